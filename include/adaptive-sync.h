@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_ADAPTIVE_SYNC_H
+#define LABWC_ADAPTIVE_SYNC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Number of commit intervals the decision is based on */
+#define ADAPTIVE_SYNC_NR_SAMPLES (64)
+#define ADAPTIVE_SYNC_NR_BUCKETS (8)
+
+struct lab_timer;
+struct output;
+struct server;
+struct view;
+
+/*
+ * Per-output state of <adaptiveSync>auto</adaptiveSync>
+ *
+ * The intervals between the commits of the fullscreen view of an output
+ * are sorted into a histogram over the most recent commits, which is
+ * used to tell continuously rendering clients (video, games) apart from
+ * the sporadic updates of desktop content.
+ */
+struct adaptive_sync {
+	struct view *view; /* fullscreen view being measured, may be NULL */
+	int64_t last_commit_nsec;
+	uint8_t samples[ADAPTIVE_SYNC_NR_SAMPLES]; /* bucket of each interval */
+	size_t head;
+	size_t count;
+	uint32_t histogram[ADAPTIVE_SYNC_NR_BUCKETS];
+	bool enabled;
+	struct lab_timer *idle_timer;
+};
+
+/**
+ * adaptive_sync_view_commit() - account for a commit of a view
+ * @view: view whose surface was committed
+ */
+void adaptive_sync_view_commit(struct view *view);
+
+/**
+ * adaptive_sync_update() - re-evaluate adaptive sync of an output
+ * @output: output to update
+ *
+ * To be called when a view on @output enters or leaves fullscreen, is
+ * (de)activated or moves to or from @output.
+ */
+void adaptive_sync_update(struct output *output);
+
+/* adaptive_sync_update_all() - the same for all outputs, e.g. on workspace switch */
+void adaptive_sync_update_all(struct server *server);
+
+/* Notify adaptive sync about a destroying view */
+void adaptive_sync_on_view_destroy(struct view *view);
+
+/* Notify adaptive sync about a destroying output */
+void adaptive_sync_on_output_destroy(struct output *output);
+
+#endif /* LABWC_ADAPTIVE_SYNC_H */
@@ -29,6 +29,19 @@
 #include <cairo.h>
 #include <wlr/types/wlr_buffer.h>
 
+struct wlr_allocator;
+
+/* What a buffer is used for, only used for memory accounting */
+enum lab_buffer_category {
+	LAB_BUFFER_OTHER = 0,
+	LAB_BUFFER_TEXT, /* titles, menu items and OSD labels */
+	LAB_BUFFER_BUTTON,
+	LAB_BUFFER_CORNER,
+	LAB_BUFFER_RESIZE_INDICATOR,
+
+	LAB_BUFFER_NR_CATEGORIES
+};
+
 struct lab_data_buffer {
 	struct wlr_buffer base;
 
@@ -39,8 +52,30 @@ struct lab_data_buffer {
 	bool free_on_destroy;
 	uint32_t unscaled_width;
 	uint32_t unscaled_height;
+
+	/* Private, allocator buffer mapped at @data, see buffer_set_allocator() */
+	struct wlr_buffer *backing;
+	/* Private, use buffer_set_category() */
+	enum lab_buffer_category category;
 };
 
+/**
+ * buffer_set_allocator - allocate large cairo buffers through wlroots
+ * @allocator: allocator of the renderer or NULL to go back to heap memory
+ *
+ * Large buffers from buffer_create_cairo() are then allocated from
+ * @allocator and mapped for drawing. A renderer can sample these buffers
+ * directly, for example by importing their dmabuf, instead of uploading
+ * the pixels. Buffers are allocated on the heap as before if @allocator
+ * can not provide buffers that can be mapped.
+ *
+ * All outputs render with the one renderer of the server, also those
+ * driven by a secondary GPU which wlroots copies finished frames to.
+ * Compositor-owned buffers and their textures are therefore shared by
+ * all outputs and never uploaded per GPU.
+ */
+void buffer_set_allocator(struct wlr_allocator *allocator);
+
 /* Create a buffer which creates a new cairo CAIRO_FORMAT_ARGB32 surface */
 struct lab_data_buffer *buffer_create_cairo(uint32_t width, uint32_t height,
 	float scale, bool free_on_destroy);
@@ -49,4 +84,38 @@ struct lab_data_buffer *buffer_create_cairo(uint32_t width, uint32_t height,
 struct lab_data_buffer *buffer_create_wrap(void *pixel_data, uint32_t width,
 	uint32_t height, uint32_t stride, bool free_on_destroy);
 
+/**
+ * buffer_set_category - account the memory of @buffer to @category
+ * @buffer: buffer to account
+ * @category: what the buffer is used for, buffers start as LAB_BUFFER_OTHER
+ */
+void buffer_set_category(struct lab_data_buffer *buffer,
+	enum lab_buffer_category category);
+
+/* buffer_print_stats - print the live buffers and their memory by category */
+void buffer_print_stats(void);
+
+/**
+ * buffer_intern - share buffers with identical pixels
+ * @buffer: fully rendered buffer, ownership is passed on
+ *
+ * Looks up a previously interned buffer with the same size, format and
+ * pixels. If there is one, @buffer is dropped and the existing buffer is
+ * returned instead, so that all users share a single wlr_buffer. Otherwise
+ * @buffer is added to the table and returned.
+ *
+ * The returned buffer must be released with buffer_intern_drop() rather
+ * than wlr_buffer_drop() and must not be modified anymore.
+ */
+struct lab_data_buffer *buffer_intern(struct lab_data_buffer *buffer);
+
+/**
+ * buffer_intern_drop - release a buffer returned by buffer_intern()
+ * @buffer: buffer to release
+ *
+ * The buffer is dropped once all users have released it. Buffers that
+ * were never interned are simply dropped.
+ */
+void buffer_intern_drop(struct lab_data_buffer *buffer);
+
 #endif /* LABWC_BUFFER_H */
@@ -0,0 +1,51 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_BUTTON_CACHE_H
+#define LABWC_BUTTON_CACHE_H
+
+#include <cairo.h>
+
+/*
+ * Decoding PNG and rendering SVG buttons is by far the most expensive part
+ * of loading a theme. The decoded images are therefore kept around, keyed
+ * by filename and render size, and re-used as long as the file is not
+ * modified. This makes a Reconfigure which changes for example only the
+ * colors of a theme or the titlebar font reuse all button images.
+ */
+
+/**
+ * button_cache_get() - get a previously decoded button image
+ * @path: full filename of the image
+ * @size: size the image was rendered at, 0 for bitmap images
+ *
+ * Returns a new reference to the image which has to be released with
+ * cairo_surface_destroy() or NULL if the image is not cached or the file
+ * has been modified since.
+ */
+cairo_surface_t *button_cache_get(const char *path, int size);
+
+/**
+ * button_cache_add() - remember a decoded button image
+ * @path: full filename of the image
+ * @size: size the image was rendered at, 0 for bitmap images
+ * @image: the decoded image, a new reference is taken
+ */
+void button_cache_add(const char *path, int size, cairo_surface_t *image);
+
+/**
+ * button_cache_preload() - decode a button image in a worker thread
+ * @path: full filename of a png or svg image
+ * @size: size to render svg images at, 0 for png images
+ *
+ * Images which are already cached are skipped. The decoded image is only
+ * added to the cache by button_cache_preload_finish(), so nothing but the
+ * decoding itself happens outside of the main thread.
+ */
+void button_cache_preload(const char *path, int size);
+
+/* button_cache_preload_finish - wait for all preloads and cache the images */
+void button_cache_preload_finish(void);
+
+/* button_cache_finish - release all cached images */
+void button_cache_finish(void);
+
+#endif /* LABWC_BUTTON_CACHE_H */
@@ -2,8 +2,19 @@
 #ifndef LABWC_BUTTON_PNG_H
 #define LABWC_BUTTON_PNG_H
 
+#include <cairo.h>
+
 struct lab_data_buffer;
 
+/**
+ * button_png_decode() - decode a png file
+ * @path: full filename
+ *
+ * Returns NULL if the file is not a valid png. Does not touch any global
+ * state and is therefore safe to be called from worker threads.
+ */
+cairo_surface_t *button_png_decode(const char *path);
+
 void button_png_load(const char *button_name, struct lab_data_buffer **buffer);
 
 #endif /* LABWC_BUTTON_PNG_H */
@@ -2,8 +2,20 @@
 #ifndef LABWC_BUTTON_SVG_H
 #define LABWC_BUTTON_SVG_H
 
+#include <cairo.h>
+
 struct lab_data_buffer;
 
+/**
+ * button_svg_render() - render an svg file
+ * @filename: full filename
+ * @size: width and height to render the image at
+ *
+ * Returns NULL on failure. Does not touch any global state and is
+ * therefore safe to be called from worker threads.
+ */
+cairo_surface_t *button_svg_render(const char *filename, int size);
+
 void button_svg_load(const char *button_name, struct lab_data_buffer **buffer,
 	int size);
 
@@ -19,4 +19,7 @@ void button_xbm_from_bitmap(const char *bitmap, struct lab_data_buffer **buffer,
 void button_xbm_load(const char *button_name, struct lab_data_buffer **buffer,
 	float *rgba);
 
+/* button_xbm_finish - free the file kept decoded by button_xbm_load() */
+void button_xbm_finish(void);
+
 #endif /* LABWC_BUTTON_XBM_H */
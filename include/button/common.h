@@ -12,4 +12,13 @@
  */
 void button_filename(const char *name, char *buf, size_t len);
 
+/*
+ * button_filename() answers from listings of the theme directories.
+ * button_filename_revalidate() makes it check once whether a directory
+ * changed (by its mtime) before using the listing again, so it should
+ * be called whenever a theme is (re-)loaded.
+ */
+void button_filename_revalidate(void);
+void button_filename_finish(void);
+
 #endif /* LABWC_BUTTON_COMMON_H */
@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_BITSET_H
+#define LABWC_BITSET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Set of small non-negative integers, such as output indices, growing as
+ * needed. A zero-initialized struct bitset is an empty set.
+ */
+struct bitset {
+	uint64_t *words;
+	size_t nr_words;
+};
+
+void bitset_set(struct bitset *set, size_t bit);
+bool bitset_test(const struct bitset *set, size_t bit);
+
+/* Removes all members, keeping the memory for reuse */
+void bitset_clear(struct bitset *set);
+
+/* Makes @dst hold the same members as @src */
+void bitset_copy(struct bitset *dst, const struct bitset *src);
+
+bool bitset_equal(const struct bitset *a, const struct bitset *b);
+bool bitset_intersects(const struct bitset *a, const struct bitset *b);
+
+/* Returns the number of members */
+size_t bitset_count(const struct bitset *set);
+
+/* Returns the smallest integer which is not a member */
+size_t bitset_first_unset(const struct bitset *set);
+
+void bitset_finish(struct bitset *set);
+
+#endif /* LABWC_BITSET_H */
@@ -50,6 +50,21 @@ void buf_expand_shell_variables(struct buf *s);
  */
 void buf_add(struct buf *s, const char *data);
 
+/**
+ * buf_add_len - add data of known length to C string buffer
+ * @s: buffer
+ * @data: data to be added, does not need to be NUL-terminated
+ * @len: number of bytes to add
+ */
+void buf_add_len(struct buf *s, const char *data, int len);
+
+/**
+ * buf_add_fmt - add printf-style formatted string to C string buffer
+ * @s: buffer
+ * @fmt: printf-style format
+ */
+void buf_add_fmt(struct buf *s, const char *fmt, ...);
+
 /**
  * buf_add_char - add single char to C string buffer
  * @s: buffer
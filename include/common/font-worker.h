@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_FONT_WORKER_H
+#define LABWC_FONT_WORKER_H
+
+#include <stddef.h>
+
+struct font;
+struct font_job;
+struct lab_data_buffer;
+struct wl_event_loop;
+
+/*
+ * Text rasterization off the main thread
+ *
+ * Shaping and drawing text with font fallback (CJK, emoji) can take
+ * milliseconds per string. font_worker_submit() hands the drawing to a
+ * worker thread which renders into plain ARGB memory; the result is
+ * wrapped into a lab_data_buffer on the main thread once an eventfd
+ * watched by the event loop signals completion.
+ *
+ * Text measurement stays synchronous, so callers know the final size of
+ * the buffer immediately and can keep showing the old one until the new
+ * one arrives.
+ */
+
+/*
+ * Called on the main thread. @buffer is NULL if rendering failed or the
+ * worker is shutting down; it must then be rendered synchronously.
+ */
+typedef void (*font_job_done_t)(struct lab_data_buffer *buffer,
+	double scale, void *data);
+
+/* font_worker_init - start the worker, dispatching results to @loop */
+void font_worker_init(struct wl_event_loop *loop);
+
+/**
+ * font_worker_submit - render text asynchronously
+ * @text_width, @arrow_width, @height: sizes from font_buffer_size()
+ * Other arguments are as for font_buffer_create() and are copied.
+ *
+ * Returns NULL if the worker is not available, in which case @done is
+ * never called.
+ */
+struct font_job *font_worker_submit(int text_width, int arrow_width,
+	int height, const char *text, struct font *font, const float *color,
+	const float *bg_color, const char *arrow, double scale,
+	font_job_done_t done, void *data);
+
+/**
+ * font_worker_warm_up - load @fonts in the background
+ *
+ * Makes fontconfig initialize and the font files (including common
+ * fallbacks) get loaded and shaped before the first title needs them.
+ */
+void font_worker_warm_up(struct font *fonts, size_t nr_fonts);
+
+/* font_job_cancel - drop a job; its callback will not be called */
+void font_job_cancel(struct font_job *job);
+
+/* font_worker_finish - wait for the worker, completing all jobs with NULL */
+void font_worker_finish(void);
+
+#endif /* LABWC_FONT_WORKER_H */
@@ -2,6 +2,9 @@
 #ifndef LABWC_FONT_H
 #define LABWC_FONT_H
 
+#include <cairo.h>
+#include <stdbool.h>
+
 struct lab_data_buffer;
 
 enum font_slant {
@@ -35,6 +38,28 @@ int font_height(struct font *font);
  */
 int font_width(struct font *font, const char *string);
 
+/**
+ * font_buffer_size - get the size of the buffer font_buffer_create()
+ * would create for the same arguments, in logical pixels
+ * @text_width: width of the (possibly ellipsized) text
+ * @arrow_width: width of the arrow or 0 for none
+ * @height: height of the buffer
+ * Returns false if there is nothing to render.
+ */
+bool font_buffer_size(int max_width, const char *text, struct font *font,
+	const char *arrow, int *text_width, int *arrow_width, int *height);
+
+/**
+ * font_render - render text and arrow to @cairo as font_buffer_create()
+ * does, using the sizes returned by font_buffer_size()
+ *
+ * Unlike the other functions here, this one does not touch any global
+ * state and may be called from any thread.
+ */
+void font_render(cairo_t *cairo, int text_width, int arrow_width,
+	const char *text, struct font *font, const float *color,
+	const float *bg_color, const char *arrow);
+
 /**
  * font_buffer_create - Create ARGB8888 lab_data_buffer using pango
  * @buffer: buffer pointer
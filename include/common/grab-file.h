@@ -8,6 +8,8 @@
 #ifndef LABWC_GRAB_FILE_H
 #define LABWC_GRAB_FILE_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include "common/buf.h"
 
 /**
@@ -17,4 +19,43 @@
  */
 struct buf grab_file(const char *filename);
 
+/**
+ * struct file_view - whole file read into memory
+ * @data: NUL-terminated file content, which may be modified in place
+ * @len: length of content, not including terminating NUL
+ */
+struct file_view {
+	char *data;
+	size_t len;
+	/* private */
+	size_t pos;
+};
+
+/**
+ * file_view_open - read file into memory
+ * @view: view to initialize
+ * @filename: file to read
+ * Return false if the file could not be read.
+ * Release the memory with file_view_close().
+ */
+bool file_view_open(struct file_view *view, const char *filename);
+
+void file_view_close(struct file_view *view);
+
+/**
+ * file_view_next_line - split off the next line in place
+ * @view: view
+ * The line break is replaced by NUL, so the returned line points into
+ * @view->data. Return NULL when all lines have been consumed.
+ */
+char *file_view_next_line(struct file_view *view);
+
+/**
+ * file_view_join_lines - remove all line breaks in place
+ * @view: view
+ * This gives the same content as grab_file() and the historic line by
+ * line readers, which is what the XML parsers have always been fed.
+ */
+void file_view_join_lines(struct file_view *view);
+
 #endif /* LABWC_GRAB_FILE_H */
@@ -3,6 +3,7 @@
 #define LABWC_GRAPHIC_HELPERS_H
 
 #include <cairo.h>
+#include <stdint.h>
 #include <wayland-server-core.h>
 
 struct wlr_scene_tree;
@@ -38,6 +39,19 @@ struct multi_rect *multi_rect_create(struct wlr_scene_tree *parent,
 
 void multi_rect_set_size(struct multi_rect *rect, int width, int height);
 
+/**
+ * outline_rect_create - create a rectangular outline of solid color
+ * @parent: scene tree to add the outline to
+ * @width, @height: outer size of the outline
+ * @line_width: width of the lines, drawn inside of @width and @height
+ * @color: color of the lines
+ *
+ * The outline consists of four wlr_scene_rects in a new tree which is
+ * returned and can be positioned and destroyed as a whole.
+ */
+struct wlr_scene_tree *outline_rect_create(struct wlr_scene_tree *parent,
+	int width, int height, int line_width, const float *color);
+
 /**
  * Sets the cairo color.
  * Splits a float[4] single color array into its own arguments
@@ -47,6 +61,32 @@ void set_cairo_color(cairo_t *cairo, const float *color);
 /* Draws a border with a specified line width */
 void draw_cairo_border(cairo_t *cairo, struct wlr_fbox fbox, double line_width);
 
+/*
+ * Pixel kernels for the simple operations of the decorations, cheaper
+ * than going through cairo. They work on premultiplied ARGB32 pixels as
+ * used by cairo and are written without branches or cross-pixel
+ * dependencies so that the compiler can vectorize them.
+ */
+
+/* pixel_from_color - pack premultiplied RGBA floats into ARGB32 */
+uint32_t pixel_from_color(const float *color);
+
+/**
+ * pixels_from_mask - colour in a 1bpp bitmap
+ * @dst: @width * @height pixels without padding
+ * @bits: bitmap rows of @mask_stride bytes, least significant bit first
+ */
+void pixels_from_mask(uint32_t *dst, const uint8_t *bits, int mask_stride,
+	int width, int height, uint32_t color);
+
+/**
+ * pixels_blend_color - paint @color over pixels
+ * @data: first pixel, rows are @stride bytes apart
+ * @color: premultiplied RGBA
+ */
+void pixels_blend_color(uint32_t *data, int width, int height, int stride,
+	const float *color);
+
 struct lab_data_buffer;
 
 struct surface_context {
@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_HASH_H
+#define LABWC_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * 64-bit FNV-1a, used to detect changes of inputs rather than for hash
+ * tables. Start with HASH_INIT and feed the values one after another.
+ */
+#define HASH_INIT (14695981039346656037ull)
+
+static inline uint64_t
+hash_data(uint64_t hash, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+	for (size_t i = 0; i < len; i++) {
+		hash ^= p[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+/* NULL hashes like "", the terminator separates consecutive strings */
+static inline uint64_t
+hash_str(uint64_t hash, const char *str)
+{
+	if (!str) {
+		str = "";
+	}
+	return hash_data(hash, str, strlen(str) + 1);
+}
+
+#define hash_value(hash, value) hash_data((hash), &(value), sizeof(value))
+
+#endif /* LABWC_HASH_H */
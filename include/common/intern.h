@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_INTERN_H
+#define LABWC_INTERN_H
+
+/*
+ * Interned strings
+ *
+ * An interned string is shared by all users of the same text, so that
+ * two interned strings are equal if and only if the pointers are equal.
+ * This is used for app_ids and titles which are often identical for
+ * many views. Interned strings are refcounted and must not be modified
+ * or passed to free().
+ */
+
+/**
+ * intern_str - get the interned copy of a string
+ * @str: string to intern, may be NULL
+ * Return a new reference to the interned string or NULL if @str is NULL.
+ */
+const char *intern_str(const char *str);
+
+/**
+ * intern_ref - take another reference to an interned string
+ * @str: interned string, may be NULL
+ * Return @str.
+ */
+const char *intern_ref(const char *str);
+
+/**
+ * intern_unref - drop a reference to an interned string
+ * @str: interned string, may be NULL
+ */
+void intern_unref(const char *str);
+
+#endif /* LABWC_INTERN_H */
@@ -52,4 +52,62 @@ char *xstrdup(const char *str);
 	free(ptr); (ptr) = NULL; \
 } while (0)
 
+struct pool_slab;
+struct wl_array;
+struct wl_event_loop;
+
+/*
+ * Scratch memory for short-lived allocations like temporary view arrays.
+ * Scratch allocations are never freed individually. Instead all of them
+ * are dropped at once when the event loop becomes idle again, so they
+ * must not be kept beyond the event handler they were made in.
+ *
+ * scratch_init() hooks the reset into the event loop. Without it, scratch
+ * memory is only reclaimed by scratch_finish().
+ */
+void scratch_init(struct wl_event_loop *loop);
+void scratch_finish(void);
+
+/*
+ * Like xmalloc() but allocates from scratch memory.
+ * Returns NULL only if (size == 0).
+ * Does NOT zero-fill memory.
+ */
+void *scratch_alloc(size_t size);
+
+/*
+ * Like wl_array_add() but grows the array in scratch memory. The array
+ * has to be initialized with wl_array_init() and must not be passed to
+ * wl_array_add() or wl_array_release() afterwards.
+ */
+void *scratch_array_add(struct wl_array *array, size_t size);
+
+/*
+ * Pool of equally sized objects which are created and destroyed all the
+ * time, like node descriptors and SSD parts. Objects are cut from slabs
+ * and freed ones are reused before the next slab is allocated, so this
+ * is cheaper than malloc() and keeps the objects close together. Slabs
+ * are only returned by pool_finish().
+ *
+ *   static struct pool part_pool = POOL_INIT(struct ssd_part);
+ *   struct ssd_part *part = pool_alloc(&part_pool);
+ *   pool_free(&part_pool, part);
+ */
+struct pool {
+	size_t size;
+	void *free_list;
+	struct pool_slab *slabs;
+	/* Number of objects cut from the first slab */
+	size_t slab_used;
+};
+
+#define POOL_INIT(type) { .size = sizeof(type) }
+
+/* Like znew(), allocates a zero-filled object; never returns NULL */
+void *pool_alloc(struct pool *pool);
+void pool_free(struct pool *pool, void *ptr);
+
+/* Frees all slabs, the objects in them must no longer be used */
+void pool_finish(struct pool *pool);
+
 #endif /* LABWC_MEM_H */
@@ -7,6 +7,8 @@
 struct wlr_scene_tree;
 struct wlr_scene_buffer;
 struct scaled_scene_buffer;
+struct font_job;
+struct lab_data_buffer;
 
 struct scaled_font_buffer {
 	struct wlr_scene_buffer *scene_buffer;
@@ -21,6 +23,12 @@ struct scaled_font_buffer {
 	char *arrow;
 	struct font font;
 	struct scaled_scene_buffer *scaled_buffer;
+
+	/* Rendering in the font worker, the old buffer stays visible */
+	struct font_job *pending;
+	/* Delivered by the font worker, consumed by the next render */
+	struct lab_data_buffer *ready;
+	double ready_scale;
 };
 
 /**
@@ -45,6 +53,11 @@ struct scaled_font_buffer *scaled_font_buffer_create(struct wlr_scene_tree *pare
  * - truncated = buffer->width == max_width
  * - text_changed = strcmp(old_text, new_text)
  * - font and color the same
+ *
+ * The new text is measured right away, so width and height are up to date
+ * when this returns. If some text is already shown, the new buffer is
+ * rasterized by the font worker though and replaces the old one a little
+ * later.
  */
 void scaled_font_buffer_update(struct scaled_font_buffer *self, const char *text,
 	int max_width, struct font *font, const float *color,
@@ -2,11 +2,18 @@
 #ifndef LABWC_SCALED_SCENE_BUFFER_H
 #define LABWC_SCALED_SCENE_BUFFER_H
 
-#define LAB_SCALED_BUFFER_MAX_CACHE 2
+#include <stddef.h>
+
+/* Minimum number of buffers cached per scaled_scene_buffer */
+#define LAB_SCALED_BUFFER_MIN_CACHE 2
+
+/* Memory all scaled_scene_buffers may use for cached buffers combined */
+#define LAB_SCALED_BUFFER_MEMORY_BUDGET (64 * 1024 * 1024)
 
 struct wl_list;
 struct wlr_buffer;
 struct wl_listener;
+struct wlr_scene_output;
 struct wlr_scene_tree;
 struct lab_data_buffer;
 struct scaled_scene_buffer;
@@ -29,6 +36,8 @@ struct scaled_scene_buffer {
 	bool drop_buffer;
 	double active_scale;
 	struct wl_list cache;  /* struct scaled_buffer_cache_entry.link */
+	int nr_cache_entries;
+	struct wl_list link;   /* all scaled_scene_buffers */
 	struct wl_listener destroy;
 	struct wl_listener output_enter;
 	struct wl_listener output_leave;
@@ -39,14 +48,20 @@ struct scaled_scene_buffer {
  * Create an auto scaling buffer that creates a wlr_scene_buffer
  * and subscribes to its output_enter and output_leave signals.
  *
- * If the maximal scale changes, it either sets an already existing buffer
+ * If the maximal scale of the outputs the buffer is displayed on changes,
+ * either by moving the buffer or by changing the scale of one of these
+ * outputs (see scaled_scene_buffer_on_output_scale_change()), it either
+ * sets an already existing buffer
  * that was rendered for the current scale or - if there is none - calls
  * implementation->create_buffer(self, scale) to get a new lab_data_buffer
  * optimized for the new scale.
  *
- * Up to LAB_SCALED_BUFFER_MAX_CACHE (2) buffers are cached in an LRU fashion
- * to handle the majority of use cases where a view is moved between no more
- * than two different scales.
+ * Buffers are cached in an LRU fashion, by default one per distinct output
+ * scale (but at least LAB_SCALED_BUFFER_MIN_CACHE), so that moving a view
+ * between outputs does not cause re-rendering. In addition, the memory used
+ * by the caches of all instances combined is limited to
+ * LAB_SCALED_BUFFER_MEMORY_BUDGET; beyond that the least recently used
+ * buffers which are not currently displayed are evicted first.
  *
  * scaled_scene_buffer will clean up automatically once the internal
  * wlr_scene_buffer is being destroyed. If implementation->destroy is set
@@ -55,8 +70,8 @@ struct scaled_scene_buffer {
  *
  * All requested lab_data_buffers via impl->create_buffer() will be locked
  * during the lifetime of the buffer in the internal cache and unlocked
- * when being evacuated from the cache (due to LAB_SCALED_BUFFER_MAX_CACHE
- * or the internal wlr_scene_buffer being destroyed).
+ * when being evacuated from the cache (due to the cache size, the memory
+ * budget or the internal wlr_scene_buffer being destroyed).
  *
  * If drop_buffer was set during creation of the scaled_scene_buffer, the
  * backing wlr_buffer behind a lab_data_buffer will also get dropped
@@ -75,6 +90,11 @@ struct scaled_scene_buffer {
  *
  * The rough idea is: use drop_buffer = true for one-shot buffers and false
  * for buffers that should outlive the scaled_scene_buffer instance itself.
+ *
+ * With drop_buffer = true, impl->create_buffer() may also return the same
+ * lab_data_buffer for multiple scaled_scene_buffers. The buffer is dropped
+ * by whichever instance evicts it first and free'd once the last instance
+ * has unlocked it.
  */
 struct scaled_scene_buffer *scaled_scene_buffer_create(
 	struct wlr_scene_tree *parent,
@@ -84,10 +104,60 @@ struct scaled_scene_buffer *scaled_scene_buffer_create(
 /* Clear the cache of existing buffers, useful in case the content changes */
 void scaled_scene_buffer_invalidate_cache(struct scaled_scene_buffer *self);
 
+/**
+ * scaled_scene_buffer_set_cache_size - set the number of buffers cached
+ * by each scaled_scene_buffer
+ * @size: usually the number of distinct output scales, values below
+ *	  LAB_SCALED_BUFFER_MIN_CACHE are raised to it
+ *
+ * Caches exceeding the new size are trimmed on their next update.
+ */
+void scaled_scene_buffer_set_cache_size(int size);
+
+/**
+ * scaled_scene_buffer_on_output_scale_change - update the buffers displayed
+ * on an output whose scale has changed
+ *
+ * Buffers not displayed on the output are left alone, they are updated
+ * once they enter an output.
+ */
+void scaled_scene_buffer_on_output_scale_change(
+	struct wlr_scene_output *scene_output);
+
+/**
+ * scaled_scene_buffer_trim_caches - evict all buffers not displayed
+ *
+ * Only the buffer each scaled_scene_buffer currently shows is kept. The
+ * others are rendered again if their scale is ever needed.
+ */
+void scaled_scene_buffer_trim_caches(void);
+
+/**
+ * scaled_scene_buffer_print_stats - print memory use, cache hits, misses
+ * and evictions of all scaled_scene_buffers combined
+ */
+void scaled_scene_buffer_print_stats(void);
+
+struct scaled_scene_buffer_stats {
+	size_t nr_entries;
+	size_t memory_used;
+	size_t nr_hits;
+	size_t nr_misses;
+	size_t nr_evictions_cache_size;
+	size_t nr_evictions_budget;
+	size_t nr_evictions_trim;
+};
+
+/* scaled_scene_buffer_get_stats - get the numbers printed by the above */
+void scaled_scene_buffer_get_stats(struct scaled_scene_buffer_stats *stats);
+
 /* Private */
 struct scaled_scene_buffer_cache_entry {
 	struct wl_list link;   /* struct scaled_scene_buffer.cache */
+	struct wl_list global_link;
+	struct scaled_scene_buffer *owner;
 	struct wlr_buffer *buffer;
+	size_t size;           /* bytes, for the memory budget */
 	double scale;
 };
 
@@ -3,8 +3,11 @@
 #define LABWC_SCENE_HELPERS_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
+struct timespec;
 struct wlr_scene_node;
+struct wlr_scene_tree;
 struct wlr_surface;
 struct wlr_scene_output;
 
@@ -17,7 +20,65 @@ struct wlr_surface *lab_wlr_surface_from_node(struct wlr_scene_node *node);
  */
 struct wlr_scene_node *lab_wlr_scene_get_prev_node(struct wlr_scene_node *node);
 
-/* A variant of wlr_scene_output_commit() that respects wlr_output->pending */
-bool lab_wlr_scene_output_commit(struct wlr_scene_output *scene_output);
+/**
+ * lab_wlr_scene_node_at_skip - variant of wlr_scene_node_at() that ignores
+ * one child of @tree without changing the scene and causing damage
+ * @tree: tree to search in
+ * @skip: direct child of @tree to ignore, e.g. the drag icons
+ * @lx, @ly: layout coordinates
+ * @nx, @ny: if a node is found, set to the node-local coordinates
+ */
+struct wlr_scene_node *lab_wlr_scene_node_at_skip(struct wlr_scene_tree *tree,
+	struct wlr_scene_node *skip, double lx, double ly,
+	double *nx, double *ny);
+
+struct wlr_buffer;
+
+/* Durations of the individual steps of lab_wlr_scene_output_commit() */
+struct lab_scene_commit_timing {
+	int64_t build_state_nsec;
+	int64_t commit_nsec;
+	/* Buffer that was committed, used to detect direct scanout */
+	struct wlr_buffer *buffer;
+};
+
+/**
+ * lab_wlr_scene_output_commit - variant of wlr_scene_output_commit() that
+ * respects wlr_output->pending, including a gamma LUT set there
+ * @scene_output: scene output to commit
+ * @timing: if not NULL, filled with the time spent building the output
+ *          state and committing it. Only valid if true is returned.
+ */
+bool lab_wlr_scene_output_commit(struct wlr_scene_output *scene_output,
+	struct lab_scene_commit_timing *timing);
+
+/**
+ * lab_wlr_scene_output_build - first half of lab_wlr_scene_output_commit()
+ * Renders into wlr_output->pending. Returns false if there is nothing to
+ * commit or rendering failed.
+ */
+bool lab_wlr_scene_output_build(struct wlr_scene_output *scene_output,
+	struct lab_scene_commit_timing *timing);
+
+/**
+ * lab_wlr_scene_output_commit_built - second half of
+ * lab_wlr_scene_output_commit(), to be called after a successful
+ * lab_wlr_scene_output_build() without the scene being changed in between
+ */
+bool lab_wlr_scene_output_commit_built(struct wlr_scene_output *scene_output,
+	struct lab_scene_commit_timing *timing);
+
+/**
+ * lab_wlr_scene_output_send_frame_done - variant of
+ * wlr_scene_output_send_frame_done() that can leave out subtrees
+ * @scene_output: scene output to send frame-done events for
+ * @now: timestamp passed to the clients
+ * @skip: called for each enabled tree, returning true skips the tree
+ *        and all of its descendants
+ * @data: passed to @skip
+ */
+void lab_wlr_scene_output_send_frame_done(struct wlr_scene_output *scene_output,
+	struct timespec *now,
+	bool (*skip)(struct wlr_scene_tree *tree, void *data), void *data);
 
 #endif /* LABWC_SCENE_HELPERS_H */
@@ -16,6 +16,24 @@ pid_t spawn_primary_client(const char *command);
  */
 void spawn_async_no_shell(char const *command);
 
+/**
+ * spawn_helper_start - start the launcher helper process
+ *
+ * Forks a small helper process which spawn_async_no_shell() hands its
+ * commands to from then on, so that launching does not have to be done
+ * from the compositor process itself. If the helper goes away, commands
+ * are spawned directly again.
+ *
+ * Must be called before any threads are started, see main().
+ */
+void spawn_helper_start(void);
+
+/**
+ * spawn_helper_stop - stop the launcher helper process
+ * It cannot be started again afterwards.
+ */
+void spawn_helper_stop(void);
+
 /**
  * spawn_piped - execute asyncronously
  * @command: command to be executed
@@ -0,0 +1,21 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_TIME_HELPERS_H
+#define LABWC_TIME_HELPERS_H
+#include <stdint.h>
+#include <time.h>
+
+#define NSEC_PER_MSEC (1000000LL)
+#define NSEC_PER_SEC (1000000000LL)
+
+/**
+ * time_timespec_to_nsec() - convert timespec to nanoseconds
+ * @ts: timespec to convert
+ */
+int64_t time_timespec_to_nsec(const struct timespec *ts);
+
+/**
+ * time_now_nsec() - get current CLOCK_MONOTONIC time in nanoseconds
+ */
+int64_t time_now_nsec(void);
+
+#endif /* LABWC_TIME_HELPERS_H */
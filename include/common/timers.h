@@ -0,0 +1,43 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_TIMERS_H
+#define LABWC_TIMERS_H
+
+#include <wayland-server-core.h>
+
+struct lab_timer;
+
+/**
+ * timers_add() - create a timer, the equivalent of wl_event_loop_add_timer()
+ * @loop: event loop, the same one must be used for all timers
+ * @func: callback run once the timer expires
+ * @data: argument of @func
+ *
+ * All timers are multiplexed onto a single timerfd of @loop, so creating
+ * and re-arming them does not involve any system calls unless the next
+ * deadline changes. Timers are created disarmed. The name of @func is
+ * used for latency tracing, see latency-trace.h.
+ */
+#define timers_add(loop, func, data) \
+	timers_add_named((loop), (func), (data), #func)
+
+struct lab_timer *timers_add_named(struct wl_event_loop *loop,
+	wl_event_loop_timer_func_t func, void *data, const char *name);
+
+/**
+ * timers_update() - arm or disarm a timer, like wl_event_source_timer_update()
+ * @timer: timer to update
+ * @ms_delay: delay in milliseconds after which the timer expires,
+ *	      or 0 to disarm the timer
+ *
+ * An expired timer is disarmed before its callback is run, which may
+ * re-arm or remove it.
+ */
+void timers_update(struct lab_timer *timer, int ms_delay);
+
+/**
+ * timers_remove() - destroy a timer, like wl_event_source_remove()
+ * @timer: timer to destroy
+ */
+void timers_remove(struct lab_timer *timer);
+
+#endif /* LABWC_TIMERS_H */
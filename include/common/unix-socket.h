@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_UNIX_SOCKET_H
+#define LABWC_UNIX_SOCKET_H
+
+struct buf;
+
+/**
+ * unix_socket_path() - resolve the configured path of a socket
+ * @path: buffer to add the path to
+ * @name: configured path, relative paths are relative to XDG_RUNTIME_DIR
+ */
+void unix_socket_path(struct buf *path, const char *name);
+
+/**
+ * unix_socket_listen() - listen on a Unix stream socket
+ * @path: socket path
+ * @backlog: maximum number of pending connections
+ *
+ * A socket left behind at @path by a crashed instance is replaced, any
+ * other file is not. The socket is only accessible by the user.
+ *
+ * Returns the non-blocking, close-on-exec socket or -1 on failure, which
+ * has been logged.
+ */
+int unix_socket_listen(const char *path, int backlog);
+
+#endif /* LABWC_UNIX_SOCKET_H */
@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_CONFIG_CACHE_H
+#define LABWC_CONFIG_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Compiled rc.xml cache
+ *
+ * When enabled with the environment variable LABWC_CONFIG_CACHE, the
+ * stream of SAX events of the parsed config files is stored in a binary
+ * file in ${XDG_CACHE_HOME:-$HOME/.cache}/labwc. On the next start or
+ * reconfigure with identical config files the events are replayed from
+ * the mapped cache file and libxml2 is not involved at all.
+ *
+ * Events rather than the resulting struct rcxml are stored, so that the
+ * cache does not depend on the layout of any in-memory structure and the
+ * post-processing of the config always runs exactly as after parsing.
+ */
+
+/* Initial value for config_cache_key() */
+#define CONFIG_CACHE_KEY_INIT (14695981039346656037ull)
+
+struct config_cache_handler {
+	void (*start_element)(const char *name);
+	void (*attribute)(const char *name, const char *value, int len);
+	void (*characters)(const char *text, int len);
+	void (*end_element)(void);
+};
+
+/* config_cache_enabled - true if LABWC_CONFIG_CACHE is set to true */
+bool config_cache_enabled(void);
+
+/**
+ * config_cache_key - add a config file to the cache key
+ * @key: current key, CONFIG_CACHE_KEY_INIT for the first file
+ * @path: path of the config file
+ * @data: content of the config file as fed to the parser
+ * @len: length of @data
+ */
+uint64_t config_cache_key(uint64_t key, const char *path, const char *data,
+	size_t len);
+
+/**
+ * config_cache_replay - feed cached events to @handler
+ * @key: key of the current config files
+ * @handler: callbacks to receive the events
+ * Return false, without calling any callback, if there is no valid cache
+ * for @key.
+ */
+bool config_cache_replay(uint64_t key,
+	const struct config_cache_handler *handler);
+
+/*
+ * Recording of SAX events for the cache. Events are ignored unless
+ * between config_cache_record_begin() and config_cache_record_finish().
+ */
+void config_cache_record_begin(void);
+void config_cache_record_start_element(const char *name);
+void config_cache_record_attribute(const char *name, const char *value,
+	int len);
+void config_cache_record_characters(const char *text, int len);
+void config_cache_record_end_element(void);
+
+/**
+ * config_cache_record_finish - stop recording
+ * @key: key of the recorded config files
+ * @commit: write the recorded events to the cache file
+ */
+void config_cache_record_finish(uint64_t key, bool commit);
+
+#endif /* LABWC_CONFIG_CACHE_H */
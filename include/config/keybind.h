@@ -37,5 +37,34 @@ uint32_t parse_modifier(const char *symname);
 
 bool keybind_the_same(struct keybind *a, struct keybind *b);
 
+/**
+ * keybind_hash - hash of the fields compared by keybind_the_same()
+ * @keybind: keybind
+ */
+uint32_t keybind_hash(struct keybind *keybind);
+
 void keybind_update_keycodes(struct server *server);
+
+/**
+ * keybind_lookup_keycode - find keybinds matching modifiers and keycode
+ * @modifiers: exact set of modifiers
+ * @keycode: xkb keycode
+ *
+ * Returns an array of struct keybind * in config order or NULL if there
+ * are none. The array is only valid until keybinds or keymaps change.
+ */
+struct wl_array *keybind_lookup_keycode(uint32_t modifiers,
+	xkb_keycode_t keycode);
+
+/**
+ * keybind_lookup_keysym - find keybinds matching modifiers and keysym
+ * @modifiers: exact set of modifiers
+ * @sym: keysym, case insensitive
+ *
+ * Same as keybind_lookup_keycode() but for keysyms.
+ */
+struct wl_array *keybind_lookup_keysym(uint32_t modifiers, xkb_keysym_t sym);
+
+/* Free the lookup index, used when keybinds are destroyed */
+void keybind_index_finish(void);
 #endif /* LABWC_KEYBIND_H */
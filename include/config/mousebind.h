@@ -14,6 +14,8 @@ enum mouse_event {
 	MOUSE_ACTION_RELEASE,
 	MOUSE_ACTION_DRAG,
 	MOUSE_ACTION_SCROLL,
+	MOUSE_ACTION_SWIPE,
+	MOUSE_ACTION_PINCH,
 };
 
 enum direction {
@@ -22,6 +24,11 @@ enum direction {
 	LAB_DIRECTION_RIGHT,
 	LAB_DIRECTION_UP,
 	LAB_DIRECTION_DOWN,
+	/* Pinch gestures */
+	LAB_DIRECTION_IN,
+	LAB_DIRECTION_OUT,
+
+	LAB_DIRECTION_COUNT
 };
 
 struct mousebind {
@@ -30,9 +37,15 @@ struct mousebind {
 	/* ex: BTN_LEFT, BTN_RIGHT from linux/input_event_codes.h */
 	uint32_t button;
 
-	/* scroll direction; considered instead of button for scroll events */
+	/*
+	 * scroll or gesture direction; considered instead of button for
+	 * scroll and gesture events
+	 */
 	enum direction direction;
 
+	/* number of fingers of swipe and pinch gestures */
+	uint32_t fingers;
+
 	/* ex: WLR_MODIFIER_SHIFT | WLR_MODIFIER_LOGO */
 	uint32_t modifiers;
 
@@ -50,4 +63,51 @@ enum direction mousebind_direction_from_str(const char *str, uint32_t *modifiers
 struct mousebind *mousebind_create(const char *context);
 bool mousebind_the_same(struct mousebind *a, struct mousebind *b);
 
+/**
+ * mousebind_hash() - hash of the fields compared by mousebind_the_same()
+ * @mousebind: mousebind
+ */
+uint32_t mousebind_hash(struct mousebind *mousebind);
+
+/* Entry of the mousebind lookup index */
+struct mousebind_entry {
+	struct mousebind *mousebind;
+	/* Bit per enum ssd_part_type contained in mousebind->context */
+	uint32_t contexts;
+};
+
+static inline bool
+mousebind_entry_matches(const struct mousebind_entry *entry,
+		enum ssd_part_type context)
+{
+	return entry->contexts & (1u << context);
+}
+
+/**
+ * mousebind_lookup_scroll() - get scroll mousebinds for a direction
+ * @direction: scroll direction
+ *
+ * Return: array of struct mousebind_entry, in config order, or NULL if
+ * there are none. Modifiers and context still need to be checked by the
+ * caller.
+ */
+struct wl_array *mousebind_lookup_scroll(enum direction direction);
+
+/**
+ * mousebind_lookup_button() - get mousebinds for a button
+ * @button: button, e.g. BTN_LEFT
+ * @modifiers: exact set of modifiers
+ *
+ * Return: array of struct mousebind_entry of all events, in config order,
+ * or NULL if there are none. The context still needs to be checked by the
+ * caller with mousebind_entry_matches().
+ */
+struct wl_array *mousebind_lookup_button(uint32_t button, uint32_t modifiers);
+
+/* Reset pressed_in_context of all mousebinds of a button */
+void mousebind_clear_pressed(uint32_t button);
+
+/* Free the lookup index, used when mousebinds are destroyed */
+void mousebind_index_finish(void);
+
 #endif /* LABWC_MOUSEBIND_H */
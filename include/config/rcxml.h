@@ -14,6 +14,7 @@
 #include "config/libinput.h"
 #include "resize_indicator.h"
 #include "theme.h"
+#include "tiling.h"
 
 enum view_placement_policy {
 	LAB_PLACE_CENTER = 0,
@@ -25,6 +26,19 @@ enum adaptive_sync_mode {
 	LAB_ADAPTIVE_SYNC_DISABLED,
 	LAB_ADAPTIVE_SYNC_ENABLED,
 	LAB_ADAPTIVE_SYNC_FULLSCREEN,
+	LAB_ADAPTIVE_SYNC_AUTO,
+};
+
+enum tearing_mode {
+	LAB_TEARING_DISABLED = 0,
+	LAB_TEARING_ENABLED,
+	LAB_TEARING_AUTO,
+};
+
+enum xwayland_start_mode {
+	LAB_XWAYLAND_START_LAZY = 0,
+	LAB_XWAYLAND_START_STARTUP,
+	LAB_XWAYLAND_START_DELAYED,
 };
 
 enum tiling_events_mode {
@@ -41,6 +55,21 @@ struct usable_area_override {
 	struct wl_list link; /* struct rcxml.usable_area_overrides */
 };
 
+/* Use render durations measured by frame-stats as render time budget */
+#define LAB_MAX_RENDER_TIME_AUTO (-1)
+
+struct output_config {
+	char *name; /* NULL applies to all outputs */
+	int max_render_time; /* in ms, 0 means disabled */
+	/* Initial mode of virtual outputs, 0 means unset */
+	int width;
+	int height;
+	int refresh; /* in mHz */
+	float scale;
+	bool constant_frame_rate;
+	struct wl_list link; /* struct rcxml.output_configs */
+};
+
 struct rcxml {
 	/* from command line */
 	char *config_dir;
@@ -51,9 +80,22 @@ struct rcxml {
 	bool xdg_shell_server_side_deco;
 	int gap;
 	enum adaptive_sync_mode adaptive_sync;
-	bool allow_tearing;
+	enum tearing_mode allow_tearing;
 	bool reuse_output_mode;
+	bool spawn_helper;
+	bool realtime; /* only applied at startup */
+	bool batch_output_frames;
+	enum xwayland_start_mode xwayland_start;
+	int xwayland_start_delay; /* ms */
+	char *metrics_socket; /* NULL if disabled */
+	char *window_state_socket; /* NULL if disabled */
+	int title_update_interval; /* ms, 0 means one output frame */
+	int throttled_frame_rate; /* Hz, 0 means none */
 	enum view_placement_policy placement_policy;
+	bool placement_remember_geometry;
+	bool placement_restore_session;
+	enum tiling_layout tiling_layout;
+	int tiling_master_ratio; /* percent */
 
 	/* focus */
 	bool focus_follow_mouse;
@@ -74,6 +116,9 @@ struct rcxml {
 	/* <margin top="" bottom="" left="" right="" output="" /> */
 	struct wl_list usable_area_overrides;
 
+	/* <outputs><output name="" maxRenderTime="" /></outputs> */
+	struct wl_list output_configs;
+
 	/* keyboard */
 	int repeat_rate;
 	int repeat_delay;
@@ -117,6 +162,7 @@ struct rcxml {
 
 	struct {
 		int popuptime;
+		int transition_time;
 		int min_nr_workspaces;
 		char *prefix;
 		struct wl_list workspaces;  /* struct workspace.link */
@@ -129,7 +175,10 @@ struct rcxml {
 	struct {
 		bool show;
 		bool preview;
+		/* preview="snapshot", implies preview */
+		bool preview_snapshot;
 		bool outlines;
+		bool thumbnails;
 		uint32_t criteria;
 		struct wl_list fields;  /* struct window_switcher_field.link */
 	} window_switcher;
@@ -139,8 +188,25 @@ struct rcxml {
 
 extern struct rcxml rc;
 
+/* Groups of settings which are applied together on reconfigure */
+enum rcxml_section {
+	RCXML_SECTION_INPUT = 0,
+	RCXML_SECTION_MENU,
+	RCXML_SECTION_REGIONS,
+	RCXML_SECTION_RESIZE_INDICATOR,
+	RCXML_NR_SECTIONS
+};
+
 void rcxml_parse_xml(struct buf *b);
 void rcxml_read(const char *filename);
 void rcxml_finish(void);
 
+/**
+ * rcxml_section_hash() - hash of the current values of a section and of
+ * the environment variables it depends on
+ * @section: section
+ * @hash: initial value, e.g. HASH_INIT, to combine with other inputs
+ */
+uint64_t rcxml_section_hash(enum rcxml_section section, uint64_t hash);
+
 #endif /* LABWC_RCXML_H */
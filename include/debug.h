@@ -6,4 +6,26 @@ struct server;
 
 void debug_dump_scene(struct server *server);
 
+/**
+ * debug_dump_scene_stats - print statistics of the whole scene graph
+ * @server: server whose scene is inspected
+ *
+ * Unlike debug_dump_scene() no subtree is skipped. The output is one
+ * "name{labels} value" line per sample so that dumps of a long running
+ * session can be compared with simple scripts.
+ */
+void debug_dump_scene_stats(struct server *server);
+void debug_dump_frame_stats(struct server *server);
+void debug_dump_buffers(void);
+
+/**
+ * debug_toggle_damage - start or stop highlighting damage
+ * @server: server whose outputs are affected
+ *
+ * While enabled, the damaged region of each frame is tinted and fades out
+ * over the following frames, and the damage of every frame is logged.
+ * Same as WLR_SCENE_DEBUG_DAMAGE=highlight but switchable at runtime.
+ */
+void debug_toggle_damage(struct server *server);
+
 #endif /* LABWC_DEBUG_H */
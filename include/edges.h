@@ -91,6 +91,10 @@ struct edge {
  * the given current or target values directly to the opposing and aligned edge
  * without regard for rc.gap.
  *
+ * Only views with an edge within rc.window_edge_strength (plus rc.gap) of the
+ * path of a moving edge are passed to the validator by edges_find_neighbors,
+ * so validators must not accept edges further away than that.
+ *
  * Any edge may take the values INT_MIN or INT_MAX to indicate that the edge
  * should be effectively ignored. Should the validator decide that a given
  * region edge (oppose or align) should be a preferred snap point, it should
@@ -120,5 +124,46 @@ void edges_adjust_resize_geom(struct view *view, struct border edges,
 
 bool edges_traverse_edge(struct edge current, struct edge target, struct edge edge);
 
+/**
+ * edges_calculate_visibility - update view->edges_visible of all views
+ * @ignored_view: view which is not considered to cover any other view
+ *
+ * The result is retained until edges_invalidate() is called,
+ * so that repeated calls without intervening stacking or geometry changes
+ * are cheap.
+ */
 void edges_calculate_visibility(struct server *server, struct view *ignored_view);
+
+/**
+ * edges_calculate_occlusion - update view->occluded of all views
+ *
+ * A view is occluded if it is completely covered by the opaque regions
+ * of the views rendered on top of it or lies outside of all usable
+ * outputs. Like the edge
+ * visibility, the result is retained until edges_invalidate() is called.
+ */
+void edges_calculate_occlusion(struct server *server);
+
+/**
+ * edges_invalidate - discard retained edge visibility and edge index
+ * @view: view which has been moved, restacked, mapped or unmapped, or
+ *	  NULL for changes affecting all views (workspace switch, output
+ *	  layout change, view destruction)
+ *
+ * Changes to the view ignored by the last edges_calculate_visibility()
+ * do not affect the visibility of other views and are therefore skipped,
+ * the occlusion state is always discarded.
+ * A few changed views are tracked individually by the edge index used by
+ * edges_find_neighbors() before it is rebuilt from scratch.
+ */
+void edges_invalidate(struct server *server, struct view *view);
+
+/**
+ * edges_view_commit - discard the occlusion state if the opaque region
+ * of the view changed, to be called on commits of its main surface
+ */
+void edges_view_commit(struct view *view);
+
+/* edges_finish - free the edge index */
+void edges_finish(struct server *server);
 #endif /* LABWC_EDGES_H */
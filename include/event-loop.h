@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_EVENT_LOOP_H
+#define LABWC_EVENT_LOOP_H
+
+struct server;
+struct wl_display;
+
+/*
+ * Input-priority dispatch
+ *
+ * Everything normally shares the single event loop of the wl_display, so
+ * when clients flood it with requests, libinput events wait behind them
+ * and the pointer lags. The libinput backend is therefore moved onto an
+ * event loop of its own which is checked first on every iteration. Input
+ * handlers (cursor, keyboard, touch, ...) consequently run before any
+ * pending client requests.
+ */
+
+/**
+ * event_loop_init - move the libinput backend onto the input loop
+ * Must be called after the backend has been created but before it is
+ * started. Without a libinput backend (nested sessions) this is a no-op.
+ */
+void event_loop_init(struct server *server);
+
+/* event_loop_finish - to be called after the wl_display is destroyed */
+void event_loop_finish(void);
+
+/* event_loop_run - replacement for wl_display_run() */
+void event_loop_run(struct wl_display *display);
+
+/* event_loop_terminate - replacement for wl_display_terminate() */
+void event_loop_terminate(struct wl_display *display);
+
+#endif /* LABWC_EVENT_LOOP_H */
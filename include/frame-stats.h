@@ -0,0 +1,136 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_FRAME_STATS_H
+#define LABWC_FRAME_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Number of frames kept for percentile calculation, ~4s at 60Hz */
+#define FRAME_STATS_NR_SAMPLES (256)
+/* Number of presented frames tracked in frame_stats.recent_missed */
+#define FRAME_STATS_NR_RECENT (64)
+
+enum frame_stats_phase {
+	FRAME_STATS_BUILD_STATE = 0,
+	FRAME_STATS_COMMIT,
+	FRAME_STATS_FRAME_DONE,
+	FRAME_STATS_NR_PHASES
+};
+
+/*
+ * Per-output frame timing statistics
+ *
+ * The durations of the most recent FRAME_STATS_NR_SAMPLES frames are kept in
+ * a ring buffer so that percentiles can be calculated on demand without any
+ * allocations in the render path.
+ */
+/*
+ * Outcome of frames committed while a fullscreen view is shown on the
+ * output: either the client buffer was scanned out directly, or the
+ * reason why not. FRAME_STATS_SCANOUT_REFUSED means that nothing of
+ * labwc itself was in the way, so the client buffer, another client
+ * surface or the backend prevented it.
+ */
+enum frame_stats_scanout {
+	FRAME_STATS_SCANOUT_DIRECT = 0,
+	FRAME_STATS_SCANOUT_BLOCKED_OSD,
+	FRAME_STATS_SCANOUT_BLOCKED_MENU,
+	FRAME_STATS_SCANOUT_BLOCKED_OVERLAY,
+	FRAME_STATS_SCANOUT_BLOCKED_TOP_LAYER,
+	FRAME_STATS_SCANOUT_REFUSED,
+	FRAME_STATS_SCANOUT_NR_RESULTS
+};
+
+struct frame_stats {
+	/* Durations in nanoseconds */
+	int64_t samples[FRAME_STATS_NR_PHASES][FRAME_STATS_NR_SAMPLES];
+	size_t head;	/* next slot to write */
+	size_t count;	/* number of valid slots */
+
+	uint64_t nr_frames;
+	uint64_t nr_missed_vblanks;
+
+	/* Bit per recently presented frame, set if it missed its vblank */
+	uint64_t recent_missed;
+	int nr_recent_missed;
+
+	/* Frames with a fullscreen view, by enum frame_stats_scanout */
+	uint64_t nr_scanout[FRAME_STATS_SCANOUT_NR_RESULTS];
+	bool has_scanout_result;
+	enum frame_stats_scanout last_scanout;
+
+	/* Frames with a visible cursor, on the cursor plane or composited */
+	uint64_t nr_cursor_hardware;
+	uint64_t nr_cursor_software;
+	bool has_cursor_result;
+	bool last_cursor_hardware;
+
+	/* Set after a successful commit until it has been presented */
+	bool awaiting_present;
+	int64_t last_commit_nsec;
+};
+
+/**
+ * frame_stats_add() - record timings of a successfully committed frame
+ * @stats: frame statistics of output
+ * @committed_at: CLOCK_MONOTONIC time (nsec) at which the commit finished
+ * @duration: time spent in each phase (nsec)
+ */
+void frame_stats_add(struct frame_stats *stats, int64_t committed_at,
+	const int64_t duration[FRAME_STATS_NR_PHASES]);
+
+/**
+ * frame_stats_presented() - handle presentation feedback of an output
+ * @stats: frame statistics of output
+ * @presented_at: CLOCK_MONOTONIC time (nsec) at which the frame was shown
+ * @refresh_nsec: refresh period of the output, 0 if unknown
+ *
+ * A vblank is considered missed if the time between finishing the commit
+ * and the frame actually being presented exceeds one refresh period.
+ */
+void frame_stats_presented(struct frame_stats *stats, int64_t presented_at,
+	int64_t refresh_nsec);
+
+/**
+ * frame_stats_scanout() - record direct scanout outcome of a frame
+ * @stats: frame statistics of output
+ * @result: outcome of a frame committed with a fullscreen view
+ *
+ * Changes of the outcome are logged at debug level.
+ */
+void frame_stats_scanout(struct frame_stats *stats,
+	enum frame_stats_scanout result);
+
+/**
+ * frame_stats_cursor() - record whether the cursor used the cursor plane
+ * @stats: frame statistics of output
+ * @hardware: true if the cursor of a frame was shown on the cursor plane,
+ *            false if it had to be composited into the frame
+ *
+ * Return: true if the outcome differs from the previous frame
+ */
+bool frame_stats_cursor(struct frame_stats *stats, bool hardware);
+
+/**
+ * frame_stats_percentile() - get percentile of recorded durations
+ * @stats: frame statistics of output
+ * @phase: phase to calculate percentile for
+ * @percentile: percentile in the range 0..100
+ *
+ * Return: duration in nanoseconds or 0 if no frames have been recorded
+ */
+int64_t frame_stats_percentile(const struct frame_stats *stats,
+	enum frame_stats_phase phase, int percentile);
+
+/* frame_stats_phase_name() - short name of @phase, e.g. "commit" */
+const char *frame_stats_phase_name(enum frame_stats_phase phase);
+
+/**
+ * frame_stats_print() - print summary of frame statistics to stdout
+ * @stats: frame statistics of output
+ * @name: name of output
+ */
+void frame_stats_print(const struct frame_stats *stats, const char *name);
+
+#endif /* LABWC_FRAME_STATS_H */
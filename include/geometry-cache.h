@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_GEOMETRY_CACHE_H
+#define LABWC_GEOMETRY_CACHE_H
+
+#include <stdbool.h>
+
+struct server;
+struct view;
+
+/*
+ * Remembered window geometry
+ *
+ * With <placement><rememberGeometry> enabled, the floating geometry and
+ * output of a window are remembered by app_id when it is closed. The next
+ * window of that app_id is mapped right there instead of being placed by
+ * the placement policy. The most recently used entries are kept in
+ * $XDG_STATE_HOME/labwc/geometry, which is read once at startup and
+ * written by a worker thread shortly after changes.
+ */
+
+void geometry_cache_init(struct server *server);
+
+/* geometry_cache_finish - write pending changes and wait for the writer */
+void geometry_cache_finish(void);
+
+/* geometry_cache_save - remember the geometry of a view about to go away */
+void geometry_cache_save(struct view *view);
+
+/**
+ * geometry_cache_place - move a newly mapped view to its remembered place
+ * Returns false if nothing is remembered for the view or the remembered
+ * geometry does not fit the output anymore.
+ */
+bool geometry_cache_place(struct view *view);
+
+#endif /* LABWC_GEOMETRY_CACHE_H */
@@ -65,6 +65,15 @@ struct cursor_context {
  */
 struct cursor_context get_cursor_context(struct server *server);
 
+/**
+ * cursor_context_invalidate - drop the cached result of get_cursor_context()
+ * @server - server
+ *
+ * Must be called whenever the scene changes in a way that may result in a
+ * different node being found for the same cursor position.
+ */
+void cursor_context_invalidate(struct server *server);
+
 /**
  * cursor_set - set cursor icon
  * @seat - current seat
@@ -118,6 +127,24 @@ void cursor_update_focus(struct server *server);
  */
 void cursor_update_image(struct seat *seat);
 
+/**
+ * cursor_load_scales - load the cursor theme for the scales of all outputs
+ * @seat - seat
+ *
+ * wlroots otherwise loads a theme from disk the first time a cursor image
+ * is shown on an output with a new scale, which stalls the motion.
+ */
+void cursor_load_scales(struct seat *seat);
+
+/**
+ * cursor_flush_motion - process coalesced pointer motion right away
+ * @seat - seat
+ *
+ * Must be called before handling any input event other than pointer
+ * motion, so that it sees the focus and cursor position the user sees.
+ */
+void cursor_flush_motion(struct seat *seat);
+
 void cursor_init(struct seat *seat);
 void cursor_load(struct seat *seat);
 void cursor_emulate_move_absolute(struct seat *seat,
@@ -2,8 +2,30 @@
 #ifndef LABWC_GESTURES_H
 #define LABWC_GESTURES_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 struct seat;
 
+enum gesture_type {
+	LAB_GESTURE_NONE = 0,
+	LAB_GESTURE_SWIPE,
+	LAB_GESTURE_PINCH,
+};
+
+/* State of a gesture recognized by the compositor, see gestures.c */
+struct gesture_tracker {
+	/* LAB_GESTURE_NONE while gestures are forwarded to clients */
+	enum gesture_type type;
+	uint32_t fingers;
+	double dx, dy;
+	double scale;
+	/* Smoothed speed in units per ms */
+	double velocity;
+	uint32_t last_time_msec;
+	bool triggered;
+};
+
 void gestures_init(struct seat *seat);
 void gestures_finish(struct seat *seat);
 
@@ -32,6 +32,23 @@ struct input_method_relay {
 	struct wlr_input_popup_surface_v2 *popup_surface;
 	struct wlr_scene_tree *popup_tree;
 
+	/*
+	 * Last applied popup placement. The popup is only moved and the
+	 * text-input rectangle only resent when one of its inputs changes.
+	 */
+	struct {
+		bool valid;
+		struct wlr_box cursor_rect; /* layout coordinates */
+		int width, height;
+	} popup_placement;
+
+	/*
+	 * Box of the output constraining the popup, cached for the focused
+	 * surface until the focus or the output layout changes.
+	 */
+	struct wlr_box output_box;
+	bool output_box_valid;
+
 	struct wl_listener new_text_input;
 	struct wl_listener new_input_method;
 
@@ -52,6 +69,18 @@ struct text_input {
 	struct wlr_text_input_v3 *input;
 	struct wl_list link;
 
+	/* State last sent to the input-method, see send_state_to_input_method() */
+	struct {
+		bool valid;
+		uint32_t features;
+		uint32_t surrounding_hash;
+		uint32_t cursor;
+		uint32_t anchor;
+		uint32_t text_change_cause;
+		uint32_t hint;
+		uint32_t purpose;
+	} sent;
+
 	struct wl_listener enable;
 	struct wl_listener commit;
 	struct wl_listener disable;
@@ -77,6 +106,9 @@ struct input_method_relay *input_method_relay_create(struct seat *seat);
 
 void input_method_relay_finish(struct input_method_relay *relay);
 
+/* Drops cached output geometry after the output layout has changed */
+void input_method_relay_output_layout_changed(struct input_method_relay *relay);
+
 /* Updates currently focused surface. Surface must belong to the same seat. */
 void input_method_relay_set_focus(struct input_method_relay *relay,
 	struct wlr_surface *surface);
@@ -7,6 +7,7 @@
 
 struct seat;
 struct keyboard;
+struct view;
 struct wlr_keyboard;
 
 void keyboard_configure(struct seat *seat, struct wlr_keyboard *kb,
@@ -18,6 +19,14 @@ void keyboard_group_finish(struct seat *seat);
 void keyboard_setup_handlers(struct keyboard *keyboard);
 void keyboard_set_numlock(struct wlr_keyboard *keyboard);
 void keyboard_update_layout(struct seat *seat, xkb_layout_index_t layout);
+
+/*
+ * Per-window layouts: the group is saved when a view is deactivated and
+ * restored when it is activated again. Nothing is sent to clients if the
+ * group does not change.
+ */
+void keyboard_save_layout(struct seat *seat, struct view *view);
+void keyboard_restore_layout(struct seat *seat, struct view *view);
 void keyboard_cancel_keybind_repeat(struct keyboard *keyboard);
 bool keyboard_any_modifiers_pressed(struct wlr_keyboard *keyboard);
 
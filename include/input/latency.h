@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_INPUT_LATENCY_H
+#define LABWC_INPUT_LATENCY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+struct wlr_output;
+struct wlr_surface;
+
+/* Bucket 0 is below 1ms, bucket n covers [2^(n-1), 2^n) ms, the last more */
+#define INPUT_LATENCY_NR_BUCKETS (12)
+
+/*
+ * Input-to-commit latency of a seat
+ *
+ * Measured from the timestamp of an input event to the first output commit
+ * after the surface focused at that time has committed new damage. While
+ * an earlier input has not been shown yet, further input does not restart
+ * the measurement, so the samples are what the user perceives as lag.
+ */
+struct input_latency {
+	/* CLOCK_MONOTONIC time of the oldest input not shown yet, or 0 */
+	int64_t input_nsec;
+	struct wlr_surface *surface;
+	bool surface_damaged;
+	struct wl_listener surface_commit;
+	struct wl_listener surface_destroy;
+
+	uint64_t buckets[INPUT_LATENCY_NR_BUCKETS];
+	uint64_t nr_samples;
+	int64_t total_nsec;
+	int64_t max_nsec;
+};
+
+void input_latency_init(struct input_latency *latency);
+void input_latency_finish(struct input_latency *latency);
+
+/**
+ * input_latency_event() - note an input event
+ * @latency: latency of the seat receiving the event
+ * @surface: surface with the focus relevant to the event, may be NULL
+ * @time_msec: timestamp of the event as provided by the input device
+ */
+void input_latency_event(struct input_latency *latency,
+	struct wlr_surface *surface, uint32_t time_msec);
+
+/**
+ * input_latency_output_commit() - take a sample if the input is now shown
+ * @latency: latency of a seat
+ * @output: output which has successfully committed a frame
+ * @committed_at: CLOCK_MONOTONIC time (nsec) at which the commit finished
+ */
+void input_latency_output_commit(struct input_latency *latency,
+	struct wlr_output *output, int64_t committed_at);
+
+/**
+ * input_latency_print() - print histogram of the samples to stdout
+ * @latency: latency of a seat
+ * @name: name of the seat
+ */
+void input_latency_print(const struct input_latency *latency,
+	const char *name);
+
+#endif /* LABWC_INPUT_LATENCY_H */
@@ -2,6 +2,8 @@
 #ifndef LABWC_TABLET_H
 #define LABWC_TABLET_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <wayland-server-core.h>
 
 struct seat;
@@ -12,6 +14,13 @@ struct drawing_tablet {
 	struct seat *seat;
 	struct wlr_tablet *tablet;
 	double x, y;
+	/* Tablet area and rotation as 2x3 matrix, row major */
+	double transform[6];
+
+	/* Cursor motion deferred until the event loop is idle */
+	bool motion_pending;
+	uint32_t motion_time_msec;
+	struct wl_event_source *motion_idle;
 	struct {
 		struct wl_listener axis;
 		struct wl_listener tip;
@@ -23,4 +32,7 @@ struct drawing_tablet {
 
 void tablet_init(struct seat *seat, struct wlr_input_device *wlr_input_device);
 
+/* Apply changes of the tablet area and rotation */
+void tablet_reconfigure(struct wlr_input_device *wlr_input_device);
+
 #endif /* LABWC_TABLET_H */
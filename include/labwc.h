@@ -40,13 +40,18 @@
 #include <wlr/types/wlr_virtual_pointer_v1.h>
 #include <wlr/types/wlr_virtual_keyboard_v1.h>
 #include <wlr/types/wlr_tearing_control_v1.h>
+#include <wlr/types/wlr_content_type_v1.h>
 #include <wlr/types/wlr_text_input_v3.h>
 #include <wlr/types/wlr_input_method_v2.h>
 #include <wlr/util/log.h>
 #include "config/keybind.h"
+#include "adaptive-sync.h"
 #include "config/rcxml.h"
+#include "frame-stats.h"
 #include "input/cursor.h"
+#include "input/gestures.h"
 #include "input/ime.h"
+#include "input/latency.h"
 #include "overlay.h"
 #include "regions.h"
 #include "session-lock.h"
@@ -90,13 +95,16 @@ struct keyboard {
 	/* key repeat for compositor keybinds */
 	uint32_t keybind_repeat_keycode;
 	int32_t keybind_repeat_rate;
-	struct wl_event_source *keybind_repeat;
+	int64_t keybind_repeat_start; /* CLOCK_MONOTONIC nsec of first repeat */
+	struct lab_timer *keybind_repeat;
 };
 
 struct seat {
 	struct wlr_seat *seat;
 	struct server *server;
 	struct wlr_keyboard_group *keyboard_group;
+	/* Incremented on keymap changes, invalidating saved layout groups */
+	uint32_t keymap_generation;
 
 	struct wl_list touch_points; /* struct touch_point.link */
 
@@ -108,12 +116,30 @@ struct seat {
 	enum lab_cursors server_cursor;
 	struct wlr_cursor *cursor;
 	struct wlr_xcursor_manager *xcursor_manager;
+	/*
+	 * Set while touch input drives the cursor. Nobody sees the cursor
+	 * then, so its image is hidden and neither the image nor the hover
+	 * state of SSD buttons are updated until a pointer or tablet tool
+	 * moves it again.
+	 */
+	bool cursor_hidden;
 	struct {
 		double x, y;
 	} smooth_scroll_offset;
 
+	/*
+	 * Scroll mousebinds are evaluated at most once per pointer frame
+	 * and axis, indexed by enum wlr_axis_orientation
+	 */
+	struct {
+		bool evaluated;
+		bool handled;
+	} scroll_frame[2];
+
 	struct wlr_pointer_constraint_v1 *current_constraint;
 
+	struct input_latency input_latency;
+
 	/* In support for ToggleKeybinds */
 	uint32_t nr_inhibited_keybind_views;
 
@@ -160,6 +186,19 @@ struct seat {
 		struct wlr_scene_tree *icons;
 	} drag;
 
+	/*
+	 * Result of the most recent get_cursor_context() call. Repeated
+	 * queries at the same cursor position are answered from here until
+	 * the scene changes or the event loop goes idle.
+	 */
+	struct {
+		bool valid;
+		double x, y;
+		struct cursor_context ctx;
+		struct wl_listener node_destroy;
+		struct wl_event_source *idle;
+	} cursor_context_cache;
+
 	struct overlay overlay;
 	/* Used to prevent region snapping when starting a move with A-Left */
 	bool region_prevent_snap;
@@ -175,7 +214,14 @@ struct seat {
 	struct wl_listener cursor_axis;
 	struct wl_listener cursor_frame;
 
+	/* Coalesced pointer motion, see preprocess_cursor_motion() */
+	struct {
+		struct wl_event_source *idle;
+		uint32_t time_msec;
+	} pending_motion;
+
 	struct wlr_pointer_gestures_v1 *pointer_gestures;
+	struct gesture_tracker gesture;
 	struct wl_listener pinch_begin;
 	struct wl_listener pinch_update;
 	struct wl_listener pinch_end;
@@ -203,7 +249,9 @@ struct seat {
 	struct wl_listener virtual_keyboard_new;
 };
 
+struct edges_index;
 struct lab_data_buffer;
+struct placement_cache;
 struct workspace;
 
 struct server {
@@ -211,6 +259,8 @@ struct server {
 	struct wl_event_loop *wl_event_loop;  /* Can be used for timer events */
 	struct wlr_renderer *renderer;
 	struct wlr_allocator *allocator;
+	/* NULL if the renderer cannot import dmabufs */
+	struct wlr_linux_dmabuf_v1 *linux_dmabuf;
 	struct wlr_backend *backend;
 	struct headless {
 		struct wlr_backend *backend;
@@ -240,7 +290,15 @@ struct server {
 	struct wl_listener xdg_activation_request;
 
 	struct wl_list views;
+	/* Secondary lists of views by scene tree, see view.layer_link */
+	struct wl_list views_always_on_top;
+	struct wl_list views_always_on_bottom;
+	/* Last stacking order keys handed out, see view.stack_seq */
+	int64_t views_front_seq;
+	int64_t views_back_seq;
 	struct wl_list unmanaged_surfaces;
+	/* Mapped unmanaged surfaces wanting focus, most recent last */
+	struct wl_list unmanaged_focus_stack;
 
 	struct seat seat;
 	struct wlr_scene *scene;
@@ -252,6 +310,20 @@ struct server {
 	double grab_x, grab_y;
 	struct wlr_box grab_box;
 	uint32_t resize_edges;
+	/* Cursor moved since the grabbed view was last moved/resized */
+	bool grab_update_pending;
+
+	/*
+	 * Retained results of edges_calculate_visibility() and
+	 * edges_calculate_occlusion()
+	 */
+	struct {
+		bool valid;
+		struct view *ignored_view;
+		bool occlusion_valid;
+	} edges_visibility;
+	/* Sorted view edges for edges_find_neighbors(), see edges.c */
+	struct edges_index *edges_index;
 
 	/*
 	 * 'active_view' is generally the view with keyboard-focus, updated with
@@ -282,6 +354,8 @@ struct server {
 	/* Tree for all non-layer xdg/xwayland-shell surfaces with always-on-top/below */
 	struct wlr_scene_tree *view_tree_always_on_top;
 	struct wlr_scene_tree *view_tree_always_on_bottom;
+	/* Window switcher preview and outlines, above all views */
+	struct wlr_scene_tree *osd_preview_tree;
 #if HAVE_XWAYLAND
 	/* Tree for unmanaged xsurfaces without initialized view (usually popups) */
 	struct wlr_scene_tree *unmanaged_tree;
@@ -293,10 +367,33 @@ struct server {
 	struct wl_list workspaces;  /* struct workspace.link */
 	struct workspace *workspace_current;
 	struct workspace *workspace_last;
+	/* Animated workspace switch, see workspaces.c */
+	struct workspace_transition {
+		struct workspace *from; /* NULL if not animating */
+		int64_t start_nsec;
+		int64_t last_step_nsec;
+		int64_t duration_nsec;
+		/* Layout pixels the new workspace slides in from */
+		int distance;
+		struct wl_event_source *timer;
+	} workspace_transition;
 
 	struct wl_list outputs;
 	struct wl_listener new_output;
+	/* Known-good state per monitor, see output-state-cache.h */
+	struct wl_list output_state_cache;
 	struct wlr_output_layout *output_layout;
+	/* Lookup tables over the outputs, see output.c */
+	struct output_index *output_index;
+	/* Open batch of xdg-shell configure requests, see view.h */
+	struct configure_batch *configure_batch;
+	/*
+	 * Pending follow-up of usable area changes (XWayland workarea and
+	 * view re-arrangement), run once the event loop goes idle.
+	 */
+	struct wl_event_source *usable_area_idle;
+	/* Bumped whenever the output layout or a usable area changes */
+	uint32_t usable_area_generation;
 
 	struct wl_listener output_layout_change;
 	struct wlr_output_manager_v1 *output_manager;
@@ -310,6 +407,14 @@ struct server {
 	 * do_output_layout_change() must be called explicitly.
 	 */
 	int pending_output_layout_change;
+	/*
+	 * do_output_layout_change() only schedules the actual update, so
+	 * that several changes within one event loop iteration (e.g. when
+	 * docking with multiple monitors) are handled at once.
+	 */
+	struct wl_event_source *output_layout_change_idle;
+	/* Repaints of all outputs due at once, see <core><batchOutputFrames> */
+	struct wl_event_source *output_repaint_idle;
 
 	struct wlr_gamma_control_manager_v1 *gamma_control_manager_v1;
 	struct wl_listener gamma_control_set_gamma;
@@ -331,6 +436,9 @@ struct server {
 	struct wlr_tearing_control_manager_v1 *tearing_control;
 	struct wl_listener tearing_new_object;
 
+	/* Queried on demand, see view_get_content_type() */
+	struct wlr_content_type_manager_v1 *content_type_manager;
+
 	struct wlr_input_method_manager_v2 *input_method_manager;
 	struct wlr_text_input_manager_v3 *text_input_manager;
 
@@ -341,9 +449,32 @@ struct server {
 		struct wlr_scene_node *preview_node;
 		struct wlr_scene_tree *preview_parent;
 		struct wlr_scene_node *preview_anchor;
+		/* Shows a snapshot instead with <windowSwitcher preview="snapshot"> */
+		struct wlr_scene_buffer *preview_snapshot;
 		struct multi_rect *preview_outline;
+		/* Window switcher candidates, see osd_cycle_views() */
+		struct wl_array views;
+		bool views_valid;
+		/* Position of cycle_view in views, only a hint */
+		size_t cycle_index;
+		/* Refreshes thumbnails which are outdated, see osd.c */
+		struct wl_event_source *thumbnail_timer;
 	} osd_state;
 
+	/* Overview of the current workspace, see overview.h */
+	struct {
+		struct wlr_scene_tree *tree; /* NULL if not shown */
+		struct wl_array items; /* struct overview_item */
+		struct wl_event_source *timer;
+		bool pressed;
+	} overview;
+
+	/* Window switcher snapshots, see thumbnail.h */
+	struct {
+		struct wl_list lru; /* struct thumbnail.link */
+		size_t bytes;
+	} thumbnails;
+
 	struct theme *theme;
 
 	struct menu *menu_current;
@@ -359,21 +490,99 @@ struct output {
 	struct server *server;
 	struct wlr_output *wlr_output;
 	struct wlr_scene_output *scene_output;
+	/* Smallest number not used by another output, see view->outputs */
+	size_t index;
 	struct wlr_scene_tree *layer_tree[LAB_NR_LAYERS];
 	struct wlr_scene_tree *layer_popup_tree;
 	struct wlr_scene_tree *osd_tree;
 	struct wlr_scene_tree *session_lock_tree;
-	struct wlr_scene_buffer *workspace_osd;
+
+	/* Retained workspace switcher OSD, see workspaces.c */
+	struct workspace_osd {
+		struct wlr_scene_tree *tree;
+		struct wlr_scene_rect *highlight;
+		struct wl_array labels; /* struct scaled_font_buffer * */
+		int width;
+		int height;
+	} workspace_osd;
 	struct wlr_box usable_area;
+	/* Position in the output layout, updated on layout changes */
+	struct wlr_box layout_box;
 
 	struct wl_list regions;  /* struct region.link */
-
-	struct lab_data_buffer *osd_buffer;
+	struct region_grid region_grid;
+
+	/* Retained window switcher scene, see osd.c */
+	struct osd_scene {
+		struct wlr_scene_tree *tree;
+		struct wlr_scene_tree *highlight;
+		struct wl_array items; /* struct osd_scene_item, one per row */
+		size_t first; /* index of the view shown in the first row */
+		int width;
+		int height;
+	} osd_scene;
+
+	/* Overlap bitmap kept between smart placements, see placement.c */
+	struct placement_cache *placement_cache;
+
+	/* Snap-to-edge trigger strips, see interactive.c */
+	struct {
+		/* Valid while both match, range is never 0 once computed */
+		uint32_t generation;
+		int range;
+		/* Usable area in layout coordinates */
+		struct wlr_box usable;
+		/* Cursor beyond these in layout coordinates is on a strip */
+		int left, right, top, bottom;
+		/* Another output lies beyond the edge, indexed by view_edge */
+		bool adjacent[VIEW_EDGE_CENTER + 1];
+	} snap_edges;
+
+	/* Zoom around the cursor, see magnifier.c */
+	struct {
+		struct wlr_buffer *buffers[3];
+		/* In buffer coordinates, empty if not zoomed */
+		struct wlr_fbox source;
+		/* The source box changed with the current frame */
+		bool moved;
+	} magnifier;
 
 	struct wl_listener destroy;
 	struct wl_listener frame;
+	struct wl_listener present;
+	struct wl_listener commit;
 	struct wl_listener request_state;
 
+	struct frame_stats frame_stats;
+	struct adaptive_sync adaptive_sync;
+
+	/* Automatic tearing for fullscreen views, see tearing.c */
+	struct {
+		struct view *view; /* only compared, never dereferenced */
+		uint64_t start_frame;
+		bool enabled;
+	} tearing;
+
+	/* Used for delayed repaints, see <maxRenderTime> */
+	struct wl_event_source *repaint_timer;
+	int64_t delayed_frame_done_nsec;
+	/* The timer is armed, frame events are ignored until it expires */
+	bool repaint_delayed;
+	/* The timer expired, the next frame event repaints right away */
+	bool repaint_due;
+	/* <maxRenderTime>auto</maxRenderTime>, refreshed every few frames */
+	struct {
+		int msec;
+		uint64_t nr_frames; /* frame_stats.nr_frames when computed */
+	} auto_render_time;
+	/* Waiting for server->output_repaint_idle */
+	bool repaint_batched;
+	int64_t batched_frame_done_nsec;
+	int64_t last_present_nsec;
+	int64_t refresh_nsec;
+	/* Last time throttled views were sent frame-done events */
+	int64_t throttled_frame_done_nsec;
+
 	bool leased;
 	bool gamma_lut_changed;
 };
@@ -389,8 +598,30 @@ struct constraint {
 void xdg_popup_create(struct view *view, struct wlr_xdg_popup *wlr_popup);
 void xdg_shell_init(struct server *server);
 
+enum foreign_toplevel_change {
+	FOREIGN_TOPLEVEL_TITLE = 1 << 0,
+	FOREIGN_TOPLEVEL_APP_ID = 1 << 1,
+	FOREIGN_TOPLEVEL_STATE = 1 << 2,
+	FOREIGN_TOPLEVEL_OUTPUTS = 1 << 3,
+	/* Relay all outputs rather than those entered and left */
+	FOREIGN_TOPLEVEL_ALL_OUTPUTS = 1 << 4,
+};
+
 void foreign_toplevel_handle_create(struct view *view);
-void foreign_toplevel_update_outputs(struct view *view);
+
+/*
+ * foreign_toplevel_queue_update - relay @changes of @view to taskbars
+ *
+ * Changes are collected and sent once per event loop iteration, taking
+ * the then current title, app_id, state and outputs of the view. Values
+ * that ended up unchanged are not sent at all, so a taskbar redraws once
+ * per view rather than after every single event.
+ */
+void foreign_toplevel_queue_update(struct view *view,
+	enum foreign_toplevel_change changes);
+
+/* foreign_toplevel_set_activated - as the state is not kept by the view */
+void foreign_toplevel_set_activated(struct view *view, bool activated);
 
 /*
  * desktop.c routines deal with a collection of views
@@ -480,26 +711,71 @@ void seat_output_layout_changed(struct seat *seat);
 void interactive_begin(struct view *view, enum input_mode mode, uint32_t edges);
 void interactive_finish(struct view *view);
 void interactive_cancel(struct view *view);
+/*
+ * Interactive moves and resizes follow the cursor once per output frame
+ * rather than on every motion event: interactive_schedule_update()
+ * records the motion, interactive_flush_update() moves or resizes the
+ * view to match the latest cursor position. A resize is held back while
+ * the client has not acked the previous configure;
+ * interactive_configure_done() lets it through once it has.
+ */
+void interactive_schedule_update(struct server *server);
+void interactive_flush_update(struct server *server);
+void interactive_configure_done(struct view *view);
 /* Possibly returns VIEW_EDGE_CENTER if <topMaximize> is yes */
 enum view_edge edge_from_cursor(struct seat *seat, struct output **dest_output);
+/* Returns true if another output lies entirely beyond @edge of @output */
+bool edge_has_adjacent_output(struct output *output, enum view_edge edge);
+/* Returns the box a view snapped to @edge of @output would take */
+struct wlr_box edge_get_snap_box(struct output *output, enum view_edge edge);
 
 void output_init(struct server *server);
 void output_manager_init(struct server *server);
 struct output *output_from_wlr_output(struct server *server,
 	struct wlr_output *wlr_output);
 struct output *output_from_name(struct server *server, const char *name);
+/* Returns the <outputs><output> entry for @name, which may be NULL */
+struct output_config *output_config_for_name(const char *name);
+/* Returns the output at layout coordinates (@lx, @ly), or NULL */
+struct output *output_at(struct server *server, double lx, double ly);
 struct output *output_nearest_to(struct server *server, int lx, int ly);
 struct output *output_nearest_to_cursor(struct server *server);
 bool output_is_usable(struct output *output);
 void output_update_usable_area(struct output *output);
 void output_update_all_usable_areas(struct server *server, bool layout_changed);
+void output_finish(struct server *server);
 struct wlr_box output_usable_area_in_layout_coords(struct output *output);
 struct wlr_box output_usable_area_scaled(struct output *output);
 void handle_output_power_manager_set_mode(struct wl_listener *listener,
 	void *data);
 void output_enable_adaptive_sync(struct wlr_output *output, bool enabled);
+
+/**
+ * output_get_fullscreen_view() - get the topmost fullscreen view of an
+ * output on the current workspace
+ * @output: output to search
+ *
+ * Return: the view or NULL if there is none
+ */
+struct view *output_get_fullscreen_view(struct output *output);
 void new_tearing_hint(struct wl_listener *listener, void *data);
 
+/*
+ * view_get_content_type() - what the surface of @view shows according
+ * to wp-content-type-v1, WP_CONTENT_TYPE_V1_TYPE_NONE if not told
+ */
+enum wp_content_type_v1_type view_get_content_type(struct view *view);
+
+/**
+ * tearing_allowed() - check whether the next frame of an output may tear
+ * @output: output about to be committed
+ *
+ * Tearing is considered for the fullscreen view of @output or, if there
+ * is none, the active view when it is on @output. This allows several
+ * outputs each showing a fullscreen game to tear at the same time.
+ */
+bool tearing_allowed(struct output *output);
+
 void server_init(struct server *server);
 void server_start(struct server *server);
 void server_finish(struct server *server);
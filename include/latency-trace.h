@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_LATENCY_TRACE_H
+#define LABWC_LATENCY_TRACE_H
+
+#include <stdint.h>
+
+struct wl_event_loop;
+struct wl_listener;
+
+/*
+ * Event loop latency tracing
+ *
+ * Disabled unless the environment variable LABWC_LATENCY_TRACE is set to
+ * a threshold in milliseconds. Each dispatch of the main loop and each
+ * traced handler taking longer than that is logged with its name. The
+ * most recent handler runs are kept in a ring buffer which is written to
+ * $XDG_RUNTIME_DIR/labwc-latency-<pid>.txt on SIGUSR1.
+ */
+
+/* latency_trace_init - enable tracing if LABWC_LATENCY_TRACE is set */
+void latency_trace_init(struct wl_event_loop *loop);
+void latency_trace_finish(void);
+
+/**
+ * latency_trace_begin - start timing a handler
+ * Returns a timestamp to be passed to latency_trace_end() or 0 if tracing
+ * is disabled.
+ */
+int64_t latency_trace_begin(void);
+
+/**
+ * latency_trace_end - record the time elapsed since latency_trace_begin()
+ * @name: name of the handler, must be a string literal
+ * @begin: return value of latency_trace_begin()
+ */
+void latency_trace_end(const char *name, int64_t begin);
+
+/*
+ * LATENCY_TRACE_LISTENER - define handler##_traced() timing @handler
+ *
+ * Use handler##_traced as notify function of a wl_listener to trace it
+ * without touching the early returns of @handler.
+ */
+#define LATENCY_TRACE_LISTENER(handler) \
+	static void handler##_traced(struct wl_listener *listener, void *data) \
+	{ \
+		int64_t begin = latency_trace_begin(); \
+		handler(listener, data); \
+		latency_trace_end(#handler, begin); \
+	}
+
+#endif /* LABWC_LATENCY_TRACE_H */
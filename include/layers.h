@@ -13,6 +13,8 @@ struct lab_layer_surface {
 	struct server *server;
 
 	bool mapped;
+	/* State of the last commit that caused an arrangement */
+	struct wlr_layer_surface_v1_state arranged_state;
 
 	struct wl_listener map;
 	struct wl_listener unmap;
@@ -0,0 +1,46 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_MAGNIFIER_H
+#define LABWC_MAGNIFIER_H
+
+#include <stdbool.h>
+
+struct output;
+struct server;
+
+/*
+ * Zooming into the output under the cursor
+ *
+ * The scene is rendered as usual and then drawn once more, scaled up
+ * from a source box around the cursor, into a buffer of the output's
+ * size which is committed instead. The point under the cursor stays in
+ * place, so the cursor keeps pointing at what it is over. The source
+ * box follows the cursor at most once per output frame, and damage of
+ * the scene is only acted upon where it is inside the source box.
+ */
+
+/**
+ * magnifier_zoom - zoom in or out by one step
+ * Zooming out of the first step turns the magnifier off.
+ */
+void magnifier_zoom(struct server *server, bool zoom_in);
+
+/* magnifier_on_cursor_motion - have the zoomed outputs follow the cursor */
+void magnifier_on_cursor_motion(struct server *server);
+
+/**
+ * magnifier_begin_frame - update the source box of @output before its
+ * scene is built
+ * Returns false if nothing visible changed and the frame can be skipped.
+ */
+bool magnifier_begin_frame(struct output *output);
+
+/**
+ * magnifier_render - replace the buffer in the pending state of @output,
+ * just built from the scene, by its zoomed version
+ * The regular frame is left in place if the zoomed one cannot be rendered.
+ */
+void magnifier_render(struct output *output);
+
+void magnifier_on_output_destroy(struct output *output);
+
+#endif /* LABWC_MAGNIFIER_H */
@@ -0,0 +1,30 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_MEMORY_PRESSURE_H
+#define LABWC_MEMORY_PRESSURE_H
+
+struct server;
+
+/*
+ * Memory pressure handling
+ *
+ * On kernels with pressure stall information, a trigger on
+ * /proc/pressure/memory is watched from the main event loop. Whenever
+ * tasks stall on memory for long enough, labwc gives back what it can
+ * recreate later: cached buffers of other output scales, hidden OSD
+ * scenes, decoded button images and free heap pages.
+ */
+
+/**
+ * memory_pressure_init - start watching memory pressure
+ * @server: server whose event loop is used
+ *
+ * Silently does nothing if PSI is not available.
+ */
+void memory_pressure_init(struct server *server);
+
+/* memory_pressure_trim - release caches as if under memory pressure */
+void memory_pressure_trim(struct server *server);
+
+void memory_pressure_finish(void);
+
+#endif /* LABWC_MEMORY_PRESSURE_H */
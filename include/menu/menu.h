@@ -29,8 +29,13 @@ struct menu_scene {
 
 struct menuitem {
 	struct wl_list actions;
+	char *text;
+	bool show_arrow;
 	char *execute;
 	char *id; /* needed for pipemenus */
+	char *search_text; /* lowercase text, NULL for separators */
+	bool search_match;
+	int cache_msec; /* pipemenus only, 0 if the output is not cached */
 	struct menu *parent;
 	struct menu *submenu;
 	bool selectable;
@@ -39,12 +44,14 @@ struct menuitem {
 	struct wlr_scene_tree *tree;
 	struct menu_scene normal;
 	struct menu_scene selected;
+	bool hidden; /* by the type-ahead search */
 	struct wl_list link; /* menu.menuitems */
 };
 
 /* This could be the root-menu or a submenu */
 struct menu {
 	char *id;
+	struct wl_list id_link; /* for menu_get_by_id() */
 	char *label;
 	int item_height;
 	struct menu *parent;
@@ -60,7 +67,28 @@ struct menu {
 		struct menuitem *item;
 	} selection;
 	struct wlr_scene_tree *scene_tree;
+	struct wlr_scene_tree *items_tree;
+	/*
+	 * Menus taller than the output show a scrollable window of their
+	 * items. Only the items in or near the window are enabled and have
+	 * font buffers, see menu_update_window().
+	 */
+	struct {
+		int offset; /* y of the topmost item shown */
+		int height;
+		int max_height; /* usable height of the output */
+	} window;
+	/* Font buffers of the items are only created once the menu is shown */
+	bool has_item_buffers;
+	/* Font buffers of items scrolled away, to be reused */
+	struct wlr_scene_tree *spare_tree;
+	struct wl_array spare_buffers; /* struct scaled_font_buffer * */
+	/* Word prefixes of the items, see menu_search_add() */
+	struct wl_array search_index; /* struct search_entry, sorted */
+	bool has_search_index;
 	bool is_pipemenu;
+	/* CLOCK_MONOTONIC time after which a cached pipemenu is destroyed */
+	int64_t cache_expiry_nsec;
 	enum menu_align align;
 
 	/* Used to match a window-menu to the view that triggered it. */
@@ -73,6 +101,27 @@ void menu_item_select_next(struct server *server);
 void menu_item_select_previous(struct server *server);
 void menu_submenu_enter(struct server *server);
 void menu_submenu_leave(struct server *server);
+
+/**
+ * menu_search_add - type-ahead search in the menu with keyboard selection
+ * @text: UTF-8 text typed by the user, usually a single character
+ *
+ * Only the items with a word starting with the text typed so far are
+ * shown and the first one is selected. Text which no item matches is
+ * ignored. The search ends when the keyboard selection moves to another
+ * menu or the menu is closed.
+ */
+void menu_search_add(struct server *server, const char *text);
+
+/* menu_search_delete - remove the last character typed */
+void menu_search_delete(struct server *server);
+
+/**
+ * menu_search_clear - end the type-ahead search, showing all items again
+ *
+ * Returns false if there was no search to end.
+ */
+bool menu_search_clear(struct server *server);
 bool menu_call_selected_actions(struct server *server);
 
 void menu_init(struct server *server);
@@ -103,6 +152,13 @@ void menu_open_root(struct menu *menu, int x, int y);
  */
 void menu_process_cursor_motion(struct wlr_scene_node *node);
 
+/**
+ * menu_scroll - scroll a menu taller than the output
+ * @node: scene node of an item of the menu
+ * @lines: number of items to scroll by, negative to scroll up
+ */
+void menu_scroll(struct wlr_scene_node *node, int lines);
+
 /**
  * menu_call_actions - call actions associated with a menu node
  *
@@ -125,7 +181,11 @@ bool menu_call_actions(struct wlr_scene_node *node);
  */
 void menu_close_root(struct server *server);
 
-/* menu_reconfigure - reload theme and content */
-void menu_reconfigure(struct server *server);
+/**
+ * menu_reconfigure - reload theme and content
+ * @force: reload even if the menu files are unchanged, e.g. because
+ *         the theme or menu related settings in rc.xml changed
+ */
+void menu_reconfigure(struct server *server, bool force);
 
 #endif /* LABWC_MENU_H */
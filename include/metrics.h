@@ -0,0 +1,51 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_METRICS_H
+#define LABWC_METRICS_H
+
+#include <stdint.h>
+
+struct server;
+
+/*
+ * Metrics in the Prometheus text exposition format
+ *
+ * Counters and histograms are always collected, which is cheap. With
+ * <core><metricsSocket> set, every connection to that Unix socket is sent
+ * the current values of these and of the statistics other subsystems
+ * keep anyway (frame times, caches, input latency) and is then closed.
+ */
+
+enum metrics_counter {
+	METRICS_CONFIGURE_TIMEOUTS = 0,
+	METRICS_PIPEMENU_TIMEOUTS,
+	METRICS_RECONFIGURES,
+	METRICS_NR_COUNTERS
+};
+
+enum metrics_histogram {
+	METRICS_PIPEMENU_DURATION = 0,
+	METRICS_RECONFIGURE_DURATION,
+	METRICS_CONFIGURE_RTT,
+	METRICS_NR_HISTOGRAMS
+};
+
+/**
+ * metrics_init - start or stop serving metrics as configured
+ * @server: server whose event loop and state are used
+ *
+ * Also to be called on reconfigure to follow changes of the socket path.
+ */
+void metrics_init(struct server *server);
+void metrics_finish(void);
+
+/* metrics_count - increment @counter */
+void metrics_count(enum metrics_counter counter);
+
+/**
+ * metrics_observe - add a sample to @histogram
+ * @histogram: histogram to add the sample to
+ * @nsec: observed duration in nanoseconds
+ */
+void metrics_observe(enum metrics_histogram histogram, int64_t nsec);
+
+#endif /* LABWC_METRICS_H */
@@ -29,11 +29,14 @@ struct window_switcher_field {
 	enum window_switcher_field_content content;
 	int width;
 	char *format;
+	/* struct osd_field_op, compiled from format by osd_field_validate() */
+	struct wl_array ops;
 	struct wl_list link; /* struct rcxml.window_switcher.fields */
 };
 
 struct buf;
 struct view;
+struct output;
 struct server;
 
 /* Updates onscreen display 'alt-tab' buffer */
@@ -45,9 +48,39 @@ void osd_finish(struct server *server);
 /* Moves preview views back into their original stacking order and state */
 void osd_preview_restore(struct server *server);
 
+/**
+ * osd_cycle_views - window switcher candidates in stacking order
+ * @server: server
+ *
+ * The array is built on first use and reused until osd_invalidate_views()
+ * is called or the OSD is closed. It must not be modified by the caller.
+ */
+struct wl_array *osd_cycle_views(struct server *server);
+
+/**
+ * osd_invalidate_views - drop the cached window switcher candidates
+ * @server: server
+ *
+ * To be called whenever a view is mapped, unmapped, restacked or moved
+ * between workspaces, or when its window rules may have changed.
+ */
+void osd_invalidate_views(struct server *server);
+
+/**
+ * osd_invalidate_scene - drop the retained window switcher OSD scenes
+ * @server: server
+ *
+ * To be called when the theme, the window switcher config or the name
+ * of the current workspace changed. The OSD is rebuilt if it is shown.
+ */
+void osd_invalidate_scene(struct server *server);
+
 /* Notify OSD about a destroying view */
 void osd_on_view_destroy(struct view *view);
 
+/* Notify OSD about a destroying output */
+void osd_on_output_destroy(struct output *output);
+
 /* Used by osd.c internally to render window switcher fields */
 void osd_field_get_content(struct window_switcher_field *field,
 	struct buf *buf, struct view *view);
@@ -0,0 +1,41 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_OUTPUT_STATE_CACHE_H
+#define LABWC_OUTPUT_STATE_CACHE_H
+
+#include <stdbool.h>
+
+struct server;
+struct wlr_output;
+
+/*
+ * Known-good output state per monitor
+ *
+ * Monitors are identified by the make, model and serial number of their
+ * EDID, so a display that reappears (on a KVM switch or a DP MST hub,
+ * for example) is recognized on any connector. The cache lives as long
+ * as the compositor.
+ */
+
+/**
+ * output_state_cache_save() - remember the current state of an output
+ * @server: server owning the cache
+ * @wlr_output: enabled output whose last commit succeeded
+ */
+void output_state_cache_save(struct server *server,
+	struct wlr_output *wlr_output);
+
+/**
+ * output_state_cache_apply() - restore the cached state of an output
+ * @server: server owning the cache
+ * @wlr_output: newly appeared output
+ *
+ * The cached state is tested and committed in one go.
+ * Returns false if nothing was cached or the state was rejected, in
+ * which case the output is left untouched.
+ */
+bool output_state_cache_apply(struct server *server,
+	struct wlr_output *wlr_output);
+
+void output_state_cache_finish(struct server *server);
+
+#endif /* LABWC_OUTPUT_STATE_CACHE_H */
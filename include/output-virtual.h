@@ -5,7 +5,16 @@
 struct server;
 struct wlr_output;
 
+/* Requested mode of a virtual output, zero fields fall back to rc.xml */
+struct output_virtual_mode {
+	int width;
+	int height;
+	int refresh; /* in mHz */
+	float scale;
+};
+
 void output_virtual_add(struct server *server, const char *output_name,
+		const struct output_virtual_mode *mode,
 		struct wlr_output **store_wlr_output);
 void output_virtual_remove(struct server *server, const char *output_name);
 void output_virtual_update_fallback(struct server *server);
@@ -32,7 +32,7 @@ struct overlay {
 	} active;
 
 	/* For delayed snap-to-edge overlay */
-	struct wl_event_source *timer;
+	struct lab_timer *timer;
 };
 
 void overlay_reconfigure(struct seat *seat);
@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_OVERVIEW_H
+#define LABWC_OVERVIEW_H
+
+#include <stdbool.h>
+
+struct server;
+struct view;
+
+/*
+ * Overview of the windows of the current workspace
+ *
+ * Each output shows the windows on it as a grid of thumbnails (see
+ * thumbnail.h) on top of the regular scene. Clicking a thumbnail
+ * focuses its window and leaves the overview.
+ */
+
+/* Show the overview or leave it if it is already shown */
+void overview_toggle(struct server *server);
+
+void overview_finish(struct server *server);
+
+/**
+ * overview_handle_button() - process a pointer button while in overview
+ * @server: server
+ * @pressed: true for a press, false for a release
+ *
+ * Returns true if the button was consumed by the overview.
+ */
+bool overview_handle_button(struct server *server, bool pressed);
+
+/* Leave the overview when a view shown in it goes away */
+void overview_on_view_unmap(struct view *view);
+
+#endif /* LABWC_OVERVIEW_H */
@@ -6,6 +6,14 @@
 #include <wlr/util/box.h>
 #include "view.h"
 
+struct output;
+
 bool placement_find_best(struct view *view, struct wlr_box *geometry);
 
+/**
+ * placement_on_output_destroy - free the overlap bitmap kept for smart
+ * placement on an output which is going away
+ */
+void placement_on_output_destroy(struct output *output);
+
 #endif /* LABWC_PLACEMENT_H */
@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_PROFILE_H
+#define LABWC_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Lightweight timing of hot code paths
+ *
+ * Profiling is disabled unless the environment variable LABWC_PROFILE is
+ * set, in which case the accumulated statistics are printed on exit and
+ * by the Debug action. If LABWC_PROFILE_JSON is set to a path as well,
+ * they are also written to that file on exit so that results of different
+ * versions can be compared, together with the time to the first frame if
+ * LABWC_PROFILE_STARTUP is set. See scripts/bench/ for a headless benchmark
+ * run and scripts/bench/perf-check.sh for comparing against a baseline.
+ */
+enum profile_zone {
+	PROFILE_PLACEMENT_FIND_BEST = 0,
+	PROFILE_OSD_UPDATE,
+	PROFILE_GET_CURSOR_CONTEXT,
+	PROFILE_DESKTOP_ARRANGE_ALL_VIEWS,
+	PROFILE_EDGES_FIND_NEIGHBORS,
+	PROFILE_SSD_CREATE,
+	PROFILE_SSD_UPDATE_TITLE,
+	PROFILE_VIEW_RELOAD_SSD,
+	PROFILE_MENU_OPEN,
+	PROFILE_NR_ZONES
+};
+
+/* profile_init - enable profiling if LABWC_PROFILE is set */
+void profile_init(void);
+
+bool profile_enabled(void);
+
+/**
+ * profile_begin - start timing a zone
+ * Returns a timestamp to be passed to profile_end() or 0 if profiling is
+ * disabled.
+ */
+int64_t profile_begin(void);
+
+/**
+ * profile_end - account the time elapsed since profile_begin() to a zone
+ * @zone: zone to account the time to
+ * @begin: return value of profile_begin()
+ */
+void profile_end(enum profile_zone zone, int64_t begin);
+
+/* profile_print - print statistics of all zones to stdout */
+void profile_print(void);
+
+/* profile_write_json - write statistics to LABWC_PROFILE_JSON if set */
+void profile_write_json(void);
+
+/*
+ * Startup phases
+ *
+ * If the environment variable LABWC_PROFILE_STARTUP is set, the phases of
+ * startup are timed from profile_init() on and a summary is printed once
+ * profile_startup_print() is called. Phases and marks are also written
+ * as trace events (see trace.h), independent of LABWC_PROFILE_STARTUP.
+ *
+ * @name must be a string literal, phases may nest.
+ */
+void profile_startup_begin(const char *name);
+void profile_startup_end(const char *name);
+
+/* profile_startup_mark - record a point in time, @detail may be NULL */
+void profile_startup_mark(const char *name, const char *detail);
+
+/* profile_startup_print - print all phases and marks recorded so far */
+void profile_startup_print(void);
+
+#endif /* LABWC_PROFILE_H */
@@ -0,0 +1,25 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_REALTIME_H
+#define LABWC_REALTIME_H
+
+#include <stdbool.h>
+
+/*
+ * Real-time mode for latency-critical deployments
+ *
+ * With <core><realtime> enabled, the compositor thread is switched to
+ * SCHED_RR and all memory mapped at the end of startup is pre-faulted and
+ * locked, so that neither other processes nor paging delay input and
+ * frames. Both need CAP_SYS_NICE/CAP_IPC_LOCK or matching RLIMIT_RTPRIO
+ * and RLIMIT_MEMLOCK limits; whatever is not permitted is skipped.
+ *
+ * Spawned processes are reset to normal scheduling.
+ */
+
+/* realtime_init - enter real-time mode if configured, once at startup */
+void realtime_init(void);
+
+/* realtime_is_active - whether the compositor thread runs as SCHED_RR */
+bool realtime_is_active(void);
+
+#endif /* LABWC_REALTIME_H */
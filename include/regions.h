@@ -2,6 +2,7 @@
 #ifndef LABWC_REGIONS_H
 #define LABWC_REGIONS_H
 
+#include <wayland-server-core.h>
 #include <wlr/util/box.h>
 
 struct seat;
@@ -25,6 +26,25 @@ struct region {
 	} center;
 };
 
+#define REGIONS_GRID_SIZE (8)
+
+/*
+ * Point-lookup index of the regions of an output. The usable area is
+ * divided into REGIONS_GRID_SIZE x REGIONS_GRID_SIZE cells, each holding
+ * the regions which intersect it, so that regions_from_cursor() only
+ * has to look at a few candidates on each pointer motion.
+ *
+ * The grid also remembers the usable area (in layout coordinates) the
+ * region geometry was last computed for, so that regions_update_geometry()
+ * is a no-op unless the usable area or the regions actually changed.
+ */
+struct region_grid {
+	bool valid;
+	struct wlr_box box;
+	/* struct region *, row-major */
+	struct wl_array cells[REGIONS_GRID_SIZE * REGIONS_GRID_SIZE];
+};
+
 /* Returns true if we should show the region overlay or snap to region */
 bool regions_should_snap(struct server *server);
 
@@ -58,6 +78,9 @@ void regions_update_geometry(struct output *output);
  */
 void regions_evacuate_output(struct output *output);
 
+/* Free the point-lookup index of an output */
+void regions_grid_finish(struct region_grid *grid);
+
 /* Free all regions in given wl_list pointer */
 void regions_destroy(struct seat *seat, struct wl_list *regions);
 
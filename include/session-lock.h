@@ -11,6 +11,8 @@ struct session_lock {
 	struct wlr_session_lock_v1 *lock;
 	struct wlr_surface *focused;
 	bool abandoned;
+	/* locked has been sent, see handle_commit() in session-lock.c */
+	bool locked_sent;
 
 	struct wl_list session_lock_outputs;
 
@@ -0,0 +1,59 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_SESSION_STATE_H
+#define LABWC_SESSION_STATE_H
+
+#include <stdbool.h>
+
+struct server;
+struct view;
+
+/*
+ * Window layout across compositor restarts
+ *
+ * With <placement><restoreSession> enabled, the natural geometry, output,
+ * workspace, maximized, fullscreen and snapped state of each window are
+ * kept in a small memory mapped file in $XDG_RUNTIME_DIR. Records are
+ * updated in place once per event loop iteration, so they survive labwc
+ * exiting or crashing at any point. The automatic tiling layouts of the
+ * workspaces are kept as well.
+ *
+ * The next instance on the same Wayland socket name reads the file once
+ * at startup. Windows appearing shortly after with a recorded app_id get
+ * their previous layout back when they are first mapped, instead of being
+ * placed like new windows.
+ */
+
+/**
+ * session_state_init - open the state file as configured
+ *
+ * Restores the tiling layouts of the workspaces on first use. Also to be
+ * called on reconfigure to follow <placement><restoreSession>.
+ */
+void session_state_init(struct server *server);
+
+/* session_state_finish - write pending changes, the file is kept */
+void session_state_finish(void);
+
+/* session_state_changed - queue @view to be written to the state file */
+void session_state_changed(struct view *view);
+
+/* session_state_layout_changed - write the tiling layouts again */
+void session_state_layout_changed(void);
+
+/* session_state_view_destroy - forget the record of @view */
+void session_state_view_destroy(struct view *view);
+
+/**
+ * session_state_place - move a view mapped for the first time to where
+ * the previous instance had a window of the same app_id
+ * Returns false if no such window is remembered.
+ */
+bool session_state_place(struct view *view);
+
+/**
+ * session_state_restore - restore the workspace and the maximized,
+ * fullscreen or snapped state of a view mapped for the first time
+ */
+void session_state_restore(struct view *view);
+
+#endif /* LABWC_SESSION_STATE_H */
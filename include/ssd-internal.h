@@ -32,11 +32,16 @@ struct ssd_button {
 struct ssd_sub_tree {
 	struct wlr_scene_tree *tree;
 	struct wl_list parts; /* ssd_part.link */
+
+	/* First part of each type, used by ssd_get_part() */
+	struct ssd_part *part_by_type[LAB_SSD_END_MARKER];
 };
 
 struct ssd_state_title_width {
 	int width;
 	bool truncated;
+	/* Update skipped while hidden, see ssd_update_title() */
+	bool stale;
 };
 
 struct ssd {
@@ -52,12 +57,21 @@ struct ssd {
 		bool was_maximized;   /* To un-round corner buttons and toggle icon on maximize */
 		struct wlr_box geometry;
 		struct ssd_state_title {
-			char *text;
+			const char *text; /* interned */
 			struct ssd_state_title_width active;
 			struct ssd_state_title_width inactive;
 		} title;
 	} state;
 
+	/* Rendering of the inactive view's active title, see ssd_prewarm_title() */
+	struct wl_event_source *prewarm_idle;
+
+	/* See ssd_update_visibility() */
+	struct {
+		int64_t since_nsec; /* 0 while shown or once released */
+		bool released;
+	} hidden;
+
 	/* An invisible area around the view which allows resizing */
 	struct ssd_sub_tree extents;
 
@@ -110,37 +124,40 @@ struct wlr_scene_tree;
 /* SSD internal helpers to create various SSD elements */
 /* TODO: Replace some common args with a struct */
 struct ssd_part *add_scene_part(
-	struct wl_list *part_list, enum ssd_part_type type);
+	struct ssd_sub_tree *subtree, enum ssd_part_type type);
 struct ssd_part *add_scene_rect(
-	struct wl_list *list, enum ssd_part_type type,
+	struct ssd_sub_tree *subtree, enum ssd_part_type type,
 	struct wlr_scene_tree *parent, int width, int height, int x, int y,
 	float color[4]);
 struct ssd_part *add_scene_buffer(
-	struct wl_list *list, enum ssd_part_type type,
+	struct ssd_sub_tree *subtree, enum ssd_part_type type,
 	struct wlr_scene_tree *parent, struct wlr_buffer *buffer, int x, int y);
 struct ssd_part *add_scene_button(
-	struct wl_list *part_list, enum ssd_part_type type,
+	struct ssd_sub_tree *subtree, enum ssd_part_type type,
 	struct wlr_scene_tree *parent, float *bg_color,
 	struct wlr_buffer *icon_buffer, struct wlr_buffer *hover_buffer,
 	int x, struct view *view);
-void add_toggled_icon(struct ssd_button *button, struct wl_list *part_list,
+void add_toggled_icon(struct ssd_button *button, struct ssd_sub_tree *subtree,
 	enum ssd_part_type type, struct wlr_buffer *icon_buffer,
 	struct wlr_buffer *hover_buffer);
 struct ssd_part *add_scene_button_corner(
-	struct wl_list *part_list, enum ssd_part_type type,
+	struct ssd_sub_tree *subtree, enum ssd_part_type type,
 	enum ssd_part_type corner_type, struct wlr_scene_tree *parent,
-	struct wlr_buffer *corner_buffer, struct wlr_buffer *icon_buffer,
+	bool active, struct wlr_buffer *icon_buffer,
 	struct wlr_buffer *hover_buffer, int x, struct view *view);
 
 /* SSD internal helpers */
 struct ssd_part *ssd_get_part(
-	struct wl_list *part_list, enum ssd_part_type type);
-void ssd_destroy_parts(struct wl_list *list);
+	struct ssd_sub_tree *subtree, enum ssd_part_type type);
+void ssd_destroy_part(struct ssd_sub_tree *subtree, struct ssd_part *part);
+void ssd_destroy_parts(struct ssd_sub_tree *subtree);
+bool ssd_view_is_shown(struct ssd *ssd);
 
 /* SSD internal */
 void ssd_titlebar_create(struct ssd *ssd);
 void ssd_titlebar_update(struct ssd *ssd);
 void ssd_titlebar_destroy(struct ssd *ssd);
+void ssd_titlebar_release(struct ssd *ssd);
 
 void ssd_border_create(struct ssd *ssd);
 void ssd_border_update(struct ssd *ssd);
@@ -63,6 +63,25 @@ struct border ssd_get_margin(const struct ssd *ssd);
 void ssd_update_margin(struct ssd *ssd);
 void ssd_set_active(struct ssd *ssd, bool active);
 void ssd_update_title(struct ssd *ssd);
+
+/**
+ * ssd_update_visibility() - to be called when the view may have been
+ * shown or hidden, by (un)mapping or a change of workspace
+ *
+ * Titles are only rendered while the view is shown. Those of views
+ * which stay hidden for a while are released to save memory.
+ */
+void ssd_update_visibility(struct ssd *ssd);
+
+/**
+ * ssd_prewarm_title() - render the active title of an inactive view
+ *
+ * Only the titlebar state shown is rendered, the other one when the
+ * view is (de)activated. Called when the cursor enters an inactive view
+ * so that the title is rendered from an idle callback before a click
+ * activates the view.
+ */
+void ssd_prewarm_title(struct ssd *ssd);
 void ssd_update_geometry(struct ssd *ssd);
 void ssd_destroy(struct ssd *ssd);
 void ssd_titlebar_hide(struct ssd *ssd);
@@ -8,9 +8,15 @@
 #ifndef LABWC_THEME_H
 #define LABWC_THEME_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <wayland-server-core.h>
 #include <wlr/render/wlr_renderer.h>
 
+struct scaled_scene_buffer;
+struct wlr_scene_tree;
+
 enum lab_justification {
 	LAB_JUSTIFY_LEFT,
 	LAB_JUSTIFY_CENTER,
@@ -119,13 +125,13 @@ struct theme {
 	struct lab_data_buffer *button_iconify_inactive_hover;
 	struct lab_data_buffer *button_menu_inactive_hover;
 
-	struct lab_data_buffer *corner_top_left_active_normal;
-	struct lab_data_buffer *corner_top_right_active_normal;
-	struct lab_data_buffer *corner_top_left_inactive_normal;
-	struct lab_data_buffer *corner_top_right_inactive_normal;
-
 	/* not set in rc.xml/themerc, but derived from font & padding_height */
 	int osd_window_switcher_item_height;
+
+	/* Private, hash of the files and settings the theme was built from */
+	uint64_t input_hash;
+	/* Private, rounded corners rendered so far, see theme_corner_create() */
+	struct wl_list corner_buffers;
 };
 
 /**
@@ -136,6 +142,33 @@ struct theme {
  */
 void theme_init(struct theme *theme, const char *theme_name);
 
+/**
+ * theme_reload - re-read theme on reconfigure
+ * @theme: theme data previously initialized by theme_init()
+ * @theme_name: theme-name in <theme-dir>/<theme-name>/openbox-3/themerc
+ *
+ * Textures are only regenerated if the content of the theme files, the
+ * button images or the relevant rc.xml settings have changed.
+ *
+ * Returns true if the theme has changed and server side decorations have
+ * to be rebuilt.
+ */
+bool theme_reload(struct theme *theme, const char *theme_name);
+
+/**
+ * theme_corner_create - create a rounded titlebar corner
+ * @parent: scene tree to add the corner to
+ * @theme: theme data
+ * @right: top right rather than top left corner
+ * @active: colors of the active rather than an inactive window
+ *
+ * The corner is rendered for the scale of the outputs it is shown on.
+ * Buffers are shared by all corners of the same kind and kept by the
+ * theme until theme_finish().
+ */
+struct scaled_scene_buffer *theme_corner_create(struct wlr_scene_tree *parent,
+	struct theme *theme, bool right, bool active);
+
 /**
  * theme_finish - free button textures
  * @theme: theme data
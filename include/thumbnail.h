@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_THUMBNAIL_H
+#define LABWC_THUMBNAIL_H
+
+#include <stdbool.h>
+
+struct server;
+struct view;
+struct wlr_buffer;
+
+/*
+ * Downscaled snapshots of views for the window switcher
+ *
+ * The surfaces of a view are rendered by the GPU into a small buffer
+ * which is kept until the view commits again. A couple of sizes are kept
+ * per view. Snapshots are evicted in least recently used order once they
+ * exceed a memory budget.
+ */
+
+/**
+ * thumbnail_get() - return the snapshot of a view
+ * @view: view to get the snapshot of
+ * @max_width: maximum width in pixels
+ * @max_height: maximum height in pixels
+ * @budget: number of snapshots which may still be rendered, decremented
+ *          for each one that is rendered
+ *
+ * The snapshot keeps the aspect ratio of the view. If it needs to be
+ * rendered but @budget is exhausted a stale snapshot or NULL is
+ * returned and thumbnail_is_current() stays false.
+ */
+struct wlr_buffer *thumbnail_get(struct view *view, int max_width,
+	int max_height, int *budget);
+
+/* Returns true if the snapshot of @view is up to date */
+bool thumbnail_is_current(struct view *view, int max_width, int max_height);
+
+void thumbnail_init(struct server *server);
+void thumbnail_finish(struct server *server);
+
+/* Drop the snapshot of a view which is unmapped or destroyed */
+void thumbnail_on_view_unmap(struct view *view);
+
+#endif /* LABWC_THUMBNAIL_H */
@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_TILING_H
+#define LABWC_TILING_H
+
+struct server;
+struct workspace;
+
+/*
+ * Automatic tiling
+ *
+ * With a layout set for a workspace, its floating toplevel windows are
+ * arranged per output to fill the usable area. All tiles are computed in
+ * one pass and applied as a single configure batch, so clients resize
+ * together. Maximized, fullscreen, snapped and minimized windows as well
+ * as dialogs and windows with a fixedPosition window rule are left out.
+ */
+enum tiling_layout {
+	TILING_LAYOUT_NONE = 0,
+	/* Newest window on the left, the others stacked on the right */
+	TILING_LAYOUT_MASTER_STACK,
+	/* Rows of equally sized windows */
+	TILING_LAYOUT_GRID,
+	TILING_LAYOUT_INVALID,
+};
+
+enum tiling_layout tiling_layout_parse(const char *name);
+
+/**
+ * tiling_set_layout - change the layout of @workspace
+ * Switching to TILING_LAYOUT_NONE moves the windows back to where they
+ * were before they were tiled.
+ */
+void tiling_set_layout(struct workspace *workspace, enum tiling_layout layout);
+
+/**
+ * tiling_update - arrange @workspace again
+ * Called whenever a window joins or leaves the layout. Only windows whose
+ * tile changed are configured.
+ */
+void tiling_update(struct workspace *workspace);
+
+void tiling_update_all(struct server *server);
+
+#endif /* LABWC_TILING_H */
@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_TRACE_H
+#define LABWC_TRACE_H
+
+#include "config.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Export of trace events
+ *
+ * When built with -Dtrace=true and the environment variable
+ * LABWC_TRACE_FILE is set, events are written to that file in the Chrome
+ * JSON trace format, which both chrome://tracing and ui.perfetto.dev can
+ * open. Timestamps are CLOCK_MONOTONIC in microseconds, so they line up
+ * with traces of clients and of the GPU driver recorded at the same time.
+ *
+ * Without the build option all functions are empty inlines.
+ *
+ * @name must be a string literal made of characters not needing escapes
+ * in JSON, @detail may be any string or NULL and is added as argument.
+ */
+
+#if HAVE_TRACE
+
+/* trace_init - start writing events if LABWC_TRACE_FILE is set */
+void trace_init(void);
+
+/* trace_finish - complete and close the trace file */
+void trace_finish(void);
+
+/* trace_begin - start a duration event, must be paired with trace_end() */
+void trace_begin(const char *name, const char *detail);
+void trace_end(const char *name);
+
+/* trace_instant - record an event without duration */
+void trace_instant(const char *name, const char *detail);
+
+/**
+ * trace_async_begin - start an event which may end in another handler
+ * @name: name of the event, the same for trace_async_end()
+ * @id: identifies the event among all running ones of @name
+ * @detail: argument to show with the event or NULL
+ */
+void trace_async_begin(const char *name, uint64_t id, const char *detail);
+void trace_async_end(const char *name, uint64_t id, const char *detail);
+
+#else
+
+static inline void trace_init(void) { }
+static inline void trace_finish(void) { }
+static inline void trace_begin(const char *name, const char *detail) { }
+static inline void trace_end(const char *name) { }
+static inline void trace_instant(const char *name, const char *detail) { }
+static inline void
+trace_async_begin(const char *name, uint64_t id, const char *detail) { }
+static inline void
+trace_async_end(const char *name, uint64_t id, const char *detail) { }
+
+#endif /* HAVE_TRACE */
+
+#endif /* LABWC_TRACE_H */
@@ -0,0 +1,25 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_VIEW_CAPTURE_H
+#define LABWC_VIEW_CAPTURE_H
+
+struct view;
+
+/*
+ * Capture of a single window
+ *
+ * The surfaces of a captured view are mirrored into a scene of their
+ * own, which is shown on a headless output outside of the output
+ * layout. Screen capture clients record the window by capturing that
+ * output via wlr-screencopy or export-dmabuf, without copying and
+ * cropping a full output. The output is named "CAPTURE-<n>", carries
+ * the app_id of the view in its description and is only repainted when
+ * the surfaces of the view are damaged.
+ */
+
+/* Start capturing @view or stop if it is already captured */
+void view_capture_toggle(struct view *view);
+
+/* Stop capturing a view which is unmapped or destroyed */
+void view_capture_on_view_unmap(struct view *view);
+
+#endif /* LABWC_VIEW_CAPTURE_H */
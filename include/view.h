@@ -8,6 +8,8 @@
 #include <wayland-util.h>
 #include <wlr/util/box.h>
 #include <xkbcommon/xkbcommon.h>
+#include "common/bitset.h"
+#include "window-rules.h"
 
 #define LAB_MIN_VIEW_WIDTH  100
 #define LAB_MIN_VIEW_HEIGHT  60
@@ -68,6 +70,9 @@ enum view_wants_focus {
 };
 
 struct view;
+struct session_record;
+struct view_capture;
+struct thumbnail;
 struct wlr_surface;
 
 /* Common to struct view and struct xwayland_unmanaged */
@@ -106,20 +111,66 @@ struct view_impl {
 	void (*minimize)(struct view *view, bool minimize);
 	void (*move_to_front)(struct view *view);
 	void (*move_to_back)(struct view *view);
-	struct view *(*get_root)(struct view *self);
-	void (*append_children)(struct view *self, struct wl_array *children);
 	struct view_size_hints (*get_size_hints)(struct view *self);
 	/* if not implemented, VIEW_WANTS_FOCUS_ALWAYS is assumed */
 	enum view_wants_focus (*wants_focus)(struct view *self);
 	/* returns true if view reserves space at screen edge */
 	bool (*has_strut_partial)(struct view *self);
+	/*
+	 * Tells the client the scale to render at before its surface is
+	 * shown on any output, after which the scene keeps it updated
+	 */
+	void (*notify_scale)(struct view *self, double scale);
+};
+
+/* Visibility of a view at the time of a commit, for the metrics */
+enum view_commit_state {
+	VIEW_COMMIT_SHOWN = 0,
+	VIEW_COMMIT_OCCLUDED,
+	VIEW_COMMIT_HIDDEN, /* on another workspace */
+	VIEW_COMMIT_NR_STATES
 };
 
 struct view {
+	/*
+	 * Fields read by most iterations over server.views (stacking,
+	 * focus, cursor and output lookups) come first, so that a walk
+	 * over the list touches as few cache lines per view as possible.
+	 * State only used by a single view at a time, such as listeners
+	 * and saved geometry, follows further down.
+	 */
+	struct wl_list link; /* server.views, in stacking order */
 	struct server *server;
-	enum view_type type;
 	const struct view_impl *impl;
-	struct wl_list link;
+	enum view_type type;
+
+	bool mapped;
+	bool been_mapped;
+	bool ssd_enabled;
+	bool ssd_titlebar_hidden;
+	bool shaded;
+	bool minimized;
+	bool fullscreen;
+	bool tearing_hint;
+	bool visible_on_all_workspaces;
+	bool occluded; /* see edges_calculate_occlusion() */
+	bool inhibits_keybinds;
+	enum view_axis maximized;
+	enum view_edge tiled;
+	uint32_t edges_visible;  /* enum wlr_edges bitset */
+
+	/*
+	 * Geometry of the wlr_surface contained within the view, as
+	 * currently displayed. Should be kept in sync with the
+	 * scene-graph at all times.
+	 */
+	struct wlr_box current;
+	/*
+	 * Expected geometry after any pending move/resize requests
+	 * have been processed. Should match current geometry when no
+	 * move/resize requests are pending.
+	 */
+	struct wlr_box pending;
 
 	/*
 	 * The primary output that the view is displayed on. Specifically:
@@ -143,48 +194,79 @@ struct view {
 	 * This is used to notify the foreign toplevel
 	 * implementation and to update the SSD invisible
 	 * resize area.
-	 * It is a bitset of output->scene_output->index.
+	 * It is a set of output->index.
 	 */
-	uint64_t outputs;
+	struct bitset outputs;
 
 	struct workspace *workspace;
 	struct wlr_surface *surface;
 	struct wlr_scene_tree *scene_tree;
 	struct wlr_scene_node *scene_node;
+	/* Offscreen mirror for window capture, see view-capture.h */
+	struct view_capture *capture;
+	/* Window switcher snapshot, see thumbnail.h */
+	struct thumbnail *thumbnail;
 
-	bool mapped;
-	bool been_mapped;
-	bool ssd_enabled;
-	bool ssd_titlebar_hidden;
+	/*
+	 * Link in the list of views sharing the same scene tree parent
+	 * (workspace.views, server.views_always_on_top or _bottom), in
+	 * the same relative order as server.views. stack_seq orders both
+	 * lists, higher values are closer to the front.
+	 */
+	struct wl_list layer_link;
+	int64_t stack_seq;
+
+	/*
+	 * Parent as set by the client (dialogs, transient windows), kept
+	 * up to date from set_parent events, see view_set_parent()
+	 */
+	struct view *parent;
+	struct wl_list children; /* view.child_link, bottom-most first */
+	struct wl_list child_link; /* view.children */
+
+	/* Remaining state, mostly used by one view at a time */
 	enum ssd_preference ssd_preference;
-	bool shaded;
-	bool minimized;
-	enum view_axis maximized;
-	bool fullscreen;
-	bool tearing_hint;
-	bool visible_on_all_workspaces;
-	enum view_edge tiled;
-	uint32_t edges_visible;  /* enum wlr_edges bitset */
-	bool inhibits_keybinds;
-	xkb_layout_index_t keyboard_layout;
+	/* Layout group while inactive, see keyboard_save_layout() */
+	struct {
+		uint32_t keymap_generation;
+		uint8_t group; /* xkb has at most 4 groups */
+	} keyboard_layout;
+	/* Surface commits while mapped, see view_count_commit() */
+	uint64_t nr_commits[VIEW_COMMIT_NR_STATES];
+
+	/* Cached window rule properties, see window-rules.c */
+	struct {
+		bool valid;
+		enum property props[LAB_RULE_PROP_COUNT];
+	} window_rule_cache;
+
+	/*
+	 * Copies of the title and app_id reported by the client, see
+	 * view_get_title(). Either may be NULL if not set by the client.
+	 */
+	struct {
+		bool valid;
+		const char *title;  /* interned, see common/intern.h */
+		const char *app_id; /* interned */
+	} string_cache;
+
+	/* Criteria the view satisfies, see view_matches_criteria() */
+	struct {
+		bool valid;
+		uint32_t state; /* enum lab_view_criteria bitset */
+	} criteria_cache;
 
 	/* Pointer to an output owned struct region, may be NULL */
 	struct region *tiled_region;
 	/* Set to region->name when tiled_region is free'd by a destroying output */
 	char *tiled_region_evacuate;
 
-	/*
-	 * Geometry of the wlr_surface contained within the view, as
-	 * currently displayed. Should be kept in sync with the
-	 * scene-graph at all times.
-	 */
-	struct wlr_box current;
-	/*
-	 * Expected geometry after any pending move/resize requests
-	 * have been processed. Should match current geometry when no
-	 * move/resize requests are pending.
-	 */
-	struct wlr_box pending;
+	/* Automatic tiling, see tiling.c */
+	struct {
+		uint64_t seq; /* order of joining the layout, 0 if not tiled */
+		struct wlr_box floating; /* geometry before joining */
+	} tiling;
+
 	/*
 	 * Saved geometry which will be restored when the view returns
 	 * to normal/floating state after being maximized/fullscreen/
@@ -200,9 +282,56 @@ struct view {
 	 */
 	struct wlr_box last_layout_geometry;
 
+	/*
+	 * Output the xdg-popups of the view were last constrained to, see
+	 * xdg-popup.c. Out-of-date once server->usable_area_generation moves.
+	 */
+	struct {
+		uint32_t generation;
+		struct wlr_box output_box; /* layout coordinates */
+		struct wlr_box usable; /* layout coordinates */
+	} popup_constraint;
+
+	/* Window state socket, see window-state.c */
+	struct {
+		uint64_t id; /* assigned when first sent, 0 before */
+		bool queued;
+		struct wl_list link; /* window_state.changed, if queued */
+	} window_state;
+
+	/* State file for restarts, see session-state.c */
+	struct {
+		struct session_record *record; /* NULL if not recorded */
+		bool queued;
+		struct wl_list link; /* session_state.changed, if queued */
+	} session_state;
+
 	/* used by xdg-shell views */
 	uint32_t pending_configure_serial;
-	struct wl_event_source *pending_configure_timeout;
+	struct lab_timer *pending_configure_timeout;
+	struct {
+		struct configure_batch *batch; /* NULL if not batched */
+		struct wl_list link; /* configure_batch.views */
+		bool acked;
+		/* Most recently committed size, applied with the batch */
+		int width, height;
+	} configure_batch;
+	/* Round trips of configures, used to adapt the configure timeout */
+	struct {
+		int64_t sent_nsec; /* of the pending configure */
+		int64_t avg_nsec;  /* moving average, 0 before the first ack */
+		int64_t max_nsec;
+		uint32_t nr_samples; /* acks and timeouts */
+		uint32_t nr_timeouts;
+		int timeout_ms;    /* of the pending configure */
+		bool slow;
+	} configure_rtt;
+
+	/* Rate limiting of title changes, see view_update_title() */
+	struct {
+		struct lab_timer *timer; /* armed while an update is deferred */
+		int64_t last_nsec;
+	} title_update;
 
 	struct ssd *ssd;
 	struct resize_indicator {
@@ -210,11 +339,19 @@ struct view {
 		struct wlr_scene_tree *tree;
 		struct wlr_scene_rect *border;
 		struct wlr_scene_rect *background;
-		struct scaled_font_buffer *text;
+		struct wlr_scene_tree *text_tree;
+		/* Text currently shown, one glyph node per character */
+		char text[32];
+		struct scaled_scene_buffer *glyphs[32];
 	} resize_indicator;
 
 	struct foreign_toplevel {
 		struct wlr_foreign_toplevel_handle_v1 *handle;
+		/* Not yet relayed, see foreign_toplevel_queue_update() */
+		uint32_t pending_changes;
+		struct wl_list queue_link;
+		bool activated;
+		struct bitset sent_outputs;
 		struct wl_listener maximize;
 		struct wl_listener minimize;
 		struct wl_listener fullscreen;
@@ -248,6 +385,7 @@ struct xdg_toplevel_view {
 
 	/* Events unique to xdg-toplevel views */
 	struct wl_listener set_app_id;
+	struct wl_listener set_parent;
 	struct wl_listener new_popup;
 };
 
@@ -299,10 +437,15 @@ bool view_matches_query(struct view *view, struct view_query *query);
  * @view: Iterator.
  * @head: Head of list to iterate over.
  * @criteria: Criteria to match against.
+ *
+ * With LAB_VIEW_CRITERIA_CURRENT_WORKSPACE only the views of the current
+ * workspace (and the always-on-top views) are visited, so the loop body
+ * must not move views between workspaces. Use view_array_append() for that.
+ *
  * Example:
  *	struct view *view;
  *	for_each_view(view, &server->views, LAB_VIEW_CRITERIA_NONE) {
- *		printf("%s\n", view_get_string_prop(view, "app_id"));
+ *		printf("%s\n", view_get_app_id(view));
  *	}
  */
 #define for_each_view(view, head, criteria)		\
@@ -310,6 +453,25 @@ bool view_matches_query(struct view *view, struct view_query *query);
 	     view;					\
 	     view = view_next(head, view, criteria))
 
+/**
+ * view_matches_criteria() - Check whether a view matches criteria
+ * @view: View to check.
+ * @criteria: Criteria to match against.
+ */
+bool view_matches_criteria(struct view *view, enum lab_view_criteria criteria);
+
+/**
+ * view_invalidate_criteria() - Drop the cached criteria state of views
+ * @server: server
+ * @view: view to invalidate or NULL for all views
+ *
+ * Except for focusability and the current workspace, which are checked
+ * directly, the criteria a view satisfies are kept as a bitmask. This
+ * has to be called when the fullscreen state, the scene tree parent, the
+ * parent toplevel or the window rules of a view may have changed.
+ */
+void view_invalidate_criteria(struct server *server, struct view *view);
+
 /**
  * view_next() - Get next view which matches criteria.
  * @head: Head of list to iterate over.
@@ -331,6 +493,17 @@ struct view *view_next_no_head_stop(struct wl_list *head, struct view *from,
 struct view *view_prev_no_head_stop(struct wl_list *head, struct view *from,
 	enum lab_view_criteria criteria);
 
+/**
+ * view_stack_insert() - insert a view at the front or back of the stacking
+ * order, or move it there if it has been inserted before
+ * @view: view to insert
+ * @front: true to insert at the front, false to insert at the back
+ *
+ * This only updates server->views and the secondary per-layer lists used
+ * by view_next(), the scene tree has to be restacked by the caller.
+ */
+void view_stack_insert(struct view *view, bool front);
+
 /**
  * view_array_append() - Append views that match criteria to array
  * @server: server context
@@ -342,7 +515,9 @@ struct view *view_prev_no_head_stop(struct wl_list *head, struct view *from,
  * for example to get the number of views before processing them.
  *
  * Note: This array has a very short shelf-life so it is intended to be used
- *       with a single-use-throw-away approach.
+ *       with a single-use-throw-away approach. It is grown in scratch memory
+ *       (see scratch_array_add()) so it must not be released and must not be
+ *       kept beyond the current event handler.
  *
  * Example usage:
  *	struct view **view;
@@ -352,7 +527,6 @@ struct view *view_prev_no_head_stop(struct wl_list *head, struct view *from,
  *	wl_array_for_each(view, &views) {
  *		// Do something with *view
  *	}
- *	wl_array_release(&views);
  */
 void view_array_append(struct server *server, struct wl_array *views,
 	enum lab_view_criteria criteria);
@@ -401,6 +575,14 @@ void view_close(struct view *view);
  * For move only, use view_move()
  */
 void view_move_resize(struct view *view, struct wlr_box geo);
+
+/**
+ * view_get_tile_geometry - fit a view into a tile
+ * @geo: tile in layout coordinates, within the usable area of @output
+ * Returns the view geometry with rc.gap and the decorations taken off.
+ */
+struct wlr_box view_get_tile_geometry(struct view *view,
+	struct output *output, struct wlr_box geo);
 void view_resize_relative(struct view *view,
 	int left, int right, int top, int bottom);
 void view_move_relative(struct view *view, int x, int y);
@@ -465,9 +647,27 @@ void view_snap_to_region(struct view *view, struct region *region, bool store_na
 void view_move_to_output(struct view *view, struct output *output);
 
 void view_move_to_front(struct view *view);
+
+/**
+ * view_array_move_to_front() - move views to the front in one go
+ * @views: struct view * array in stacking order, topmost first
+ *
+ * Equivalent to calling view_move_to_front() for each view, starting
+ * with the last one, but updates the edges and cursor focus only once.
+ */
+void view_array_move_to_front(struct wl_array *views);
 void view_move_to_back(struct view *view);
 struct view *view_get_root(struct view *view);
-void view_append_children(struct view *view, struct wl_array *children);
+
+/**
+ * view_set_parent() - update the parent/child index of views
+ * @parent: new parent, or NULL to make @view a root view
+ *
+ * Called by the shells when a client sets the parent of a window. The
+ * view is put on top of its new siblings. Changes that would create a
+ * cycle are ignored.
+ */
+void view_set_parent(struct view *view, struct view *parent);
 bool view_on_output(struct view *view, struct output *output);
 
 /**
@@ -478,11 +678,47 @@ bool view_on_output(struct view *view, struct output *output);
  */
 bool view_has_strut_partial(struct view *view);
 
-const char *view_get_string_prop(struct view *view, const char *prop);
+/**
+ * view_get_title() - return the title of a view
+ * @view: View to get the title of
+ *
+ * The string is copied from the client once and refreshed when the
+ * client changes it (see view_update_title()), so this is cheap to call
+ * repeatedly. Returns NULL if the client has not set a title.
+ */
+const char *view_get_title(struct view *view);
+
+/**
+ * view_get_app_id() - return the app_id of a view
+ * @view: View to get the app_id of
+ *
+ * Like view_get_title(). For xwayland views this is the window class.
+ */
+const char *view_get_app_id(struct view *view);
+
+/**
+ * view_update_title() - handle a title change of the client
+ * @view: View whose title changed
+ *
+ * The cached title is refreshed at once, but the decoration and the
+ * foreign-toplevel handle are updated at most once per frame of the
+ * view's output (or once per <core><titleUpdateInterval>) so that
+ * clients changing their title many times per second do not cause a
+ * text layout and buffer allocation each time.
+ */
 void view_update_title(struct view *view);
 void view_update_app_id(struct view *view);
 void view_reload_ssd(struct view *view);
 
+/**
+ * view_count_commit() - account for a surface commit of a mapped view
+ *
+ * The commits are counted by the visibility of the view, so that the
+ * clients which keep rendering while nobody can see them stand out in
+ * the metrics.
+ */
+void view_count_commit(struct view *view);
+
 void view_set_shade(struct view *view, bool shaded);
 
 struct view_size_hints view_get_size_hints(struct view *view);
@@ -501,4 +737,23 @@ enum view_edge view_edge_parse(const char *direction);
 /* xdg.c */
 struct wlr_xdg_surface *xdg_surface_from_view(struct view *view);
 
+/**
+ * xdg_configure_batch_begin() - start grouping configure requests
+ *
+ * Until the matching xdg_configure_batch_end(), xdg-shell views which are
+ * moved or resized join a common batch. The new geometry of all of them
+ * is applied together once every view of the batch has acknowledged its
+ * configure request, or when a single shared timeout expires.
+ *
+ * Calls may be nested.
+ */
+void xdg_configure_batch_begin(struct server *server);
+void xdg_configure_batch_end(struct server *server);
+
+/**
+ * xdg_print_configure_stats() - print configure round trips of all
+ * xdg-shell views to stdout, marking the clients considered slow
+ */
+void xdg_print_configure_stats(struct server *server);
+
 #endif /* LABWC_VIEW_H */
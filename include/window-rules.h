@@ -13,6 +13,19 @@ enum property {
 	LAB_PROP_TRUE,
 };
 
+/* Properties which can be queried with window_rules_get_property() */
+enum window_rule_property {
+	LAB_RULE_PROP_SERVER_DECORATION = 0,
+	LAB_RULE_PROP_SKIP_TASKBAR,
+	LAB_RULE_PROP_SKIP_WINDOW_SWITCHER,
+	LAB_RULE_PROP_IGNORE_FOCUS_REQUEST,
+	LAB_RULE_PROP_FIXED_POSITION,
+	LAB_RULE_PROP_ADAPTIVE_SYNC,
+	LAB_RULE_PROP_ALLOW_TEARING,
+
+	LAB_RULE_PROP_COUNT
+};
+
 /*
  * 'identifier' represents:
  *   - 'app_id' for native Wayland windows
@@ -31,13 +44,56 @@ struct window_rule {
 	enum property skip_window_switcher;
 	enum property ignore_focus_request;
 	enum property fixed_position;
+	enum property adaptive_sync;
+	enum property allow_tearing;
+
+	/*
+	 * Interned identifier and title last matched against the rule, with
+	 * references held, and the results. Many views share the same
+	 * identifier, so this avoids most of the glob matching.
+	 */
+	struct {
+		const char *id;
+		bool id_matches;
+		const char *title;
+		bool title_matches;
+	} match_cache;
 
 	struct wl_list link; /* struct rcxml.window_rules */
 };
 
+struct server;
 struct view;
 
 void window_rules_apply(struct view *view, enum window_rule_event event);
-enum property window_rules_get_property(struct view *view, const char *property);
+
+/**
+ * window_rules_count_instance - track the app_ids and titles of views
+ * @prop: "app_id" or "title"
+ * @old: interned value no longer used by a view or NULL
+ * @new: interned value now used by a view or NULL
+ *
+ * The counts make matchOnce independent of the number of views.
+ */
+void window_rules_count_instance(const char *prop, const char *old,
+	const char *new);
+
+/**
+ * window_rules_get_property - get the value of a window rule property
+ * @view: view to match the rules against
+ * @property: property to query
+ *
+ * Results are cached per view, see window_rules_invalidate().
+ */
+enum property window_rules_get_property(struct view *view,
+	enum window_rule_property property);
+
+/**
+ * window_rules_invalidate - drop cached window rule results
+ * @server: server
+ * @view: view whose app_id or title has changed or NULL to
+ *        invalidate all views (after a reconfigure)
+ */
+void window_rules_invalidate(struct server *server, struct view *view);
 
 #endif /* LABWC_WINDOW_RULES_H */
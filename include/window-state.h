@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#ifndef LABWC_WINDOW_STATE_H
+#define LABWC_WINDOW_STATE_H
+
+#include <stdint.h>
+
+struct server;
+struct view;
+
+/*
+ * Window state for external tools
+ *
+ * With <core><windowStateSocket> set, labwc listens on that Unix socket
+ * for a single request line per connection:
+ *
+ *   snapshot   - answer with all views in stacking order and close
+ *   subscribe  - the same, then keep sending changes as they happen
+ *
+ * Every message is one line of JSON. Changes of a view are collected and
+ * sent once per event loop iteration, so a burst of updates (for example
+ * an interactive resize) costs one message per view and iteration.
+ */
+
+/**
+ * window_state_init - start or stop serving window state as configured
+ *
+ * Also to be called on reconfigure to follow changes of the socket path.
+ */
+void window_state_init(struct server *server);
+void window_state_finish(void);
+
+/*
+ * window_state_view_id - small id of @view, stable for its lifetime and
+ * never reused, as used in the messages and by other interfaces
+ */
+uint64_t window_state_view_id(struct view *view);
+
+/* window_state_changed - queue @view for subscribers, if there are any */
+void window_state_changed(struct view *view);
+
+/* window_state_view_destroy - tell subscribers that @view is gone */
+void window_state_view_destroy(struct view *view);
+
+#endif /* LABWC_WINDOW_STATE_H */
@@ -4,7 +4,9 @@
 
 #include <stdbool.h>
 #include <wayland-util.h>
+#include "tiling.h"
 
+struct output;
 struct seat;
 struct server;
 struct wlr_scene_tree;
@@ -19,12 +21,42 @@ struct workspace {
 
 	char *name;
 	struct wlr_scene_tree *tree;
+	struct wl_list views; /* view.layer_link, in stacking order */
+	enum tiling_layout tiling_layout;
 };
 
 void workspaces_init(struct server *server);
 void workspaces_switch_to(struct workspace *target, bool update_focus);
 void workspaces_destroy(struct server *server);
 void workspaces_osd_hide(struct seat *seat);
+
+/**
+ * workspaces_transition_update - step the animated workspace switch
+ *
+ * Called for each output frame. Does nothing unless a switch is being
+ * animated, see <desktops><transitionTime>.
+ */
+void workspaces_transition_update(struct server *server);
+
+/**
+ * workspaces_transition_finish - end the animated workspace switch
+ *
+ * Hides the old workspace and moves the new one to its final position
+ * right away. Used before anything that relies on the scene matching
+ * the current workspace, for example a button press.
+ */
+void workspaces_transition_finish(struct server *server);
+
+/**
+ * workspaces_osd_invalidate - drop the retained workspace OSD scenes
+ *
+ * They are created again from the current theme and font on next use.
+ */
+void workspaces_osd_invalidate(struct server *server);
+
+/* workspaces_osd_trim - drop the retained scenes of hidden workspace OSDs */
+void workspaces_osd_trim(struct server *server);
+void workspaces_osd_on_output_destroy(struct output *output);
 struct workspace *workspaces_find(struct workspace *anchor, const char *name,
 	bool wrap);
 
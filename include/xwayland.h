@@ -6,6 +6,7 @@
 #if HAVE_XWAYLAND
 #include <assert.h>
 #include <stdbool.h>
+#include <wlr/xwayland.h>
 #include <xcb/xcb.h>
 #include "common/macros.h"
 #include "view.h"
@@ -55,6 +56,8 @@ static_assert(
 	ARRAY_SIZE(atom_names) == ATOM_LEN,
 	"Xwayland atoms out of sync");
 
+static_assert(ATOM_LEN <= 32, "window types do not fit into mask");
+
 extern xcb_atom_t atoms[ATOM_LEN];
 
 struct xwayland_unmanaged {
@@ -62,6 +65,8 @@ struct xwayland_unmanaged {
 	struct wlr_xwayland_surface *xwayland_surface;
 	struct wlr_scene_node *node;
 	struct wl_list link;
+	/* server.unmanaged_focus_stack, only while mapped and wanting focus */
+	struct wl_list focus_link;
 
 	struct mappable mappable;
 
@@ -79,6 +84,22 @@ struct xwayland_view {
 	struct view base;
 	struct wlr_xwayland_surface *xwayland_surface;
 
+	/*
+	 * Cached from the xsurface whenever the window type or WM_HINTS
+	 * change and on map, see xwayland_view_update_props()
+	 */
+	uint32_t window_types; /* 1 << enum atom */
+	enum wlr_xwayland_icccm_input_model input_model;
+
+	/*
+	 * While a resize sent to the client has not been committed yet,
+	 * further configures only update view->pending and are sent as
+	 * one once the commit arrives, see xwayland_view_configure()
+	 */
+	struct wlr_box configure_inflight; /* empty if none outstanding */
+	bool configure_queued;
+	struct lab_timer *configure_timeout;
+
 	/* Events unique to XWayland views */
 	struct wl_listener associate;
 	struct wl_listener dissociate;
@@ -89,10 +110,11 @@ struct xwayland_view {
 	struct wl_listener set_override_redirect;
 	struct wl_listener set_strut_partial;
 	struct wl_listener set_window_type;
+	struct wl_listener set_hints;
+	struct wl_listener set_parent;
 
 	/* Not (yet) implemented */
 /*	struct wl_listener set_role; */
-/*	struct wl_listener set_hints; */
 };
 
 void xwayland_unmanaged_create(struct server *server,
@@ -103,11 +125,27 @@ void xwayland_view_create(struct server *server,
 
 void xwayland_adjust_stacking_order(struct server *server);
 
+/**
+ * xwayland_restack_begin() - group the restacking of several views
+ *
+ * The unmanaged surfaces are raised above the views only once, at the
+ * matching xwayland_restack_end().
+ */
+void xwayland_restack_begin(void);
+void xwayland_restack_end(struct server *server);
+
 struct wlr_xwayland_surface *xwayland_surface_from_view(struct view *view);
 
 bool xwayland_surface_contains_window_type(
 	struct wlr_xwayland_surface *surface, enum atom window_type);
 
+static inline bool
+xwayland_view_has_window_type(struct xwayland_view *xwayland_view,
+		enum atom window_type)
+{
+	return xwayland_view->window_types & (1u << window_type);
+}
+
 void xwayland_server_init(struct server *server,
 	struct wlr_compositor *compositor);
 void xwayland_server_finish(struct server *server);
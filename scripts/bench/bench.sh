@@ -0,0 +1,32 @@
+#!/usr/bin/env bash
+#
+# Run labwc on the headless backend with the profile zones enabled. The
+# autostart in this directory drives the clients, see bench_autostart.sh.
+# Run like this: `scripts/bench/bench.sh build` or as meson benchmark with
+# `meson test -C build --benchmark`.
+
+benchdir=$(dirname "$(realpath "$0")")
+
+if ! test -x "$1/labwc"; then
+	echo "$1/labwc not found"
+	exit 1
+fi
+
+export XDG_RUNTIME_DIR=$(mktemp -d)
+export WLR_BACKENDS=headless
+export LABWC_PROFILE=1
+export LABWC_PROFILE_JSON="${LABWC_PROFILE_JSON:-$1/bench-results.json}"
+export LABWC_BENCH_DIR="$benchdir"
+
+rm -f "$LABWC_PROFILE_JSON"
+"$1/labwc" -C "$benchdir"
+ret=$?
+
+rm -rf "$XDG_RUNTIME_DIR"
+echo "labwc terminated with return code $ret"
+if ! test -s "$LABWC_PROFILE_JSON"; then
+	echo "no results written to $LABWC_PROFILE_JSON"
+	exit 1
+fi
+echo "results written to $LABWC_PROFILE_JSON"
+exit $ret
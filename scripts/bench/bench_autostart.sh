@@ -0,0 +1,72 @@
+#!/usr/bin/env bash
+
+# Prefer scripts/helper/load-gen if built: a single process maps all views
+# and keeps maximizing and resizing them
+loadgen="$LABWC_BENCH_DIR/../helper/load-gen"
+if test -z "$LABWC_BENCH_CLIENT" && test -x "$loadgen"; then
+	LABWC_BENCH_CLIENT="$loadgen -n ${LABWC_BENCH_VIEWS:-20} -c 500 -d 120"
+	LABWC_BENCH_VIEWS=1
+fi
+
+: ${LABWC_BENCH_CLIENT:=foot}
+: ${LABWC_BENCH_VIEWS:=20}
+: ${LABWC_BENCH_RECONFIGURES:=5}
+: ${LABWC_BENCH_CYCLES:=20}
+: ${LABWC_BENCH_MENUS:=0}
+: ${LABWC_BENCH_SETTLE:=1}
+
+if test -z "$LABWC_PID"; then
+	echo "LABWC_PID not set" >&2
+	exit 1
+fi
+
+# The client may come with arguments, for example scripts/helper/load-gen
+if ! command -v "${LABWC_BENCH_CLIENT%% *}" >/dev/null; then
+	echo "$LABWC_BENCH_CLIENT not found" >&2
+	kill -s TERM $LABWC_PID
+	exit 1
+fi
+
+echo "Spawning $LABWC_BENCH_VIEWS instances of $LABWC_BENCH_CLIENT"
+
+pids=()
+for((i=0; i<LABWC_BENCH_VIEWS; i++)); do
+	$LABWC_BENCH_CLIENT >/dev/null 2>&1 &
+	pids+=($!)
+	sleep 0.1
+done
+sleep $LABWC_BENCH_SETTLE
+
+# Each reconfigure re-applies window rules and re-arranges all views
+for((i=0; i<LABWC_BENCH_RECONFIGURES; i++)); do
+	kill -s HUP $LABWC_PID
+	sleep 0.5
+done
+
+# Window switcher cycles, driven by a virtual keyboard if wtype is around
+if command -v wtype >/dev/null; then
+	for((i=0; i<LABWC_BENCH_CYCLES; i++)); do
+		wtype -M alt -k Tab -k Tab -k Tab -m alt
+		sleep 0.2
+	done
+else
+	echo "wtype not found, skipping window switcher cycles" >&2
+fi
+
+# Client menu openings with the default A-Space keybind
+if test $LABWC_BENCH_MENUS -gt 0 && command -v wtype >/dev/null; then
+	for((i=0; i<LABWC_BENCH_MENUS; i++)); do
+		wtype -M alt -k space -m alt
+		sleep 0.1
+		wtype -k Escape
+		sleep 0.1
+	done
+elif test $LABWC_BENCH_MENUS -gt 0; then
+	echo "wtype not found, skipping menu openings" >&2
+fi
+
+kill ${pids[@]} 2>/dev/null
+sleep 0.5
+
+echo "killing labwc"
+kill -s TERM $LABWC_PID
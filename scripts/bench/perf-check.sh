@@ -0,0 +1,72 @@
+#!/usr/bin/env bash
+#
+# Run the headless bench in a fixed set of scenarios and compare the timing
+# of hot code paths against scripts/bench/baseline.json. Run like this:
+# `scripts/bench/perf-check.sh build`. The baseline holds no values until
+# it has been recorded on the reference machine: with --update as second
+# argument, the baseline is rewritten from the results instead, which is
+# also how it should be refreshed after intended changes.
+
+benchdir=$(dirname "$(realpath "$0")")
+
+builddir=$(realpath "$1" 2>/dev/null)
+if ! test -x "$builddir/labwc"; then
+	echo "$1/labwc not found"
+	exit 1
+fi
+
+# One load-gen process maps all views of a scenario, much faster than
+# spawning hundreds of terminals
+helperdir=$(realpath "$benchdir/../helper")
+loadgen="$helperdir/load-gen"
+if ! test -x "$loadgen" && ! make -C "$helperdir" load-gen >/dev/null; then
+	echo "cannot build $loadgen"
+	exit 1
+fi
+
+# The switcher and menu scenarios press keys with wtype
+have_wtype=1
+if ! command -v wtype >/dev/null; then
+	echo "perf-check: wtype not found, skipping the switcher and menu scenarios"
+	have_wtype=0
+fi
+
+outdir="$builddir/perf-check"
+rm -rf "$outdir"
+mkdir -p "$outdir"
+
+# Name, views, settle time (s), title interval (ms, 0 for none), whether
+# wtype is needed and further bench tunables of each scenario
+scenarios=(
+	"placement-100	100	3	0	0	"
+	"placement-500	500	6	0	0	"
+	"switcher	20	2	0	1	LABWC_BENCH_CYCLES=50"
+	"menu	20	2	0	1	LABWC_BENCH_MENUS=20"
+	"titles	50	8	10	0	"
+	"reconfigure	50	2	0	0	LABWC_BENCH_RECONFIGURES=20"
+	"startup	0	1	0	0	"
+)
+
+for scenario in "${scenarios[@]}"; do
+	IFS=$'\t' read -r name views settle title_interval needs_wtype tunables \
+		<<<"$scenario"
+	if test "$needs_wtype" -gt "$have_wtype"; then
+		echo "wtype not found" >"$outdir/$name.skipped"
+		continue
+	fi
+	echo "perf-check: running $name"
+	env LABWC_PROFILE_STARTUP=1 \
+		LABWC_PROFILE_JSON="$outdir/$name.json" \
+		LABWC_BENCH_CLIENT="$loadgen -n $views -r 200 -t $title_interval -f 0 -d 120" \
+		LABWC_BENCH_VIEWS=$((views > 0)) \
+		LABWC_BENCH_SETTLE=$settle \
+		LABWC_BENCH_RECONFIGURES=0 \
+		LABWC_BENCH_CYCLES=0 \
+		$tunables \
+		"$benchdir/bench.sh" "$builddir" >"$outdir/$name.log" 2>&1
+	if test $? -ne 0; then
+		echo "perf-check: $name failed, see $outdir/$name.log"
+	fi
+done
+
+"$benchdir/perf-compare.py" ${2:+"$2"} "$benchdir/baseline.json" "$outdir"
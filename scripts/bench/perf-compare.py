@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-only
+#
+# Compare the results of scripts/bench/perf-check.sh against a baseline
+#
+# Usage: perf-compare.py [--update] <baseline.json> <results dir>
+#
+# The baseline lists, per scenario, the metrics to check and their values
+# on the reference machine. A metric is "<zone>.avg_us" (mean time per
+# call of a profile zone), "<zone>.max_us" or "startup.first_frame_ms".
+# A metric regresses if it exceeds its baseline value by more than the
+# tolerance of the scenario (or the global one), given as a fraction.
+# A metric without a recorded value, or which the scenario did not
+# measure, fails as well: the check must not pass on nothing. Scenarios
+# which perf-check.sh skipped, marked by a <scenario>.skipped file with
+# the reason, are reported but not checked.
+#
+# With --update, the values of all metrics are replaced by the results
+# and the baseline is written back.
+
+import json
+import os
+import sys
+
+
+def metric_value(results, metric):
+    group, field = metric.split('.', 1)
+    if group == 'startup':
+        return results.get('startup', {}).get(field)
+    zone = results.get('zones', {}).get(group)
+    if not zone or not zone['calls']:
+        return None
+    if field == 'avg_us':
+        return zone['total_ns'] / zone['calls'] / 1000.0
+    if field == 'max_us':
+        return zone['max_ns'] / 1000.0
+    raise ValueError(f'unknown metric {metric}')
+
+
+def main():
+    args = sys.argv[1:]
+    update = '--update' in args
+    args = [a for a in args if a != '--update']
+    if len(args) != 2:
+        print(f'usage: {sys.argv[0]} [--update] <baseline.json> '
+              '<results dir>', file=sys.stderr)
+        return 2
+    baseline_path, results_dir = args
+
+    with open(baseline_path) as f:
+        baseline = json.load(f)
+    default_tolerance = baseline.get('tolerance', 0.25)
+    if not update and all(value is None
+                          for scenario in baseline['scenarios'].values()
+                          for value in scenario['metrics'].values()):
+        print(f'{baseline_path} holds no values yet, record them on the '
+              'reference machine with --update', file=sys.stderr)
+        return 1
+
+    nr_failures = 0
+    print(f'{"scenario":<16} {"metric":<36} {"baseline":>10} '
+          f'{"result":>10} {"delta":>8}')
+    for name, scenario in baseline['scenarios'].items():
+        try:
+            with open(os.path.join(results_dir, f'{name}.skipped')) as f:
+                print(f'{name:<16} skipped: {f.read().strip()}')
+            continue
+        except OSError:
+            pass
+        path = os.path.join(results_dir, f'{name}.json')
+        try:
+            with open(path) as f:
+                results = json.load(f)
+        except (OSError, ValueError):
+            print(f'{name:<16} no results in {path}')
+            nr_failures += 1
+            continue
+        tolerance = scenario.get('tolerance', default_tolerance)
+        metrics = scenario['metrics']
+        for metric, expected in metrics.items():
+            value = metric_value(results, metric)
+            if update:
+                metrics[metric] = None if value is None else round(value, 3)
+            if value is None:
+                print(f'{name:<16} {metric:<36} {"-":>10} {"-":>10} '
+                      'NOT MEASURED')
+                nr_failures += not update
+                continue
+            if expected is None:
+                print(f'{name:<16} {metric:<36} {"-":>10} {value:>10.2f} '
+                      'NO BASELINE')
+                nr_failures += not update
+                continue
+            delta = (value - expected) / expected if expected else 0.0
+            verdict = ''
+            if not update and delta > tolerance:
+                verdict = ' REGRESSION'
+                nr_failures += 1
+            print(f'{name:<16} {metric:<36} {expected:>10.2f} '
+                  f'{value:>10.2f} {delta:>+7.1%}{verdict}')
+
+    if update:
+        with open(baseline_path, 'w') as f:
+            json.dump(baseline, f, indent=2)
+            f.write('\n')
+        print(f'baseline written to {baseline_path}')
+        return 0
+    if nr_failures:
+        print(f'{nr_failures} check(s) failed')
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,591 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Helper to put a compositor under synthetic client load
+ *
+ * Maps Wayland (xdg-shell) and X11 windows at a given rate, then keeps
+ * changing their titles, committing new content and causing configures
+ * (maximize toggles for Wayland windows, resize requests for X11 ones)
+ * until the given duration has passed. Combined with the headless backend
+ * and LABWC_PROFILE or the metrics socket this allows stress-testing labwc
+ * with many views and high commit rates.
+ *
+ * Run with -h for options.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include <xcb/xcb.h>
+#include "xdg-shell-client-protocol.h"
+
+#define MAX_CONNECTIONS (64)
+
+struct options {
+	int nr_wayland;         /* Wayland windows */
+	int nr_x11;             /* X11 windows */
+	int nr_connections;     /* Wayland connections to spread windows on */
+	double map_rate;        /* windows mapped per second */
+	int title_interval_ms;  /* 0 disables title changes */
+	int fps;                /* commits per second and window, 0 disables */
+	int configure_interval_ms; /* 0 disables maximize toggles/resizes */
+	int duration_s;
+	int width;
+	int height;
+};
+
+static struct options opts = {
+	.nr_wayland = 20,
+	.nr_x11 = 0,
+	.nr_connections = 1,
+	.map_rate = 10,
+	.title_interval_ms = 500,
+	.fps = 60,
+	.configure_interval_ms = 0,
+	.duration_s = 30,
+	.width = 400,
+	.height = 300,
+};
+
+struct connection {
+	struct wl_display *display;
+	struct wl_compositor *compositor;
+	struct wl_shm *shm;
+	struct xdg_wm_base *wm_base;
+};
+
+struct window {
+	int index;
+	bool mapped;
+	int64_t next_title;
+	int64_t next_commit;
+	int64_t next_configure;
+	uint32_t nr_titles;
+	uint32_t nr_frames;
+
+	/* Wayland */
+	struct connection *conn;
+	struct wl_surface *surface;
+	struct xdg_surface *xdg_surface;
+	struct xdg_toplevel *toplevel;
+	struct wl_buffer *buffer;
+	uint32_t *data;
+	size_t size;
+	int buffer_width;
+	int buffer_height;
+	bool buffer_busy;
+	int width;
+	int height;
+	bool configured;
+	bool maximized;
+
+	/* X11 */
+	xcb_connection_t *xcb;
+	xcb_window_t xid;
+};
+
+static struct connection connections[MAX_CONNECTIONS];
+static struct window *windows;
+static int nr_windows;
+
+static struct {
+	uint64_t commits;
+	uint64_t titles;
+	uint64_t configures;
+} stats;
+
+static int64_t
+now_msec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void
+die(const char *msg)
+{
+	fprintf(stderr, "load-gen: %s\n", msg);
+	exit(EXIT_FAILURE);
+}
+
+/* Wayland */
+
+static void
+handle_buffer_release(void *data, struct wl_buffer *buffer)
+{
+	struct window *window = data;
+	window->buffer_busy = false;
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+	.release = handle_buffer_release,
+};
+
+static void
+buffer_destroy(struct window *window)
+{
+	if (!window->buffer) {
+		return;
+	}
+	wl_buffer_destroy(window->buffer);
+	munmap(window->data, window->size);
+	window->buffer = NULL;
+	window->data = NULL;
+}
+
+static void
+buffer_create(struct window *window, int width, int height)
+{
+	buffer_destroy(window);
+
+	int stride = width * 4;
+	window->size = (size_t)stride * height;
+	int fd = memfd_create("load-gen", MFD_CLOEXEC);
+	if (fd < 0 || ftruncate(fd, window->size) < 0) {
+		die("cannot create shm file");
+	}
+	window->data = mmap(NULL, window->size, PROT_READ | PROT_WRITE,
+		MAP_SHARED, fd, 0);
+	if (window->data == MAP_FAILED) {
+		die("cannot map shm file");
+	}
+	struct wl_shm_pool *pool = wl_shm_create_pool(window->conn->shm, fd,
+		window->size);
+	window->buffer = wl_shm_pool_create_buffer(pool, 0, width, height,
+		stride, WL_SHM_FORMAT_XRGB8888);
+	wl_shm_pool_destroy(pool);
+	close(fd);
+	wl_buffer_add_listener(window->buffer, &buffer_listener, window);
+	window->buffer_width = width;
+	window->buffer_height = height;
+	window->buffer_busy = false;
+}
+
+static void
+window_draw(struct window *window)
+{
+	int width = window->width > 0 ? window->width : opts.width;
+	int height = window->height > 0 ? window->height : opts.height;
+	if (!window->buffer || window->buffer_width != width
+			|| window->buffer_height != height) {
+		buffer_create(window, width, height);
+	}
+
+	/* Only draw into the buffer once the compositor is done with it */
+	if (!window->buffer_busy) {
+		uint32_t color = 0xff000000
+			| ((window->index * 2654435761u) & 0x00ffffff);
+		color ^= (window->nr_frames & 0xff) << 8;
+		size_t nr_pixels = (size_t)width * height;
+		for (size_t i = 0; i < nr_pixels; i++) {
+			window->data[i] = color;
+		}
+	}
+
+	wl_surface_attach(window->surface, window->buffer, 0, 0);
+	wl_surface_damage_buffer(window->surface, 0, 0, width, height);
+	wl_surface_commit(window->surface);
+	window->buffer_busy = true;
+	window->nr_frames++;
+	stats.commits++;
+}
+
+static void
+handle_xdg_surface_configure(void *data, struct xdg_surface *xdg_surface,
+		uint32_t serial)
+{
+	struct window *window = data;
+	xdg_surface_ack_configure(xdg_surface, serial);
+	window->configured = true;
+	window_draw(window);
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+	.configure = handle_xdg_surface_configure,
+};
+
+static void
+handle_toplevel_configure(void *data, struct xdg_toplevel *toplevel,
+		int32_t width, int32_t height, struct wl_array *states)
+{
+	struct window *window = data;
+	window->width = width;
+	window->height = height;
+}
+
+static void
+handle_toplevel_close(void *data, struct xdg_toplevel *toplevel)
+{
+	/* Keep going, the window is destroyed on exit */
+}
+
+static const struct xdg_toplevel_listener toplevel_listener = {
+	.configure = handle_toplevel_configure,
+	.close = handle_toplevel_close,
+};
+
+static void
+handle_wm_base_ping(void *data, struct xdg_wm_base *wm_base, uint32_t serial)
+{
+	xdg_wm_base_pong(wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+	.ping = handle_wm_base_ping,
+};
+
+static void
+handle_global(void *data, struct wl_registry *registry, uint32_t name,
+		const char *interface, uint32_t version)
+{
+	struct connection *conn = data;
+	if (!strcmp(interface, wl_compositor_interface.name)) {
+		conn->compositor = wl_registry_bind(registry, name,
+			&wl_compositor_interface, 4);
+	} else if (!strcmp(interface, wl_shm_interface.name)) {
+		conn->shm = wl_registry_bind(registry, name,
+			&wl_shm_interface, 1);
+	} else if (!strcmp(interface, xdg_wm_base_interface.name)) {
+		conn->wm_base = wl_registry_bind(registry, name,
+			&xdg_wm_base_interface, 1);
+		xdg_wm_base_add_listener(conn->wm_base, &wm_base_listener,
+			NULL);
+	}
+}
+
+static void
+handle_global_remove(void *data, struct wl_registry *registry, uint32_t name)
+{
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = handle_global,
+	.global_remove = handle_global_remove,
+};
+
+static void
+connection_init(struct connection *conn)
+{
+	conn->display = wl_display_connect(NULL);
+	if (!conn->display) {
+		die("cannot connect to the Wayland display");
+	}
+	struct wl_registry *registry = wl_display_get_registry(conn->display);
+	wl_registry_add_listener(registry, &registry_listener, conn);
+	wl_display_roundtrip(conn->display);
+	if (!conn->compositor || !conn->shm || !conn->wm_base) {
+		die("compositor lacks wl_compositor, wl_shm or xdg_wm_base");
+	}
+}
+
+static void
+wayland_window_map(struct window *window)
+{
+	struct connection *conn = window->conn;
+	window->surface = wl_compositor_create_surface(conn->compositor);
+	window->xdg_surface = xdg_wm_base_get_xdg_surface(conn->wm_base,
+		window->surface);
+	xdg_surface_add_listener(window->xdg_surface, &xdg_surface_listener,
+		window);
+	window->toplevel = xdg_surface_get_toplevel(window->xdg_surface);
+	xdg_toplevel_add_listener(window->toplevel, &toplevel_listener, window);
+	xdg_toplevel_set_app_id(window->toplevel, "load-gen");
+	xdg_toplevel_set_title(window->toplevel, "load-gen");
+	wl_surface_commit(window->surface);
+}
+
+/* X11 */
+
+static void
+x11_window_map(struct window *window)
+{
+	window->xcb = xcb_connect(NULL, NULL);
+	if (xcb_connection_has_error(window->xcb)) {
+		die("cannot connect to the X11 display");
+	}
+	xcb_screen_t *screen =
+		xcb_setup_roots_iterator(xcb_get_setup(window->xcb)).data;
+	window->xid = xcb_generate_id(window->xcb);
+	uint32_t values[] = {
+		screen->white_pixel,
+		XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_STRUCTURE_NOTIFY,
+	};
+	xcb_create_window(window->xcb, XCB_COPY_FROM_PARENT, window->xid,
+		screen->root, 0, 0, opts.width, opts.height, 0,
+		XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual,
+		XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK, values);
+	xcb_change_property(window->xcb, XCB_PROP_MODE_REPLACE, window->xid,
+		XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 8, sizeof("load-gen\0load-gen"),
+		"load-gen\0load-gen");
+	xcb_map_window(window->xcb, window->xid);
+	xcb_flush(window->xcb);
+}
+
+/* Common */
+
+static void
+window_set_title(struct window *window)
+{
+	char title[64];
+	snprintf(title, sizeof(title), "load-gen %d: title %u", window->index,
+		window->nr_titles++);
+	if (window->toplevel) {
+		xdg_toplevel_set_title(window->toplevel, title);
+	} else {
+		xcb_change_property(window->xcb, XCB_PROP_MODE_REPLACE,
+			window->xid, XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 8,
+			strlen(title), title);
+	}
+	stats.titles++;
+}
+
+static void
+window_configure(struct window *window)
+{
+	if (window->toplevel) {
+		if (window->maximized) {
+			xdg_toplevel_unset_maximized(window->toplevel);
+		} else {
+			xdg_toplevel_set_maximized(window->toplevel);
+		}
+		window->maximized = !window->maximized;
+	} else {
+		/* Alternate between the initial and a larger size */
+		window->maximized = !window->maximized;
+		uint32_t size[] = {
+			opts.width * (window->maximized ? 2 : 1),
+			opts.height * (window->maximized ? 2 : 1),
+		};
+		xcb_configure_window(window->xcb, window->xid,
+			XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT,
+			size);
+	}
+	stats.configures++;
+}
+
+static void
+window_map(struct window *window, int64_t now)
+{
+	if (window->conn) {
+		wayland_window_map(window);
+	} else {
+		x11_window_map(window);
+	}
+	window->mapped = true;
+	/* Spread the periodic work of all windows over time */
+	int64_t offset = window->index * 7;
+	window->next_title = now + opts.title_interval_ms
+		+ (opts.title_interval_ms ? offset % opts.title_interval_ms : 0);
+	window->next_commit = now + (opts.fps ? 1000 / opts.fps : 0);
+	window->next_configure = now + opts.configure_interval_ms
+		+ (opts.configure_interval_ms
+			? offset % opts.configure_interval_ms : 0);
+}
+
+static int64_t
+window_run(struct window *window, int64_t now)
+{
+	int64_t next = INT64_MAX;
+	if (opts.title_interval_ms) {
+		if (now >= window->next_title) {
+			window_set_title(window);
+			window->next_title = now + opts.title_interval_ms;
+		}
+		next = window->next_title;
+	}
+	if (opts.fps && window->toplevel && window->configured) {
+		if (now >= window->next_commit) {
+			window_draw(window);
+			window->next_commit = now + 1000 / opts.fps;
+		}
+		if (window->next_commit < next) {
+			next = window->next_commit;
+		}
+	}
+	if (opts.configure_interval_ms) {
+		if (now >= window->next_configure) {
+			window_configure(window);
+			window->next_configure = now + opts.configure_interval_ms;
+		}
+		if (window->next_configure < next) {
+			next = window->next_configure;
+		}
+	}
+	if (window->xcb) {
+		xcb_generic_event_t *event;
+		while ((event = xcb_poll_for_event(window->xcb))) {
+			free(event);
+		}
+		xcb_flush(window->xcb);
+	}
+	return next;
+}
+
+static void
+dispatch(int timeout)
+{
+	struct pollfd fds[MAX_CONNECTIONS];
+	for (int i = 0; i < opts.nr_connections; i++) {
+		struct wl_display *display = connections[i].display;
+		wl_display_dispatch_pending(display);
+		if (wl_display_flush(display) < 0 && errno != EAGAIN) {
+			die("lost connection to the compositor");
+		}
+		fds[i] = (struct pollfd){
+			.fd = wl_display_get_fd(display),
+			.events = POLLIN,
+		};
+	}
+	if (poll(fds, opts.nr_connections, timeout) < 0 && errno != EINTR) {
+		die("poll failed");
+	}
+	for (int i = 0; i < opts.nr_connections; i++) {
+		if ((fds[i].revents & POLLIN)
+				&& wl_display_dispatch(connections[i].display) < 0) {
+			die("lost connection to the compositor");
+		}
+	}
+}
+
+static void
+usage(void)
+{
+	printf(
+"Usage: load-gen [options...]\n"
+"  -n <n>     number of Wayland windows (default %d)\n"
+"  -x <n>     number of X11 windows (default %d)\n"
+"  -C <n>     Wayland connections to spread windows on (default %d)\n"
+"  -r <n>     windows mapped per second (default %g)\n"
+"  -t <ms>    interval of title changes, 0 to disable (default %d)\n"
+"  -f <fps>   commits per second and window, 0 to disable (default %d)\n"
+"  -c <ms>    interval of maximize toggles / resizes, 0 to disable (default %d)\n"
+"  -d <s>     duration (default %d)\n"
+"  -s <WxH>   initial window size (default %dx%d)\n",
+		opts.nr_wayland, opts.nr_x11, opts.nr_connections,
+		opts.map_rate, opts.title_interval_ms, opts.fps,
+		opts.configure_interval_ms, opts.duration_s,
+		opts.width, opts.height);
+	exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int c;
+	while ((c = getopt(argc, argv, "n:x:C:r:t:f:c:d:s:h")) != -1) {
+		switch (c) {
+		case 'n':
+			opts.nr_wayland = atoi(optarg);
+			break;
+		case 'x':
+			opts.nr_x11 = atoi(optarg);
+			break;
+		case 'C':
+			opts.nr_connections = atoi(optarg);
+			break;
+		case 'r':
+			opts.map_rate = atof(optarg);
+			break;
+		case 't':
+			opts.title_interval_ms = atoi(optarg);
+			break;
+		case 'f':
+			opts.fps = atoi(optarg);
+			break;
+		case 'c':
+			opts.configure_interval_ms = atoi(optarg);
+			break;
+		case 'd':
+			opts.duration_s = atoi(optarg);
+			break;
+		case 's':
+			if (sscanf(optarg, "%dx%d", &opts.width,
+					&opts.height) != 2) {
+				usage();
+			}
+			break;
+		default:
+			usage();
+		}
+	}
+	if (opts.nr_connections < 1 || opts.nr_connections > MAX_CONNECTIONS
+			|| opts.nr_wayland < 0 || opts.nr_x11 < 0
+			|| opts.map_rate <= 0 || opts.fps < 0 || opts.fps > 1000
+			|| opts.width <= 0 || opts.height <= 0) {
+		usage();
+	}
+
+	for (int i = 0; i < opts.nr_connections; i++) {
+		connection_init(&connections[i]);
+	}
+
+	nr_windows = opts.nr_wayland + opts.nr_x11;
+	windows = calloc(nr_windows ? nr_windows : 1, sizeof(*windows));
+	if (!windows) {
+		die("out of memory");
+	}
+	for (int i = 0; i < nr_windows; i++) {
+		windows[i].index = i;
+		if (i < opts.nr_wayland) {
+			windows[i].conn = &connections[i % opts.nr_connections];
+		}
+	}
+
+	int64_t start = now_msec();
+	int64_t end = start + (int64_t)opts.duration_s * 1000;
+	int nr_mapped = 0;
+	int64_t now;
+	while ((now = now_msec()) < end) {
+		int due = (int)((now - start) * opts.map_rate / 1000.0) + 1;
+		while (nr_mapped < nr_windows && nr_mapped < due) {
+			window_map(&windows[nr_mapped++], now);
+		}
+
+		int64_t next = end;
+		if (nr_mapped < nr_windows) {
+			next = start + (int64_t)(due * 1000 / opts.map_rate);
+		}
+		for (int i = 0; i < nr_mapped; i++) {
+			int64_t window_next = window_run(&windows[i], now);
+			if (window_next < next) {
+				next = window_next;
+			}
+		}
+
+		now = now_msec();
+		dispatch(next > now ? (int)(next - now) : 0);
+	}
+
+	double seconds = (double)(now_msec() - start) / 1000.0;
+	printf("%d windows, %.1fs: %.0f commits/s, %.0f title changes/s, "
+		"%.0f configures/s\n", nr_mapped, seconds,
+		stats.commits / seconds, stats.titles / seconds,
+		stats.configures / seconds);
+
+	for (int i = 0; i < nr_mapped; i++) {
+		struct window *window = &windows[i];
+		if (window->xcb) {
+			xcb_disconnect(window->xcb);
+			continue;
+		}
+		xdg_toplevel_destroy(window->toplevel);
+		xdg_surface_destroy(window->xdg_surface);
+		wl_surface_destroy(window->surface);
+		buffer_destroy(window);
+	}
+	for (int i = 0; i < opts.nr_connections; i++) {
+		wl_display_disconnect(connections[i].display);
+	}
+	free(windows);
+	return 0;
+}
@@ -7,21 +7,29 @@
 #include <unistd.h>
 #include <wlr/util/log.h>
 #include "action.h"
+#include "common/buf.h"
 #include "common/macros.h"
 #include "common/list.h"
 #include "common/mem.h"
 #include "common/parse-bool.h"
+#include "common/parse-double.h"
 #include "common/spawn.h"
 #include "common/string-helpers.h"
 #include "debug.h"
 #include "labwc.h"
+#include "event-loop.h"
+#include "magnifier.h"
 #include "menu/menu.h"
 #include "osd.h"
 #include "output-virtual.h"
+#include "overview.h"
 #include "placement.h"
+#include "profile.h"
 #include "regions.h"
 #include "ssd.h"
+#include "tiling.h"
 #include "view.h"
+#include "view-capture.h"
 #include "workspaces.h"
 
 enum action_arg_type {
@@ -32,10 +40,75 @@ enum action_arg_type {
 	LAB_ACTION_ARG_ACTION_LIST,
 };
 
+/*
+ * Argument keys are resolved once when parsing the config, so that
+ * looking up arguments while running actions is a plain integer compare.
+ */
+enum action_arg_key {
+	ACTION_ARG_INVALID = 0,
+	ACTION_ARG_COMMAND,
+	ACTION_ARG_SNAP_WINDOWS,
+	ACTION_ARG_DIRECTION,
+	ACTION_ARG_MENU,
+	ACTION_ARG_AT_CURSOR,
+	ACTION_ARG_LEFT,
+	ACTION_ARG_RIGHT,
+	ACTION_ARG_TOP,
+	ACTION_ARG_BOTTOM,
+	ACTION_ARG_X,
+	ACTION_ARG_Y,
+	ACTION_ARG_WIDTH,
+	ACTION_ARG_HEIGHT,
+	ACTION_ARG_FOLLOW,
+	ACTION_ARG_TO,
+	ACTION_ARG_WRAP,
+	ACTION_ARG_REGION,
+	ACTION_ARG_OUTPUT,
+	ACTION_ARG_OUTPUT_NAME,
+	ACTION_ARG_REFRESH,
+	ACTION_ARG_SCALE,
+	ACTION_ARG_QUERY,
+	ACTION_ARG_LAYOUT,
+	ACTION_ARG_THEN,
+	ACTION_ARG_ELSE,
+	ACTION_ARG_NONE,
+};
+
+static const char * const action_arg_names[] = {
+	"INVALID",
+	"command",
+	"snapWindows",
+	"direction",
+	"menu",
+	"atCursor",
+	"left",
+	"right",
+	"top",
+	"bottom",
+	"x",
+	"y",
+	"width",
+	"height",
+	"follow",
+	"to",
+	"wrap",
+	"region",
+	"output",
+	"output_name",
+	"refresh",
+	"scale",
+	"query",
+	"layout",
+	"then",
+	"else",
+	"none",
+	NULL
+};
+
 struct action_arg {
 	struct wl_list link;        /* struct action.args */
 
-	char *key;                  /* May be NULL if there is just one arg */
+	enum action_arg_key key;
 	enum action_arg_type type;
 };
 
@@ -65,6 +138,8 @@ enum action_type {
 	ACTION_TYPE_CLOSE,
 	ACTION_TYPE_KILL,
 	ACTION_TYPE_DEBUG,
+	ACTION_TYPE_DEBUG_SCENE_STATS,
+	ACTION_TYPE_DEBUG_TOGGLE_DAMAGE,
 	ACTION_TYPE_EXECUTE,
 	ACTION_TYPE_EXIT,
 	ACTION_TYPE_MOVE_TO_EDGE,
@@ -110,6 +185,11 @@ enum action_type {
 	ACTION_TYPE_SHADE,
 	ACTION_TYPE_UNSHADE,
 	ACTION_TYPE_TOGGLE_SHADE,
+	ACTION_TYPE_TOGGLE_WINDOW_CAPTURE,
+	ACTION_TYPE_TOGGLE_OVERVIEW,
+	ACTION_TYPE_SET_TILING_LAYOUT,
+	ACTION_TYPE_ZOOM_IN,
+	ACTION_TYPE_ZOOM_OUT,
 };
 
 const char *action_names[] = {
@@ -118,6 +198,8 @@ const char *action_names[] = {
 	"Close",
 	"Kill",
 	"Debug",
+	"DebugSceneStats",
+	"DebugToggleDamage",
 	"Execute",
 	"Exit",
 	"MoveToEdge",
@@ -163,54 +245,73 @@ const char *action_names[] = {
 	"Shade",
 	"Unshade",
 	"ToggleShade",
+	"ToggleWindowCapture",
+	"ToggleOverview",
+	"SetTilingLayout",
+	"ZoomIn",
+	"ZoomOut",
 	NULL
 };
 
-void
-action_arg_add_str(struct action *action, const char *key, const char *value)
+static enum action_arg_key
+action_arg_key_from_str(const char *key)
 {
-	assert(action);
 	assert(key);
+	for (size_t i = 1; action_arg_names[i]; i++) {
+		if (!strcasecmp(key, action_arg_names[i])) {
+			return i;
+		}
+	}
+	return ACTION_ARG_INVALID;
+}
+
+static void
+action_arg_add_str(struct action *action, enum action_arg_key key,
+		const char *value)
+{
+	assert(action);
+	assert(key != ACTION_ARG_INVALID);
 	assert(value && "Tried to add NULL action string argument");
 	struct action_arg_str *arg = znew(*arg);
 	arg->base.type = LAB_ACTION_ARG_STR;
-	arg->base.key = xstrdup(key);
+	arg->base.key = key;
 	arg->value = xstrdup(value);
 	wl_list_append(&action->args, &arg->base.link);
 }
 
 static void
-action_arg_add_bool(struct action *action, const char *key, bool value)
+action_arg_add_bool(struct action *action, enum action_arg_key key, bool value)
 {
 	assert(action);
-	assert(key);
+	assert(key != ACTION_ARG_INVALID);
 	struct action_arg_bool *arg = znew(*arg);
 	arg->base.type = LAB_ACTION_ARG_BOOL;
-	arg->base.key = xstrdup(key);
+	arg->base.key = key;
 	arg->value = value;
 	wl_list_append(&action->args, &arg->base.link);
 }
 
 static void
-action_arg_add_int(struct action *action, const char *key, int value)
+action_arg_add_int(struct action *action, enum action_arg_key key, int value)
 {
 	assert(action);
-	assert(key);
+	assert(key != ACTION_ARG_INVALID);
 	struct action_arg_int *arg = znew(*arg);
 	arg->base.type = LAB_ACTION_ARG_INT;
-	arg->base.key = xstrdup(key);
+	arg->base.key = key;
 	arg->value = value;
 	wl_list_append(&action->args, &arg->base.link);
 }
 
 static void
-action_arg_add_list(struct action *action, const char *key, enum action_arg_type type)
+action_arg_add_list(struct action *action, enum action_arg_key key,
+		enum action_arg_type type)
 {
 	assert(action);
-	assert(key);
+	assert(key != ACTION_ARG_INVALID);
 	struct action_arg_list *arg = znew(*arg);
 	arg->base.type = type;
-	arg->base.key = xstrdup(key);
+	arg->base.key = key;
 	wl_list_init(&arg->value);
 	wl_list_append(&action->args, &arg->base.link);
 }
@@ -218,23 +319,25 @@ action_arg_add_list(struct action *action, const char *key, enum action_arg_type
 void
 action_arg_add_querylist(struct action *action, const char *key)
 {
-	action_arg_add_list(action, key, LAB_ACTION_ARG_QUERY_LIST);
+	action_arg_add_list(action, action_arg_key_from_str(key),
+		LAB_ACTION_ARG_QUERY_LIST);
 }
 
 void
 action_arg_add_actionlist(struct action *action, const char *key)
 {
-	action_arg_add_list(action, key, LAB_ACTION_ARG_ACTION_LIST);
+	action_arg_add_list(action, action_arg_key_from_str(key),
+		LAB_ACTION_ARG_ACTION_LIST);
 }
 
 static void *
-action_get_arg(struct action *action, const char *key, enum action_arg_type type)
+action_get_arg(struct action *action, enum action_arg_key key,
+		enum action_arg_type type)
 {
 	assert(action);
-	assert(key);
 	struct action_arg *arg;
 	wl_list_for_each(arg, &action->args, link) {
-		if (!strcasecmp(key, arg->key) && arg->type == type) {
+		if (arg->key == key && arg->type == type) {
 			return arg;
 		}
 	}
@@ -242,38 +345,47 @@ action_get_arg(struct action *action, const char *key, enum action_arg_type type
 }
 
 static const char *
-action_get_str(struct action *action, const char *key, const char *default_value)
+action_get_str(struct action *action, enum action_arg_key key,
+		const char *default_value)
 {
 	struct action_arg_str *arg = action_get_arg(action, key, LAB_ACTION_ARG_STR);
 	return arg ? arg->value : default_value;
 }
 
 static bool
-action_get_bool(struct action *action, const char *key, bool default_value)
+action_get_bool(struct action *action, enum action_arg_key key, bool default_value)
 {
 	struct action_arg_bool *arg = action_get_arg(action, key, LAB_ACTION_ARG_BOOL);
 	return arg ? arg->value : default_value;
 }
 
 static int
-action_get_int(struct action *action, const char *key, int default_value)
+action_get_int(struct action *action, enum action_arg_key key, int default_value)
 {
 	struct action_arg_int *arg = action_get_arg(action, key, LAB_ACTION_ARG_INT);
 	return arg ? arg->value : default_value;
 }
 
+static struct wl_list *
+action_get_list(struct action *action, enum action_arg_key key,
+		enum action_arg_type type)
+{
+	struct action_arg_list *arg = action_get_arg(action, key, type);
+	return arg ? &arg->value : NULL;
+}
+
 struct wl_list *
 action_get_querylist(struct action *action, const char *key)
 {
-	struct action_arg_list *arg = action_get_arg(action, key, LAB_ACTION_ARG_QUERY_LIST);
-	return arg ? &arg->value : NULL;
+	return action_get_list(action, action_arg_key_from_str(key),
+		LAB_ACTION_ARG_QUERY_LIST);
 }
 
 struct wl_list *
 action_get_actionlist(struct action *action, const char *key)
 {
-	struct action_arg_list *arg = action_get_arg(action, key, LAB_ACTION_ARG_ACTION_LIST);
-	return arg ? &arg->value : NULL;
+	return action_get_list(action, action_arg_key_from_str(key),
+		LAB_ACTION_ARG_ACTION_LIST);
 }
 
 void
@@ -283,6 +395,7 @@ action_arg_from_xml_node(struct action *action, const char *nodename, const char
 
 	char *argument = xstrdup(nodename);
 	string_truncate_at_pattern(argument, ".action");
+	enum action_arg_key key = action_arg_key_from_str(argument);
 
 	switch (action->type) {
 	case ACTION_TYPE_EXECUTE:
@@ -292,13 +405,22 @@ action_arg_from_xml_node(struct action *action, const char *nodename, const char
 		 * compatibility with old openbox-menu generators
 		 */
 		if (!strcmp(argument, "command") || !strcmp(argument, "execute")) {
-			action_arg_add_str(action, "command", content);
+			/*
+			 * Expand ~ once here rather than every time the
+			 * action runs. The config is parsed again on
+			 * reconfigure, which picks up a changed $HOME.
+			 */
+			struct buf cmd = BUF_INIT;
+			buf_add(&cmd, content);
+			buf_expand_tilde(&cmd);
+			action_arg_add_str(action, ACTION_ARG_COMMAND, cmd.data);
+			buf_reset(&cmd);
 			goto cleanup;
 		}
 		break;
 	case ACTION_TYPE_MOVE_TO_EDGE:
 		if (!strcasecmp(argument, "snapWindows")) {
-			action_arg_add_bool(action, argument, parse_bool(content, true));
+			action_arg_add_bool(action, key, parse_bool(content, true));
 			goto cleanup;
 		}
 		/* Falls through */
@@ -312,18 +434,18 @@ action_arg_from_xml_node(struct action *action, const char *nodename, const char
 				wlr_log(WLR_ERROR, "Invalid argument for action %s: '%s' (%s)",
 					action_names[action->type], argument, content);
 			} else {
-				action_arg_add_int(action, argument, edge);
+				action_arg_add_int(action, key, edge);
 			}
 			goto cleanup;
 		}
 		break;
 	case ACTION_TYPE_SHOW_MENU:
 		if (!strcmp(argument, "menu")) {
-			action_arg_add_str(action, argument, content);
+			action_arg_add_str(action, key, content);
 			goto cleanup;
 		}
 		if (!strcasecmp(argument, "atCursor")) {
-			action_arg_add_bool(action, argument, parse_bool(content, true));
+			action_arg_add_bool(action, key, parse_bool(content, true));
 			goto cleanup;
 		}
 		break;
@@ -335,7 +457,7 @@ action_arg_from_xml_node(struct action *action, const char *nodename, const char
 				wlr_log(WLR_ERROR, "Invalid argument for action %s: '%s' (%s)",
 					action_names[action->type], argument, content);
 			} else {
-				action_arg_add_int(action, argument, axis);
+				action_arg_add_int(action, key, axis);
 			}
 			goto cleanup;
 		}
@@ -343,54 +465,54 @@ action_arg_from_xml_node(struct action *action, const char *nodename, const char
 	case ACTION_TYPE_RESIZE_RELATIVE:
 		if (!strcmp(argument, "left") || !strcmp(argument, "right") ||
 				!strcmp(argument, "top") || !strcmp(argument, "bottom")) {
-			action_arg_add_int(action, argument, atoi(content));
+			action_arg_add_int(action, key, atoi(content));
 			goto cleanup;
 		}
 		break;
 	case ACTION_TYPE_MOVETO:
 	case ACTION_TYPE_MOVE_RELATIVE:
 		if (!strcmp(argument, "x") || !strcmp(argument, "y")) {
-			action_arg_add_int(action, argument, atoi(content));
+			action_arg_add_int(action, key, atoi(content));
 			goto cleanup;
 		}
 		break;
 	case ACTION_TYPE_RESIZETO:
 		if (!strcmp(argument, "width") || !strcmp(argument, "height")) {
-			action_arg_add_int(action, argument, atoi(content));
+			action_arg_add_int(action, key, atoi(content));
 			goto cleanup;
 		}
 		break;
 	case ACTION_TYPE_SEND_TO_DESKTOP:
 		if (!strcmp(argument, "follow")) {
-			action_arg_add_bool(action, argument, parse_bool(content, true));
+			action_arg_add_bool(action, key, parse_bool(content, true));
 			goto cleanup;
 		}
 		/* Falls through to GoToDesktop */
 	case ACTION_TYPE_GO_TO_DESKTOP:
 		if (!strcmp(argument, "to")) {
-			action_arg_add_str(action, argument, content);
+			action_arg_add_str(action, key, content);
 			goto cleanup;
 		}
 		if (!strcmp(argument, "wrap")) {
-			action_arg_add_bool(action, argument, parse_bool(content, true));
+			action_arg_add_bool(action, key, parse_bool(content, true));
 			goto cleanup;
 		}
 		break;
 	case ACTION_TYPE_SNAP_TO_REGION:
 		if (!strcmp(argument, "region")) {
-			action_arg_add_str(action, argument, content);
+			action_arg_add_str(action, key, content);
 			goto cleanup;
 		}
 		break;
 	case ACTION_TYPE_FOCUS_OUTPUT:
 		if (!strcmp(argument, "output")) {
-			action_arg_add_str(action, argument, content);
+			action_arg_add_str(action, key, content);
 			goto cleanup;
 		}
 		break;
 	case ACTION_TYPE_MOVE_TO_OUTPUT:
 		if (!strcmp(argument, "output")) {
-			action_arg_add_str(action, argument, content);
+			action_arg_add_str(action, key, content);
 			goto cleanup;
 		}
 		if (!strcmp(argument, "direction")) {
@@ -399,19 +521,47 @@ action_arg_from_xml_node(struct action *action, const char *nodename, const char
 				wlr_log(WLR_ERROR, "Invalid argument for action %s: '%s' (%s)",
 					action_names[action->type], argument, content);
 			} else {
-				action_arg_add_int(action, argument, edge);
+				action_arg_add_int(action, key, edge);
 			}
 			goto cleanup;
 		}
 		if (!strcmp(argument, "wrap")) {
-			action_arg_add_bool(action, argument, parse_bool(content, false));
+			action_arg_add_bool(action, key, parse_bool(content, false));
 			goto cleanup;
 		}
 		break;
 	case ACTION_TYPE_VIRTUAL_OUTPUT_ADD:
+		if (!strcmp(argument, "width") || !strcmp(argument, "height")) {
+			action_arg_add_int(action, key, atoi(content));
+			goto cleanup;
+		}
+		if (!strcmp(argument, "refresh")) {
+			/* Given in Hz, stored in mHz like wlroots does */
+			double refresh = 0;
+			set_double(content, &refresh);
+			action_arg_add_int(action, key, MAX(0, refresh * 1000));
+			goto cleanup;
+		}
+		if (!strcmp(argument, "scale")) {
+			action_arg_add_str(action, key, content);
+			goto cleanup;
+		}
+		/* Falls through */
 	case ACTION_TYPE_VIRTUAL_OUTPUT_REMOVE:
 		if (!strcmp(argument, "output_name")) {
-			action_arg_add_str(action, argument, content);
+			action_arg_add_str(action, key, content);
+			goto cleanup;
+		}
+		break;
+	case ACTION_TYPE_SET_TILING_LAYOUT:
+		if (!strcmp(argument, "layout")) {
+			enum tiling_layout layout = tiling_layout_parse(content);
+			if (layout == TILING_LAYOUT_INVALID) {
+				wlr_log(WLR_ERROR, "Invalid argument for action %s: '%s' (%s)",
+					action_names[action->type], argument, content);
+			} else {
+				action_arg_add_int(action, key, layout);
+			}
 			goto cleanup;
 		}
 		break;
@@ -485,42 +635,50 @@ action_list_is_valid(struct wl_list *actions)
 bool
 action_is_valid(struct action *action)
 {
-	const char *arg_name = NULL;
+	enum action_arg_key arg_key = ACTION_ARG_INVALID;
 	enum action_arg_type arg_type = LAB_ACTION_ARG_STR;
 
 	switch (action->type) {
 	case ACTION_TYPE_EXECUTE:
-		arg_name = "command";
+		arg_key = ACTION_ARG_COMMAND;
 		break;
 	case ACTION_TYPE_MOVE_TO_EDGE:
 	case ACTION_TYPE_SNAP_TO_EDGE:
 	case ACTION_TYPE_GROW_TO_EDGE:
 	case ACTION_TYPE_SHRINK_TO_EDGE:
-		arg_name = "direction";
+		arg_key = ACTION_ARG_DIRECTION;
 		arg_type = LAB_ACTION_ARG_INT;
 		break;
 	case ACTION_TYPE_SHOW_MENU:
-		arg_name = "menu";
+		arg_key = ACTION_ARG_MENU;
 		break;
 	case ACTION_TYPE_GO_TO_DESKTOP:
 	case ACTION_TYPE_SEND_TO_DESKTOP:
-		arg_name = "to";
+		arg_key = ACTION_ARG_TO;
 		break;
 	case ACTION_TYPE_SNAP_TO_REGION:
-		arg_name = "region";
+		arg_key = ACTION_ARG_REGION;
 		break;
 	case ACTION_TYPE_FOCUS_OUTPUT:
-		arg_name = "output";
+		arg_key = ACTION_ARG_OUTPUT;
+		break;
+	case ACTION_TYPE_SET_TILING_LAYOUT:
+		arg_key = ACTION_ARG_LAYOUT;
+		arg_type = LAB_ACTION_ARG_INT;
 		break;
 	case ACTION_TYPE_IF:
 	case ACTION_TYPE_FOR_EACH:
 		; /* works around "a label can only be part of a statement" */
-		static const char * const branches[] = { "then", "else", "none" };
+		static const enum action_arg_key branches[] = {
+			ACTION_ARG_THEN, ACTION_ARG_ELSE, ACTION_ARG_NONE
+		};
 		for (size_t i = 0; i < ARRAY_SIZE(branches); i++) {
-			struct wl_list *children = action_get_actionlist(action, branches[i]);
+			struct wl_list *children = action_get_list(action,
+				branches[i], LAB_ACTION_ARG_ACTION_LIST);
 			if (children && !action_list_is_valid(children)) {
 				wlr_log(WLR_ERROR, "Invalid action in %s '%s' branch",
-					action_names[action->type], branches[i]);
+					action_names[action->type],
+					action_arg_names[branches[i]]);
 				return false;
 			}
 		}
@@ -530,12 +688,12 @@ action_is_valid(struct action *action)
 		return true;
 	}
 
-	if (action_get_arg(action, arg_name, arg_type)) {
+	if (action_get_arg(action, arg_key, arg_type)) {
 		return true;
 	}
 
 	wlr_log(WLR_ERROR, "Missing required argument for %s: %s",
-		action_names[action->type], arg_name);
+		action_names[action->type], action_arg_names[arg_key]);
 	return false;
 }
 
@@ -546,7 +704,6 @@ action_free(struct action *action)
 	struct action_arg *arg, *arg_tmp;
 	wl_list_for_each_safe(arg, arg_tmp, &action->args, link) {
 		wl_list_remove(&arg->link);
-		zfree(arg->key);
 		if (arg->type == LAB_ACTION_ARG_STR) {
 			struct action_arg_str *str_arg = (struct action_arg_str *)arg;
 			zfree(str_arg->value);
@@ -641,25 +798,26 @@ run_if_action(struct view *view, struct server *server, struct action *action)
 {
 	struct view_query *query;
 	struct wl_list *queries, *actions;
-	const char *branch = "then";
+	enum action_arg_key branch = ACTION_ARG_THEN;
 
-	queries = action_get_querylist(action, "query");
+	queries = action_get_list(action, ACTION_ARG_QUERY,
+		LAB_ACTION_ARG_QUERY_LIST);
 	if (queries) {
-		branch = "else";
+		branch = ACTION_ARG_ELSE;
 		/* All queries are OR'ed */
 		wl_list_for_each(query, queries, link) {
 			if (view_matches_query(view, query)) {
-				branch = "then";
+				branch = ACTION_ARG_THEN;
 				break;
 			}
 		}
 	}
 
-	actions = action_get_actionlist(action, branch);
+	actions = action_get_list(action, branch, LAB_ACTION_ARG_ACTION_LIST);
 	if (actions) {
 		actions_run(view, server, actions, 0);
 	}
-	return !strcmp(branch, "then");
+	return branch == ACTION_ARG_THEN;
 }
 
 void
@@ -703,31 +861,39 @@ actions_run(struct view *activator, struct server *server,
 			break;
 		case ACTION_TYPE_DEBUG:
 			debug_dump_scene(server);
+			debug_dump_frame_stats(server);
+			xdg_print_configure_stats(server);
+			debug_dump_buffers();
+			profile_print();
+			break;
+		case ACTION_TYPE_DEBUG_SCENE_STATS:
+			debug_dump_scene_stats(server);
+			break;
+		case ACTION_TYPE_DEBUG_TOGGLE_DAMAGE:
+			debug_toggle_damage(server);
 			break;
 		case ACTION_TYPE_EXECUTE:
-			{
-				struct buf cmd = BUF_INIT;
-				buf_add(&cmd, action_get_str(action, "command", NULL));
-				buf_expand_tilde(&cmd);
-				spawn_async_no_shell(cmd.data);
-				buf_reset(&cmd);
-			}
+			/* ~ has already been expanded when parsing the config */
+			spawn_async_no_shell(action_get_str(action, ACTION_ARG_COMMAND, ""));
 			break;
 		case ACTION_TYPE_EXIT:
-			wl_display_terminate(server->wl_display);
+			event_loop_terminate(server->wl_display);
 			break;
 		case ACTION_TYPE_MOVE_TO_EDGE:
 			if (view) {
 				/* Config parsing makes sure that direction is a valid direction */
-				enum view_edge edge = action_get_int(action, "direction", 0);
-				bool snap_to_windows = action_get_bool(action, "snapWindows", true);
+				enum view_edge edge = action_get_int(action,
+					ACTION_ARG_DIRECTION, 0);
+				bool snap_to_windows = action_get_bool(action,
+					ACTION_ARG_SNAP_WINDOWS, true);
 				view_move_to_edge(view, edge, snap_to_windows);
 			}
 			break;
 		case ACTION_TYPE_SNAP_TO_EDGE:
 			if (view) {
 				/* Config parsing makes sure that direction is a valid direction */
-				enum view_edge edge = action_get_int(action, "direction", 0);
+				enum view_edge edge = action_get_int(action,
+					ACTION_ARG_DIRECTION, 0);
 				view_snap_to_edge(view, edge,
 					/*across_outputs*/ true,
 					/*store_natural_geometry*/ true);
@@ -736,14 +902,16 @@ actions_run(struct view *activator, struct server *server,
 		case ACTION_TYPE_GROW_TO_EDGE:
 			if (view) {
 				/* Config parsing makes sure that direction is a valid direction */
-				enum view_edge edge = action_get_int(action, "direction", 0);
+				enum view_edge edge = action_get_int(action,
+					ACTION_ARG_DIRECTION, 0);
 				view_grow_to_edge(view, edge);
 			}
 			break;
 		case ACTION_TYPE_SHRINK_TO_EDGE:
 			if (view) {
 				/* Config parsing makes sure that direction is a valid direction */
-				enum view_edge edge = action_get_int(action, "direction", 0);
+				enum view_edge edge = action_get_int(action,
+					ACTION_ARG_DIRECTION, 0);
 				view_shrink_to_edge(view, edge);
 			}
 			break;
@@ -762,20 +930,20 @@ actions_run(struct view *activator, struct server *server,
 			break;
 		case ACTION_TYPE_SHOW_MENU:
 			show_menu(server, view,
-				action_get_str(action, "menu", NULL),
-				action_get_bool(action, "atCursor", true));
+				action_get_str(action, ACTION_ARG_MENU, NULL),
+				action_get_bool(action, ACTION_ARG_AT_CURSOR, true));
 			break;
 		case ACTION_TYPE_TOGGLE_MAXIMIZE:
 			if (view) {
 				enum view_axis axis = action_get_int(action,
-					"direction", VIEW_AXIS_BOTH);
+					ACTION_ARG_DIRECTION, VIEW_AXIS_BOTH);
 				view_toggle_maximize(view, axis);
 			}
 			break;
 		case ACTION_TYPE_MAXIMIZE:
 			if (view) {
 				enum view_axis axis = action_get_int(action,
-					"direction", VIEW_AXIS_BOTH);
+					ACTION_ARG_DIRECTION, VIEW_AXIS_BOTH);
 				view_maximize(view, axis,
 					/*store_natural_geometry*/ true);
 			}
@@ -841,24 +1009,24 @@ actions_run(struct view *activator, struct server *server,
 			break;
 		case ACTION_TYPE_RESIZE_RELATIVE:
 			if (view) {
-				int left = action_get_int(action, "left", 0);
-				int right = action_get_int(action, "right", 0);
-				int top = action_get_int(action, "top", 0);
-				int bottom = action_get_int(action, "bottom", 0);
+				int left = action_get_int(action, ACTION_ARG_LEFT, 0);
+				int right = action_get_int(action, ACTION_ARG_RIGHT, 0);
+				int top = action_get_int(action, ACTION_ARG_TOP, 0);
+				int bottom = action_get_int(action, ACTION_ARG_BOTTOM, 0);
 				view_resize_relative(view, left, right, top, bottom);
 			}
 			break;
 		case ACTION_TYPE_MOVETO:
 			if (view) {
-				int x = action_get_int(action, "x", 0);
-				int y = action_get_int(action, "y", 0);
+				int x = action_get_int(action, ACTION_ARG_X, 0);
+				int y = action_get_int(action, ACTION_ARG_Y, 0);
 				view_move(view, x, y);
 			}
 			break;
 		case ACTION_TYPE_RESIZETO:
 			if (view) {
-				int width = action_get_int(action, "width", 0);
-				int height = action_get_int(action, "height", 0);
+				int width = action_get_int(action, ACTION_ARG_WIDTH, 0);
+				int height = action_get_int(action, ACTION_ARG_HEIGHT, 0);
 
 				/*
 				 * To support only setting one of width/height
@@ -877,8 +1045,8 @@ actions_run(struct view *activator, struct server *server,
 			break;
 		case ACTION_TYPE_MOVE_RELATIVE:
 			if (view) {
-				int x = action_get_int(action, "x", 0);
-				int y = action_get_int(action, "y", 0);
+				int x = action_get_int(action, ACTION_ARG_X, 0);
+				int y = action_get_int(action, ACTION_ARG_Y, 0);
 				view_move_relative(view, x, y);
 			}
 			break;
@@ -895,8 +1063,8 @@ actions_run(struct view *activator, struct server *server,
 		case ACTION_TYPE_GO_TO_DESKTOP:
 			{
 				bool follow = true;
-				bool wrap = action_get_bool(action, "wrap", true);
-				const char *to = action_get_str(action, "to", NULL);
+				bool wrap = action_get_bool(action, ACTION_ARG_WRAP, true);
+				const char *to = action_get_str(action, ACTION_ARG_TO, NULL);
 				/*
 				 * `to` is always != NULL here because otherwise we would have
 				 * removed the action during the initial parsing step as it is
@@ -909,7 +1077,7 @@ actions_run(struct view *activator, struct server *server,
 				}
 				if (action->type == ACTION_TYPE_SEND_TO_DESKTOP) {
 					view_move_to_workspace(view, target);
-					follow = action_get_bool(action, "follow", true);
+					follow = action_get_bool(action, ACTION_ARG_FOLLOW, true);
 				}
 				if (follow) {
 					workspaces_switch_to(target,
@@ -921,13 +1089,14 @@ actions_run(struct view *activator, struct server *server,
 			if (!view) {
 				break;
 			}
-			const char *output_name = action_get_str(action, "output", NULL);
+			const char *output_name = action_get_str(action, ACTION_ARG_OUTPUT, NULL);
 			struct output *target = NULL;
 			if (output_name) {
 				target = output_from_name(view->server, output_name);
 			} else {
-				enum view_edge edge = action_get_int(action, "direction", 0);
-				bool wrap = action_get_bool(action, "wrap", false);
+				enum view_edge edge = action_get_int(action,
+					ACTION_ARG_DIRECTION, 0);
+				bool wrap = action_get_bool(action, ACTION_ARG_WRAP, false);
 				target = view_get_adjacent_output(view, edge, wrap);
 			}
 			if (!target) {
@@ -955,7 +1124,7 @@ actions_run(struct view *activator, struct server *server,
 			if (!output) {
 				break;
 			}
-			const char *region_name = action_get_str(action, "region", NULL);
+			const char *region_name = action_get_str(action, ACTION_ARG_REGION, NULL);
 			struct region *region = regions_from_name(region_name, output);
 			if (region) {
 				view_snap_to_region(view, region,
@@ -971,7 +1140,8 @@ actions_run(struct view *activator, struct server *server,
 			break;
 		case ACTION_TYPE_FOCUS_OUTPUT:
 			{
-				const char *output_name = action_get_str(action, "output", NULL);
+				const char *output_name = action_get_str(action,
+					ACTION_ARG_OUTPUT, NULL);
 				desktop_focus_output(output_from_name(server, output_name));
 			}
 			break;
@@ -990,10 +1160,10 @@ actions_run(struct view *activator, struct server *server,
 				wl_array_for_each(item, &views) {
 					matches |= run_if_action(*item, server, action);
 				}
-				wl_array_release(&views);
 				if (!matches) {
 					struct wl_list *actions;
-					actions = action_get_actionlist(action, "none");
+					actions = action_get_list(action, ACTION_ARG_NONE,
+						LAB_ACTION_ARG_ACTION_LIST);
 					if (actions) {
 						actions_run(view, server, actions, 0);
 					}
@@ -1002,16 +1172,29 @@ actions_run(struct view *activator, struct server *server,
 			break;
 		case ACTION_TYPE_VIRTUAL_OUTPUT_ADD:
 			{
-				const char *output_name = action_get_str(action, "output_name",
-						NULL);
-				output_virtual_add(server, output_name,
+				const char *output_name = action_get_str(action,
+					ACTION_ARG_OUTPUT_NAME, NULL);
+				struct output_virtual_mode mode = {
+					.width = action_get_int(action,
+						ACTION_ARG_WIDTH, 0),
+					.height = action_get_int(action,
+						ACTION_ARG_HEIGHT, 0),
+					.refresh = action_get_int(action,
+						ACTION_ARG_REFRESH, 0),
+				};
+				const char *scale = action_get_str(action,
+					ACTION_ARG_SCALE, NULL);
+				if (scale) {
+					set_float(scale, &mode.scale);
+				}
+				output_virtual_add(server, output_name, &mode,
 					/*store_wlr_output*/ NULL);
 			}
 			break;
 		case ACTION_TYPE_VIRTUAL_OUTPUT_REMOVE:
 			{
-				const char *output_name = action_get_str(action, "output_name",
-						NULL);
+				const char *output_name = action_get_str(action,
+					ACTION_ARG_OUTPUT_NAME, NULL);
 				output_virtual_remove(server, output_name);
 			}
 			break;
@@ -1045,6 +1228,25 @@ actions_run(struct view *activator, struct server *server,
 				view_set_shade(view, false);
 			}
 			break;
+		case ACTION_TYPE_TOGGLE_WINDOW_CAPTURE:
+			if (view) {
+				view_capture_toggle(view);
+			}
+			break;
+		case ACTION_TYPE_TOGGLE_OVERVIEW:
+			overview_toggle(server);
+			break;
+		case ACTION_TYPE_SET_TILING_LAYOUT:
+			tiling_set_layout(server->workspace_current,
+				action_get_int(action, ACTION_ARG_LAYOUT,
+					TILING_LAYOUT_NONE));
+			break;
+		case ACTION_TYPE_ZOOM_IN:
+			magnifier_zoom(server, true);
+			break;
+		case ACTION_TYPE_ZOOM_OUT:
+			magnifier_zoom(server, false);
+			break;
 		case ACTION_TYPE_INVALID:
 			wlr_log(WLR_ERROR, "Not executing unknown action");
 			break;
@@ -0,0 +1,229 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include "adaptive-sync.h"
+#include "common/macros.h"
+#include "common/time-helpers.h"
+#include "common/timers.h"
+#include "config/rcxml.h"
+#include "labwc.h"
+#include "view.h"
+#include "window-rules.h"
+
+/* Upper bounds of the histogram buckets in ms, the last bucket is open */
+static const int bucket_limit_ms[ADAPTIVE_SYNC_NR_BUCKETS - 1] = {
+	8, 12, 18, 26, 36, 50, 100,
+};
+
+/*
+ * Intervals in the buckets below 50 ms count as continuous rendering.
+ * This covers 24 fps video (~42 ms) as well as games, but not the
+ * sporadic updates of desktop content which cause flicker with VRR.
+ */
+#define CONTINUOUS_BUCKETS (6)
+
+/*
+ * Hysteresis: adaptive sync is enabled once this percentage of the
+ * intervals is continuous and disabled again when it drops below the
+ * keep percentage.
+ */
+#define ENABLE_PERCENT (90)
+#define KEEP_PERCENT (50)
+
+/* Adaptive sync is disabled if the view does not commit for this long */
+#define IDLE_TIMEOUT_MS (500)
+
+static void
+reset_samples(struct adaptive_sync *state)
+{
+	state->last_commit_nsec = 0;
+	state->head = 0;
+	state->count = 0;
+	for (size_t i = 0; i < ARRAY_SIZE(state->histogram); i++) {
+		state->histogram[i] = 0;
+	}
+}
+
+static size_t
+interval_bucket(int64_t interval_nsec)
+{
+	size_t i;
+	for (i = 0; i < ARRAY_SIZE(bucket_limit_ms); i++) {
+		if (interval_nsec < bucket_limit_ms[i] * NSEC_PER_MSEC) {
+			break;
+		}
+	}
+	return i;
+}
+
+static void
+set_enabled(struct output *output, bool enabled)
+{
+	struct adaptive_sync *state = &output->adaptive_sync;
+	if (state->enabled == enabled) {
+		return;
+	}
+	state->enabled = enabled;
+	/* Applied with the next frame of the output */
+	output_enable_adaptive_sync(output->wlr_output, enabled);
+}
+
+static enum property
+get_rule(struct adaptive_sync *state)
+{
+	return window_rules_get_property(state->view,
+		LAB_RULE_PROP_ADAPTIVE_SYNC);
+}
+
+static void
+evaluate(struct output *output)
+{
+	struct adaptive_sync *state = &output->adaptive_sync;
+	if (!state->view) {
+		set_enabled(output, false);
+		return;
+	}
+
+	switch (get_rule(state)) {
+	case LAB_PROP_TRUE:
+		set_enabled(output, true);
+		return;
+	case LAB_PROP_FALSE:
+		set_enabled(output, false);
+		return;
+	default:
+		break;
+	}
+
+	/* No need to measure if the client tells what it shows */
+	switch (view_get_content_type(state->view)) {
+	case WP_CONTENT_TYPE_V1_TYPE_GAME:
+	case WP_CONTENT_TYPE_V1_TYPE_VIDEO:
+		set_enabled(output, true);
+		return;
+	case WP_CONTENT_TYPE_V1_TYPE_PHOTO:
+		set_enabled(output, false);
+		return;
+	default:
+		break;
+	}
+
+	/* Wait for enough samples before changing anything */
+	if (state->count < ADAPTIVE_SYNC_NR_SAMPLES / 2) {
+		return;
+	}
+
+	uint32_t continuous = 0;
+	for (size_t i = 0; i < CONTINUOUS_BUCKETS; i++) {
+		continuous += state->histogram[i];
+	}
+	size_t percent = continuous * 100 / state->count;
+	if (state->enabled) {
+		set_enabled(output, percent >= KEEP_PERCENT);
+	} else {
+		set_enabled(output, percent >= ENABLE_PERCENT);
+	}
+}
+
+static int
+handle_idle_timeout(void *data)
+{
+	struct output *output = data;
+	struct adaptive_sync *state = &output->adaptive_sync;
+
+	/* Content is static, start measuring from scratch */
+	reset_samples(state);
+	if (!state->view || get_rule(state) != LAB_PROP_TRUE) {
+		set_enabled(output, false);
+	}
+	return 0;
+}
+
+void
+adaptive_sync_view_commit(struct view *view)
+{
+	if (rc.adaptive_sync != LAB_ADAPTIVE_SYNC_AUTO) {
+		return;
+	}
+	struct output *output = view->output;
+	if (!output_is_usable(output) || output->adaptive_sync.view != view) {
+		return;
+	}
+
+	struct adaptive_sync *state = &output->adaptive_sync;
+	int64_t now = time_now_nsec();
+	if (state->last_commit_nsec) {
+		size_t bucket = interval_bucket(now - state->last_commit_nsec);
+		if (state->count == ADAPTIVE_SYNC_NR_SAMPLES) {
+			/* Drop the oldest sample */
+			state->histogram[state->samples[state->head]]--;
+		} else {
+			state->count++;
+		}
+		state->samples[state->head] = bucket;
+		state->histogram[bucket]++;
+		state->head = (state->head + 1) % ADAPTIVE_SYNC_NR_SAMPLES;
+	}
+	state->last_commit_nsec = now;
+
+	timers_update(state->idle_timer, IDLE_TIMEOUT_MS);
+	evaluate(output);
+}
+
+void
+adaptive_sync_update(struct output *output)
+{
+	if (rc.adaptive_sync != LAB_ADAPTIVE_SYNC_AUTO
+			|| !output_is_usable(output)) {
+		return;
+	}
+
+	struct adaptive_sync *state = &output->adaptive_sync;
+	struct view *view = output_get_fullscreen_view(output);
+	if (view != state->view) {
+		state->view = view;
+		reset_samples(state);
+	}
+
+	if (!state->idle_timer) {
+		state->idle_timer = timers_add(output->server->wl_event_loop,
+			handle_idle_timeout, output);
+	}
+	timers_update(state->idle_timer, view ? IDLE_TIMEOUT_MS : 0);
+	evaluate(output);
+}
+
+void
+adaptive_sync_update_all(struct server *server)
+{
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		adaptive_sync_update(output);
+	}
+}
+
+void
+adaptive_sync_on_view_destroy(struct view *view)
+{
+	assert(view);
+	struct output *output;
+	wl_list_for_each(output, &view->server->outputs, link) {
+		struct adaptive_sync *state = &output->adaptive_sync;
+		if (state->view == view) {
+			state->view = NULL;
+			reset_samples(state);
+			timers_update(state->idle_timer, 0);
+			evaluate(output);
+		}
+	}
+}
+
+void
+adaptive_sync_on_output_destroy(struct output *output)
+{
+	struct adaptive_sync *state = &output->adaptive_sync;
+	if (state->idle_timer) {
+		timers_remove(state->idle_timer);
+		state->idle_timer = NULL;
+	}
+	state->view = NULL;
+}
@@ -25,12 +25,68 @@
  */
 
 #include <assert.h>
+#include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <drm_fourcc.h>
 #include <wlr/interfaces/wlr_buffer.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/drm_format_set.h>
+#include <wlr/util/log.h>
 #include "buffer.h"
+#include "common/hash.h"
+#include "common/macros.h"
 #include "common/mem.h"
 
+/*
+ * Buffers passed to buffer_intern(), keyed by a hash of their pixels.
+ * Theme buffers are often identical, for example active and inactive
+ * buttons of the same color or their hover fallbacks, and interning
+ * makes them share one wlr_buffer and its pixel memory.
+ */
+struct interned_buffer {
+	uint64_t hash;
+	int refcount;
+	struct lab_data_buffer *buffer;
+	struct wl_list link; /* interned_buffers */
+};
+
+static struct wl_list interned_buffers;
+
+/*
+ * Mapping an allocator buffer costs a few syscalls and possibly a dmabuf,
+ * which is only worth it for large buffers like menus or OSDs. Smaller
+ * buffers, for example most titles and buttons, stay on the heap.
+ */
+#define ALLOCATOR_MIN_PIXELS (256 * 256)
+
+/* Live lab_data_buffers and their pixel memory, by category */
+static struct {
+	size_t nr_buffers[LAB_BUFFER_NR_CATEGORIES];
+	size_t bytes[LAB_BUFFER_NR_CATEGORIES];
+	size_t nr_interned;
+	size_t nr_intern_hits;
+} accounting;
+
+static const char *const category_names[] = {
+	[LAB_BUFFER_OTHER] = "other",
+	[LAB_BUFFER_TEXT] = "text",
+	[LAB_BUFFER_BUTTON] = "button",
+	[LAB_BUFFER_CORNER] = "corner",
+	[LAB_BUFFER_RESIZE_INDICATOR] = "resize-indicator",
+};
+
+static_assert(ARRAY_SIZE(category_names) == LAB_BUFFER_NR_CATEGORIES,
+	"every category needs a name");
+
+static struct {
+	struct wlr_allocator *allocator;
+	struct wlr_drm_format_set formats;
+	/* Cleared after the first failure to map a buffer */
+	bool mappable;
+} backing;
+
 static const struct wlr_buffer_impl data_buffer_impl;
 
 static struct lab_data_buffer *
@@ -40,10 +96,30 @@ data_buffer_from_buffer(struct wlr_buffer *buffer)
 	return (struct lab_data_buffer *)buffer;
 }
 
+static size_t
+buffer_bytes(struct lab_data_buffer *buffer)
+{
+	return buffer->stride * buffer->base.height;
+}
+
+static void
+account(struct lab_data_buffer *buffer, bool add)
+{
+	enum lab_buffer_category category = buffer->category;
+	if (add) {
+		accounting.nr_buffers[category]++;
+		accounting.bytes[category] += buffer_bytes(buffer);
+	} else {
+		accounting.nr_buffers[category]--;
+		accounting.bytes[category] -= buffer_bytes(buffer);
+	}
+}
+
 static void
 data_buffer_destroy(struct wlr_buffer *wlr_buffer)
 {
 	struct lab_data_buffer *buffer = data_buffer_from_buffer(wlr_buffer);
+	account(buffer, false);
 	if (!buffer->free_on_destroy) {
 		free(buffer);
 		return;
@@ -52,7 +128,12 @@ data_buffer_destroy(struct wlr_buffer *wlr_buffer)
 		cairo_surface_t *surf = cairo_get_target(buffer->cairo);
 		cairo_destroy(buffer->cairo);
 		cairo_surface_destroy(surf);
-	} else if (buffer->data) {
+	}
+	if (buffer->backing) {
+		/* @data belongs to the mapping */
+		wlr_buffer_end_data_ptr_access(buffer->backing);
+		wlr_buffer_drop(buffer->backing);
+	} else if (!buffer->cairo && buffer->data) {
 		free(buffer->data);
 		buffer->data = NULL;
 	}
@@ -78,12 +159,89 @@ data_buffer_end_data_ptr_access(struct wlr_buffer *wlr_buffer)
 	/* noop */
 }
 
+static bool
+data_buffer_get_dmabuf(struct wlr_buffer *wlr_buffer,
+		struct wlr_dmabuf_attributes *attribs)
+{
+	struct lab_data_buffer *buffer = data_buffer_from_buffer(wlr_buffer);
+	return buffer->backing && wlr_buffer_get_dmabuf(buffer->backing, attribs);
+}
+
 static const struct wlr_buffer_impl data_buffer_impl = {
 	.destroy = data_buffer_destroy,
+	.get_dmabuf = data_buffer_get_dmabuf,
 	.begin_data_ptr_access = data_buffer_begin_data_ptr_access,
 	.end_data_ptr_access = data_buffer_end_data_ptr_access,
 };
 
+void
+buffer_set_allocator(struct wlr_allocator *allocator)
+{
+	wlr_drm_format_set_finish(&backing.formats);
+	backing.allocator = allocator;
+	backing.mappable = false;
+	if (!allocator) {
+		return;
+	}
+	/* cairo needs a linear layout to draw into the mapping */
+	if (!wlr_drm_format_set_add(&backing.formats, DRM_FORMAT_ARGB8888,
+			DRM_FORMAT_MOD_LINEAR)) {
+		return;
+	}
+	backing.mappable = true;
+}
+
+/*
+ * Allocates the pixels of @buffer from the allocator and keeps them mapped
+ * for the lifetime of @buffer. The renderer never sees the mapping, it
+ * gets our own data pointer or the dmabuf of the backing buffer.
+ */
+static cairo_surface_t *
+create_backing(struct lab_data_buffer *buffer, uint32_t width,
+		uint32_t height)
+{
+	const struct wlr_drm_format *format =
+		wlr_drm_format_set_get(&backing.formats, DRM_FORMAT_ARGB8888);
+	struct wlr_buffer *wlr_buffer = wlr_allocator_create_buffer(
+		backing.allocator, width, height, format);
+	if (!wlr_buffer) {
+		goto err;
+	}
+
+	void *data;
+	uint32_t data_format;
+	size_t stride;
+	if (!wlr_buffer_begin_data_ptr_access(wlr_buffer,
+			WLR_BUFFER_DATA_PTR_ACCESS_READ
+			| WLR_BUFFER_DATA_PTR_ACCESS_WRITE,
+			&data, &data_format, &stride)) {
+		wlr_buffer_drop(wlr_buffer);
+		goto err;
+	}
+	if (data_format != DRM_FORMAT_ARGB8888 || stride > INT_MAX
+			|| stride < (size_t)cairo_format_stride_for_width(
+				CAIRO_FORMAT_ARGB32, width)) {
+		goto err_access;
+	}
+	cairo_surface_t *surf = cairo_image_surface_create_for_data(data,
+		CAIRO_FORMAT_ARGB32, width, height, stride);
+	if (cairo_surface_status(surf) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy(surf);
+		goto err_access;
+	}
+	buffer->backing = wlr_buffer;
+	return surf;
+
+err_access:
+	wlr_buffer_end_data_ptr_access(wlr_buffer);
+	wlr_buffer_drop(wlr_buffer);
+err:
+	/* Don't try again for every buffer, e.g. GBM can't be mapped */
+	wlr_log(WLR_INFO, "allocator buffers can not be mapped, using heap");
+	backing.mappable = false;
+	return NULL;
+}
+
 struct lab_data_buffer *
 buffer_create_cairo(uint32_t width, uint32_t height, float scale,
 	bool free_on_destroy)
@@ -96,8 +254,15 @@ buffer_create_cairo(uint32_t width, uint32_t height, float scale,
 
 	/* Allocate the buffer with the scaled size */
 	wlr_buffer_init(&buffer->base, &data_buffer_impl, width, height);
-	cairo_surface_t *surf =
-		cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+	cairo_surface_t *surf = NULL;
+	if (backing.mappable && free_on_destroy
+			&& (uint64_t)width * height >= ALLOCATOR_MIN_PIXELS) {
+		surf = create_backing(buffer, width, height);
+	}
+	if (!surf) {
+		surf = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+			width, height);
+	}
 
 	/**
 	 * Tell cairo about the device scale so we can keep drawing in unscaled
@@ -117,9 +282,14 @@ buffer_create_cairo(uint32_t width, uint32_t height, float scale,
 	if (!buffer->data) {
 		cairo_destroy(buffer->cairo);
 		cairo_surface_destroy(surf);
+		if (buffer->backing) {
+			wlr_buffer_end_data_ptr_access(buffer->backing);
+			wlr_buffer_drop(buffer->backing);
+		}
 		free(buffer);
-		buffer = NULL;
+		return NULL;
 	}
+	account(buffer, true);
 	return buffer;
 }
 
@@ -135,5 +305,150 @@ buffer_create_wrap(void *pixel_data, uint32_t width, uint32_t height,
 	buffer->format = DRM_FORMAT_ARGB8888;
 	buffer->stride = stride;
 	buffer->free_on_destroy = free_on_destroy;
+	account(buffer, true);
 	return buffer;
 }
+
+void
+buffer_set_category(struct lab_data_buffer *buffer,
+		enum lab_buffer_category category)
+{
+	assert(category < LAB_BUFFER_NR_CATEGORIES);
+	if (!buffer) {
+		return;
+	}
+	account(buffer, false);
+	buffer->category = category;
+	account(buffer, true);
+}
+
+void
+buffer_print_stats(void)
+{
+	printf("Buffers\n");
+	printf("   %-18s %8s %12s\n", "category", "buffers", "KiB");
+	size_t nr_buffers = 0;
+	size_t bytes = 0;
+	for (size_t i = 0; i < LAB_BUFFER_NR_CATEGORIES; i++) {
+		printf("   %-18s %8zu %12zu\n", category_names[i],
+			accounting.nr_buffers[i], accounting.bytes[i] / 1024);
+		nr_buffers += accounting.nr_buffers[i];
+		bytes += accounting.bytes[i];
+	}
+	printf("   %-18s %8zu %12zu\n", "total", nr_buffers, bytes / 1024);
+	printf("   interned: %zu buffers, %zu hits\n", accounting.nr_interned,
+		accounting.nr_intern_hits);
+}
+
+static size_t
+row_len(struct lab_data_buffer *buffer)
+{
+	/* Both constructors only ever create 32-bit pixels */
+	return (size_t)buffer->base.width * 4;
+}
+
+static uint64_t
+hash_pixels(struct lab_data_buffer *buffer)
+{
+	uint64_t hash = HASH_INIT;
+	hash = hash_value(hash, buffer->base.width);
+	hash = hash_value(hash, buffer->base.height);
+	hash = hash_value(hash, buffer->format);
+	/* Skip the padding at the end of each row */
+	const unsigned char *row = buffer->data;
+	for (int y = 0; y < buffer->base.height; y++) {
+		hash = hash_data(hash, row, row_len(buffer));
+		row += buffer->stride;
+	}
+	return hash;
+}
+
+static bool
+pixels_equal(struct lab_data_buffer *a, struct lab_data_buffer *b)
+{
+	if (a->base.width != b->base.width || a->base.height != b->base.height
+			|| a->format != b->format
+			|| a->unscaled_width != b->unscaled_width
+			|| a->unscaled_height != b->unscaled_height) {
+		return false;
+	}
+	const unsigned char *row_a = a->data;
+	const unsigned char *row_b = b->data;
+	for (int y = 0; y < a->base.height; y++) {
+		if (memcmp(row_a, row_b, row_len(a))) {
+			return false;
+		}
+		row_a += a->stride;
+		row_b += b->stride;
+	}
+	return true;
+}
+
+static struct interned_buffer *
+interned_buffer_find(struct lab_data_buffer *buffer)
+{
+	if (!interned_buffers.next) {
+		wl_list_init(&interned_buffers);
+	}
+	struct interned_buffer *entry;
+	wl_list_for_each(entry, &interned_buffers, link) {
+		if (entry->buffer == buffer) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+struct lab_data_buffer *
+buffer_intern(struct lab_data_buffer *buffer)
+{
+	if (!buffer || !buffer->data) {
+		return buffer;
+	}
+	if (buffer->cairo) {
+		cairo_surface_flush(cairo_get_target(buffer->cairo));
+	}
+
+	struct interned_buffer *entry = interned_buffer_find(buffer);
+	if (entry) {
+		/* Interning the same buffer twice just adds a user */
+		entry->refcount++;
+		return buffer;
+	}
+
+	uint64_t hash = hash_pixels(buffer);
+	wl_list_for_each(entry, &interned_buffers, link) {
+		if (entry->hash == hash && pixels_equal(entry->buffer, buffer)) {
+			entry->refcount++;
+			accounting.nr_intern_hits++;
+			wlr_buffer_drop(&buffer->base);
+			return entry->buffer;
+		}
+	}
+
+	entry = znew(*entry);
+	entry->hash = hash;
+	entry->refcount = 1;
+	entry->buffer = buffer;
+	wl_list_insert(&interned_buffers, &entry->link);
+	accounting.nr_interned++;
+	return buffer;
+}
+
+void
+buffer_intern_drop(struct lab_data_buffer *buffer)
+{
+	if (!buffer) {
+		return;
+	}
+	struct interned_buffer *entry = interned_buffer_find(buffer);
+	if (entry) {
+		if (--entry->refcount > 0) {
+			return;
+		}
+		wl_list_remove(&entry->link);
+		free(entry);
+		accounting.nr_interned--;
+	}
+	wlr_buffer_drop(&buffer->base);
+}
@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include "config.h"
+#include <cairo.h>
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <wayland-util.h>
+#include "button/button-cache.h"
+#include "button/button-png.h"
+#include "common/mem.h"
+#if HAVE_RSVG
+#include "button/button-svg.h"
+#endif
+
+/* Themes have at most a few dozen button images */
+#define BUTTON_CACHE_SIZE (64)
+
+struct button_cache_entry {
+	char *path;
+	int size;
+	struct timespec mtime;
+	off_t file_size;
+	cairo_surface_t *image;
+	struct wl_list link; /* button_cache.entries */
+};
+
+static struct {
+	struct wl_list entries; /* most recently used first */
+	int nr_entries;
+} button_cache;
+
+struct preload_job {
+	char *path;
+	int size;
+	cairo_surface_t *image; /* result */
+	struct wl_list link; /* preload.jobs */
+};
+
+static struct {
+	GThreadPool *pool;
+	struct wl_list jobs;
+} preload;
+
+static void
+entry_destroy(struct button_cache_entry *entry)
+{
+	wl_list_remove(&entry->link);
+	cairo_surface_destroy(entry->image);
+	free(entry->path);
+	free(entry);
+	button_cache.nr_entries--;
+}
+
+static struct button_cache_entry *
+entry_find(const char *path, int size)
+{
+	if (!button_cache.entries.next) {
+		wl_list_init(&button_cache.entries);
+	}
+	struct button_cache_entry *entry;
+	wl_list_for_each(entry, &button_cache.entries, link) {
+		if (entry->size == size && !strcmp(entry->path, path)) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+cairo_surface_t *
+button_cache_get(const char *path, int size)
+{
+	struct button_cache_entry *entry = entry_find(path, size);
+	if (!entry) {
+		return NULL;
+	}
+
+	struct stat st;
+	if (stat(path, &st) || st.st_size != entry->file_size
+			|| st.st_mtim.tv_sec != entry->mtime.tv_sec
+			|| st.st_mtim.tv_nsec != entry->mtime.tv_nsec) {
+		/* Removed or modified */
+		entry_destroy(entry);
+		return NULL;
+	}
+
+	/* Move to front */
+	wl_list_remove(&entry->link);
+	wl_list_insert(&button_cache.entries, &entry->link);
+	return cairo_surface_reference(entry->image);
+}
+
+void
+button_cache_add(const char *path, int size, cairo_surface_t *image)
+{
+	struct stat st;
+	if (stat(path, &st)) {
+		return;
+	}
+
+	struct button_cache_entry *entry = entry_find(path, size);
+	if (entry) {
+		entry_destroy(entry);
+	} else if (button_cache.nr_entries >= BUTTON_CACHE_SIZE) {
+		entry = wl_container_of(button_cache.entries.prev, entry, link);
+		entry_destroy(entry);
+	}
+
+	entry = znew(*entry);
+	entry->path = xstrdup(path);
+	entry->size = size;
+	entry->mtime = st.st_mtim;
+	entry->file_size = st.st_size;
+	entry->image = cairo_surface_reference(image);
+	wl_list_insert(&button_cache.entries, &entry->link);
+	button_cache.nr_entries++;
+}
+
+/* Runs in a worker thread */
+static void
+preload_decode(gpointer data, gpointer user_data)
+{
+	struct preload_job *job = data;
+#if HAVE_RSVG
+	if (job->size) {
+		job->image = button_svg_render(job->path, job->size);
+		return;
+	}
+#endif
+	job->image = button_png_decode(job->path);
+}
+
+void
+button_cache_preload(const char *path, int size)
+{
+#if !HAVE_RSVG
+	if (size) {
+		return;
+	}
+#endif
+	cairo_surface_t *image = button_cache_get(path, size);
+	if (image) {
+		cairo_surface_destroy(image);
+		return;
+	}
+
+	if (!preload.pool) {
+		wl_list_init(&preload.jobs);
+		preload.pool = g_thread_pool_new(preload_decode, NULL,
+			g_get_num_processors(), FALSE, NULL);
+		if (!preload.pool) {
+			/* The image will be decoded once it is loaded */
+			return;
+		}
+	}
+
+	struct preload_job *job = znew(*job);
+	job->path = xstrdup(path);
+	job->size = size;
+	wl_list_insert(&preload.jobs, &job->link);
+	g_thread_pool_push(preload.pool, job, NULL);
+}
+
+void
+button_cache_preload_finish(void)
+{
+	if (!preload.pool) {
+		return;
+	}
+
+	/* Wait for all queued jobs to complete */
+	g_thread_pool_free(preload.pool, FALSE, TRUE);
+	preload.pool = NULL;
+
+	struct preload_job *job, *tmp;
+	wl_list_for_each_safe(job, tmp, &preload.jobs, link) {
+		if (job->image) {
+			button_cache_add(job->path, job->size, job->image);
+			cairo_surface_destroy(job->image);
+		}
+		wl_list_remove(&job->link);
+		free(job->path);
+		free(job);
+	}
+}
+
+void
+button_cache_finish(void)
+{
+	if (!button_cache.entries.next) {
+		return;
+	}
+	struct button_cache_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &button_cache.entries, link) {
+		entry_destroy(entry);
+	}
+}
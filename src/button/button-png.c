@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <wlr/util/log.h>
 #include "buffer.h"
+#include "button/button-cache.h"
 #include "button/button-png.h"
 #include "button/common.h"
 #include "common/string-helpers.h"
@@ -43,6 +44,22 @@ ispng(const char *filename)
 
 #undef PNG_BYTES_TO_CHECK
 
+cairo_surface_t *
+button_png_decode(const char *path)
+{
+	if (!ispng(path)) {
+		return NULL;
+	}
+	cairo_surface_t *image = cairo_image_surface_create_from_png(path);
+	if (cairo_surface_status(image)) {
+		wlr_log(WLR_ERROR, "error reading png button '%s'", path);
+		cairo_surface_destroy(image);
+		return NULL;
+	}
+	cairo_surface_flush(image);
+	return image;
+}
+
 void
 button_png_load(const char *button_name, struct lab_data_buffer **buffer)
 {
@@ -56,17 +73,15 @@ button_png_load(const char *button_name, struct lab_data_buffer **buffer)
 
 	char path[4096] = { 0 };
 	button_filename(button_name, path, sizeof(path));
-	if (!ispng(path)) {
-		return;
-	}
 
-	cairo_surface_t *image = cairo_image_surface_create_from_png(path);
-	if (cairo_surface_status(image)) {
-		wlr_log(WLR_ERROR, "error reading png button '%s'", path);
-		cairo_surface_destroy(image);
-		return;
+	cairo_surface_t *image = button_cache_get(path, 0);
+	if (!image) {
+		image = button_png_decode(path);
+		if (!image) {
+			return;
+		}
+		button_cache_add(path, 0, image);
 	}
-	cairo_surface_flush(image);
 
 	double w = cairo_image_surface_get_width(image);
 	double h = cairo_image_surface_get_height(image);
@@ -74,4 +89,5 @@ button_png_load(const char *button_name, struct lab_data_buffer **buffer)
 	cairo_t *cairo = (*buffer)->cairo;
 	cairo_set_source_surface(cairo, image, 0, 0);
 	cairo_paint_with_alpha(cairo, 1.0);
+	cairo_surface_destroy(image);
 }
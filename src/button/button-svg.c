@@ -10,26 +10,15 @@
 #include <stdlib.h>
 #include <wlr/util/log.h>
 #include "buffer.h"
+#include "button/button-cache.h"
 #include "button/button-svg.h"
 #include "button/common.h"
 #include "common/string-helpers.h"
 #include "labwc.h"
 
-void
-button_svg_load(const char *button_name, struct lab_data_buffer **buffer,
-		int size)
+cairo_surface_t *
+button_svg_render(const char *filename, int size)
 {
-	if (*buffer) {
-		wlr_buffer_drop(&(*buffer)->base);
-		*buffer = NULL;
-	}
-	if (string_null_or_empty(button_name)) {
-		return;
-	}
-
-	char filename[4096] = { 0 };
-	button_filename(button_name, filename, sizeof(filename));
-
 	GError *err = NULL;
 	RsvgRectangle viewport = { .width = size, .height = size };
 	RsvgHandle *svg = rsvg_handle_new_from_file(filename, &err);
@@ -40,7 +29,7 @@ button_svg_load(const char *button_name, struct lab_data_buffer **buffer,
 		 * rsvg_handle_new_from_file() returns NULL if an error occurs,
 		 * so there is no need to free svg here.
 		 */
-		return;
+		return NULL;
 	}
 
 	cairo_surface_t *image = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
@@ -58,6 +47,40 @@ button_svg_load(const char *button_name, struct lab_data_buffer **buffer,
 		goto error;
 	}
 	cairo_surface_flush(image);
+	cairo_destroy(cr);
+	g_object_unref(svg);
+	return image;
+
+error:
+	cairo_destroy(cr);
+	cairo_surface_destroy(image);
+	g_object_unref(svg);
+	return NULL;
+}
+
+void
+button_svg_load(const char *button_name, struct lab_data_buffer **buffer,
+		int size)
+{
+	if (*buffer) {
+		wlr_buffer_drop(&(*buffer)->base);
+		*buffer = NULL;
+	}
+	if (string_null_or_empty(button_name)) {
+		return;
+	}
+
+	char filename[4096] = { 0 };
+	button_filename(button_name, filename, sizeof(filename));
+
+	cairo_surface_t *image = button_cache_get(filename, size);
+	if (!image) {
+		image = button_svg_render(filename, size);
+		if (!image) {
+			return;
+		}
+		button_cache_add(filename, size, image);
+	}
 
 	double w = cairo_image_surface_get_width(image);
 	double h = cairo_image_surface_get_height(image);
@@ -65,9 +88,5 @@ button_svg_load(const char *button_name, struct lab_data_buffer **buffer,
 	cairo_t *cairo = (*buffer)->cairo;
 	cairo_set_source_surface(cairo, image, 0, 0);
 	cairo_paint_with_alpha(cairo, 1.0);
-
-error:
-	cairo_destroy(cr);
 	cairo_surface_destroy(image);
-	g_object_unref(svg);
 }
@@ -6,276 +6,170 @@
  */
 
 #define _POSIX_C_SOURCE 200809L
-#include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <drm_fourcc.h>
 #include "button/button-xbm.h"
 #include "button/common.h"
 #include "common/grab-file.h"
+#include "common/graphic-helpers.h"
 #include "common/mem.h"
 #include "common/string-helpers.h"
 #include "buffer.h"
 
-enum token_type {
-	TOKEN_NONE = 0,
-	TOKEN_IDENT,
-	TOKEN_INT,
-	TOKEN_SPECIAL,
-	TOKEN_OTHER,
-};
-
-#define MAX_TOKEN_SIZE (256)
-struct token {
-	char name[MAX_TOKEN_SIZE];
-	int value;
-	size_t pos;
-	enum token_type type;
-};
-
-struct pixmap {
-	uint32_t *data;
+/* Bitmap as stored in xbm files, rows padded to whole bytes, LSB first */
+struct mask {
 	int width;
 	int height;
+	int stride;
+	uint8_t *bits;
 };
 
-static uint32_t color;
-static char *current_buffer_position;
-static struct token *tokens;
-static int nr_tokens, alloc_tokens;
-
-static void
-add_token(enum token_type token_type)
-{
-	if (nr_tokens == alloc_tokens) {
-		alloc_tokens = (alloc_tokens + 16) * 2;
-		tokens = xrealloc(tokens, alloc_tokens * sizeof(struct token));
-	}
-	struct token *token = tokens + nr_tokens;
-	memset(token, 0, sizeof(*token));
-	nr_tokens++;
-	token->type = token_type;
-}
-
-static void
-get_identifier_token(void)
-{
-	struct token *token = tokens + nr_tokens - 1;
-	token->name[token->pos] = current_buffer_position[0];
-	token->pos++;
-	if (token->pos == MAX_TOKEN_SIZE - 1) {
-		return;
-	}
-	current_buffer_position++;
-	switch (current_buffer_position[0]) {
-	case '\0':
-		return;
-	case 'a' ... 'z':
-	case 'A' ... 'Z':
-	case '0' ... '9':
-	case '_':
-	case '#':
-		get_identifier_token();
-		break;
-	default:
-		break;
-	}
-}
-
-static void
-get_number_token(void)
+/*
+ * The active and inactive variants of a button are loaded from the same
+ * file one after the other, so the last decoded file is kept and only
+ * coloured in again.
+ */
+static struct {
+	char *filename;
+	struct timespec mtime;
+	off_t size;
+	struct mask mask;
+} last_file;
+
+static bool
+is_ident_char(char c)
 {
-	struct token *token = tokens + nr_tokens - 1;
-	token->name[token->pos] = current_buffer_position[0];
-	token->pos++;
-	if (token->pos == MAX_TOKEN_SIZE - 1) {
-		return;
-	}
-	current_buffer_position++;
-	switch (current_buffer_position[0]) {
-	case '\0':
-		return;
-	case '0' ... '9':
-	case 'a' ... 'f':
-	case 'A' ... 'F':
-	case 'x':
-		get_number_token();
-		break;
-	default:
-		break;
-	}
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+		|| (c >= '0' && c <= '9') || c == '_';
 }
 
-static void
-get_special_char_token(void)
+static bool
+ends_with(const char *s, size_t len, const char *suffix)
 {
-	struct token *token = tokens + nr_tokens - 1;
-	token->name[0] = current_buffer_position[0];
-	current_buffer_position++;
+	size_t suffix_len = strlen(suffix);
+	return len >= suffix_len && !memcmp(s + len - suffix_len, suffix,
+		suffix_len);
 }
 
-/**
- * tokenize_xbm - tokenize xbm file
- * @buffer: buffer containing xbm file
- * return token vector
+/*
+ * Decodes the NUL-terminated xbm file content in @p in a single pass:
+ *
+ *   #define name_width 6
+ *   #define name_height 6
+ *   static unsigned char name_bits[] = { 0x3f, 0x3f, ... };
  */
-static struct token *
-tokenize_xbm(char *buffer)
+static bool
+parse_xbm(const char *p, struct mask *mask)
 {
-	tokens = NULL;
-	nr_tokens = 0;
-	alloc_tokens = 0;
-
-	current_buffer_position = buffer;
+	*mask = (struct mask){ 0 };
 
-	for (;;) {
-		switch (current_buffer_position[0]) {
-		case '\0':
-			goto out;
-		case 'a' ... 'z':
-		case 'A' ... 'Z':
-		case '_':
-		case '#':
-			add_token(TOKEN_IDENT);
-			get_identifier_token();
+	/* Dimensions from the #define lines in front of the data */
+	while (*p && *p != '{') {
+		if (strncmp(p, "#define", 7)) {
+			p++;
 			continue;
-		case '0' ... '9':
-			add_token(TOKEN_INT);
-			get_number_token();
-			struct token *token = tokens + nr_tokens - 1;
-			token->value = (int)strtol(token->name, NULL, 0);
-			continue;
-		case '{':
-			add_token(TOKEN_SPECIAL);
-			get_special_char_token();
-			continue;
-		default:
-			break;
 		}
-		++current_buffer_position;
+		p += 7;
+		while (*p == ' ' || *p == '\t') {
+			p++;
+		}
+		const char *name = p;
+		while (is_ident_char(*p)) {
+			p++;
+		}
+		size_t len = p - name;
+		if (ends_with(name, len, "width")) {
+			mask->width = (int)strtol(p, (char **)&p, 0);
+		} else if (ends_with(name, len, "height")) {
+			mask->height = (int)strtol(p, (char **)&p, 0);
+		}
 	}
-out:
-	add_token(TOKEN_NONE); /* vector end marker */
-	return tokens;
-}
-
-static uint32_t
-argb32(float *rgba)
-{
-	uint32_t r[4] = { 0 };
-	for (int i = 0; i < 4; i++) {
-		r[i] = rgba[i] * 255;
+	if (*p != '{' || mask->width <= 0 || mask->height <= 0) {
+		return false;
 	}
-	return ((r[3] & 0xff) << 24) | ((r[0] & 0xff) << 16) |
-		((r[1] & 0xff) << 8) | (r[2] & 0xff);
-}
 
-static void
-process_bytes(struct pixmap *pixmap, struct token *tokens)
-{
-	pixmap->data = znew_n(uint32_t, pixmap->width * pixmap->height);
-	struct token *t = tokens;
-	for (int row = 0; row < pixmap->height; row++) {
-		int byte = 1;
-		for (int col = 0; col < pixmap->width; col++) {
-			if (col == byte * 8) {
-				++byte;
-				++t;
-			}
-			if (!t->type) {
-				return;
-			}
-			if (t->type != TOKEN_INT) {
-				return;
-			}
-			int bit = 1 << (col % 8);
-			if (t->value & bit) {
-				pixmap->data[row * pixmap->width + col] = color;
-			}
+	mask->stride = (mask->width + 7) / 8;
+	size_t nr_bytes = (size_t)mask->stride * mask->height;
+	mask->bits = znew_n(uint8_t, nr_bytes);
+
+	/* Missing bytes are left blank */
+	size_t i = 0;
+	p++;
+	while (*p && *p != '}' && i < nr_bytes) {
+		if (*p >= '0' && *p <= '9') {
+			mask->bits[i++] = (uint8_t)strtol(p, (char **)&p, 0);
+		} else {
+			p++;
 		}
-		++t;
 	}
+	return true;
 }
 
-/**
- * parse_xbm_tokens - parse xbm tokens and create pixmap
- * @tokens: token vector
- */
-static struct pixmap
-parse_xbm_tokens(struct token *tokens)
+static struct lab_data_buffer *
+mask_to_buffer(const struct mask *mask, float *rgba)
 {
-	struct pixmap pixmap = { 0 };
-
-	for (struct token *t = tokens; t->type; t++) {
-		if (pixmap.width && pixmap.height) {
-			if (t->type != TOKEN_INT) {
-				continue;
-			}
-			process_bytes(&pixmap, t);
-			goto out;
-		}
-		if (strstr(t->name, "width")) {
-			pixmap.width = atoi((++t)->name);
-		} else if (strstr(t->name, "height")) {
-			pixmap.height = atoi((++t)->name);
-		}
-	}
-out:
-	return pixmap;
+	uint32_t *pixels = znew_n(uint32_t, mask->width * mask->height);
+	pixels_from_mask(pixels, mask->bits, mask->stride, mask->width,
+		mask->height, pixel_from_color(rgba));
+	return buffer_create_wrap(pixels, mask->width, mask->height,
+		mask->width * 4, /* free_on_destroy */ true);
 }
 
-/*
- * Openbox built-in icons are not bigger than 8x8, so have only written this
- * function to cope wit that max size
- */
-#define LABWC_BUILTIN_ICON_MAX_SIZE (8)
-
-/**
- * parse_xbm_builtin - parse builtin xbm button and create pixmap
- * @button: button byte array (xbm format)
- */
-static struct pixmap
-parse_xbm_builtin(const char *button, int size)
+/* Returns the decoded content of @filename, NULL if it can't be read */
+static struct mask *
+load_mask(const char *filename)
 {
-	struct pixmap pixmap = { 0 };
-
-	assert(size <= LABWC_BUILTIN_ICON_MAX_SIZE);
-	pixmap.width = size;
-	pixmap.height = size;
-
-	struct token t[LABWC_BUILTIN_ICON_MAX_SIZE + 1];
-	for (int i = 0; i < size; i++) {
-		t[i].value = button[i];
-		t[i].type = TOKEN_INT;
-	}
-	t[size].type = 0;
-	process_bytes(&pixmap, t);
-	return pixmap;
+	struct stat st;
+	if (stat(filename, &st)) {
+		return NULL;
+	}
+	if (last_file.filename && !strcmp(last_file.filename, filename)
+			&& last_file.size == st.st_size
+			&& last_file.mtime.tv_sec == st.st_mtim.tv_sec
+			&& last_file.mtime.tv_nsec == st.st_mtim.tv_nsec) {
+		return &last_file.mask;
+	}
+
+	button_xbm_finish();
+	struct buf content = grab_file(filename);
+	bool ok = content.len && parse_xbm(content.data, &last_file.mask);
+	buf_reset(&content);
+	if (!ok) {
+		return NULL;
+	}
+	last_file.filename = xstrdup(filename);
+	last_file.size = st.st_size;
+	last_file.mtime = st.st_mtim;
+	return &last_file.mask;
 }
 
 void
 button_xbm_from_bitmap(const char *bitmap, struct lab_data_buffer **buffer,
 		float *rgba)
 {
-	struct pixmap pixmap = {0};
 	if (*buffer) {
 		wlr_buffer_drop(&(*buffer)->base);
 		*buffer = NULL;
 	}
-	color = argb32(rgba);
-	pixmap = parse_xbm_builtin(bitmap, 6);
-	*buffer = buffer_create_wrap(pixmap.data, pixmap.width, pixmap.height,
-		pixmap.width * 4, /* free_on_destroy */ true);
+	/* The built-in fallbacks are 6x6 */
+	struct mask mask = {
+		.width = 6,
+		.height = 6,
+		.stride = 1,
+		.bits = (uint8_t *)bitmap,
+	};
+	*buffer = mask_to_buffer(&mask, rgba);
 }
 
 void
 button_xbm_load(const char *button_name, struct lab_data_buffer **buffer,
 		float *rgba)
 {
-	struct pixmap pixmap = {0};
 	if (*buffer) {
 		wlr_buffer_drop(&(*buffer)->base);
 		*buffer = NULL;
@@ -283,27 +177,22 @@ button_xbm_load(const char *button_name, struct lab_data_buffer **buffer,
 	if (string_null_or_empty(button_name)) {
 		return;
 	}
-	color = argb32(rgba);
 
-	/* Read file into memory as it's easier to tokenize that way */
 	char filename[4096] = { 0 };
 	button_filename(button_name, filename, sizeof(filename));
-	struct buf token_buf = grab_file(filename);
-	if (token_buf.len) {
-		struct token *tokens = tokenize_xbm(token_buf.data);
-		pixmap = parse_xbm_tokens(tokens);
-		if (tokens) {
-			free(tokens);
-		}
-	}
-	buf_reset(&token_buf);
-	if (!pixmap.data) {
+	if (!filename[0]) {
 		return;
 	}
-
-	/* Create buffer with free_on_destroy being true */
-	if (pixmap.data) {
-		*buffer = buffer_create_wrap(pixmap.data, pixmap.width,
-			pixmap.height, pixmap.width * 4, true);
+	struct mask *mask = load_mask(filename);
+	if (mask) {
+		*buffer = mask_to_buffer(mask, rgba);
 	}
 }
+
+void
+button_xbm_finish(void)
+{
+	zfree(last_file.filename);
+	zfree(last_file.mask.bits);
+	last_file.mask = (struct mask){ 0 };
+}
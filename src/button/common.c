@@ -1,11 +1,141 @@
 // SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
 #include <stdio.h>
-#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 #include "button/common.h"
 #include "common/dir.h"
+#include "common/mem.h"
+#include "common/string-helpers.h"
 #include "config/rcxml.h"
 #include "labwc.h"
 
+/*
+ * Listing of a theme directory. Loading a theme looks up every button in
+ * several formats and states in each theme directory, which would cost a
+ * failed access() each - slow on network file systems. Instead, every
+ * directory is listed once and only listed again if its mtime changed.
+ */
+struct dir_index {
+	char *path;
+	bool exists;
+	struct timespec mtime;
+	char **names; /* sorted */
+	size_t nr_names;
+	/* Checked against the file system since button_filename_revalidate() */
+	bool validated;
+	struct wl_list link; /* dir_indexes */
+};
+
+static struct wl_list dir_indexes;
+
+static int
+compare_names(const void *a, const void *b)
+{
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static void
+dir_index_clear(struct dir_index *index)
+{
+	for (size_t i = 0; i < index->nr_names; i++) {
+		free(index->names[i]);
+	}
+	zfree(index->names);
+	index->nr_names = 0;
+}
+
+static void
+dir_index_scan(struct dir_index *index)
+{
+	dir_index_clear(index);
+
+	DIR *dir = opendir(index->path);
+	if (!dir) {
+		return;
+	}
+	size_t alloc = 0;
+	struct dirent *entry;
+	while ((entry = readdir(dir))) {
+		if (entry->d_name[0] == '.') {
+			/* Including "." and "..", themes have no hidden buttons */
+			continue;
+		}
+		if (index->nr_names == alloc) {
+			alloc = alloc ? alloc * 2 : 32;
+			index->names = xrealloc(index->names,
+				alloc * sizeof(*index->names));
+		}
+		index->names[index->nr_names++] = xstrdup(entry->d_name);
+	}
+	closedir(dir);
+	qsort(index->names, index->nr_names, sizeof(*index->names),
+		compare_names);
+}
+
+static struct dir_index *
+dir_index_get(const char *path)
+{
+	if (!dir_indexes.next) {
+		wl_list_init(&dir_indexes);
+	}
+
+	struct dir_index *index;
+	bool found = false;
+	wl_list_for_each(index, &dir_indexes, link) {
+		if (!strcmp(index->path, path)) {
+			found = true;
+			break;
+		}
+	}
+	if (found && index->validated) {
+		return index;
+	}
+	if (!found) {
+		index = znew(*index);
+		index->path = xstrdup(path);
+		wl_list_insert(&dir_indexes, &index->link);
+	}
+
+	struct stat st;
+	bool exists = !stat(path, &st) && S_ISDIR(st.st_mode);
+	if (!found || exists != index->exists || (exists
+			&& (st.st_mtim.tv_sec != index->mtime.tv_sec
+			|| st.st_mtim.tv_nsec != index->mtime.tv_nsec))) {
+		index->exists = exists;
+		if (exists) {
+			index->mtime = st.st_mtim;
+			dir_index_scan(index);
+		} else {
+			dir_index_clear(index);
+		}
+	}
+	index->validated = true;
+	return index;
+}
+
+static bool
+dir_index_contains(struct dir_index *index, const char *name)
+{
+	return index->nr_names && bsearch(&name, index->names,
+		index->nr_names, sizeof(*index->names), compare_names);
+}
+
+static bool
+file_exists(const char *filename)
+{
+	const char *slash = strrchr(filename, '/');
+	if (!slash) {
+		return false;
+	}
+	char *dir = strdup_printf("%.*s", (int)(slash - filename), filename);
+	struct dir_index *index = dir_index_get(dir);
+	free(dir);
+	return dir_index_contains(index, slash + 1);
+}
+
 void
 button_filename(const char *name, char *buf, size_t len)
 {
@@ -18,10 +148,37 @@ button_filename(const char *name, char *buf, size_t len)
 	 */
 	struct path *path;
 	wl_list_for_each(path, &paths, link) {
-		if (access(path->string, R_OK) == 0) {
+		if (file_exists(path->string)) {
 			snprintf(buf, len, "%s", path->string);
 			break;
 		}
 	}
 	paths_destroy(&paths);
 }
+
+void
+button_filename_revalidate(void)
+{
+	if (!dir_indexes.next) {
+		return;
+	}
+	struct dir_index *index;
+	wl_list_for_each(index, &dir_indexes, link) {
+		index->validated = false;
+	}
+}
+
+void
+button_filename_finish(void)
+{
+	if (!dir_indexes.next) {
+		return;
+	}
+	struct dir_index *index, *tmp;
+	wl_list_for_each_safe(index, tmp, &dir_indexes, link) {
+		dir_index_clear(index);
+		wl_list_remove(&index->link);
+		free(index->path);
+		free(index);
+	}
+}
@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <string.h>
+#include "common/bitset.h"
+#include "common/macros.h"
+#include "common/mem.h"
+
+#define BITS_PER_WORD 64
+
+static uint64_t
+word_at(const struct bitset *set, size_t i)
+{
+	return i < set->nr_words ? set->words[i] : 0;
+}
+
+static void
+grow(struct bitset *set, size_t nr_words)
+{
+	if (nr_words <= set->nr_words) {
+		return;
+	}
+	set->words = xrealloc(set->words, nr_words * sizeof(*set->words));
+	memset(set->words + set->nr_words, 0,
+		(nr_words - set->nr_words) * sizeof(*set->words));
+	set->nr_words = nr_words;
+}
+
+void
+bitset_set(struct bitset *set, size_t bit)
+{
+	grow(set, bit / BITS_PER_WORD + 1);
+	set->words[bit / BITS_PER_WORD] |= 1ull << (bit % BITS_PER_WORD);
+}
+
+bool
+bitset_test(const struct bitset *set, size_t bit)
+{
+	return word_at(set, bit / BITS_PER_WORD)
+		& (1ull << (bit % BITS_PER_WORD));
+}
+
+void
+bitset_clear(struct bitset *set)
+{
+	if (set->nr_words) {
+		memset(set->words, 0, set->nr_words * sizeof(*set->words));
+	}
+}
+
+void
+bitset_copy(struct bitset *dst, const struct bitset *src)
+{
+	bitset_clear(dst);
+	grow(dst, src->nr_words);
+	if (src->nr_words) {
+		memcpy(dst->words, src->words,
+			src->nr_words * sizeof(*src->words));
+	}
+}
+
+bool
+bitset_equal(const struct bitset *a, const struct bitset *b)
+{
+	/* Trailing zero words do not count */
+	size_t nr_words = MAX(a->nr_words, b->nr_words);
+	for (size_t i = 0; i < nr_words; i++) {
+		if (word_at(a, i) != word_at(b, i)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool
+bitset_intersects(const struct bitset *a, const struct bitset *b)
+{
+	size_t nr_words = MIN(a->nr_words, b->nr_words);
+	for (size_t i = 0; i < nr_words; i++) {
+		if (a->words[i] & b->words[i]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+size_t
+bitset_count(const struct bitset *set)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < set->nr_words; i++) {
+		count += __builtin_popcountll(set->words[i]);
+	}
+	return count;
+}
+
+size_t
+bitset_first_unset(const struct bitset *set)
+{
+	for (size_t i = 0; i < set->nr_words; i++) {
+		if (~set->words[i]) {
+			return i * BITS_PER_WORD
+				+ __builtin_ctzll(~set->words[i]);
+		}
+	}
+	return set->nr_words * BITS_PER_WORD;
+}
+
+void
+bitset_finish(struct bitset *set)
+{
+	zfree(set->words);
+	set->nr_words = 0;
+}
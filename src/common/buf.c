@@ -1,75 +1,15 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include <assert.h>
 #include <ctype.h>
+#include <stdarg.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <string.h>
 #include "common/buf.h"
 #include "common/macros.h"
 #include "common/mem.h"
 #include "common/string-helpers.h"
 
-void
-buf_expand_tilde(struct buf *s)
-{
-	struct buf new = BUF_INIT;
-	for (int i = 0 ; i < s->len ; i++) {
-		if (s->data[i] == '~') {
-			buf_add(&new, getenv("HOME"));
-		} else {
-			buf_add_char(&new, s->data[i]);
-		}
-	}
-	buf_move(s, &new);
-}
-
-static void
-strip_curly_braces(char *s)
-{
-	size_t len = strlen(s);
-	if (s[0] != '{' || s[len - 1] != '}') {
-		return;
-	}
-	len -= 2;
-	memmove(s, s + 1, len);
-	s[len] = 0;
-}
-
-static bool
-isvalid(char p)
-{
-	return isalnum(p) || p == '_' || p == '{' || p == '}';
-}
-
-void
-buf_expand_shell_variables(struct buf *s)
-{
-	struct buf new = BUF_INIT;
-	struct buf environment_variable = BUF_INIT;
-
-	for (int i = 0 ; i < s->len ; i++) {
-		if (s->data[i] == '$' && isvalid(s->data[i+1])) {
-			/* expand environment variable */
-			buf_clear(&environment_variable);
-			buf_add(&environment_variable, s->data + i + 1);
-			char *p = environment_variable.data;
-			while (isvalid(*p)) {
-				++p;
-			}
-			*p = '\0';
-			i += strlen(environment_variable.data);
-			strip_curly_braces(environment_variable.data);
-			p = getenv(environment_variable.data);
-			if (p) {
-				buf_add(&new, p);
-			}
-		} else {
-			buf_add_char(&new, s->data[i]);
-		}
-	}
-	buf_reset(&environment_variable);
-	buf_move(s, &new);
-}
-
 static void
 buf_expand(struct buf *s, int new_alloc)
 {
@@ -96,18 +36,139 @@ buf_expand(struct buf *s, int new_alloc)
 }
 
 void
-buf_add(struct buf *s, const char *data)
+buf_add_len(struct buf *s, const char *data, int len)
 {
-	if (string_null_or_empty(data)) {
+	if (len <= 0) {
 		return;
 	}
-	int len = strlen(data);
 	buf_expand(s, s->len + len + 1);
 	memcpy(s->data + s->len, data, len);
 	s->len += len;
 	s->data[s->len] = 0;
 }
 
+void
+buf_add(struct buf *s, const char *data)
+{
+	if (string_null_or_empty(data)) {
+		return;
+	}
+	buf_add_len(s, data, strlen(data));
+}
+
+void
+buf_add_fmt(struct buf *s, const char *fmt, ...)
+{
+	va_list ap;
+
+	/* Make sure data is allocated so that it can be written to */
+	buf_expand(s, s->len + 1);
+
+	va_start(ap, fmt);
+	int len = vsnprintf(s->data + s->len, s->alloc - s->len, fmt, ap);
+	va_end(ap);
+	if (len < 0) {
+		s->data[s->len] = '\0';
+		return;
+	}
+	if (len >= s->alloc - s->len) {
+		buf_expand(s, s->len + len + 1);
+		va_start(ap, fmt);
+		vsnprintf(s->data + s->len, s->alloc - s->len, fmt, ap);
+		va_end(ap);
+	}
+	s->len += len;
+}
+
+void
+buf_expand_tilde(struct buf *s)
+{
+	const char *p = s->data;
+	const char *end = s->data + s->len;
+	const char *tilde = memchr(p, '~', end - p);
+	if (!tilde) {
+		return;
+	}
+
+	const char *home = getenv("HOME");
+	int home_len = home ? strlen(home) : 0;
+	struct buf new = BUF_INIT;
+	buf_expand(&new, s->len + home_len + 1);
+	while (tilde) {
+		buf_add_len(&new, p, tilde - p);
+		buf_add_len(&new, home, home_len);
+		p = tilde + 1;
+		tilde = memchr(p, '~', end - p);
+	}
+	buf_add_len(&new, p, end - p);
+	buf_move(s, &new);
+}
+
+static bool
+isvalid(char p)
+{
+	return isalnum((unsigned char)p) || p == '_' || p == '{' || p == '}';
+}
+
+/* Find the next '$' which starts a variable name */
+static const char *
+find_variable(const char *p, const char *end)
+{
+	while ((p = memchr(p, '$', end - p))) {
+		if (p + 1 < end && isvalid(p[1])) {
+			return p;
+		}
+		p++;
+	}
+	return NULL;
+}
+
+void
+buf_expand_shell_variables(struct buf *s)
+{
+	const char *p = s->data;
+	const char *end = s->data + s->len;
+	const char *dollar = find_variable(p, end);
+	if (!dollar) {
+		return;
+	}
+
+	struct buf new = BUF_INIT;
+	char short_name[256];
+	buf_expand(&new, s->len + 1);
+	while (dollar) {
+		buf_add_len(&new, p, dollar - p);
+
+		const char *name = dollar + 1;
+		const char *name_end = name;
+		while (name_end < end && isvalid(*name_end)) {
+			++name_end;
+		}
+		p = name_end;
+
+		/* Strip curly braces of ${foo} */
+		if (name_end - name >= 2 && name[0] == '{'
+				&& name_end[-1] == '}') {
+			++name;
+			--name_end;
+		}
+
+		/* getenv() needs a NUL-terminated name */
+		size_t len = name_end - name;
+		char *var = len < sizeof(short_name) ? short_name : xmalloc(len + 1);
+		memcpy(var, name, len);
+		var[len] = '\0';
+		buf_add(&new, getenv(var));
+		if (var != short_name) {
+			free(var);
+		}
+
+		dollar = find_variable(p, end);
+	}
+	buf_add_len(&new, p, end - p);
+	buf_move(s, &new);
+}
+
 void
 buf_add_char(struct buf *s, char ch)
 {
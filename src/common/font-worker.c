@@ -0,0 +1,304 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <cairo.h>
+#include <glib.h>
+#include <pango/pangocairo.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/util/log.h>
+#include "buffer.h"
+#include "common/font.h"
+#include "common/font-worker.h"
+#include "common/mem.h"
+
+struct font_job {
+	/* Input, owned by the job */
+	char *text;
+	char *arrow;
+	struct font font;
+	float color[4];
+	float bg_color[4];
+	int text_width;
+	int arrow_width;
+	int height;
+	double scale;
+	bool warm_up;
+
+	/* Result, pixel data is free'd along the buffer */
+	void *data;
+	int width_px;
+	int height_px;
+	int stride;
+
+	/* Only accessed from the main thread */
+	font_job_done_t done;
+	void *done_data;
+	struct wl_list link; /* font_worker.jobs */
+
+	gint cancelled;
+};
+
+static struct {
+	/*
+	 * A single exclusive thread, so that pango only ever creates the
+	 * per-thread default font map once.
+	 */
+	GThreadPool *pool;
+	GAsyncQueue *results;
+	int event_fd;
+	struct wl_event_source *source;
+	struct wl_list jobs; /* all jobs not yet handed back */
+} font_worker = {
+	.event_fd = -1,
+};
+
+static void
+job_destroy(struct font_job *job)
+{
+	wl_list_remove(&job->link);
+	free(job->data);
+	free(job->text);
+	free(job->arrow);
+	free(job->font.name);
+	free(job);
+}
+
+/* Runs in the worker thread */
+static void
+job_render(struct font_job *job)
+{
+	/* Same rounding as buffer_create_cairo() */
+	job->width_px = (job->text_width + job->arrow_width) * job->scale;
+	job->height_px = job->height * job->scale;
+	if (job->width_px <= 0 || job->height_px <= 0) {
+		return;
+	}
+
+	job->stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32,
+		job->width_px);
+	job->data = calloc(job->height_px, job->stride);
+	if (!job->data) {
+		return;
+	}
+
+	cairo_surface_t *surf = cairo_image_surface_create_for_data(job->data,
+		CAIRO_FORMAT_ARGB32, job->width_px, job->height_px, job->stride);
+	cairo_surface_set_device_scale(surf, job->scale, job->scale);
+	cairo_t *cairo = cairo_create(surf);
+	font_render(cairo, job->text_width, job->arrow_width, job->text,
+		&job->font, job->color, job->bg_color, job->arrow);
+	cairo_destroy(cairo);
+
+	if (cairo_surface_status(surf) != CAIRO_STATUS_SUCCESS) {
+		zfree(job->data);
+	}
+	cairo_surface_destroy(surf);
+}
+
+/* Runs in the worker thread */
+static void
+job_warm_up(struct font_job *job)
+{
+	cairo_surface_t *surf =
+		cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+	cairo_t *cairo = cairo_create(surf);
+	PangoLayout *layout = pango_cairo_create_layout(cairo);
+	PangoFontDescription *desc = font_to_pango_desc(&job->font);
+	pango_layout_set_font_description(layout, desc);
+	pango_font_description_free(desc);
+	pango_layout_set_text(layout, job->text, -1);
+
+	/* Shaping loads the font and any fallbacks, drawing the glyphs */
+	int width, height;
+	pango_layout_get_pixel_size(layout, &width, &height);
+	pango_cairo_show_layout(cairo, layout);
+
+	g_object_unref(layout);
+	cairo_destroy(cairo);
+	cairo_surface_destroy(surf);
+}
+
+/* Runs in the worker thread */
+static void
+handle_job(gpointer data, gpointer user_data)
+{
+	struct font_job *job = data;
+	if (g_atomic_int_get(&job->cancelled)) {
+		/* Only handed back */
+	} else if (job->warm_up) {
+		job_warm_up(job);
+	} else {
+		job_render(job);
+	}
+	g_async_queue_push(font_worker.results, job);
+
+	uint64_t one = 1;
+	if (write(font_worker.event_fd, &one, sizeof(one)) < 0) {
+		wlr_log_errno(WLR_ERROR, "cannot signal font worker result");
+	}
+}
+
+static void
+job_complete(struct font_job *job)
+{
+	font_job_done_t done = job->done;
+	void *done_data = job->done_data;
+	double scale = job->scale;
+
+	struct lab_data_buffer *buffer = NULL;
+	if (done && job->data) {
+		buffer = buffer_create_wrap(job->data, job->width_px,
+			job->height_px, job->stride, /* free_on_destroy */ true);
+		buffer->unscaled_width = job->text_width + job->arrow_width;
+		buffer->unscaled_height = job->height;
+		buffer_set_category(buffer, LAB_BUFFER_TEXT);
+		/* Now owned by the buffer */
+		job->data = NULL;
+	}
+	job_destroy(job);
+
+	if (done) {
+		done(buffer, scale, done_data);
+	}
+}
+
+static int
+handle_results(int fd, uint32_t mask, void *data)
+{
+	uint64_t count;
+	if (read(fd, &count, sizeof(count)) < 0) {
+		return 0;
+	}
+	struct font_job *job;
+	while ((job = g_async_queue_try_pop(font_worker.results))) {
+		job_complete(job);
+	}
+	return 0;
+}
+
+void
+font_worker_init(struct wl_event_loop *loop)
+{
+	wl_list_init(&font_worker.jobs);
+
+	font_worker.event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (font_worker.event_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "cannot create eventfd for font worker");
+		return;
+	}
+	font_worker.source = wl_event_loop_add_fd(loop, font_worker.event_fd,
+		WL_EVENT_READABLE, handle_results, NULL);
+	if (!font_worker.source) {
+		goto err;
+	}
+
+	font_worker.results = g_async_queue_new();
+	font_worker.pool = g_thread_pool_new(handle_job, NULL,
+		/* max_threads */ 1, /* exclusive */ TRUE, NULL);
+	if (!font_worker.pool) {
+		wlr_log(WLR_ERROR, "cannot start font worker");
+		goto err;
+	}
+	return;
+err:
+	font_worker_finish();
+}
+
+struct font_job *
+font_worker_submit(int text_width, int arrow_width, int height,
+		const char *text, struct font *font, const float *color,
+		const float *bg_color, const char *arrow, double scale,
+		font_job_done_t done, void *data)
+{
+	if (!font_worker.pool) {
+		return NULL;
+	}
+
+	struct font_job *job = znew(*job);
+	job->text = xstrdup(text);
+	job->arrow = arrow ? xstrdup(arrow) : NULL;
+	job->font = *font;
+	job->font.name = font->name ? xstrdup(font->name) : NULL;
+	memcpy(job->color, color, sizeof(job->color));
+	memcpy(job->bg_color, bg_color, sizeof(job->bg_color));
+	job->text_width = text_width;
+	job->arrow_width = arrow_width;
+	job->height = height;
+	job->scale = scale;
+	job->done = done;
+	job->done_data = data;
+	wl_list_insert(&font_worker.jobs, &job->link);
+
+	g_thread_pool_push(font_worker.pool, job, NULL);
+	return job;
+}
+
+void
+font_worker_warm_up(struct font *fonts, size_t nr_fonts)
+{
+	if (!font_worker.pool) {
+		return;
+	}
+
+	/* What titles, menus and the OSD show most often */
+	static const char text[] =
+		"abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ "
+		"0123456789 .,:;-_()[]/ \u2026";
+
+	for (size_t i = 0; i < nr_fonts; i++) {
+		struct font_job *job = znew(*job);
+		job->text = xstrdup(text);
+		job->font = fonts[i];
+		job->font.name = fonts[i].name ? xstrdup(fonts[i].name) : NULL;
+		job->warm_up = true;
+		wl_list_insert(&font_worker.jobs, &job->link);
+		g_thread_pool_push(font_worker.pool, job, NULL);
+	}
+}
+
+void
+font_job_cancel(struct font_job *job)
+{
+	if (!job) {
+		return;
+	}
+	/* Freed once the worker hands it back */
+	job->done = NULL;
+	g_atomic_int_set(&job->cancelled, 1);
+}
+
+void
+font_worker_finish(void)
+{
+	if (font_worker.pool) {
+		/* Wait for the job currently running, skip the others */
+		struct font_job *job;
+		wl_list_for_each(job, &font_worker.jobs, link) {
+			g_atomic_int_set(&job->cancelled, 1);
+		}
+		g_thread_pool_free(font_worker.pool, FALSE, TRUE);
+		font_worker.pool = NULL;
+	}
+	if (font_worker.results) {
+		/* Complete everything with NULL to make owners forget the jobs */
+		struct font_job *job;
+		while ((job = g_async_queue_try_pop(font_worker.results))) {
+			zfree(job->data);
+			job_complete(job);
+		}
+		g_async_queue_unref(font_worker.results);
+		font_worker.results = NULL;
+	}
+	if (font_worker.source) {
+		wl_event_source_remove(font_worker.source);
+		font_worker.source = NULL;
+	}
+	if (font_worker.event_fd >= 0) {
+		close(font_worker.event_fd);
+		font_worker.event_fd = -1;
+	}
+}
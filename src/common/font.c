@@ -2,11 +2,15 @@
 #include <cairo.h>
 #include <drm_fourcc.h>
 #include <pango/pangocairo.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-server-core.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/util/box.h>
 #include <wlr/util/log.h>
 #include "common/font.h"
 #include "common/graphic-helpers.h"
+#include "common/mem.h"
 #include "common/string-helpers.h"
 #include "labwc.h"
 #include "buffer.h"
@@ -26,6 +30,108 @@ font_to_pango_desc(struct font *font)
 	return desc;
 }
 
+/*
+ * Text measurements are requested over and over again with the same
+ * arguments (window titles, menu items, OSD entries), so a single layout
+ * bound to a 1x1 surface is kept around and the results are remembered
+ * in a small LRU cache. Extents are measured in logical pixels and are
+ * therefore independent of the output scale.
+ */
+#define FONT_EXTENTS_CACHE_SIZE (128)
+
+struct font_extents_entry {
+	uint32_t hash;
+	char *text;
+	struct font font;
+	PangoRectangle rect;
+	struct wl_list link; /* font_measure.lru */
+};
+
+static struct {
+	cairo_surface_t *surface;
+	cairo_t *cairo;
+	PangoLayout *layout;
+	/* Font currently set on the layout */
+	struct font font;
+	struct wl_list lru; /* most recently used first */
+	int nr_entries;
+} font_measure;
+
+static bool
+font_equal(struct font *a, struct font *b)
+{
+	if (a->size != b->size || a->slant != b->slant
+			|| a->weight != b->weight) {
+		return false;
+	}
+	if (!a->name || !b->name) {
+		return a->name == b->name;
+	}
+	return !strcmp(a->name, b->name);
+}
+
+static void
+font_copy(struct font *dst, struct font *src)
+{
+	free(dst->name);
+	*dst = *src;
+	dst->name = src->name ? xstrdup(src->name) : NULL;
+}
+
+/* FNV-1a */
+static uint32_t
+hash_string(uint32_t hash, const char *s)
+{
+	for (; s && *s; s++) {
+		hash ^= (unsigned char)*s;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static uint32_t
+font_extents_hash(struct font *font, const char *string)
+{
+	uint32_t hash = hash_string(2166136261u, string);
+	hash = hash_string(hash, font->name);
+	hash ^= (uint32_t)font->size << 2 | font->slant << 1 | font->weight;
+	return hash;
+}
+
+static void
+font_extents_entry_destroy(struct font_extents_entry *entry)
+{
+	wl_list_remove(&entry->link);
+	free(entry->text);
+	free(entry->font.name);
+	free(entry);
+	font_measure.nr_entries--;
+}
+
+static PangoLayout *
+font_measure_layout(struct font *font)
+{
+	if (!font_measure.layout) {
+		font_measure.surface = cairo_image_surface_create(
+			CAIRO_FORMAT_ARGB32, 1, 1);
+		font_measure.cairo = cairo_create(font_measure.surface);
+		font_measure.layout =
+			pango_cairo_create_layout(font_measure.cairo);
+		pango_layout_set_single_paragraph_mode(font_measure.layout, TRUE);
+		pango_layout_set_width(font_measure.layout, -1);
+		pango_layout_set_ellipsize(font_measure.layout,
+			PANGO_ELLIPSIZE_MIDDLE);
+	} else if (font_equal(&font_measure.font, font)) {
+		return font_measure.layout;
+	}
+
+	PangoFontDescription *desc = font_to_pango_desc(font);
+	pango_layout_set_font_description(font_measure.layout, desc);
+	pango_font_description_free(desc);
+	font_copy(&font_measure.font, font);
+	return font_measure.layout;
+}
+
 static PangoRectangle
 font_extents(struct font *font, const char *string)
 {
@@ -33,20 +139,25 @@ font_extents(struct font *font, const char *string)
 	if (!string) {
 		return rect;
 	}
-	cairo_surface_t *surface;
-	cairo_t *c;
-	PangoLayout *layout;
 
-	surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
-	c = cairo_create(surface);
-	layout = pango_cairo_create_layout(c);
-	PangoFontDescription *desc = font_to_pango_desc(font);
+	if (!font_measure.lru.next) {
+		wl_list_init(&font_measure.lru);
+	}
 
-	pango_layout_set_font_description(layout, desc);
+	uint32_t hash = font_extents_hash(font, string);
+	struct font_extents_entry *entry;
+	wl_list_for_each(entry, &font_measure.lru, link) {
+		if (entry->hash == hash && !strcmp(entry->text, string)
+				&& font_equal(&entry->font, font)) {
+			/* Move to front */
+			wl_list_remove(&entry->link);
+			wl_list_insert(&font_measure.lru, &entry->link);
+			return entry->rect;
+		}
+	}
+
+	PangoLayout *layout = font_measure_layout(font);
 	pango_layout_set_text(layout, string, -1);
-	pango_layout_set_single_paragraph_mode(layout, TRUE);
-	pango_layout_set_width(layout, -1);
-	pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_MIDDLE);
 	pango_layout_get_extents(layout, NULL, &rect);
 	pango_extents_to_pixels(&rect, NULL);
 
@@ -54,10 +165,18 @@ font_extents(struct font *font, const char *string)
 	/* TODO: remove the 4 pixel addition and always do the padding by the caller */
 	rect.width += 4;
 
-	cairo_destroy(c);
-	cairo_surface_destroy(surface);
-	pango_font_description_free(desc);
-	g_object_unref(layout);
+	if (font_measure.nr_entries >= FONT_EXTENTS_CACHE_SIZE) {
+		entry = wl_container_of(font_measure.lru.prev, entry, link);
+		font_extents_entry_destroy(entry);
+	}
+	entry = znew(*entry);
+	entry->hash = hash;
+	entry->text = xstrdup(string);
+	font_copy(&entry->font, font);
+	entry->rect = rect;
+	wl_list_insert(&font_measure.lru, &entry->link);
+	font_measure.nr_entries++;
+
 	return rect;
 }
 
@@ -75,10 +194,9 @@ font_width(struct font *font, const char *string)
 	return rectangle.width;
 }
 
-void
-font_buffer_create(struct lab_data_buffer **buffer, int max_width,
-	const char *text, struct font *font, const float *color,
-	const float *bg_color, const char *arrow, double scale)
+bool
+font_buffer_size(int max_width, const char *text, struct font *font,
+	const char *arrow, int *text_width, int *arrow_width, int *height)
 {
 	/* Allow a minimum of one pixel each for text and arrow */
 	if (max_width < 2) {
@@ -86,7 +204,7 @@ font_buffer_create(struct lab_data_buffer **buffer, int max_width,
 	}
 
 	if (string_null_or_empty(text)) {
-		return;
+		return false;
 	}
 
 	PangoRectangle text_extents = font_extents(font, text);
@@ -104,14 +222,17 @@ font_buffer_create(struct lab_data_buffer **buffer, int max_width,
 		text_extents.width = max_width;
 	}
 
-	*buffer = buffer_create_cairo(text_extents.width + arrow_extents.width,
-			text_extents.height, scale, true);
-	if (!*buffer) {
-		wlr_log(WLR_ERROR, "Failed to create font buffer");
-		return;
-	}
+	*text_width = text_extents.width;
+	*arrow_width = arrow_extents.width;
+	*height = text_extents.height;
+	return true;
+}
 
-	cairo_t *cairo = (*buffer)->cairo;
+void
+font_render(cairo_t *cairo, int text_width, int arrow_width,
+	const char *text, struct font *font, const float *color,
+	const float *bg_color, const char *arrow)
+{
 	cairo_surface_t *surf = cairo_get_target(cairo);
 
 	/*
@@ -137,7 +258,7 @@ font_buffer_create(struct lab_data_buffer **buffer, int max_width,
 	cairo_move_to(cairo, 0, 0);
 
 	PangoLayout *layout = pango_cairo_create_layout(cairo);
-	pango_layout_set_width(layout, text_extents.width * PANGO_SCALE);
+	pango_layout_set_width(layout, text_width * PANGO_SCALE);
 	pango_layout_set_text(layout, text, -1);
 	pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_END);
 
@@ -157,8 +278,8 @@ font_buffer_create(struct lab_data_buffer **buffer, int max_width,
 	pango_cairo_show_layout(cairo, layout);
 
 	if (arrow) {
-		cairo_move_to(cairo, text_extents.width, 0);
-		pango_layout_set_width(layout, arrow_extents.width * PANGO_SCALE);
+		cairo_move_to(cairo, text_width, 0);
+		pango_layout_set_width(layout, arrow_width * PANGO_SCALE);
 		pango_layout_set_text(layout, arrow, -1);
 		pango_cairo_show_layout(cairo, layout);
 	}
@@ -168,8 +289,47 @@ font_buffer_create(struct lab_data_buffer **buffer, int max_width,
 	cairo_surface_flush(surf);
 }
 
+void
+font_buffer_create(struct lab_data_buffer **buffer, int max_width,
+	const char *text, struct font *font, const float *color,
+	const float *bg_color, const char *arrow, double scale)
+{
+	int text_width, arrow_width, height;
+	if (!font_buffer_size(max_width, text, font, arrow, &text_width,
+			&arrow_width, &height)) {
+		return;
+	}
+
+	*buffer = buffer_create_cairo(text_width + arrow_width, height,
+		scale, true);
+	if (!*buffer) {
+		wlr_log(WLR_ERROR, "Failed to create font buffer");
+		return;
+	}
+	buffer_set_category(*buffer, LAB_BUFFER_TEXT);
+
+	font_render((*buffer)->cairo, text_width, arrow_width, text, font,
+		color, bg_color, arrow);
+}
+
 void
 font_finish(void)
 {
+	if (font_measure.lru.next) {
+		struct font_extents_entry *entry, *tmp;
+		wl_list_for_each_safe(entry, tmp, &font_measure.lru, link) {
+			font_extents_entry_destroy(entry);
+		}
+	}
+	if (font_measure.layout) {
+		g_object_unref(font_measure.layout);
+		cairo_destroy(font_measure.cairo);
+		cairo_surface_destroy(font_measure.surface);
+	}
+	zfree(font_measure.font.name);
+	font_measure.layout = NULL;
+	font_measure.cairo = NULL;
+	font_measure.surface = NULL;
+
 	pango_cairo_font_map_set_default(NULL);
 }
@@ -8,29 +8,121 @@
 #define _POSIX_C_SOURCE 200809L
 #include "common/grab-file.h"
 #include "common/buf.h"
+#include "common/mem.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 struct buf
 grab_file(const char *filename)
 {
-	char *line = NULL;
-	size_t len = 0;
-	FILE *stream = fopen(filename, "r");
-	if (!stream) {
+	struct file_view view;
+	if (!file_view_open(&view, filename)) {
 		return BUF_INIT;
 	}
+	file_view_join_lines(&view);
 	struct buf buffer = BUF_INIT;
-	while ((getline(&line, &len, stream) != -1)) {
-		char *p = strrchr(line, '\n');
-		if (p) {
-			*p = '\0';
+	buf_add(&buffer, view.data);
+	file_view_close(&view);
+	return buffer;
+}
+
+/* Returns the number of bytes read, which is short if the file shrank */
+static ssize_t
+read_all(int fd, char *data, size_t len)
+{
+	size_t pos = 0;
+	while (pos < len) {
+		ssize_t ret = read(fd, data + pos, len - pos);
+		if (ret < 0 && errno == EINTR) {
+			continue;
 		}
-		buf_add(&buffer, line);
+		if (ret < 0) {
+			return -1;
+		}
+		if (ret == 0) {
+			break;
+		}
+		pos += ret;
 	}
-	free(line);
-	fclose(stream);
-	return buffer;
+	return pos;
+}
+
+bool
+file_view_open(struct file_view *view, const char *filename)
+{
+	*view = (struct file_view){ 0 };
+
+	int fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+		close(fd);
+		return false;
+	}
+
+	/*
+	 * Config files are small, so they are read in one go rather than
+	 * mapped: a mapped file being truncated while it is parsed, as by
+	 * an editor rewriting it in place, would crash the compositor with
+	 * SIGBUS. A file shrinking meanwhile just reads shorter instead.
+	 */
+	view->data = xmalloc(st.st_size + 1);
+	ssize_t len = read_all(fd, view->data, st.st_size);
+	close(fd);
+	if (len < 0) {
+		zfree(view->data);
+		return false;
+	}
+	view->len = len;
+	view->data[view->len] = '\0';
+	return true;
+}
+
+void
+file_view_close(struct file_view *view)
+{
+	free(view->data);
+	*view = (struct file_view){ 0 };
+}
+
+char *
+file_view_next_line(struct file_view *view)
+{
+	if (view->pos >= view->len) {
+		return NULL;
+	}
+	char *line = view->data + view->pos;
+	char *end = memchr(line, '\n', view->len - view->pos);
+	if (end) {
+		*end = '\0';
+		view->pos = end - view->data + 1;
+	} else {
+		view->pos = view->len;
+	}
+	return line;
+}
+
+void
+file_view_join_lines(struct file_view *view)
+{
+	char *end = memchr(view->data, '\n', view->len);
+	if (!end) {
+		return;
+	}
+	char *dst = end;
+	for (char *src = end; src < view->data + view->len; src++) {
+		if (*src != '\n') {
+			*dst++ = *src;
+		}
+	}
+	*dst = '\0';
+	view->len = dst - view->data;
 }
@@ -2,12 +2,14 @@
 
 #include <assert.h>
 #include <cairo.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <wlr/types/wlr_scene.h>
 #include <wlr/util/box.h>
 #include "buffer.h"
 #include "common/graphic-helpers.h"
+#include "common/macros.h"
 #include "common/mem.h"
 
 static void
@@ -75,6 +77,25 @@ multi_rect_set_size(struct multi_rect *rect, int width, int height)
 	}
 }
 
+struct wlr_scene_tree *
+outline_rect_create(struct wlr_scene_tree *parent, int width, int height,
+		int line_width, const float *color)
+{
+	struct wlr_scene_tree *tree = wlr_scene_tree_create(parent);
+	int inner_height = MAX(height - 2 * line_width, 0);
+
+	wlr_scene_rect_create(tree, width, line_width, color);
+	struct wlr_scene_rect *rect;
+	rect = wlr_scene_rect_create(tree, width, line_width, color);
+	wlr_scene_node_set_position(&rect->node, 0, height - line_width);
+	rect = wlr_scene_rect_create(tree, line_width, inner_height, color);
+	wlr_scene_node_set_position(&rect->node, 0, line_width);
+	rect = wlr_scene_rect_create(tree, line_width, inner_height, color);
+	wlr_scene_node_set_position(&rect->node, width - line_width, line_width);
+
+	return tree;
+}
+
 /* Draws a border with a specified line width */
 void
 draw_cairo_border(cairo_t *cairo, struct wlr_fbox fbox, double line_width)
@@ -112,6 +133,58 @@ set_cairo_color(cairo_t *cairo, const float *c)
 		c[2] / alpha, alpha);
 }
 
+uint32_t
+pixel_from_color(const float *color)
+{
+	uint32_t c[4];
+	for (int i = 0; i < 4; i++) {
+		c[i] = (uint32_t)(color[i] * 255) & 0xff;
+	}
+	return (c[3] << 24) | (c[0] << 16) | (c[1] << 8) | c[2];
+}
+
+void
+pixels_from_mask(uint32_t *dst, const uint8_t *bits, int mask_stride,
+		int width, int height, uint32_t color)
+{
+	for (int row = 0; row < height; row++) {
+		const uint8_t *src = bits + row * mask_stride;
+		for (int col = 0; col < width; col++) {
+			uint32_t bit = (src[col >> 3] >> (col & 7)) & 1;
+			*dst++ = color & -bit;
+		}
+	}
+}
+
+/*
+ * Multiplies all four channels of @pixel by @factor / 255, two at a time
+ * in the alternate bytes of a 32-bit word.
+ */
+static inline uint32_t
+scale_pixel(uint32_t pixel, uint32_t factor)
+{
+	uint32_t rb = (pixel & 0x00ff00ff) * factor + 0x00800080;
+	rb = ((rb + ((rb >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+	uint32_t ag = ((pixel >> 8) & 0x00ff00ff) * factor + 0x00800080;
+	ag = (ag + ((ag >> 8) & 0x00ff00ff)) & 0xff00ff00;
+	return rb | ag;
+}
+
+void
+pixels_blend_color(uint32_t *data, int width, int height, int stride,
+		const float *color)
+{
+	uint32_t src = pixel_from_color(color);
+	uint32_t inv_alpha = 255 - (src >> 24);
+	for (int row = 0; row < height; row++) {
+		uint32_t *dst = (uint32_t *)((uint8_t *)data + row * stride);
+		for (int col = 0; col < width; col++) {
+			/* Premultiplied "over", no channel can overflow */
+			dst[col] = src + scale_pixel(dst[col], inv_alpha);
+		}
+	}
+}
+
 struct surface_context
 get_cairo_surface_from_lab_data_buffer(struct lab_data_buffer *buffer)
 {
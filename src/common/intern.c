@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <wayland-util.h>
+#include "common/hash.h"
+#include "common/intern.h"
+#include "common/mem.h"
+
+#define INTERN_MIN_BUCKETS (64)
+
+struct interned {
+	struct wl_list link; /* table.buckets[] */
+	uint64_t hash;
+	unsigned int refcount;
+	char str[];
+};
+
+static struct {
+	struct wl_list *buckets;
+	size_t nr_buckets; /* power of two */
+	size_t nr_strings;
+} table;
+
+static struct interned *
+interned_from_str(const char *str)
+{
+	return (struct interned *)(str - offsetof(struct interned, str));
+}
+
+static struct wl_list *
+bucket(uint64_t hash)
+{
+	return &table.buckets[hash & (table.nr_buckets - 1)];
+}
+
+static void
+table_resize(size_t nr_buckets)
+{
+	struct wl_list *old = table.buckets;
+	size_t nr_old = table.nr_buckets;
+
+	table.buckets = znew_n(*table.buckets, nr_buckets);
+	table.nr_buckets = nr_buckets;
+	for (size_t i = 0; i < nr_buckets; i++) {
+		wl_list_init(&table.buckets[i]);
+	}
+	for (size_t i = 0; i < nr_old; i++) {
+		struct interned *entry, *tmp;
+		wl_list_for_each_safe(entry, tmp, &old[i], link) {
+			wl_list_remove(&entry->link);
+			wl_list_insert(bucket(entry->hash), &entry->link);
+		}
+	}
+	free(old);
+}
+
+const char *
+intern_str(const char *str)
+{
+	if (!str) {
+		return NULL;
+	}
+	if (!table.buckets) {
+		table_resize(INTERN_MIN_BUCKETS);
+	}
+
+	uint64_t hash = hash_str(HASH_INIT, str);
+	struct interned *entry;
+	wl_list_for_each(entry, bucket(hash), link) {
+		if (entry->hash == hash && !strcmp(entry->str, str)) {
+			entry->refcount++;
+			return entry->str;
+		}
+	}
+
+	size_t len = strlen(str);
+	entry = xmalloc(sizeof(*entry) + len + 1);
+	memcpy(entry->str, str, len + 1);
+	entry->hash = hash;
+	entry->refcount = 1;
+	wl_list_insert(bucket(hash), &entry->link);
+	if (++table.nr_strings > table.nr_buckets) {
+		table_resize(table.nr_buckets * 2);
+	}
+	return entry->str;
+}
+
+const char *
+intern_ref(const char *str)
+{
+	if (str) {
+		interned_from_str(str)->refcount++;
+	}
+	return str;
+}
+
+void
+intern_unref(const char *str)
+{
+	if (!str) {
+		return;
+	}
+	struct interned *entry = interned_from_str(str);
+	assert(entry->refcount > 0);
+	if (--entry->refcount) {
+		return;
+	}
+	wl_list_remove(&entry->link);
+	free(entry);
+
+	/* Drop the table with the last string so that nothing is leaked */
+	if (!--table.nr_strings) {
+		zfree(table.buckets);
+		table.nr_buckets = 0;
+	}
+}
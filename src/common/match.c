@@ -1,10 +1,16 @@
 // SPDX-License-Identifier: GPL-2.0-only
 
 #include <fnmatch.h>
+#include <string.h>
+#include <strings.h>
 #include "common/match.h"
 
 bool
 match_glob(const char *pattern, const char *string)
 {
+	/* Most patterns are plain strings which need no fnmatch() */
+	if (!strpbrk(pattern, "*?[\\")) {
+		return !strcasecmp(pattern, string);
+	}
 	return fnmatch(pattern, string, FNM_CASEFOLD) == 0;
 }
@@ -1,10 +1,19 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
+#include <wayland-server-core.h>
+#include "common/macros.h"
 #include "common/mem.h"
 
+#define SCRATCH_CHUNK_SIZE (16 * 1024)
+#define SCRATCH_ARRAY_MIN_ALLOC (16)
+#define POOL_SLAB_SIZE (16 * 1024)
+
 static void
 die_if_null(void *ptr)
 {
@@ -45,3 +54,203 @@ xstrdup(const char *str)
 	die_if_null(copy);
 	return copy;
 }
+
+struct scratch_chunk {
+	struct scratch_chunk *next;
+	size_t size;
+	size_t used;
+	max_align_t data[];
+};
+
+static struct {
+	struct wl_event_loop *loop;
+	struct wl_event_source *reset_idle;
+	/* The chunk currently allocated from comes first */
+	struct scratch_chunk *chunks;
+	size_t total_size;
+} scratch;
+
+static size_t
+scratch_align(size_t size)
+{
+	size_t align = alignof(max_align_t);
+	return (size + align - 1) & ~(align - 1);
+}
+
+static struct scratch_chunk *
+scratch_chunk_add(size_t size)
+{
+	struct scratch_chunk *chunk = xmalloc(sizeof(*chunk) + size);
+	chunk->next = scratch.chunks;
+	chunk->size = size;
+	chunk->used = 0;
+	scratch.chunks = chunk;
+	scratch.total_size += size;
+	return chunk;
+}
+
+static void
+scratch_chunks_free(void)
+{
+	struct scratch_chunk *chunk = scratch.chunks;
+	while (chunk) {
+		struct scratch_chunk *next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+	scratch.chunks = NULL;
+	scratch.total_size = 0;
+}
+
+static void
+handle_reset_idle(void *data)
+{
+	scratch.reset_idle = NULL;
+	if (!scratch.chunks->next) {
+		scratch.chunks->used = 0;
+		return;
+	}
+	/* Replace the chunks by one which fits everything next time */
+	size_t size = scratch.total_size;
+	scratch_chunks_free();
+	scratch_chunk_add(size);
+}
+
+void
+scratch_init(struct wl_event_loop *loop)
+{
+	scratch.loop = loop;
+}
+
+void
+scratch_finish(void)
+{
+	if (scratch.reset_idle) {
+		wl_event_source_remove(scratch.reset_idle);
+		scratch.reset_idle = NULL;
+	}
+	scratch_chunks_free();
+	scratch.loop = NULL;
+}
+
+void *
+scratch_alloc(size_t size)
+{
+	if (!size) {
+		return NULL;
+	}
+	size = scratch_align(size);
+	struct scratch_chunk *chunk = scratch.chunks;
+	if (!chunk || chunk->size - chunk->used < size) {
+		chunk = scratch_chunk_add(MAX(size, SCRATCH_CHUNK_SIZE));
+	}
+	if (scratch.loop && !scratch.reset_idle) {
+		scratch.reset_idle = wl_event_loop_add_idle(scratch.loop,
+			handle_reset_idle, NULL);
+	}
+	void *ptr = (char *)chunk->data + chunk->used;
+	chunk->used += size;
+	return ptr;
+}
+
+void *
+scratch_array_add(struct wl_array *array, size_t size)
+{
+	size_t needed = array->size + size;
+	if (needed > array->alloc) {
+		size_t alloc = array->alloc ? array->alloc : SCRATCH_ARRAY_MIN_ALLOC;
+		while (alloc < needed) {
+			alloc *= 2;
+		}
+		struct scratch_chunk *chunk = scratch.chunks;
+		bool is_last = chunk && array->data
+			&& (char *)array->data + array->alloc
+				== (char *)chunk->data + chunk->used;
+		if (is_last && chunk->size - chunk->used >= alloc - array->alloc) {
+			/* Grow in place */
+			chunk->used += alloc - array->alloc;
+		} else {
+			void *data = scratch_alloc(alloc);
+			if (array->size) {
+				memcpy(data, array->data, array->size);
+			}
+			array->data = data;
+		}
+		array->alloc = alloc;
+	}
+	void *ptr = (char *)array->data + array->size;
+	array->size += size;
+	return ptr;
+}
+
+struct pool_slab {
+	struct pool_slab *next;
+	max_align_t data[];
+};
+
+/* Freed objects are linked through their first bytes */
+struct pool_free_object {
+	struct pool_free_object *next;
+};
+
+static size_t
+pool_object_size(struct pool *pool)
+{
+	return scratch_align(MAX(pool->size,
+		sizeof(struct pool_free_object)));
+}
+
+static size_t
+pool_objects_per_slab(struct pool *pool)
+{
+	return MAX(POOL_SLAB_SIZE / pool_object_size(pool), 1);
+}
+
+void *
+pool_alloc(struct pool *pool)
+{
+	size_t size = pool_object_size(pool);
+	void *ptr;
+	if (pool->free_list) {
+		struct pool_free_object *object = pool->free_list;
+		pool->free_list = object->next;
+		ptr = object;
+	} else {
+		if (!pool->slabs
+				|| pool->slab_used == pool_objects_per_slab(pool)) {
+			struct pool_slab *slab = xmalloc(sizeof(*slab)
+				+ pool_objects_per_slab(pool) * size);
+			slab->next = pool->slabs;
+			pool->slabs = slab;
+			pool->slab_used = 0;
+		}
+		ptr = (char *)pool->slabs->data + pool->slab_used++ * size;
+	}
+	memset(ptr, 0, pool->size);
+	return ptr;
+}
+
+void
+pool_free(struct pool *pool, void *ptr)
+{
+	if (!ptr) {
+		return;
+	}
+	struct pool_free_object *object = ptr;
+	object->next = pool->free_list;
+	pool->free_list = object;
+}
+
+void
+pool_finish(struct pool *pool)
+{
+	struct pool_slab *slab = pool->slabs;
+	while (slab) {
+		struct pool_slab *next = slab->next;
+		free(slab);
+		slab = next;
+	}
+	pool->slabs = NULL;
+	pool->slab_used = 0;
+	pool->free_list = NULL;
+}
@@ -4,22 +4,130 @@
 #include <stdlib.h>
 #include <string.h>
 #include <wayland-server-core.h>
+#include <wlr/types/wlr_scene.h>
 #include <wlr/util/log.h>
 #include "buffer.h"
 #include "common/font.h"
+#include "common/font-worker.h"
 #include "common/mem.h"
 #include "common/scaled_scene_buffer.h"
 #include "common/scaled_font_buffer.h"
 
+/*
+ * Rendered text buffers are shared between all scaled_font_buffers with
+ * identical content, for example the titlebars of many windows with the
+ * same title. Entries are not locked by the cache itself; each user holds
+ * its own lock via scaled_scene_buffer and the entry goes away together
+ * with the buffer once the last user has released it.
+ */
+struct shared_font_buffer {
+	char *text;
+	int max_width;
+	float color[4];
+	float bg_color[4];
+	char *arrow;
+	struct font font;
+	double scale;
+	struct lab_data_buffer *buffer;
+	struct wl_listener destroy;
+	struct wl_list link; /* shared_font_buffers */
+};
+
+static struct wl_list shared_font_buffers;
+
+static bool
+str_equal(const char *a, const char *b)
+{
+	if (!a || !b) {
+		return a == b;
+	}
+	return !strcmp(a, b);
+}
+
+static bool
+shared_font_buffer_matches(struct shared_font_buffer *shared,
+		struct scaled_font_buffer *self, double scale)
+{
+	return shared->scale == scale
+		&& shared->max_width == self->max_width
+		&& shared->font.size == self->font.size
+		&& shared->font.slant == self->font.slant
+		&& shared->font.weight == self->font.weight
+		&& !memcmp(shared->color, self->color, sizeof(self->color))
+		&& !memcmp(shared->bg_color, self->bg_color,
+			sizeof(self->bg_color))
+		&& str_equal(shared->text, self->text)
+		&& str_equal(shared->arrow, self->arrow)
+		&& str_equal(shared->font.name, self->font.name);
+}
+
+static void
+handle_shared_buffer_destroy(struct wl_listener *listener, void *data)
+{
+	struct shared_font_buffer *shared =
+		wl_container_of(listener, shared, destroy);
+	wl_list_remove(&shared->destroy.link);
+	wl_list_remove(&shared->link);
+	free(shared->text);
+	free(shared->arrow);
+	free(shared->font.name);
+	free(shared);
+}
+
+static void
+shared_font_buffer_add(struct scaled_font_buffer *self, double scale,
+		struct lab_data_buffer *buffer)
+{
+	struct shared_font_buffer *shared = znew(*shared);
+	shared->text = xstrdup(self->text);
+	shared->max_width = self->max_width;
+	memcpy(shared->color, self->color, sizeof(shared->color));
+	memcpy(shared->bg_color, self->bg_color, sizeof(shared->bg_color));
+	shared->arrow = self->arrow ? xstrdup(self->arrow) : NULL;
+	shared->font = self->font;
+	shared->font.name = self->font.name ? xstrdup(self->font.name) : NULL;
+	shared->scale = scale;
+	shared->buffer = buffer;
+	shared->destroy.notify = handle_shared_buffer_destroy;
+	wl_signal_add(&buffer->base.events.destroy, &shared->destroy);
+	wl_list_insert(&shared_font_buffers, &shared->link);
+}
+
+static struct lab_data_buffer *
+shared_font_buffer_find(struct scaled_font_buffer *self, double scale)
+{
+	if (!shared_font_buffers.next) {
+		wl_list_init(&shared_font_buffers);
+	}
+	struct shared_font_buffer *shared;
+	wl_list_for_each(shared, &shared_font_buffers, link) {
+		if (shared_font_buffer_matches(shared, self, scale)) {
+			return shared->buffer;
+		}
+	}
+	return NULL;
+}
+
 static struct lab_data_buffer *
 _create_buffer(struct scaled_scene_buffer *scaled_buffer, double scale)
 {
-	struct lab_data_buffer *buffer;
 	struct scaled_font_buffer *self = scaled_buffer->data;
 
-	/* Buffer gets free'd automatically along the backing wlr_buffer */
-	font_buffer_create(&buffer, self->max_width, self->text,
-		&self->font, self->color, self->bg_color, self->arrow, scale);
+	struct lab_data_buffer *buffer = shared_font_buffer_find(self, scale);
+	if (!buffer && self->ready && self->ready_scale == scale) {
+		buffer = self->ready;
+		self->ready = NULL;
+		shared_font_buffer_add(self, scale, buffer);
+	}
+	if (!buffer) {
+		/* Buffer gets free'd automatically along the backing wlr_buffer */
+		font_buffer_create(&buffer, self->max_width, self->text,
+			&self->font, self->color, self->bg_color, self->arrow,
+			scale);
+		if (buffer) {
+			shared_font_buffer_add(self, scale, buffer);
+		}
+	}
 
 	self->width = buffer ? buffer->unscaled_width : 0;
 	self->height = buffer ? buffer->unscaled_height : 0;
@@ -32,6 +140,7 @@ _destroy(struct scaled_scene_buffer *scaled_buffer)
 	struct scaled_font_buffer *self = scaled_buffer->data;
 	scaled_buffer->data = NULL;
 
+	font_job_cancel(self->pending);
 	zfree(self->text);
 	zfree(self->font.name);
 	zfree(self->arrow);
@@ -43,6 +152,65 @@ static const struct scaled_scene_buffer_impl impl = {
 	.destroy = _destroy
 };
 
+static void
+handle_font_job_done(struct lab_data_buffer *buffer, double scale, void *data)
+{
+	struct scaled_font_buffer *self = data;
+	self->pending = NULL;
+	self->ready = buffer;
+	self->ready_scale = scale;
+
+	/* Picks up the new buffer unless the scale changed in the meantime */
+	scaled_scene_buffer_invalidate_cache(self->scaled_buffer);
+	if (self->ready) {
+		wlr_buffer_drop(&self->ready->base);
+		self->ready = NULL;
+	}
+}
+
+/*
+ * Replace already visible text by handing the rendering to the font worker,
+ * only the measurement is done right away. Returns false if the buffer has
+ * to be rendered synchronously instead.
+ */
+static bool
+render_async(struct scaled_font_buffer *self)
+{
+	double scale = self->scaled_buffer->active_scale;
+	if (!self->scene_buffer->buffer || shared_font_buffer_find(self, scale)) {
+		/* Nothing to keep showing or already rendered */
+		return false;
+	}
+
+	int text_width, arrow_width, height;
+	if (!font_buffer_size(self->max_width, self->text, &self->font,
+			self->arrow, &text_width, &arrow_width, &height)) {
+		return false;
+	}
+	self->pending = font_worker_submit(text_width, arrow_width, height,
+		self->text, &self->font, self->color, self->bg_color,
+		self->arrow, scale, handle_font_job_done, self);
+	if (!self->pending) {
+		return false;
+	}
+
+	self->width = text_width + arrow_width;
+	self->height = height;
+	return true;
+}
+
+static void
+update_buffer(struct scaled_font_buffer *self)
+{
+	font_job_cancel(self->pending);
+	self->pending = NULL;
+
+	if (!render_async(self)) {
+		/* Invalidate cache and force a new render */
+		scaled_scene_buffer_invalidate_cache(self->scaled_buffer);
+	}
+}
+
 /* Public API */
 struct scaled_font_buffer *
 scaled_font_buffer_create(struct wlr_scene_tree *parent)
@@ -90,13 +258,12 @@ scaled_font_buffer_update(struct scaled_font_buffer *self, const char *text,
 	memcpy(self->bg_color, bg_color, sizeof(self->bg_color));
 	self->arrow = arrow ? xstrdup(arrow) : NULL;
 
-	/* Invalidate cache and force a new render */
-	scaled_scene_buffer_invalidate_cache(self->scaled_buffer);
+	update_buffer(self);
 }
 
 void
 scaled_font_buffer_set_max_width(struct scaled_font_buffer *self, int max_width)
 {
 	self->max_width = max_width;
-	scaled_scene_buffer_invalidate_cache(self->scaled_buffer);
+	update_buffer(self);
 }
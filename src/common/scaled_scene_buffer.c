@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <wayland-server-core.h>
 #include <wlr/types/wlr_buffer.h>
@@ -8,47 +9,95 @@
 #include <wlr/types/wlr_scene.h>
 #include <wlr/util/log.h>
 #include "buffer.h"
+#include "common/macros.h"
 #include "common/mem.h"
 #include "common/scaled_scene_buffer.h"
 
-/**
- * TODO
- *
- * This implementation does not react to output scale changes itself but only
- * to movement of scene nodes to different outputs. To also handle output scale
- * changes we'd need to keep a list of struct wlr_outputs * in sync and listen
- * to their commit signals.
- *
- * The detection of the max output scale is also not 100% robust for all use
- * cases as on output_enter we only compare the new output scale with the
- * primary_output scale. In specific conditions the primary output may be the
- * same as the new output even though a smaller part of the buffer node is
- * still visible on an output with a bigger scale. This could be solved the
- * same way as the previous point in keeping a list of outputs in sync.
- *
- * Most of this would be easier when wlroots would instead provide a
- * max_scale_changed event because it already touches all the relevant parts
- * when calculating the primary_output and inform wlr_scene_buffers about
- * output changes.
- *
- * See wlroots/types/scene/wlr_scene.c scene_buffer_update_outputs()
+/*
+ * wlroots does not provide a max_scale_changed event, so the maximum scale
+ * of all outputs a buffer is displayed on is recomputed from the active
+ * outputs of the wlr_scene_buffer on output_enter and output_leave. Output
+ * scale changes which do not move the buffer between outputs are reported
+ * by output.c via scaled_scene_buffer_on_output_scale_change().
  */
 
+/* State shared by all scaled_scene_buffers */
+static struct {
+	int cache_size;
+	size_t memory_used;
+	/* Statistics, see scaled_scene_buffer_print_stats() */
+	size_t nr_entries;
+	size_t nr_hits;
+	size_t nr_misses;
+	size_t nr_evictions_cache_size;
+	size_t nr_evictions_budget;
+	size_t nr_evictions_trim;
+	/* All cache entries, most recently used first */
+	struct wl_list lru;  /* struct scaled_scene_buffer_cache_entry.global_link */
+	struct wl_list instances;  /* struct scaled_scene_buffer.link */
+} caches = {
+	.cache_size = LAB_SCALED_BUFFER_MIN_CACHE,
+};
+
 /* Internal API */
+static void
+_unlock_buffer(struct wlr_buffer *buffer, bool drop_buffer)
+{
+	/*
+	 * A buffer may be shared between multiple scaled_scene_buffers,
+	 * in which case the first one letting go of it drops it and the
+	 * remaining locks keep it alive until the last consumer is gone.
+	 * The lock is released last as it may free the buffer.
+	 */
+	if (drop_buffer && !buffer->dropped) {
+		wlr_buffer_drop(buffer);
+	}
+	wlr_buffer_unlock(buffer);
+}
+
 static void
 _cache_entry_destroy(struct scaled_scene_buffer_cache_entry *cache_entry, bool drop_buffer)
 {
 	wl_list_remove(&cache_entry->link);
+	wl_list_remove(&cache_entry->global_link);
+	cache_entry->owner->nr_cache_entries--;
+	caches.nr_entries--;
+	caches.memory_used -= cache_entry->size;
 	if (cache_entry->buffer) {
 		/* Allow the buffer to get dropped if there are no further consumers */
-		wlr_buffer_unlock(cache_entry->buffer);
-		if (drop_buffer) {
-			wlr_buffer_drop(cache_entry->buffer);
-		}
+		_unlock_buffer(cache_entry->buffer, drop_buffer);
 	}
 	free(cache_entry);
 }
 
+static bool
+_cache_entry_is_active(struct scaled_scene_buffer_cache_entry *cache_entry)
+{
+	/* The most recently used entry is the one currently displayed */
+	return cache_entry->owner->cache.next == &cache_entry->link;
+}
+
+/*
+ * Evict the least recently used buffers of any scaled_scene_buffer until
+ * the memory budget is met again, sparing the ones currently displayed.
+ */
+static void
+_enforce_memory_budget(void)
+{
+	struct scaled_scene_buffer_cache_entry *cache_entry, *cache_entry_tmp;
+	wl_list_for_each_reverse_safe(cache_entry, cache_entry_tmp,
+			&caches.lru, global_link) {
+		if (caches.memory_used <= LAB_SCALED_BUFFER_MEMORY_BUDGET) {
+			break;
+		}
+		if (!_cache_entry_is_active(cache_entry)) {
+			caches.nr_evictions_budget++;
+			_cache_entry_destroy(cache_entry,
+				cache_entry->owner->drop_buffer);
+		}
+	}
+}
+
 static void
 _update_buffer(struct scaled_scene_buffer *self, double scale)
 {
@@ -61,10 +110,14 @@ _update_buffer(struct scaled_scene_buffer *self, double scale)
 			/* LRU cache, recently used in front */
 			wl_list_remove(&cache_entry->link);
 			wl_list_insert(&self->cache, &cache_entry->link);
+			wl_list_remove(&cache_entry->global_link);
+			wl_list_insert(&caches.lru, &cache_entry->global_link);
 			wlr_scene_buffer_set_buffer(self->scene_buffer, cache_entry->buffer);
+			caches.nr_hits++;
 			return;
 		}
 	}
+	caches.nr_misses++;
 
 	/* Create new buffer, will get destroyed along the backing wlr_buffer */
 	struct lab_data_buffer *buffer = self->impl->create_buffer(self, scale);
@@ -75,25 +128,28 @@ _update_buffer(struct scaled_scene_buffer *self, double scale)
 	self->width = buffer ? buffer->unscaled_width : 0;
 	self->height = buffer ? buffer->unscaled_height : 0;
 
-	/* Create or reuse cache entry */
-	if (wl_list_length(&self->cache) < LAB_SCALED_BUFFER_MAX_CACHE) {
-		cache_entry = znew(*cache_entry);
-	} else {
+	/* Make room by evicting the least recently used buffers */
+	while (self->nr_cache_entries >= caches.cache_size) {
 		cache_entry = wl_container_of(self->cache.prev, cache_entry, link);
-		if (cache_entry->buffer) {
-			/* Allow the old buffer to get dropped if there are no further consumers */
-			wlr_buffer_unlock(cache_entry->buffer);
-			if (self->drop_buffer) {
-				wlr_buffer_drop(cache_entry->buffer);
-			}
-		}
-		wl_list_remove(&cache_entry->link);
+		caches.nr_evictions_cache_size++;
+		_cache_entry_destroy(cache_entry, self->drop_buffer);
 	}
 
-	/* Update the cache entry */
+	/* Add the new cache entry */
+	cache_entry = znew(*cache_entry);
+	cache_entry->owner = self;
 	cache_entry->scale = scale;
 	cache_entry->buffer = buffer ? &buffer->base : NULL;
+	if (buffer) {
+		cache_entry->size = (size_t)4 * buffer->base.width
+			* buffer->base.height;
+	}
 	wl_list_insert(&self->cache, &cache_entry->link);
+	wl_list_insert(&caches.lru, &cache_entry->global_link);
+	self->nr_cache_entries++;
+	caches.nr_entries++;
+	caches.memory_used += cache_entry->size;
+	_enforce_memory_budget();
 
 	/* And finally update the wlr_scene_buffer itself */
 	wlr_scene_buffer_set_buffer(self->scene_buffer, cache_entry->buffer);
@@ -110,6 +166,7 @@ _handle_node_destroy(struct wl_listener *listener, void *data)
 	wl_list_remove(&self->destroy.link);
 	wl_list_remove(&self->output_enter.link);
 	wl_list_remove(&self->output_leave.link);
+	wl_list_remove(&self->link);
 
 	wl_list_for_each_safe(cache_entry, cache_entry_tmp, &self->cache, link) {
 		_cache_entry_destroy(cache_entry, self->drop_buffer);
@@ -122,24 +179,45 @@ _handle_node_destroy(struct wl_listener *listener, void *data)
 	free(self);
 }
 
+/*
+ * Maximum scale of all outputs the buffer is displayed on,
+ * or 0 if it is not displayed at all.
+ */
+static double
+_get_max_scale(struct scaled_scene_buffer *self, struct wlr_scene *scene)
+{
+	double max_scale = 0;
+	struct wlr_scene_output *scene_output;
+	wl_list_for_each(scene_output, &scene->outputs, link) {
+		uint64_t mask = 1ull << scene_output->index;
+		if ((self->scene_buffer->active_outputs & mask)
+				&& scene_output->output->scale > max_scale) {
+			max_scale = scene_output->output->scale;
+		}
+	}
+	return max_scale;
+}
+
+static void
+_update_scale(struct scaled_scene_buffer *self, struct wlr_scene *scene)
+{
+	double max_scale = _get_max_scale(self, scene);
+
+	/* Keep the current buffer while not displayed on any output */
+	if (max_scale > 0 && self->active_scale != max_scale) {
+		_update_buffer(self, max_scale);
+	}
+}
+
 static void
 _handle_output_enter(struct wl_listener *listener, void *data)
 {
 	struct scaled_scene_buffer *self =
 		wl_container_of(listener, self, output_enter);
-	/* primary_output is the output most of the node area is in */
-	struct wlr_scene_output *primary = self->scene_buffer->primary_output;
 	/* scene_output is the output we just entered */
 	struct wlr_scene_output *scene_output = data;
-	double max_scale = scene_output->output->scale;
 
-	if (primary && primary->output->scale > max_scale) {
-		max_scale = primary->output->scale;
-	}
-
-	if (self->active_scale != max_scale) {
-		_update_buffer(self, max_scale);
-	}
+	_update_scale(self, scene_output->scene);
 }
 
 static void
@@ -147,12 +225,10 @@ _handle_output_leave(struct wl_listener *listener, void *data)
 {
 	struct scaled_scene_buffer *self =
 		wl_container_of(listener, self, output_leave);
-	/* primary_output is the output most of the node area is in */
-	struct wlr_scene_output *primary = self->scene_buffer->primary_output;
+	/* scene_output is the output we just left */
+	struct wlr_scene_output *scene_output = data;
 
-	if (primary && primary->output->scale != self->active_scale) {
-		_update_buffer(self, primary->output->scale);
-	}
+	_update_scale(self, scene_output->scene);
 }
 
 /* Public API */
@@ -178,6 +254,12 @@ scaled_scene_buffer_create(struct wlr_scene_tree *parent,
 	self->drop_buffer = drop_buffer;
 	wl_list_init(&self->cache);
 
+	if (!caches.instances.next) {
+		wl_list_init(&caches.lru);
+		wl_list_init(&caches.instances);
+	}
+	wl_list_insert(&caches.instances, &self->link);
+
 	/* Listen to output enter/leave so we get notified about scale changes */
 	self->output_enter.notify = _handle_output_enter;
 	wl_signal_add(&self->scene_buffer->events.output_enter, &self->output_enter);
@@ -202,3 +284,73 @@ scaled_scene_buffer_invalidate_cache(struct scaled_scene_buffer *self)
 	assert(wl_list_empty(&self->cache));
 	_update_buffer(self, self->active_scale);
 }
+
+void
+scaled_scene_buffer_on_output_scale_change(struct wlr_scene_output *scene_output)
+{
+	assert(scene_output);
+	if (!caches.instances.next) {
+		return;
+	}
+
+	uint64_t mask = 1ull << scene_output->index;
+	struct scaled_scene_buffer *self;
+	wl_list_for_each(self, &caches.instances, link) {
+		if (self->scene_buffer->active_outputs & mask) {
+			_update_scale(self, scene_output->scene);
+		}
+	}
+}
+
+void
+scaled_scene_buffer_trim_caches(void)
+{
+	if (!caches.instances.next) {
+		return;
+	}
+	struct scaled_scene_buffer_cache_entry *cache_entry, *cache_entry_tmp;
+	wl_list_for_each_safe(cache_entry, cache_entry_tmp,
+			&caches.lru, global_link) {
+		if (!_cache_entry_is_active(cache_entry)) {
+			caches.nr_evictions_trim++;
+			_cache_entry_destroy(cache_entry,
+				cache_entry->owner->drop_buffer);
+		}
+	}
+}
+
+void
+scaled_scene_buffer_set_cache_size(int size)
+{
+	caches.cache_size = MAX(size, LAB_SCALED_BUFFER_MIN_CACHE);
+}
+
+void
+scaled_scene_buffer_get_stats(struct scaled_scene_buffer_stats *stats)
+{
+	*stats = (struct scaled_scene_buffer_stats){
+		.nr_entries = caches.nr_entries,
+		.memory_used = caches.memory_used,
+		.nr_hits = caches.nr_hits,
+		.nr_misses = caches.nr_misses,
+		.nr_evictions_cache_size = caches.nr_evictions_cache_size,
+		.nr_evictions_budget = caches.nr_evictions_budget,
+		.nr_evictions_trim = caches.nr_evictions_trim,
+	};
+}
+
+void
+scaled_scene_buffer_print_stats(void)
+{
+	printf("Scaled buffer caches\n");
+	printf("   instances: %d, entries: %zu, cache size: %d\n",
+		caches.instances.next ? wl_list_length(&caches.instances) : 0,
+		caches.nr_entries, caches.cache_size);
+	printf("   memory: %zu KiB of %d KiB budget\n",
+		caches.memory_used / 1024,
+		LAB_SCALED_BUFFER_MEMORY_BUDGET / 1024);
+	printf("   hits: %zu, misses: %zu\n", caches.nr_hits, caches.nr_misses);
+	printf("   evictions: %zu by cache size, %zu by memory budget, "
+		"%zu by trimming\n", caches.nr_evictions_cache_size,
+		caches.nr_evictions_budget, caches.nr_evictions_trim);
+}
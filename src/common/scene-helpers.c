@@ -1,10 +1,12 @@
 // SPDX-License-Identifier: GPL-2.0-only
 
 #include <assert.h>
+#include <inttypes.h>
 #include <wlr/types/wlr_output.h>
 #include <wlr/types/wlr_scene.h>
 #include <wlr/util/log.h>
 #include "common/scene-helpers.h"
+#include "common/time-helpers.h"
 
 struct wlr_surface *
 lab_wlr_surface_from_node(struct wlr_scene_node *node)
@@ -34,31 +36,114 @@ lab_wlr_scene_get_prev_node(struct wlr_scene_node *node)
 	return prev;
 }
 
+struct wlr_scene_node *
+lab_wlr_scene_node_at_skip(struct wlr_scene_tree *tree,
+		struct wlr_scene_node *skip, double lx, double ly,
+		double *nx, double *ny)
+{
+	assert(tree);
+	if (!tree->node.enabled) {
+		return NULL;
+	}
+
+	/* Top-most first, like wlr_scene_node_at() */
+	struct wlr_scene_node *child;
+	wl_list_for_each_reverse(child, &tree->children, link) {
+		if (child == skip) {
+			continue;
+		}
+		struct wlr_scene_node *node =
+			wlr_scene_node_at(child, lx, ly, nx, ny);
+		if (node) {
+			return node;
+		}
+	}
+	return NULL;
+}
+
 /*
  * This is a copy of wlr_scene_output_commit()
  * as it doesn't use the pending state at all.
  */
 bool
-lab_wlr_scene_output_commit(struct wlr_scene_output *scene_output)
+lab_wlr_scene_output_commit(struct wlr_scene_output *scene_output,
+		struct lab_scene_commit_timing *timing)
+{
+	return lab_wlr_scene_output_build(scene_output, timing)
+		&& lab_wlr_scene_output_commit_built(scene_output, timing);
+}
+
+/* Logs the damage of each frame while it is highlighted for debugging */
+static void
+log_damage(struct wlr_scene_output *scene_output)
+{
+	if (scene_output->scene->debug_damage_option
+			!= WLR_SCENE_DEBUG_DAMAGE_HIGHLIGHT) {
+		return;
+	}
+	int nr_rects;
+	const pixman_box32_t *rects = pixman_region32_rectangles(
+		&scene_output->damage_ring.current, &nr_rects);
+	int64_t area = 0;
+	for (int i = 0; i < nr_rects; i++) {
+		area += (int64_t)(rects[i].x2 - rects[i].x1)
+			* (rects[i].y2 - rects[i].y1);
+	}
+	pixman_box32_t *extents =
+		pixman_region32_extents(&scene_output->damage_ring.current);
+	wlr_log(WLR_INFO, "damage on %s: %" PRId64 " px in %d rects, "
+		"extents %dx%d+%d+%d", scene_output->output->name, area,
+		nr_rects, extents->x2 - extents->x1, extents->y2 - extents->y1,
+		extents->x1, extents->y1);
+}
+
+bool
+lab_wlr_scene_output_build(struct wlr_scene_output *scene_output,
+		struct lab_scene_commit_timing *timing)
 {
 	assert(scene_output);
 	struct wlr_output *wlr_output = scene_output->output;
 	struct wlr_output_state *state = &wlr_output->pending;
 
+	/* A pending gamma LUT is committed even without damage */
 	if (!wlr_output->needs_frame && !pixman_region32_not_empty(
-			&scene_output->damage_ring.current)) {
+			&scene_output->damage_ring.current)
+			&& !(state->committed & WLR_OUTPUT_STATE_GAMMA_LUT)) {
 		return false;
 	}
+	log_damage(scene_output);
+	int64_t start = timing ? time_now_nsec() : 0;
 	if (!wlr_scene_output_build_state(scene_output, state, NULL)) {
 		wlr_log(WLR_ERROR, "Failed to build output state for %s",
 			wlr_output->name);
 		return false;
 	}
+	if (timing) {
+		timing->build_state_nsec = time_now_nsec() - start;
+	}
+	return true;
+}
+
+bool
+lab_wlr_scene_output_commit_built(struct wlr_scene_output *scene_output,
+		struct lab_scene_commit_timing *timing)
+{
+	assert(scene_output);
+	struct wlr_output *wlr_output = scene_output->output;
+	struct wlr_output_state *state = &wlr_output->pending;
+
+	int64_t start = timing ? time_now_nsec() : 0;
+	struct wlr_buffer *buffer = (state->committed & WLR_OUTPUT_STATE_BUFFER)
+		? state->buffer : NULL;
 	if (!wlr_output_commit(wlr_output)) {
 		wlr_log(WLR_INFO, "Failed to commit output %s",
 			wlr_output->name);
 		return false;
 	}
+	if (timing) {
+		timing->commit_nsec = time_now_nsec() - start;
+		timing->buffer = buffer;
+	}
 	/*
 	 * FIXME: Remove the following line as soon as
 	 * https://gitlab.freedesktop.org/wlroots/wlroots/-/merge_requests/4253
@@ -68,3 +153,40 @@ lab_wlr_scene_output_commit(struct wlr_scene_output *scene_output)
 	wlr_damage_ring_rotate(&scene_output->damage_ring);
 	return true;
 }
+
+static void
+send_frame_done_iter(struct wlr_scene_node *node,
+		struct wlr_scene_output *scene_output, struct timespec *now,
+		bool (*skip)(struct wlr_scene_tree *tree, void *data), void *data)
+{
+	if (!node->enabled) {
+		return;
+	}
+
+	if (node->type == WLR_SCENE_NODE_BUFFER) {
+		struct wlr_scene_buffer *buffer = wlr_scene_buffer_from_node(node);
+		if (buffer->primary_output == scene_output) {
+			wlr_scene_buffer_send_frame_done(buffer, now);
+		}
+	} else if (node->type == WLR_SCENE_NODE_TREE) {
+		struct wlr_scene_tree *tree = wlr_scene_tree_from_node(node);
+		if (skip(tree, data)) {
+			return;
+		}
+		struct wlr_scene_node *child;
+		wl_list_for_each(child, &tree->children, link) {
+			send_frame_done_iter(child, scene_output, now, skip, data);
+		}
+	}
+}
+
+void
+lab_wlr_scene_output_send_frame_done(struct wlr_scene_output *scene_output,
+		struct timespec *now,
+		bool (*skip)(struct wlr_scene_tree *tree, void *data), void *data)
+{
+	assert(scene_output);
+	assert(skip);
+	send_frame_done_iter(&scene_output->scene->tree.node, scene_output,
+		now, skip, data);
+}
@@ -1,16 +1,27 @@
 // SPDX-License-Identifier: GPL-2.0-only
-#define _POSIX_C_SOURCE 200809L
+/* _GNU_SOURCE for POSIX_SPAWN_SETSID */
+#define _GNU_SOURCE
 #include <assert.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <glib.h>
+#include <limits.h>
+#include <sched.h>
 #include <signal.h>
+#include <spawn.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <wlr/util/log.h>
-#include "common/spawn.h"
+#include "common/buf.h"
 #include "common/fd_util.h"
+#include "common/mem.h"
+#include "common/spawn.h"
 
 static void
 reset_signals_and_limits(void)
@@ -23,6 +34,72 @@ reset_signals_and_limits(void)
 
 	/* Restore ignored signals */
 	signal(SIGPIPE, SIG_DFL);
+
+	/*
+	 * Drop real-time scheduling, see realtime.h. Memory locks are not
+	 * inherited and SCHED_RESET_ON_FORK usually did this already, but
+	 * not if labwc was started with a real-time policy, e.g. by chrt.
+	 */
+	struct sched_param param = { 0 };
+	sched_setscheduler(0, SCHED_OTHER, &param);
+}
+
+extern char **environ;
+
+/*
+ * posix_spawn() is implemented with vfork() semantics by glibc and musl,
+ * so unlike fork() it does not have to copy the page tables of the
+ * compositor. The signal mask is cleared and ignored signals are restored
+ * to their default action.
+ *
+ * There is no spawn attribute for resource limits, so the original open
+ * files limit is restored in labwc itself for the duration of the call
+ * and the child inherits it. This is fine because only the main thread
+ * spawns processes.
+ */
+static pid_t
+spawn_process(const char *path, char *const argv[], char *const envp[],
+		const posix_spawn_file_actions_t *file_actions, bool new_session)
+{
+	posix_spawnattr_t attr;
+	posix_spawnattr_init(&attr);
+
+	short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+#ifdef POSIX_SPAWN_SETSID
+	if (new_session) {
+		flags |= POSIX_SPAWN_SETSID;
+	}
+#else
+	assert(!new_session);
+#endif
+	posix_spawnattr_setflags(&attr, flags);
+
+	sigset_t set;
+	sigemptyset(&set);
+	posix_spawnattr_setsigmask(&attr, &set);
+
+	/* Restore ignored signals, SIGCHLD is ignored by the spawn helper */
+	sigaddset(&set, SIGPIPE);
+	sigaddset(&set, SIGCHLD);
+	posix_spawnattr_setsigdefault(&attr, &set);
+
+	if (!envp) {
+		envp = environ;
+	}
+
+	pid_t pid = -1;
+	restore_nofile_limit();
+	int err = path
+		? posix_spawn(&pid, path, file_actions, &attr, argv, envp)
+		: posix_spawnp(&pid, argv[0], file_actions, &attr, argv, envp);
+	increase_nofile_limit();
+	posix_spawnattr_destroy(&attr);
+
+	if (err) {
+		errno = err;
+		return -1;
+	}
+	return pid;
 }
 
 static bool
@@ -43,6 +120,170 @@ set_cloexec(int fd)
 	return true;
 }
 
+#ifdef POSIX_SPAWN_SETSID
+/*
+ * The spawn helper is a child forked from main() before labwc starts any
+ * threads or opens its backends, so it is small and safe to use malloc()
+ * and stdio in. It closes whatever file descriptors it inherited anyway,
+ * so that it never holds on to devices or sockets of the compositor.
+ * Commands are sent to it as one SOCK_SEQPACKET message each, holding the
+ * number of arguments, the arguments and the environment of labwc at the
+ * time of the request, all as NUL-terminated strings.
+ */
+#define SPAWN_HELPER_MAX_MSG (64 * 1024)
+
+static int spawn_helper_fd = -1;
+
+static void
+close_inherited_fds(int keep)
+{
+	struct rlimit limit;
+	int max_fd = 1024;
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0
+			&& limit.rlim_cur != RLIM_INFINITY
+			&& limit.rlim_cur < INT_MAX) {
+		max_fd = limit.rlim_cur;
+	}
+	for (int fd = STDERR_FILENO + 1; fd < max_fd; fd++) {
+		if (fd != keep) {
+			close(fd);
+		}
+	}
+}
+
+static void
+spawn_helper_run(int fd)
+{
+	reset_signals_and_limits();
+	close_inherited_fds(fd);
+	/* Let the kernel reap the children of the helper */
+	signal(SIGCHLD, SIG_IGN);
+
+	char *msg = xmalloc(SPAWN_HELPER_MAX_MSG + 1);
+	char **argv = xmalloc((SPAWN_HELPER_MAX_MSG + 2) * sizeof(*argv));
+	while (true) {
+		ssize_t len = recv(fd, msg, SPAWN_HELPER_MAX_MSG, 0);
+		if (len < 0 && errno == EINTR) {
+			continue;
+		}
+		if (len <= 0) {
+			/* labwc went away */
+			_exit(0);
+		}
+		msg[len] = '\0';
+
+		/* Split into argv and envp */
+		size_t argc = strtoul(msg, NULL, 10);
+		char **envp = NULL;
+		size_t n = 0;
+		for (char *p = msg + strlen(msg) + 1; p < msg + len;
+				p += strlen(p) + 1) {
+			if (n == argc) {
+				argv[n++] = NULL;
+				envp = argv + n;
+			}
+			argv[n++] = p;
+		}
+		argv[n] = NULL;
+		if (!argc || n < argc) {
+			continue;
+		}
+		if (!envp) {
+			/* Empty environment */
+			envp = argv + n;
+		}
+
+		if (spawn_process(NULL, argv, envp, NULL,
+				/*new_session*/ true) < 0) {
+			wlr_log_errno(WLR_ERROR, "unable to execute %s", argv[0]);
+		}
+	}
+}
+
+void
+spawn_helper_start(void)
+{
+	if (spawn_helper_fd >= 0) {
+		return;
+	}
+
+	int sv[2];
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+		wlr_log_errno(WLR_ERROR, "unable to create spawn helper socket");
+		return;
+	}
+
+	pid_t pid = fork();
+	if (pid < 0) {
+		wlr_log_errno(WLR_ERROR, "unable to fork spawn helper");
+		close(sv[0]);
+		close(sv[1]);
+		return;
+	} else if (pid == 0) {
+		close(sv[0]);
+		spawn_helper_run(sv[1]);
+	}
+
+	close(sv[1]);
+	spawn_helper_fd = sv[0];
+	wlr_log(WLR_INFO, "started spawn helper %ld", (long)pid);
+}
+
+void
+spawn_helper_stop(void)
+{
+	if (spawn_helper_fd < 0) {
+		return;
+	}
+	/* The helper handles outstanding requests and exits on EOF */
+	close(spawn_helper_fd);
+	spawn_helper_fd = -1;
+}
+
+/* Return true if the helper took care of the command */
+static bool
+spawn_helper_send(char **argv)
+{
+	if (spawn_helper_fd < 0) {
+		return false;
+	}
+
+	struct buf msg = BUF_INIT;
+	buf_add_fmt(&msg, "%u", g_strv_length(argv));
+	buf_add_len(&msg, "", 1);
+	for (char **arg = argv; *arg; arg++) {
+		buf_add_len(&msg, *arg, strlen(*arg) + 1);
+	}
+	for (char **env = environ; *env; env++) {
+		buf_add_len(&msg, *env, strlen(*env) + 1);
+	}
+
+	bool sent = false;
+	if (msg.len <= SPAWN_HELPER_MAX_MSG) {
+		ssize_t ret = send(spawn_helper_fd, msg.data, msg.len,
+			MSG_DONTWAIT | MSG_NOSIGNAL);
+		sent = ret == msg.len;
+		if (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+			wlr_log_errno(WLR_ERROR, "spawn helper gone");
+			spawn_helper_stop();
+		}
+	}
+	buf_reset(&msg);
+	return sent;
+}
+#else
+void
+spawn_helper_start(void)
+{
+	wlr_log(WLR_ERROR, "spawn helper not supported on this system");
+}
+
+void
+spawn_helper_stop(void)
+{
+}
+#endif
+
 void
 spawn_async_no_shell(char const *command)
 {
@@ -59,6 +300,16 @@ spawn_async_no_shell(char const *command)
 		return;
 	}
 
+#ifdef POSIX_SPAWN_SETSID
+	/*
+	 * Prefer the spawn helper if running. Otherwise spawn directly, the
+	 * child is then reaped by the SIGCHLD handler in src/server.c
+	 */
+	if (!spawn_helper_send(argv) && spawn_process(NULL, argv, NULL, NULL,
+			/*new_session*/ true) < 0) {
+		wlr_log_errno(WLR_ERROR, "unable to execute %s", argv[0]);
+	}
+#else
 	/*
 	 * Avoid zombie processes by using a double-fork, whereby the
 	 * grandchild becomes orphaned & the responsibility of the OS.
@@ -69,7 +320,7 @@ spawn_async_no_shell(char const *command)
 	switch (child) {
 	case -1:
 		wlr_log(WLR_ERROR, "unable to fork()");
-		goto out;
+		break;
 	case 0:
 		reset_signals_and_limits();
 
@@ -83,10 +334,10 @@ spawn_async_no_shell(char const *command)
 		}
 		_exit(0);
 	default:
+		waitpid(child, NULL, 0);
 		break;
 	}
-	waitpid(child, NULL, 0);
-out:
+#endif
 	g_strfreev(argv);
 }
 
@@ -106,23 +357,19 @@ spawn_primary_client(const char *command)
 		return -1;
 	}
 
-	pid_t child = fork();
-	switch (child) {
-	case -1:
-		wlr_log_errno(WLR_ERROR, "Failed to fork");
-		g_strfreev(argv);
-		return -1;
-	case 0:
-		/* child */
-		close(STDIN_FILENO);
-		reset_signals_and_limits();
-		execvp(argv[0], argv);
-		wlr_log_errno(WLR_ERROR, "Failed to execute primary client %s", command);
-		_exit(1);
-	default:
-		g_strfreev(argv);
-		return child;
+	posix_spawn_file_actions_t file_actions;
+	posix_spawn_file_actions_init(&file_actions);
+	posix_spawn_file_actions_addclose(&file_actions, STDIN_FILENO);
+
+	pid_t child = spawn_process(NULL, argv, NULL, &file_actions,
+		/*new_session*/ false);
+	if (child < 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to execute primary client %s",
+			command);
 	}
+	posix_spawn_file_actions_destroy(&file_actions);
+	g_strfreev(argv);
+	return child;
 }
 
 pid_t
@@ -136,49 +383,31 @@ spawn_piped(const char *command, int *pipe_fd)
 		return -1;
 	}
 
-	pid_t pid = fork();
+	/*
+	 * Replace stdin and stderr with /dev/null
+	 * and stdout with the write end of the pipe
+	 */
+	posix_spawn_file_actions_t file_actions;
+	posix_spawn_file_actions_init(&file_actions);
+	posix_spawn_file_actions_adddup2(&file_actions, pipe_rw[1], STDOUT_FILENO);
+	posix_spawn_file_actions_addclose(&file_actions, pipe_rw[0]);
+	posix_spawn_file_actions_addclose(&file_actions, pipe_rw[1]);
+	posix_spawn_file_actions_addopen(&file_actions, STDIN_FILENO,
+		"/dev/null", O_RDWR, 0);
+	posix_spawn_file_actions_adddup2(&file_actions, STDIN_FILENO,
+		STDERR_FILENO);
+
+	char *const argv[] = { "sh", "-c", (char *)command, NULL };
+	pid_t pid = spawn_process("/bin/sh", argv, NULL, &file_actions,
+		/*new_session*/ false);
+	posix_spawn_file_actions_destroy(&file_actions);
 	if (pid < 0) {
 		close(pipe_rw[0]);
 		close(pipe_rw[1]);
-		wlr_log(WLR_ERROR, "unable to fork()");
+		wlr_log_errno(WLR_ERROR, "unable to spawn %s", command);
 		return pid;
 	}
 
-	if (pid == 0) {
-		/* child */
-		reset_signals_and_limits();
-
-		/*
-		 * replace stdin and stderr with /dev/null
-		 * and stdout with the write end of the pipe
-		 */
-		dup2(pipe_rw[1], STDOUT_FILENO);
-		close(pipe_rw[0]);
-		close(pipe_rw[1]);
-
-		int dev_null = open("/dev/null", O_RDWR);
-		if (dev_null < 0) {
-			wlr_log_errno(WLR_ERROR, "opening /dev/null failed");
-			/*
-			 * Just close stdin and stderr and
-			 * hope $command can deal with that.
-			 */
-			close(STDIN_FILENO);
-			close(STDERR_FILENO);
-		} else {
-			dup2(dev_null, STDIN_FILENO);
-			dup2(dev_null, STDERR_FILENO);
-			close(dev_null);
-		}
-
-		execl("/bin/sh", "sh", "-c", command, NULL);
-		/*
-		 * Our stderr points to /dev/null or is closed
-		 * at this point so logging is pretty useless.
-		 */
-		_exit(1);
-	}
-
 	/* labwc */
 	close(pipe_rw[1]);
 
@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#include "common/time-helpers.h"
+
+int64_t
+time_timespec_to_nsec(const struct timespec *ts)
+{
+	return (int64_t)ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+int64_t
+time_now_nsec(void)
+{
+	struct timespec now = { 0 };
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return time_timespec_to_nsec(&now);
+}
@@ -0,0 +1,191 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+#include "common/mem.h"
+#include "common/time-helpers.h"
+#include "common/timers.h"
+#include "latency-trace.h"
+
+struct lab_timer {
+	int64_t deadline_nsec;
+	int index; /* in timers.heap, -1 if disarmed */
+	wl_event_loop_timer_func_t func;
+	void *data;
+	const char *name;
+};
+
+/* Armed timers are kept in a binary min-heap ordered by deadline */
+static struct {
+	struct wl_event_loop *loop;
+	struct wl_event_source *source;
+	struct lab_timer **heap;
+	int nr_armed;
+	int alloc;
+	int nr_timers;
+	bool dispatching;
+} timers;
+
+static bool
+is_earlier(int a, int b)
+{
+	return timers.heap[a]->deadline_nsec < timers.heap[b]->deadline_nsec;
+}
+
+static void
+swap(int a, int b)
+{
+	struct lab_timer *tmp = timers.heap[a];
+	timers.heap[a] = timers.heap[b];
+	timers.heap[b] = tmp;
+	timers.heap[a]->index = a;
+	timers.heap[b]->index = b;
+}
+
+static void
+sift_up(int i)
+{
+	while (i > 0 && is_earlier(i, (i - 1) / 2)) {
+		swap(i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+static void
+sift_down(int i)
+{
+	for (;;) {
+		int min = i;
+		int left = 2 * i + 1;
+		int right = left + 1;
+		if (left < timers.nr_armed && is_earlier(left, min)) {
+			min = left;
+		}
+		if (right < timers.nr_armed && is_earlier(right, min)) {
+			min = right;
+		}
+		if (min == i) {
+			return;
+		}
+		swap(i, min);
+		i = min;
+	}
+}
+
+static void
+heap_insert(struct lab_timer *timer)
+{
+	if (timers.nr_armed == timers.alloc) {
+		timers.alloc = timers.alloc ? 2 * timers.alloc : 16;
+		timers.heap = xrealloc(timers.heap,
+			timers.alloc * sizeof(*timers.heap));
+	}
+	timer->index = timers.nr_armed++;
+	timers.heap[timer->index] = timer;
+	sift_up(timer->index);
+}
+
+static void
+heap_remove(struct lab_timer *timer)
+{
+	int i = timer->index;
+	assert(i >= 0 && i < timers.nr_armed);
+	timer->index = -1;
+	if (i == --timers.nr_armed) {
+		return;
+	}
+	timers.heap[i] = timers.heap[timers.nr_armed];
+	timers.heap[i]->index = i;
+	sift_down(i);
+	sift_up(i);
+}
+
+/* Arm the timerfd for the earliest deadline */
+static void
+rearm(void)
+{
+	if (timers.dispatching || !timers.source) {
+		return;
+	}
+	if (!timers.nr_armed) {
+		wl_event_source_timer_update(timers.source, 0);
+		return;
+	}
+	int64_t delay = timers.heap[0]->deadline_nsec - time_now_nsec();
+	/* Round up, a timer must never expire early */
+	int ms_delay = (delay + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC;
+	wl_event_source_timer_update(timers.source, ms_delay > 0 ? ms_delay : 1);
+}
+
+static int
+handle_timeout(void *data)
+{
+	int64_t now = time_now_nsec();
+	timers.dispatching = true;
+	while (timers.nr_armed && timers.heap[0]->deadline_nsec <= now) {
+		struct lab_timer *timer = timers.heap[0];
+		heap_remove(timer);
+		/* May re-arm or remove any timer, including this one */
+		const char *name = timer->name;
+		int64_t begin = latency_trace_begin();
+		timer->func(timer->data);
+		latency_trace_end(name, begin);
+	}
+	timers.dispatching = false;
+	rearm();
+	return 0;
+}
+
+struct lab_timer *
+timers_add_named(struct wl_event_loop *loop, wl_event_loop_timer_func_t func,
+		void *data, const char *name)
+{
+	assert(!timers.loop || timers.loop == loop);
+	if (!timers.source) {
+		timers.loop = loop;
+		timers.source = wl_event_loop_add_timer(loop, handle_timeout,
+			NULL);
+	}
+
+	struct lab_timer *timer = znew(*timer);
+	timer->index = -1;
+	timer->func = func;
+	timer->data = data;
+	timer->name = name;
+	timers.nr_timers++;
+	return timer;
+}
+
+void
+timers_update(struct lab_timer *timer, int ms_delay)
+{
+	bool was_first = timer->index == 0;
+	if (timer->index >= 0) {
+		heap_remove(timer);
+	}
+	if (ms_delay > 0) {
+		timer->deadline_nsec = time_now_nsec()
+			+ (int64_t)ms_delay * NSEC_PER_MSEC;
+		heap_insert(timer);
+	}
+	if (was_first || timer->index == 0) {
+		rearm();
+	}
+}
+
+void
+timers_remove(struct lab_timer *timer)
+{
+	timers_update(timer, 0);
+	free(timer);
+
+	/* Give the timerfd back once the last timer is gone */
+	if (!--timers.nr_timers) {
+		wl_event_source_remove(timers.source);
+		timers.source = NULL;
+		timers.loop = NULL;
+		zfree(timers.heap);
+		timers.alloc = 0;
+	}
+}
@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "common/buf.h"
+#include "common/unix-socket.h"
+
+void
+unix_socket_path(struct buf *path, const char *name)
+{
+	if (name && *name != '/') {
+		const char *dir = getenv("XDG_RUNTIME_DIR");
+		buf_add_fmt(path, "%s/", dir ? dir : "/tmp");
+	}
+	buf_add(path, name ? name : "");
+}
+
+int
+unix_socket_listen(const char *path, int backlog)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		wlr_log(WLR_ERROR, "socket path too long: %s", path);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	/* Remove a stale socket left behind by a crashed instance, only */
+	struct stat st;
+	if (lstat(path, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {
+			wlr_log(WLR_ERROR, "%s exists and is not a socket", path);
+			return -1;
+		}
+		unlink(path);
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		wlr_log_errno(WLR_ERROR, "socket");
+		return -1;
+	}
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+			|| chmod(path, 0600) < 0 || listen(fd, backlog) < 0) {
+		wlr_log_errno(WLR_ERROR, "cannot listen on %s", path);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
@@ -0,0 +1,334 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <wayland-util.h>
+#include <wlr/util/log.h>
+#include "common/buf.h"
+#include "common/parse-bool.h"
+#include "config/config-cache.h"
+
+#define CONFIG_CACHE_MAGIC "labwc-rc"
+/* Bump whenever the encoding or the meaning of events changes */
+#define CONFIG_CACHE_VERSION (1)
+
+struct config_cache_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t nr_events;
+	uint64_t key;
+	uint64_t len; /* of the event data following the header */
+};
+
+/*
+ * Each event is a type byte followed by zero, one or two strings. Each
+ * string is stored as a 32-bit length, the bytes and a terminating NUL
+ * so that it can be passed on directly from the mapping.
+ */
+enum event_type {
+	EVENT_START_ELEMENT = 1,
+	EVENT_ATTRIBUTE,
+	EVENT_CHARACTERS,
+	EVENT_END_ELEMENT,
+};
+
+static struct {
+	bool active;
+	uint32_t nr_events;
+	struct wl_array data;
+} recording;
+
+bool
+config_cache_enabled(void)
+{
+	const char *env = getenv("LABWC_CONFIG_CACHE");
+	return env && parse_bool(env, false) == 1;
+}
+
+/* FNV-1a */
+static uint64_t
+hash_bytes(uint64_t hash, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+	for (size_t i = 0; i < len; i++) {
+		hash ^= p[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+uint64_t
+config_cache_key(uint64_t key, const char *path, const char *data, size_t len)
+{
+	/* Include the terminator so that paths and contents can not shift */
+	key = hash_bytes(key, path, strlen(path) + 1);
+	key = hash_bytes(key, &len, sizeof(len));
+	return hash_bytes(key, data, len);
+}
+
+static void
+cache_path(struct buf *path, bool create_dirs)
+{
+	const char *cache_home = getenv("XDG_CACHE_HOME");
+	if (cache_home && *cache_home) {
+		buf_add(path, cache_home);
+	} else {
+		const char *home = getenv("HOME");
+		if (!home) {
+			return;
+		}
+		buf_add_fmt(path, "%s/.cache", home);
+	}
+	if (create_dirs) {
+		mkdir(path->data, 0700);
+	}
+	buf_add(path, "/labwc");
+	if (create_dirs) {
+		mkdir(path->data, 0700);
+	}
+	buf_add(path, "/rc.cache");
+}
+
+static bool
+read_string(const char **p, const char *end, const char **str, uint32_t *len)
+{
+	if (end - *p < (ptrdiff_t)sizeof(*len)) {
+		return false;
+	}
+	memcpy(len, *p, sizeof(*len));
+	*p += sizeof(*len);
+	if ((size_t)(end - *p) < (size_t)*len + 1 || (*p)[*len] != '\0') {
+		return false;
+	}
+	*str = *p;
+	*p += *len + 1;
+	return true;
+}
+
+/*
+ * Walks all events, calling @handler if not NULL. Returns false on any
+ * malformed event, so that a first pass without handler can validate the
+ * whole file before anything is applied.
+ */
+static bool
+process_events(const char *data, size_t len, uint32_t nr_events,
+		const struct config_cache_handler *handler)
+{
+	const char *p = data;
+	const char *end = data + len;
+	for (uint32_t i = 0; i < nr_events; i++) {
+		if (p == end) {
+			return false;
+		}
+		enum event_type type = *p++;
+		const char *a, *b;
+		uint32_t a_len, b_len;
+		switch (type) {
+		case EVENT_START_ELEMENT:
+			if (!read_string(&p, end, &a, &a_len)) {
+				return false;
+			}
+			if (handler) {
+				handler->start_element(a);
+			}
+			break;
+		case EVENT_ATTRIBUTE:
+			if (!read_string(&p, end, &a, &a_len)
+					|| !read_string(&p, end, &b, &b_len)) {
+				return false;
+			}
+			if (handler) {
+				handler->attribute(a, b, b_len);
+			}
+			break;
+		case EVENT_CHARACTERS:
+			if (!read_string(&p, end, &a, &a_len)) {
+				return false;
+			}
+			if (handler) {
+				handler->characters(a, a_len);
+			}
+			break;
+		case EVENT_END_ELEMENT:
+			if (handler) {
+				handler->end_element();
+			}
+			break;
+		default:
+			return false;
+		}
+	}
+	return p == end;
+}
+
+bool
+config_cache_replay(uint64_t key, const struct config_cache_handler *handler)
+{
+	struct buf path = BUF_INIT;
+	cache_path(&path, false);
+	if (!path.len) {
+		buf_reset(&path);
+		return false;
+	}
+	int fd = open(path.data, O_RDONLY | O_CLOEXEC);
+	buf_reset(&path);
+	if (fd < 0) {
+		return false;
+	}
+
+	bool replayed = false;
+	struct stat st;
+	struct config_cache_header header;
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(header)) {
+		goto out;
+	}
+	char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		goto out;
+	}
+	memcpy(&header, map, sizeof(header));
+	const char *data = map + sizeof(header);
+	if (memcmp(header.magic, CONFIG_CACHE_MAGIC, sizeof(header.magic))
+			|| header.version != CONFIG_CACHE_VERSION
+			|| header.key != key
+			|| header.len != st.st_size - sizeof(header)
+			|| !process_events(data, header.len,
+				header.nr_events, NULL)) {
+		goto out_unmap;
+	}
+
+	wlr_log(WLR_INFO, "replay config from cache");
+	process_events(data, header.len, header.nr_events, handler);
+	replayed = true;
+out_unmap:
+	munmap(map, st.st_size);
+out:
+	close(fd);
+	return replayed;
+}
+
+void
+config_cache_record_begin(void)
+{
+	wl_array_release(&recording.data);
+	wl_array_init(&recording.data);
+	recording.nr_events = 0;
+	recording.active = true;
+}
+
+static void
+record_type(enum event_type type)
+{
+	char *p = wl_array_add(&recording.data, 1);
+	*p = type;
+	recording.nr_events++;
+}
+
+static void
+record_string(const char *str, uint32_t len)
+{
+	char *p = wl_array_add(&recording.data, sizeof(len) + len + 1);
+	memcpy(p, &len, sizeof(len));
+	memcpy(p + sizeof(len), str, len);
+	p[sizeof(len) + len] = '\0';
+}
+
+void
+config_cache_record_start_element(const char *name)
+{
+	if (!recording.active) {
+		return;
+	}
+	record_type(EVENT_START_ELEMENT);
+	record_string(name, strlen(name));
+}
+
+void
+config_cache_record_attribute(const char *name, const char *value, int len)
+{
+	if (!recording.active) {
+		return;
+	}
+	record_type(EVENT_ATTRIBUTE);
+	record_string(name, strlen(name));
+	record_string(value, len);
+}
+
+void
+config_cache_record_characters(const char *text, int len)
+{
+	if (!recording.active) {
+		return;
+	}
+	record_type(EVENT_CHARACTERS);
+	record_string(text, len);
+}
+
+void
+config_cache_record_end_element(void)
+{
+	if (!recording.active) {
+		return;
+	}
+	record_type(EVENT_END_ELEMENT);
+}
+
+static void
+write_cache(uint64_t key)
+{
+	struct buf path = BUF_INIT;
+	cache_path(&path, true);
+	if (!path.len) {
+		buf_reset(&path);
+		return;
+	}
+	struct buf tmp_path = BUF_INIT;
+	buf_add_fmt(&tmp_path, "%s.%d", path.data, getpid());
+
+	struct config_cache_header header = {
+		.version = CONFIG_CACHE_VERSION,
+		.nr_events = recording.nr_events,
+		.key = key,
+		.len = recording.data.size,
+	};
+	memcpy(header.magic, CONFIG_CACHE_MAGIC, sizeof(header.magic));
+
+	FILE *stream = fopen(tmp_path.data, "w");
+	if (!stream) {
+		wlr_log(WLR_ERROR, "cannot write config cache %s: %s",
+			tmp_path.data, strerror(errno));
+		goto out;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, stream) == 1;
+	if (recording.data.size) {
+		ok &= fwrite(recording.data.data, recording.data.size,
+			1, stream) == 1;
+	}
+	ok &= !fclose(stream);
+
+	/* Replace atomically so that a concurrent reader never sees junk */
+	if (!ok || rename(tmp_path.data, path.data) < 0) {
+		wlr_log(WLR_ERROR, "cannot write config cache %s", path.data);
+		unlink(tmp_path.data);
+	}
+out:
+	buf_reset(&tmp_path);
+	buf_reset(&path);
+}
+
+void
+config_cache_record_finish(uint64_t key, bool commit)
+{
+	if (recording.active && commit) {
+		write_cache(key);
+	}
+	recording.active = false;
+	wl_array_release(&recording.data);
+	wl_array_init(&recording.data);
+}
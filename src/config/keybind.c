@@ -48,6 +48,158 @@ keybind_the_same(struct keybind *a, struct keybind *b)
 	return true;
 }
 
+/* FNV-1a */
+static uint32_t
+hash_u32(uint32_t hash, uint32_t value)
+{
+	for (int i = 0; i < 4; i++) {
+		hash ^= (value >> (i * 8)) & 0xff;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+uint32_t
+keybind_hash(struct keybind *keybind)
+{
+	uint32_t hash = hash_u32(2166136261u, keybind->modifiers);
+	for (size_t i = 0; i < keybind->keysyms_len; i++) {
+		hash = hash_u32(hash, keybind->keysyms[i]);
+	}
+	return hash;
+}
+
+/*
+ * Keybinds are looked up from an open addressing hash table keyed on
+ * modifiers and either keycode or (lowercase) keysym. Each entry holds the
+ * matching keybinds in config order. The index is built lazily on first
+ * lookup and invalidated whenever keybinds or their keycodes change.
+ */
+enum keybind_key_type {
+	KEYBIND_KEY_KEYCODE = 0,
+	KEYBIND_KEY_KEYSYM,
+};
+
+struct keybind_index_entry {
+	uint64_t key;
+	struct wl_array keybinds; /* struct keybind * */
+};
+
+static struct {
+	struct keybind_index_entry *entries;
+	size_t size; /* power of two */
+	bool valid;
+} keybind_index;
+
+static uint64_t
+index_key(enum keybind_key_type type, uint32_t modifiers, uint32_t value)
+{
+	/* Never zero, which denotes an empty slot */
+	return (uint64_t)(type + 1) << 62 | (uint64_t)modifiers << 32 | value;
+}
+
+static struct keybind_index_entry *
+index_find_slot(uint64_t key)
+{
+	/* Fibonacci hashing, the table is never full */
+	size_t i = (key * 11400714819323198485llu) >> 32;
+	for (;; i++) {
+		struct keybind_index_entry *entry =
+			&keybind_index.entries[i & (keybind_index.size - 1)];
+		if (!entry->key || entry->key == key) {
+			return entry;
+		}
+	}
+}
+
+static void
+index_add(uint64_t key, struct keybind *keybind)
+{
+	struct keybind_index_entry *entry = index_find_slot(key);
+	if (!entry->key) {
+		entry->key = key;
+		wl_array_init(&entry->keybinds);
+	}
+	struct keybind **last = NULL;
+	if (entry->keybinds.size) {
+		last = (struct keybind **)((char *)entry->keybinds.data
+			+ entry->keybinds.size - sizeof(*last));
+	}
+	if (last && *last == keybind) {
+		/* Same keybind with duplicated keycode or keysym */
+		return;
+	}
+	struct keybind **slot = wl_array_add(&entry->keybinds, sizeof(*slot));
+	*slot = keybind;
+}
+
+void
+keybind_index_finish(void)
+{
+	for (size_t i = 0; i < keybind_index.size; i++) {
+		if (keybind_index.entries[i].key) {
+			wl_array_release(&keybind_index.entries[i].keybinds);
+		}
+	}
+	zfree(keybind_index.entries);
+	keybind_index.size = 0;
+	keybind_index.valid = false;
+}
+
+static void
+index_build(void)
+{
+	keybind_index_finish();
+
+	size_t nr_keys = 0;
+	struct keybind *keybind;
+	wl_list_for_each(keybind, &rc.keybinds, link) {
+		nr_keys += keybind->keycodes_len + keybind->keysyms_len;
+	}
+	/* Keep the load factor below 0.5 */
+	keybind_index.size = 16;
+	while (keybind_index.size < 2 * nr_keys) {
+		keybind_index.size *= 2;
+	}
+	keybind_index.entries = znew_n(*keybind_index.entries,
+		keybind_index.size);
+
+	wl_list_for_each(keybind, &rc.keybinds, link) {
+		for (size_t i = 0; i < keybind->keycodes_len; i++) {
+			index_add(index_key(KEYBIND_KEY_KEYCODE,
+				keybind->modifiers, keybind->keycodes[i]), keybind);
+		}
+		for (size_t i = 0; i < keybind->keysyms_len; i++) {
+			index_add(index_key(KEYBIND_KEY_KEYSYM,
+				keybind->modifiers, keybind->keysyms[i]), keybind);
+		}
+	}
+	keybind_index.valid = true;
+}
+
+static struct wl_array *
+index_lookup(uint64_t key)
+{
+	if (!keybind_index.valid) {
+		index_build();
+	}
+	struct keybind_index_entry *entry = index_find_slot(key);
+	return entry->key ? &entry->keybinds : NULL;
+}
+
+struct wl_array *
+keybind_lookup_keycode(uint32_t modifiers, xkb_keycode_t keycode)
+{
+	return index_lookup(index_key(KEYBIND_KEY_KEYCODE, modifiers, keycode));
+}
+
+struct wl_array *
+keybind_lookup_keysym(uint32_t modifiers, xkb_keysym_t sym)
+{
+	return index_lookup(index_key(KEYBIND_KEY_KEYSYM, modifiers,
+		xkb_keysym_to_lower(sym)));
+}
+
 static void
 update_keycodes_iter(struct xkb_keymap *keymap, xkb_keycode_t key, void *data)
 {
@@ -108,6 +260,7 @@ keybind_update_keycodes(struct server *server)
 		keybind->keycodes_len = 0;
 		keybind->keycodes_layout = -1;
 	}
+	keybind_index.valid = false;
 	xkb_layout_index_t layouts = xkb_keymap_num_layouts(keymap);
 	for (xkb_layout_index_t i = 0; i < layouts; i++) {
 		wlr_log(WLR_DEBUG, "Found layout %s", xkb_keymap_layout_get_name(keymap, i));
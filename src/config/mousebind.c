@@ -6,10 +6,141 @@
 #include <unistd.h>
 #include <wlr/util/log.h>
 #include "common/list.h"
+#include "common/macros.h"
 #include "common/mem.h"
 #include "config/mousebind.h"
 #include "config/rcxml.h"
 
+struct mousebind_bucket {
+	uint32_t button;
+	uint32_t modifiers;
+	struct wl_array entries; /* struct mousebind_entry */
+};
+
+static_assert(LAB_SSD_END_MARKER <= 32, "contexts do not fit into mask");
+
+/*
+ * Mousebinds by (button, modifiers) and scroll mousebinds by direction,
+ * built on first use. Only few buttons are ever bound, so the buckets
+ * are simply searched linearly.
+ */
+static struct {
+	struct wl_array buttons; /* struct mousebind_bucket */
+	struct wl_array scroll[LAB_DIRECTION_COUNT]; /* struct mousebind_entry */
+	bool valid;
+} mousebind_index;
+
+void
+mousebind_index_finish(void)
+{
+	struct mousebind_bucket *bucket;
+	wl_array_for_each(bucket, &mousebind_index.buttons) {
+		wl_array_release(&bucket->entries);
+	}
+	wl_array_release(&mousebind_index.buttons);
+	wl_array_init(&mousebind_index.buttons);
+	for (size_t i = 0; i < LAB_DIRECTION_COUNT; i++) {
+		wl_array_release(&mousebind_index.scroll[i]);
+		wl_array_init(&mousebind_index.scroll[i]);
+	}
+	mousebind_index.valid = false;
+}
+
+static struct mousebind_bucket *
+find_bucket(uint32_t button, uint32_t modifiers)
+{
+	struct mousebind_bucket *bucket;
+	wl_array_for_each(bucket, &mousebind_index.buttons) {
+		if (bucket->button == button && bucket->modifiers == modifiers) {
+			return bucket;
+		}
+	}
+	return NULL;
+}
+
+static void
+add_entry(struct wl_array *entries, struct mousebind *mousebind)
+{
+	struct mousebind_entry *entry = wl_array_add(entries, sizeof(*entry));
+	entry->mousebind = mousebind;
+	entry->contexts = 0;
+	/* Resolve the context hierarchy once rather than per event */
+	for (uint32_t type = 0; type < LAB_SSD_END_MARKER; type++) {
+		if (ssd_part_contains(mousebind->context, type)) {
+			entry->contexts |= 1u << type;
+		}
+	}
+}
+
+static void
+index_build(void)
+{
+	mousebind_index_finish();
+	struct mousebind *mousebind;
+	wl_list_for_each(mousebind, &rc.mousebinds, link) {
+		if (mousebind->mouse_event == MOUSE_ACTION_SCROLL) {
+			if (mousebind->direction < LAB_DIRECTION_COUNT) {
+				add_entry(&mousebind_index.scroll[mousebind->direction],
+					mousebind);
+			}
+			continue;
+		}
+		if (!mousebind->button) {
+			continue;
+		}
+		struct mousebind_bucket *bucket = find_bucket(
+			mousebind->button, mousebind->modifiers);
+		if (!bucket) {
+			bucket = wl_array_add(&mousebind_index.buttons,
+				sizeof(*bucket));
+			bucket->button = mousebind->button;
+			bucket->modifiers = mousebind->modifiers;
+			wl_array_init(&bucket->entries);
+		}
+		add_entry(&bucket->entries, mousebind);
+	}
+	mousebind_index.valid = true;
+}
+
+struct wl_array *
+mousebind_lookup_scroll(enum direction direction)
+{
+	assert(direction < LAB_DIRECTION_COUNT);
+	if (!mousebind_index.valid) {
+		index_build();
+	}
+	struct wl_array *entries = &mousebind_index.scroll[direction];
+	return entries->size ? entries : NULL;
+}
+
+struct wl_array *
+mousebind_lookup_button(uint32_t button, uint32_t modifiers)
+{
+	if (!mousebind_index.valid) {
+		index_build();
+	}
+	struct mousebind_bucket *bucket = find_bucket(button, modifiers);
+	return bucket ? &bucket->entries : NULL;
+}
+
+void
+mousebind_clear_pressed(uint32_t button)
+{
+	if (!mousebind_index.valid) {
+		index_build();
+	}
+	struct mousebind_bucket *bucket;
+	wl_array_for_each(bucket, &mousebind_index.buttons) {
+		if (bucket->button != button) {
+			continue;
+		}
+		struct mousebind_entry *entry;
+		wl_array_for_each(entry, &bucket->entries) {
+			entry->mousebind->pressed_in_context = false;
+		}
+	}
+}
+
 uint32_t
 mousebind_button_from_str(const char *str, uint32_t *modifiers)
 {
@@ -76,6 +207,10 @@ mousebind_direction_from_str(const char *str, uint32_t *modifiers)
 		return LAB_DIRECTION_UP;
 	} else if (!strcasecmp(str, "Down")) {
 		return LAB_DIRECTION_DOWN;
+	} else if (!strcasecmp(str, "In")) {
+		return LAB_DIRECTION_IN;
+	} else if (!strcasecmp(str, "Out")) {
+		return LAB_DIRECTION_OUT;
 	}
 invalid:
 	wlr_log(WLR_ERROR, "unknown direction (%s)", str);
@@ -98,6 +233,10 @@ mousebind_event_from_str(const char *str)
 		return MOUSE_ACTION_DRAG;
 	} else if (!strcasecmp(str, "scroll")) {
 		return MOUSE_ACTION_SCROLL;
+	} else if (!strcasecmp(str, "swipe")) {
+		return MOUSE_ACTION_SWIPE;
+	} else if (!strcasecmp(str, "pinch")) {
+		return MOUSE_ACTION_PINCH;
 	}
 	wlr_log(WLR_ERROR, "unknown mouse action (%s)", str);
 	return MOUSE_ACTION_NONE;
@@ -154,10 +293,31 @@ mousebind_the_same(struct mousebind *a, struct mousebind *b)
 	return a->context == b->context
 		&& a->button == b->button
 		&& a->direction == b->direction
+		&& a->fingers == b->fingers
 		&& a->mouse_event == b->mouse_event
 		&& a->modifiers == b->modifiers;
 }
 
+uint32_t
+mousebind_hash(struct mousebind *mousebind)
+{
+	/* FNV-1a over the fields compared by mousebind_the_same() */
+	uint32_t values[] = {
+		mousebind->context,
+		mousebind->button,
+		mousebind->direction,
+		mousebind->fingers,
+		mousebind->mouse_event,
+		mousebind->modifiers,
+	};
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < ARRAY_SIZE(values); i++) {
+		hash ^= values[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
 struct mousebind *
 mousebind_create(const char *context)
 {
@@ -167,6 +327,7 @@ mousebind_create(const char *context)
 	}
 	struct mousebind *m = znew(*m);
 	m->context = context_from_str(context);
+	m->fingers = 3;
 	if (m->context != LAB_SSD_NONE) {
 		wl_list_append(&rc.mousebinds, &m->link);
 	}
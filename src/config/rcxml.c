@@ -1,11 +1,13 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <ctype.h>
 #include <fcntl.h>
 #include <glib.h>
 #include <libxml/parser.h>
 #include <libxml/tree.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -15,19 +17,24 @@
 #include <wlr/util/box.h>
 #include <wlr/util/log.h>
 #include "action.h"
+#include "common/buf.h"
 #include "common/dir.h"
+#include "common/grab-file.h"
+#include "common/hash.h"
+#include "common/intern.h"
 #include "common/list.h"
 #include "common/macros.h"
 #include "common/mem.h"
-#include "common/nodename.h"
 #include "common/parse-bool.h"
 #include "common/parse-double.h"
 #include "common/string-helpers.h"
+#include "config/config-cache.h"
 #include "config/default-bindings.h"
 #include "config/keybind.h"
 #include "config/libinput.h"
 #include "config/mousebind.h"
 #include "config/tablet.h"
+#include "config/touch.h"
 #include "config/rcxml.h"
 #include "labwc.h"
 #include "osd.h"
@@ -38,6 +45,7 @@
 
 static bool in_regions;
 static bool in_usable_area_override;
+static bool in_output_config;
 static bool in_keybind;
 static bool in_mousebind;
 static bool in_touch;
@@ -50,11 +58,12 @@ static bool in_action_else_branch;
 static bool in_action_none_branch;
 
 static struct usable_area_override *current_usable_area_override;
+static struct output_config *current_output_config;
 static struct keybind *current_keybind;
 static struct mousebind *current_mousebind;
 static struct touch_config_entry *current_touch;
 static struct libinput_category *current_libinput_category;
-static const char *current_mouse_context;
+static char *current_mouse_context;
 static struct action *current_keybind_action;
 static struct action *current_mousebind_action;
 static struct region *current_region;
@@ -107,6 +116,60 @@ fill_usable_area_override(char *nodename, char *content)
 	}
 }
 
+static void
+fill_output_config(char *nodename, char *content)
+{
+	if (!strcasecmp(nodename, "output.outputs")) {
+		current_output_config = znew(*current_output_config);
+		wl_list_append(&rc.output_configs, &current_output_config->link);
+		return;
+	}
+	string_truncate_at_pattern(nodename, ".output.outputs");
+	if (!content) {
+		/* nop */
+	} else if (!current_output_config) {
+		wlr_log(WLR_ERROR, "expect <output> element first. "
+			"nodename: '%s' content: '%s'", nodename, content);
+	} else if (!strcmp(nodename, "name")) {
+		free(current_output_config->name);
+		current_output_config->name = xstrdup(content);
+	} else if (!strcasecmp(nodename, "maxRenderTime")) {
+		if (!strcasecmp(content, "auto")) {
+			current_output_config->max_render_time =
+				LAB_MAX_RENDER_TIME_AUTO;
+		} else if (!strcasecmp(content, "off")) {
+			current_output_config->max_render_time = 0;
+		} else {
+			current_output_config->max_render_time =
+				MAX(0, atoi(content));
+		}
+	} else if (!strcasecmp(nodename, "mode")) {
+		/* WIDTHxHEIGHT or WIDTHxHEIGHT@REFRESH with refresh in Hz */
+		int width = 0, height = 0;
+		double refresh = 0;
+		int n = sscanf(content, "%dx%d@%lf", &width, &height, &refresh);
+		if (n < 2 || width <= 0 || height <= 0 || refresh < 0) {
+			wlr_log(WLR_ERROR, "invalid output mode '%s'", content);
+		} else {
+			current_output_config->width = width;
+			current_output_config->height = height;
+			current_output_config->refresh = refresh * 1000;
+		}
+	} else if (!strcasecmp(nodename, "scale")) {
+		float scale = 0;
+		if (set_float(content, &scale) && scale > 0) {
+			current_output_config->scale = scale;
+		} else {
+			wlr_log(WLR_ERROR, "invalid output scale '%s'", content);
+		}
+	} else if (!strcasecmp(nodename, "constantFrameRate")) {
+		set_bool(content, &current_output_config->constant_frame_rate);
+	} else {
+		wlr_log(WLR_ERROR, "Unexpected data in output parser: %s=\"%s\"",
+			nodename, content);
+	}
+}
+
 /* Does a boolean-parse but also allows 'default' */
 static void
 set_property(const char *str, enum property *variable)
@@ -169,6 +232,10 @@ fill_window_rule(char *nodename, char *content)
 		set_property(content, &current_window_rule->ignore_focus_request);
 	} else if (!strcasecmp(nodename, "fixedPosition")) {
 		set_property(content, &current_window_rule->fixed_position);
+	} else if (!strcasecmp(nodename, "adaptiveSync")) {
+		set_property(content, &current_window_rule->adaptive_sync);
+	} else if (!strcasecmp(nodename, "allowTearing")) {
+		set_property(content, &current_window_rule->allow_tearing);
 
 	/* Actions */
 	} else if (!strcmp(nodename, "name.action")) {
@@ -395,6 +462,8 @@ fill_mousebind(char *nodename, char *content)
 	} else if (!strcmp(nodename, "direction")) {
 		current_mousebind->direction = mousebind_direction_from_str(content,
 			&current_mousebind->modifiers);
+	} else if (!strcmp(nodename, "fingers")) {
+		current_mousebind->fingers = MAX(1, atoi(content));
 	} else if (!strcmp(nodename, "action")) {
 		/* <mousebind button="" action="EVENT"> */
 		current_mousebind->mouse_event =
@@ -687,11 +756,25 @@ enum_font_place(const char *place)
 	return FONT_PLACE_UNKNOWN;
 }
 
+static void
+set_tearing_mode(const char *str, enum tearing_mode *variable)
+{
+	if (!strcasecmp(str, "auto")) {
+		*variable = LAB_TEARING_AUTO;
+	} else if (parse_bool(str, -1) == 1) {
+		*variable = LAB_TEARING_ENABLED;
+	} else {
+		*variable = LAB_TEARING_DISABLED;
+	}
+}
+
 static void
 set_adaptive_sync_mode(const char *str, enum adaptive_sync_mode *variable)
 {
 	if (!strcasecmp(str, "fullscreen")) {
 		*variable = LAB_ADAPTIVE_SYNC_FULLSCREEN;
+	} else if (!strcasecmp(str, "auto")) {
+		*variable = LAB_ADAPTIVE_SYNC_AUTO;
 	} else {
 		int ret = parse_bool(str, -1);
 		if (ret == 1) {
@@ -703,7 +786,7 @@ set_adaptive_sync_mode(const char *str, enum adaptive_sync_mode *variable)
 }
 
 static void
-entry(xmlNode *node, char *nodename, char *content)
+entry(char *nodename, char *content)
 {
 	/* current <theme><font place=""></font></theme> */
 	static enum font_place font_place = FONT_PLACE_NONE;
@@ -723,6 +806,10 @@ entry(xmlNode *node, char *nodename, char *content)
 	if (in_usable_area_override) {
 		fill_usable_area_override(nodename, content);
 	}
+	if (in_output_config) {
+		fill_output_config(nodename, content);
+		return;
+	}
 	if (in_keybind) {
 		if (in_action_query) {
 			fill_action_query(nodename, content,
@@ -739,6 +826,7 @@ entry(xmlNode *node, char *nodename, char *content)
 		} else {
 			fill_keybind(nodename, content);
 		}
+		return;
 	}
 	if (in_mousebind) {
 		if (in_action_query) {
@@ -756,6 +844,7 @@ entry(xmlNode *node, char *nodename, char *content)
 		} else {
 			fill_mousebind(nodename, content);
 		}
+		return;
 	}
 	if (in_touch) {
 		fill_touch(nodename, content);
@@ -816,16 +905,48 @@ entry(xmlNode *node, char *nodename, char *content)
 	} else if (!strcasecmp(nodename, "adaptiveSync.core")) {
 		set_adaptive_sync_mode(content, &rc.adaptive_sync);
 	} else if (!strcasecmp(nodename, "allowTearing.core")) {
-		set_bool(content, &rc.allow_tearing);
+		set_tearing_mode(content, &rc.allow_tearing);
 		if (rc.allow_tearing) {
 			char *no_atomic_env = getenv("WLR_DRM_NO_ATOMIC");
 			if (!no_atomic_env || strcmp(no_atomic_env, "1") != 0) {
-				rc.allow_tearing = false;
+				rc.allow_tearing = LAB_TEARING_DISABLED;
 				wlr_log(WLR_ERROR, "tearing requires WLR_DRM_NO_ATOMIC=1");
 			}
 		}
 	} else if (!strcasecmp(nodename, "reuseOutputMode.core")) {
 		set_bool(content, &rc.reuse_output_mode);
+	} else if (!strcasecmp(nodename, "spawnHelper.core")) {
+		set_bool(content, &rc.spawn_helper);
+	} else if (!strcasecmp(nodename, "realtime.core")) {
+		set_bool(content, &rc.realtime);
+	} else if (!strcasecmp(nodename, "batchOutputFrames.core")) {
+		set_bool(content, &rc.batch_output_frames);
+	} else if (!strcasecmp(nodename, "xwaylandStart.core")) {
+		if (!strcasecmp(content, "lazy")) {
+			rc.xwayland_start = LAB_XWAYLAND_START_LAZY;
+		} else if (!strcasecmp(content, "startup")) {
+			rc.xwayland_start = LAB_XWAYLAND_START_STARTUP;
+		} else if (!strcasecmp(content, "delayed")) {
+			rc.xwayland_start = LAB_XWAYLAND_START_DELAYED;
+		} else {
+			wlr_log(WLR_ERROR, "invalid xwaylandStart %s", content);
+		}
+	} else if (!strcasecmp(nodename, "xwaylandStartDelay.core")) {
+		rc.xwayland_start_delay = MAX(atoi(content), 0);
+	} else if (!strcasecmp(nodename, "titleUpdateInterval.core")) {
+		rc.title_update_interval = MAX(atoi(content), 0);
+	} else if (!strcasecmp(nodename, "throttledFrameRate.core")) {
+		rc.throttled_frame_rate = MIN(MAX(atoi(content), 0), 1000);
+	} else if (!strcasecmp(nodename, "metricsSocket.core")) {
+		zfree(rc.metrics_socket);
+		if (*content) {
+			rc.metrics_socket = xstrdup(content);
+		}
+	} else if (!strcasecmp(nodename, "windowStateSocket.core")) {
+		zfree(rc.window_state_socket);
+		if (*content) {
+			rc.window_state_socket = xstrdup(content);
+		}
 	} else if (!strcmp(nodename, "policy.placement")) {
 		if (!strcmp(content, "automatic")) {
 			rc.placement_policy = LAB_PLACE_AUTOMATIC;
@@ -834,6 +955,19 @@ entry(xmlNode *node, char *nodename, char *content)
 		} else {
 			rc.placement_policy = LAB_PLACE_CENTER;
 		}
+	} else if (!strcasecmp(nodename, "rememberGeometry.placement")) {
+		set_bool(content, &rc.placement_remember_geometry);
+	} else if (!strcasecmp(nodename, "restoreSession.placement")) {
+		set_bool(content, &rc.placement_restore_session);
+	} else if (!strcasecmp(nodename, "layout.tiling")) {
+		enum tiling_layout layout = tiling_layout_parse(content);
+		if (layout == TILING_LAYOUT_INVALID) {
+			wlr_log(WLR_ERROR, "invalid tiling layout %s", content);
+		} else {
+			rc.tiling_layout = layout;
+		}
+	} else if (!strcasecmp(nodename, "masterRatio.tiling")) {
+		rc.tiling_master_ratio = MIN(MAX(atoi(content), 10), 90);
 	} else if (!strcmp(nodename, "name.theme")) {
 		rc.theme_name = xstrdup(content);
 	} else if (!strcmp(nodename, "cornerradius.theme")) {
@@ -864,7 +998,9 @@ entry(xmlNode *node, char *nodename, char *content)
 	} else if (!strcasecmp(nodename, "scrollFactor.mouse")) {
 		set_double(content, &rc.scroll_factor);
 	} else if (!strcasecmp(nodename, "name.context.mouse")) {
-		current_mouse_context = content;
+		/* content does not outlive the current SAX callback */
+		free(current_mouse_context);
+		current_mouse_context = xstrdup(content);
 		current_mousebind = NULL;
 
 	} else if (!strcasecmp(nodename, "repeatRate.keyboard")) {
@@ -906,13 +1042,22 @@ entry(xmlNode *node, char *nodename, char *content)
 			wlr_log(WLR_ERROR, "ignoring invalid value for notifyClient");
 		}
 
-	/* <windowSwitcher show="" preview="" outlines="" /> */
+	/* <windowSwitcher show="" preview="" outlines="" thumbnails="" /> */
 	} else if (!strcasecmp(nodename, "show.windowSwitcher")) {
 		set_bool(content, &rc.window_switcher.show);
 	} else if (!strcasecmp(nodename, "preview.windowSwitcher")) {
-		set_bool(content, &rc.window_switcher.preview);
+		rc.window_switcher.preview_snapshot =
+			!strcasecmp(content, "snapshot");
+		if (rc.window_switcher.preview_snapshot) {
+			rc.window_switcher.preview = true;
+	rc.window_switcher.preview_snapshot = false;
+		} else {
+			set_bool(content, &rc.window_switcher.preview);
+		}
 	} else if (!strcasecmp(nodename, "outlines.windowSwitcher")) {
 		set_bool(content, &rc.window_switcher.outlines);
+	} else if (!strcasecmp(nodename, "thumbnails.windowSwitcher")) {
+		set_bool(content, &rc.window_switcher.thumbnails);
 	} else if (!strcasecmp(nodename, "allWorkspaces.windowSwitcher")) {
 		if (parse_bool(content, -1) == true) {
 			rc.window_switcher.criteria &=
@@ -951,6 +1096,8 @@ entry(xmlNode *node, char *nodename, char *content)
 		wl_list_append(&rc.workspace_config.workspaces, &workspace->link);
 	} else if (!strcasecmp(nodename, "popupTime.desktops")) {
 		rc.workspace_config.popuptime = atoi(content);
+	} else if (!strcasecmp(nodename, "transitionTime.desktops")) {
+		rc.workspace_config.transition_time = MAX(0, atoi(content));
 	} else if (!strcasecmp(nodename, "number.desktops")) {
 		rc.workspace_config.min_nr_workspaces = MAX(1, atoi(content));
 	} else if (!strcasecmp(nodename, "prefix.desktops")) {
@@ -991,130 +1138,376 @@ entry(xmlNode *node, char *nodename, char *content)
 	}
 }
 
+/* Elements which set a parsing state for their children */
+static const struct {
+	const char *name;
+	bool *state;
+} state_nodes[] = {
+	{ "margin", &in_usable_area_override },
+	{ "outputs", &in_output_config },
+	{ "keybind", &in_keybind },
+	{ "mousebind", &in_mousebind },
+	{ "touch", &in_touch },
+	{ "device", &in_libinput_category },
+	{ "regions", &in_regions },
+	{ "fields", &in_window_switcher_field },
+	{ "windowRules", &in_window_rules },
+	{ "query", &in_action_query },
+	{ "then", &in_action_then_branch },
+	{ "else", &in_action_else_branch },
+	{ "none", &in_action_none_branch },
+};
+
+static bool *
+node_state(const char *name)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(state_nodes); i++) {
+		/* Cheap first character check before the full comparison */
+		if (tolower((unsigned char)*name) == *state_nodes[i].name
+				&& !strcasecmp(name, state_nodes[i].name)) {
+			return state_nodes[i].state;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * rc.xml is parsed with the SAX2 interface rather than into a DOM, so
+ * that large configs do not need to be held in memory as a tree. The
+ * callbacks produce the same sequence of entry() calls as walking the
+ * tree did: each element with NULL content, then its attributes, then
+ * its non-blank text and children in document order.
+ *
+ * Element names are kept on a stack in a fixed buffer. Nodenames are
+ * built from that stack in the format of nodename(), i.e. lowercased
+ * and innermost first, for example "name.font.theme.labwc_config".
+ */
+#define SAX_NAMES_LEN (256)
+#define SAX_MAX_DEPTH (64)
+
+static struct {
+	char names[SAX_NAMES_LEN]; /* NUL separated, outermost first */
+	int names_len;
+	int offsets[SAX_MAX_DEPTH];
+	bool *states[SAX_MAX_DEPTH];
+	int depth;
+	/* Nesting level within an ignored subtree, e.g. <comment> */
+	int skip_depth;
+	struct buf text;
+} sax;
+
+/*
+ * Build nodename for the innermost @depth elements of the stack, prefixed
+ * by @prefix (an attribute name) if not NULL.
+ */
+static char *
+sax_nodename(char *buf, int len, int depth, const char *prefix)
+{
+	char *p = buf;
+	char *end = buf + len - 1;
+	if (prefix) {
+		for (; *prefix && p < end; prefix++) {
+			*p++ = tolower((unsigned char)*prefix);
+		}
+		if (p < end && depth) {
+			*p++ = '.';
+		}
+	}
+	for (int i = depth - 1; i >= 0; i--) {
+		for (const char *s = sax.names + sax.offsets[i]; *s && p < end; s++) {
+			*p++ = *s;
+		}
+		if (i && p < end) {
+			*p++ = '.';
+		}
+	}
+	*p = '\0';
+	return buf;
+}
+
+static bool
+is_blank(const char *s, int len)
+{
+	for (int i = 0; i < len; i++) {
+		if (!isspace((unsigned char)s[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void
+sax_flush_text(void)
+{
+	if (!sax.text.len) {
+		return;
+	}
+	if (!is_blank(sax.text.data, sax.text.len)) {
+		char buf[SAX_NAMES_LEN];
+		entry(sax_nodename(buf, sizeof(buf), sax.depth, NULL),
+			sax.text.data);
+	}
+	buf_clear(&sax.text);
+}
+
+static bool
+sax_push(const char *name)
+{
+	int len = strlen(name);
+	if (sax.depth == SAX_MAX_DEPTH
+			|| sax.names_len + len + 1 > SAX_NAMES_LEN) {
+		return false;
+	}
+	sax.offsets[sax.depth] = sax.names_len;
+	sax.states[sax.depth] = NULL;
+	for (int i = 0; i < len; i++) {
+		sax.names[sax.names_len++] = tolower((unsigned char)name[i]);
+	}
+	sax.names[sax.names_len++] = '\0';
+	sax.depth++;
+	return true;
+}
+
 static void
-process_node(xmlNode *node)
+sax_skip_subtree(void)
 {
-	char *content;
-	static char buffer[256];
-	char *name;
+	/* Only count the depth until the matching end element */
+	sax.skip_depth = 1;
+}
 
-	content = (char *)node->content;
-	if (xmlIsBlankNode(node)) {
+static void
+sax_start_element(const char *name)
+{
+	if (sax.skip_depth) {
+		sax.skip_depth++;
+		return;
+	}
+	sax_flush_text();
+	if (!strcasecmp(name, "comment")) {
+		sax_skip_subtree();
 		return;
 	}
-	name = nodename(node, buffer, sizeof(buffer));
-	entry(node, name, content);
+	if (!sax_push(name)) {
+		wlr_log(WLR_ERROR, "config nested too deeply, ignoring <%s>", name);
+		sax_skip_subtree();
+		return;
+	}
+
+	bool *state = node_state(name);
+	if (state) {
+		*state = true;
+		sax.states[sax.depth - 1] = state;
+	}
+
+	/* Ignore superfluous 'text.' in node name */
+	int depth = sax.depth;
+	if (depth > 1 && !strcmp(name, "text")) {
+		depth--;
+	}
+	char buf[SAX_NAMES_LEN];
+	entry(sax_nodename(buf, sizeof(buf), depth, NULL), NULL);
 }
 
-static void xml_tree_walk(xmlNode *node);
+static void
+sax_attribute(const char *name, const char *value, int len)
+{
+	if (sax.skip_depth || is_blank(value, len)) {
+		return;
+	}
+	char buf[SAX_NAMES_LEN];
+	buf_add_len(&sax.text, value, len);
+	entry(sax_nodename(buf, sizeof(buf), sax.depth, name), sax.text.data);
+	buf_clear(&sax.text);
+}
 
 static void
-traverse(xmlNode *n)
+sax_characters(const char *text, int len)
 {
-	xmlAttr *attr;
+	if (!sax.skip_depth && sax.depth) {
+		buf_add_len(&sax.text, text, len);
+	}
+}
 
-	process_node(n);
-	for (attr = n->properties; attr; attr = attr->next) {
-		xml_tree_walk(attr->children);
+static void
+sax_end_element(void)
+{
+	if (sax.skip_depth) {
+		sax.skip_depth--;
+		return;
 	}
-	xml_tree_walk(n->children);
+	sax_flush_text();
+	sax.depth--;
+	if (sax.states[sax.depth]) {
+		*sax.states[sax.depth] = false;
+	}
+	sax.names_len = sax.offsets[sax.depth];
 }
 
 static void
-xml_tree_walk(xmlNode *node)
+sax_reset(void)
 {
-	for (xmlNode *n = node; n && n->name; n = n->next) {
-		if (!strcasecmp((char *)n->name, "comment")) {
-			continue;
-		}
-		if (!strcasecmp((char *)n->name, "margin")) {
-			in_usable_area_override = true;
-			traverse(n);
-			in_usable_area_override = false;
-			continue;
-		}
-		if (!strcasecmp((char *)n->name, "keybind")) {
-			in_keybind = true;
-			traverse(n);
-			in_keybind = false;
-			continue;
-		}
-		if (!strcasecmp((char *)n->name, "mousebind")) {
-			in_mousebind = true;
-			traverse(n);
-			in_mousebind = false;
-			continue;
-		}
-		if (!strcasecmp((char *)n->name, "touch")) {
-			in_touch = true;
-			traverse(n);
-			in_touch = false;
-			continue;
-		}
-		if (!strcasecmp((char *)n->name, "device")) {
-			in_libinput_category = true;
-			traverse(n);
-			in_libinput_category = false;
-			continue;
-		}
-		if (!strcasecmp((char *)n->name, "regions")) {
-			in_regions = true;
-			traverse(n);
-			in_regions = false;
-			continue;
-		}
-		if (!strcasecmp((char *)n->name, "fields")) {
-			in_window_switcher_field = true;
-			traverse(n);
-			in_window_switcher_field = false;
-			continue;
-		}
-		if (!strcasecmp((char *)n->name, "windowRules")) {
-			in_window_rules = true;
-			traverse(n);
-			in_window_rules = false;
-			continue;
-		}
-		if (!strcasecmp((char *)n->name, "query")) {
-			in_action_query = true;
-			traverse(n);
-			in_action_query = false;
-			continue;
-		}
-		if (!strcasecmp((char *)n->name, "then")) {
-			in_action_then_branch = true;
-			traverse(n);
-			in_action_then_branch = false;
-			continue;
-		}
-		if (!strcasecmp((char *)n->name, "else")) {
-			in_action_else_branch = true;
-			traverse(n);
-			in_action_else_branch = false;
-			continue;
-		}
-		if (!strcasecmp((char *)n->name, "none")) {
-			in_action_none_branch = true;
-			traverse(n);
-			in_action_none_branch = false;
-			continue;
-		}
-		traverse(n);
+	sax.names_len = 0;
+	sax.depth = 0;
+	sax.skip_depth = 0;
+	buf_reset(&sax.text);
+}
+
+static void
+handle_start_element(void *ctx, const xmlChar *localname,
+		const xmlChar *prefix, const xmlChar *uri, int nr_namespaces,
+		const xmlChar **namespaces, int nr_attributes, int nr_defaulted,
+		const xmlChar **attributes)
+{
+	const char *name = (const char *)localname;
+	config_cache_record_start_element(name);
+	sax_start_element(name);
+
+	/* Each attribute is localname/prefix/URI/value/end */
+	for (int i = 0; i < nr_attributes; i++) {
+		const char *attr = (const char *)attributes[i * 5];
+		const char *value = (const char *)attributes[i * 5 + 3];
+		int len = (const char *)attributes[i * 5 + 4] - value;
+		config_cache_record_attribute(attr, value, len);
+		sax_attribute(attr, value, len);
 	}
 }
 
-/* Exposed in header file to allow unit tests to parse buffers */
-void
-rcxml_parse_xml(struct buf *b)
+static void
+handle_end_element(void *ctx, const xmlChar *localname,
+		const xmlChar *prefix, const xmlChar *uri)
 {
-	xmlDoc *d = xmlParseMemory(b->data, b->len);
-	if (!d) {
+	config_cache_record_end_element();
+	sax_end_element();
+}
+
+static void
+handle_characters(void *ctx, const xmlChar *ch, int len)
+{
+	config_cache_record_characters((const char *)ch, len);
+	sax_characters((const char *)ch, len);
+}
+
+static bool
+parse_xml_data(const char *data, int len)
+{
+	xmlSAXHandler handler = {
+		.initialized = XML_SAX2_MAGIC,
+		.startElementNs = handle_start_element,
+		.endElementNs = handle_end_element,
+		.characters = handle_characters,
+		.warning = xmlParserWarning,
+		.error = xmlParserError,
+	};
+
+	sax_reset();
+
+	/*
+	 * Unlike with a DOM, entries before a syntax error have already
+	 * been applied at this point.
+	 */
+	bool ok = !xmlSAXUserParseMemory(&handler, NULL, data, len);
+	if (!ok) {
 		wlr_log(WLR_ERROR, "error parsing config file");
-		return;
 	}
-	xml_tree_walk(xmlDocGetRootElement(d));
-	xmlFreeDoc(d);
+	sax_reset();
 	xmlCleanupParser();
+	return ok;
+}
+
+static const struct config_cache_handler config_cache_handler = {
+	.start_element = sax_start_element,
+	.attribute = sax_attribute,
+	.characters = sax_characters,
+	.end_element = sax_end_element,
+};
+
+static uint64_t
+hash_font(uint64_t hash, struct font *font)
+{
+	hash = hash_str(hash, font->name);
+	hash = hash_value(hash, font->size);
+	hash = hash_value(hash, font->slant);
+	return hash_value(hash, font->weight);
+}
+
+static uint64_t
+hash_input_section(uint64_t hash)
+{
+	hash = hash_value(hash, rc.repeat_rate);
+	hash = hash_value(hash, rc.repeat_delay);
+
+	/* Read by the keymap and cursor theme loading, see seat_reconfigure() */
+	static const char *const env_names[] = {
+		"XKB_DEFAULT_RULES",
+		"XKB_DEFAULT_MODEL",
+		"XKB_DEFAULT_LAYOUT",
+		"XKB_DEFAULT_VARIANT",
+		"XKB_DEFAULT_OPTIONS",
+		"XCURSOR_THEME",
+		"XCURSOR_SIZE",
+	};
+	for (size_t i = 0; i < ARRAY_SIZE(env_names); i++) {
+		hash = hash_str(hash, getenv(env_names[i]));
+	}
+
+	struct touch_config_entry *touch;
+	wl_list_for_each(touch, &rc.touch_configs, link) {
+		hash = hash_str(hash, touch->device_name);
+		hash = hash_str(hash, touch->output_name);
+	}
+
+	hash = hash_str(hash, rc.tablet.output_name);
+	hash = hash_value(hash, rc.tablet.box);
+	hash = hash_value(hash, rc.tablet.rotation);
+	hash = hash_data(hash, rc.tablet.button_map,
+		rc.tablet.button_map_count * sizeof(rc.tablet.button_map[0]));
+
+	/* Categories are zero-allocated, so padding is hashed as well */
+	struct libinput_category *category;
+	wl_list_for_each(category, &rc.libinput_categories, link) {
+		size_t offset = offsetof(struct libinput_category, pointer_speed);
+		hash = hash_value(hash, category->type);
+		hash = hash_str(hash, category->name);
+		hash = hash_data(hash, (char *)category + offset,
+			sizeof(*category) - offset);
+	}
+	return hash;
+}
+
+uint64_t
+rcxml_section_hash(enum rcxml_section section, uint64_t hash)
+{
+	switch (section) {
+	case RCXML_SECTION_INPUT:
+		return hash_input_section(hash);
+	case RCXML_SECTION_MENU: {
+		hash = hash_font(hash, &rc.font_menuitem);
+		hash = hash_value(hash, rc.merge_config);
+		int nr_workspaces = wl_list_length(&rc.workspace_config.workspaces);
+		return hash_value(hash, nr_workspaces);
+	}
+	case RCXML_SECTION_REGIONS: {
+		hash = hash_font(hash, &rc.font_osd);
+		struct region *region;
+		wl_list_for_each(region, &rc.regions, link) {
+			hash = hash_str(hash, region->name);
+			hash = hash_value(hash, region->percentage);
+		}
+		return hash;
+	}
+	case RCXML_SECTION_RESIZE_INDICATOR:
+		hash = hash_font(hash, &rc.font_osd);
+		return hash_value(hash, rc.resize_indicator);
+	default:
+		return hash;
+	}
+}
+
+/* Exposed in header file to allow unit tests to parse buffers */
+void
+rcxml_parse_xml(struct buf *b)
+{
+	parse_xml_data(b->data, b->len);
 }
 
 static void
@@ -1132,6 +1525,7 @@ rcxml_init(void)
 
 	if (!has_run) {
 		wl_list_init(&rc.usable_area_overrides);
+		wl_list_init(&rc.output_configs);
 		wl_list_init(&rc.keybinds);
 		wl_list_init(&rc.mousebinds);
 		wl_list_init(&rc.libinput_categories);
@@ -1146,6 +1540,10 @@ rcxml_init(void)
 	rc.placement_policy = LAB_PLACE_CENTER;
 
 	rc.xdg_shell_server_side_deco = true;
+	rc.xwayland_start_delay = 2000;
+	rc.title_update_interval = 0;
+	rc.throttled_frame_rate = 1;
+	rc.tiling_master_ratio = 55;
 	rc.ssd_keep_border = true;
 	rc.corner_radius = 8;
 
@@ -1182,6 +1580,7 @@ rcxml_init(void)
 
 	rc.window_switcher.show = true;
 	rc.window_switcher.preview = true;
+	rc.window_switcher.preview_snapshot = false;
 	rc.window_switcher.outlines = true;
 	rc.window_switcher.criteria = LAB_VIEW_CRITERIA_CURRENT_WORKSPACE
 		| LAB_VIEW_CRITERIA_ROOT_TOPLEVEL
@@ -1190,6 +1589,7 @@ rcxml_init(void)
 	rc.resize_indicator = LAB_RESIZE_INDICATOR_NEVER;
 
 	rc.workspace_config.popuptime = INT_MIN;
+	rc.workspace_config.transition_time = 0;
 	rc.workspace_config.min_nr_workspaces = 1;
 }
 
@@ -1261,26 +1661,81 @@ load_default_mouse_bindings(void)
 	wlr_log(WLR_DEBUG, "Loaded %u merged mousebinds", count);
 }
 
+/*
+ * Open addressing hash set of bindings used to find duplicates in linear
+ * time. The set never owns the bindings.
+ */
+struct binding_set {
+	void **slots;
+	size_t size; /* power of two */
+};
+
+static void
+binding_set_init(struct binding_set *set, size_t nr_bindings)
+{
+	/* Keep the load factor below 0.5 */
+	set->size = 16;
+	while (set->size < 2 * nr_bindings) {
+		set->size *= 2;
+	}
+	set->slots = znew_n(void *, set->size);
+}
+
+/*
+ * Returns the binding equal to @binding if there is one, otherwise adds
+ * @binding to the set and returns NULL.
+ */
+static void *
+binding_set_insert(struct binding_set *set, void *binding, uint32_t hash,
+		bool (*same)(void *a, void *b))
+{
+	/* Fibonacci hashing, the table is never full */
+	size_t i = (hash * 2654435769u) >> 8;
+	for (;; i++) {
+		void **slot = &set->slots[i & (set->size - 1)];
+		if (!*slot) {
+			*slot = binding;
+			return NULL;
+		}
+		if (same(*slot, binding)) {
+			return *slot;
+		}
+	}
+}
+
+static bool
+mousebind_same(void *a, void *b)
+{
+	return mousebind_the_same(a, b);
+}
+
+static bool
+keybind_same(void *a, void *b)
+{
+	return keybind_the_same(a, b);
+}
+
 static void
 deduplicate_mouse_bindings(void)
 {
 	uint32_t replaced = 0;
 	uint32_t cleared = 0;
-	struct mousebind *current, *tmp, *existing;
-	wl_list_for_each_safe(existing, tmp, &rc.mousebinds, link) {
-		wl_list_for_each_reverse(current, &rc.mousebinds, link) {
-			if (existing == current) {
-				break;
-			}
-			if (mousebind_the_same(existing, current)) {
-				wl_list_remove(&existing->link);
-				action_list_free(&existing->actions);
-				free(existing);
-				replaced++;
-				break;
-			}
+	struct mousebind *current, *tmp;
+
+	/* Walk backwards so that the last of equal mousebinds is kept */
+	struct binding_set set;
+	binding_set_init(&set, wl_list_length(&rc.mousebinds));
+	wl_list_for_each_reverse_safe(current, tmp, &rc.mousebinds, link) {
+		if (binding_set_insert(&set, current, mousebind_hash(current),
+				mousebind_same)) {
+			wl_list_remove(&current->link);
+			action_list_free(&current->actions);
+			free(current);
+			replaced++;
 		}
 	}
+	free(set.slots);
+
 	wl_list_for_each_safe(current, tmp, &rc.mousebinds, link) {
 		if (wl_list_empty(&current->actions)) {
 			wl_list_remove(&current->link);
@@ -1288,6 +1743,26 @@ deduplicate_mouse_bindings(void)
 			cleared++;
 		}
 	}
+
+	/*
+	 * Gestures without a direction of their kind would be taken from
+	 * clients without ever running the actions
+	 */
+	wl_list_for_each_safe(current, tmp, &rc.mousebinds, link) {
+		bool pinch = current->direction == LAB_DIRECTION_IN
+			|| current->direction == LAB_DIRECTION_OUT;
+		bool invalid = current->direction == LAB_DIRECTION_INVALID;
+		if ((current->mouse_event == MOUSE_ACTION_SWIPE
+				&& (invalid || pinch))
+				|| (current->mouse_event == MOUSE_ACTION_PINCH
+				&& !pinch)) {
+			wlr_log(WLR_ERROR, "ignoring swipe or pinch mousebind "
+				"without valid direction");
+			wl_list_remove(&current->link);
+			action_list_free(&current->actions);
+			free(current);
+		}
+	}
 	if (replaced) {
 		wlr_log(WLR_DEBUG, "Replaced %u mousebinds", replaced);
 	}
@@ -1301,21 +1776,22 @@ deduplicate_key_bindings(void)
 {
 	uint32_t replaced = 0;
 	uint32_t cleared = 0;
-	struct keybind *current, *tmp, *existing;
-	wl_list_for_each_safe(existing, tmp, &rc.keybinds, link) {
-		wl_list_for_each_reverse(current, &rc.keybinds, link) {
-			if (existing == current) {
-				break;
-			}
-			if (keybind_the_same(existing, current)) {
-				wl_list_remove(&existing->link);
-				action_list_free(&existing->actions);
-				free(existing);
-				replaced++;
-				break;
-			}
+	struct keybind *current, *tmp;
+
+	/* Walk backwards so that the last of equal keybinds is kept */
+	struct binding_set set;
+	binding_set_init(&set, wl_list_length(&rc.keybinds));
+	wl_list_for_each_reverse_safe(current, tmp, &rc.keybinds, link) {
+		if (binding_set_insert(&set, current, keybind_hash(current),
+				keybind_same)) {
+			wl_list_remove(&current->link);
+			action_list_free(&current->actions);
+			free(current);
+			replaced++;
 		}
 	}
+	free(set.slots);
+
 	wl_list_for_each_safe(current, tmp, &rc.keybinds, link) {
 		if (wl_list_empty(&current->actions)) {
 			wl_list_remove(&current->link);
@@ -1425,6 +1901,8 @@ rule_destroy(struct window_rule *rule)
 	wl_list_remove(&rule->link);
 	zfree(rule->identifier);
 	zfree(rule->title);
+	intern_unref(rule->match_cache.id);
+	intern_unref(rule->match_cache.title);
 	action_list_free(&rule->actions);
 	zfree(rule);
 }
@@ -1544,34 +2022,44 @@ rcxml_read(const char *filename)
 	 * If merging, we iterate backwards (least important XDG Base Dir first)
 	 * and keep going.
 	 */
+	struct file_view *views = znew_n(struct file_view, wl_list_length(&paths));
+	int nr_views = 0;
+	uint64_t cache_key = CONFIG_CACHE_KEY_INIT;
 	for (struct wl_list *elm = iter(&paths); elm != &paths; elm = iter(elm)) {
 		struct path *path = wl_container_of(elm, path, link);
-		FILE *stream = fopen(path->string, "r");
-		if (!stream) {
+		struct file_view *view = &views[nr_views];
+		if (!file_view_open(view, path->string)) {
 			continue;
 		}
 
 		wlr_log(WLR_INFO, "read config file %s", path->string);
 
-		struct buf b = BUF_INIT;
-		char *line = NULL;
-		size_t len = 0;
-		while (getline(&line, &len, stream) != -1) {
-			char *p = strrchr(line, '\n');
-			if (p) {
-				*p = '\0';
-			}
-			buf_add(&b, line);
-		}
-		zfree(line);
-		fclose(stream);
-		rcxml_parse_xml(&b);
-		buf_reset(&b);
+		file_view_join_lines(view);
+		cache_key = config_cache_key(cache_key, path->string,
+			view->data, view->len);
+		nr_views++;
 		if (!should_merge_config) {
 			break;
 		}
 	};
 	paths_destroy(&paths);
+
+	bool use_cache = config_cache_enabled();
+	if (!use_cache || !config_cache_replay(cache_key, &config_cache_handler)) {
+		bool ok = true;
+		if (use_cache) {
+			config_cache_record_begin();
+		}
+		for (int i = 0; i < nr_views; i++) {
+			ok &= parse_xml_data(views[i].data, views[i].len);
+		}
+		config_cache_record_finish(cache_key, use_cache && ok);
+	}
+	sax_reset();
+	for (int i = 0; i < nr_views; i++) {
+		file_view_close(&views[i]);
+	}
+	free(views);
 	post_processing();
 	validate();
 }
@@ -1584,6 +2072,8 @@ rcxml_finish(void)
 	zfree(rc.font_menuitem.name);
 	zfree(rc.font_osd.name);
 	zfree(rc.theme_name);
+	zfree(rc.metrics_socket);
+	zfree(rc.window_state_socket);
 	zfree(rc.workspace_config.prefix);
 
 	struct usable_area_override *area, *area_tmp;
@@ -1593,6 +2083,15 @@ rcxml_finish(void)
 		zfree(area);
 	}
 
+	struct output_config *output_config, *output_config_tmp;
+	wl_list_for_each_safe(output_config, output_config_tmp,
+			&rc.output_configs, link) {
+		wl_list_remove(&output_config->link);
+		zfree(output_config->name);
+		zfree(output_config);
+	}
+
+	keybind_index_finish();
 	struct keybind *k, *k_tmp;
 	wl_list_for_each_safe(k, k_tmp, &rc.keybinds, link) {
 		wl_list_remove(&k->link);
@@ -1601,6 +2100,7 @@ rcxml_finish(void)
 		zfree(k);
 	}
 
+	mousebind_index_finish();
 	struct mousebind *m, *m_tmp;
 	wl_list_for_each_safe(m, m_tmp, &rc.mousebinds, link) {
 		wl_list_remove(&m->link);
@@ -1647,11 +2147,12 @@ rcxml_finish(void)
 
 	/* Reset state vars for starting fresh when Reload is triggered */
 	current_usable_area_override = NULL;
+	current_output_config = NULL;
 	current_keybind = NULL;
 	current_mousebind = NULL;
 	current_touch = NULL;
 	current_libinput_category = NULL;
-	current_mouse_context = NULL;
+	zfree(current_mouse_context);
 	current_keybind_action = NULL;
 	current_mousebind_action = NULL;
 	current_child_action = NULL;
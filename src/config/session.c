@@ -8,18 +8,22 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 #include <wlr/backend/drm.h>
 #include <wlr/backend/multi.h>
 #include <wlr/util/log.h>
 #include "common/buf.h"
 #include "common/dir.h"
 #include "common/file-helpers.h"
+#include "common/grab-file.h"
 #include "common/mem.h"
 #include "common/parse-bool.h"
 #include "common/spawn.h"
 #include "common/string-helpers.h"
+#include "common/time-helpers.h"
 #include "config/session.h"
 #include "labwc.h"
+#include "profile.h"
 
 static const char *const env_vars[] = {
 	"DISPLAY",
@@ -32,6 +36,22 @@ static const char *const env_vars[] = {
 	NULL
 };
 
+/*
+ * Import of the environment into dbus and systemd at startup. It is started
+ * from an idle callback so that neither the first frame nor the autostart
+ * script wait for spawning it; both commands then run concurrently.
+ */
+static struct {
+	struct wl_event_source *idle;
+	struct wl_event_source *source;
+	pid_t pid;
+	int pipe_fd;
+	int64_t start_nsec;
+} activation = {
+	.pid = -1,
+	.pipe_fd = -1,
+};
+
 static void
 process_line(char *line)
 {
@@ -61,22 +81,16 @@ process_line(char *line)
 static bool
 read_environment_file(const char *filename)
 {
-	char *line = NULL;
-	size_t len = 0;
-	FILE *stream = fopen(filename, "r");
-	if (!stream) {
+	struct file_view view;
+	if (!file_view_open(&view, filename)) {
 		return false;
 	}
 	wlr_log(WLR_INFO, "read environment file %s", filename);
-	while (getline(&line, &len, stream) != -1) {
-		char *p = strrchr(line, '\n');
-		if (p) {
-			*p = '\0';
-		}
+	char *line;
+	while ((line = file_view_next_line(&view))) {
 		process_line(line);
 	}
-	free(line);
-	fclose(stream);
+	file_view_close(&view);
 	return true;
 }
 
@@ -185,6 +199,61 @@ should_update_activation(struct server *server)
 	return have_drm;
 }
 
+static void
+activation_import_finish(void)
+{
+	if (activation.idle) {
+		wl_event_source_remove(activation.idle);
+		activation.idle = NULL;
+	}
+	if (activation.source) {
+		wl_event_source_remove(activation.source);
+		activation.source = NULL;
+	}
+	if (activation.pipe_fd >= 0) {
+		spawn_piped_close(activation.pid, activation.pipe_fd);
+		activation.pipe_fd = -1;
+		activation.pid = -1;
+	}
+}
+
+/* Both commands have exited once the shared stdout pipe hits EOF */
+static int
+handle_activation_import_done(int fd, uint32_t mask, void *data)
+{
+	char buf[256];
+	if (mask & WL_EVENT_READABLE && read(fd, buf, sizeof(buf)) > 0) {
+		/* Discard any output */
+		return 0;
+	}
+	wlr_log(WLR_INFO, "dbus and systemd environment updated after %.1f ms",
+		(double)(time_now_nsec() - activation.start_nsec)
+			/ NSEC_PER_MSEC);
+	profile_startup_mark("activation_env", NULL);
+	activation_import_finish();
+	return 0;
+}
+
+static void
+activation_import_start(struct server *server, const char *dbus_cmd,
+		const char *systemd_cmd)
+{
+	char *cmd = strdup_printf("%s & %s; wait", dbus_cmd, systemd_cmd);
+	activation.start_nsec = time_now_nsec();
+	activation.pid = spawn_piped(cmd, &activation.pipe_fd);
+	free(cmd);
+	if (activation.pid < 0) {
+		activation.pipe_fd = -1;
+		return;
+	}
+	activation.source = wl_event_loop_add_fd(server->wl_event_loop,
+		activation.pipe_fd, WL_EVENT_READABLE,
+		handle_activation_import_done, NULL);
+	if (!activation.source) {
+		activation_import_finish();
+	}
+}
+
 static void
 update_activation_env(struct server *server, bool initialize)
 {
@@ -204,16 +273,19 @@ update_activation_env(struct server *server, bool initialize)
 	char *env_keys = str_join(env_vars, "%s", " ");
 	char *env_unset_keys = initialize ? NULL : str_join(env_vars, "%s=", " ");
 
-	char *cmd =
+	char *dbus_cmd =
 		strdup_printf("dbus-update-activation-environment %s",
 			initialize ? env_keys : env_unset_keys);
-	spawn_async_no_shell(cmd);
-	free(cmd);
-
-	cmd = strdup_printf("systemctl --user %s %s",
+	char *systemd_cmd = strdup_printf("systemctl --user %s %s",
 		initialize ? "import-environment" : "unset-environment", env_keys);
-	spawn_async_no_shell(cmd);
-	free(cmd);
+	if (initialize) {
+		activation_import_start(server, dbus_cmd, systemd_cmd);
+	} else {
+		spawn_async_no_shell(dbus_cmd);
+		spawn_async_no_shell(systemd_cmd);
+	}
+	free(dbus_cmd);
+	free(systemd_cmd);
 
 	free(env_keys);
 	free(env_unset_keys);
@@ -288,11 +360,20 @@ run_session_script(const char *script)
 	paths_destroy(&paths);
 }
 
-void
-session_autostart_init(struct server *server)
+static void
+handle_activation_idle(void *data)
 {
+	struct server *server = data;
+	activation.idle = NULL;
 	/* Update dbus and systemd user environment, each may fail gracefully */
 	update_activation_env(server, /* initialize */ true);
+}
+
+void
+session_autostart_init(struct server *server)
+{
+	activation.idle = wl_event_loop_add_idle(server->wl_event_loop,
+		handle_activation_idle, server);
 	run_session_script("autostart");
 }
 
@@ -300,6 +381,8 @@ void
 session_shutdown(struct server *server)
 {
 	run_session_script("shutdown");
+	spawn_helper_stop();
+	activation_import_finish();
 
 	/* Clear the dbus and systemd user environment, each may fail gracefully */
 	update_activation_env(server, /* initialize */ false);
@@ -1,7 +1,12 @@
 // SPDX-License-Identifier: GPL-2.0-only
+#include <string.h>
 #include <wlr/types/wlr_layer_shell_v1.h>
+#include <wlr/util/log.h>
 #include <wlr/types/wlr_scene.h>
+#include "buffer.h"
 #include "common/graphic-helpers.h"
+#include "common/macros.h"
+#include "common/scaled_scene_buffer.h"
 #include "common/scene-helpers.h"
 #include "debug.h"
 #include "labwc.h"
@@ -67,7 +72,7 @@ get_view_part(struct view *view, struct wlr_scene_node *node)
 		return NULL;
 	}
 	if (node == &view->scene_tree->node) {
-		const char *app_id = view_get_string_prop(view, "app_id");
+		const char *app_id = view_get_app_id(view);
 		if (!app_id) {
 			return "view";
 		}
@@ -103,6 +108,9 @@ get_special(struct server *server, struct wlr_scene_node *node)
 	if (node == &server->view_tree_always_on_top->node) {
 		return "server->always_on_top";
 	}
+	if (node == &server->osd_preview_tree->node) {
+		return "server->osd_preview_tree";
+	}
 	if (node->parent == server->view_tree) {
 		struct workspace *workspace;
 		wl_list_for_each(workspace, &server->workspaces, link) {
@@ -256,3 +264,255 @@ debug_dump_scene(struct server *server)
 	 */
 	last_view = NULL;
 }
+
+/* Deeper nodes are accounted to the last bucket */
+#define SCENE_STATS_MAX_DEPTH 16
+
+static const char *const descriptor_names[] = {
+	[LAB_NODE_DESC_NODE] = "node",
+	[LAB_NODE_DESC_VIEW] = "view",
+	[LAB_NODE_DESC_XDG_POPUP] = "xdg-popup",
+	[LAB_NODE_DESC_LAYER_SURFACE] = "layer-surface",
+	[LAB_NODE_DESC_LAYER_POPUP] = "layer-popup",
+	[LAB_NODE_DESC_IME_POPUP] = "ime-popup",
+	[LAB_NODE_DESC_MENUITEM] = "menuitem",
+	[LAB_NODE_DESC_TREE] = "tree",
+	[LAB_NODE_DESC_SSD_BUTTON] = "ssd-button",
+};
+
+static const char *const node_type_names[] = {
+	[WLR_SCENE_NODE_TREE] = "tree",
+	[WLR_SCENE_NODE_RECT] = "rect",
+	[WLR_SCENE_NODE_BUFFER] = "buffer",
+};
+
+static struct {
+	size_t nr_nodes[ARRAY_SIZE(node_type_names)];
+	size_t nr_descriptors[ARRAY_SIZE(descriptor_names)];
+	size_t nr_no_descriptor;
+	size_t nr_enabled;
+	size_t nr_disabled;
+	size_t depth[SCENE_STATS_MAX_DEPTH];
+	size_t menu_bytes;
+	size_t osd_bytes;
+} scene_stats;
+
+/* Assumes 32-bit pixels as the actual format of client buffers is opaque */
+static size_t
+node_buffer_bytes(struct wlr_scene_node *node)
+{
+	if (node->type != WLR_SCENE_NODE_BUFFER) {
+		return 0;
+	}
+	struct wlr_buffer *buffer = wlr_scene_buffer_from_node(node)->buffer;
+	if (!buffer) {
+		return 0;
+	}
+	return (size_t)buffer->width * buffer->height * 4;
+}
+
+static bool
+node_get_size(struct wlr_scene_node *node, int *width, int *height)
+{
+	switch (node->type) {
+	case WLR_SCENE_NODE_RECT: {
+		struct wlr_scene_rect *rect = wlr_scene_rect_from_node(node);
+		*width = rect->width;
+		*height = rect->height;
+		return true;
+	}
+	case WLR_SCENE_NODE_BUFFER: {
+		struct wlr_scene_buffer *scene_buffer =
+			wlr_scene_buffer_from_node(node);
+		if (scene_buffer->dst_width > 0 && scene_buffer->dst_height > 0) {
+			*width = scene_buffer->dst_width;
+			*height = scene_buffer->dst_height;
+			return true;
+		}
+		if (!scene_buffer->buffer) {
+			return false;
+		}
+		*width = scene_buffer->buffer->width;
+		*height = scene_buffer->buffer->height;
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+static bool
+is_osd_tree(struct server *server, struct wlr_scene_node *node)
+{
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (node == &output->osd_tree->node) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Returns the buffer bytes of the subtree, printing those of each view */
+static size_t
+count_nodes(struct server *server, struct wlr_scene_node *node, int depth)
+{
+	scene_stats.nr_nodes[node->type]++;
+	struct node_descriptor *desc = node->data;
+	if (desc && desc->type < ARRAY_SIZE(descriptor_names)) {
+		scene_stats.nr_descriptors[desc->type]++;
+	} else {
+		scene_stats.nr_no_descriptor++;
+	}
+	if (node->enabled) {
+		scene_stats.nr_enabled++;
+	} else {
+		scene_stats.nr_disabled++;
+	}
+	scene_stats.depth[MIN(depth, SCENE_STATS_MAX_DEPTH - 1)]++;
+
+	size_t bytes = node_buffer_bytes(node);
+	if (node->type == WLR_SCENE_NODE_TREE) {
+		struct wlr_scene_node *child;
+		struct wlr_scene_tree *tree = wlr_scene_tree_from_node(node);
+		wl_list_for_each(child, &tree->children, link) {
+			bytes += count_nodes(server, child, depth + 1);
+		}
+	}
+
+	if (node == &server->menu_tree->node) {
+		scene_stats.menu_bytes = bytes;
+	} else if (node->parent == &server->scene->tree
+			&& is_osd_tree(server, node)) {
+		scene_stats.osd_bytes += bytes;
+	}
+
+	if (desc && desc->type == LAB_NODE_DESC_VIEW) {
+		struct view *view = desc->data;
+		const char *app_id = view_get_app_id(view);
+		printf("scene_buffer_bytes{subtree=\"view\",app_id=\"%s\","
+			"view=\"%p\"} %zu\n", app_id ? app_id : "",
+			(void *)view, bytes);
+	}
+	return bytes;
+}
+
+/* Counts the enabled rects and buffers intersecting @output_box */
+static size_t
+count_visible_nodes(struct wlr_scene_node *node, int x, int y,
+		struct wlr_box *output_box)
+{
+	if (!node->enabled) {
+		return 0;
+	}
+	x += node->x;
+	y += node->y;
+	if (node->type == WLR_SCENE_NODE_TREE) {
+		size_t count = 0;
+		struct wlr_scene_node *child;
+		struct wlr_scene_tree *tree = wlr_scene_tree_from_node(node);
+		wl_list_for_each(child, &tree->children, link) {
+			count += count_visible_nodes(child, x, y, output_box);
+		}
+		return count;
+	}
+	struct wlr_box box = { .x = x, .y = y };
+	if (!node_get_size(node, &box.width, &box.height)) {
+		return 0;
+	}
+	struct wlr_box intersection;
+	return wlr_box_intersection(&intersection, &box, output_box);
+}
+
+void
+debug_dump_scene_stats(struct server *server)
+{
+	memset(&scene_stats, 0, sizeof(scene_stats));
+	printf("Scene statistics\n");
+	size_t total_bytes = count_nodes(server, &server->scene->tree.node, 0);
+
+	for (size_t i = 0; i < ARRAY_SIZE(node_type_names); i++) {
+		printf("scene_nodes{type=\"%s\"} %zu\n", node_type_names[i],
+			scene_stats.nr_nodes[i]);
+	}
+	for (size_t i = 0; i < ARRAY_SIZE(descriptor_names); i++) {
+		printf("scene_nodes{descriptor=\"%s\"} %zu\n",
+			descriptor_names[i], scene_stats.nr_descriptors[i]);
+	}
+	printf("scene_nodes{descriptor=\"none\"} %zu\n",
+		scene_stats.nr_no_descriptor);
+	printf("scene_nodes{state=\"enabled\"} %zu\n", scene_stats.nr_enabled);
+	printf("scene_nodes{state=\"disabled\"} %zu\n",
+		scene_stats.nr_disabled);
+	for (int i = 0; i < SCENE_STATS_MAX_DEPTH; i++) {
+		if (scene_stats.depth[i]) {
+			printf("scene_nodes{depth=\"%d%s\"} %zu\n", i,
+				i == SCENE_STATS_MAX_DEPTH - 1 ? "+" : "",
+				scene_stats.depth[i]);
+		}
+	}
+
+	printf("scene_buffer_bytes{subtree=\"menu\"} %zu\n",
+		scene_stats.menu_bytes);
+	printf("scene_buffer_bytes{subtree=\"osd\"} %zu\n",
+		scene_stats.osd_bytes);
+	printf("scene_buffer_bytes{subtree=\"total\"} %zu\n", total_bytes);
+
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		struct wlr_box output_box;
+		wlr_output_layout_get_box(server->output_layout,
+			output->wlr_output, &output_box);
+		if (wlr_box_empty(&output_box)) {
+			continue;
+		}
+		printf("scene_visible_nodes{output=\"%s\"} %zu\n",
+			output->wlr_output->name,
+			count_visible_nodes(&server->scene->tree.node, 0, 0,
+				&output_box));
+	}
+	printf("\n");
+}
+
+void
+debug_dump_frame_stats(struct server *server)
+{
+	printf("Frame statistics\n");
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		frame_stats_print(&output->frame_stats, output->wlr_output->name);
+	}
+	input_latency_print(&server->seat.input_latency,
+		server->seat.seat->name);
+	printf("\n");
+}
+
+void
+debug_dump_buffers(void)
+{
+	buffer_print_stats();
+	scaled_scene_buffer_print_stats();
+	printf("\n");
+}
+
+void
+debug_toggle_damage(struct server *server)
+{
+	struct wlr_scene *scene = server->scene;
+	bool enable =
+		scene->debug_damage_option != WLR_SCENE_DEBUG_DAMAGE_HIGHLIGHT;
+	scene->debug_damage_option = enable
+		? WLR_SCENE_DEBUG_DAMAGE_HIGHLIGHT : WLR_SCENE_DEBUG_DAMAGE_NONE;
+	wlr_log(WLR_INFO, "damage highlighting %sabled",
+		enable ? "en" : "dis");
+
+	/* Start from, or get rid of, a fully tinted frame */
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (output->scene_output) {
+			wlr_damage_ring_add_whole(
+				&output->scene_output->damage_ring);
+			wlr_output_schedule_frame(output->wlr_output);
+		}
+	}
+}
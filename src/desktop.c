@@ -1,14 +1,17 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include "config.h"
 #include <assert.h>
+#include <sys/types.h>
+#include "common/array.h"
 #include "common/scene-helpers.h"
 #include "common/surface-helpers.h"
-#include "dnd.h"
 #include "labwc.h"
 #include "layers.h"
 #include "node.h"
 #include "osd.h"
+#include "profile.h"
 #include "ssd.h"
+#include "tiling.h"
 #include "view.h"
 #include "window-rules.h"
 #include "workspaces.h"
@@ -31,12 +34,17 @@ desktop_arrange_all_views(struct server *server)
 	 * still unmapped. We do want to adjust the geometry of those
 	 * views.
 	 */
+	int64_t profile_start = profile_begin();
+	xdg_configure_batch_begin(server);
 	struct view *view;
 	wl_list_for_each(view, &server->views, link) {
 		if (!wlr_box_empty(&view->pending)) {
 			view_adjust_for_layout_change(view);
 		}
 	}
+	tiling_update_all(server);
+	xdg_configure_batch_end(server);
+	profile_end(PROFILE_DESKTOP_ARRANGE_ALL_VIEWS, profile_start);
 }
 
 void
@@ -108,6 +116,25 @@ desktop_focus_view_or_surface(struct seat *seat, struct view *view,
 	}
 }
 
+/* Index of @view in the window switcher candidates or -1 */
+static ssize_t
+cycle_views_index(struct server *server, struct wl_array *views,
+		struct view *view)
+{
+	struct view **array = views->data;
+	size_t len = wl_array_len(views);
+	size_t hint = server->osd_state.cycle_index;
+	if (hint < len && array[hint] == view) {
+		return hint;
+	}
+	for (size_t i = 0; i < len; i++) {
+		if (array[i] == view) {
+			return i;
+		}
+	}
+	return -1;
+}
+
 struct view *
 desktop_cycle_view(struct server *server, struct view *start_view,
 		enum lab_cycle_dir dir)
@@ -115,12 +142,13 @@ desktop_cycle_view(struct server *server, struct view *start_view,
 	/* Make sure to have all nodes in their actual ordering */
 	osd_preview_restore(server);
 
-	struct view *(*iter)(struct wl_list *head, struct view *view,
-		enum lab_view_criteria criteria);
 	bool forwards = dir == LAB_CYCLE_DIR_FORWARD;
-	iter = forwards ? view_next_no_head_stop : view_prev_no_head_stop;
-
-	enum lab_view_criteria criteria = rc.window_switcher.criteria;
+	struct wl_array *views = osd_cycle_views(server);
+	struct view **array = views->data;
+	ssize_t len = wl_array_len(views);
+	if (!len) {
+		return start_view;
+	}
 
 	/*
 	 * Views are listed in stacking order, topmost first.  Usually the
@@ -132,11 +160,28 @@ desktop_cycle_view(struct server *server, struct view *start_view,
 	 *   View #3
 	 *   ...
 	 */
-	if (!start_view && forwards) {
-		start_view = iter(&server->views, NULL, criteria);
+	ssize_t index;
+	if (!start_view) {
+		index = forwards ? 0 : len;
+	} else {
+		index = cycle_views_index(server, views, start_view);
 	}
 
-	return iter(&server->views, start_view, criteria);
+	if (index < 0) {
+		/*
+		 * The start view is not a candidate (anymore), so continue
+		 * from its position in the stacking order instead.
+		 */
+		struct view *(*iter)(struct wl_list *head, struct view *view,
+			enum lab_view_criteria criteria);
+		iter = forwards ? view_next_no_head_stop : view_prev_no_head_stop;
+		return iter(&server->views, start_view,
+			rc.window_switcher.criteria);
+	}
+
+	index = (index + (forwards ? 1 : len - 1)) % len;
+	server->osd_state.cycle_index = index;
+	return array[index];
 }
 
 struct view *
@@ -221,6 +266,11 @@ desktop_update_top_layer_visiblity(struct server *server)
 	struct output *output;
 	uint32_t top = ZWLR_LAYER_SHELL_V1_LAYER_TOP;
 
+	/* All layers are hidden while locked, see session-lock.c */
+	if (server->session_lock) {
+		return;
+	}
+
 	/* Enable all top layers */
 	wl_list_for_each(output, &server->outputs, link) {
 		if (!output_is_usable(output)) {
@@ -258,24 +308,20 @@ get_surface_from_layer_node(struct wlr_scene_node *node)
 }
 
 /* TODO: make this less big and scary */
-struct cursor_context
-get_cursor_context(struct server *server)
+static struct cursor_context
+get_cursor_context_uncached(struct server *server)
 {
 	struct cursor_context ret = {.type = LAB_SSD_NONE};
 	struct wlr_cursor *cursor = server->seat.cursor;
 
-	/* Prevent drag icons to be on top of the hitbox detection */
-	if (server->seat.drag.active) {
-		dnd_icons_show(&server->seat, false);
-	}
-
-	struct wlr_scene_node *node =
-		wlr_scene_node_at(&server->scene->tree.node,
-			cursor->x, cursor->y, &ret.sx, &ret.sy);
-
-	if (server->seat.drag.active) {
-		dnd_icons_show(&server->seat, true);
-	}
+	/*
+	 * Prevent drag icons to be on top of the hitbox detection. They
+	 * are skipped rather than hidden temporarily, which would damage
+	 * the outputs on every motion event.
+	 */
+	struct wlr_scene_node *node = lab_wlr_scene_node_at_skip(
+		&server->scene->tree, &server->seat.drag.icons->node,
+		cursor->x, cursor->y, &ret.sx, &ret.sy);
 
 	ret.node = node;
 	if (!node) {
@@ -376,3 +422,72 @@ get_cursor_context(struct server *server)
 	return ret;
 }
 
+void
+cursor_context_invalidate(struct server *server)
+{
+	struct seat *seat = &server->seat;
+	if (!seat->cursor_context_cache.valid) {
+		return;
+	}
+	seat->cursor_context_cache.valid = false;
+	if (seat->cursor_context_cache.ctx.node) {
+		wl_list_remove(&seat->cursor_context_cache.node_destroy.link);
+	}
+}
+
+static void
+handle_cursor_context_node_destroy(struct wl_listener *listener, void *data)
+{
+	struct seat *seat = wl_container_of(listener, seat,
+		cursor_context_cache.node_destroy);
+	cursor_context_invalidate(seat->server);
+}
+
+static void
+handle_cursor_context_idle(void *data)
+{
+	struct server *server = data;
+	server->seat.cursor_context_cache.idle = NULL;
+	cursor_context_invalidate(server);
+}
+
+/*
+ * Hit-testing walks the whole scene graph, so remember the result for the
+ * current cursor position. The cache is dropped when the event loop goes
+ * idle (which covers client commits changing surfaces under the cursor),
+ * when the node found is destroyed and by cursor_context_invalidate().
+ */
+struct cursor_context
+get_cursor_context(struct server *server)
+{
+	struct seat *seat = &server->seat;
+	struct wlr_cursor *cursor = seat->cursor;
+
+	if (seat->cursor_context_cache.valid
+			&& seat->cursor_context_cache.x == cursor->x
+			&& seat->cursor_context_cache.y == cursor->y) {
+		return seat->cursor_context_cache.ctx;
+	}
+	cursor_context_invalidate(server);
+
+	int64_t profile_start = profile_begin();
+	struct cursor_context ctx = get_cursor_context_uncached(server);
+	profile_end(PROFILE_GET_CURSOR_CONTEXT, profile_start);
+
+	seat->cursor_context_cache.ctx = ctx;
+	seat->cursor_context_cache.x = cursor->x;
+	seat->cursor_context_cache.y = cursor->y;
+	seat->cursor_context_cache.valid = true;
+	if (ctx.node) {
+		seat->cursor_context_cache.node_destroy.notify =
+			handle_cursor_context_node_destroy;
+		wl_signal_add(&ctx.node->events.destroy,
+			&seat->cursor_context_cache.node_destroy);
+	}
+	if (!seat->cursor_context_cache.idle) {
+		seat->cursor_context_cache.idle = wl_event_loop_add_idle(
+			server->wl_event_loop, handle_cursor_context_idle, server);
+	}
+	return ctx;
+}
+
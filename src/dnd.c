@@ -97,12 +97,6 @@ dnd_init(struct seat *seat)
 	 */
 }
 
-void
-dnd_icons_show(struct seat *seat, bool show)
-{
-	wlr_scene_node_set_enabled(&seat->drag.icons->node, show);
-}
-
 void
 dnd_icons_move(struct seat *seat, double x, double y)
 {
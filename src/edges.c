@@ -2,16 +2,44 @@
 #include <assert.h>
 #include <limits.h>
 #include <pixman.h>
+#include <stdlib.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_scene.h>
 #include <wlr/util/edges.h>
 #include <wlr/util/box.h>
 #include "common/border.h"
 #include "common/macros.h"
+#include "common/mem.h"
 #include "config/rcxml.h"
 #include "edges.h"
 #include "labwc.h"
+#include "profile.h"
 #include "view.h"
 #include "node.h"
 
+/*
+ * Sorted view edges along each axis, used to limit the search of
+ * edges_find_neighbors() to views with an edge close to the path of the
+ * moving edges. Views which have changed since the index was built are
+ * kept in a short list and always considered.
+ */
+#define EDGES_INDEX_MAX_DIRTY (8)
+
+struct indexed_edge {
+	int offset;
+	struct view *view;
+};
+
+struct edges_index {
+	bool valid;
+	struct wl_array vertical;	/* struct indexed_edge, left and right */
+	struct wl_array horizontal;	/* struct indexed_edge, top and bottom */
+	struct view *dirty[EDGES_INDEX_MAX_DIRTY];
+	int nr_dirty;
+	/* Scratch array for edges_find_neighbors() */
+	struct wl_array candidates;	/* struct view * */
+};
+
 static void
 edges_for_target_geometry(struct border *edges, struct view *view,
 		struct wlr_box target)
@@ -241,17 +269,33 @@ validate_output_edges(struct border *valid_edges,
 			view, target, output, validator, WLR_EDGE_BOTTOM);
 }
 
-/* Test if parts of the current view is covered by the remaining space in the region */
-static void
-subtract_view_from_space(struct view *view, pixman_region32_t *available)
+static pixman_box32_t
+view_space_rect(struct view *view)
 {
 	struct wlr_box view_size = ssd_max_extents(view);
-	pixman_box32_t view_rect = {
+	return (pixman_box32_t){
 		.x1 = view_size.x,
 		.x2 = view_size.x + view_size.width,
 		.y1 = view_size.y,
 		.y2 = view_size.y + view_size.height
 	};
+}
+
+/* Subtract the view geometry from the available region for the next check */
+static void
+subtract_rect_from_space(pixman_box32_t *rect, pixman_region32_t *available)
+{
+	pixman_region32_t view_region;
+	pixman_region32_init_rects(&view_region, rect, 1);
+	pixman_region32_subtract(available, available, &view_region);
+	pixman_region32_fini(&view_region);
+}
+
+/* Test if parts of the current view is covered by the remaining space in the region */
+static void
+subtract_view_from_space(struct view *view, pixman_region32_t *available)
+{
+	pixman_box32_t view_rect = view_space_rect(view);
 
 	pixman_region_overlap_t overlap =
 		pixman_region32_contains_rectangle(available, &view_rect);
@@ -269,8 +313,8 @@ subtract_view_from_space(struct view *view, pixman_region32_t *available)
 		pixman_region32_t intersection;
 		pixman_region32_init(&intersection);
 		pixman_region32_intersect_rect(&intersection, available,
-			view_size.x, view_size.y,
-			view_size.width, view_size.height);
+			view_rect.x1, view_rect.y1,
+			view_rect.x2 - view_rect.x1, view_rect.y2 - view_rect.y1);
 
 		int nrects;
 		const pixman_box32_t *rects =
@@ -295,16 +339,57 @@ subtract_view_from_space(struct view *view, pixman_region32_t *available)
 		break;
 	}
 
-	/* Subtract the view geometry from the available region for the next check */
-	pixman_region32_t view_region;
-	pixman_region32_init_rects(&view_region, &view_rect, 1);
-	pixman_region32_subtract(available, available, &view_region);
-	pixman_region32_fini(&view_region);
+	subtract_rect_from_space(&view_rect, available);
+}
+
+static void
+add_opaque_region(struct wlr_scene_buffer *buffer, int sx, int sy, void *data)
+{
+	pixman_region32_t *opaque = data;
+	struct wlr_scene_surface *scene_surface =
+		wlr_scene_surface_try_from_buffer(buffer);
+	if (!scene_surface || buffer->opacity < 1.0f) {
+		return;
+	}
+	pixman_region32_t region;
+	pixman_region32_init(&region);
+	pixman_region32_copy(&region, &scene_surface->surface->opaque_region);
+	pixman_region32_translate(&region, sx, sy);
+	pixman_region32_union(opaque, opaque, &region);
+	pixman_region32_fini(&region);
+}
+
+/*
+ * Test if the view is completely covered by views rendered on top of it.
+ * Only the opaque regions of its surfaces hide what is below, so that
+ * translucent windows and client side shadows don't occlude anything.
+ * The SSD is not considered opaque either.
+ */
+static void
+occlude_view_from_space(struct view *view, pixman_region32_t *available)
+{
+	pixman_box32_t view_rect = view_space_rect(view);
+	view->occluded = pixman_region32_contains_rectangle(available,
+		&view_rect) == PIXMAN_REGION_OUT;
+
+	/* The buffer positions include the offset of the node itself */
+	struct wlr_scene_node *node = &view->scene_tree->node;
+	int lx, ly;
+	if (!wlr_scene_node_coords(node, &lx, &ly)) {
+		return;
+	}
+	pixman_region32_t opaque;
+	pixman_region32_init(&opaque);
+	wlr_scene_node_for_each_buffer(node, add_opaque_region, &opaque);
+	pixman_region32_translate(&opaque, lx - node->x, ly - node->y);
+	pixman_region32_subtract(available, available, &opaque);
+	pixman_region32_fini(&opaque);
 }
 
 static void
 subtract_node_tree(struct wlr_scene_tree *tree, pixman_region32_t *available,
-		struct view *ignored_view)
+		struct view *ignored_view,
+		void (*update)(struct view *view, pixman_region32_t *available))
 {
 	struct view *view;
 	struct wlr_scene_node *node;
@@ -324,39 +409,26 @@ subtract_node_tree(struct wlr_scene_tree *tree, pixman_region32_t *available,
 		if (node_desc && node_desc->type == LAB_NODE_DESC_VIEW) {
 			view = node_view_from_node(node);
 			if (view != ignored_view) {
-				subtract_view_from_space(view, available);
+				update(view, available);
 			}
 		} else if (node->type == WLR_SCENE_NODE_TREE) {
 			subtract_node_tree(wlr_scene_tree_from_node(node),
-				available, ignored_view);
+				available, ignored_view, update);
 		}
 	}
 }
 
-void
-edges_calculate_visibility(struct server *server, struct view *ignored_view)
+/* Initialize the region with each individual usable output */
+static void
+init_output_space(struct server *server, pixman_region32_t *region)
 {
 	/*
-	 * The region stores the available output layout space
-	 * and subtracts the window geometries in reverse rendering
-	 * order, e.g. a window rendered on top is subtracted first.
-	 *
-	 * This allows to detect if a window is actually visible.
-	 * If there is no overlap of its geometry and the remaining
-	 * region it must be completely covered by other windows.
-	 *
-	 */
-	pixman_region32_t region;
-	pixman_region32_init(&region);
-
-	/*
-	 * Initialize the region with each individual output.
-	 *
 	 * If we were to use NULL for the reference output we
 	 * would get a single combined wlr_box of the whole
 	 * layout which could cover actual invisible areas
 	 * in case the output resolutions differ.
 	 */
+	pixman_region32_init(region);
 	struct output *output;
 	struct wlr_box layout_box;
 	wl_list_for_each(output, &server->outputs, link) {
@@ -365,13 +437,226 @@ edges_calculate_visibility(struct server *server, struct view *ignored_view)
 		}
 		wlr_output_layout_get_box(server->output_layout,
 			output->wlr_output, &layout_box);
-		pixman_region32_union_rect(&region, &region,
+		pixman_region32_union_rect(region, region,
 			layout_box.x, layout_box.y, layout_box.width, layout_box.height);
 	}
+}
+
+void
+edges_calculate_visibility(struct server *server, struct view *ignored_view)
+{
+	/*
+	 * The region stores the available output layout space
+	 * and subtracts the window geometries in reverse rendering
+	 * order, e.g. a window rendered on top is subtracted first.
+	 *
+	 * This allows to detect if a window is actually visible.
+	 * If there is no overlap of its geometry and the remaining
+	 * region it must be completely covered by other windows.
+	 *
+	 */
+	if (server->edges_visibility.valid
+			&& server->edges_visibility.ignored_view == ignored_view) {
+		return;
+	}
+
+	pixman_region32_t region;
+	init_output_space(server, &region);
+	subtract_node_tree(&server->scene->tree, &region, ignored_view,
+		subtract_view_from_space);
+	pixman_region32_fini(&region);
+
+	server->edges_visibility.valid = true;
+	server->edges_visibility.ignored_view = ignored_view;
+}
 
-	subtract_node_tree(&server->scene->tree, &region, ignored_view);
+void
+edges_calculate_occlusion(struct server *server)
+{
+	if (server->edges_visibility.occlusion_valid) {
+		return;
+	}
 
+	pixman_region32_t region;
+	init_output_space(server, &region);
+	subtract_node_tree(&server->scene->tree, &region, NULL,
+		occlude_view_from_space);
 	pixman_region32_fini(&region);
+
+	server->edges_visibility.occlusion_valid = true;
+}
+
+static void
+index_invalidate(struct server *server, struct view *view)
+{
+	struct edges_index *index = server->edges_index;
+	if (!index || !index->valid) {
+		return;
+	}
+	if (!view || index->nr_dirty == EDGES_INDEX_MAX_DIRTY) {
+		index->valid = false;
+		return;
+	}
+	for (int i = 0; i < index->nr_dirty; i++) {
+		if (index->dirty[i] == view) {
+			return;
+		}
+	}
+	index->dirty[index->nr_dirty++] = view;
+}
+
+void
+edges_invalidate(struct server *server, struct view *view)
+{
+	index_invalidate(server, view);
+	server->edges_visibility.occlusion_valid = false;
+
+	if (view && view == server->edges_visibility.ignored_view) {
+		return;
+	}
+	server->edges_visibility.valid = false;
+	if (!view) {
+		/* Do not keep a pointer to a possibly destroyed view */
+		server->edges_visibility.ignored_view = NULL;
+	}
+}
+
+void
+edges_view_commit(struct view *view)
+{
+	if (view->surface->current.committed & WLR_SURFACE_STATE_OPAQUE_REGION) {
+		view->server->edges_visibility.occlusion_valid = false;
+	}
+}
+
+void
+edges_finish(struct server *server)
+{
+	struct edges_index *index = server->edges_index;
+	if (!index) {
+		return;
+	}
+	wl_array_release(&index->vertical);
+	wl_array_release(&index->horizontal);
+	wl_array_release(&index->candidates);
+	zfree(server->edges_index);
+}
+
+/* Edges of a view including its server-side decoration */
+static struct border
+view_region_edges(struct view *view)
+{
+	struct border border = ssd_get_margin(view->ssd);
+	return (struct border){
+		.top = view->current.y - border.top,
+		.left = view->current.x - border.left,
+		.bottom = view->current.y + border.bottom
+			+ view_effective_height(view, /* use_pending */ false),
+		.right = view->current.x + view->current.width + border.right,
+	};
+}
+
+static int
+compare_indexed_edges(const void *a, const void *b)
+{
+	int oa = ((const struct indexed_edge *)a)->offset;
+	int ob = ((const struct indexed_edge *)b)->offset;
+	return (oa > ob) - (oa < ob);
+}
+
+static void
+index_add_edge(struct wl_array *edges, int offset, struct view *view)
+{
+	struct indexed_edge *edge = wl_array_add(edges, sizeof(*edge));
+	if (!edge) {
+		wlr_log(WLR_ERROR, "wl_array_add(): out of memory");
+		return;
+	}
+	edge->offset = offset;
+	edge->view = view;
+}
+
+static void
+index_sort(struct wl_array *edges)
+{
+	qsort(edges->data, edges->size / sizeof(struct indexed_edge),
+		sizeof(struct indexed_edge), compare_indexed_edges);
+}
+
+static struct edges_index *
+get_index(struct server *server)
+{
+	if (!server->edges_index) {
+		server->edges_index = znew(*server->edges_index);
+		wl_array_init(&server->edges_index->vertical);
+		wl_array_init(&server->edges_index->horizontal);
+		wl_array_init(&server->edges_index->candidates);
+	}
+	struct edges_index *index = server->edges_index;
+	if (index->valid) {
+		return index;
+	}
+
+	/*
+	 * All views are indexed regardless of their workspace or state,
+	 * as edges_find_neighbors() checks that for each candidate anyway.
+	 */
+	index->vertical.size = 0;
+	index->horizontal.size = 0;
+	struct view *view;
+	wl_list_for_each(view, &server->views, link) {
+		struct border edges = view_region_edges(view);
+		index_add_edge(&index->vertical, edges.left, view);
+		index_add_edge(&index->vertical, edges.right, view);
+		index_add_edge(&index->horizontal, edges.top, view);
+		index_add_edge(&index->horizontal, edges.bottom, view);
+	}
+	index_sort(&index->vertical);
+	index_sort(&index->horizontal);
+
+	index->nr_dirty = 0;
+	index->valid = true;
+	return index;
+}
+
+/*
+ * Append all views with an indexed edge within slack of the path
+ * from cur to tgt to the candidates.
+ */
+static void
+index_query(struct edges_index *index, struct wl_array *edges,
+		int cur, int tgt, int slack)
+{
+	/* Validators ignore edges which do not move */
+	if (cur == tgt) {
+		return;
+	}
+
+	int lo = clipped_sub(MIN(cur, tgt), slack);
+	int hi = clipped_add(MAX(cur, tgt), slack);
+
+	struct indexed_edge *array = edges->data;
+	size_t l = 0;
+	size_t r = edges->size / sizeof(*array);
+
+	/* Find the first edge with offset >= lo */
+	size_t end = r;
+	while (l < r) {
+		size_t m = (l + r) / 2;
+		if (array[m].offset < lo) {
+			l = m + 1;
+		} else {
+			r = m;
+		}
+	}
+
+	for (size_t i = l; i < end && array[i].offset <= hi; i++) {
+		struct view **candidate = wl_array_add(&index->candidates,
+			sizeof(*candidate));
+		if (candidate) {
+			*candidate = array[i].view;
+		}
+	}
 }
 
 void
@@ -388,17 +673,48 @@ edges_find_neighbors(struct border *nearest_edges, struct view *view,
 		return;
 	}
 
+	int64_t profile_start = profile_begin();
 	struct border view_edges = { 0 };
 	struct border target_edges = { 0 };
 
 	edges_for_target_geometry(&view_edges, view, origin);
 	edges_for_target_geometry(&target_edges, view, target);
 
-	struct view *v;
-	for_each_view(v, &view->server->views, LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
+	/*
+	 * Only consider views with an edge near the path of the moving
+	 * edges, plus those which changed since the index was built.
+	 * A view may be listed more than once, which is harmless since
+	 * validating the same edges again does not change the result.
+	 */
+	struct edges_index *index = get_index(view->server);
+	int slack = abs(rc.window_edge_strength) + rc.gap;
+	index->candidates.size = 0;
+	index_query(index, &index->vertical,
+		view_edges.left, target_edges.left, slack);
+	index_query(index, &index->vertical,
+		view_edges.right, target_edges.right, slack);
+	index_query(index, &index->horizontal,
+		view_edges.top, target_edges.top, slack);
+	index_query(index, &index->horizontal,
+		view_edges.bottom, target_edges.bottom, slack);
+	for (int i = 0; i < index->nr_dirty; i++) {
+		struct view **candidate = wl_array_add(&index->candidates,
+			sizeof(*candidate));
+		if (candidate) {
+			*candidate = index->dirty[i];
+		}
+	}
+
+	struct view **candidate;
+	wl_array_for_each(candidate, &index->candidates) {
+		struct view *v = *candidate;
 		if (v == view || v->minimized || !output_is_usable(v->output)) {
 			continue;
 		}
+		if (!view_matches_criteria(v,
+				LAB_VIEW_CRITERIA_CURRENT_WORKSPACE)) {
+			continue;
+		}
 
 		uint32_t edges_visible = ignore_hidden ? v->edges_visible :
 			WLR_EDGE_TOP | WLR_EDGE_LEFT
@@ -413,23 +729,16 @@ edges_find_neighbors(struct border *nearest_edges, struct view *view,
 		}
 
 		/* Both view and v must share a common output */
-		if (view->output != v->output && !(view->outputs & v->outputs)) {
+		if (view->output != v->output && !bitset_intersects(&view->outputs, &v->outputs)) {
 			continue;
 		}
 
-		struct border border = ssd_get_margin(v->ssd);
-
-		struct border win_edges = {
-			.top = v->current.y - border.top,
-			.left = v->current.x - border.left,
-			.bottom = v->current.y + border.bottom
-				+ view_effective_height(v, /* use_pending */ false),
-			.right = v->current.x + v->current.width + border.right,
-		};
+		struct border win_edges = view_region_edges(v);
 
 		validate_edges(nearest_edges, view_edges,
 			target_edges, win_edges, edges_visible, validator);
 	}
+	profile_end(PROFILE_EDGES_FIND_NEIGHBORS, profile_start);
 }
 
 void
@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <wayland-server-core.h>
+#include <wlr/backend/libinput.h>
+#include <wlr/backend/multi.h>
+#include <wlr/util/log.h>
+#include "common/macros.h"
+#include "event-loop.h"
+#include "labwc.h"
+#include "latency-trace.h"
+
+static struct {
+	/*
+	 * wlroots attaches the libinput backend to the event loop of the
+	 * display it is created for, so the input loop comes with a
+	 * display of its own. It never gets a socket or any clients.
+	 */
+	struct wl_display *input_display;
+	struct wl_event_loop *input_loop;
+	bool running;
+} event_loop;
+
+static void
+get_libinput_backend(struct wlr_backend *backend, void *data)
+{
+	if (wlr_backend_is_libinput(backend)) {
+		struct wlr_backend **libinput = data;
+		*libinput = backend;
+	}
+}
+
+void
+event_loop_init(struct server *server)
+{
+	struct wlr_backend *libinput = NULL;
+	wlr_multi_for_each_backend(server->backend, get_libinput_backend,
+		&libinput);
+	if (!libinput || !server->session) {
+		return;
+	}
+
+	event_loop.input_display = wl_display_create();
+	if (!event_loop.input_display) {
+		wlr_log(WLR_ERROR, "unable to create input display");
+		return;
+	}
+	struct wlr_backend *prioritized = wlr_libinput_backend_create(
+		event_loop.input_display, server->session);
+	if (!prioritized) {
+		wlr_log(WLR_ERROR, "unable to create libinput backend");
+		wl_display_destroy(event_loop.input_display);
+		event_loop.input_display = NULL;
+		return;
+	}
+
+	/* Not started yet, so no devices are lost by replacing it */
+	wlr_multi_backend_remove(server->backend, libinput);
+	wlr_backend_destroy(libinput);
+	wlr_multi_backend_add(server->backend, prioritized);
+	event_loop.input_loop =
+		wl_display_get_event_loop(event_loop.input_display);
+}
+
+void
+event_loop_finish(void)
+{
+	/* The libinput backend went away along with the multi backend */
+	if (event_loop.input_display) {
+		wl_display_destroy(event_loop.input_display);
+		event_loop.input_display = NULL;
+		event_loop.input_loop = NULL;
+	}
+}
+
+static void
+dispatch(struct wl_event_loop *loop, const char *name)
+{
+	int64_t begin = latency_trace_begin();
+	wl_event_loop_dispatch(loop, 0);
+	latency_trace_end(name, begin);
+}
+
+void
+event_loop_run(struct wl_display *display)
+{
+	/*
+	 * Same as wl_display_run() except that the loop waits for events
+	 * with poll() itself. This allows the input loop to be dispatched
+	 * ahead of the main loop and only the actual dispatch to be timed
+	 * when tracing latency.
+	 *
+	 * libwayland still reads and dispatches all pending requests of a
+	 * client in one go, and up to 32 ready sources per dispatch of the
+	 * main loop, so input waits for at most one such batch.
+	 */
+	struct wl_event_loop *loop = wl_display_get_event_loop(display);
+	struct pollfd pfds[] = {
+		{ .fd = wl_event_loop_get_fd(loop), .events = POLLIN },
+		{ .fd = -1, .events = POLLIN },
+	};
+	if (event_loop.input_loop) {
+		pfds[1].fd = wl_event_loop_get_fd(event_loop.input_loop);
+	}
+
+	event_loop.running = true;
+	while (event_loop.running) {
+		wl_display_flush_clients(display);
+		if (event_loop.input_loop) {
+			wl_event_loop_dispatch_idle(event_loop.input_loop);
+		}
+		wl_event_loop_dispatch_idle(loop);
+		if (poll(pfds, ARRAY_SIZE(pfds), -1) < 0 && errno != EINTR) {
+			wlr_log_errno(WLR_ERROR, "poll");
+			break;
+		}
+		if (pfds[1].revents & POLLIN) {
+			dispatch(event_loop.input_loop, "input dispatch");
+		}
+		if (pfds[0].revents & POLLIN) {
+			dispatch(loop, "wl_event_loop_dispatch");
+		}
+	}
+}
+
+void
+event_loop_terminate(struct wl_display *display)
+{
+	event_loop.running = false;
+	wl_display_terminate(display);
+}
@@ -1,5 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include <assert.h>
+#include <string.h>
+#include "common/bitset.h"
 #include "labwc.h"
 #include "view.h"
 #include "workspaces.h"
@@ -45,11 +47,26 @@ handle_request_close(struct wl_listener *listener, void *data)
 	view_close(view);
 }
 
+/* Views with queued changes, flushed from an idle callback */
+static struct {
+	struct wl_list toplevels; /* foreign_toplevel.queue_link */
+	struct wl_event_source *idle;
+} queue;
+
 static void
 handle_destroy(struct wl_listener *listener, void *data)
 {
 	struct view *view = wl_container_of(listener, view, toplevel.destroy);
 	struct foreign_toplevel *toplevel = &view->toplevel;
+	if (toplevel->pending_changes) {
+		wl_list_remove(&toplevel->queue_link);
+		toplevel->pending_changes = 0;
+		if (wl_list_empty(&queue.toplevels) && queue.idle) {
+			wl_event_source_remove(queue.idle);
+			queue.idle = NULL;
+		}
+	}
+	bitset_finish(&toplevel->sent_outputs);
 	wl_list_remove(&toplevel->maximize.link);
 	wl_list_remove(&toplevel->minimize.link);
 	wl_list_remove(&toplevel->fullscreen.link);
@@ -68,7 +85,7 @@ foreign_toplevel_handle_create(struct view *view)
 		view->server->foreign_toplevel_manager);
 	if (!toplevel->handle) {
 		wlr_log(WLR_ERROR, "cannot create foreign toplevel handle for (%s)",
-			view_get_string_prop(view, "title"));
+			view_get_title(view));
 		return;
 	}
 
@@ -94,23 +111,37 @@ foreign_toplevel_handle_create(struct view *view)
 
 	toplevel->destroy.notify = handle_destroy;
 	wl_signal_add(&toplevel->handle->events.destroy, &toplevel->destroy);
+
+	/* The view may already be activated and on outputs */
+	foreign_toplevel_queue_update(view, FOREIGN_TOPLEVEL_TITLE
+		| FOREIGN_TOPLEVEL_APP_ID | FOREIGN_TOPLEVEL_STATE
+		| FOREIGN_TOPLEVEL_ALL_OUTPUTS);
 }
 
 /*
  * Loop over all outputs and notify foreign_toplevel clients about changes.
+ * These are the outputs in @after but not in @before and the other way
+ * round, or all outputs if @all is set.
  * wlr_foreign_toplevel_handle_v1_output_xxx() keeps track of the active
  * outputs internally and merges the events. It also listens to output
  * destroy events so its fine to just relay the current state and let
- * wlr_foreign_toplevel handle the rest.
+ * wlr_foreign_toplevel handle the rest. Unless @all is set, outputs in
+ * both or neither set are skipped, which saves walking the lists of
+ * wlr_foreign_toplevel for each of them.
  */
-void
-foreign_toplevel_update_outputs(struct view *view)
+static void
+update_outputs(struct view *view, const struct bitset *before,
+		const struct bitset *after, bool all)
 {
 	assert(view->toplevel.handle);
 
 	struct output *output;
 	wl_list_for_each(output, &view->server->outputs, link) {
-		if (view_on_output(view, output)) {
+		bool on_output = bitset_test(after, output->index);
+		if (!all && on_output == bitset_test(before, output->index)) {
+			continue;
+		}
+		if (on_output) {
 			wlr_foreign_toplevel_handle_v1_output_enter(
 				view->toplevel.handle, output->wlr_output);
 		} else {
@@ -119,3 +150,110 @@ foreign_toplevel_update_outputs(struct view *view)
 		}
 	}
 }
+
+static bool
+has_state(struct wlr_foreign_toplevel_handle_v1 *handle,
+		enum wlr_foreign_toplevel_handle_v1_state state)
+{
+	return handle->state & state;
+}
+
+static void
+flush_state(struct view *view)
+{
+	struct wlr_foreign_toplevel_handle_v1 *handle = view->toplevel.handle;
+	bool maximized = view->maximized == VIEW_AXIS_BOTH;
+	if (has_state(handle, WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MAXIMIZED)
+			!= maximized) {
+		wlr_foreign_toplevel_handle_v1_set_maximized(handle, maximized);
+	}
+	if (has_state(handle, WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MINIMIZED)
+			!= view->minimized) {
+		wlr_foreign_toplevel_handle_v1_set_minimized(handle,
+			view->minimized);
+	}
+	if (has_state(handle, WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_FULLSCREEN)
+			!= view->fullscreen) {
+		wlr_foreign_toplevel_handle_v1_set_fullscreen(handle,
+			view->fullscreen);
+	}
+	if (has_state(handle, WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_ACTIVATED)
+			!= view->toplevel.activated) {
+		wlr_foreign_toplevel_handle_v1_set_activated(handle,
+			view->toplevel.activated);
+	}
+}
+
+static void
+flush_view(struct view *view, uint32_t changes)
+{
+	struct foreign_toplevel *toplevel = &view->toplevel;
+	struct wlr_foreign_toplevel_handle_v1 *handle = toplevel->handle;
+
+	if (changes & FOREIGN_TOPLEVEL_TITLE) {
+		const char *title = view_get_title(view);
+		if (title && (!handle->title || strcmp(handle->title, title))) {
+			wlr_foreign_toplevel_handle_v1_set_title(handle, title);
+		}
+	}
+	if (changes & FOREIGN_TOPLEVEL_APP_ID) {
+		const char *app_id = view_get_app_id(view);
+		if (app_id && (!handle->app_id
+				|| strcmp(handle->app_id, app_id))) {
+			wlr_foreign_toplevel_handle_v1_set_app_id(handle,
+				app_id);
+		}
+	}
+	if (changes & FOREIGN_TOPLEVEL_STATE) {
+		flush_state(view);
+	}
+	if (changes & (FOREIGN_TOPLEVEL_OUTPUTS
+			| FOREIGN_TOPLEVEL_ALL_OUTPUTS)) {
+		update_outputs(view, &toplevel->sent_outputs, &view->outputs,
+			changes & FOREIGN_TOPLEVEL_ALL_OUTPUTS);
+		bitset_copy(&toplevel->sent_outputs, &view->outputs);
+	}
+}
+
+static void
+handle_flush(void *data)
+{
+	queue.idle = NULL;
+	while (!wl_list_empty(&queue.toplevels)) {
+		struct foreign_toplevel *toplevel = wl_container_of(
+			queue.toplevels.next, toplevel, queue_link);
+		struct view *view = wl_container_of(toplevel, view, toplevel);
+		uint32_t changes = toplevel->pending_changes;
+		wl_list_remove(&toplevel->queue_link);
+		toplevel->pending_changes = 0;
+		flush_view(view, changes);
+	}
+}
+
+void
+foreign_toplevel_queue_update(struct view *view,
+		enum foreign_toplevel_change changes)
+{
+	struct foreign_toplevel *toplevel = &view->toplevel;
+	if (!toplevel->handle) {
+		return;
+	}
+	if (!queue.toplevels.next) {
+		wl_list_init(&queue.toplevels);
+	}
+	if (!toplevel->pending_changes) {
+		wl_list_insert(queue.toplevels.prev, &toplevel->queue_link);
+	}
+	toplevel->pending_changes |= changes;
+	if (!queue.idle) {
+		queue.idle = wl_event_loop_add_idle(
+			view->server->wl_event_loop, handle_flush, NULL);
+	}
+}
+
+void
+foreign_toplevel_set_activated(struct view *view, bool activated)
+{
+	view->toplevel.activated = activated;
+	foreign_toplevel_queue_update(view, FOREIGN_TOPLEVEL_STATE);
+}
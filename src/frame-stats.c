@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <wlr/util/log.h>
+#include "common/macros.h"
+#include "common/time-helpers.h"
+#include "frame-stats.h"
+
+static const char * const phase_names[] = {
+	[FRAME_STATS_BUILD_STATE] = "build-state",
+	[FRAME_STATS_COMMIT] = "commit",
+	[FRAME_STATS_FRAME_DONE] = "frame-done",
+};
+
+const char *
+frame_stats_phase_name(enum frame_stats_phase phase)
+{
+	assert(phase < FRAME_STATS_NR_PHASES);
+	return phase_names[phase];
+}
+
+static const char * const scanout_names[] = {
+	[FRAME_STATS_SCANOUT_DIRECT] = "direct",
+	[FRAME_STATS_SCANOUT_BLOCKED_OSD] = "osd",
+	[FRAME_STATS_SCANOUT_BLOCKED_MENU] = "menu",
+	[FRAME_STATS_SCANOUT_BLOCKED_OVERLAY] = "overlay",
+	[FRAME_STATS_SCANOUT_BLOCKED_TOP_LAYER] = "top-layer",
+	[FRAME_STATS_SCANOUT_REFUSED] = "refused",
+};
+
+void
+frame_stats_add(struct frame_stats *stats, int64_t committed_at,
+		const int64_t duration[FRAME_STATS_NR_PHASES])
+{
+	assert(stats);
+	for (size_t i = 0; i < FRAME_STATS_NR_PHASES; i++) {
+		stats->samples[i][stats->head] = duration[i];
+	}
+	stats->head = (stats->head + 1) % FRAME_STATS_NR_SAMPLES;
+	stats->count = MIN(stats->count + 1, FRAME_STATS_NR_SAMPLES);
+	stats->nr_frames++;
+
+	stats->awaiting_present = true;
+	stats->last_commit_nsec = committed_at;
+}
+
+void
+frame_stats_presented(struct frame_stats *stats, int64_t presented_at,
+		int64_t refresh_nsec)
+{
+	assert(stats);
+	if (!stats->awaiting_present) {
+		return;
+	}
+	stats->awaiting_present = false;
+
+	bool missed = refresh_nsec > 0
+		&& presented_at - stats->last_commit_nsec > refresh_nsec;
+	if (missed) {
+		stats->nr_missed_vblanks++;
+	}
+
+	/* Shift the oldest frame out of the window of recent frames */
+	if (stats->recent_missed & (1ULL << (FRAME_STATS_NR_RECENT - 1))) {
+		stats->nr_recent_missed--;
+	}
+	stats->recent_missed = (stats->recent_missed << 1) | missed;
+	stats->nr_recent_missed += missed;
+}
+
+void
+frame_stats_scanout(struct frame_stats *stats, enum frame_stats_scanout result)
+{
+	assert(stats);
+	assert(result < FRAME_STATS_SCANOUT_NR_RESULTS);
+	stats->nr_scanout[result]++;
+	if (!stats->has_scanout_result || stats->last_scanout != result) {
+		wlr_log(WLR_DEBUG, "fullscreen scanout: %s",
+			scanout_names[result]);
+	}
+	stats->has_scanout_result = true;
+	stats->last_scanout = result;
+}
+
+static int
+compare_int64(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *)a;
+	int64_t y = *(const int64_t *)b;
+	return (x > y) - (x < y);
+}
+
+bool
+frame_stats_cursor(struct frame_stats *stats, bool hardware)
+{
+	assert(stats);
+	if (hardware) {
+		stats->nr_cursor_hardware++;
+	} else {
+		stats->nr_cursor_software++;
+	}
+	bool changed = !stats->has_cursor_result
+		|| stats->last_cursor_hardware != hardware;
+	stats->has_cursor_result = true;
+	stats->last_cursor_hardware = hardware;
+	return changed;
+}
+
+int64_t
+frame_stats_percentile(const struct frame_stats *stats,
+		enum frame_stats_phase phase, int percentile)
+{
+	assert(stats);
+	assert(phase < FRAME_STATS_NR_PHASES);
+	if (!stats->count) {
+		return 0;
+	}
+
+	/* Order of samples in the ring does not matter when sorting */
+	int64_t sorted[FRAME_STATS_NR_SAMPLES];
+	for (size_t i = 0; i < stats->count; i++) {
+		sorted[i] = stats->samples[phase][i];
+	}
+	qsort(sorted, stats->count, sizeof(sorted[0]), compare_int64);
+
+	percentile = MAX(0, MIN(percentile, 100));
+	size_t index = (stats->count - 1) * percentile / 100;
+	return sorted[index];
+}
+
+void
+frame_stats_print(const struct frame_stats *stats, const char *name)
+{
+	printf("%s: %lu frames, %lu missed vblanks\n", name,
+		(unsigned long)stats->nr_frames,
+		(unsigned long)stats->nr_missed_vblanks);
+	if (stats->has_scanout_result) {
+		printf("   fullscreen scanout:");
+		for (size_t i = 0; i < ARRAY_SIZE(scanout_names); i++) {
+			printf(" %s=%lu", scanout_names[i],
+				(unsigned long)stats->nr_scanout[i]);
+		}
+		printf("\n");
+	}
+	if (stats->has_cursor_result) {
+		printf("   cursor: hardware=%lu software=%lu\n",
+			(unsigned long)stats->nr_cursor_hardware,
+			(unsigned long)stats->nr_cursor_software);
+	}
+	if (!stats->count) {
+		return;
+	}
+	printf("   %-12s %8s %8s %8s\n", "phase (ms)", "p50", "p95", "p99");
+	for (size_t i = 0; i < ARRAY_SIZE(phase_names); i++) {
+		printf("   %-12s %8.3f %8.3f %8.3f\n", phase_names[i],
+			(double)frame_stats_percentile(stats, i, 50) / NSEC_PER_MSEC,
+			(double)frame_stats_percentile(stats, i, 95) / NSEC_PER_MSEC,
+			(double)frame_stats_percentile(stats, i, 99) / NSEC_PER_MSEC);
+	}
+}
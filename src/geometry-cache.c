@@ -0,0 +1,314 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <wlr/util/box.h>
+#include <wlr/util/log.h>
+#include "common/buf.h"
+#include "common/mem.h"
+#include "common/string-helpers.h"
+#include "common/timers.h"
+#include "config/rcxml.h"
+#include "geometry-cache.h"
+#include "labwc.h"
+#include "ssd.h"
+#include "view.h"
+
+#define MAX_ENTRIES (128)
+/* Closing many windows at once, e.g. at logout, results in one write */
+#define WRITE_DELAY_MS (2000)
+
+struct entry {
+	char *app_id;
+	char *output_name;
+	/* Relative to the output */
+	struct wlr_box geometry;
+	struct wl_list link; /* geometry_cache.entries, most recent first */
+};
+
+struct write_job {
+	char *path;
+	struct buf data;
+};
+
+static struct {
+	struct server *server;
+	struct wl_list entries;
+	int nr_entries;
+	char *path;
+	bool dirty;
+	struct lab_timer *write_timer;
+	/* One thread, so that writes happen in order */
+	GThreadPool *writer;
+} geometry_cache;
+
+static void
+entry_destroy(struct entry *entry)
+{
+	wl_list_remove(&entry->link);
+	geometry_cache.nr_entries--;
+	free(entry->app_id);
+	free(entry->output_name);
+	free(entry);
+}
+
+static struct entry *
+entry_find(const char *app_id)
+{
+	struct entry *entry;
+	wl_list_for_each(entry, &geometry_cache.entries, link) {
+		if (!strcmp(entry->app_id, app_id)) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+/* Adds a new entry in front, dropping the least recently used one */
+static struct entry *
+entry_add(const char *app_id, const char *output_name,
+		struct wlr_box geometry)
+{
+	if (geometry_cache.nr_entries >= MAX_ENTRIES) {
+		struct entry *oldest = wl_container_of(
+			geometry_cache.entries.prev, oldest, link);
+		entry_destroy(oldest);
+	}
+	struct entry *entry = znew(*entry);
+	entry->app_id = xstrdup(app_id);
+	entry->output_name = xstrdup(output_name);
+	entry->geometry = geometry;
+	wl_list_insert(&geometry_cache.entries, &entry->link);
+	geometry_cache.nr_entries++;
+	return entry;
+}
+
+static void
+state_path(struct buf *path)
+{
+	const char *state_home = getenv("XDG_STATE_HOME");
+	if (state_home && *state_home) {
+		buf_add(path, state_home);
+	} else {
+		const char *home = getenv("HOME");
+		if (!home) {
+			return;
+		}
+		buf_add_fmt(path, "%s/.local/state", home);
+	}
+	buf_add(path, "/labwc/geometry");
+}
+
+/* Line format: "<x> <y> <width> <height> <output> <app_id>" */
+static void
+load(void)
+{
+	FILE *stream = fopen(geometry_cache.path, "r");
+	if (!stream) {
+		return;
+	}
+	char *line = NULL;
+	size_t size = 0;
+	while (getline(&line, &size, stream) > 0) {
+		struct wlr_box box;
+		char output_name[64];
+		int app_id_pos = 0;
+		line[strcspn(line, "\n")] = '\0';
+		if (sscanf(line, "%d %d %d %d %63s %n", &box.x, &box.y,
+				&box.width, &box.height, output_name,
+				&app_id_pos) != 5 || !app_id_pos
+				|| !line[app_id_pos]) {
+			continue;
+		}
+		if (box.width <= 0 || box.height <= 0
+				|| entry_find(line + app_id_pos)) {
+			continue;
+		}
+		/* The file lists the most recent entries first */
+		struct entry *entry = entry_add(line + app_id_pos, output_name,
+			box);
+		wl_list_remove(&entry->link);
+		wl_list_insert(geometry_cache.entries.prev, &entry->link);
+	}
+	free(line);
+	fclose(stream);
+}
+
+/* Runs in the writer thread */
+static void
+handle_write_job(gpointer data, gpointer user_data)
+{
+	struct write_job *job = data;
+
+	/* Create $XDG_STATE_HOME/labwc and its parents as needed */
+	for (char *slash = strchr(job->path + 1, '/'); slash;
+			slash = strchr(slash + 1, '/')) {
+		*slash = '\0';
+		mkdir(job->path, 0700);
+		*slash = '/';
+	}
+
+	char *tmp = strdup_printf("%s.tmp", job->path);
+	FILE *stream = fopen(tmp, "w");
+	if (stream) {
+		bool ok = fwrite(job->data.data, 1, job->data.len, stream)
+			== (size_t)job->data.len;
+		ok = !fclose(stream) && ok;
+		if (!ok || rename(tmp, job->path)) {
+			wlr_log(WLR_ERROR, "cannot write %s", job->path);
+			unlink(tmp);
+		}
+	}
+	free(tmp);
+	buf_reset(&job->data);
+	free(job->path);
+	free(job);
+}
+
+static void
+write_entries(void)
+{
+	if (!geometry_cache.dirty || !geometry_cache.writer) {
+		return;
+	}
+	geometry_cache.dirty = false;
+
+	struct write_job *job = znew(*job);
+	job->path = xstrdup(geometry_cache.path);
+	job->data = BUF_INIT;
+	struct entry *entry;
+	wl_list_for_each(entry, &geometry_cache.entries, link) {
+		buf_add_fmt(&job->data, "%d %d %d %d %s %s\n",
+			entry->geometry.x, entry->geometry.y,
+			entry->geometry.width, entry->geometry.height,
+			entry->output_name, entry->app_id);
+	}
+	g_thread_pool_push(geometry_cache.writer, job, NULL);
+}
+
+static int
+handle_write_timer(void *data)
+{
+	write_entries();
+	return 0;
+}
+
+void
+geometry_cache_init(struct server *server)
+{
+	geometry_cache.server = server;
+	wl_list_init(&geometry_cache.entries);
+
+	struct buf path = BUF_INIT;
+	state_path(&path);
+	if (!path.len) {
+		buf_reset(&path);
+		return;
+	}
+	geometry_cache.path = xstrdup(path.data);
+	buf_reset(&path);
+
+	geometry_cache.writer = g_thread_pool_new(handle_write_job, NULL,
+		/* max_threads */ 1, /* exclusive */ FALSE, NULL);
+	geometry_cache.write_timer = timers_add(server->wl_event_loop,
+		handle_write_timer, NULL);
+	load();
+}
+
+void
+geometry_cache_finish(void)
+{
+	if (geometry_cache.write_timer) {
+		timers_remove(geometry_cache.write_timer);
+		geometry_cache.write_timer = NULL;
+	}
+	write_entries();
+	if (geometry_cache.writer) {
+		/* Waits for the remaining writes */
+		g_thread_pool_free(geometry_cache.writer, FALSE, TRUE);
+		geometry_cache.writer = NULL;
+	}
+	if (geometry_cache.entries.next) {
+		struct entry *entry, *tmp;
+		wl_list_for_each_safe(entry, tmp, &geometry_cache.entries,
+				link) {
+			entry_destroy(entry);
+		}
+	}
+	zfree(geometry_cache.path);
+}
+
+void
+geometry_cache_save(struct view *view)
+{
+	if (!rc.placement_remember_geometry || !geometry_cache.path
+			|| !view->been_mapped || !view->output
+			|| !output_is_usable(view->output)) {
+		return;
+	}
+	const char *app_id = view_get_app_id(view);
+	if (!app_id || !*app_id || strchr(app_id, '\n')) {
+		return;
+	}
+
+	struct wlr_box geometry = view_is_floating(view)
+		? view->pending : view->natural_geometry;
+	if (wlr_box_empty(&geometry)) {
+		return;
+	}
+	struct wlr_box *layout_box = &view->output->layout_box;
+	geometry.x -= layout_box->x;
+	geometry.y -= layout_box->y;
+
+	struct entry *entry = entry_find(app_id);
+	if (entry) {
+		entry_destroy(entry);
+	}
+	entry_add(app_id, view->output->wlr_output->name, geometry);
+	geometry_cache.dirty = true;
+	timers_update(geometry_cache.write_timer, WRITE_DELAY_MS);
+}
+
+bool
+geometry_cache_place(struct view *view)
+{
+	if (!rc.placement_remember_geometry || !geometry_cache.path) {
+		return false;
+	}
+	const char *app_id = view_get_app_id(view);
+	struct entry *entry = app_id ? entry_find(app_id) : NULL;
+	if (!entry) {
+		return false;
+	}
+	struct output *output = output_from_name(geometry_cache.server,
+		entry->output_name);
+	if (!output) {
+		return false;
+	}
+
+	struct wlr_box geometry = entry->geometry;
+	geometry.x += output->layout_box.x;
+	geometry.y += output->layout_box.y;
+
+	/* Including decorations, the window must still fit the output */
+	struct border margin = ssd_get_margin(view->ssd);
+	struct wlr_box usable = output_usable_area_in_layout_coords(output);
+	if (geometry.x - margin.left < usable.x
+			|| geometry.y - margin.top < usable.y
+			|| geometry.x + geometry.width + margin.right
+				> usable.x + usable.width
+			|| geometry.y + geometry.height + margin.bottom
+				> usable.y + usable.height) {
+		return false;
+	}
+
+	wl_list_remove(&entry->link);
+	wl_list_insert(&geometry_cache.entries, &entry->link);
+	view_set_output(view, output);
+	view_move_resize(view, geometry);
+	return true;
+}
@@ -5,8 +5,20 @@
 #include <wlr/types/wlr_idle_notify_v1.h>
 #include <wlr/types/wlr_idle_inhibit_v1.h>
 #include "common/mem.h"
+#include "common/time-helpers.h"
+#include "common/timers.h"
 #include "idle.h"
 
+/*
+ * Activity is forwarded to wlroots at most once per interval, as every
+ * notification re-arms the idle timers of all clients. The first event
+ * after a quiet interval is forwarded at once so that clients learn
+ * about resumed activity without delay, and skipped events are
+ * forwarded at the end of the interval. Idle is thus never reported
+ * early, and at most one interval late.
+ */
+#define IDLE_NOTIFY_INTERVAL_MS 50
+
 struct lab_idle_inhibitor {
 	struct wlr_idle_inhibitor_v1 *wlr_inhibitor;
 	struct wl_listener on_destroy;
@@ -19,6 +31,11 @@ struct lab_idle_manager {
 		struct wl_listener on_new_inhibitor;
 	} inhibitor;
 	struct wlr_seat *wlr_seat;
+	struct {
+		int64_t last_nsec; /* of the last forwarded notification */
+		struct wlr_seat *pending; /* skipped, to be forwarded */
+		struct lab_timer *timer;
+	} rate_limit;
 	struct wl_listener on_display_destroy;
 };
 
@@ -66,9 +83,27 @@ handle_display_destroy(struct wl_listener *listener, void *data)
 	 * destroy signal as well and thus clean up.
 	 */
 	wl_list_remove(&manager->on_display_destroy.link);
+	timers_remove(manager->rate_limit.timer);
 	zfree(manager);
 }
 
+static void
+notify_activity(struct wlr_seat *seat)
+{
+	manager->rate_limit.last_nsec = time_now_nsec();
+	manager->rate_limit.pending = NULL;
+	wlr_idle_notifier_v1_notify_activity(manager->ext, seat);
+}
+
+static int
+handle_rate_limit_timeout(void *data)
+{
+	if (manager && manager->rate_limit.pending) {
+		notify_activity(manager->rate_limit.pending);
+	}
+	return 0;
+}
+
 void
 idle_manager_create(struct wl_display *display, struct wlr_seat *wlr_seat)
 {
@@ -83,6 +118,10 @@ idle_manager_create(struct wl_display *display, struct wlr_seat *wlr_seat)
 	wl_signal_add(&manager->inhibitor.manager->events.new_inhibitor,
 		&manager->inhibitor.on_new_inhibitor);
 
+	manager->rate_limit.timer = timers_add(
+		wl_display_get_event_loop(display), handle_rate_limit_timeout,
+		NULL);
+
 	manager->on_display_destroy.notify = handle_display_destroy;
 	wl_display_add_destroy_listener(display, &manager->on_display_destroy);
 }
@@ -100,5 +139,16 @@ idle_manager_notify_activity(struct wlr_seat *seat)
 		return;
 	}
 
-	wlr_idle_notifier_v1_notify_activity(manager->ext, seat);
+	if (manager->rate_limit.pending) {
+		/* Already forwarded at the end of the interval */
+		return;
+	}
+	int64_t elapsed = time_now_nsec() - manager->rate_limit.last_nsec;
+	if (elapsed >= IDLE_NOTIFY_INTERVAL_MS * NSEC_PER_MSEC) {
+		notify_activity(seat);
+		return;
+	}
+	manager->rate_limit.pending = seat;
+	int delay_ms = IDLE_NOTIFY_INTERVAL_MS - elapsed / NSEC_PER_MSEC;
+	timers_update(manager->rate_limit.timer, delay_ms);
 }
@@ -18,12 +18,16 @@
 #include "input/gestures.h"
 #include "input/touch.h"
 #include "labwc.h"
+#include "latency-trace.h"
 #include "layers.h"
+#include "magnifier.h"
 #include "menu/menu.h"
+#include "overview.h"
 #include "regions.h"
-#include "resistance.h"
 #include "ssd.h"
+#include "trace.h"
 #include "view.h"
+#include "workspaces.h"
 
 #define LAB_CURSOR_SHAPE_V1_VERSION 1
 
@@ -135,7 +139,8 @@ request_cursor_notify(struct wl_listener *listener, void *data)
 {
 	struct seat *seat = wl_container_of(listener, seat, request_cursor);
 
-	if (seat->server->input_mode != LAB_INPUT_STATE_PASSTHROUGH) {
+	if (seat->server->input_mode != LAB_INPUT_STATE_PASSTHROUGH
+			|| seat->cursor_hidden) {
 		/* Prevent setting a cursor image when moving or resizing */
 		return;
 	}
@@ -174,7 +179,8 @@ request_set_shape_notify(struct wl_listener *listener, void *data)
 	struct wlr_seat_client *focused_client = seat->seat->pointer_state.focused_client;
 
 	/* Prevent setting a cursor image when moving or resizing */
-	if (seat->server->input_mode != LAB_INPUT_STATE_PASSTHROUGH) {
+	if (seat->server->input_mode != LAB_INPUT_STATE_PASSTHROUGH
+			|| seat->cursor_hidden) {
 		return;
 	}
 
@@ -212,65 +218,6 @@ request_set_primary_selection_notify(struct wl_listener *listener, void *data)
 		event->serial);
 }
 
-static void
-process_cursor_move(struct server *server, uint32_t time)
-{
-	double dx = server->seat.cursor->x - server->grab_x;
-	double dy = server->seat.cursor->y - server->grab_y;
-	struct view *view = server->grabbed_view;
-
-	/* Move the grabbed view to the new position. */
-	dx += server->grab_box.x;
-	dy += server->grab_box.y;
-	resistance_move_apply(view, &dx, &dy);
-	view_move(view, dx, dy);
-
-	overlay_update(&server->seat);
-}
-
-static void
-process_cursor_resize(struct server *server, uint32_t time)
-{
-	double dx = server->seat.cursor->x - server->grab_x;
-	double dy = server->seat.cursor->y - server->grab_y;
-
-	struct view *view = server->grabbed_view;
-	struct wlr_box new_view_geo = view->current;
-
-	if (server->resize_edges & WLR_EDGE_TOP) {
-		/* Shift y to anchor bottom edge when resizing top */
-		new_view_geo.y = server->grab_box.y + dy;
-		new_view_geo.height = server->grab_box.height - dy;
-	} else if (server->resize_edges & WLR_EDGE_BOTTOM) {
-		new_view_geo.height = server->grab_box.height + dy;
-	}
-
-	if (server->resize_edges & WLR_EDGE_LEFT) {
-		/* Shift x to anchor right edge when resizing left */
-		new_view_geo.x = server->grab_box.x + dx;
-		new_view_geo.width = server->grab_box.width - dx;
-	} else if (server->resize_edges & WLR_EDGE_RIGHT) {
-		new_view_geo.width = server->grab_box.width + dx;
-	}
-
-	resistance_resize_apply(view, &new_view_geo);
-	view_adjust_size(view, &new_view_geo.width, &new_view_geo.height);
-
-	if (server->resize_edges & WLR_EDGE_TOP) {
-		/* After size adjustments, make sure to anchor bottom edge */
-		new_view_geo.y = server->grab_box.y +
-			server->grab_box.height - new_view_geo.height;
-	}
-
-	if (server->resize_edges & WLR_EDGE_LEFT) {
-		/* After size adjustments, make sure to anchor bottom right */
-		new_view_geo.x = server->grab_box.x +
-			server->grab_box.width - new_view_geo.width;
-	}
-
-	view_move_resize(view, new_view_geo);
-}
-
 void
 cursor_set(struct seat *seat, enum lab_cursors cursor)
 {
@@ -281,15 +228,21 @@ cursor_set(struct seat *seat, enum lab_cursors cursor)
 		return;
 	}
 
-	wlr_cursor_set_xcursor(seat->cursor, seat->xcursor_manager,
-		cursor_names[cursor]);
 	seat->server_cursor = cursor;
+	if (!seat->cursor_hidden) {
+		/* Otherwise applied by cursor_set_hidden() */
+		wlr_cursor_set_xcursor(seat->cursor, seat->xcursor_manager,
+			cursor_names[cursor]);
+	}
 }
 
 void
 cursor_update_image(struct seat *seat)
 {
 	enum lab_cursors cursor = seat->server_cursor;
+	if (seat->cursor_hidden) {
+		return;
+	}
 	if (cursor == LAB_CURSOR_CLIENT) {
 		/*
 		 * When we loose the output cursor while over a client
@@ -323,6 +276,80 @@ input_inhibit_blocks_surface(struct seat *seat, struct wl_resource *resource)
 		&& inhibiting_client != wl_resource_get_client(resource);
 }
 
+/*
+ * While the session is locked or input is inhibited, only one client
+ * receives pointer input. Events are then handed straight to it from the
+ * listeners below, without looking at decorations, menus, bindings or
+ * interactive move/resize.
+ */
+static bool
+input_is_exclusive(struct server *server)
+{
+	return server->session_lock || server->seat.active_client_while_inhibited;
+}
+
+static struct wlr_surface *
+exclusive_surface_at(struct server *server, double *sx, double *sy)
+{
+	struct seat *seat = &server->seat;
+	double lx = seat->cursor->x;
+	double ly = seat->cursor->y;
+	struct wlr_scene_node *node = NULL;
+
+	if (server->session_lock) {
+		/* Only lock surfaces can take input, so skip everything else */
+		struct output *output;
+		wl_list_for_each(output, &server->outputs, link) {
+			node = wlr_scene_node_at(&output->session_lock_tree->node,
+				lx, ly, sx, sy);
+			if (node) {
+				break;
+			}
+		}
+	} else {
+		node = wlr_scene_node_at(&server->scene->tree.node,
+			lx, ly, sx, sy);
+	}
+
+	struct wlr_surface *surface = lab_wlr_surface_from_node(node);
+	if (surface && input_inhibit_blocks_surface(seat, surface->resource)) {
+		return NULL;
+	}
+	return surface;
+}
+
+static void
+process_exclusive_motion(struct server *server, uint32_t time_msec,
+		bool cursor_has_moved)
+{
+	struct seat *seat = &server->seat;
+	double sx, sy;
+	struct wlr_surface *surface = exclusive_surface_at(server, &sx, &sy);
+	if (!surface) {
+		wlr_seat_pointer_notify_clear_focus(seat->seat);
+		cursor_set(seat, LAB_CURSOR_DEFAULT);
+		return;
+	}
+	if (surface != seat->seat->pointer_state.focused_surface) {
+		wlr_seat_pointer_notify_enter(seat->seat, surface, sx, sy);
+		seat->server_cursor = LAB_CURSOR_CLIENT;
+	}
+	if (cursor_has_moved) {
+		wlr_seat_pointer_notify_motion(seat->seat, time_msec, sx, sy);
+	}
+}
+
+static void
+process_exclusive_button_press(struct seat *seat, struct wlr_surface *surface)
+{
+	/* The inhibiting client may have more than one layer-shell surface */
+	struct wlr_layer_surface_v1 *layer = surface ?
+		wlr_layer_surface_v1_try_from_wlr_surface(surface) : NULL;
+	if (layer && layer->current.keyboard_interactive) {
+		layer_try_set_focus(seat, layer);
+	}
+}
+
 static bool
 update_pressed_surface(struct seat *seat, struct cursor_context *ctx)
 {
@@ -399,7 +426,12 @@ cursor_update_common(struct server *server, struct cursor_context *ctx,
 	struct seat *seat = &server->seat;
 	struct wlr_seat *wlr_seat = seat->seat;
 
-	ssd_update_button_hover(ctx->node, server->ssd_hover_state);
+	if (!seat->cursor_hidden) {
+		ssd_update_button_hover(ctx->node, server->ssd_hover_state);
+		if (ctx->view && ctx->view != server->active_view) {
+			ssd_prewarm_title(ctx->view->ssd);
+		}
+	}
 
 	if (server->input_mode != LAB_INPUT_STATE_PASSTHROUGH) {
 		/*
@@ -497,12 +529,17 @@ cursor_get_resize_edges(struct wlr_cursor *cursor, struct cursor_context *ctx)
 static void
 process_cursor_motion(struct server *server, uint32_t time)
 {
-	/* If the mode is non-passthrough, delegate to those functions. */
-	if (server->input_mode == LAB_INPUT_STATE_MOVE) {
-		process_cursor_move(server, time);
+	magnifier_on_cursor_motion(server);
+
+	if (input_is_exclusive(server)) {
+		process_exclusive_motion(server, time, /*cursor_has_moved*/ true);
 		return;
-	} else if (server->input_mode == LAB_INPUT_STATE_RESIZE) {
-		process_cursor_resize(server, time);
+	}
+
+	/* If the mode is non-passthrough, the grabbed view follows */
+	if (server->input_mode == LAB_INPUT_STATE_MOVE
+			|| server->input_mode == LAB_INPUT_STATE_RESIZE) {
+		interactive_schedule_update(server);
 		return;
 	}
 
@@ -550,12 +587,33 @@ msec(const struct timespec *t)
 	return t->tv_sec * 1000 + t->tv_nsec / 1000000;
 }
 
+/*
+ * A locked pointer does not move and stays focused on the locking surface
+ * until the constraint goes away, so there is nothing to hit-test.
+ */
+static bool
+pointer_locked(struct seat *seat)
+{
+	return seat->current_constraint
+		&& seat->current_constraint->type == WLR_POINTER_CONSTRAINT_V1_LOCKED;
+}
+
 static void
 _cursor_update_focus(struct server *server)
 {
+	if (pointer_locked(&server->seat)) {
+		return;
+	}
+
 	struct timespec now;
 	clock_gettime(CLOCK_MONOTONIC, &now);
 
+	if (input_is_exclusive(server)) {
+		process_exclusive_motion(server, msec(&now),
+			/*cursor_has_moved*/ false);
+		return;
+	}
+
 	/* Focus surface under cursor if it isn't already focused */
 	struct cursor_context ctx = get_cursor_context(server);
 
@@ -578,6 +636,8 @@ cursor_update_focus(struct server *server)
 	static bool updating_focus = false;
 	if (!updating_focus) {
 		updating_focus = true;
+		/* The scene has likely changed underneath the cursor */
+		cursor_context_invalidate(server);
 		_cursor_update_focus(server);
 		updating_focus = false;
 	}
@@ -713,9 +773,52 @@ apply_constraint(struct seat *seat, struct wlr_pointer *pointer, double *x, doub
 static bool
 cursor_locked(struct seat *seat, struct wlr_pointer *pointer)
 {
-	return seat->current_constraint
-		&& pointer->base.type == WLR_INPUT_DEVICE_POINTER
-		&& seat->current_constraint->type == WLR_POINTER_CONSTRAINT_V1_LOCKED;
+	return pointer->base.type == WLR_INPUT_DEVICE_POINTER
+		&& pointer_locked(seat);
+}
+
+/*
+ * Pointer motion is applied to the wlr_cursor right away, but the
+ * expensive part (hit-testing, focus and cursor image updates and
+ * notifying the client) is done only once per event loop iteration.
+ * High rate mice easily deliver several motion events per dispatch.
+ */
+static void
+handle_pending_motion(void *data)
+{
+	struct seat *seat = data;
+	seat->pending_motion.idle = NULL;
+	process_cursor_motion(seat->server, seat->pending_motion.time_msec);
+	wlr_seat_pointer_notify_frame(seat->seat);
+}
+
+void
+cursor_flush_motion(struct seat *seat)
+{
+	if (seat->pending_motion.idle) {
+		wl_event_source_remove(seat->pending_motion.idle);
+		handle_pending_motion(seat);
+	}
+}
+
+/*
+ * Touch input hides the cursor, other input shows it again. Hiding drops
+ * the hover state of SSD buttons, showing restores the last cursor image
+ * set by labwc or has the client under the cursor set its own again.
+ */
+static void
+cursor_set_hidden(struct seat *seat, bool hidden)
+{
+	if (seat->cursor_hidden == hidden) {
+		return;
+	}
+	seat->cursor_hidden = hidden;
+	if (hidden) {
+		wlr_cursor_unset_image(seat->cursor);
+		ssd_update_button_hover(NULL, seat->server->ssd_hover_state);
+	} else {
+		cursor_update_image(seat);
+	}
 }
 
 static void
@@ -725,6 +828,7 @@ preprocess_cursor_motion(struct seat *seat, struct wlr_pointer *pointer,
 	if (cursor_locked(seat, pointer)) {
 		return;
 	}
+	cursor_set_hidden(seat, false);
 	apply_constraint(seat, pointer, &dx, &dy);
 
 	/*
@@ -736,7 +840,12 @@ preprocess_cursor_motion(struct seat *seat, struct wlr_pointer *pointer,
 	 * without any input.
 	 */
 	wlr_cursor_move(seat->cursor, &pointer->base, dx, dy);
-	process_cursor_motion(seat->server, time_msec);
+
+	seat->pending_motion.time_msec = time_msec;
+	if (!seat->pending_motion.idle) {
+		seat->pending_motion.idle = wl_event_loop_add_idle(
+			seat->server->wl_event_loop, handle_pending_motion, seat);
+	}
 }
 
 static void
@@ -750,6 +859,9 @@ cursor_motion(struct wl_listener *listener, void *data)
 	struct server *server = seat->server;
 	struct wlr_pointer_motion_event *event = data;
 	idle_manager_notify_activity(seat->seat);
+	trace_instant("pointer_motion", NULL);
+	input_latency_event(&seat->input_latency,
+		seat->seat->pointer_state.focused_surface, event->time_msec);
 
 	wlr_relative_pointer_manager_v1_send_relative_motion(
 		server->relative_pointer_manager,
@@ -757,6 +869,15 @@ cursor_motion(struct wl_listener *listener, void *data)
 		event->delta_x, event->delta_y, event->unaccel_dx,
 		event->unaccel_dy);
 
+	if (cursor_locked(seat, event->pointer)) {
+		/*
+		 * Locked pointer: the relative motion is all the client
+		 * gets. The frame follows from cursor_frame() right away
+		 * as no motion is pending.
+		 */
+		return;
+	}
+
 	preprocess_cursor_motion(seat, event->pointer,
 		event->time_msec, event->delta_x, event->delta_y);
 }
@@ -776,6 +897,9 @@ cursor_motion_absolute(struct wl_listener *listener, void *data)
 		listener, seat, cursor_motion_absolute);
 	struct wlr_pointer_motion_absolute_event *event = data;
 	idle_manager_notify_activity(seat->seat);
+	trace_instant("pointer_motion", NULL);
+	input_latency_event(&seat->input_latency,
+		seat->seat->pointer_state.focused_surface, event->time_msec);
 
 	double lx, ly;
 	wlr_cursor_absolute_to_layout_coords(seat->cursor,
@@ -797,16 +921,19 @@ static bool
 handle_release_mousebinding(struct server *server,
 		struct cursor_context *ctx, uint32_t button)
 {
-	struct mousebind *mousebind;
 	bool consumed_by_frame_context = false;
 
 	uint32_t modifiers = wlr_keyboard_get_modifiers(
 			&server->seat.keyboard_group->keyboard);
 
-	wl_list_for_each(mousebind, &rc.mousebinds, link) {
-		if (ssd_part_contains(mousebind->context, ctx->type)
-				&& mousebind->button == button
-				&& modifiers == mousebind->modifiers) {
+	struct wl_array *bindings = mousebind_lookup_button(button, modifiers);
+	struct mousebind_entry *entry;
+	if (!bindings) {
+		goto out;
+	}
+	wl_array_for_each(entry, bindings) {
+		struct mousebind *mousebind = entry->mousebind;
+		if (mousebind_entry_matches(entry, ctx->type)) {
 			switch (mousebind->mouse_event) {
 			case MOUSE_ACTION_RELEASE:
 				break;
@@ -833,15 +960,12 @@ handle_release_mousebinding(struct server *server,
 				/*resize_edges*/ 0);
 		}
 	}
+out:
 	/*
 	 * Clear "pressed" status for all bindings of this mouse button,
 	 * regardless of whether handled or not
 	 */
-	wl_list_for_each(mousebind, &rc.mousebinds, link) {
-		if (mousebind->button == button) {
-			mousebind->pressed_in_context = false;
-		}
-	}
+	mousebind_clear_pressed(button);
 	return consumed_by_frame_context;
 }
 
@@ -883,17 +1007,21 @@ static bool
 handle_press_mousebinding(struct server *server, struct cursor_context *ctx,
 		uint32_t button, uint32_t resize_edges)
 {
-	struct mousebind *mousebind;
 	bool double_click = is_double_click(rc.doubleclick_time, button, ctx);
 	bool consumed_by_frame_context = false;
 
 	uint32_t modifiers = wlr_keyboard_get_modifiers(
 			&server->seat.keyboard_group->keyboard);
 
-	wl_list_for_each(mousebind, &rc.mousebinds, link) {
-		if (ssd_part_contains(mousebind->context, ctx->type)
-				&& mousebind->button == button
-				&& modifiers == mousebind->modifiers) {
+	struct wl_array *bindings = mousebind_lookup_button(button, modifiers);
+	if (!bindings) {
+		return false;
+	}
+
+	struct mousebind_entry *entry;
+	wl_array_for_each(entry, bindings) {
+		struct mousebind *mousebind = entry->mousebind;
+		if (mousebind_entry_matches(entry, ctx->type)) {
 			switch (mousebind->mouse_event) {
 			case MOUSE_ACTION_DRAG: /* fallthrough */
 			case MOUSE_ACTION_CLICK:
@@ -937,6 +1065,21 @@ cursor_button_press(struct seat *seat, uint32_t button,
 		enum wlr_button_state button_state, uint32_t time_msec)
 {
 	struct server *server = seat->server;
+
+	if (input_is_exclusive(server)) {
+		process_exclusive_button_press(seat,
+			seat->seat->pointer_state.focused_surface);
+		wlr_seat_pointer_notify_button(seat->seat, time_msec,
+			button, button_state);
+		return;
+	}
+
+	if (overview_handle_button(server, /*pressed*/ true)) {
+		return;
+	}
+
+	/* Clicks are meant for what the scene will look like in the end */
+	workspaces_transition_finish(server);
 	struct cursor_context ctx = get_cursor_context(server);
 
 	/* Determine closest resize edges in case action is Resize */
@@ -1013,6 +1156,19 @@ cursor_button_release(struct seat *seat, uint32_t button,
 		enum wlr_button_state button_state, uint32_t time_msec)
 {
 	struct server *server = seat->server;
+
+	if (input_is_exclusive(server)
+			&& server->input_mode == LAB_INPUT_STATE_PASSTHROUGH) {
+		seat_reset_pressed(seat);
+		wlr_seat_pointer_notify_button(seat->seat, time_msec,
+			button, button_state);
+		return;
+	}
+
+	if (overview_handle_button(server, /*pressed*/ false)) {
+		return;
+	}
+
 	struct cursor_context ctx = get_cursor_context(server);
 	struct wlr_surface *pressed_surface = seat->pressed.surface;
 
@@ -1076,6 +1232,12 @@ cursor_button(struct wl_listener *listener, void *data)
 	struct seat *seat = wl_container_of(listener, seat, cursor_button);
 	struct wlr_pointer_button_event *event = data;
 	idle_manager_notify_activity(seat->seat);
+	trace_instant("pointer_button", event->state == WLR_BUTTON_PRESSED
+		? "pressed" : "released");
+	input_latency_event(&seat->input_latency,
+		seat->seat->pointer_state.focused_surface, event->time_msec);
+	cursor_flush_motion(seat);
+	cursor_set_hidden(seat, false);
 
 	switch (event->state) {
 	case WLR_BUTTON_PRESSED:
@@ -1092,6 +1254,8 @@ cursor_emulate_move_absolute(struct seat *seat, struct wlr_input_device *device,
 		double x, double y, uint32_t time_msec)
 {
 	idle_manager_notify_activity(seat->seat);
+	cursor_flush_motion(seat);
+	cursor_set_hidden(seat, device->type == WLR_INPUT_DEVICE_TOUCH);
 
 	double lx, ly;
 	wlr_cursor_absolute_to_layout_coords(seat->cursor,
@@ -1120,6 +1284,7 @@ cursor_emulate_button(struct seat *seat, uint32_t button,
 		enum wlr_button_state state, uint32_t time_msec)
 {
 	idle_manager_notify_activity(seat->seat);
+	cursor_flush_motion(seat);
 
 	switch (state) {
 	case WLR_BUTTON_PRESSED:
@@ -1196,16 +1361,35 @@ handle_cursor_axis(struct server *server, struct cursor_context *ctx,
 		return false;
 	}
 
-	wl_list_for_each(mousebind, &rc.mousebinds, link) {
-		if (ssd_part_contains(mousebind->context, ctx->type)
-				&& mousebind->direction == direction
-				&& modifiers == mousebind->modifiers
-				&& mousebind->mouse_event == MOUSE_ACTION_SCROLL) {
+	struct wl_array *bindings = mousebind_lookup_scroll(direction);
+	if (!bindings) {
+		return false;
+	}
+
+	/*
+	 * High resolution wheels and touchpads can cross the threshold
+	 * several times within one frame, run the bindings only once
+	 */
+	uint32_t axis = event->orientation;
+	if (axis >= ARRAY_SIZE(server->seat.scroll_frame)) {
+		return false;
+	}
+	if (server->seat.scroll_frame[axis].evaluated) {
+		return server->seat.scroll_frame[axis].handled;
+	}
+
+	struct mousebind_entry *entry;
+	wl_array_for_each(entry, bindings) {
+		mousebind = entry->mousebind;
+		if (mousebind_entry_matches(entry, ctx->type)
+				&& modifiers == mousebind->modifiers) {
 			handled = true;
 			actions_run(ctx->view, server, &mousebind->actions, /*resize_edges*/ 0);
 		}
 	}
 
+	server->seat.scroll_frame[axis].evaluated = true;
+	server->seat.scroll_frame[axis].handled = handled;
 	return handled;
 }
 
@@ -1219,8 +1403,35 @@ cursor_axis(struct wl_listener *listener, void *data)
 	struct seat *seat = wl_container_of(listener, seat, cursor_axis);
 	struct wlr_pointer_axis_event *event = data;
 	struct server *server = seat->server;
-	struct cursor_context ctx = get_cursor_context(server);
+	cursor_flush_motion(seat);
 	idle_manager_notify_activity(seat->seat);
+	trace_instant("pointer_axis", NULL);
+	input_latency_event(&seat->input_latency,
+		seat->seat->pointer_state.focused_surface, event->time_msec);
+
+	if (input_is_exclusive(server)) {
+		/* No scroll bindings, straight to the surface under the cursor */
+		process_exclusive_motion(server, event->time_msec,
+			/*cursor_has_moved*/ false);
+		wlr_seat_pointer_notify_axis(seat->seat, event->time_msec,
+			event->orientation, rc.scroll_factor * event->delta,
+			round(rc.scroll_factor * event->delta_discrete),
+			event->source);
+		return;
+	}
+
+	struct cursor_context ctx = get_cursor_context(server);
+
+	if (server->input_mode == LAB_INPUT_STATE_MENU
+			&& ctx.type == LAB_SSD_MENU) {
+		/* Menus taller than the output scroll by three items a step */
+		if (event->orientation == WLR_AXIS_ORIENTATION_VERTICAL) {
+			int rel = compare_delta(event,
+				&seat->smooth_scroll_offset.y);
+			menu_scroll(ctx.node, 3 * rel);
+		}
+		return;
+	}
 
 	/* Bindings swallow mouse events if activated */
 	bool handled = handle_cursor_axis(server, &ctx, event);
@@ -1248,10 +1459,36 @@ cursor_frame(struct wl_listener *listener, void *data)
 	 * between.
 	 */
 	struct seat *seat = wl_container_of(listener, seat, cursor_frame);
+	for (size_t i = 0; i < ARRAY_SIZE(seat->scroll_frame); i++) {
+		seat->scroll_frame[i].evaluated = false;
+	}
+	if (seat->pending_motion.idle) {
+		/* Sent along with the motion, see handle_pending_motion() */
+		return;
+	}
 	/* Notify the client with pointer focus of the frame event. */
 	wlr_seat_pointer_notify_frame(seat->seat);
 }
 
+LATENCY_TRACE_LISTENER(cursor_motion)
+LATENCY_TRACE_LISTENER(cursor_motion_absolute)
+LATENCY_TRACE_LISTENER(cursor_button)
+LATENCY_TRACE_LISTENER(cursor_axis)
+LATENCY_TRACE_LISTENER(cursor_frame)
+
+void
+cursor_load_scales(struct seat *seat)
+{
+	/* Loading an already loaded scale is a no-op */
+	struct output *output;
+	wl_list_for_each(output, &seat->server->outputs, link) {
+		if (output_is_usable(output)) {
+			wlr_xcursor_manager_load(seat->xcursor_manager,
+				output->wlr_output->scale);
+		}
+	}
+}
+
 void
 cursor_load(struct seat *seat)
 {
@@ -1264,6 +1501,7 @@ cursor_load(struct seat *seat)
 	}
 	seat->xcursor_manager = wlr_xcursor_manager_create(xcursor_theme, size);
 	wlr_xcursor_manager_load(seat->xcursor_manager, 1);
+	cursor_load_scales(seat);
 
 	/*
 	 * Wlroots provides integrated fallback cursor icons using
@@ -1308,16 +1546,16 @@ cursor_init(struct seat *seat)
 
 	dnd_init(seat);
 
-	seat->cursor_motion.notify = cursor_motion;
+	seat->cursor_motion.notify = cursor_motion_traced;
 	wl_signal_add(&seat->cursor->events.motion, &seat->cursor_motion);
-	seat->cursor_motion_absolute.notify = cursor_motion_absolute;
+	seat->cursor_motion_absolute.notify = cursor_motion_absolute_traced;
 	wl_signal_add(&seat->cursor->events.motion_absolute,
 		&seat->cursor_motion_absolute);
-	seat->cursor_button.notify = cursor_button;
+	seat->cursor_button.notify = cursor_button_traced;
 	wl_signal_add(&seat->cursor->events.button, &seat->cursor_button);
-	seat->cursor_axis.notify = cursor_axis;
+	seat->cursor_axis.notify = cursor_axis_traced;
 	wl_signal_add(&seat->cursor->events.axis, &seat->cursor_axis);
-	seat->cursor_frame.notify = cursor_frame;
+	seat->cursor_frame.notify = cursor_frame_traced;
 	wl_signal_add(&seat->cursor->events.frame, &seat->cursor_frame);
 
 	gestures_init(seat);
@@ -1357,6 +1595,10 @@ void cursor_finish(struct seat *seat)
 	wl_list_remove(&seat->cursor_button.link);
 	wl_list_remove(&seat->cursor_axis.link);
 	wl_list_remove(&seat->cursor_frame.link);
+	if (seat->pending_motion.idle) {
+		wl_event_source_remove(seat->pending_motion.idle);
+		seat->pending_motion.idle = NULL;
+	}
 
 	gestures_finish(seat);
 	touch_finish(seat);
@@ -1,13 +1,175 @@
 // SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include <math.h>
 #include <wlr/types/wlr_pointer_gestures_v1.h>
+#include "action.h"
+#include "config/mousebind.h"
+#include "config/rcxml.h"
 #include "input/gestures.h"
 #include "labwc.h"
+#include "ssd.h"
+
+/*
+ * Swipe and pinch gestures for which a mousebind exists are consumed by
+ * the compositor and not forwarded to clients. A gesture is recognized
+ * once it has travelled far enough or, for quick flicks, once it has
+ * travelled a short distance at high speed. The bound actions run once
+ * per gesture.
+ */
+#define GESTURE_SWIPE_THRESHOLD (80.0)
+#define GESTURE_FLICK_THRESHOLD (GESTURE_SWIPE_THRESHOLD / 4)
+/* units per ms */
+#define GESTURE_FLICK_VELOCITY (1.0)
+#define GESTURE_PINCH_IN_SCALE (0.75)
+#define GESTURE_PINCH_OUT_SCALE (1.33)
+
+static enum mouse_event
+gesture_mouse_event(enum gesture_type type)
+{
+	switch (type) {
+	case LAB_GESTURE_SWIPE:
+		return MOUSE_ACTION_SWIPE;
+	case LAB_GESTURE_PINCH:
+		return MOUSE_ACTION_PINCH;
+	default:
+		return MOUSE_ACTION_NONE;
+	}
+}
+
+static uint32_t
+keyboard_modifiers(struct seat *seat)
+{
+	return wlr_keyboard_get_modifiers(&seat->keyboard_group->keyboard);
+}
+
+/*
+ * Find a mousebind for the gesture. With direction LAB_DIRECTION_INVALID
+ * any direction matches, which is used to decide whether to track the
+ * gesture at all.
+ */
+static struct mousebind *
+gesture_find_binding(struct seat *seat, struct cursor_context *ctx,
+		enum gesture_type type, uint32_t fingers,
+		enum direction direction)
+{
+	enum mouse_event event = gesture_mouse_event(type);
+	uint32_t modifiers = keyboard_modifiers(seat);
+	struct mousebind *mousebind;
+	wl_list_for_each(mousebind, &rc.mousebinds, link) {
+		if (mousebind->mouse_event != event
+				|| mousebind->fingers != fingers
+				|| mousebind->modifiers != modifiers
+				|| !ssd_part_contains(mousebind->context,
+					ctx->type)) {
+			continue;
+		}
+		if (direction == LAB_DIRECTION_INVALID
+				|| mousebind->direction == direction) {
+			return mousebind;
+		}
+	}
+	return NULL;
+}
+
+static bool
+gesture_begin(struct seat *seat, enum gesture_type type, uint32_t fingers,
+		uint32_t time_msec)
+{
+	struct gesture_tracker *gesture = &seat->gesture;
+	*gesture = (struct gesture_tracker){ 0 };
+
+	struct cursor_context ctx = get_cursor_context(seat->server);
+	if (!gesture_find_binding(seat, &ctx, type, fingers,
+			LAB_DIRECTION_INVALID)) {
+		return false;
+	}
+	gesture->type = type;
+	gesture->fingers = fingers;
+	gesture->scale = 1.0;
+	gesture->last_time_msec = time_msec;
+	return true;
+}
+
+static enum direction
+gesture_direction(struct gesture_tracker *gesture)
+{
+	if (gesture->type == LAB_GESTURE_PINCH) {
+		if (gesture->scale <= GESTURE_PINCH_IN_SCALE) {
+			return LAB_DIRECTION_IN;
+		} else if (gesture->scale >= GESTURE_PINCH_OUT_SCALE) {
+			return LAB_DIRECTION_OUT;
+		}
+		return LAB_DIRECTION_INVALID;
+	}
+
+	double distance = fmax(fabs(gesture->dx), fabs(gesture->dy));
+	if (distance < GESTURE_SWIPE_THRESHOLD
+			&& (distance < GESTURE_FLICK_THRESHOLD
+			|| gesture->velocity < GESTURE_FLICK_VELOCITY)) {
+		return LAB_DIRECTION_INVALID;
+	}
+	if (fabs(gesture->dx) > fabs(gesture->dy)) {
+		return gesture->dx < 0 ? LAB_DIRECTION_LEFT : LAB_DIRECTION_RIGHT;
+	}
+	return gesture->dy < 0 ? LAB_DIRECTION_UP : LAB_DIRECTION_DOWN;
+}
+
+static void
+gesture_update(struct seat *seat, uint32_t time_msec, double dx, double dy,
+		double scale)
+{
+	struct gesture_tracker *gesture = &seat->gesture;
+	assert(gesture->type != LAB_GESTURE_NONE);
+	if (gesture->triggered) {
+		return;
+	}
+
+	gesture->dx += dx;
+	gesture->dy += dy;
+	gesture->scale = scale;
+
+	/* Exponentially smoothed speed to ignore single outliers */
+	uint32_t dt = time_msec - gesture->last_time_msec;
+	if (dt > 0) {
+		double speed = hypot(dx, dy) / dt;
+		gesture->velocity = 0.5 * gesture->velocity + 0.5 * speed;
+	}
+	gesture->last_time_msec = time_msec;
+
+	enum direction direction = gesture_direction(gesture);
+	if (direction == LAB_DIRECTION_INVALID) {
+		return;
+	}
+
+	struct cursor_context ctx = get_cursor_context(seat->server);
+	struct mousebind *mousebind = gesture_find_binding(seat, &ctx,
+		gesture->type, gesture->fingers, direction);
+	if (!mousebind) {
+		return;
+	}
+	gesture->triggered = true;
+	actions_run(ctx.view, seat->server, &mousebind->actions, 0);
+}
+
+static bool
+gesture_end(struct seat *seat, enum gesture_type type)
+{
+	if (seat->gesture.type != type) {
+		return false;
+	}
+	seat->gesture = (struct gesture_tracker){ 0 };
+	return true;
+}
 
 static void
 handle_pointer_pinch_begin(struct wl_listener *listener, void *data)
 {
 	struct seat *seat = wl_container_of(listener, seat, pinch_begin);
 	struct wlr_pointer_pinch_begin_event *event = data;
+	if (gesture_begin(seat, LAB_GESTURE_PINCH, event->fingers,
+			event->time_msec)) {
+		return;
+	}
 	wlr_pointer_gestures_v1_send_pinch_begin(seat->pointer_gestures,
 		seat->seat, event->time_msec, event->fingers);
 }
@@ -17,6 +179,11 @@ handle_pointer_pinch_update(struct wl_listener *listener, void *data)
 {
 	struct seat *seat = wl_container_of(listener, seat, pinch_update);
 	struct wlr_pointer_pinch_update_event *event = data;
+	if (seat->gesture.type == LAB_GESTURE_PINCH) {
+		gesture_update(seat, event->time_msec, event->dx, event->dy,
+			event->scale);
+		return;
+	}
 	wlr_pointer_gestures_v1_send_pinch_update(seat->pointer_gestures,
 		seat->seat, event->time_msec, event->dx, event->dy,
 		event->scale, event->rotation);
@@ -27,6 +194,9 @@ handle_pointer_pinch_end(struct wl_listener *listener, void *data)
 {
 	struct seat *seat = wl_container_of(listener, seat, pinch_end);
 	struct wlr_pointer_pinch_end_event *event = data;
+	if (gesture_end(seat, LAB_GESTURE_PINCH)) {
+		return;
+	}
 	wlr_pointer_gestures_v1_send_pinch_end(seat->pointer_gestures,
 		seat->seat, event->time_msec, event->cancelled);
 }
@@ -36,6 +206,10 @@ handle_pointer_swipe_begin(struct wl_listener *listener, void *data)
 {
 	struct seat *seat = wl_container_of(listener, seat, swipe_begin);
 	struct wlr_pointer_swipe_begin_event *event = data;
+	if (gesture_begin(seat, LAB_GESTURE_SWIPE, event->fingers,
+			event->time_msec)) {
+		return;
+	}
 	wlr_pointer_gestures_v1_send_swipe_begin(seat->pointer_gestures,
 		seat->seat, event->time_msec, event->fingers);
 }
@@ -45,6 +219,11 @@ handle_pointer_swipe_update(struct wl_listener *listener, void *data)
 {
 	struct seat *seat = wl_container_of(listener, seat, swipe_update);
 	struct wlr_pointer_swipe_update_event *event = data;
+	if (seat->gesture.type == LAB_GESTURE_SWIPE) {
+		gesture_update(seat, event->time_msec, event->dx, event->dy,
+			1.0);
+		return;
+	}
 	wlr_pointer_gestures_v1_send_swipe_update(seat->pointer_gestures,
 		seat->seat, event->time_msec, event->dx, event->dy);
 }
@@ -54,6 +233,9 @@ handle_pointer_swipe_end(struct wl_listener *listener, void *data)
 {
 	struct seat *seat = wl_container_of(listener, seat, swipe_end);
 	struct wlr_pointer_swipe_end_event *event = data;
+	if (gesture_end(seat, LAB_GESTURE_SWIPE)) {
+		return;
+	}
 	wlr_pointer_gestures_v1_send_swipe_end(seat->pointer_gestures,
 		seat->seat, event->time_msec, event->cancelled);
 }
@@ -197,16 +197,33 @@ update_popup_position(struct input_method_relay *relay)
 		cursor_rect = (struct wlr_box){0};
 	}
 
-	struct output *output =
-		output_nearest_to(server, cursor_rect.x, cursor_rect.y);
-	if (!output_is_usable(output)) {
-		wlr_log(WLR_ERROR,
-			"Cannot position IME popup (unusable output)");
+	int width = relay->popup_surface->surface->current.width;
+	int height = relay->popup_surface->surface->current.height;
+
+	/* Make sure IME popup is always on top, above layer-shell surfaces */
+	wlr_scene_node_raise_to_top(&relay->popup_tree->node);
+
+	if (relay->popup_placement.valid
+			&& wlr_box_equal(&cursor_rect,
+				&relay->popup_placement.cursor_rect)
+			&& width == relay->popup_placement.width
+			&& height == relay->popup_placement.height) {
 		return;
 	}
-	struct wlr_box output_box;
-	wlr_output_layout_get_box(
-		server->output_layout, output->wlr_output, &output_box);
+
+	if (!relay->output_box_valid || !wlr_box_contains_point(
+			&relay->output_box, cursor_rect.x, cursor_rect.y)) {
+		struct output *output = output_nearest_to(server,
+			cursor_rect.x, cursor_rect.y);
+		if (!output_is_usable(output)) {
+			wlr_log(WLR_ERROR,
+				"Cannot position IME popup (unusable output)");
+			return;
+		}
+		wlr_output_layout_get_box(server->output_layout,
+			output->wlr_output, &relay->output_box);
+		relay->output_box_valid = true;
+	}
 
 	/* Use xdg-positioner utilities to position popup */
 	struct wlr_xdg_positioner_rules rules = {
@@ -214,8 +231,8 @@ update_popup_position(struct input_method_relay *relay)
 		.anchor = XDG_POSITIONER_ANCHOR_BOTTOM_LEFT,
 		.gravity = XDG_POSITIONER_GRAVITY_BOTTOM_RIGHT,
 		.size = {
-			.width = relay->popup_surface->surface->current.width,
-			.height = relay->popup_surface->surface->current.height,
+			.width = width,
+			.height = height,
 		},
 		.constraint_adjustment =
 			XDG_POSITIONER_CONSTRAINT_ADJUSTMENT_FLIP_Y
@@ -224,12 +241,16 @@ update_popup_position(struct input_method_relay *relay)
 
 	struct wlr_box popup_box;
 	wlr_xdg_positioner_rules_get_geometry(&rules, &popup_box);
-	wlr_xdg_positioner_rules_unconstrain_box(&rules, &output_box, &popup_box);
+	wlr_xdg_positioner_rules_unconstrain_box(&rules, &relay->output_box,
+		&popup_box);
 
 	wlr_scene_node_set_position(
 		&relay->popup_tree->node, popup_box.x, popup_box.y);
-	/* Make sure IME popup is always on top, above layer-shell surfaces */
-	wlr_scene_node_raise_to_top(&relay->popup_tree->node);
+
+	relay->popup_placement.valid = true;
+	relay->popup_placement.cursor_rect = cursor_rect;
+	relay->popup_placement.width = width;
+	relay->popup_placement.height = height;
 
 	wlr_input_popup_surface_v2_send_text_input_rectangle(
 		relay->popup_surface, &(struct wlr_box){
@@ -333,6 +354,7 @@ handle_popup_surface_destroy(struct wl_listener *listener, void *data)
 	wl_list_remove(&relay->popup_surface_commit.link);
 	relay->popup_surface = NULL;
 	relay->popup_tree = NULL;
+	relay->popup_placement.valid = false;
 }
 
 static void
@@ -364,6 +386,7 @@ handle_input_method_new_popup_surface(struct wl_listener *listener, void *data)
 	}
 
 	relay->popup_surface = data;
+	relay->popup_placement.valid = false;
 
 	wl_signal_add(&relay->popup_surface->events.destroy,
 		&relay->popup_surface_destroy);
@@ -418,6 +441,57 @@ handle_new_input_method(struct wl_listener *listener, void *data)
 	update_active_text_input(relay);
 }
 
+/* FNV-1a */
+static uint32_t
+hash_string(const char *s)
+{
+	uint32_t hash = 2166136261u;
+	for (; s && *s; s++) {
+		hash ^= (unsigned char)*s;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/*
+ * Remembers the state about to be sent to the input-method and returns
+ * false if it is the same as the one sent last time.
+ */
+static bool
+text_input_state_changed(struct text_input *text_input)
+{
+	struct wlr_text_input_v3 *input = text_input->input;
+	struct wlr_text_input_v3_state *current = &input->current;
+	uint32_t surrounding_hash = 0;
+	if (input->active_features
+			& WLR_TEXT_INPUT_V3_FEATURE_SURROUNDING_TEXT) {
+		surrounding_hash = hash_string(current->surrounding.text);
+	}
+
+	if (text_input->sent.valid
+			&& text_input->sent.features == input->active_features
+			&& text_input->sent.surrounding_hash == surrounding_hash
+			&& text_input->sent.cursor == current->surrounding.cursor
+			&& text_input->sent.anchor == current->surrounding.anchor
+			&& text_input->sent.text_change_cause
+				== current->text_change_cause
+			&& text_input->sent.hint == current->content_type.hint
+			&& text_input->sent.purpose
+				== current->content_type.purpose) {
+		return false;
+	}
+
+	text_input->sent.valid = true;
+	text_input->sent.features = input->active_features;
+	text_input->sent.surrounding_hash = surrounding_hash;
+	text_input->sent.cursor = current->surrounding.cursor;
+	text_input->sent.anchor = current->surrounding.anchor;
+	text_input->sent.text_change_cause = current->text_change_cause;
+	text_input->sent.hint = current->content_type.hint;
+	text_input->sent.purpose = current->content_type.purpose;
+	return true;
+}
+
 /* Conveys state from active text-input to input-method */
 static void
 send_state_to_input_method(struct input_method_relay *relay)
@@ -427,7 +501,14 @@ send_state_to_input_method(struct input_method_relay *relay)
 	struct wlr_input_method_v2 *input_method = relay->input_method;
 	struct wlr_text_input_v3 *input = relay->active_text_input->input;
 
-	/* TODO: only send each of those if they were modified */
+	/*
+	 * Text-inputs commit frequently while typing, often without any
+	 * change of the state relevant to the input-method.
+	 */
+	if (!text_input_state_changed(relay->active_text_input)) {
+		return;
+	}
+
 	if (input->active_features
 			& WLR_TEXT_INPUT_V3_FEATURE_SURROUNDING_TEXT) {
 		wlr_input_method_v2_send_surrounding_text(input_method,
@@ -452,6 +533,9 @@ handle_text_input_enable(struct wl_listener *listener, void *data)
 		wl_container_of(listener, text_input, enable);
 	struct input_method_relay *relay = text_input->relay;
 
+	/* The input-method is (re)activated and needs the full state */
+	text_input->sent.valid = false;
+
 	update_active_text_input(relay);
 	if (relay->active_text_input == text_input) {
 		update_popup_position(relay);
@@ -574,6 +658,13 @@ input_method_relay_finish(struct input_method_relay *relay)
 	free(relay);
 }
 
+void
+input_method_relay_output_layout_changed(struct input_method_relay *relay)
+{
+	relay->output_box_valid = false;
+	relay->popup_placement.valid = false;
+}
+
 void
 input_method_relay_set_focus(struct input_method_relay *relay,
 		struct wlr_surface *surface)
@@ -587,6 +678,8 @@ input_method_relay_set_focus(struct input_method_relay *relay,
 		wl_list_remove(&relay->focused_surface_destroy.link);
 	}
 	relay->focused_surface = surface;
+	relay->output_box_valid = false;
+	relay->popup_placement.valid = false;
 	if (surface) {
 		wl_signal_add(&surface->events.destroy,
 			&relay->focused_surface_destroy);
@@ -1,4 +1,5 @@
 // SPDX-License-Identifier: GPL-2.0-only
+#include <linux/input-event-codes.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -7,92 +8,118 @@
 #include <wlr/util/log.h>
 #include "input/key-state.h"
 
-#define MAX_PRESSED_KEYS (16)
+/*
+ * Key sets are bitsets indexed by keycode, so that adding, removing and
+ * looking up keys is O(1) and there is no limit on the number of keys
+ * held down at the same time (n-key-rollover keyboards).
+ */
+#define KEY_SET_WORD_BITS (64)
+#define KEY_SET_WORDS ((KEY_CNT + KEY_SET_WORD_BITS - 1) / KEY_SET_WORD_BITS)
 
-struct key_array {
-	uint32_t keys[MAX_PRESSED_KEYS];
+struct key_set {
+	uint64_t bits[KEY_SET_WORDS];
 	int nr_keys;
 };
 
-static struct key_array pressed, pressed_mods, bound, pressed_sent;
+static struct key_set pressed, pressed_mods, bound;
 
-static void
-report(struct key_array *array, const char *msg)
-{
-	static char *should_print;
-	static bool has_run;
+/* Compact list of pressed+sent keys, as expected by wlroots */
+static uint32_t pressed_sent[KEY_CNT];
+static int nr_pressed_sent;
 
-	if (!has_run) {
-		should_print = getenv("LABWC_DEBUG_KEY_STATE");
-		has_run = true;
-	}
-	if (!should_print) {
-		return;
-	}
-	printf("%s", msg);
-	for (int i = 0; i < array->nr_keys; ++i) {
-		printf("%d,", array->keys[i]);
+static bool
+key_present(struct key_set *set, uint32_t keycode)
+{
+	if (keycode >= KEY_CNT) {
+		return false;
 	}
-	printf("\n");
+	return set->bits[keycode / KEY_SET_WORD_BITS]
+		& (1ULL << (keycode % KEY_SET_WORD_BITS));
 }
 
-static bool
-key_present(struct key_array *array, uint32_t keycode)
+static void
+remove_key(struct key_set *set, uint32_t keycode)
 {
-	for (int i = 0; i < array->nr_keys; ++i) {
-		if (array->keys[i] == keycode) {
-			return true;
-		}
+	if (key_present(set, keycode)) {
+		set->bits[keycode / KEY_SET_WORD_BITS] &=
+			~(1ULL << (keycode % KEY_SET_WORD_BITS));
+		--set->nr_keys;
 	}
-	return false;
 }
 
 static void
-remove_key(struct key_array *array, uint32_t keycode)
+add_key(struct key_set *set, uint32_t keycode)
 {
-	bool shifting = false;
+	if (keycode >= KEY_CNT) {
+		wlr_log(WLR_DEBUG, "ignoring out of range keycode %u", keycode);
+		return;
+	}
+	if (!key_present(set, keycode)) {
+		set->bits[keycode / KEY_SET_WORD_BITS] |=
+			1ULL << (keycode % KEY_SET_WORD_BITS);
+		++set->nr_keys;
+	}
+}
 
-	for (int i = 0; i < MAX_PRESSED_KEYS; ++i) {
-		if (array->keys[i] == keycode) {
-			--array->nr_keys;
-			shifting = true;
+/* Appends the keys of @set minus those of @exclude to @keys in keycode order */
+static int
+key_set_to_array(struct key_set *set, struct key_set *exclude, uint32_t *keys)
+{
+	int nr_keys = 0;
+	for (int i = 0; i < KEY_SET_WORDS; i++) {
+		uint64_t word = set->bits[i];
+		if (exclude) {
+			word &= ~exclude->bits[i];
 		}
-		if (shifting) {
-			array->keys[i] = i < MAX_PRESSED_KEYS - 1
-				? array->keys[i + 1] : 0;
+		for (int bit = 0; word; bit++, word >>= 1) {
+			if (word & 1) {
+				keys[nr_keys++] = i * KEY_SET_WORD_BITS + bit;
+			}
 		}
 	}
+	return nr_keys;
 }
 
 static void
-add_key(struct key_array *array, uint32_t keycode)
+report(struct key_set *set, struct key_set *exclude, const char *msg)
 {
-	if (!key_present(array, keycode) && array->nr_keys < MAX_PRESSED_KEYS) {
-		array->keys[array->nr_keys++] = keycode;
+	static char *should_print;
+	static bool has_run;
+
+	if (!has_run) {
+		should_print = getenv("LABWC_DEBUG_KEY_STATE");
+		has_run = true;
+	}
+	if (!should_print) {
+		return;
 	}
+	uint32_t keys[KEY_CNT];
+	int nr_keys = key_set_to_array(set, exclude, keys);
+	printf("%s", msg);
+	for (int i = 0; i < nr_keys; ++i) {
+		printf("%d,", keys[i]);
+	}
+	printf("\n");
 }
 
 uint32_t *
 key_state_pressed_sent_keycodes(void)
 {
-	report(&pressed, "before - pressed:");
-	report(&bound, "before - bound:");
+	report(&pressed, NULL, "before - pressed:");
+	report(&bound, NULL, "before - bound:");
 
 	/* pressed_sent = pressed - bound */
-	pressed_sent = pressed;
-	for (int i = 0; i < bound.nr_keys; ++i) {
-		remove_key(&pressed_sent, bound.keys[i]);
-	}
+	nr_pressed_sent = key_set_to_array(&pressed, &bound, pressed_sent);
 
-	report(&pressed_sent, "after - pressed_sent:");
+	report(&pressed, &bound, "after - pressed_sent:");
 
-	return pressed_sent.keys;
+	return pressed_sent;
 }
 
 int
 key_state_nr_pressed_sent_keycodes(void)
 {
-	return pressed_sent.nr_keys;
+	return nr_pressed_sent;
 }
 
 void
@@ -119,8 +146,10 @@ key_state_store_pressed_key_as_bound(uint32_t keycode)
 	 * a modifier key that was part of a keybinding (e.g. Firefox
 	 * displays its menu bar for a lone Alt press + release).
 	 */
-	for (int i = 0; i < pressed_mods.nr_keys; ++i) {
-		add_key(&bound, pressed_mods.keys[i]);
+	uint32_t mods[KEY_CNT];
+	int nr_mods = key_set_to_array(&pressed_mods, NULL, mods);
+	for (int i = 0; i < nr_mods; ++i) {
+		add_key(&bound, mods[i]);
 	}
 }
 
@@ -2,17 +2,25 @@
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wlr/backend/multi.h>
 #include <wlr/backend/session.h>
 #include <wlr/interfaces/wlr_keyboard.h>
 #include "action.h"
+#include "common/macros.h"
+#include "common/mem.h"
+#include "common/time-helpers.h"
+#include "common/timers.h"
 #include "idle.h"
+#include "input/cursor.h"
 #include "input/keyboard.h"
 #include "input/key-state.h"
 #include "labwc.h"
+#include "latency-trace.h"
 #include "menu/menu.h"
 #include "osd.h"
 #include "regions.h"
+#include "trace.h"
 #include "view.h"
 #include "workspaces.h"
 
@@ -46,14 +54,11 @@ change_vt(struct server *server, unsigned int vt)
 bool
 keyboard_any_modifiers_pressed(struct wlr_keyboard *keyboard)
 {
-	xkb_mod_index_t i;
-	for (i = 0; i < xkb_keymap_num_mods(keyboard->keymap); i++) {
-		if (xkb_state_mod_index_is_active(keyboard->xkb_state,
-				i, XKB_STATE_MODS_DEPRESSED)) {
-			return true;
-		}
-	}
-	return false;
+	/*
+	 * wlroots keeps the serialized depressed modifiers up to date
+	 * before emitting the key and modifiers events
+	 */
+	return keyboard->modifiers.depressed;
 }
 
 static void
@@ -78,6 +83,8 @@ keyboard_modifiers_notify(struct wl_listener *listener, void *data)
 	struct server *server = seat->server;
 	struct wlr_keyboard *wlr_keyboard = keyboard->wlr_keyboard;
 
+	cursor_flush_motion(seat);
+
 	if (server->input_mode == LAB_INPUT_STATE_MOVE) {
 		/* Any change to the modifier state re-enable region snap */
 		seat->region_prevent_snap = false;
@@ -111,32 +118,27 @@ static struct keybind *
 match_keybinding_for_sym(struct server *server, uint32_t modifiers,
 		xkb_keysym_t sym, xkb_keycode_t xkb_keycode)
 {
-	struct keybind *keybind;
-	wl_list_for_each(keybind, &rc.keybinds, link) {
-		if (modifiers ^ keybind->modifiers) {
-			continue;
-		}
+	struct wl_array *keybinds;
+	if (sym == XKB_KEY_NoSymbol) {
+		/* Use keycodes */
+		keybinds = keybind_lookup_keycode(modifiers, xkb_keycode);
+	} else {
+		/* Use syms */
+		keybinds = keybind_lookup_keysym(modifiers, sym);
+	}
+	if (!keybinds) {
+		return NULL;
+	}
+
+	struct keybind **keybind;
+	wl_array_for_each(keybind, keybinds) {
 		if (server->seat.nr_inhibited_keybind_views
 				&& server->active_view
 				&& server->active_view->inhibits_keybinds
-				&& !actions_contain_toggle_keybinds(&keybind->actions)) {
+				&& !actions_contain_toggle_keybinds(&(*keybind)->actions)) {
 			continue;
 		}
-		if (sym == XKB_KEY_NoSymbol) {
-			/* Use keycodes */
-			for (size_t i = 0; i < keybind->keycodes_len; i++) {
-				if (keybind->keycodes[i] == xkb_keycode) {
-					return keybind;
-				}
-			}
-		} else {
-			/* Use syms */
-			for (size_t i = 0; i < keybind->keysyms_len; i++) {
-				if (xkb_keysym_to_lower(sym) == keybind->keysyms[i]) {
-					return keybind;
-				}
-			}
-		}
+		return *keybind;
 	}
 	return NULL;
 }
@@ -349,11 +351,27 @@ handle_menu_keys(struct server *server, struct keysyms *syms)
 			menu_call_selected_actions(server);
 			break;
 		case XKB_KEY_Escape:
+			if (menu_search_clear(server)) {
+				break;
+			}
 			menu_close_root(server);
 			cursor_update_focus(server);
 			break;
-		default:
-			continue;
+		case XKB_KEY_BackSpace:
+			menu_search_delete(server);
+			break;
+		default: {
+			/* Printable characters start or refine a search */
+			char text[8];
+			uint32_t codepoint = xkb_keysym_to_utf32(syms->syms[i]);
+			if (codepoint < 0x20 || codepoint == 0x7f
+					|| xkb_keysym_to_utf8(syms->syms[i], text,
+						sizeof(text)) <= 0) {
+				continue;
+			}
+			menu_search_add(server, text);
+			break;
+		}
 		}
 		break;
 	}
@@ -472,9 +490,23 @@ handle_keybind_repeat(void *data)
 	};
 
 	handle_compositor_keybindings(keyboard, &event);
-	int next_repeat_ms = 1000 / keyboard->keybind_repeat_rate;
-	wl_event_source_timer_update(keyboard->keybind_repeat,
-		next_repeat_ms);
+	/* The keybind may have cancelled the repeat */
+	if (!keyboard->keybind_repeat) {
+		return 0;
+	}
+
+	/*
+	 * Schedule the next repeat relative to the start of the repeat
+	 * rather than to now. That way slow actions or a busy main loop
+	 * do not make the rate drift, and repeats which were missed in
+	 * the meantime are coalesced into the one just run instead of
+	 * being replayed in a burst.
+	 */
+	int64_t period = NSEC_PER_SEC / keyboard->keybind_repeat_rate;
+	int64_t elapsed = MAX(time_now_nsec() - keyboard->keybind_repeat_start, 0);
+	int64_t next = (elapsed / period + 1) * period - elapsed;
+	int next_repeat_ms = (next + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC;
+	timers_update(keyboard->keybind_repeat, MAX(next_repeat_ms, 1));
 
 	return 0; /* ignored per wl_event_loop docs */
 }
@@ -490,9 +522,11 @@ start_keybind_repeat(struct server *server, struct keyboard *keyboard,
 			&& wlr_keyboard->repeat_info.delay > 0) {
 		keyboard->keybind_repeat_keycode = event->keycode;
 		keyboard->keybind_repeat_rate = wlr_keyboard->repeat_info.rate;
-		keyboard->keybind_repeat = wl_event_loop_add_timer(
+		keyboard->keybind_repeat_start = time_now_nsec()
+			+ wlr_keyboard->repeat_info.delay * NSEC_PER_MSEC;
+		keyboard->keybind_repeat = timers_add(
 			server->wl_event_loop, handle_keybind_repeat, keyboard);
-		wl_event_source_timer_update(keyboard->keybind_repeat,
+		timers_update(keyboard->keybind_repeat,
 			wlr_keyboard->repeat_info.delay);
 	}
 }
@@ -501,7 +535,7 @@ void
 keyboard_cancel_keybind_repeat(struct keyboard *keyboard)
 {
 	if (keyboard->keybind_repeat) {
-		wl_event_source_remove(keyboard->keybind_repeat);
+		timers_remove(keyboard->keybind_repeat);
 		keyboard->keybind_repeat = NULL;
 	}
 }
@@ -515,6 +549,13 @@ keyboard_key_notify(struct wl_listener *listener, void *data)
 	struct wlr_keyboard_key_event *event = data;
 	struct wlr_seat *wlr_seat = seat->seat;
 	idle_manager_notify_activity(seat->seat);
+	trace_instant("key", event->state == WL_KEYBOARD_KEY_STATE_PRESSED
+		? "pressed" : "released");
+	input_latency_event(&seat->input_latency,
+		wlr_seat->keyboard_state.focused_surface, event->time_msec);
+
+	/* Keybinds and focus changes act on the current pointer focus */
+	cursor_flush_motion(seat);
 
 	/* any new press/release cancels current keybind repeat */
 	keyboard_cancel_keybind_repeat(keyboard);
@@ -537,6 +578,9 @@ keyboard_key_notify(struct wl_listener *listener, void *data)
 	}
 }
 
+LATENCY_TRACE_LISTENER(keyboard_key_notify)
+LATENCY_TRACE_LISTENER(keyboard_modifiers_notify)
+
 void
 keyboard_set_numlock(struct wlr_keyboard *keyboard)
 {
@@ -569,6 +613,11 @@ keyboard_update_layout(struct seat *seat, xkb_layout_index_t layout)
 {
 	assert(seat);
 
+	/* All members follow the group, so this is the common early exit */
+	if (seat->keyboard_group->keyboard.modifiers.group == layout) {
+		return;
+	}
+
 	struct input *input;
 	struct keyboard *keyboard;
 	struct wlr_keyboard *kb = NULL;
@@ -599,6 +648,25 @@ keyboard_update_layout(struct seat *seat, xkb_layout_index_t layout)
 		kb->modifiers.latched, kb->modifiers.locked, layout);
 }
 
+void
+keyboard_save_layout(struct seat *seat, struct view *view)
+{
+	view->keyboard_layout.keymap_generation = seat->keymap_generation;
+	view->keyboard_layout.group =
+		seat->keyboard_group->keyboard.modifiers.group;
+}
+
+void
+keyboard_restore_layout(struct seat *seat, struct view *view)
+{
+	/* Groups saved for an earlier keymap fall back to the first one */
+	xkb_layout_index_t group = 0;
+	if (view->keyboard_layout.keymap_generation == seat->keymap_generation) {
+		group = view->keyboard_layout.group;
+	}
+	keyboard_update_layout(seat, group);
+}
+
 static void
 reset_window_keyboard_layout_groups(struct server *server)
 {
@@ -609,18 +677,131 @@ reset_window_keyboard_layout_groups(struct server *server)
 	/*
 	 * Technically it would be possible to reconcile previous group indices
 	 * to new group ones if particular layouts exist in both old and new,
-	 * but let's keep it simple for now and just reset them all.
+	 * but let's keep it simple for now and just reset them all. Views
+	 * notice lazily when they are activated again.
 	 */
-	struct view *view;
-	for_each_view(view, &server->views, LAB_VIEW_CRITERIA_NONE) {
-		view->keyboard_layout = 0;
-	}
+	server->seat.keymap_generation++;
 
 	struct view *active_view = server->active_view;
 	if (!active_view) {
 		return;
 	}
-	keyboard_update_layout(&server->seat, active_view->keyboard_layout);
+	keyboard_restore_layout(&server->seat, active_view);
+}
+
+/*
+ * Compiling a keymap takes tens of milliseconds. New keyboards and every
+ * reconfigure ask for a keymap again, usually for unchanged rule names, so
+ * the compiled keymaps are kept along with a single xkb_context.
+ */
+#define KEYMAP_CACHE_SIZE (4)
+
+static const char *const keymap_env_names[] = {
+	"XKB_DEFAULT_RULES",
+	"XKB_DEFAULT_MODEL",
+	"XKB_DEFAULT_LAYOUT",
+	"XKB_DEFAULT_VARIANT",
+	"XKB_DEFAULT_OPTIONS",
+};
+
+struct keymap_cache_entry {
+	/* Values of keymap_env_names[] at compile time, NULL if unset */
+	char *names[ARRAY_SIZE(keymap_env_names)];
+	struct xkb_keymap *keymap;
+	struct wl_list link; /* keymap_cache.entries */
+};
+
+static struct {
+	struct xkb_context *context;
+	struct wl_list entries; /* most recently used first */
+	int nr_entries;
+} keymap_cache;
+
+static void
+keymap_cache_entry_destroy(struct keymap_cache_entry *entry)
+{
+	wl_list_remove(&entry->link);
+	for (size_t i = 0; i < ARRAY_SIZE(entry->names); i++) {
+		free(entry->names[i]);
+	}
+	xkb_keymap_unref(entry->keymap);
+	free(entry);
+	keymap_cache.nr_entries--;
+}
+
+static bool
+keymap_cache_entry_matches(struct keymap_cache_entry *entry)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(keymap_env_names); i++) {
+		const char *value = getenv(keymap_env_names[i]);
+		if (!value || !entry->names[i]) {
+			if (value != entry->names[i]) {
+				return false;
+			}
+		} else if (strcmp(value, entry->names[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Returns a keymap owned by the cache or NULL if compiling failed */
+static struct xkb_keymap *
+keymap_cache_get(void)
+{
+	if (!keymap_cache.context) {
+		keymap_cache.context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+		if (!keymap_cache.context) {
+			return NULL;
+		}
+		wl_list_init(&keymap_cache.entries);
+	}
+
+	struct keymap_cache_entry *entry;
+	wl_list_for_each(entry, &keymap_cache.entries, link) {
+		if (keymap_cache_entry_matches(entry)) {
+			/* Move to front */
+			wl_list_remove(&entry->link);
+			wl_list_insert(&keymap_cache.entries, &entry->link);
+			return entry->keymap;
+		}
+	}
+
+	/* Empty rule names make xkbcommon use the XKB_DEFAULT_* variables */
+	struct xkb_rule_names rules = { 0 };
+	struct xkb_keymap *keymap = xkb_map_new_from_names(
+		keymap_cache.context, &rules, XKB_KEYMAP_COMPILE_NO_FLAGS);
+	if (!keymap) {
+		return NULL;
+	}
+
+	if (keymap_cache.nr_entries >= KEYMAP_CACHE_SIZE) {
+		entry = wl_container_of(keymap_cache.entries.prev, entry, link);
+		keymap_cache_entry_destroy(entry);
+	}
+	entry = znew(*entry);
+	for (size_t i = 0; i < ARRAY_SIZE(keymap_env_names); i++) {
+		const char *value = getenv(keymap_env_names[i]);
+		entry->names[i] = value ? xstrdup(value) : NULL;
+	}
+	entry->keymap = keymap;
+	wl_list_insert(&keymap_cache.entries, &entry->link);
+	keymap_cache.nr_entries++;
+	return keymap;
+}
+
+static void
+keymap_cache_finish(void)
+{
+	if (!keymap_cache.context) {
+		return;
+	}
+	struct keymap_cache_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &keymap_cache.entries, link) {
+		keymap_cache_entry_destroy(entry);
+	}
+	xkb_context_unref(keymap_cache.context);
+	keymap_cache.context = NULL;
 }
 
 /*
@@ -632,16 +813,13 @@ set_layout(struct server *server, struct wlr_keyboard *kb)
 {
 	static bool fallback_mode;
 
-	struct xkb_rule_names rules = { 0 };
-	struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
-	struct xkb_keymap *keymap = xkb_map_new_from_names(context, &rules,
-		XKB_KEYMAP_COMPILE_NO_FLAGS);
+	struct xkb_keymap *keymap = keymap_cache_get();
 	if (keymap) {
-		if (!wlr_keyboard_keymaps_match(kb->keymap, keymap)) {
+		if (kb->keymap != keymap
+				&& !wlr_keyboard_keymaps_match(kb->keymap, keymap)) {
 			wlr_keyboard_set_keymap(kb, keymap);
 			reset_window_keyboard_layout_groups(server);
 		}
-		xkb_keymap_unref(keymap);
 	} else {
 		wlr_log(WLR_ERROR, "failed to create xkb keymap for layout '%s'",
 			getenv("XKB_DEFAULT_LAYOUT"));
@@ -652,7 +830,6 @@ set_layout(struct server *server, struct wlr_keyboard *kb)
 			set_layout(server, kb);
 		}
 	}
-	xkb_context_unref(context);
 }
 
 void
@@ -681,9 +858,9 @@ keyboard_setup_handlers(struct keyboard *keyboard)
 {
 	struct wlr_keyboard *wlr_kb = keyboard->wlr_keyboard;
 
-	keyboard->key.notify = keyboard_key_notify;
+	keyboard->key.notify = keyboard_key_notify_traced;
 	wl_signal_add(&wlr_kb->events.key, &keyboard->key);
-	keyboard->modifier.notify = keyboard_modifiers_notify;
+	keyboard->modifier.notify = keyboard_modifiers_notify_traced;
 	wl_signal_add(&wlr_kb->events.modifiers, &keyboard->modifier);
 }
 
@@ -698,4 +875,5 @@ keyboard_group_finish(struct seat *seat)
 		wlr_keyboard_group_destroy(seat->keyboard_group);
 		seat->keyboard_group = NULL;
 	}
+	keymap_cache_finish();
 }
@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <stdio.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_output.h>
+#include "common/macros.h"
+#include "common/time-helpers.h"
+#include "input/latency.h"
+
+/*
+ * Input handled by labwc itself, like keybinds, may never lead to a client
+ * commit. Forget about input which was not shown within this time rather
+ * than recording it once the surface happens to commit later.
+ */
+#define INPUT_LATENCY_MAX_NSEC (1000 * NSEC_PER_MSEC)
+
+static void
+set_surface(struct input_latency *latency, struct wlr_surface *surface)
+{
+	if (latency->surface == surface) {
+		return;
+	}
+	wl_list_remove(&latency->surface_commit.link);
+	wl_list_remove(&latency->surface_destroy.link);
+	wl_list_init(&latency->surface_commit.link);
+	wl_list_init(&latency->surface_destroy.link);
+	latency->surface = surface;
+	latency->surface_damaged = false;
+	if (surface) {
+		wl_signal_add(&surface->events.commit, &latency->surface_commit);
+		wl_signal_add(&surface->events.destroy,
+			&latency->surface_destroy);
+	}
+}
+
+static void
+reset(struct input_latency *latency)
+{
+	latency->input_nsec = 0;
+	set_surface(latency, NULL);
+}
+
+static void
+handle_surface_commit(struct wl_listener *listener, void *data)
+{
+	struct input_latency *latency =
+		wl_container_of(listener, latency, surface_commit);
+	if (pixman_region32_not_empty(&latency->surface->buffer_damage)) {
+		latency->surface_damaged = true;
+	}
+}
+
+static void
+handle_surface_destroy(struct wl_listener *listener, void *data)
+{
+	struct input_latency *latency =
+		wl_container_of(listener, latency, surface_destroy);
+	reset(latency);
+}
+
+void
+input_latency_init(struct input_latency *latency)
+{
+	*latency = (struct input_latency){ 0 };
+	latency->surface_commit.notify = handle_surface_commit;
+	latency->surface_destroy.notify = handle_surface_destroy;
+	wl_list_init(&latency->surface_commit.link);
+	wl_list_init(&latency->surface_destroy.link);
+}
+
+void
+input_latency_finish(struct input_latency *latency)
+{
+	reset(latency);
+}
+
+/* Event timestamps are CLOCK_MONOTONIC milliseconds truncated to 32 bits */
+static int64_t
+event_time_to_nsec(uint32_t time_msec, int64_t now)
+{
+	uint32_t age_msec = (uint32_t)(now / NSEC_PER_MSEC) - time_msec;
+	if ((int64_t)age_msec * NSEC_PER_MSEC > INPUT_LATENCY_MAX_NSEC) {
+		/* Some other clock, fall back to the time of handling */
+		return now;
+	}
+	return now - (int64_t)age_msec * NSEC_PER_MSEC;
+}
+
+void
+input_latency_event(struct input_latency *latency,
+		struct wlr_surface *surface, uint32_t time_msec)
+{
+	int64_t now = time_now_nsec();
+	if (latency->input_nsec
+			&& now - latency->input_nsec > INPUT_LATENCY_MAX_NSEC) {
+		reset(latency);
+	}
+	if (!surface) {
+		return;
+	}
+	if (latency->input_nsec && latency->surface == surface) {
+		/* Still waiting for the earlier input to be shown */
+		return;
+	}
+	latency->input_nsec = event_time_to_nsec(time_msec, now);
+	set_surface(latency, surface);
+}
+
+static bool
+surface_on_output(struct wlr_surface *surface, struct wlr_output *output)
+{
+	struct wlr_surface_output *surface_output;
+	wl_list_for_each(surface_output, &surface->current_outputs, link) {
+		if (surface_output->output == output) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void
+input_latency_output_commit(struct input_latency *latency,
+		struct wlr_output *output, int64_t committed_at)
+{
+	if (!latency->input_nsec || !latency->surface_damaged
+			|| !surface_on_output(latency->surface, output)) {
+		return;
+	}
+	int64_t duration = committed_at - latency->input_nsec;
+	reset(latency);
+	if (duration < 0 || duration > INPUT_LATENCY_MAX_NSEC) {
+		return;
+	}
+
+	size_t bucket = 0;
+	for (int64_t msec = duration / NSEC_PER_MSEC; msec; msec >>= 1) {
+		bucket++;
+	}
+	bucket = MIN(bucket, (size_t)INPUT_LATENCY_NR_BUCKETS - 1);
+	latency->buckets[bucket]++;
+	latency->nr_samples++;
+	latency->total_nsec += duration;
+	latency->max_nsec = MAX(latency->max_nsec, duration);
+}
+
+void
+input_latency_print(const struct input_latency *latency, const char *name)
+{
+	printf("%s: %lu input-to-commit samples", name,
+		(unsigned long)latency->nr_samples);
+	if (!latency->nr_samples) {
+		printf("\n");
+		return;
+	}
+	printf(", avg %.3f ms, max %.3f ms\n",
+		(double)latency->total_nsec / latency->nr_samples
+			/ NSEC_PER_MSEC,
+		(double)latency->max_nsec / NSEC_PER_MSEC);
+	for (size_t i = 0; i < INPUT_LATENCY_NR_BUCKETS; i++) {
+		if (i == 0) {
+			printf("   %12s", "< 1 ms");
+		} else if (i == INPUT_LATENCY_NR_BUCKETS - 1) {
+			printf("   >= %6lu ms", 1UL << (i - 1));
+		} else {
+			printf("   %4lu-%4lu ms", 1UL << (i - 1), 1UL << i);
+		}
+		printf(" %10lu\n", (unsigned long)latency->buckets[i]);
+	}
+}
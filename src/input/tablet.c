@@ -10,6 +10,7 @@
 #include "config/rcxml.h"
 #include "input/cursor.h"
 #include "input/tablet.h"
+#include "labwc.h"
 
 static void
 adjust_for_tablet_area(double tablet_width, double tablet_height,
@@ -63,6 +64,70 @@ adjust_for_rotation(enum rotation rotation, double *x, double *y)
 	}
 }
 
+static void
+transform_point(struct drawing_tablet *tablet, double *x, double *y)
+{
+	adjust_for_tablet_area(tablet->tablet->width_mm,
+		tablet->tablet->height_mm, rc.tablet.box, x, y);
+	adjust_for_rotation(rc.tablet.rotation, x, y);
+}
+
+/*
+ * Both the tablet area and the rotation are affine transformations, so
+ * they are combined into a single matrix by transforming the origin and
+ * the unit vectors once.
+ */
+static void
+update_transform(struct drawing_tablet *tablet)
+{
+	double ox = 0, oy = 0;
+	double xx = 1, xy = 0;
+	double yx = 0, yy = 1;
+	transform_point(tablet, &ox, &oy);
+	transform_point(tablet, &xx, &xy);
+	transform_point(tablet, &yx, &yy);
+
+	tablet->transform[0] = xx - ox;
+	tablet->transform[1] = yx - ox;
+	tablet->transform[2] = ox;
+	tablet->transform[3] = xy - oy;
+	tablet->transform[4] = yy - oy;
+	tablet->transform[5] = oy;
+}
+
+static void
+flush_motion(struct drawing_tablet *tablet)
+{
+	if (tablet->motion_idle) {
+		wl_event_source_remove(tablet->motion_idle);
+		tablet->motion_idle = NULL;
+	}
+	if (!tablet->motion_pending) {
+		return;
+	}
+	tablet->motion_pending = false;
+
+	const double *m = tablet->transform;
+	double x = m[0] * tablet->x + m[1] * tablet->y + m[2];
+	double y = m[3] * tablet->x + m[4] * tablet->y + m[5];
+	cursor_emulate_move_absolute(tablet->seat, &tablet->tablet->base, x, y,
+		tablet->motion_time_msec);
+}
+
+static void
+handle_motion_idle(void *data)
+{
+	struct drawing_tablet *tablet = data;
+	/* Idle sources are removed after being dispatched */
+	tablet->motion_idle = NULL;
+	flush_motion(tablet);
+}
+
+/*
+ * Tablets report at a high rate, so the cursor is only moved once all
+ * axis events that arrived during the current event loop iteration have
+ * been processed.
+ */
 static void
 handle_axis(struct wl_listener *listener, void *data)
 {
@@ -75,13 +140,13 @@ handle_axis(struct wl_listener *listener, void *data)
 		if (ev->updated_axes & WLR_TABLET_TOOL_AXIS_Y) {
 			tablet->y = ev->y;
 		}
-
-		double x = tablet->x;
-		double y = tablet->y;
-		adjust_for_tablet_area(tablet->tablet->width_mm, tablet->tablet->height_mm,
-			rc.tablet.box, &x, &y);
-		adjust_for_rotation(rc.tablet.rotation, &x, &y);
-		cursor_emulate_move_absolute(tablet->seat, &ev->tablet->base, x, y, ev->time_msec);
+		tablet->motion_pending = true;
+		tablet->motion_time_msec = ev->time_msec;
+		if (!tablet->motion_idle) {
+			tablet->motion_idle = wl_event_loop_add_idle(
+				tablet->seat->server->wl_event_loop,
+				handle_motion_idle, tablet);
+		}
 	}
 	// Ignore other events
 }
@@ -91,6 +156,7 @@ handle_tip(struct wl_listener *listener, void *data)
 {
 	struct wlr_tablet_tool_tip_event *ev = data;
 	struct drawing_tablet *tablet = ev->tablet->data;
+	flush_motion(tablet);
 
 	uint32_t button = tablet_get_mapped_button(BTN_TOOL_PEN);
 	if (!button) {
@@ -110,6 +176,7 @@ handle_button(struct wl_listener *listener, void *data)
 {
 	struct wlr_tablet_tool_button_event *ev = data;
 	struct drawing_tablet *tablet = ev->tablet->data;
+	flush_motion(tablet);
 
 	uint32_t button = tablet_get_mapped_button(ev->button);
 	if (!button) {
@@ -124,6 +191,9 @@ handle_destroy(struct wl_listener *listener, void *data)
 {
 	struct drawing_tablet *tablet =
 		wl_container_of(listener, tablet, handlers.destroy);
+	if (tablet->motion_idle) {
+		wl_event_source_remove(tablet->motion_idle);
+	}
 	free(tablet);
 }
 
@@ -137,6 +207,7 @@ tablet_init(struct seat *seat, struct wlr_input_device *wlr_device)
 	tablet->tablet->data = tablet;
 	tablet->x = 0.0;
 	tablet->y = 0.0;
+	update_transform(tablet);
 	wlr_log(WLR_INFO, "tablet dimensions: %.2fmm x %.2fmm",
 		tablet->tablet->width_mm, tablet->tablet->height_mm);
 	CONNECT_SIGNAL(tablet->tablet, &tablet->handlers, axis);
@@ -144,3 +215,11 @@ tablet_init(struct seat *seat, struct wlr_input_device *wlr_device)
 	CONNECT_SIGNAL(tablet->tablet, &tablet->handlers, button);
 	CONNECT_SIGNAL(wlr_device, &tablet->handlers, destroy);
 }
+
+void
+tablet_reconfigure(struct wlr_input_device *wlr_device)
+{
+	struct drawing_tablet *tablet =
+		wlr_tablet_from_input_device(wlr_device)->data;
+	update_transform(tablet);
+}
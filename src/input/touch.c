@@ -18,6 +18,12 @@ struct touch_point {
 	uint32_t y_offset;
 	struct wlr_surface *surface;
 	struct wl_list link; /* seat.touch_points */
+
+	/* Latest motion since the last touch frame, see touch_frame() */
+	bool motion_pending;
+	struct wlr_touch *touch;
+	double x, y;
+	uint32_t time_msec;
 };
 
 static struct wlr_surface*
@@ -45,6 +51,38 @@ touch_get_coords(struct seat *seat, struct wlr_touch *touch, double x, double y,
 	return surface;
 }
 
+static void
+touch_point_flush_motion(struct seat *seat, struct touch_point *touch_point)
+{
+	if (!touch_point->motion_pending) {
+		return;
+	}
+	touch_point->motion_pending = false;
+
+	if (touch_point->surface) {
+		/* Convert coordinates: first [0, 1] => layout */
+		double lx, ly;
+		wlr_cursor_absolute_to_layout_coords(seat->cursor,
+			&touch_point->touch->base, touch_point->x,
+			touch_point->y, &lx, &ly);
+
+		/* Apply offsets to get surface coords before reporting event */
+		double sx = lx - touch_point->x_offset;
+		double sy = ly - touch_point->y_offset;
+
+		wlr_seat_touch_notify_motion(seat->seat, touch_point->time_msec,
+			touch_point->touch_id, sx, sy);
+	} else {
+		cursor_emulate_move_absolute(seat, &touch_point->touch->base,
+			touch_point->x, touch_point->y, touch_point->time_msec);
+	}
+}
+
+/*
+ * Motion events are only recorded here and forwarded by touch_frame(),
+ * so that several motions of the same finger within one frame result in
+ * a single event and, for emulated pointer input, a single hit test.
+ */
 static void
 touch_motion(struct wl_listener *listener, void *data)
 {
@@ -52,26 +90,14 @@ touch_motion(struct wl_listener *listener, void *data)
 	struct wlr_touch_motion_event *event = data;
 	idle_manager_notify_activity(seat->seat);
 
-	/* Find existing touch point to determine initial offsets to subtract */
 	struct touch_point *touch_point;
 	wl_list_for_each(touch_point, &seat->touch_points, link) {
 		if (touch_point->touch_id == event->touch_id) {
-			if (touch_point->surface) {
-				/* Convert coordinates: first [0, 1] => layout */
-				double lx, ly;
-				wlr_cursor_absolute_to_layout_coords(seat->cursor,
-					&event->touch->base, event->x, event->y, &lx, &ly);
-
-				/* Apply offsets to get surface coords before reporting event */
-				double sx = lx - touch_point->x_offset;
-				double sy = ly - touch_point->y_offset;
-
-				wlr_seat_touch_notify_motion(seat->seat, event->time_msec,
-					event->touch_id, sx, sy);
-			} else {
-				cursor_emulate_move_absolute(seat, &event->touch->base,
-					event->x, event->y, event->time_msec);
-			}
+			touch_point->motion_pending = true;
+			touch_point->touch = event->touch;
+			touch_point->x = event->x;
+			touch_point->y = event->y;
+			touch_point->time_msec = event->time_msec;
 			return;
 		}
 	}
@@ -82,6 +108,10 @@ touch_frame(struct wl_listener *listener, void *data)
 {
 	struct seat *seat = wl_container_of(listener, seat, touch_frame);
 
+	struct touch_point *touch_point;
+	wl_list_for_each(touch_point, &seat->touch_points, link) {
+		touch_point_flush_motion(seat, touch_point);
+	}
 	wlr_seat_touch_notify_frame(seat->seat);
 }
 
@@ -142,6 +172,8 @@ touch_up(struct wl_listener *listener, void *data)
 	struct touch_point *touch_point, *tmp;
 	wl_list_for_each_safe(touch_point, tmp, &seat->touch_points, link) {
 		if (touch_point->touch_id == event->touch_id) {
+			/* Report where the finger was lifted */
+			touch_point_flush_motion(seat, touch_point);
 			if (touch_point->surface) {
 				wlr_seat_touch_notify_up(seat->seat, event->time_msec,
 					event->touch_id);
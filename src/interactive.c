@@ -1,10 +1,14 @@
 // SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include <string.h>
 #include "edges.h"
 #include "input/keyboard.h"
 #include "labwc.h"
 #include "regions.h"
+#include "resistance.h"
 #include "resize_indicator.h"
 #include "snap.h"
+#include "tiling.h"
 #include "view.h"
 #include "window-rules.h"
 
@@ -38,7 +42,8 @@ interactive_begin(struct view *view, enum input_mode mode, uint32_t edges)
 	}
 
 	/* Prevent moving/resizing fixed-position and panel-like views */
-	if (window_rules_get_property(view, "fixedPosition") == LAB_PROP_TRUE
+	if (window_rules_get_property(view,
+			LAB_RULE_PROP_FIXED_POSITION) == LAB_PROP_TRUE
 			|| view_has_strut_partial(view)) {
 		return;
 	}
@@ -122,6 +127,7 @@ interactive_begin(struct view *view, enum input_mode mode, uint32_t edges)
 	server->grab_y = seat->cursor->y;
 	server->grab_box = geometry;
 	server->resize_edges = edges;
+	server->grab_update_pending = false;
 	if (rc.resize_indicator) {
 		resize_indicator_show(view);
 	}
@@ -130,11 +136,177 @@ interactive_begin(struct view *view, enum input_mode mode, uint32_t edges)
 	}
 }
 
+static void
+move_grabbed_view(struct server *server)
+{
+	struct view *view = server->grabbed_view;
+	double dx = server->seat.cursor->x - server->grab_x;
+	double dy = server->seat.cursor->y - server->grab_y;
+
+	/* Move the grabbed view to the new position. */
+	dx += server->grab_box.x;
+	dy += server->grab_box.y;
+	resistance_move_apply(view, &dx, &dy);
+	view_move(view, dx, dy);
+
+	overlay_update(&server->seat);
+}
+
+static void
+resize_grabbed_view(struct server *server)
+{
+	double dx = server->seat.cursor->x - server->grab_x;
+	double dy = server->seat.cursor->y - server->grab_y;
+
+	struct view *view = server->grabbed_view;
+	struct wlr_box new_view_geo = view->current;
+
+	if (server->resize_edges & WLR_EDGE_TOP) {
+		/* Shift y to anchor bottom edge when resizing top */
+		new_view_geo.y = server->grab_box.y + dy;
+		new_view_geo.height = server->grab_box.height - dy;
+	} else if (server->resize_edges & WLR_EDGE_BOTTOM) {
+		new_view_geo.height = server->grab_box.height + dy;
+	}
+
+	if (server->resize_edges & WLR_EDGE_LEFT) {
+		/* Shift x to anchor right edge when resizing left */
+		new_view_geo.x = server->grab_box.x + dx;
+		new_view_geo.width = server->grab_box.width - dx;
+	} else if (server->resize_edges & WLR_EDGE_RIGHT) {
+		new_view_geo.width = server->grab_box.width + dx;
+	}
+
+	resistance_resize_apply(view, &new_view_geo);
+	view_adjust_size(view, &new_view_geo.width, &new_view_geo.height);
+
+	if (server->resize_edges & WLR_EDGE_TOP) {
+		/* After size adjustments, make sure to anchor bottom edge */
+		new_view_geo.y = server->grab_box.y +
+			server->grab_box.height - new_view_geo.height;
+	}
+
+	if (server->resize_edges & WLR_EDGE_LEFT) {
+		/* After size adjustments, make sure to anchor bottom right */
+		new_view_geo.x = server->grab_box.x +
+			server->grab_box.width - new_view_geo.width;
+	}
+
+	view_move_resize(view, new_view_geo);
+}
+
+static void
+update_grabbed_view(struct server *server)
+{
+	server->grab_update_pending = false;
+	if (!server->grabbed_view) {
+		return;
+	}
+	if (server->input_mode == LAB_INPUT_STATE_MOVE) {
+		move_grabbed_view(server);
+	} else if (server->input_mode == LAB_INPUT_STATE_RESIZE) {
+		resize_grabbed_view(server);
+	}
+}
+
+void
+interactive_schedule_update(struct server *server)
+{
+	/*
+	 * Pointers may report motion several times per refresh cycle and
+	 * each update repositions the view, its decorations and the
+	 * snapping overlay, or sends the client a configure. Only the last
+	 * position before a frame is ever shown.
+	 */
+	server->grab_update_pending = true;
+	struct output *output = output_nearest_to_cursor(server);
+	if (output_is_usable(output)) {
+		wlr_output_schedule_frame(output->wlr_output);
+	}
+}
+
+void
+interactive_flush_update(struct server *server)
+{
+	if (!server->grab_update_pending) {
+		return;
+	}
+
+	/*
+	 * Keep at most one configure outstanding while resizing. Fast
+	 * clients are not flooded with sizes they will never show, and
+	 * slow ones get the newest size as soon as they are ready rather
+	 * than working through a backlog behind the pointer.
+	 */
+	struct view *view = server->grabbed_view;
+	if (view && server->input_mode == LAB_INPUT_STATE_RESIZE
+			&& view->pending_configure_serial) {
+		return;
+	}
+
+	update_grabbed_view(server);
+}
+
+void
+interactive_configure_done(struct view *view)
+{
+	struct server *server = view->server;
+	if (server->grabbed_view == view && server->grab_update_pending) {
+		/* Send the resize held back, paced to the next frame */
+		interactive_schedule_update(server);
+	}
+}
+
+/*
+ * Moves check the snap edges on every cursor motion. The trigger strips
+ * and the neighbours of each output only change with the layout or the
+ * usable areas, so they are computed once per change rather than asking
+ * the output layout each time.
+ */
+static void
+update_snap_edges(struct output *output)
+{
+	struct server *server = output->server;
+	int range = rc.snap_edge_range;
+	if (output->snap_edges.generation == server->usable_area_generation
+			&& output->snap_edges.range == range) {
+		return;
+	}
+	output->snap_edges.generation = server->usable_area_generation;
+	output->snap_edges.range = range;
+
+	struct wlr_box usable = output->usable_area;
+	usable.x += output->layout_box.x;
+	usable.y += output->layout_box.y;
+	output->snap_edges.usable = usable;
+	output->snap_edges.left = usable.x + range;
+	output->snap_edges.right = usable.x + usable.width - range;
+	output->snap_edges.top = usable.y + range;
+	output->snap_edges.bottom = usable.y + usable.height - range;
+
+	/* As wlr_output_layout_adjacent_output(), regardless of the cursor */
+	bool *adjacent = output->snap_edges.adjacent;
+	memset(adjacent, 0, sizeof(output->snap_edges.adjacent));
+	struct wlr_box *ref = &output->layout_box;
+	struct output *other;
+	wl_list_for_each(other, &server->outputs, link) {
+		struct wlr_box *box = &other->layout_box;
+		if (other == output || !output_is_usable(other)
+				|| wlr_box_empty(box)) {
+			continue;
+		}
+		adjacent[VIEW_EDGE_LEFT] |= box->x + box->width <= ref->x;
+		adjacent[VIEW_EDGE_RIGHT] |= box->x >= ref->x + ref->width;
+		adjacent[VIEW_EDGE_UP] |= box->y + box->height <= ref->y;
+		adjacent[VIEW_EDGE_DOWN] |= box->y >= ref->y + ref->height;
+	}
+	adjacent[VIEW_EDGE_CENTER] = adjacent[VIEW_EDGE_UP];
+}
+
 enum view_edge
 edge_from_cursor(struct seat *seat, struct output **dest_output)
 {
-	int snap_range = rc.snap_edge_range;
-	if (!snap_range) {
+	if (!rc.snap_edge_range) {
 		return VIEW_EDGE_INVALID;
 	}
 
@@ -144,25 +316,21 @@ edge_from_cursor(struct seat *seat, struct output **dest_output)
 		return VIEW_EDGE_INVALID;
 	}
 	*dest_output = output;
+	update_snap_edges(output);
 
-	/* Translate into output local coordinates */
 	double cursor_x = seat->cursor->x;
 	double cursor_y = seat->cursor->y;
-	wlr_output_layout_output_coords(seat->server->output_layout,
-		output->wlr_output, &cursor_x, &cursor_y);
-
-	struct wlr_box *area = &output->usable_area;
-	if (cursor_x <= area->x + snap_range) {
+	if (cursor_x <= output->snap_edges.left) {
 		return VIEW_EDGE_LEFT;
-	} else if (cursor_x >= area->x + area->width - snap_range) {
+	} else if (cursor_x >= output->snap_edges.right) {
 		return VIEW_EDGE_RIGHT;
-	} else if (cursor_y <= area->y + snap_range) {
+	} else if (cursor_y <= output->snap_edges.top) {
 		if (rc.snap_top_maximize) {
 			return VIEW_EDGE_CENTER;
 		} else {
 			return VIEW_EDGE_UP;
 		}
-	} else if (cursor_y >= area->y + area->height - snap_range) {
+	} else if (cursor_y >= output->snap_edges.bottom) {
 		return VIEW_EDGE_DOWN;
 	} else {
 		/* Not close to any edge */
@@ -170,6 +338,43 @@ edge_from_cursor(struct seat *seat, struct output **dest_output)
 	}
 }
 
+bool
+edge_has_adjacent_output(struct output *output, enum view_edge edge)
+{
+	assert(edge > VIEW_EDGE_INVALID && edge <= VIEW_EDGE_CENTER);
+	update_snap_edges(output);
+	return output->snap_edges.adjacent[edge];
+}
+
+/* TODO: share logic with view_get_edge_snap_box() */
+struct wlr_box
+edge_get_snap_box(struct output *output, enum view_edge edge)
+{
+	update_snap_edges(output);
+	struct wlr_box box = output->snap_edges.usable;
+	switch (edge) {
+	case VIEW_EDGE_RIGHT:
+		box.x += box.width / 2;
+		/* fallthrough */
+	case VIEW_EDGE_LEFT:
+		box.width /= 2;
+		break;
+	case VIEW_EDGE_DOWN:
+		box.y += box.height / 2;
+		/* fallthrough */
+	case VIEW_EDGE_UP:
+		box.height /= 2;
+		break;
+	case VIEW_EDGE_CENTER:
+		/* <topMaximize> */
+		break;
+	default:
+		/* not reached */
+		assert(false);
+	}
+	return box;
+}
+
 /* Returns true if view was snapped to any edge */
 static bool
 snap_to_edge(struct view *view)
@@ -221,6 +426,11 @@ interactive_finish(struct view *view)
 		return;
 	}
 
+	/* Don't lose the motion since the last frame */
+	if (view->server->grab_update_pending) {
+		update_grabbed_view(view->server);
+	}
+
 	if (view->server->input_mode == LAB_INPUT_STATE_MOVE) {
 		if (!snap_to_region(view)) {
 			snap_to_edge(view);
@@ -228,6 +438,8 @@ interactive_finish(struct view *view)
 	}
 
 	interactive_cancel(view);
+	/* Back into its tile, or into the layout of another output */
+	tiling_update(view->workspace);
 }
 
 /*
@@ -248,6 +460,7 @@ interactive_cancel(struct view *view)
 
 	view->server->input_mode = LAB_INPUT_STATE_PASSTHROUGH;
 	view->server->grabbed_view = NULL;
+	view->server->grab_update_pending = false;
 
 	/* Update focus/cursor image */
 	cursor_update_focus(view->server);
@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/util/log.h>
+#include "common/buf.h"
+#include "common/macros.h"
+#include "common/time-helpers.h"
+#include "latency-trace.h"
+
+#define DEFAULT_THRESHOLD_MS (16)
+#define RING_SIZE (1024)
+
+struct trace_entry {
+	const char *name;
+	int64_t begin_nsec;
+	int64_t duration_nsec;
+	int depth;
+};
+
+static struct {
+	bool enabled;
+	int64_t threshold_nsec;
+	/* Nesting of traced handlers, e.g. a listener within dispatch */
+	int depth;
+	struct trace_entry ring[RING_SIZE];
+	uint64_t nr_entries; /* ever recorded, the ring index is modulo */
+	struct wl_event_source *sigusr1_source;
+} trace;
+
+static void
+dump_ring(void)
+{
+	struct buf path = BUF_INIT;
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+	buf_add_fmt(&path, "%s/labwc-latency-%d.txt",
+		dir && *dir ? dir : "/tmp", getpid());
+
+	FILE *stream = fopen(path.data, "w");
+	if (!stream) {
+		wlr_log(WLR_ERROR, "cannot write %s: %s", path.data,
+			strerror(errno));
+		goto out;
+	}
+	fprintf(stream, "# threshold %.3f ms, times in ms relative to now\n",
+		(double)trace.threshold_nsec / NSEC_PER_MSEC);
+	int64_t now = time_now_nsec();
+	uint64_t first = trace.nr_entries > RING_SIZE
+		? trace.nr_entries - RING_SIZE : 0;
+	for (uint64_t i = first; i < trace.nr_entries; i++) {
+		struct trace_entry *entry = &trace.ring[i % RING_SIZE];
+		fprintf(stream, "%12.3f %10.3f %*s%s%s\n",
+			(double)(entry->begin_nsec - now) / NSEC_PER_MSEC,
+			(double)entry->duration_nsec / NSEC_PER_MSEC,
+			2 * entry->depth, "", entry->name,
+			entry->duration_nsec > trace.threshold_nsec
+				? " (slow)" : "");
+	}
+	fclose(stream);
+	wlr_log(WLR_INFO, "latency trace written to %s", path.data);
+out:
+	buf_reset(&path);
+}
+
+static int
+handle_sigusr1(int signal, void *data)
+{
+	dump_ring();
+	return 0;
+}
+
+void
+latency_trace_init(struct wl_event_loop *loop)
+{
+	const char *env = getenv("LABWC_LATENCY_TRACE");
+	if (!env) {
+		return;
+	}
+	int threshold_ms = atoi(env);
+	if (threshold_ms <= 0) {
+		threshold_ms = DEFAULT_THRESHOLD_MS;
+	}
+	trace.threshold_nsec = (int64_t)threshold_ms * NSEC_PER_MSEC;
+	trace.sigusr1_source = wl_event_loop_add_signal(loop, SIGUSR1,
+		handle_sigusr1, NULL);
+	trace.enabled = true;
+	wlr_log(WLR_INFO, "latency tracing enabled, threshold %d ms",
+		threshold_ms);
+}
+
+void
+latency_trace_finish(void)
+{
+	if (trace.sigusr1_source) {
+		wl_event_source_remove(trace.sigusr1_source);
+		trace.sigusr1_source = NULL;
+	}
+	trace.enabled = false;
+}
+
+int64_t
+latency_trace_begin(void)
+{
+	if (!trace.enabled) {
+		return 0;
+	}
+	trace.depth++;
+	return time_now_nsec();
+}
+
+void
+latency_trace_end(const char *name, int64_t begin)
+{
+	if (!trace.enabled || !begin) {
+		return;
+	}
+	int64_t duration = time_now_nsec() - begin;
+	trace.depth = MAX(trace.depth - 1, 0);
+	trace.ring[trace.nr_entries++ % RING_SIZE] = (struct trace_entry){
+		.name = name,
+		.begin_nsec = begin,
+		.duration_nsec = duration,
+		.depth = trace.depth,
+	};
+	if (duration > trace.threshold_nsec) {
+		wlr_log(WLR_INFO, "slow handler %s took %.3f ms", name,
+			(double)duration / NSEC_PER_MSEC);
+	}
+}
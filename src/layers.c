@@ -68,6 +68,7 @@ layers_arrange(struct output *output)
 	struct wlr_box usable_area = full_area;
 
 	apply_override(output, &usable_area);
+	cursor_context_invalidate(output->server);
 
 	struct server *server = output->server;
 	struct wlr_scene_output *scene_output =
@@ -235,6 +236,26 @@ is_on_demand(struct wlr_layer_surface_v1 *layer_surface)
 		ZWLR_LAYER_SURFACE_V1_KEYBOARD_INTERACTIVITY_ON_DEMAND;
 }
 
+/*
+ * Returns true if the committed state affects the arrangement of the
+ * layer surfaces or the usable area of the output. Just attaching a new
+ * buffer, which bars redrawing a clock do every second, does not.
+ */
+static bool
+arrangement_changed(struct wlr_layer_surface_v1_state *old,
+		struct wlr_layer_surface_v1_state *new)
+{
+	return old->layer != new->layer
+		|| old->anchor != new->anchor
+		|| old->exclusive_zone != new->exclusive_zone
+		|| old->margin.top != new->margin.top
+		|| old->margin.right != new->margin.right
+		|| old->margin.bottom != new->margin.bottom
+		|| old->margin.left != new->margin.left
+		|| old->desired_width != new->desired_width
+		|| old->desired_height != new->desired_height;
+}
+
 static void
 handle_surface_commit(struct wl_listener *listener, void *data)
 {
@@ -282,8 +303,11 @@ handle_surface_commit(struct wl_listener *listener, void *data)
 	}
 out:
 
-	if (committed || layer->mapped != layer_surface->surface->mapped) {
+	if (layer->mapped != layer_surface->surface->mapped
+			|| (committed && arrangement_changed(&layer->arranged_state,
+				&layer_surface->current))) {
 		layer->mapped = layer_surface->surface->mapped;
+		layer->arranged_state = layer_surface->current;
 		output_update_usable_area(output);
 		/*
 		 * Update cursor focus here to ensure we
@@ -510,16 +534,15 @@ handle_new_layer_surface(struct wl_listener *listener, void *data)
 	struct wlr_layer_surface_v1 *layer_surface = data;
 
 	if (!layer_surface->output) {
-		struct wlr_output *output = wlr_output_layout_output_at(
-			server->output_layout, server->seat.cursor->x,
-			server->seat.cursor->y);
+		struct output *output = output_at(server,
+			server->seat.cursor->x, server->seat.cursor->y);
 		if (!output) {
 			wlr_log(WLR_INFO,
 				"No output available to assign layer surface");
 			wlr_layer_surface_v1_destroy(layer_surface);
 			return;
 		}
-		layer_surface->output = output;
+		layer_surface->output = output->wlr_output;
 	}
 
 	struct lab_layer_surface *surface = znew(*surface);
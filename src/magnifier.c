@@ -0,0 +1,290 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <math.h>
+#include <pixman.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/drm_format_set.h>
+#include <wlr/render/pass.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/render/wlr_texture.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/util/box.h>
+#include <wlr/util/log.h>
+#include <wlr/util/region.h>
+#include "common/macros.h"
+#include "labwc.h"
+#include "magnifier.h"
+
+#define SCALE_STEP (1.25)
+#define MAX_SCALE (8.0)
+
+static struct {
+	double scale; /* 1.0 if off */
+} magnifier = { .scale = 1.0 };
+
+static void
+schedule_frames(struct server *server)
+{
+	struct output *cursor_output = output_nearest_to_cursor(server);
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		/* Including the one zoomed last, so that it is restored */
+		if (output_is_usable(output) && (output == cursor_output
+				|| output->magnifier.source.width > 0)) {
+			wlr_output_schedule_frame(output->wlr_output);
+		}
+	}
+}
+
+void
+magnifier_zoom(struct server *server, bool zoom_in)
+{
+	double scale = zoom_in ? magnifier.scale * SCALE_STEP
+		: magnifier.scale / SCALE_STEP;
+	scale = MIN(scale, MAX_SCALE);
+	if (scale < 1.0 + 1e-3) {
+		scale = 1.0;
+	}
+	if (scale == magnifier.scale) {
+		return;
+	}
+	magnifier.scale = scale;
+	schedule_frames(server);
+}
+
+void
+magnifier_on_cursor_motion(struct server *server)
+{
+	if (magnifier.scale != 1.0) {
+		schedule_frames(server);
+	}
+}
+
+/* Returns false if @output is not zoomed */
+static bool
+get_source(struct output *output, struct wlr_fbox *source)
+{
+	*source = (struct wlr_fbox){ 0 };
+	struct server *server = output->server;
+	if (magnifier.scale == 1.0 || output_nearest_to_cursor(server) != output) {
+		return false;
+	}
+
+	/* Cursor position in buffer coordinates */
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct wlr_box cursor = {
+		.x = (server->seat.cursor->x - output->layout_box.x)
+			* wlr_output->scale,
+		.y = (server->seat.cursor->y - output->layout_box.y)
+			* wlr_output->scale,
+		.width = 1,
+		.height = 1,
+	};
+	int width, height;
+	wlr_output_transformed_resolution(wlr_output, &width, &height);
+	struct wlr_box point;
+	wlr_box_transform(&point, &cursor,
+		wlr_output_transform_invert(wlr_output->transform),
+		width, height);
+
+	/* The point under the cursor stays where it is */
+	source->width = wlr_output->width / magnifier.scale;
+	source->height = wlr_output->height / magnifier.scale;
+	source->x = point.x * (1.0 - 1.0 / magnifier.scale);
+	source->y = point.y * (1.0 - 1.0 / magnifier.scale);
+	return true;
+}
+
+bool
+magnifier_begin_frame(struct output *output)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct wlr_fbox source;
+	bool zoomed = get_source(output, &source);
+
+	output->magnifier.moved =
+		!wlr_fbox_equal(&source, &output->magnifier.source);
+	output->magnifier.source = source;
+	if (output->magnifier.moved) {
+		wlr_output_update_needs_frame(wlr_output);
+		return true;
+	}
+	if (!zoomed || wlr_output->needs_frame || (wlr_output->pending.committed
+			& WLR_OUTPUT_STATE_GAMMA_LUT)) {
+		return true;
+	}
+
+	/* Damage outside of the source box does not need a frame */
+	pixman_region32_t damage;
+	pixman_region32_init_rect(&damage, floor(source.x), floor(source.y),
+		ceil(source.width) + 1, ceil(source.height) + 1);
+	pixman_region32_intersect(&damage, &damage,
+		&output->scene_output->damage_ring.current);
+	bool visible = pixman_region32_not_empty(&damage);
+	pixman_region32_fini(&damage);
+	return visible;
+}
+
+static void
+release_buffers(struct output *output)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(output->magnifier.buffers); i++) {
+		if (output->magnifier.buffers[i]) {
+			wlr_buffer_drop(output->magnifier.buffers[i]);
+			output->magnifier.buffers[i] = NULL;
+		}
+	}
+}
+
+static struct wlr_buffer *
+create_buffer(struct output *output, int width, int height)
+{
+	struct server *server = output->server;
+	struct wlr_output *wlr_output = output->wlr_output;
+
+	/* Like the output's own buffers, it is rendered to and scanned out */
+	const struct wlr_drm_format_set *render_formats =
+		wlr_renderer_get_render_formats(server->renderer);
+	const struct wlr_drm_format_set *display_formats =
+		wlr_output_get_primary_formats(wlr_output,
+			server->allocator->buffer_caps);
+	struct wlr_drm_format_set formats = { 0 };
+	if (display_formats) {
+		wlr_drm_format_set_intersect(&formats, display_formats,
+			render_formats);
+	}
+	const struct wlr_drm_format *format = wlr_drm_format_set_get(
+		display_formats ? &formats : render_formats,
+		wlr_output->render_format);
+
+	struct wlr_buffer *buffer = format ? wlr_allocator_create_buffer(
+		server->allocator, width, height, format) : NULL;
+	wlr_drm_format_set_finish(&formats);
+	if (!buffer) {
+		wlr_log(WLR_ERROR, "cannot allocate zoom buffer for %s",
+			wlr_output->name);
+	}
+	return buffer;
+}
+
+/* Returns a buffer which is neither shown nor waiting to be shown */
+static struct wlr_buffer *
+acquire_buffer(struct output *output, int width, int height)
+{
+	struct wlr_buffer **buffers = output->magnifier.buffers;
+	size_t nr_buffers = ARRAY_SIZE(output->magnifier.buffers);
+	for (size_t i = 0; i < nr_buffers; i++) {
+		if (buffers[i] && (buffers[i]->width != width
+				|| buffers[i]->height != height)) {
+			wlr_buffer_drop(buffers[i]);
+			buffers[i] = NULL;
+		}
+		if (buffers[i] && !buffers[i]->n_locks) {
+			return buffers[i];
+		}
+	}
+	for (size_t i = 0; i < nr_buffers; i++) {
+		if (!buffers[i]) {
+			buffers[i] = create_buffer(output, width, height);
+			return buffers[i];
+		}
+	}
+	return NULL;
+}
+
+/* Maps the damage of the scene through the zoom */
+static void
+set_damage(struct output *output, struct wlr_output_state *state,
+		int width, int height)
+{
+	struct wlr_fbox *source = &output->magnifier.source;
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	if (output->magnifier.moved
+			|| !(state->committed & WLR_OUTPUT_STATE_DAMAGE)) {
+		pixman_region32_union_rect(&damage, &damage, 0, 0,
+			width, height);
+	} else {
+		pixman_region32_copy(&damage, &state->damage);
+		pixman_region32_translate(&damage, -floor(source->x),
+			-floor(source->y));
+		wlr_region_scale(&damage, &damage, magnifier.scale);
+		/* Filtering spreads each source pixel a little further */
+		wlr_region_expand(&damage, &damage, ceil(magnifier.scale));
+		pixman_region32_intersect_rect(&damage, &damage, 0, 0,
+			width, height);
+	}
+	wlr_output_state_set_damage(state, &damage);
+	pixman_region32_fini(&damage);
+}
+
+/* Returns false if the zoomed frame could not be rendered */
+static bool
+render(struct output *output, struct wlr_output_state *state)
+{
+	struct server *server = output->server;
+	struct wlr_buffer *scene_buffer = state->buffer;
+	struct wlr_buffer *buffer = acquire_buffer(output,
+		scene_buffer->width, scene_buffer->height);
+	if (!buffer) {
+		return false;
+	}
+	struct wlr_texture *texture =
+		wlr_texture_from_buffer(server->renderer, scene_buffer);
+	if (!texture) {
+		return false;
+	}
+	struct wlr_render_pass *pass =
+		wlr_renderer_begin_buffer_pass(server->renderer, buffer, NULL);
+	if (!pass) {
+		wlr_texture_destroy(texture);
+		return false;
+	}
+	wlr_render_pass_add_texture(pass, &(struct wlr_render_texture_options){
+		.texture = texture,
+		.src_box = output->magnifier.source,
+		.dst_box = { .width = buffer->width, .height = buffer->height },
+		.blend_mode = WLR_RENDER_BLEND_MODE_NONE,
+	});
+	bool ok = wlr_render_pass_submit(pass);
+	wlr_texture_destroy(texture);
+	if (!ok) {
+		return false;
+	}
+
+	set_damage(output, state, buffer->width, buffer->height);
+	wlr_output_state_set_buffer(state, buffer);
+	return true;
+}
+
+void
+magnifier_render(struct output *output)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct wlr_output_state *state = &wlr_output->pending;
+	if (!(state->committed & WLR_OUTPUT_STATE_BUFFER)) {
+		return;
+	}
+	if (output->magnifier.source.width > 0) {
+		if (render(output, state)) {
+			return;
+		}
+		wlr_log(WLR_ERROR, "cannot zoom %s", wlr_output->name);
+		/* Show the regular frame until the next attempt */
+		output->magnifier.source = (struct wlr_fbox){ 0 };
+		output->magnifier.moved = true;
+	}
+	if (output->magnifier.moved) {
+		/* Back to the regular frame, all of which changed */
+		set_damage(output, state, wlr_output->width,
+			wlr_output->height);
+		release_buffers(output);
+	}
+}
+
+void
+magnifier_on_output_destroy(struct output *output)
+{
+	release_buffers(output);
+}
@@ -3,14 +3,21 @@
 #include <signal.h>
 #include <string.h>
 #include <unistd.h>
+#include "button/button-cache.h"
+#include "button/button-xbm.h"
+#include "button/common.h"
 #include "common/dir.h"
 #include "common/fd_util.h"
 #include "common/font.h"
 #include "common/mem.h"
 #include "common/spawn.h"
 #include "config/session.h"
+#include "event-loop.h"
 #include "labwc.h"
+#include "profile.h"
+#include "realtime.h"
 #include "theme.h"
+#include "trace.h"
 #include "menu/menu.h"
 
 struct rcxml rc = { 0 };
@@ -140,11 +147,22 @@ main(int argc, char *argv[])
 	}
 
 	wlr_log_init(verbosity, NULL);
+	profile_init();
+	trace_init();
 
 	die_on_detecting_suid();
 
+	profile_startup_begin("session_environment_init");
 	session_environment_init();
+	profile_startup_end("session_environment_init");
+	profile_startup_begin("rcxml_read");
 	rcxml_read(rc.config_file);
+	profile_startup_end("rcxml_read");
+
+	/* Before server_init() starts threads and opens devices */
+	if (rc.spawn_helper) {
+		spawn_helper_start();
+	}
 
 	/*
 	 * Set environment variable LABWC_PID to the pid of the compositor
@@ -167,15 +185,23 @@ main(int argc, char *argv[])
 	increase_nofile_limit();
 
 	struct server server = { 0 };
+	profile_startup_begin("server_init");
 	server_init(&server);
+	profile_startup_end("server_init");
+	profile_startup_begin("server_start");
 	server_start(&server);
+	profile_startup_end("server_start");
 
 	struct theme theme = { 0 };
+	profile_startup_begin("theme_init");
 	theme_init(&theme, rc.theme_name);
+	profile_startup_end("theme_init");
 	rc.theme = &theme;
 	server.theme = &theme;
 
+	profile_startup_begin("menu_init");
 	menu_init(&server);
+	profile_startup_end("menu_init");
 
 	/* Start session-manager if one is specified by -S|--session */
 	if (primary_client) {
@@ -187,12 +213,15 @@ main(int argc, char *argv[])
 		}
 	}
 
+	profile_startup_begin("autostart");
 	session_autostart_init(&server);
 	if (startup_cmd) {
 		spawn_async_no_shell(startup_cmd);
 	}
+	profile_startup_end("autostart");
 
-	wl_display_run(server.wl_display);
+	realtime_init();
+	event_loop_run(server.wl_display);
 
 out:
 	session_shutdown(&server);
@@ -201,7 +230,15 @@ out:
 
 	menu_finish(&server);
 	theme_finish(&theme);
+	button_filename_finish();
+	button_xbm_finish();
+	button_cache_finish();
+	scratch_finish();
 	rcxml_finish();
 	font_finish();
+	profile_print();
+	profile_write_json();
+	profile_startup_print();
+	trace_finish();
 	return 0;
 }
@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/util/log.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#include "button/button-cache.h"
+#include "common/scaled_scene_buffer.h"
+#include "labwc.h"
+#include "memory-pressure.h"
+#include "workspaces.h"
+
+#define PSI_MEMORY "/proc/pressure/memory"
+
+/*
+ * Fire if some tasks stalled on memory for 150ms within 2s. Unprivileged
+ * processes may only use windows which are a multiple of 2s.
+ */
+#define PSI_TRIGGER "some 150000 2000000"
+
+static struct {
+	struct server *server;
+	int psi_fd;
+	/*
+	 * PSI signals a trigger with EPOLLPRI while always being readable,
+	 * so it can't be added to the wl_event_loop directly. It is watched
+	 * by a dedicated epoll instance instead, which itself becomes readable
+	 * once the trigger fires.
+	 */
+	int epoll_fd;
+	struct wl_event_source *source;
+} pressure = {
+	.psi_fd = -1,
+	.epoll_fd = -1,
+};
+
+void
+memory_pressure_trim(struct server *server)
+{
+	scaled_scene_buffer_trim_caches();
+	workspaces_osd_trim(server);
+	/* Reloaded from disk by the next Reconfigure */
+	button_cache_finish();
+#if defined(__GLIBC__)
+	malloc_trim(0);
+#endif
+}
+
+static int
+handle_pressure(int fd, uint32_t mask, void *data)
+{
+	struct epoll_event event;
+	while (epoll_wait(pressure.epoll_fd, &event, 1, 0) > 0) {
+		if (event.events & (EPOLLERR | EPOLLHUP)) {
+			wlr_log(WLR_ERROR, "memory pressure trigger went away");
+			memory_pressure_finish();
+			return 0;
+		}
+	}
+	wlr_log(WLR_INFO, "memory pressure, trimming caches");
+	memory_pressure_trim(pressure.server);
+	return 0;
+}
+
+void
+memory_pressure_init(struct server *server)
+{
+	pressure.server = server;
+	pressure.psi_fd = open(PSI_MEMORY, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (pressure.psi_fd < 0) {
+		wlr_log(WLR_DEBUG, "no memory pressure information: %s",
+			strerror(errno));
+		return;
+	}
+	/* The terminating NUL is part of the trigger */
+	if (write(pressure.psi_fd, PSI_TRIGGER, sizeof(PSI_TRIGGER)) < 0) {
+		wlr_log(WLR_INFO, "cannot add memory pressure trigger: %s",
+			strerror(errno));
+		goto err;
+	}
+
+	pressure.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (pressure.epoll_fd < 0) {
+		goto err;
+	}
+	struct epoll_event event = {
+		.events = EPOLLPRI,
+	};
+	if (epoll_ctl(pressure.epoll_fd, EPOLL_CTL_ADD, pressure.psi_fd,
+			&event) < 0) {
+		goto err;
+	}
+
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(server->wl_display);
+	pressure.source = wl_event_loop_add_fd(loop, pressure.epoll_fd,
+		WL_EVENT_READABLE, handle_pressure, NULL);
+	if (!pressure.source) {
+		goto err;
+	}
+	return;
+err:
+	memory_pressure_finish();
+}
+
+void
+memory_pressure_finish(void)
+{
+	if (pressure.source) {
+		wl_event_source_remove(pressure.source);
+		pressure.source = NULL;
+	}
+	if (pressure.epoll_fd >= 0) {
+		close(pressure.epoll_fd);
+		pressure.epoll_fd = -1;
+	}
+	if (pressure.psi_fd >= 0) {
+		close(pressure.psi_fd);
+		pressure.psi_fd = -1;
+	}
+}
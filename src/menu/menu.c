@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <glib.h>
+#include <limits.h>
 #include <libxml/parser.h>
 #include <libxml/tree.h>
 #include <signal.h>
@@ -14,20 +16,30 @@
 #include "common/buf.h"
 #include "common/dir.h"
 #include "common/font.h"
+#include "common/grab-file.h"
+#include "common/hash.h"
 #include "common/list.h"
+#include "common/macros.h"
 #include "common/mem.h"
 #include "common/nodename.h"
 #include "common/scaled_font_buffer.h"
 #include "common/scene-helpers.h"
 #include "common/spawn.h"
 #include "common/string-helpers.h"
+#include "common/time-helpers.h"
+#include "common/timers.h"
 #include "labwc.h"
 #include "menu/menu.h"
+#include "metrics.h"
 #include "node.h"
+#include "profile.h"
 #include "theme.h"
+#include "trace.h"
 
 #define PIPEMENU_MAX_BUF_SIZE 1048576  /* 1 MiB */
 #define PIPEMENU_TIMEOUT_IN_MS 4000    /* 4 seconds */
+#define MENU_BUFFER_RELEASE_DELAY_IN_MS 60000 /* 1 minute */
+#define MENU_WINDOW_MARGIN_IN_ITEMS 8
 
 /* state-machine variables for processing <item></item> */
 static bool in_item;
@@ -38,20 +50,90 @@ static int menu_level;
 static struct menu *current_menu;
 
 static bool waiting_for_pipe_menu;
+
+/* Hash of the menu files the current menus were created from */
+static uint64_t files_hash;
 static struct menuitem *selected_item;
+static struct lab_timer *buffer_release_timer;
+/* Menus are rebuilt on every reconfigure and pipemenus on every open */
+static struct pool item_pool = POOL_INIT(struct menuitem);
+
+/* Type-ahead search, see menu_search_add() */
+static struct {
+	struct menu *menu; /* NULL if no search is active */
+	struct buf query;
+} search = {
+	.query = BUF_INIT,
+};
+
+struct search_entry {
+	const char *word; /* suffix of item->search_text starting at a word */
+	struct menuitem *item;
+};
 
 /* TODO: split this whole file into parser.c and actions.c*/
 
+/*
+ * Index of server->menus by id, resized to keep at most one menu per
+ * bucket on average. Menus with the same id are kept in creation order
+ * within their chain, so a lookup finds the same menu as a scan of
+ * server->menus would.
+ */
+static struct {
+	struct wl_list *buckets; /* struct menu.id_link */
+	size_t nr_buckets; /* power of two */
+	size_t nr_menus;
+} menu_index;
+
+static struct wl_list *
+id_bucket(const char *id)
+{
+	uint64_t hash = hash_str(HASH_INIT, id);
+	return &menu_index.buckets[hash & (menu_index.nr_buckets - 1)];
+}
+
+static void
+menu_index_add(struct server *server, struct menu *menu)
+{
+	menu_index.nr_menus++;
+	if (menu_index.nr_menus <= menu_index.nr_buckets) {
+		wl_list_insert(id_bucket(menu->id)->prev, &menu->id_link);
+		return;
+	}
+
+	/* Rehash, @menu is already part of server->menus */
+	free(menu_index.buckets);
+	menu_index.nr_buckets = menu_index.nr_buckets
+		? menu_index.nr_buckets * 2 : 64;
+	menu_index.buckets = znew_n(*menu_index.buckets, menu_index.nr_buckets);
+	for (size_t i = 0; i < menu_index.nr_buckets; i++) {
+		wl_list_init(&menu_index.buckets[i]);
+	}
+	struct menu *iter;
+	wl_list_for_each(iter, &server->menus, link) {
+		wl_list_insert(id_bucket(iter->id)->prev, &iter->id_link);
+	}
+}
+
+static void
+menu_index_remove(struct menu *menu)
+{
+	wl_list_remove(&menu->id_link);
+	menu_index.nr_menus--;
+}
+
+static void
+menu_index_finish(void)
+{
+	assert(!menu_index.nr_menus);
+	zfree(menu_index.buckets);
+	menu_index.nr_buckets = 0;
+}
+
 static bool
 is_unique_id(struct server *server, const char *id)
 {
-	struct menu *menu;
-	wl_list_for_each(menu, &server->menus, link) {
-		if (!strcmp(menu->id, id)) {
-			return false;
-		}
-	}
-	return true;
+	return !menu_get_by_id(server, id);
 }
 
 static struct menu *
@@ -62,10 +144,11 @@ menu_create(struct server *server, const char *id, const char *label)
 	}
 
 	struct menu *menu = znew(*menu);
+	menu->id = xstrdup(id);
 	wl_list_append(&server->menus, &menu->link);
+	menu_index_add(server, menu);
 
 	wl_list_init(&menu->menuitems);
-	menu->id = xstrdup(id);
 	menu->label = xstrdup(label ? label : id);
 	menu->parent = current_menu;
 	menu->server = server;
@@ -74,17 +157,21 @@ menu_create(struct server *server, const char *id, const char *label)
 	/* menu->size.height will be kept up to date by adding items */
 	menu->scene_tree = wlr_scene_tree_create(server->menu_tree);
 	wlr_scene_node_set_enabled(&menu->scene_tree->node, false);
+	menu->items_tree = wlr_scene_tree_create(menu->scene_tree);
+	menu->spare_tree = wlr_scene_tree_create(menu->scene_tree);
+	wlr_scene_node_set_enabled(&menu->spare_tree->node, false);
+	wl_array_init(&menu->spare_buffers);
 	return menu;
 }
 
 struct menu *
 menu_get_by_id(struct server *server, const char *id)
 {
-	if (!id) {
+	if (!id || !menu_index.nr_menus) {
 		return NULL;
 	}
 	struct menu *menu;
-	wl_list_for_each(menu, &server->menus, link) {
+	wl_list_for_each(menu, id_bucket(id), id_link) {
 		if (!strcmp(menu->id, id)) {
 			return menu;
 		}
@@ -92,6 +179,17 @@ menu_get_by_id(struct server *server, const char *id)
 	return NULL;
 }
 
+static int
+item_text_width(struct menuitem *item)
+{
+	struct theme *theme = item->parent->server->theme;
+	int max_width = item->parent->size.width - 2 * theme->menu_item_padding_x;
+	if (item->native_width > max_width || item->submenu || item->execute) {
+		return max_width;
+	}
+	return item->native_width;
+}
+
 static void
 menu_update_width(struct menu *menu)
 {
@@ -125,22 +223,72 @@ menu_update_width(struct menu *menu)
 			wlr_scene_rect_set_size(
 				wlr_scene_rect_from_node(item->selected.background),
 				menu->size.width, item->height);
-			if (item->native_width > max_width || item->submenu || item->execute) {
+			if (item->normal.buffer) {
+				int width = item_text_width(item);
 				scaled_font_buffer_set_max_width(item->normal.buffer,
-					max_width);
+					width);
 				scaled_font_buffer_set_max_width(item->selected.buffer,
-					max_width);
+					width);
 			}
 		}
 	}
 }
 
+static int
+compare_search_entries(const void *a, const void *b)
+{
+	const struct search_entry *entry_a = a;
+	const struct search_entry *entry_b = b;
+	return strcmp(entry_a->word, entry_b->word);
+}
+
+/* Bytes of multi-byte UTF-8 sequences count as part of a word */
+static bool
+is_word_char(char c)
+{
+	return g_ascii_isalnum(c) || (unsigned char)c >= 0x80;
+}
+
+/*
+ * All suffixes of the item texts which start at a word, sorted so that
+ * those starting with the query are adjacent and found by binary search.
+ */
+static void
+menu_build_search_index(struct menu *menu)
+{
+	if (menu->has_search_index) {
+		return;
+	}
+	wl_array_init(&menu->search_index);
+	struct menuitem *item;
+	wl_list_for_each(item, &menu->menuitems, link) {
+		const char *text = item->search_text;
+		if (!text) {
+			continue;
+		}
+		for (const char *p = text; *p; p++) {
+			if (!is_word_char(*p) || (p > text && is_word_char(p[-1]))) {
+				continue;
+			}
+			struct search_entry *entry = wl_array_add(
+				&menu->search_index, sizeof(*entry));
+			entry->word = p;
+			entry->item = item;
+		}
+	}
+	qsort(menu->search_index.data,
+		menu->search_index.size / sizeof(struct search_entry),
+		sizeof(struct search_entry), compare_search_entries);
+	menu->has_search_index = true;
+}
+
 static void
 post_processing(struct server *server)
 {
 	struct menu *menu;
 	wl_list_for_each(menu, &server->menus, link) {
 		menu_update_width(menu);
+		menu_build_search_index(menu);
 	}
 }
 
@@ -169,34 +317,249 @@ validate(struct server *server)
 	}
 }
 
+/* Reuses a font buffer released by item_release_buffers() if possible */
+static struct scaled_font_buffer *
+item_get_buffer(struct menu *menu, struct wlr_scene_tree *parent)
+{
+	if (!menu->spare_buffers.size) {
+		return scaled_font_buffer_create(parent);
+	}
+	menu->spare_buffers.size -= sizeof(struct scaled_font_buffer *);
+	struct scaled_font_buffer **spare = (void *)(
+		(char *)menu->spare_buffers.data + menu->spare_buffers.size);
+	wlr_scene_node_reparent(&(*spare)->scene_buffer->node, parent);
+	return *spare;
+}
+
+static void
+item_create_buffers(struct menuitem *item)
+{
+	struct menu *menu = item->parent;
+	struct theme *theme = menu->server->theme;
+	const char *arrow = item->show_arrow ? "›" : NULL;
+
+	item->normal.buffer = item_get_buffer(menu, item->normal.tree);
+	item->selected.buffer = item_get_buffer(menu, item->selected.tree);
+	if (!item->normal.buffer || !item->selected.buffer) {
+		wlr_log(WLR_ERROR, "Failed to create menu item '%s'", item->text);
+		/* Destroying the node also destroys the scaled_font_buffer */
+		if (item->normal.buffer) {
+			wlr_scene_node_destroy(
+				&item->normal.buffer->scene_buffer->node);
+			item->normal.buffer = NULL;
+		}
+		if (item->selected.buffer) {
+			wlr_scene_node_destroy(
+				&item->selected.buffer->scene_buffer->node);
+			item->selected.buffer = NULL;
+		}
+		return;
+	}
+	item->normal.text = &item->normal.buffer->scene_buffer->node;
+	item->selected.text = &item->selected.buffer->scene_buffer->node;
+
+	/* Font buffers */
+	int width = item_text_width(item);
+	scaled_font_buffer_update(item->normal.buffer, item->text, width,
+		&rc.font_menuitem, theme->menu_items_text_color,
+		theme->menu_items_bg_color, arrow);
+	scaled_font_buffer_update(item->selected.buffer, item->text, width,
+		&rc.font_menuitem, theme->menu_items_active_text_color,
+		theme->menu_items_active_bg_color, arrow);
+
+	/* Center font nodes */
+	int x = theme->menu_item_padding_x;
+	int y = (menu->item_height - item->normal.buffer->height) / 2;
+	wlr_scene_node_set_position(item->normal.text, x, y);
+	y = (menu->item_height - item->selected.buffer->height) / 2;
+	wlr_scene_node_set_position(item->selected.text, x, y);
+}
+
+static void
+spare_buffer_add(struct menu *menu, struct scaled_font_buffer *buffer)
+{
+	/*
+	 * Drop the old text so that the next update renders synchronously
+	 * rather than showing it until the new one is ready.
+	 */
+	wlr_scene_buffer_set_buffer(buffer->scene_buffer, NULL);
+	wlr_scene_node_reparent(&buffer->scene_buffer->node, menu->spare_tree);
+	struct scaled_font_buffer **spare =
+		wl_array_add(&menu->spare_buffers, sizeof(*spare));
+	*spare = buffer;
+}
+
+static void
+item_release_buffers(struct menuitem *item)
+{
+	if (!item->normal.buffer) {
+		return;
+	}
+	spare_buffer_add(item->parent, item->normal.buffer);
+	spare_buffer_add(item->parent, item->selected.buffer);
+	item->normal.buffer = NULL;
+	item->selected.buffer = NULL;
+	item->normal.text = NULL;
+	item->selected.text = NULL;
+}
+
+static void
+item_destroy_buffers(struct menuitem *item)
+{
+	if (!item->normal.buffer) {
+		return;
+	}
+	/* Destroying the node also destroys the scaled_font_buffer */
+	wlr_scene_node_destroy(item->normal.text);
+	wlr_scene_node_destroy(item->selected.text);
+	item->normal.buffer = NULL;
+	item->selected.buffer = NULL;
+	item->normal.text = NULL;
+	item->selected.text = NULL;
+}
+
+static bool
+item_within(struct menuitem *item, int top, int bottom)
+{
+	int y = item->tree->node.y;
+	return y >= top && y + item->height <= bottom;
+}
+
+/*
+ * Rendering the text of all items of all menus up front would be wasted
+ * on the many submenus which are never opened, so the font buffers are
+ * created when a menu is shown. Of long menus, only the items within a
+ * margin around the visible window get buffers; those scrolled further
+ * away hand theirs over to the items coming into view.
+ */
+static void
+menu_update_window(struct menu *menu)
+{
+	int top = menu->window.offset;
+	int bottom = top + menu->window.height;
+	int margin = MENU_WINDOW_MARGIN_IN_ITEMS * menu->item_height;
+
+	struct menuitem *item;
+	wl_list_for_each(item, &menu->menuitems, link) {
+		bool shown = !item->hidden && item_within(item, top, bottom);
+		wlr_scene_node_set_enabled(&item->tree->node, shown);
+		if (item->selectable && (item->hidden
+				|| !item_within(item, top - margin, bottom + margin))) {
+			item_release_buffers(item);
+		}
+	}
+	wl_list_for_each(item, &menu->menuitems, link) {
+		if (item->selectable && !item->normal.buffer && !item->hidden
+				&& item_within(item, top - margin, bottom + margin)) {
+			item_create_buffers(item);
+		}
+	}
+	wlr_scene_node_set_position(&menu->items_tree->node, 0, -top);
+	menu->has_item_buffers = true;
+}
+
+static void
+menu_destroy_item_buffers(struct menu *menu)
+{
+	struct menuitem *item;
+	wl_list_for_each(item, &menu->menuitems, link) {
+		if (item->selectable) {
+			item_destroy_buffers(item);
+		}
+	}
+	struct scaled_font_buffer **spare;
+	wl_array_for_each(spare, &menu->spare_buffers) {
+		/* Destroying the node also destroys the scaled_font_buffer */
+		wlr_scene_node_destroy(&(*spare)->scene_buffer->node);
+	}
+	menu->spare_buffers.size = 0;
+	menu->has_item_buffers = false;
+}
+
+/* Returns the y of the first item shown at or below @y */
+static int
+menu_item_y_from(struct menu *menu, int y)
+{
+	struct menuitem *item;
+	wl_list_for_each(item, &menu->menuitems, link) {
+		if (!item->hidden && item->tree->node.y >= y) {
+			return item->tree->node.y;
+		}
+	}
+	return menu->size.height;
+}
+
+/* Scrolls to the item at or below @offset, keeping the window filled */
+static void
+menu_scroll_to(struct menu *menu, int offset)
+{
+	int max_offset = menu_item_y_from(menu,
+		menu->size.height - menu->window.height);
+	offset = MIN(menu_item_y_from(menu, MAX(offset, 0)), max_offset);
+	if (offset == menu->window.offset) {
+		return;
+	}
+	menu->window.offset = offset;
+	menu_update_window(menu);
+	cursor_context_invalidate(menu->server);
+}
+
+static void
+menu_scroll_to_item(struct menuitem *item)
+{
+	struct menu *menu = item->parent;
+	int y = item->tree->node.y;
+	if (y < menu->window.offset) {
+		menu_scroll_to(menu, y);
+	} else if (y + item->height > menu->window.offset + menu->window.height) {
+		menu_scroll_to(menu, y + item->height - menu->window.height);
+	}
+}
+
+/* Fits the window to the output, the items must be laid out already */
+static void
+menu_set_window(struct menu *menu, int max_height)
+{
+	menu->window.max_height = max_height;
+	menu->window.height = MIN(menu->size.height, max_height);
+	menu->window.offset = 0;
+}
+
+static void
+menu_show(struct menu *menu)
+{
+	menu_update_window(menu);
+	wlr_scene_node_set_enabled(&menu->scene_tree->node, true);
+}
+
 static struct menuitem *
 item_create(struct menu *menu, const char *text, bool show_arrow)
 {
 	assert(menu);
 	assert(text);
 
-	struct menuitem *menuitem = znew(*menuitem);
+	struct menuitem *menuitem = pool_alloc(&item_pool);
 	menuitem->parent = menu;
 	menuitem->selectable = true;
+	menuitem->text = xstrdup(text);
+	menuitem->search_text = g_utf8_strdown(text, -1);
+	menuitem->show_arrow = show_arrow;
 	struct server *server = menu->server;
 	struct theme *theme = server->theme;
 
-	const char *arrow = show_arrow ? "›" : NULL;
-
 	if (!menu->item_height) {
 		menu->item_height = font_height(&rc.font_menuitem)
 			+ 2 * theme->menu_item_padding_y;
 	}
 	menuitem->height = menu->item_height;
 
-	int x, y;
 	menuitem->native_width = font_width(&rc.font_menuitem, text);
-	if (arrow) {
-		menuitem->native_width += font_width(&rc.font_menuitem, arrow);
+	if (show_arrow) {
+		menuitem->native_width += font_width(&rc.font_menuitem, "›");
 	}
 
 	/* Menu item root node */
-	menuitem->tree = wlr_scene_tree_create(menu->scene_tree);
+	menuitem->tree = wlr_scene_tree_create(menu->items_tree);
 	node_descriptor_create(&menuitem->tree->node,
 		LAB_NODE_DESC_MENUITEM, menuitem);
 
@@ -214,36 +577,7 @@ item_create(struct menu *menu, const char *text, bool show_arrow)
 		menu->size.width, menu->item_height,
 		theme->menu_items_active_bg_color)->node;
 
-	/* Font nodes */
-	menuitem->normal.buffer = scaled_font_buffer_create(menuitem->normal.tree);
-	menuitem->selected.buffer = scaled_font_buffer_create(menuitem->selected.tree);
-	if (!menuitem->normal.buffer || !menuitem->selected.buffer) {
-		wlr_log(WLR_ERROR, "Failed to create menu item '%s'", text);
-		/*
-		 * Destroying the root node will destroy everything,
-		 * including the node descriptor and scaled_font_buffers.
-		 */
-		wlr_scene_node_destroy(&menuitem->tree->node);
-		free(menuitem);
-		return NULL;
-	}
-	menuitem->normal.text = &menuitem->normal.buffer->scene_buffer->node;
-	menuitem->selected.text = &menuitem->selected.buffer->scene_buffer->node;
-
-	/* Font buffers */
-	scaled_font_buffer_update(menuitem->normal.buffer, text, menuitem->native_width,
-		&rc.font_menuitem, theme->menu_items_text_color,
-		theme->menu_items_bg_color, arrow);
-	scaled_font_buffer_update(menuitem->selected.buffer, text, menuitem->native_width,
-		&rc.font_menuitem, theme->menu_items_active_text_color,
-		theme->menu_items_active_bg_color, arrow);
-
-	/* Center font nodes */
-	x = theme->menu_item_padding_x;
-	y = (menu->item_height - menuitem->normal.buffer->height) / 2;
-	wlr_scene_node_set_position(menuitem->normal.text, x, y);
-	y = (menu->item_height - menuitem->selected.buffer->height) / 2;
-	wlr_scene_node_set_position(menuitem->selected.text, x, y);
+	/* Font buffers are created by menu_update_window() */
 
 	/* Position the item in relation to its menu */
 	wlr_scene_node_set_position(&menuitem->tree->node, 0, menu->size.height);
@@ -262,7 +596,7 @@ item_create(struct menu *menu, const char *text, bool show_arrow)
 static struct menuitem *
 separator_create(struct menu *menu, const char *label)
 {
-	struct menuitem *menuitem = znew(*menuitem);
+	struct menuitem *menuitem = pool_alloc(&item_pool);
 	menuitem->parent = menu;
 	menuitem->selectable = false;
 	struct server *server = menu->server;
@@ -270,7 +604,7 @@ separator_create(struct menu *menu, const char *label)
 	menuitem->height = theme->menu_separator_line_thickness +
 			2 * theme->menu_separator_padding_height;
 
-	menuitem->tree = wlr_scene_tree_create(menu->scene_tree);
+	menuitem->tree = wlr_scene_tree_create(menu->items_tree);
 	node_descriptor_create(&menuitem->tree->node,
 		LAB_NODE_DESC_MENUITEM, menuitem);
 	menuitem->normal.tree = wlr_scene_tree_create(menuitem->tree);
@@ -350,9 +684,11 @@ item_destroy(struct menuitem *item)
 	wl_list_remove(&item->link);
 	action_list_free(&item->actions);
 	wlr_scene_node_destroy(&item->tree->node);
+	free(item->text);
+	g_free(item->search_text);
 	free(item->execute);
 	free(item->id);
-	free(item);
+	pool_free(&item_pool, item);
 }
 
 /*
@@ -491,6 +827,40 @@ is_toplevel_static_menu_definition(xmlNode *n, char *id)
 	return id && nr_parents(n) == 2;
 }
 
+/*
+ * Parse the cache="" attribute of pipemenus, for example "30s", "500ms" or
+ * "5m". A number without unit is interpreted as seconds.
+ */
+static int
+parse_cache_duration(const char *str)
+{
+	char *end;
+	long value = strtol(str, &end, 10);
+	if (end == str || value < 0) {
+		goto invalid;
+	}
+
+	long factor;
+	if (!*end || !strcasecmp(end, "s")) {
+		factor = 1000;
+	} else if (!strcasecmp(end, "ms")) {
+		factor = 1;
+	} else if (!strcasecmp(end, "m")) {
+		factor = 60 * 1000;
+	} else {
+		goto invalid;
+	}
+
+	if (value > INT_MAX / factor) {
+		return INT_MAX;
+	}
+	return value * factor;
+
+invalid:
+	wlr_log(WLR_ERROR, "invalid pipemenu cache duration '%s'", str);
+	return 0;
+}
+
 /*
  * <menu> elements have three different roles:
  *  * Definition of (sub)menu - has ID, LABEL and CONTENT
@@ -503,6 +873,7 @@ handle_menu_element(xmlNode *n, struct server *server)
 	char *label = (char *)xmlGetProp(n, (const xmlChar *)"label");
 	char *execute = (char *)xmlGetProp(n, (const xmlChar *)"execute");
 	char *id = (char *)xmlGetProp(n, (const xmlChar *)"id");
+	char *cache = (char *)xmlGetProp(n, (const xmlChar *)"cache");
 
 	if (execute && label && id) {
 		wlr_log(WLR_DEBUG, "pipemenu '%s:%s:%s'", id, label, execute);
@@ -510,6 +881,9 @@ handle_menu_element(xmlNode *n, struct server *server)
 		current_item_action = NULL;
 		current_item->execute = xstrdup(execute);
 		current_item->id = xstrdup(id);
+		if (cache) {
+			current_item->cache_msec = parse_cache_duration(cache);
+		}
 	} else if ((label && id) || is_toplevel_static_menu_definition(n, id)) {
 		/*
 		 * (label && id) refers to <menu id="" label=""> which is an
@@ -578,6 +952,7 @@ error:
 	free(label);
 	free(execute);
 	free(id);
+	free(cache);
 }
 
 /* This can be one of <separator> and <separator label=""> */
@@ -615,11 +990,11 @@ xml_tree_walk(xmlNode *node, struct server *server)
 }
 
 static bool
-parse_buf(struct server *server, struct buf *buf)
+parse_buf(struct server *server, const char *data, int len)
 {
-	xmlDoc *d = xmlParseMemory(buf->data, buf->len);
+	xmlDoc *d = xmlReadMemory(data, len, NULL, NULL, 0);
 	if (!d) {
-		wlr_log(WLR_ERROR, "xmlParseMemory()");
+		wlr_log(WLR_ERROR, "xmlReadMemory()");
 		return false;
 	}
 	xml_tree_walk(xmlDocGetRootElement(d), server);
@@ -628,30 +1003,6 @@ parse_buf(struct server *server, struct buf *buf)
 	return true;
 }
 
-/*
- * @stream can come from either of the following:
- *   - fopen() in the case of reading a file such as menu.xml
- *   - popen() when processing pipemenus
- */
-static void
-parse_stream(struct server *server, FILE *stream)
-{
-	char *line = NULL;
-	size_t len = 0;
-	struct buf b = BUF_INIT;
-
-	while (getline(&line, &len, stream) != -1) {
-		char *p = strrchr(line, '\n');
-		if (p) {
-			*p = '\0';
-		}
-		buf_add(&b, line);
-	}
-	free(line);
-	parse_buf(server, &b);
-	buf_reset(&b);
-}
-
 static void
 parse_xml(const char *filename, struct server *server)
 {
@@ -664,13 +1015,14 @@ parse_xml(const char *filename, struct server *server)
 
 	for (struct wl_list *elm = iter(&paths); elm != &paths; elm = iter(elm)) {
 		struct path *path = wl_container_of(elm, path, link);
-		FILE *stream = fopen(path->string, "r");
-		if (!stream) {
+		struct file_view view;
+		if (!file_view_open(&view, path->string)) {
 			return;
 		}
 		wlr_log(WLR_INFO, "read menu file %s", path->string);
-		parse_stream(server, stream);
-		fclose(stream);
+		file_view_join_lines(&view);
+		parse_buf(server, view.data, view.len);
+		file_view_close(&view);
 		if (!should_merge_config) {
 			break;
 		}
@@ -711,7 +1063,7 @@ get_submenu_position(struct menuitem *item, enum menu_align align)
 	} else {
 		pos.x = lx;
 	}
-	int rel_y = item->tree->node.y;
+	int rel_y = item->tree->node.y - menu->window.offset;
 	pos.y = ly + rel_y - theme->menu_overlap_y;
 	return pos;
 }
@@ -724,10 +1076,7 @@ menu_configure(struct menu *menu, int lx, int ly, enum menu_align align)
 	/* Get output local coordinates + output usable area */
 	double ox = lx;
 	double oy = ly;
-	struct wlr_output *wlr_output = wlr_output_layout_output_at(
-		menu->server->output_layout, lx, ly);
-	struct output *output = wlr_output ? output_from_wlr_output(
-		menu->server, wlr_output) : NULL;
+	struct output *output = output_at(menu->server, lx, ly);
 	if (!output) {
 		wlr_log(WLR_ERROR,
 			"Failed to position menu %s (%s) and its submenus: "
@@ -735,7 +1084,7 @@ menu_configure(struct menu *menu, int lx, int ly, enum menu_align align)
 		return;
 	}
 	wlr_output_layout_output_coords(menu->server->output_layout,
-		wlr_output, &ox, &oy);
+		output->wlr_output, &ox, &oy);
 
 	if (align == LAB_MENU_OPEN_AUTO) {
 		int full_width = menu_get_full_width(menu);
@@ -746,7 +1095,9 @@ menu_configure(struct menu *menu, int lx, int ly, enum menu_align align)
 		}
 	}
 
-	if (oy + menu->size.height > output->usable_area.height) {
+	menu_set_window(menu, output->usable_area.height);
+
+	if (oy + menu->window.height > output->usable_area.height) {
 		align &= ~LAB_MENU_OPEN_BOTTOM;
 		align |= LAB_MENU_OPEN_TOP;
 	} else {
@@ -758,24 +1109,46 @@ menu_configure(struct menu *menu, int lx, int ly, enum menu_align align)
 		lx -= menu->size.width - theme->menu_overlap_x;
 	}
 	if (align & LAB_MENU_OPEN_TOP) {
-		ly -= menu->size.height;
+		ly -= menu->window.height;
 		if (menu->parent) {
 			/* For submenus adjust y to bottom left corner */
 			ly += menu->item_height;
 		}
 	}
+	if (menu->window.height < menu->size.height) {
+		/* Scrolled menus fill the usable area of the output */
+		ly = ly - oy + output->usable_area.y;
+	}
 	wlr_scene_node_set_position(&menu->scene_tree->node, lx, ly);
 
-	/* Needed for pipemenus to inherit alignment */
+	/*
+	 * Needed for submenus and pipemenus to inherit alignment. They are
+	 * only positioned once opened, see menu_configure_submenu().
+	 */
 	menu->align = align;
 
-	struct menuitem *item;
-	wl_list_for_each(item, &menu->menuitems, link) {
-		if (!item->submenu) {
-			continue;
-		}
-		struct wlr_box pos = get_submenu_position(item, align);
-		menu_configure(item->submenu, pos.x, pos.y, align);
+	if (menu->scene_tree->node.enabled) {
+		/* Otherwise done by menu_show() */
+		menu_update_window(menu);
+	}
+}
+
+/*
+ * Positions the submenu of @item and the submenus currently open below it.
+ * Generated menus can hold thousands of entries, so submenus are not
+ * positioned ahead of time but when they are actually shown.
+ */
+static void
+menu_configure_submenu(struct menuitem *item)
+{
+	struct menu *menu = item->parent;
+	struct wlr_box pos = get_submenu_position(item, menu->align);
+	menu_configure(item->submenu, pos.x, pos.y, menu->align);
+
+	struct menu *submenu = item->submenu;
+	if (submenu->selection.menu && submenu->selection.item
+			&& submenu->selection.item->submenu) {
+		menu_configure_submenu(submenu->selection.item);
 	}
 }
 
@@ -881,9 +1254,30 @@ init_windowmenu(struct server *server)
 	}
 }
 
+static uint64_t
+hash_menu_files(const char *filename)
+{
+	uint64_t hash = HASH_INIT;
+	struct wl_list paths;
+	paths_config_create(&paths, filename);
+	struct path *path;
+	wl_list_for_each(path, &paths, link) {
+		struct file_view view;
+		hash = hash_str(hash, path->string);
+		if (!file_view_open(&view, path->string)) {
+			continue;
+		}
+		hash = hash_data(hash, view.data, view.len);
+		file_view_close(&view);
+	}
+	paths_destroy(&paths);
+	return hash;
+}
+
 void
 menu_init(struct server *server)
 {
+	files_hash = hash_menu_files("menu.xml");
 	wl_list_init(&server->menus);
 	parse_xml("menu.xml", server);
 	init_rootmenu(server);
@@ -931,7 +1325,16 @@ menu_free(struct menu *menu)
 	 * including node descriptors and scaled_font_buffers.
 	 */
 	wlr_scene_node_destroy(&menu->scene_tree->node);
+	wl_array_release(&menu->spare_buffers);
 	wl_list_remove(&menu->link);
+	menu_index_remove(menu);
+	if (menu->has_search_index) {
+		wl_array_release(&menu->search_index);
+	}
+	if (search.menu == menu) {
+		search.menu = NULL;
+		buf_clear(&search.query);
+	}
 	zfree(menu);
 }
 
@@ -960,6 +1363,14 @@ void
 menu_finish(struct server *server)
 {
 	menu_free_from(server, NULL);
+	/* All items are gone along the menus */
+	pool_finish(&item_pool);
+	menu_index_finish();
+	buf_reset(&search.query);
+	if (buffer_release_timer) {
+		timers_remove(buffer_release_timer);
+		buffer_release_timer = NULL;
+	}
 }
 
 /* Sets selection (or clears selection if passing NULL) */
@@ -995,6 +1406,23 @@ close_all_submenus(struct menu *menu)
 	menu->selection.menu = NULL;
 }
 
+/*
+ * A pipemenu with a cache="" attribute outlives the menu-tree it was opened
+ * from until its cache duration has expired. Its pipemenu ancestors must be
+ * kept as well, because it can only be reached through them.
+ */
+static bool
+pipemenu_is_cached(struct menu *menu, int64_t now)
+{
+	if (now >= menu->cache_expiry_nsec || !menu->parent) {
+		return false;
+	}
+	if (menu->parent->is_pipemenu) {
+		return pipemenu_is_cached(menu->parent, now);
+	}
+	return true;
+}
+
 /*
  * We only destroy pipemenus when closing the entire menu-tree so that pipemenu
  * are cached (for as long as the menu is open). This drastically improves the
@@ -1007,9 +1435,14 @@ destroy_pipemenus(struct server *server)
 	wlr_log(WLR_DEBUG, "number of menus before close=%d",
 		wl_list_length(&server->menus));
 
+	/*
+	 * Freeing a menu resets the parent of its submenus, so the submenus
+	 * of an expired pipemenu are not considered cached either.
+	 */
+	int64_t now = time_now_nsec();
 	struct menu *iter, *tmp;
 	wl_list_for_each_safe(iter, tmp, &server->menus, link) {
-		if (iter->is_pipemenu) {
+		if (iter->is_pipemenu && !pipemenu_is_cached(iter, now)) {
 			menu_free(iter);
 		}
 	}
@@ -1018,10 +1451,16 @@ destroy_pipemenus(struct server *server)
 		wl_list_length(&server->menus));
 }
 
+static void search_end(void);
+
 static void
 _close(struct menu *menu)
 {
+	if (menu == search.menu) {
+		search_end();
+	}
 	wlr_scene_node_set_enabled(&menu->scene_tree->node, false);
+	cursor_context_invalidate(menu->server);
 	menu_set_selection(menu, NULL);
 	if (menu->selection.menu) {
 		_close(menu->selection.menu);
@@ -1029,6 +1468,35 @@ _close(struct menu *menu)
 	}
 }
 
+static int
+handle_buffer_release_timeout(void *data)
+{
+	struct server *server = data;
+	struct menu *menu;
+	wl_list_for_each(menu, &server->menus, link) {
+		if (menu->has_item_buffers && !menu->scene_tree->node.enabled) {
+			menu_destroy_item_buffers(menu);
+		}
+	}
+	return 0;
+}
+
+/*
+ * Free the font buffers of menus which have not been shown again for
+ * MENU_BUFFER_RELEASE_DELAY_IN_MS after the last menu was closed.
+ */
+static void
+schedule_buffer_release(struct server *server)
+{
+	if (!buffer_release_timer) {
+		buffer_release_timer = timers_add(
+			server->wl_event_loop, handle_buffer_release_timeout,
+			server);
+	}
+	timers_update(buffer_release_timer,
+		MENU_BUFFER_RELEASE_DELAY_IN_MS);
+}
+
 static void
 menu_close(struct menu *menu)
 {
@@ -1037,12 +1505,15 @@ menu_close(struct menu *menu)
 		return;
 	}
 	_close(menu);
+	schedule_buffer_release(menu->server);
 }
 
 void
 menu_open_root(struct menu *menu, int x, int y)
 {
 	assert(menu);
+	trace_instant("menu_open", menu->id);
+	int64_t profile_start = profile_begin();
 	if (menu->server->menu_current) {
 		menu_close(menu->server->menu_current);
 		destroy_pipemenus(menu->server);
@@ -1050,24 +1521,29 @@ menu_open_root(struct menu *menu, int x, int y)
 	close_all_submenus(menu);
 	menu_set_selection(menu, NULL);
 	menu_configure(menu, x, y, LAB_MENU_OPEN_AUTO);
-	wlr_scene_node_set_enabled(&menu->scene_tree->node, true);
+	menu_show(menu);
+	cursor_context_invalidate(menu->server);
 	menu->server->menu_current = menu;
 	menu->server->input_mode = LAB_INPUT_STATE_MENU;
 	selected_item = NULL;
+	profile_end(PROFILE_MENU_OPEN, profile_start);
 }
 
 struct pipe_context {
 	struct server *server;
 	struct menuitem *item;
-	struct buf buf;
+	/* Created once the first non-whitespace data has been read */
+	xmlParserCtxtPtr parser;
+	size_t nr_bytes;
 	struct wl_event_source *event_read;
-	struct wl_event_source *event_timeout;
+	struct lab_timer *event_timeout;
 	pid_t pid;
 	int pipe_fd;
+	int64_t spawned_nsec;
 };
 
 static void
-create_pipe_menu(struct pipe_context *ctx)
+create_pipe_menu(struct pipe_context *ctx, xmlDoc *doc)
 {
 	struct menu *pipe_parent = ctx->item->parent;
 	if (!pipe_parent) {
@@ -1092,13 +1568,20 @@ create_pipe_menu(struct pipe_context *ctx)
 
 	menu_level++;
 	current_menu = pipe_menu;
-	if (!parse_buf(ctx->server, &ctx->buf)) {
-		menu_free(pipe_menu);
-		ctx->item->submenu = NULL;
-		goto restore_menus;
-	}
+	xml_tree_walk(xmlDocGetRootElement(doc), ctx->server);
 	ctx->item->submenu = pipe_menu;
 
+	if (ctx->item->cache_msec > 0) {
+		/* Inline submenus were appended after pipe_menu */
+		int64_t expiry = time_now_nsec()
+			+ ctx->item->cache_msec * NSEC_PER_MSEC;
+		struct wl_list *link = &pipe_menu->link;
+		for (; link != &ctx->server->menus; link = link->next) {
+			struct menu *iter = wl_container_of(link, iter, link);
+			iter->cache_expiry_nsec = expiry;
+		}
+	}
+
 	/*
 	 * TODO: refactor validate() and post_processing() to only
 	 * operate from current point onwards
@@ -1115,7 +1598,8 @@ create_pipe_menu(struct pipe_context *ctx)
 	 */
 	enum menu_align align = ctx->item->parent->align;
 	int x = pipe_parent->scene_tree->node.x;
-	int y = pipe_parent->scene_tree->node.y + ctx->item->tree->node.y;
+	int y = pipe_parent->scene_tree->node.y + ctx->item->tree->node.y
+		- pipe_parent->window.offset;
 	if (align & LAB_MENU_OPEN_RIGHT) {
 		x += pipe_parent->size.width;
 	}
@@ -1124,10 +1608,9 @@ create_pipe_menu(struct pipe_context *ctx)
 	validate(ctx->server);
 
 	/* Finally open the new submenu tree */
-	wlr_scene_node_set_enabled(&pipe_menu->scene_tree->node, true);
+	menu_show(pipe_menu);
 	pipe_parent->selection.menu = pipe_menu;
 
-restore_menus:
 	current_menu = pipe_parent;
 	menu_level--;
 }
@@ -1136,9 +1619,12 @@ static void
 pipemenu_ctx_destroy(struct pipe_context *ctx)
 {
 	wl_event_source_remove(ctx->event_read);
-	wl_event_source_remove(ctx->event_timeout);
+	timers_remove(ctx->event_timeout);
 	spawn_piped_close(ctx->pid, ctx->pipe_fd);
-	buf_reset(&ctx->buf);
+	if (ctx->parser) {
+		xmlFreeDoc(ctx->parser->myDoc);
+		xmlFreeParserCtxt(ctx->parser);
+	}
 	free(ctx);
 	waiting_for_pipe_menu = false;
 }
@@ -1149,28 +1635,57 @@ handle_pipemenu_timeout(void *_ctx)
 	struct pipe_context *ctx = _ctx;
 	wlr_log(WLR_ERROR, "[pipemenu %ld] timeout reached, killing %s",
 		(long)ctx->pid, ctx->item->execute);
+	metrics_count(METRICS_PIPEMENU_TIMEOUTS);
 	kill(ctx->pid, SIGTERM);
 	pipemenu_ctx_destroy(ctx);
 	return 0;
 }
 
+/*
+ * Feed data read from the pipe to the push parser, so that the document is
+ * parsed incrementally while the pipemenu process is still producing it.
+ */
 static bool
-starts_with_less_than(const char *s)
+feed_pipemenu_parser(struct pipe_context *ctx, const char *data, int size)
 {
-	return (s + strspn(s, " \t\r\n"))[0] == '<';
+	if (!ctx->parser) {
+		/* Skip leading whitespace */
+		while (size && *data && strchr(" \t\r\n", *data)) {
+			data++;
+			size--;
+		}
+		if (!size) {
+			return true;
+		}
+		/* Guard against badly formed data such as binary input */
+		if (*data != '<') {
+			wlr_log(WLR_ERROR, "expect xml data to start with '<'; abort pipemenu");
+			return false;
+		}
+		ctx->parser = xmlCreatePushParserCtxt(NULL, NULL, NULL, 0, NULL);
+		if (!ctx->parser) {
+			wlr_log(WLR_ERROR, "xmlCreatePushParserCtxt()");
+			return false;
+		}
+	}
+	if (xmlParseChunk(ctx->parser, data, size, /* terminate */ !size)) {
+		wlr_log(WLR_ERROR, "[pipemenu %ld] invalid xml data",
+			(long)ctx->pid);
+		return false;
+	}
+	return true;
 }
 
 static int
 handle_pipemenu_readable(int fd, uint32_t mask, void *_ctx)
 {
 	struct pipe_context *ctx = _ctx;
-	/* two 4k pages + 1 NULL byte */
-	char data[8193];
+	/* two 4k pages */
+	char data[8192];
 	ssize_t size;
 
 	do {
-		/* leave space for terminating NULL byte */
-		size = read(fd, data, sizeof(data) - 1);
+		size = read(fd, data, sizeof(data));
 	} while (size == -1 && errno == EINTR);
 
 	if (size == -1) {
@@ -1179,28 +1694,40 @@ handle_pipemenu_readable(int fd, uint32_t mask, void *_ctx)
 		goto clean_up;
 	}
 
-	/* Limit pipemenu buffer to 1 MiB for safety */
-	if (ctx->buf.len + size > PIPEMENU_MAX_BUF_SIZE) {
+	/* Limit pipemenu data to 1 MiB for safety */
+	if (ctx->nr_bytes + size > PIPEMENU_MAX_BUF_SIZE) {
 		wlr_log(WLR_ERROR, "[pipemenu %ld] too big (> %d bytes); killing %s",
 			(long)ctx->pid, PIPEMENU_MAX_BUF_SIZE, ctx->item->execute);
 		kill(ctx->pid, SIGTERM);
 		goto clean_up;
 	}
+	ctx->nr_bytes += size;
 
 	wlr_log(WLR_DEBUG, "[pipemenu %ld] read %ld bytes of data", (long)ctx->pid, size);
 	if (size) {
-		data[size] = '\0';
-		buf_add(&ctx->buf, data);
+		if (!feed_pipemenu_parser(ctx, data, size)) {
+			kill(ctx->pid, SIGTERM);
+			goto clean_up;
+		}
 		return 0;
 	}
 
-	/* Guard against badly formed data such as binary input */
-	if (!starts_with_less_than(ctx->buf.data)) {
-		wlr_log(WLR_ERROR, "expect xml data to start with '<'; abort pipemenu");
+	if (!ctx->parser) {
+		wlr_log(WLR_ERROR, "[pipemenu %ld] no data", (long)ctx->pid);
 		goto clean_up;
 	}
 
-	create_pipe_menu(ctx);
+	/* End of data, finish parsing */
+	if (!feed_pipemenu_parser(ctx, NULL, 0) || !ctx->parser->wellFormed
+			|| !ctx->parser->myDoc) {
+		wlr_log(WLR_ERROR, "[pipemenu %ld] xml data not well-formed",
+			(long)ctx->pid);
+		goto clean_up;
+	}
+
+	create_pipe_menu(ctx, ctx->parser->myDoc);
+	metrics_observe(METRICS_PIPEMENU_DURATION,
+		time_now_nsec() - ctx->spawned_nsec);
 
 clean_up:
 	pipemenu_ctx_destroy(ctx);
@@ -1216,6 +1743,7 @@ parse_pipemenu(struct menuitem *item)
 	}
 
 	int pipe_fd = 0;
+	int64_t spawned_nsec = time_now_nsec();
 	pid_t pid = spawn_piped(item->execute, &pipe_fd);
 	if (pid <= 0) {
 		wlr_log(WLR_ERROR, "Failed to spawn pipe menu process %s", item->execute);
@@ -1228,14 +1756,14 @@ parse_pipemenu(struct menuitem *item)
 	ctx->item = item;
 	ctx->pid = pid;
 	ctx->pipe_fd = pipe_fd;
-	ctx->buf = BUF_INIT;
+	ctx->spawned_nsec = spawned_nsec;
 
 	ctx->event_read = wl_event_loop_add_fd(ctx->server->wl_event_loop,
 		pipe_fd, WL_EVENT_READABLE, handle_pipemenu_readable, ctx);
 
-	ctx->event_timeout = wl_event_loop_add_timer(ctx->server->wl_event_loop,
+	ctx->event_timeout = timers_add(ctx->server->wl_event_loop,
 		handle_pipemenu_timeout, ctx);
-	wl_event_source_timer_update(ctx->event_timeout, PIPEMENU_TIMEOUT_IN_MS);
+	timers_update(ctx->event_timeout, PIPEMENU_TIMEOUT_IN_MS);
 
 	wlr_log(WLR_DEBUG, "[pipemenu %ld] executed: %s", (long)ctx->pid, ctx->item->execute);
 }
@@ -1261,6 +1789,7 @@ menu_process_item_selection(struct menuitem *item)
 
 	/* We are on an item that has new focus */
 	menu_set_selection(item->parent, item);
+	menu_scroll_to_item(item);
 	if (item->parent->selection.menu) {
 		/* Close old submenu tree */
 		menu_close(item->parent->selection.menu);
@@ -1279,8 +1808,8 @@ menu_process_item_selection(struct menuitem *item)
 		/* Ensure the submenu has its parent set correctly */
 		item->submenu->parent = item->parent;
 		/* And open the new submenu tree */
-		wlr_scene_node_set_enabled(
-			&item->submenu->scene_tree->node, true);
+		menu_configure_submenu(item);
+		menu_show(item->submenu);
 	}
 
 	item->parent->selection.menu = item->submenu;
@@ -1318,7 +1847,7 @@ menu_item_select(struct server *server, bool forward)
 	struct menuitem *selection = menu->selection.item;
 	struct wl_list *start = selection ? &selection->link : &menu->menuitems;
 	struct wl_list *current = start;
-	while (!item || !item->selectable) {
+	while (!item || !item->selectable || item->hidden) {
 		current = forward ? current->next : current->prev;
 		if (current == start) {
 			return;
@@ -1406,7 +1935,7 @@ menu_submenu_enter(struct server *server)
 	struct wl_list *start = &menu->selection.menu->menuitems;
 	struct wl_list *current = start;
 	struct menuitem *item = NULL;
-	while (!item || !item->selectable) {
+	while (!item || !item->selectable || !item->tree->node.enabled) {
 		current = current->next;
 		if (current == start) {
 			return;
@@ -1429,6 +1958,160 @@ menu_submenu_leave(struct server *server)
 	menu_process_item_selection(menu->parent->selection.item);
 }
 
+/*
+ * Shows only the items matching the search if @filtered, re-using their
+ * scene nodes, and moves the submenus along with their items.
+ */
+static void
+menu_search_layout(struct menu *menu, bool filtered)
+{
+	int y = 0;
+	struct menuitem *item;
+	wl_list_for_each(item, &menu->menuitems, link) {
+		item->hidden = filtered && !item->search_match;
+		if (!item->hidden) {
+			wlr_scene_node_set_position(&item->tree->node, 0, y);
+			y += item->height;
+		}
+	}
+	menu->size.height = y;
+	menu_set_window(menu, menu->window.max_height);
+	menu_update_window(menu);
+
+	/* Others are positioned when opened */
+	item = menu->selection.item;
+	if (menu->selection.menu && item && item->submenu) {
+		menu_configure_submenu(item);
+	}
+}
+
+/* Marks the items matching @query, returns the first one or NULL */
+static struct menuitem *
+menu_search_match(struct menu *menu, const char *query)
+{
+	struct menuitem *item;
+	wl_list_for_each(item, &menu->menuitems, link) {
+		item->search_match = false;
+	}
+
+	struct search_entry *entries = menu->search_index.data;
+	size_t nr_entries = menu->search_index.size / sizeof(*entries);
+	size_t lo = 0, hi = nr_entries;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (strcmp(entries[mid].word, query) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	size_t len = strlen(query);
+	bool matched = false;
+	for (size_t i = lo; i < nr_entries; i++) {
+		if (strncmp(entries[i].word, query, len)) {
+			break;
+		}
+		entries[i].item->search_match = true;
+		matched = true;
+	}
+	if (!matched) {
+		return NULL;
+	}
+
+	/* The first match in menu order rather than in index order */
+	wl_list_for_each(item, &menu->menuitems, link) {
+		if (item->search_match && item->selectable) {
+			return item;
+		}
+	}
+	return NULL;
+}
+
+static bool
+search_apply(struct menu *menu)
+{
+	struct menuitem *first = menu_search_match(menu, search.query.data);
+	if (!first) {
+		return false;
+	}
+	menu_search_layout(menu, /* filtered */ true);
+	cursor_context_invalidate(menu->server);
+
+	/* Force re-processing so that the submenu of @first is shown */
+	selected_item = NULL;
+	menu_process_item_selection(first);
+	return true;
+}
+
+static void
+search_end(void)
+{
+	struct menu *menu = search.menu;
+	if (!menu) {
+		return;
+	}
+	search.menu = NULL;
+	buf_clear(&search.query);
+	menu_search_layout(menu, /* filtered */ false);
+	cursor_context_invalidate(menu->server);
+}
+
+void
+menu_search_add(struct server *server, const char *text)
+{
+	struct menu *menu = get_selection_leaf(server);
+	if (!menu || waiting_for_pipe_menu) {
+		return;
+	}
+	if (menu != search.menu) {
+		search_end();
+		menu_build_search_index(menu);
+	}
+
+	int len = search.query.len;
+	char *lower = g_utf8_strdown(text, -1);
+	buf_add(&search.query, lower);
+	g_free(lower);
+	if (search_apply(menu)) {
+		search.menu = menu;
+		return;
+	}
+
+	/* Nothing matches, ignore the keystroke */
+	search.query.len = len;
+	search.query.data[len] = '\0';
+}
+
+void
+menu_search_delete(struct server *server)
+{
+	if (!search.menu || !search.query.len) {
+		return;
+	}
+	int len = search.query.len;
+	while (len > 0 && (search.query.data[len - 1] & 0xc0) == 0x80) {
+		len--;
+	}
+	len = MAX(len - 1, 0);
+	search.query.len = len;
+	search.query.data[len] = '\0';
+	if (!len) {
+		search_end();
+		return;
+	}
+	search_apply(search.menu);
+}
+
+bool
+menu_search_clear(struct server *server)
+{
+	if (!search.menu) {
+		return false;
+	}
+	search_end();
+	return true;
+}
+
 /* Mouse based selection */
 void
 menu_process_cursor_motion(struct wlr_scene_node *node)
@@ -1438,6 +2121,40 @@ menu_process_cursor_motion(struct wlr_scene_node *node)
 	menu_process_item_selection(item);
 }
 
+void
+menu_scroll(struct wlr_scene_node *node, int lines)
+{
+	assert(node && node->data);
+	struct menuitem *item = node_menuitem_from_node(node);
+	struct menu *menu = item->parent;
+	if (menu->window.height >= menu->size.height || !lines) {
+		return;
+	}
+
+	/* Step @lines items shown from the topmost one */
+	struct wl_list *link = &item->link;
+	wl_list_for_each(item, &menu->menuitems, link) {
+		if (!item->hidden && item->tree->node.y >= menu->window.offset) {
+			link = &item->link;
+			break;
+		}
+	}
+	struct wl_list *next = link;
+	for (int i = 0; i < abs(lines);) {
+		next = lines > 0 ? next->next : next->prev;
+		if (next == &menu->menuitems) {
+			break;
+		}
+		item = wl_container_of(next, item, link);
+		if (!item->hidden) {
+			link = next;
+			i++;
+		}
+	}
+	item = wl_container_of(link, item, link);
+	menu_scroll_to(menu, item->tree->node.y);
+}
+
 bool
 menu_call_actions(struct wlr_scene_node *node)
 {
@@ -1460,8 +2177,12 @@ menu_close_root(struct server *server)
 }
 
 void
-menu_reconfigure(struct server *server)
+menu_reconfigure(struct server *server, bool force)
 {
+	if (!force && hash_menu_files("menu.xml") == files_hash) {
+		wlr_log(WLR_DEBUG, "menu unchanged, keeping menus");
+		return;
+	}
 	menu_finish(server);
 	server->menu_current = NULL;
 	menu_init(server);
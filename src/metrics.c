@@ -0,0 +1,484 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _GNU_SOURCE /* accept4() */
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/util/log.h>
+#include "common/buf.h"
+#include "common/macros.h"
+#include "common/mem.h"
+#include "common/scaled_scene_buffer.h"
+#include "common/time-helpers.h"
+#include "common/unix-socket.h"
+#include "config/rcxml.h"
+#include "frame-stats.h"
+#include "input/latency.h"
+#include "labwc.h"
+#include "metrics.h"
+#include "realtime.h"
+#include "view.h"
+#include "window-state.h"
+
+/* Connections exceeding this are closed right away */
+#define MAX_CLIENTS (8)
+
+/* Upper bounds of the histogram buckets in ms, +Inf is implicit */
+static const double bucket_bounds_ms[] = {
+	1, 2.5, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000,
+};
+
+struct histogram {
+	uint64_t buckets[ARRAY_SIZE(bucket_bounds_ms) + 1];
+	uint64_t count;
+	int64_t sum_nsec;
+};
+
+struct metrics_client {
+	int fd;
+	struct wl_event_source *source;
+	struct buf data;
+	int written;
+	struct wl_list link; /* metrics.clients */
+};
+
+static const struct {
+	const char *name;
+	const char *help;
+} counter_info[] = {
+	[METRICS_CONFIGURE_TIMEOUTS] = { "labwc_configure_timeouts_total",
+		"Configures not acked by xdg-shell clients in time" },
+	[METRICS_PIPEMENU_TIMEOUTS] = { "labwc_pipemenu_timeouts_total",
+		"Pipemenus killed for not finishing in time" },
+	[METRICS_RECONFIGURES] = { "labwc_reconfigures_total",
+		"Reloads of the configuration and theme" },
+};
+
+static const struct {
+	const char *name;
+	const char *help;
+} histogram_info[] = {
+	[METRICS_PIPEMENU_DURATION] = { "labwc_pipemenu_seconds",
+		"Time from spawning a pipemenu to showing its menu" },
+	[METRICS_RECONFIGURE_DURATION] = { "labwc_reconfigure_seconds",
+		"Time taken by a reload of the configuration and theme" },
+	[METRICS_CONFIGURE_RTT] = { "labwc_configure_rtt_seconds",
+		"Time xdg-shell clients took to ack configure requests" },
+};
+
+static struct {
+	struct server *server;
+	char *path;
+	int fd;
+	struct wl_event_source *source;
+	struct wl_list clients;
+	int nr_clients;
+
+	uint64_t counters[METRICS_NR_COUNTERS];
+	struct histogram histograms[METRICS_NR_HISTOGRAMS];
+} metrics = {
+	.fd = -1,
+};
+
+void
+metrics_count(enum metrics_counter counter)
+{
+	assert(counter < METRICS_NR_COUNTERS);
+	metrics.counters[counter]++;
+}
+
+void
+metrics_observe(enum metrics_histogram histogram, int64_t nsec)
+{
+	assert(histogram < METRICS_NR_HISTOGRAMS);
+	struct histogram *h = &metrics.histograms[histogram];
+	size_t i = 0;
+	while (i < ARRAY_SIZE(bucket_bounds_ms)
+			&& nsec > bucket_bounds_ms[i] * NSEC_PER_MSEC) {
+		i++;
+	}
+	h->buckets[i]++;
+	h->count++;
+	h->sum_nsec += nsec;
+}
+
+static void
+add_header(struct buf *b, const char *name, const char *type,
+		const char *help)
+{
+	buf_add_fmt(b, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void
+add_histogram(struct buf *b, const char *name, const struct histogram *h)
+{
+	uint64_t cumulative = 0;
+	for (size_t i = 0; i < ARRAY_SIZE(bucket_bounds_ms); i++) {
+		cumulative += h->buckets[i];
+		buf_add_fmt(b, "%s_bucket{le=\"%g\"} %llu\n", name,
+			bucket_bounds_ms[i] / 1000.0,
+			(unsigned long long)cumulative);
+	}
+	buf_add_fmt(b, "%s_bucket{le=\"+Inf\"} %llu\n", name,
+		(unsigned long long)h->count);
+	buf_add_fmt(b, "%s_sum %.9f\n%s_count %llu\n", name,
+		(double)h->sum_nsec / NSEC_PER_SEC, name,
+		(unsigned long long)h->count);
+}
+
+static void
+add_frame_stats(struct buf *b, struct server *server)
+{
+	struct output *output;
+	add_header(b, "labwc_frames_total", "counter",
+		"Frames committed per output");
+	wl_list_for_each(output, &server->outputs, link) {
+		buf_add_fmt(b, "labwc_frames_total{output=\"%s\"} %llu\n",
+			output->wlr_output->name,
+			(unsigned long long)output->frame_stats.nr_frames);
+	}
+	add_header(b, "labwc_missed_vblanks_total", "counter",
+		"Frames presented later than one refresh after their commit");
+	wl_list_for_each(output, &server->outputs, link) {
+		buf_add_fmt(b, "labwc_missed_vblanks_total{output=\"%s\"} %llu\n",
+			output->wlr_output->name, (unsigned long long)
+			output->frame_stats.nr_missed_vblanks);
+	}
+
+	static const int quantiles[] = { 50, 95, 99 };
+	add_header(b, "labwc_frame_phase_seconds", "summary",
+		"Time spent per frame phase over the most recent frames");
+	wl_list_for_each(output, &server->outputs, link) {
+		for (int phase = 0; phase < FRAME_STATS_NR_PHASES; phase++) {
+			for (size_t i = 0; i < ARRAY_SIZE(quantiles); i++) {
+				int64_t nsec = frame_stats_percentile(
+					&output->frame_stats, phase,
+					quantiles[i]);
+				buf_add_fmt(b, "labwc_frame_phase_seconds{output="
+					"\"%s\",phase=\"%s\",quantile=\"0.%d\"}"
+					" %.9f\n", output->wlr_output->name,
+					frame_stats_phase_name(phase),
+					quantiles[i],
+					(double)nsec / NSEC_PER_SEC);
+			}
+		}
+	}
+}
+
+static void
+add_scaled_buffer_stats(struct buf *b)
+{
+	struct scaled_scene_buffer_stats stats;
+	scaled_scene_buffer_get_stats(&stats);
+
+	add_header(b, "labwc_scaled_buffer_entries", "gauge",
+		"Buffers cached for decorations, menus and OSDs");
+	buf_add_fmt(b, "labwc_scaled_buffer_entries %zu\n", stats.nr_entries);
+	add_header(b, "labwc_scaled_buffer_bytes", "gauge",
+		"Memory used by cached scaled buffers");
+	buf_add_fmt(b, "labwc_scaled_buffer_bytes %zu\n", stats.memory_used);
+	add_header(b, "labwc_scaled_buffer_lookups_total", "counter",
+		"Lookups of scaled buffers in the cache");
+	buf_add_fmt(b, "labwc_scaled_buffer_lookups_total{result=\"hit\"} %zu\n",
+		stats.nr_hits);
+	buf_add_fmt(b, "labwc_scaled_buffer_lookups_total{result=\"miss\"} %zu\n",
+		stats.nr_misses);
+	add_header(b, "labwc_scaled_buffer_evictions_total", "counter",
+		"Scaled buffers evicted from the cache");
+	buf_add_fmt(b, "labwc_scaled_buffer_evictions_total"
+		"{reason=\"cache_size\"} %zu\n", stats.nr_evictions_cache_size);
+	buf_add_fmt(b, "labwc_scaled_buffer_evictions_total"
+		"{reason=\"budget\"} %zu\n", stats.nr_evictions_budget);
+	buf_add_fmt(b, "labwc_scaled_buffer_evictions_total"
+		"{reason=\"trim\"} %zu\n", stats.nr_evictions_trim);
+}
+
+/* Label values escape backslash, double-quote and line feed */
+static void
+add_label_value(struct buf *b, const char *s)
+{
+	const char *run = s;
+	for (const char *p = s; *p; p++) {
+		if (*p != '\\' && *p != '"' && *p != '\n') {
+			continue;
+		}
+		buf_add_len(b, run, p - run);
+		if (*p == '\n') {
+			buf_add(b, "\\n");
+		} else {
+			buf_add_fmt(b, "\\%c", *p);
+		}
+		run = p + 1;
+	}
+	buf_add(b, run);
+}
+
+static void
+add_views(struct buf *b, struct server *server)
+{
+	int nr_views = 0;
+	int nr_mapped = 0;
+	struct view *view;
+	wl_list_for_each(view, &server->views, link) {
+		nr_views++;
+		nr_mapped += view->mapped;
+	}
+	add_header(b, "labwc_views", "gauge", "Toplevel views");
+	buf_add_fmt(b, "labwc_views{state=\"mapped\"} %d\n", nr_mapped);
+	buf_add_fmt(b, "labwc_views{state=\"unmapped\"} %d\n",
+		nr_views - nr_mapped);
+
+	static const char *const commit_states[] = {
+		[VIEW_COMMIT_SHOWN] = "shown",
+		[VIEW_COMMIT_OCCLUDED] = "occluded",
+		[VIEW_COMMIT_HIDDEN] = "hidden",
+	};
+	add_header(b, "labwc_view_commits_total", "counter",
+		"Surface commits per view by its visibility at the time");
+	wl_list_for_each(view, &server->views, link) {
+		const char *app_id = view_get_app_id(view);
+		for (size_t i = 0; i < ARRAY_SIZE(commit_states); i++) {
+			buf_add_fmt(b, "labwc_view_commits_total{view=\"%llu\","
+				"app_id=\"", (unsigned long long)
+				window_state_view_id(view));
+			add_label_value(b, app_id ? app_id : "");
+			buf_add_fmt(b, "\",state=\"%s\"} %llu\n",
+				commit_states[i],
+				(unsigned long long)view->nr_commits[i]);
+		}
+	}
+}
+
+static void
+add_input_latency(struct buf *b, struct seat *seat)
+{
+	const struct input_latency *latency = &seat->input_latency;
+	const char *name = "labwc_input_to_commit_seconds";
+	add_header(b, name, "histogram",
+		"Time from input events to the output commit showing them");
+
+	uint64_t cumulative = 0;
+	for (size_t i = 0; i < INPUT_LATENCY_NR_BUCKETS - 1; i++) {
+		cumulative += latency->buckets[i];
+		buf_add_fmt(b, "%s_bucket{seat=\"%s\",le=\"%g\"} %llu\n",
+			name, seat->seat->name, (double)(1UL << i) / 1000.0,
+			(unsigned long long)cumulative);
+	}
+	buf_add_fmt(b, "%s_bucket{seat=\"%s\",le=\"+Inf\"} %llu\n", name,
+		seat->seat->name, (unsigned long long)latency->nr_samples);
+	buf_add_fmt(b, "%s_sum{seat=\"%s\"} %.9f\n", name, seat->seat->name,
+		(double)latency->total_nsec / NSEC_PER_SEC);
+	buf_add_fmt(b, "%s_count{seat=\"%s\"} %llu\n", name, seat->seat->name,
+		(unsigned long long)latency->nr_samples);
+}
+
+static void
+add_process_stats(struct buf *b)
+{
+	add_header(b, "labwc_realtime", "gauge",
+		"Whether the compositor thread runs with SCHED_RR");
+	buf_add_fmt(b, "labwc_realtime %d\n", realtime_is_active());
+
+	struct rusage usage;
+	if (!getrusage(RUSAGE_SELF, &usage)) {
+		add_header(b, "labwc_page_faults_total", "counter",
+			"Page faults of labwc, major ones needed I/O");
+		buf_add_fmt(b, "labwc_page_faults_total{type=\"minor\"} %ld\n",
+			usage.ru_minflt);
+		buf_add_fmt(b, "labwc_page_faults_total{type=\"major\"} %ld\n",
+			usage.ru_majflt);
+		add_header(b, "labwc_context_switches_total", "counter",
+			"Context switches, involuntary ones are preemptions");
+		buf_add_fmt(b, "labwc_context_switches_total"
+			"{type=\"voluntary\"} %ld\n", usage.ru_nvcsw);
+		buf_add_fmt(b, "labwc_context_switches_total"
+			"{type=\"involuntary\"} %ld\n", usage.ru_nivcsw);
+	}
+
+	/* Time on the CPU, runnable but waiting for it, number of slices */
+	unsigned long long run_nsec, wait_nsec, nr_slices;
+	FILE *stream = fopen("/proc/thread-self/schedstat", "r");
+	if (!stream) {
+		return;
+	}
+	if (fscanf(stream, "%llu %llu %llu", &run_nsec, &wait_nsec,
+			&nr_slices) == 3) {
+		add_header(b, "labwc_sched_wait_seconds_total", "counter",
+			"Time the compositor thread was runnable but not running");
+		buf_add_fmt(b, "labwc_sched_wait_seconds_total %.9f\n",
+			(double)wait_nsec / NSEC_PER_SEC);
+		add_header(b, "labwc_sched_timeslices_total", "counter",
+			"Times the compositor thread was scheduled");
+		buf_add_fmt(b, "labwc_sched_timeslices_total %llu\n",
+			nr_slices);
+	}
+	fclose(stream);
+}
+
+static void
+format_metrics(struct buf *b)
+{
+	for (size_t i = 0; i < METRICS_NR_COUNTERS; i++) {
+		add_header(b, counter_info[i].name, "counter",
+			counter_info[i].help);
+		buf_add_fmt(b, "%s %llu\n", counter_info[i].name,
+			(unsigned long long)metrics.counters[i]);
+	}
+	for (size_t i = 0; i < METRICS_NR_HISTOGRAMS; i++) {
+		add_header(b, histogram_info[i].name, "histogram",
+			histogram_info[i].help);
+		add_histogram(b, histogram_info[i].name,
+			&metrics.histograms[i]);
+	}
+	add_frame_stats(b, metrics.server);
+	add_scaled_buffer_stats(b);
+	add_views(b, metrics.server);
+	add_input_latency(b, &metrics.server->seat);
+	add_process_stats(b);
+}
+
+static void
+client_destroy(struct metrics_client *client)
+{
+	if (client->source) {
+		wl_event_source_remove(client->source);
+	}
+	close(client->fd);
+	buf_reset(&client->data);
+	wl_list_remove(&client->link);
+	metrics.nr_clients--;
+	free(client);
+}
+
+/* Returns false once the client is done with, either way */
+static bool
+client_write(struct metrics_client *client)
+{
+	while (client->written < client->data.len) {
+		ssize_t ret = write(client->fd,
+			client->data.data + client->written,
+			client->data.len - client->written);
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+		if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return true;
+		}
+		if (ret <= 0) {
+			return false;
+		}
+		client->written += ret;
+	}
+	return false;
+}
+
+static int
+handle_client_writable(int fd, uint32_t mask, void *data)
+{
+	struct metrics_client *client = data;
+	if (!(mask & WL_EVENT_WRITABLE) || !client_write(client)) {
+		client_destroy(client);
+	}
+	return 0;
+}
+
+static int
+handle_connection(int fd, uint32_t mask, void *data)
+{
+	int client_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (client_fd < 0) {
+		return 0;
+	}
+	if (metrics.nr_clients >= MAX_CLIENTS) {
+		close(client_fd);
+		return 0;
+	}
+
+	struct metrics_client *client = znew(*client);
+	client->fd = client_fd;
+	client->data = BUF_INIT;
+	wl_list_insert(&metrics.clients, &client->link);
+	metrics.nr_clients++;
+
+	format_metrics(&client->data);
+	if (!client_write(client)) {
+		client_destroy(client);
+		return 0;
+	}
+	/* The rest is written whenever the reader catches up */
+	client->source = wl_event_loop_add_fd(metrics.server->wl_event_loop,
+		client_fd, WL_EVENT_WRITABLE, handle_client_writable, client);
+	if (!client->source) {
+		client_destroy(client);
+	}
+	return 0;
+}
+
+static void
+close_socket(void)
+{
+	struct metrics_client *client, *tmp;
+	wl_list_for_each_safe(client, tmp, &metrics.clients, link) {
+		client_destroy(client);
+	}
+	if (metrics.source) {
+		wl_event_source_remove(metrics.source);
+		metrics.source = NULL;
+	}
+	if (metrics.fd >= 0) {
+		close(metrics.fd);
+		unlink(metrics.path);
+		metrics.fd = -1;
+	}
+	zfree(metrics.path);
+}
+
+static bool
+open_socket(const char *path)
+{
+	int fd = unix_socket_listen(path, MAX_CLIENTS);
+	if (fd < 0) {
+		return false;
+	}
+	metrics.fd = fd;
+	metrics.path = xstrdup(path);
+	metrics.source = wl_event_loop_add_fd(metrics.server->wl_event_loop,
+		fd, WL_EVENT_READABLE, handle_connection, NULL);
+	wlr_log(WLR_INFO, "serving metrics on %s", path);
+	return true;
+}
+
+void
+metrics_init(struct server *server)
+{
+	if (!metrics.clients.next) {
+		wl_list_init(&metrics.clients);
+	}
+	metrics.server = server;
+
+	struct buf path = BUF_INIT;
+	unix_socket_path(&path, rc.metrics_socket);
+
+	if (metrics.path && !strcmp(metrics.path, path.data)) {
+		goto out;
+	}
+	close_socket();
+	if (rc.metrics_socket) {
+		open_socket(path.data);
+	}
+out:
+	buf_reset(&path);
+}
+
+void
+metrics_finish(void)
+{
+	if (metrics.clients.next) {
+		close_socket();
+	}
+}
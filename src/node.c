@@ -4,6 +4,9 @@
 #include "common/mem.h"
 #include "node.h"
 
+/* Every tagged scene node has one, so they come and go with every view */
+static struct pool descriptor_pool = POOL_INIT(struct node_descriptor);
+
 static void
 descriptor_destroy(struct node_descriptor *node_descriptor)
 {
@@ -11,7 +14,7 @@ descriptor_destroy(struct node_descriptor *node_descriptor)
 		return;
 	}
 	wl_list_remove(&node_descriptor->destroy.link);
-	free(node_descriptor);
+	pool_free(&descriptor_pool, node_descriptor);
 }
 
 static void
@@ -26,7 +29,7 @@ void
 node_descriptor_create(struct wlr_scene_node *scene_node,
 		enum node_descriptor_type type, void *data)
 {
-	struct node_descriptor *node_descriptor = znew(*node_descriptor);
+	struct node_descriptor *node_descriptor = pool_alloc(&descriptor_pool);
 	node_descriptor->type = type;
 	node_descriptor->data = data;
 	node_descriptor->destroy.notify = destroy_notify;
@@ -1,26 +1,87 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include "config.h"
 #include <assert.h>
-#include <cairo.h>
 #include <drm_fourcc.h>
-#include <pango/pangocairo.h>
+#include <string.h>
 #include <wlr/util/log.h>
 #include <wlr/util/box.h>
-#include "buffer.h"
 #include "common/array.h"
 #include "common/buf.h"
 #include "common/font.h"
 #include "common/graphic-helpers.h"
+#include "common/macros.h"
+#include "common/mem.h"
+#include "common/scaled_font_buffer.h"
 #include "common/scene-helpers.h"
 #include "config/rcxml.h"
 #include "labwc.h"
 #include "node.h"
 #include "osd.h"
+#include "profile.h"
 #include "theme.h"
+#include "thumbnail.h"
+#include "trace.h"
 #include "view.h"
 #include "window-rules.h"
 #include "workspaces.h"
 
+/*
+ * The window switcher is kept as a retained scene while cycling: the
+ * background and border are solid rects, the workspace indicator and each
+ * field of an item row are scaled_font_buffers and the highlight is a
+ * separate outline. Advancing the selection
+ * only moves the highlight and re-renders rows whose content has changed.
+ *
+ * There are only as many rows as fit on the output. With more windows,
+ * the rows show a window of the list which scrolls along with the
+ * selection, and a row is re-rendered for the view scrolled into it.
+ */
+struct osd_scene_item {
+	struct view *view;
+	struct wlr_scene_tree *tree;
+	char *content; /* all fields, used to detect changes */
+	/* Snapshot left of the fields with <windowSwitcher thumbnails=""> */
+	struct wlr_scene_buffer *thumbnail;
+};
+
+/*
+ * Thumbnails are rendered in small batches so that opening the window
+ * switcher with many windows does not stall the compositor. Outdated
+ * ones, like those of a playing video, are refreshed at a lower rate.
+ */
+#define THUMBNAIL_RENDERS_PER_BATCH (4)
+#define THUMBNAIL_REFRESH_MS (50)
+
+/* Logical size of the thumbnail area of a row, 0x0 if disabled */
+static void
+get_thumbnail_size(struct theme *theme, int *width, int *height)
+{
+	*width = 0;
+	*height = 0;
+	if (!rc.window_switcher.thumbnails) {
+		return;
+	}
+	*height = theme->osd_window_switcher_item_height
+		- 2 * theme->osd_window_switcher_item_padding_y;
+	*width = *height * 3 / 2;
+}
+
+static void
+osd_scene_reset(struct output *output)
+{
+	struct osd_scene_item *item;
+	wl_array_for_each(item, &output->osd_scene.items) {
+		free(item->content);
+	}
+	wl_array_release(&output->osd_scene.items);
+	wl_array_init(&output->osd_scene.items);
+	output->osd_scene.tree = NULL;
+	output->osd_scene.highlight = NULL;
+	output->osd_scene.first = 0;
+	output->osd_scene.width = 0;
+	output->osd_scene.height = 0;
+}
+
 static void
 destroy_osd_nodes(struct output *output)
 {
@@ -29,6 +90,7 @@ destroy_osd_nodes(struct output *output)
 	wl_list_for_each_safe(child, next, children, link) {
 		wlr_scene_node_destroy(child);
 	}
+	osd_scene_reset(output);
 }
 
 static void
@@ -44,8 +106,8 @@ osd_update_preview_outlines(struct view *view)
 			server->theme->osd_window_switcher_preview_border_color[1],
 			server->theme->osd_window_switcher_preview_border_color[2],
 		};
-		rect = multi_rect_create(&server->scene->tree, colors, line_width);
-		wlr_scene_node_place_above(&rect->tree->node, &server->menu_tree->node);
+		rect = multi_rect_create(server->osd_preview_tree, colors,
+			line_width);
 		server->osd_state.preview_outline = rect;
 	}
 
@@ -60,6 +122,9 @@ osd_on_view_destroy(struct view *view)
 	assert(view);
 	struct osd_state *osd_state = &view->server->osd_state;
 
+	/* The view is still in server->views but about to go away */
+	osd_invalidate_views(view->server);
+
 	if (!osd_state->cycle_view) {
 		/* OSD not active, no need for clean up */
 		return;
@@ -88,6 +153,7 @@ osd_on_view_destroy(struct view *view)
 	if (osd_state->cycle_view) {
 		/* Update the OSD to reflect the view has now gone. */
 		osd_update(view->server);
+		osd_invalidate_views(view->server);
 	}
 
 	if (view->scene_tree) {
@@ -102,12 +168,55 @@ osd_on_view_destroy(struct view *view)
 	}
 }
 
+struct wl_array *
+osd_cycle_views(struct server *server)
+{
+	struct osd_state *osd_state = &server->osd_state;
+	if (!osd_state->views_valid) {
+		/* The cache outlives the scratch memory, so copy it */
+		struct wl_array views;
+		wl_array_init(&views);
+		view_array_append(server, &views, rc.window_switcher.criteria);
+		wl_array_copy(&osd_state->views, &views);
+		osd_state->views_valid = true;
+	}
+	return &osd_state->views;
+}
+
+void
+osd_invalidate_views(struct server *server)
+{
+	server->osd_state.views_valid = false;
+}
+
+void
+osd_invalidate_scene(struct server *server)
+{
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		destroy_osd_nodes(output);
+	}
+	if (server->osd_state.cycle_view) {
+		/* Rebuild the OSD which is on screen right away */
+		osd_update(server);
+	}
+}
+
 void
 osd_finish(struct server *server)
 {
 	server->osd_state.preview_node = NULL;
 	server->osd_state.preview_anchor = NULL;
 
+	wl_array_release(&server->osd_state.views);
+	wl_array_init(&server->osd_state.views);
+	server->osd_state.views_valid = false;
+
+	if (server->osd_state.thumbnail_timer) {
+		wl_event_source_remove(server->osd_state.thumbnail_timer);
+		server->osd_state.thumbnail_timer = NULL;
+	}
+
 	struct output *output;
 	wl_list_for_each(output, &server->outputs, link) {
 		destroy_osd_nodes(output);
@@ -118,6 +227,10 @@ osd_finish(struct server *server)
 		wlr_scene_node_destroy(&server->osd_state.preview_outline->tree->node);
 		server->osd_state.preview_outline = NULL;
 	}
+	if (server->osd_state.preview_snapshot) {
+		wlr_scene_node_destroy(&server->osd_state.preview_snapshot->node);
+		server->osd_state.preview_snapshot = NULL;
+	}
 
 	/* Hiding OSD may need a cursor change */
 	cursor_update_focus(server);
@@ -136,9 +249,15 @@ void
 osd_preview_restore(struct server *server)
 {
 	struct osd_state *osd_state = &server->osd_state;
+	if (osd_state->preview_snapshot) {
+		wlr_scene_node_set_enabled(&osd_state->preview_snapshot->node,
+			false);
+	}
 	if (osd_state->preview_node) {
 		wlr_scene_node_reparent(osd_state->preview_node,
 			osd_state->preview_parent);
+		view_invalidate_criteria(server,
+			node_view_from_node(osd_state->preview_node));
 
 		if (osd_state->preview_anchor) {
 			wlr_scene_node_place_above(osd_state->preview_node,
@@ -168,6 +287,9 @@ preview_cycled_view(struct view *view)
 	/* Move previous selected node back to its original place */
 	osd_preview_restore(view->server);
 
+	/* The view is moved out of its layer tree below */
+	view_invalidate_criteria(view->server, view);
+
 	/* Store some pointers so we can reset the preview later on */
 	osd_state->preview_node = &view->scene_tree->node;
 	osd_state->preview_parent = view->scene_tree->node.parent;
@@ -187,141 +309,305 @@ preview_cycled_view(struct view *view)
 		wlr_scene_node_set_enabled(osd_state->preview_node, true);
 	}
 
-	/*
-	 * FIXME: This abuses an implementation detail of the always-on-top tree.
-	 *        Create a permanent server->osd_preview_tree instead that can
-	 *        also be used as parent for the preview outlines.
-	 */
 	wlr_scene_node_reparent(osd_state->preview_node,
-		view->server->view_tree_always_on_top);
+		view->server->osd_preview_tree);
 
-	/* Finally raise selected node to the top */
-	wlr_scene_node_raise_to_top(osd_state->preview_node);
+	/* Below the outline */
+	wlr_scene_node_lower_to_bottom(osd_state->preview_node);
 }
 
+/*
+ * Shows a snapshot of the view above all others instead of moving the
+ * view itself, which would restack it and damage both of its places on
+ * every step. The snapshot is kept until the view commits again.
+ */
 static void
-render_osd(struct server *server, cairo_t *cairo, int w, int h,
-		bool show_workspace, const char *workspace_name,
-		struct wl_array *views)
+preview_snapshot(struct view *view)
 {
-	struct view *cycle_view = server->osd_state.cycle_view;
-	struct theme *theme = server->theme;
-
-	cairo_surface_t *surf = cairo_get_target(cairo);
+	assert(view);
+	struct server *server = view->server;
+	struct osd_state *osd_state = &server->osd_state;
+	if (!osd_state->preview_snapshot) {
+		osd_state->preview_snapshot =
+			wlr_scene_buffer_create(server->osd_preview_tree, NULL);
+		if (!osd_state->preview_snapshot) {
+			return;
+		}
+		wlr_scene_node_lower_to_bottom(
+			&osd_state->preview_snapshot->node);
+	}
+	struct wlr_scene_buffer *snapshot = osd_state->preview_snapshot;
+
+	float scale = view->output ? view->output->wlr_output->scale : 1;
+	int width = view->surface ? view->surface->current.width : 0;
+	int height = view->surface ? view->surface->current.height : 0;
+	int budget = 1;
+	struct wlr_buffer *buffer = NULL;
+	if (width > 0 && height > 0) {
+		buffer = thumbnail_get(view, width * scale, height * scale,
+			&budget);
+	}
+	wlr_scene_buffer_set_buffer(snapshot, buffer);
+	wlr_scene_node_set_enabled(&snapshot->node, !!buffer);
+	if (!buffer) {
+		return;
+	}
 
-	/* Draw background */
-	set_cairo_color(cairo, theme->osd_bg_color);
-	cairo_rectangle(cairo, 0, 0, w, h);
-	cairo_fill(cairo);
+	/* Where the surface of the view is shown, also when minimized */
+	int lx, ly;
+	wlr_scene_node_coords(view->scene_node, &lx, &ly);
+	wlr_scene_buffer_set_dest_size(snapshot, width, height);
+	wlr_scene_node_set_position(&snapshot->node, lx, ly);
+}
 
-	/* Draw border */
-	set_cairo_color(cairo, theme->osd_border_color);
-	struct wlr_fbox fbox = {
-		.width = w,
-		.height = h,
-	};
-	draw_cairo_border(cairo, fbox, theme->osd_border_width);
+static void
+create_osd_background(struct wlr_scene_tree *parent, struct theme *theme,
+		int w, int h, bool show_workspace, const char *workspace_name)
+{
+	/* Background and border are plain rects, no pixels to upload */
+	wlr_scene_rect_create(parent, w, h, theme->osd_bg_color);
+	outline_rect_create(parent, w, h, theme->osd_border_width,
+		theme->osd_border_color);
 
-	/* Set up text rendering */
-	set_cairo_color(cairo, theme->osd_label_text_color);
-	PangoLayout *layout = pango_cairo_create_layout(cairo);
-	pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_END);
+	/* Workspace indicator */
+	if (show_workspace) {
+		struct scaled_font_buffer *label =
+			scaled_font_buffer_create(parent);
+		if (!label) {
+			return;
+		}
+		struct font font = rc.font_osd;
+		font.weight = FONT_WEIGHT_BOLD;
+		int max_width = w - 2 * theme->osd_border_width
+			- 2 * theme->osd_window_switcher_padding;
+		scaled_font_buffer_update(label, workspace_name, max_width,
+			&font, theme->osd_label_text_color,
+			theme->osd_bg_color, NULL);
 
-	PangoFontDescription *desc = font_to_pango_desc(&rc.font_osd);
-	pango_layout_set_font_description(layout, desc);
+		/* Center workspace indicator on the x axis */
+		int x = (w - label->width) / 2;
+		int y = theme->osd_border_width + theme->osd_window_switcher_padding
+			+ theme->osd_window_switcher_item_active_border_width;
+		wlr_scene_node_set_position(&label->scene_buffer->node, x, y);
+	}
+}
 
-	pango_cairo_update_layout(cairo, layout);
+static void
+get_item_content(struct view *view, struct buf *content)
+{
+	struct buf field_buf = BUF_INIT;
+	struct window_switcher_field *field;
+
+	buf_clear(content);
+	wl_list_for_each(field, &rc.window_switcher.fields, link) {
+		buf_clear(&field_buf);
+		osd_field_get_content(field, &field_buf, view);
+		/* Separate fields by a unit separator */
+		buf_add_len(content, field_buf.data, field_buf.len);
+		buf_add_char(content, '\x1f');
+	}
+	buf_reset(&field_buf);
+}
 
-	int y = theme->osd_border_width + theme->osd_window_switcher_padding;
+static void
+render_item_fields(struct osd_scene_item *item, struct theme *theme,
+		int available_width)
+{
+	/* Remove previous fields */
+	struct wlr_scene_node *child, *next;
+	wl_list_for_each_safe(child, next, &item->tree->children, link) {
+		wlr_scene_node_destroy(child);
+	}
 
-	/* Draw workspace indicator */
-	if (show_workspace) {
-		/* Center workspace indicator on the x axis */
-		int x = font_width(&rc.font_osd, workspace_name);
-		x = (w - x) / 2;
-		cairo_move_to(cairo, x, y + theme->osd_window_switcher_item_active_border_width);
-		PangoWeight weight = pango_font_description_get_weight(desc);
-		pango_font_description_set_weight(desc, PANGO_WEIGHT_BOLD);
-		pango_layout_set_font_description(layout, desc);
-		pango_layout_set_text(layout, workspace_name, -1);
-		pango_cairo_show_layout(cairo, layout);
-		pango_font_description_set_weight(desc, weight);
-		pango_layout_set_font_description(layout, desc);
-		y += theme->osd_window_switcher_item_height;
+	int thumbnail_width, thumbnail_height;
+	get_thumbnail_size(theme, &thumbnail_width, &thumbnail_height);
+	if (thumbnail_width) {
+		available_width -= thumbnail_width
+			+ theme->osd_window_switcher_item_padding_x;
 	}
-	pango_font_description_free(desc);
+	int x = theme->osd_window_switcher_item_padding_x;
+	if (thumbnail_width) {
+		x += thumbnail_width + theme->osd_window_switcher_item_padding_x;
+	}
+	int y = theme->osd_window_switcher_item_padding_y;
 
 	struct buf buf = BUF_INIT;
+	int nr_fields = wl_list_length(&rc.window_switcher.fields);
+	struct window_switcher_field *field;
+	wl_list_for_each(field, &rc.window_switcher.fields, link) {
+		int field_width = (available_width - (nr_fields + 1)
+			* theme->osd_window_switcher_item_padding_x)
+			* field->width / 100.0;
+
+		buf_clear(&buf);
+		osd_field_get_content(field, &buf, item->view);
+		if (buf.len && field_width > 0) {
+			struct scaled_font_buffer *font_buffer =
+				scaled_font_buffer_create(item->tree);
+			if (font_buffer) {
+				scaled_font_buffer_update(font_buffer, buf.data,
+					field_width, &rc.font_osd,
+					theme->osd_label_text_color,
+					theme->osd_bg_color, NULL);
+				wlr_scene_node_set_position(
+					&font_buffer->scene_buffer->node, x, y);
+			}
+		}
+		x += field_width + theme->osd_window_switcher_item_padding_x;
+	}
+	buf_reset(&buf);
+}
 
-	/* This is the width of the area available for text fields */
-	int available_width = w - 2 * theme->osd_border_width
-		- 2 * theme->osd_window_switcher_padding
-		- 2 * theme->osd_window_switcher_item_active_border_width;
+static bool
+osd_scene_matches(struct output *output, size_t nr_rows, int w, int h)
+{
+	struct osd_scene *scene = &output->osd_scene;
+	return scene->tree && scene->width == w && scene->height == h
+		&& scene->items.size / sizeof(struct osd_scene_item) == nr_rows;
+}
 
-	/* Draw text for each node */
-	struct view **view;
-	wl_array_for_each(view, views) {
-		/*
-		 *    OSD border
-		 * +---------------------------------+
-		 * |                                 |
-		 * |  item border                    |
-		 * |+-------------------------------+|
-		 * ||                               ||
-		 * ||padding between each field     ||
-		 * ||| field-1 | field-2 | field-n |||
-		 * ||                               ||
-		 * ||                               ||
-		 * |+-------------------------------+|
-		 * |                                 |
-		 * |                                 |
-		 * +---------------------------------+
-		 */
-		int x = theme->osd_border_width
-			+ theme->osd_window_switcher_padding
-			+ theme->osd_window_switcher_item_active_border_width
-			+ theme->osd_window_switcher_item_padding_x;
+static void
+create_osd_scene(struct output *output, size_t nr_rows, int w, int h,
+		bool show_workspace)
+{
+	struct server *server = output->server;
+	struct theme *theme = server->theme;
+	struct osd_scene *scene = &output->osd_scene;
+	const char *workspace_name = server->workspace_current->name;
 
-		int nr_fields = wl_list_length(&rc.window_switcher.fields);
-		struct window_switcher_field *field;
-		wl_list_for_each(field, &rc.window_switcher.fields, link) {
-			buf_clear(&buf);
-			cairo_move_to(cairo, x, y
-				+ theme->osd_window_switcher_item_padding_y
-				+ theme->osd_window_switcher_item_active_border_width);
+	destroy_osd_nodes(output);
+
+	scene->tree = wlr_scene_tree_create(output->osd_tree);
+	scene->width = w;
+	scene->height = h;
+	create_osd_background(scene->tree, theme, w, h, show_workspace,
+		workspace_name);
 
-			osd_field_get_content(field, &buf, *view);
+	int x = theme->osd_border_width + theme->osd_window_switcher_padding
+		+ theme->osd_window_switcher_item_active_border_width;
+	int y = theme->osd_border_width + theme->osd_window_switcher_padding
+		+ theme->osd_window_switcher_item_active_border_width;
+	if (show_workspace) {
+		y += theme->osd_window_switcher_item_height;
+	}
 
-			int field_width = (available_width - (nr_fields + 1)
-				* theme->osd_window_switcher_item_padding_x)
-				* field->width / 100.0;
-			pango_layout_set_width(layout, field_width * PANGO_SCALE);
-			pango_layout_set_text(layout, buf.data, -1);
-			pango_cairo_show_layout(cairo, layout);
-			x += field_width + theme->osd_window_switcher_item_padding_x;
+	int thumbnail_width, thumbnail_height;
+	get_thumbnail_size(theme, &thumbnail_width, &thumbnail_height);
+
+	for (size_t i = 0; i < nr_rows; i++) {
+		struct osd_scene_item *item =
+			wl_array_add(&scene->items, sizeof(*item));
+		*item = (struct osd_scene_item){
+			.tree = wlr_scene_tree_create(scene->tree),
+		};
+		wlr_scene_node_set_position(&item->tree->node, x, y);
+		if (thumbnail_width > 0 && thumbnail_height > 0) {
+			item->thumbnail = wlr_scene_buffer_create(scene->tree,
+				NULL);
 		}
+		y += theme->osd_window_switcher_item_height;
+	}
 
-		if (*view == cycle_view) {
-			/* Highlight current window */
-			struct wlr_fbox fbox = {
-				.x = theme->osd_border_width + theme->osd_window_switcher_padding,
-				.y = y,
-				.width = w
-					- 2 * theme->osd_border_width
-					- 2 * theme->osd_window_switcher_padding,
-				.height = theme->osd_window_switcher_item_height,
-			};
-			draw_cairo_border(cairo, fbox,
-				theme->osd_window_switcher_item_active_border_width);
-			cairo_stroke(cairo);
+	/*
+	 *    OSD border
+	 * +---------------------------------+
+	 * |                                 |
+	 * |  item border                    |
+	 * |+-------------------------------+|
+	 * ||                               ||
+	 * ||padding between each field     ||
+	 * ||| field-1 | field-2 | field-n |||
+	 * ||                               ||
+	 * ||                               ||
+	 * |+-------------------------------+|
+	 * |                                 |
+	 * |                                 |
+	 * +---------------------------------+
+	 */
+	scene->highlight = outline_rect_create(scene->tree,
+		w - 2 * theme->osd_border_width
+			- 2 * theme->osd_window_switcher_padding,
+		theme->osd_window_switcher_item_height,
+		theme->osd_window_switcher_item_active_border_width,
+		theme->osd_label_text_color);
+}
+
+/* Returns false if some thumbnails are left outdated */
+static bool
+update_thumbnails(struct output *output, int *budget)
+{
+	struct theme *theme = output->server->theme;
+	struct osd_scene *scene = &output->osd_scene;
+	int width, height;
+	get_thumbnail_size(theme, &width, &height);
+	float scale = output->wlr_output->scale;
+	int max_width = width * scale;
+	int max_height = height * scale;
+
+	bool current = true;
+	struct osd_scene_item *item;
+	wl_array_for_each(item, &scene->items) {
+		if (!item->thumbnail || !item->view) {
+			continue;
+		}
+		struct wlr_buffer *buffer = thumbnail_get(item->view,
+			max_width, max_height, budget);
+		current &= thumbnail_is_current(item->view, max_width,
+			max_height);
+		if (buffer == item->thumbnail->buffer) {
+			continue;
+		}
+		wlr_scene_buffer_set_buffer(item->thumbnail, buffer);
+		if (!buffer) {
+			continue;
 		}
+		/* Center the snapshot, which keeps the aspect ratio */
+		int w = buffer->width / scale;
+		int h = buffer->height / scale;
+		wlr_scene_buffer_set_dest_size(item->thumbnail, w, h);
+		wlr_scene_node_set_position(&item->thumbnail->node,
+			item->tree->node.x
+				+ theme->osd_window_switcher_item_padding_x
+				+ (width - w) / 2,
+			item->tree->node.y
+				+ theme->osd_window_switcher_item_padding_y
+				+ (height - h) / 2);
+	}
+	return current;
+}
 
-		y += theme->osd_window_switcher_item_height;
+static int
+handle_thumbnail_timer(void *data)
+{
+	struct server *server = data;
+	if (!server->osd_state.cycle_view) {
+		return 0;
 	}
-	buf_reset(&buf);
-	g_object_unref(layout);
+	int budget = THUMBNAIL_RENDERS_PER_BATCH;
+	bool current = true;
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (output->osd_scene.tree) {
+			current &= update_thumbnails(output, &budget);
+		}
+	}
+	if (!current) {
+		/* Render the rest right away, but refresh live ones slowly */
+		wl_event_source_timer_update(server->osd_state.thumbnail_timer,
+			budget > 0 ? THUMBNAIL_REFRESH_MS : 1);
+	}
+	return 0;
+}
 
-	cairo_surface_flush(surf);
+static void
+schedule_thumbnail_update(struct server *server)
+{
+	struct osd_state *osd_state = &server->osd_state;
+	if (!osd_state->thumbnail_timer) {
+		osd_state->thumbnail_timer = wl_event_loop_add_timer(
+			server->wl_event_loop, handle_thumbnail_timer, server);
+	}
+	wl_event_source_timer_update(osd_state->thumbnail_timer, 1);
 }
 
 static void
@@ -329,40 +615,78 @@ display_osd(struct output *output, struct wl_array *views)
 {
 	struct server *server = output->server;
 	struct theme *theme = server->theme;
+	struct osd_scene *scene = &output->osd_scene;
 	bool show_workspace = wl_list_length(&rc.workspace_config.workspaces) > 1;
-	const char *workspace_name = server->workspace_current->name;
 
-	float scale = output->wlr_output->scale;
 	int w = theme->osd_window_switcher_width;
 	if (theme->osd_window_switcher_width_is_percent) {
 		w = output->wlr_output->width / output->wlr_output->scale
 			* theme->osd_window_switcher_width / 100;
 	}
-	int h = wl_array_len(views) * rc.theme->osd_window_switcher_item_height
-		+ 2 * rc.theme->osd_border_width
+	int h = 2 * rc.theme->osd_border_width
 		+ 2 * rc.theme->osd_window_switcher_padding;
 	if (show_workspace) {
 		/* workspace indicator */
 		h += theme->osd_window_switcher_item_height;
 	}
 
-	/* Reset buffer */
-	if (output->osd_buffer) {
-		wlr_buffer_drop(&output->osd_buffer->base);
+	/* Only as many rows as fit on the output */
+	size_t nr_views = wl_array_len(views);
+	int max_rows = (output->usable_area.height - h)
+		/ theme->osd_window_switcher_item_height;
+	size_t nr_rows = MIN(nr_views, (size_t)MAX(max_rows, 1));
+	h += nr_rows * theme->osd_window_switcher_item_height;
+
+	if (!osd_scene_matches(output, nr_rows, w, h)) {
+		create_osd_scene(output, nr_rows, w, h, show_workspace);
+		if (!scene->tree) {
+			return;
+		}
 	}
-	output->osd_buffer = buffer_create_cairo(w, h, scale, true);
-	if (!output->osd_buffer) {
-		wlr_log(WLR_ERROR, "Failed to allocate cairo buffer for the window switcher");
-		return;
+
+	/* Scroll the rows just enough to show the selected view */
+	struct view **all = views->data;
+	size_t selected = 0;
+	while (selected < nr_views
+			&& all[selected] != server->osd_state.cycle_view) {
+		selected++;
 	}
+	if (selected < scene->first) {
+		scene->first = selected;
+	} else if (selected < nr_views && selected >= scene->first + nr_rows) {
+		scene->first = selected - nr_rows + 1;
+	}
+	scene->first = MIN(scene->first, nr_views - nr_rows);
 
-	/* Render OSD image */
-	cairo_t *cairo = output->osd_buffer->cairo;
-	render_osd(server, cairo, w, h, show_workspace, workspace_name, views);
+	/* This is the width of the area available for text fields */
+	int available_width = w - 2 * theme->osd_border_width
+		- 2 * theme->osd_window_switcher_padding
+		- 2 * theme->osd_window_switcher_item_active_border_width;
 
-	struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_create(
-		output->osd_tree, &output->osd_buffer->base);
-	wlr_scene_buffer_set_dest_size(scene_buffer, w, h);
+	/* Only re-render rows which show a different view or content */
+	struct buf content = BUF_INIT;
+	struct osd_scene_item *item = scene->items.data;
+	for (size_t i = 0; i < nr_rows; i++) {
+		struct view **view = &all[scene->first + i];
+		get_item_content(*view, &content);
+		if (item->view != *view || !item->content
+				|| strcmp(item->content, content.data)) {
+			item->view = *view;
+			free(item->content);
+			item->content = xstrdup(content.data);
+			render_item_fields(item, theme, available_width);
+		}
+		if (*view == server->osd_state.cycle_view) {
+			/* Highlight current window */
+			wlr_scene_node_set_position(&scene->highlight->node,
+				theme->osd_border_width
+					+ theme->osd_window_switcher_padding,
+				item->tree->node.y
+					- theme->osd_window_switcher_item_active_border_width);
+		}
+		item++;
+	}
+	buf_reset(&content);
 
 	/* Center OSD */
 	struct wlr_box output_box;
@@ -372,21 +696,27 @@ display_osd(struct output *output, struct wl_array *views)
 		- w / 2 + output_box.x;
 	int ly = output->usable_area.y + output->usable_area.height / 2
 		- h / 2 + output_box.y;
-	wlr_scene_node_set_position(&scene_buffer->node, lx, ly);
+	wlr_scene_node_set_position(&scene->tree->node, lx, ly);
 	wlr_scene_node_set_enabled(&output->osd_tree->node, true);
 
 	/* Update cursor, in case it is within the area covered by OSD */
 	cursor_update_focus(server);
 }
 
+void
+osd_on_output_destroy(struct output *output)
+{
+	osd_scene_reset(output);
+}
+
 void
 osd_update(struct server *server)
 {
-	struct wl_array views;
-	wl_array_init(&views);
-	view_array_append(server, &views, rc.window_switcher.criteria);
+	int64_t profile_start = profile_begin();
+	trace_begin("osd_update", NULL);
+	struct wl_array *views = osd_cycle_views(server);
 
-	if (!wl_array_len(&views) || !server->osd_state.cycle_view) {
+	if (!wl_array_len(views) || !server->osd_state.cycle_view) {
 		osd_finish(server);
 		goto out;
 	}
@@ -395,11 +725,15 @@ osd_update(struct server *server)
 		/* Display the actual OSD */
 		struct output *output;
 		wl_list_for_each(output, &server->outputs, link) {
-			destroy_osd_nodes(output);
 			if (output_is_usable(output)) {
-				display_osd(output, &views);
+				display_osd(output, views);
+			} else {
+				destroy_osd_nodes(output);
 			}
 		}
+		if (rc.window_switcher.thumbnails) {
+			schedule_thumbnail_update(server);
+		}
 	}
 
 	/* Outline current window */
@@ -409,9 +743,12 @@ osd_update(struct server *server)
 		}
 	}
 
-	if (rc.window_switcher.preview) {
+	if (rc.window_switcher.preview_snapshot) {
+		preview_snapshot(server->osd_state.cycle_view);
+	} else if (rc.window_switcher.preview) {
 		preview_cycled_view(server->osd_state.cycle_view);
 	}
 out:
-	wl_array_release(&views);
+	trace_end("osd_update");
+	profile_end(PROFILE_OSD_UPDATE, profile_start);
 }
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include <assert.h>
 #include <ctype.h>
+#include <string.h>
 #include <wlr/util/log.h>
 #include "common/mem.h"
 #include "config/rcxml.h"
@@ -31,7 +32,7 @@ get_app_id_or_class(struct view *view, bool trim)
 	 * XWayland clients return WM_CLASS for 'app_id' so we don't need a
 	 * special case for that here.
 	 */
-	const char *identifier = view_get_string_prop(view, "app_id");
+	const char *identifier = view_get_app_id(view);
 
 	/* remove the first two nodes of 'org.' strings */
 	if (trim && identifier && !strncmp(identifier, "org.", 4)) {
@@ -61,7 +62,7 @@ get_type(struct view *view, bool short_form)
 static const char *
 get_title(struct view *view)
 {
-	return view_get_string_prop(view, "title");
+	return view_get_title(view);
 }
 
 static const char *
@@ -178,41 +179,82 @@ field_set_title_short(struct buf *buf, struct view *view, const char *format)
 	buf_add(buf, get_title_if_different(view));
 }
 
+static const struct field_converter field_converter[LAB_FIELD_COUNT] = {
+	[LAB_FIELD_TYPE]               = { 'B', field_set_type },
+	[LAB_FIELD_TYPE_SHORT]         = { 'b', field_set_type_short },
+	[LAB_FIELD_WIN_STATE_ALL]      = { 'S', field_set_win_state_all },
+	[LAB_FIELD_WIN_STATE]          = { 's', field_set_win_state },
+	[LAB_FIELD_IDENTIFIER]         = { 'I', field_set_identifier },
+	[LAB_FIELD_TRIMMED_IDENTIFIER] = { 'i', field_set_identifier_trimmed },
+	[LAB_FIELD_WORKSPACE]          = { 'W', field_set_workspace },
+	[LAB_FIELD_WORKSPACE_SHORT]    = { 'w', field_set_workspace_short },
+	[LAB_FIELD_OUTPUT]             = { 'O', field_set_output },
+	[LAB_FIELD_OUTPUT_SHORT]       = { 'o', field_set_output_short },
+	[LAB_FIELD_TITLE]              = { 'T', field_set_title },
+	[LAB_FIELD_TITLE_SHORT]        = { 't', field_set_title_short },
+	/* LAB_FIELD_CUSTOM is handled by field_run_ops() */
+};
+
+/*
+ * Custom formats are compiled into a list of ops when the config is
+ * loaded, so that rendering a row does not have to parse the format.
+ * An op either relays a literal part of the format or converts a field,
+ * formatted with the pre-built single format string like "%-10s".
+ */
+struct osd_field_op {
+	enum window_switcher_field_content content; /* LAB_FIELD_NONE for literals */
+	const char *literal; /* points into window_switcher_field.format */
+	size_t len;
+	char fmt[LAB_FIELD_SINGLE_FMT_MAX_LEN];
+};
+
+static enum window_switcher_field_content
+field_content_from_char(char fmt_char)
+{
+	for (unsigned char i = 0; i < LAB_FIELD_COUNT; i++) {
+		if (field_converter[i].fn && fmt_char == field_converter[i].fmt_char) {
+			return i;
+		}
+	}
+	return LAB_FIELD_NONE;
+}
+
 static void
-field_set_custom(struct buf *buf, struct view *view, const char *format)
+field_add_literal(struct window_switcher_field *field, const char *literal,
+		size_t len)
 {
-	if (!format) {
-		wlr_log(WLR_ERROR, "Missing format for custom window switcher field");
+	if (!len) {
 		return;
 	}
+	struct osd_field_op *op = wl_array_add(&field->ops, sizeof(*op));
+	*op = (struct osd_field_op){
+		.content = LAB_FIELD_NONE,
+		.literal = literal,
+		.len = len,
+	};
+}
 
+static void
+field_compile_format(struct window_switcher_field *field)
+{
+	const char *format = field->format;
 	char fmt[LAB_FIELD_SINGLE_FMT_MAX_LEN];
 	unsigned char fmt_position = 0;
+	const char *literal = format;
+	const char *p;
 
-	struct buf field_result = BUF_INIT;
-	char converted_field[4096];
-
-	for (const char *p = format; *p; p++) {
+	field->ops.size = 0;
+	for (p = format; *p; p++) {
 		if (!fmt_position) {
 			if (*p == '%') {
+				field_add_literal(field, literal, p - literal);
 				fmt[fmt_position++] = *p;
-			} else {
-				/*
-				 * Just relay anything not part of a
-				 * format string to the output buffer.
-				 */
-				buf_add_char(buf, *p);
 			}
 			continue;
 		}
 
 		/* Allow string formatting */
 		/* TODO: add . for manual truncating? */
-		/*
-		 * Remove the || *p == '#' section as not used/needed
-		 * change (*p >= '0' && *p <= '9') to isdigit(*p)
-		 * changes by droc12345
-		 */
 		if (*p == '-' || isdigit(*p)) {
 			if (fmt_position >= LAB_FIELD_SINGLE_FMT_MAX_LEN - 2) {
 				/* Leave space for terminating 's' and NULL byte */
@@ -224,59 +266,66 @@ field_set_custom(struct buf *buf, struct view *view, const char *format)
 			continue;
 		}
 
-		/* Handlers */
-		for (unsigned char i = 0; i < LAB_FIELD_COUNT; i++) {
-			if (*p != field_converter[i].fmt_char) {
-				continue;
-			}
-
-			/* Generate the actual content*/
-			field_converter[i].fn(&field_result, view, /*format*/ NULL);
-
-			/* Throw it at snprintf to allow formatting / padding */
+		enum window_switcher_field_content content =
+			field_content_from_char(*p);
+		if (content == LAB_FIELD_NONE) {
+			wlr_log(WLR_ERROR,
+				"invalid format character found for osd %s: '%c'",
+				format, *p);
+		} else {
+			struct osd_field_op *op =
+				wl_array_add(&field->ops, sizeof(*op));
+			*op = (struct osd_field_op){ .content = content };
 			fmt[fmt_position++] = 's';
 			fmt[fmt_position++] = '\0';
-			snprintf(converted_field, sizeof(converted_field),
-				fmt, field_result.data);
-
-			/* And finally write it to the output buffer */
-			buf_add(buf, converted_field);
-			goto reset_format;
+			memcpy(op->fmt, fmt, fmt_position);
 		}
 
-		wlr_log(WLR_ERROR,
-			"invalid format character found for osd %s: '%c'",
-			format, *p);
+		/* Reset format string */
+		fmt_position = 0;
+		literal = p + 1;
+	}
+
+	/* An unterminated trailing format string is dropped */
+	if (!fmt_position) {
+		field_add_literal(field, literal, p - literal);
+	}
+}
+
+static void
+field_run_ops(struct window_switcher_field *field, struct buf *buf,
+		struct view *view)
+{
+	struct buf field_result = BUF_INIT;
+	struct osd_field_op *op;
+	wl_array_for_each(op, &field->ops) {
+		if (op->content == LAB_FIELD_NONE) {
+			buf_add_len(buf, op->literal, op->len);
+			continue;
+		}
 
-reset_format:
-		/* Reset format string and tmp field result buffer */
+		/* Generate the actual content */
 		buf_clear(&field_result);
-		fmt_position = 0;
+		field_converter[op->content].fn(&field_result, view, /*format*/ NULL);
+
+		/*
+		 * Format it straight into the output buffer to allow
+		 * formatting / padding
+		 */
+		if (!strcmp(op->fmt, "%s")) {
+			buf_add_len(buf, field_result.data, field_result.len);
+		} else {
+			buf_add_fmt(buf, op->fmt, field_result.data);
+		}
 	}
 	buf_reset(&field_result);
 }
 
-static const struct field_converter field_converter[LAB_FIELD_COUNT] = {
-	[LAB_FIELD_TYPE]               = { 'B', field_set_type },
-	[LAB_FIELD_TYPE_SHORT]         = { 'b', field_set_type_short },
-	[LAB_FIELD_WIN_STATE_ALL]      = { 'S', field_set_win_state_all },
-	[LAB_FIELD_WIN_STATE]          = { 's', field_set_win_state },
-	[LAB_FIELD_IDENTIFIER]         = { 'I', field_set_identifier },
-	[LAB_FIELD_TRIMMED_IDENTIFIER] = { 'i', field_set_identifier_trimmed },
-	[LAB_FIELD_WORKSPACE]          = { 'W', field_set_workspace },
-	[LAB_FIELD_WORKSPACE_SHORT]    = { 'w', field_set_workspace_short },
-	[LAB_FIELD_OUTPUT]             = { 'O', field_set_output },
-	[LAB_FIELD_OUTPUT_SHORT]       = { 'o', field_set_output_short },
-	[LAB_FIELD_TITLE]              = { 'T', field_set_title },
-	[LAB_FIELD_TITLE_SHORT]        = { 't', field_set_title_short },
-	/* fmt_char can never be matched so prevents LAB_FIELD_CUSTOM recursion */
-	[LAB_FIELD_CUSTOM]             = { '\0', field_set_custom },
-};
-
 struct window_switcher_field *
 osd_field_create(void)
 {
 	struct window_switcher_field *field = znew(*field);
+	wl_array_init(&field->ops);
 	return field;
 }
 
@@ -339,6 +388,9 @@ osd_field_validate(struct window_switcher_field *field)
 		wlr_log(WLR_ERROR, "Invalid OSD field: no width");
 		return false;
 	}
+	if (field->content == LAB_FIELD_CUSTOM) {
+		field_compile_format(field);
+	}
 	return true;
 }
 
@@ -350,6 +402,10 @@ osd_field_get_content(struct window_switcher_field *field,
 		wlr_log(WLR_ERROR, "Invalid window switcher field type");
 		return;
 	}
+	if (field->content == LAB_FIELD_CUSTOM) {
+		field_run_ops(field, buf, view);
+		return;
+	}
 	assert(field->content < LAB_FIELD_COUNT && field_converter[field->content].fn);
 
 	field_converter[field->content].fn(buf, view, field->format);
@@ -359,5 +415,6 @@ void
 osd_field_free(struct window_switcher_field *field)
 {
 	zfree(field->format);
+	wl_array_release(&field->ops);
 	zfree(field);
 }
@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+#include "common/mem.h"
+#include "common/string-helpers.h"
+#include "config/rcxml.h"
+#include "labwc.h"
+#include "output-state-cache.h"
+
+struct output_state_cache_entry {
+	struct wl_list link; /* server.output_state_cache */
+	char *key;
+	int32_t width;
+	int32_t height;
+	int32_t refresh;
+	float scale;
+	enum wl_output_transform transform;
+	bool adaptive_sync;
+};
+
+/* Returns NULL for outputs without any EDID identity, like nested ones */
+static char *
+get_key(struct wlr_output *wlr_output)
+{
+	if (string_null_or_empty(wlr_output->make)
+			&& string_null_or_empty(wlr_output->model)
+			&& string_null_or_empty(wlr_output->serial)) {
+		return NULL;
+	}
+	return strdup_printf("%s\n%s\n%s",
+		wlr_output->make ? wlr_output->make : "",
+		wlr_output->model ? wlr_output->model : "",
+		wlr_output->serial ? wlr_output->serial : "");
+}
+
+static struct output_state_cache_entry *
+find_entry(struct server *server, const char *key)
+{
+	struct output_state_cache_entry *entry;
+	wl_list_for_each(entry, &server->output_state_cache, link) {
+		if (!strcmp(entry->key, key)) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+void
+output_state_cache_save(struct server *server, struct wlr_output *wlr_output)
+{
+	if (!wlr_output->enabled || !wlr_output->current_mode) {
+		return;
+	}
+	char *key = get_key(wlr_output);
+	if (!key) {
+		return;
+	}
+
+	struct output_state_cache_entry *entry = find_entry(server, key);
+	if (entry) {
+		free(key);
+	} else {
+		entry = znew(*entry);
+		entry->key = key;
+		wl_list_insert(&server->output_state_cache, &entry->link);
+	}
+	entry->width = wlr_output->current_mode->width;
+	entry->height = wlr_output->current_mode->height;
+	entry->refresh = wlr_output->current_mode->refresh;
+	entry->scale = wlr_output->scale;
+	entry->transform = wlr_output->transform;
+	entry->adaptive_sync = wlr_output->adaptive_sync_status
+		== WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED;
+}
+
+static struct wlr_output_mode *
+find_mode(struct wlr_output *wlr_output,
+		struct output_state_cache_entry *entry)
+{
+	struct wlr_output_mode *mode;
+	wl_list_for_each(mode, &wlr_output->modes, link) {
+		if (mode->width == entry->width
+				&& mode->height == entry->height
+				&& mode->refresh == entry->refresh) {
+			return mode;
+		}
+	}
+	return NULL;
+}
+
+bool
+output_state_cache_apply(struct server *server, struct wlr_output *wlr_output)
+{
+	char *key = get_key(wlr_output);
+	if (!key) {
+		return false;
+	}
+	struct output_state_cache_entry *entry = find_entry(server, key);
+	free(key);
+	if (!entry) {
+		return false;
+	}
+	struct wlr_output_mode *mode = find_mode(wlr_output, entry);
+	if (!mode) {
+		return false;
+	}
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	wlr_output_state_set_enabled(&state, true);
+	wlr_output_state_set_mode(&state, mode);
+	wlr_output_state_set_scale(&state, entry->scale);
+	wlr_output_state_set_transform(&state, entry->transform);
+	if (rc.adaptive_sync == LAB_ADAPTIVE_SYNC_ENABLED) {
+		/* Only retry adaptive sync if it worked last time */
+		wlr_output_state_set_adaptive_sync_enabled(&state,
+			entry->adaptive_sync);
+	}
+
+	bool success = wlr_output_test_state(wlr_output, &state)
+		&& wlr_output_commit_state(wlr_output, &state);
+	wlr_output_state_finish(&state);
+	if (success) {
+		wlr_log(WLR_DEBUG, "restored cached state of output %s",
+			wlr_output->name);
+	}
+	return success;
+}
+
+void
+output_state_cache_finish(struct server *server)
+{
+	struct output_state_cache_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &server->output_state_cache, link) {
+		wl_list_remove(&entry->link);
+		free(entry->key);
+		free(entry);
+	}
+}
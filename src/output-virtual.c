@@ -4,13 +4,68 @@
 #include <wlr/backend/headless.h>
 #include <wlr/types/wlr_output.h>
 #include "common/string-helpers.h"
+#include "config/rcxml.h"
 #include "labwc.h"
 #include "output-virtual.h"
 
 static struct wlr_output *fallback_output = NULL;
 
+#define DEFAULT_WIDTH (1920)
+#define DEFAULT_HEIGHT (1080)
+
+/* Fill in unset fields of @mode from <outputs><output mode="" scale=""> */
+static void
+resolve_mode(struct output_virtual_mode *mode, const char *output_name)
+{
+	struct output_config *config = output_config_for_name(output_name);
+	if (config && (!mode->width || !mode->height)) {
+		mode->width = config->width;
+		mode->height = config->height;
+	}
+	if (config && !mode->refresh) {
+		mode->refresh = config->refresh;
+	}
+	if (config && !mode->scale) {
+		mode->scale = config->scale;
+	}
+	if (!mode->width || !mode->height) {
+		mode->width = DEFAULT_WIDTH;
+		mode->height = DEFAULT_HEIGHT;
+	}
+}
+
+/*
+ * The headless backend creates outputs at its default refresh rate and
+ * paces frames by the refresh rate of the custom mode, so the requested
+ * rate and scale are applied with one more commit once the output has
+ * been configured.
+ */
+static void
+apply_mode(struct wlr_output *wlr_output,
+		const struct output_virtual_mode *mode)
+{
+	if (!mode->refresh && !mode->scale) {
+		return;
+	}
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	if (mode->refresh) {
+		wlr_output_state_set_custom_mode(&state, mode->width,
+			mode->height, mode->refresh);
+	}
+	if (mode->scale) {
+		wlr_output_state_set_scale(&state, mode->scale);
+	}
+	if (!wlr_output_commit_state(wlr_output, &state)) {
+		wlr_log(WLR_ERROR, "Failed to set mode of virtual output %s",
+			wlr_output->name);
+	}
+	wlr_output_state_finish(&state);
+}
+
 void
 output_virtual_add(struct server *server, const char *output_name,
+		const struct output_virtual_mode *requested_mode,
 		struct wlr_output **store_wlr_output)
 {
 	if (output_name) {
@@ -47,10 +102,16 @@ output_virtual_add(struct server *server, const char *output_name,
 	 * server->headless.started state around that we could check here we just
 	 * ignore duplicated new output calls in new_output_notify().
 	 */
+	struct output_virtual_mode mode = { 0 };
+	if (requested_mode) {
+		mode = *requested_mode;
+	}
+	resolve_mode(&mode, output_name);
+
 	wl_list_remove(&server->new_output.link);
 
 	struct wlr_output *wlr_output = wlr_headless_add_output(
-		server->headless.backend, 1920, 1080);
+		server->headless.backend, mode.width, mode.height);
 
 	if (!wlr_output) {
 		wlr_log(WLR_ERROR, "Failed to create virtual output %s",
@@ -70,6 +131,7 @@ output_virtual_add(struct server *server, const char *output_name,
 	if (server->new_output.notify) {
 		server->new_output.notify(&server->new_output, wlr_output);
 	}
+	apply_mode(wlr_output, &mode);
 
 restore_handler:
 	/* And finally restore output notifications */
@@ -116,7 +178,8 @@ output_virtual_update_fallback(struct server *server)
 			&& !string_null_or_empty(fallback_output_name)) {
 		wlr_log(WLR_DEBUG, "adding fallback output %s", fallback_output_name);
 
-		output_virtual_add(server, fallback_output_name, &fallback_output);
+		output_virtual_add(server, fallback_output_name,
+			/*mode*/ NULL, &fallback_output);
 	} else if (fallback_output && (wl_list_length(layout_outputs) > 1
 			|| string_null_or_empty(fallback_output_name))) {
 		wlr_log(WLR_DEBUG, "destroying fallback output %s",
@@ -8,44 +8,460 @@
 
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <float.h>
+#include <stdlib.h>
 #include <strings.h>
+#include <wlr/backend.h>
 #include <wlr/backend/drm.h>
 #include <wlr/backend/wayland.h>
 #include <wlr/types/wlr_buffer.h>
 #include <wlr/types/wlr_drm_lease_v1.h>
 #include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_xdg_output_v1.h>
 #include <wlr/types/wlr_scene.h>
+#include <wlr/util/box.h>
 #include <wlr/util/region.h>
 #include <wlr/util/log.h>
+#include "common/bitset.h"
 #include "common/macros.h"
 #include "common/mem.h"
+#include "common/scaled_scene_buffer.h"
 #include "common/scene-helpers.h"
+#include "common/time-helpers.h"
+#include "edges.h"
 #include "labwc.h"
 #include "layers.h"
+#include "magnifier.h"
 #include "node.h"
+#include "osd.h"
+#include "output-state-cache.h"
 #include "output-virtual.h"
+#include "placement.h"
+#include "profile.h"
 #include "regions.h"
+#include "trace.h"
 #include "view.h"
+#include "workspaces.h"
 #include "xwayland.h"
 
+static void output_index_invalidate(struct server *server);
+
+/*
+ * Views hidden by the lock screen or the overview only get
+ * <core><throttledFrameRate> frame-done events per second so that their
+ * clients do not keep rendering frames at the refresh rate. Sending them
+ * occasionally still allows clients to make progress. Views on other
+ * workspaces and minimized views are disabled in the scene and get no
+ * frame-done events at all.
+ *
+ * Views which are merely occluded by other windows are not throttled:
+ * the occlusion state does not follow the opaque regions of subsurfaces,
+ * so a visible window could stutter.
+ */
 static bool
-get_tearing_preference(struct output *output)
+throttled_frame_done_due(struct output *output, int64_t now_nsec)
 {
-	struct server *server = output->server;
-
-	/* Never allow tearing when disabled */
-	if (!rc.allow_tearing) {
+	if (rc.throttled_frame_rate <= 0) {
 		return false;
 	}
+	return now_nsec - output->throttled_frame_done_nsec
+		>= NSEC_PER_SEC / rc.throttled_frame_rate;
+}
 
-	/* Tearing is only allowed for the output with the active view */
-	if (!server->active_view || server->active_view->output != output) {
+static bool
+view_is_throttled(struct wlr_scene_tree *tree, void *data)
+{
+	struct server *server = data;
+	struct node_descriptor *desc = tree->node.data;
+	if (!desc || desc->type != LAB_NODE_DESC_VIEW) {
 		return false;
 	}
+	return server->session_lock || server->overview.tree;
+}
+
+static int64_t
+send_frame_done(struct output *output)
+{
+	struct server *server = output->server;
+	struct timespec now = { 0 };
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int64_t now_nsec = time_timespec_to_nsec(&now);
+
+	if (throttled_frame_done_due(output, now_nsec)) {
+		output->throttled_frame_done_nsec = now_nsec;
+		wlr_scene_output_send_frame_done(output->scene_output, &now);
+	} else {
+		/* Only needed to count the commits of occluded views */
+		edges_calculate_occlusion(server);
+		lab_wlr_scene_output_send_frame_done(output->scene_output,
+			&now, view_is_throttled, server);
+	}
+	return time_now_nsec() - now_nsec;
+}
+
+struct view *
+output_get_fullscreen_view(struct output *output)
+{
+	struct view *view;
+	enum lab_view_criteria criteria =
+		LAB_VIEW_CRITERIA_CURRENT_WORKSPACE | LAB_VIEW_CRITERIA_FULLSCREEN;
+	for_each_view(view, &output->server->views, criteria) {
+		if (view->output == output) {
+			return view;
+		}
+	}
+	return NULL;
+}
+
+static bool
+overlay_rect_shown(struct overlay_rect *rect)
+{
+	return rect->node && rect->node->enabled;
+}
+
+/*
+ * Checks which of the scene elements of labwc itself, if any, are shown
+ * on top of a fullscreen view and thus prevent direct scanout. The top
+ * layer is hidden by desktop_update_top_layer_visiblity() while a view
+ * is fullscreen, so it is only reported if that did not happen.
+ */
+static enum frame_stats_scanout
+get_scanout_blocker(struct output *output)
+{
+	struct server *server = output->server;
+	struct wlr_scene_tree *top =
+		output->layer_tree[ZWLR_LAYER_SHELL_V1_LAYER_TOP];
+
+	if (output->osd_tree->node.enabled) {
+		return FRAME_STATS_SCANOUT_BLOCKED_OSD;
+	}
+	if (server->input_mode == LAB_INPUT_STATE_MENU) {
+		return FRAME_STATS_SCANOUT_BLOCKED_MENU;
+	}
+	if (overlay_rect_shown(&server->seat.overlay.region_rect)
+			|| overlay_rect_shown(&server->seat.overlay.edge_rect)) {
+		return FRAME_STATS_SCANOUT_BLOCKED_OVERLAY;
+	}
+	if (top->node.enabled && !wl_list_empty(&top->children)) {
+		return FRAME_STATS_SCANOUT_BLOCKED_TOP_LAYER;
+	}
+	return FRAME_STATS_SCANOUT_REFUSED;
+}
 
-	/* If the active view requests tearing, or it is toggled on with action, allow it */
-	return server->active_view->tearing_hint;
+static void
+update_scanout_stats(struct output *output, struct wlr_buffer *buffer)
+{
+	struct view *view = output_get_fullscreen_view(output);
+	if (!view) {
+		return;
+	}
+
+	struct wlr_surface *surface = view->surface;
+	if (buffer && surface && surface->buffer
+			&& buffer == &surface->buffer->base) {
+		frame_stats_scanout(&output->frame_stats,
+			FRAME_STATS_SCANOUT_DIRECT);
+		return;
+	}
+	frame_stats_scanout(&output->frame_stats, get_scanout_blocker(output));
+}
+
+/*
+ * Cursor images which do not fit the cursor plane of an output (or any
+ * other backend limitation) make wlroots composite the cursor into every
+ * frame instead, which means a repaint for each motion. Report when that
+ * happens so the cause (usually XCURSOR_SIZE times the output scale
+ * exceeding the plane size) can be found.
+ */
+static void
+update_cursor_stats(struct output *output)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct wlr_output_cursor *cursor;
+	wl_list_for_each(cursor, &wlr_output->cursors, link) {
+		if (!cursor->enabled || !cursor->visible) {
+			continue;
+		}
+		bool hardware = wlr_output->hardware_cursor == cursor;
+		if (frame_stats_cursor(&output->frame_stats, hardware)) {
+			wlr_log(WLR_INFO, "%s: %s cursor", wlr_output->name,
+				hardware ? "hardware" : "software");
+		}
+		return;
+	}
+}
+
+/* State of a repaint between building and committing the output state */
+struct repaint {
+	struct output *output;
+	struct wlr_gamma_control_v1 *gamma_control;
+	bool gamma_changed;
+	bool built;
+	struct lab_scene_commit_timing timing;
+};
+
+static void
+repaint_build(struct output *output, struct repaint *repaint)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct server *server = output->server;
+	*repaint = (struct repaint){ .output = output };
+
+	/*
+	 * A changed gamma LUT is added to the pending state so that it is
+	 * committed together with the regular frame rather than with a
+	 * separately built one.
+	 */
+	if (output->gamma_lut_changed) {
+		output->gamma_lut_changed = false;
+		repaint->gamma_changed = true;
+		repaint->gamma_control = wlr_gamma_control_manager_v1_get_control(
+			server->gamma_control_manager_v1, wlr_output);
+		if (!wlr_gamma_control_v1_apply(repaint->gamma_control,
+				&wlr_output->pending)) {
+			wlr_log(WLR_ERROR, "failed to apply gamma to %s",
+				wlr_output->name);
+			repaint->gamma_changed = false;
+		}
+	}
+
+	/*
+	 * With <output constantFrameRate="yes"> every frame is presented,
+	 * even without damage, so that consumers like video encoders of
+	 * virtual outputs get frames at a steady rate. The output is not
+	 * damaged for this, so the commit still carries the real damage
+	 * region and screencopy clients asking for damage skip the frame.
+	 */
+	struct output_config *config = get_output_config(output);
+	if (config && config->constant_frame_rate) {
+		wlr_output_update_needs_frame(wlr_output);
+	}
+
+	/* The gamma LUT cannot be changed with a tearing page-flip */
+	wlr_output->pending.tearing_page_flip =
+		!repaint->gamma_changed && tearing_allowed(output);
+	trace_begin("scene_output_build", NULL);
+	repaint->built = magnifier_begin_frame(output)
+		&& lab_wlr_scene_output_build(output->scene_output,
+			&repaint->timing);
+	if (repaint->built) {
+		magnifier_render(output);
+	}
+	trace_end("scene_output_build");
+}
+
+static void
+repaint_commit(struct repaint *repaint, int64_t frame_done_nsec)
+{
+	struct output *output = repaint->output;
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct server *server = output->server;
+
+	trace_begin("scene_output_commit", NULL);
+	bool committed = repaint->built && lab_wlr_scene_output_commit_built(
+		output->scene_output, &repaint->timing);
+	trace_end("scene_output_commit");
+	int64_t committed_at = time_now_nsec();
+
+	if (repaint->gamma_changed && !committed && repaint->gamma_control) {
+		wlr_gamma_control_v1_send_failed_and_destroy(
+			repaint->gamma_control);
+	}
+
+	if (frame_done_nsec < 0) {
+		frame_done_nsec = send_frame_done(output);
+	}
+
+	if (committed) {
+		int64_t duration[FRAME_STATS_NR_PHASES] = {
+			[FRAME_STATS_BUILD_STATE] = repaint->timing.build_state_nsec,
+			[FRAME_STATS_COMMIT] = repaint->timing.commit_nsec,
+			[FRAME_STATS_FRAME_DONE] = frame_done_nsec,
+		};
+		frame_stats_add(&output->frame_stats, committed_at, duration);
+		if (output->frame_stats.nr_frames == 1) {
+			profile_startup_mark("first_frame", wlr_output->name);
+		}
+		update_scanout_stats(output, repaint->timing.buffer);
+		update_cursor_stats(output);
+		input_latency_output_commit(&server->seat.input_latency,
+			wlr_output, committed_at);
+	}
+}
+
+/*
+ * Renders and commits the output
+ *
+ * If frame-done events have already been sent to clients (which is the
+ * case for a delayed repaint) @frame_done_nsec contains the time it took.
+ * Otherwise it must be negative and frame-done events are sent after the
+ * commit.
+ */
+static void
+output_repaint(struct output *output, int64_t frame_done_nsec)
+{
+	trace_begin("output_repaint", output->wlr_output->name);
+	struct repaint repaint;
+	repaint_build(output, &repaint);
+	repaint_commit(&repaint, frame_done_nsec);
+	trace_end("output_repaint");
+}
+
+/*
+ * With <core><batchOutputFrames>, the outputs whose frames are due in the
+ * same iteration of the event loop (typically all outputs of a video wall
+ * driven by a common vblank) are repainted together: all output states are
+ * built from the same scene first, then committed one after the other.
+ * The commits reach the kernel in quick succession, so the outputs flip
+ * in the same vblank and never show different states of the scene.
+ * Updates concerning all outputs are also only done once per batch.
+ */
+static void
+handle_repaint_batch(void *data)
+{
+	struct server *server = data;
+	server->output_repaint_idle = NULL;
+
+	workspaces_transition_update(server);
+	interactive_flush_update(server);
+
+	struct wl_array repaints;
+	wl_array_init(&repaints);
+	struct output *output;
+	trace_begin("output_repaint_batch", NULL);
+	wl_list_for_each(output, &server->outputs, link) {
+		if (!output->repaint_batched) {
+			continue;
+		}
+		output->repaint_batched = false;
+		if (!output_is_usable(output) || !output->scene_output) {
+			continue;
+		}
+		struct repaint *repaint = wl_array_add(&repaints,
+			sizeof(*repaint));
+		if (!repaint) {
+			wlr_log(WLR_ERROR, "wl_array_add(): out of memory");
+			/* Better unbatched than not at all */
+			output_repaint(output, output->batched_frame_done_nsec);
+			continue;
+		}
+		repaint_build(output, repaint);
+	}
+
+	/* Nothing may change the scene in between */
+	struct repaint *repaint;
+	wl_array_for_each(repaint, &repaints) {
+		repaint_commit(repaint,
+			repaint->output->batched_frame_done_nsec);
+	}
+	trace_end("output_repaint_batch");
+	wl_array_release(&repaints);
+}
+
+static void
+queue_repaint(struct output *output, int64_t frame_done_nsec)
+{
+	struct server *server = output->server;
+	output->repaint_batched = true;
+	output->batched_frame_done_nsec = frame_done_nsec;
+	if (!server->output_repaint_idle) {
+		server->output_repaint_idle = wl_event_loop_add_idle(
+			server->wl_event_loop, handle_repaint_batch, server);
+	}
+}
+
+static int
+handle_repaint_timer(void *data)
+{
+	struct output *output = data;
+	output->repaint_delayed = false;
+	output->repaint_due = true;
+	/* Repaint with the frame event, see output_frame_notify() */
+	wlr_output_schedule_frame(output->wlr_output);
+	return 0;
+}
+
+struct output_config *
+output_config_for_name(const char *name)
+{
+	/* Later entries take precedence */
+	struct output_config *config, *result = NULL;
+	wl_list_for_each(config, &rc.output_configs, link) {
+		if (!config->name || (name
+				&& !strcasecmp(config->name, name))) {
+			result = config;
+		}
+	}
+	return result;
+}
+
+static struct output_config *
+get_output_config(struct output *output)
+{
+	return output_config_for_name(output->wlr_output->name);
+}
+
+/* Frames between re-estimating <maxRenderTime>auto</maxRenderTime> */
+#define AUTO_RENDER_TIME_INTERVAL (16)
+
+/* Returns the render time budget of an output in ms or 0 if disabled */
+static int
+get_max_render_time(struct output *output)
+{
+	struct output_config *config = get_output_config(output);
+	if (!config || !config->max_render_time) {
+		return 0;
+	}
+	if (config->max_render_time != LAB_MAX_RENDER_TIME_AUTO) {
+		return config->max_render_time;
+	}
+
+	/* Wait until there is enough data to make a sensible guess */
+	struct frame_stats *stats = &output->frame_stats;
+	if (stats->count < FRAME_STATS_NR_SAMPLES / 4) {
+		return 0;
+	}
+
+	/* Percentiles sort all samples, so they are not taken every frame */
+	if (output->auto_render_time.msec && stats->nr_frames
+			- output->auto_render_time.nr_frames
+			< AUTO_RENDER_TIME_INTERVAL) {
+		return output->auto_render_time.msec;
+	}
+
+	/*
+	 * Only CPU time is measured, so leave some headroom for the GPU
+	 * to finish and the page-flip to make it in time for the vblank.
+	 */
+	int64_t budget = 2 * NSEC_PER_MSEC
+		+ frame_stats_percentile(stats, FRAME_STATS_BUILD_STATE, 99)
+		+ frame_stats_percentile(stats, FRAME_STATS_COMMIT, 99);
+	output->auto_render_time.msec =
+		(budget + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC;
+	output->auto_render_time.nr_frames = stats->nr_frames;
+	return output->auto_render_time.msec;
+}
+
+/* Returns the delay in ms to wait before repainting the output */
+static int
+get_repaint_delay(struct output *output)
+{
+	int max_render_time = get_max_render_time(output);
+	if (!max_render_time || !output->last_present_nsec
+			|| output->refresh_nsec <= 0) {
+		return 0;
+	}
+
+	int64_t now = time_now_nsec();
+	int64_t next_refresh = output->last_present_nsec + output->refresh_nsec;
+	if (next_refresh <= now) {
+		/* Skip refresh cycles without presentation feedback */
+		int64_t cycles = (now - next_refresh) / output->refresh_nsec + 1;
+		next_refresh += cycles * output->refresh_nsec;
+	}
+	int msec_until_refresh = (next_refresh - now) / NSEC_PER_MSEC;
+	return msec_until_refresh - max_render_time;
 }
 
 static void
@@ -59,6 +475,7 @@ output_frame_notify(struct wl_listener *listener, void *data)
 	if (!output_is_usable(output)) {
 		return;
 	}
+	trace_instant("output_frame", output->wlr_output->name);
 
 	if (!output->scene_output) {
 		/*
@@ -71,42 +488,80 @@ output_frame_notify(struct wl_listener *listener, void *data)
 		return;
 	}
 
-	struct wlr_output *wlr_output = output->wlr_output;
-	struct server *server = output->server;
+	/* The repaint timer takes care of this frame */
+	if (output->repaint_delayed) {
+		return;
+	}
 
-	if (output->gamma_lut_changed) {
-		struct wlr_output_state pending;
-		wlr_output_state_init(&pending);
-		if (!wlr_scene_output_build_state(output->scene_output, &pending, NULL)) {
-			return;
-		}
-		output->gamma_lut_changed = false;
-		struct wlr_gamma_control_v1 *gamma_control =
-			wlr_gamma_control_manager_v1_get_control(
-				server->gamma_control_manager_v1, wlr_output);
-		if (!wlr_gamma_control_v1_apply(gamma_control, &pending)) {
-			wlr_output_state_finish(&pending);
-			return;
-		}
+	if (!rc.batch_output_frames) {
+		workspaces_transition_update(output->server);
+		interactive_flush_update(output->server);
+	}
 
-		if (!wlr_output_commit_state(output->wlr_output, &pending)) {
-			wlr_gamma_control_v1_send_failed_and_destroy(gamma_control);
-			wlr_output_state_finish(&pending);
-			return;
+	/*
+	 * With <maxRenderTime> configured, rendering is delayed until
+	 * shortly before the predicted next vblank. Clients are sent
+	 * frame-done events right away so that their commits can still
+	 * make it into the upcoming frame, which reduces latency.
+	 */
+	int64_t frame_done_nsec = -1;
+	int delay = 0;
+	if (output->repaint_due) {
+		output->repaint_due = false;
+		frame_done_nsec = output->delayed_frame_done_nsec;
+	} else {
+		delay = get_repaint_delay(output);
+	}
+	if (delay < 1) {
+		if (rc.batch_output_frames) {
+			queue_repaint(output, frame_done_nsec);
+		} else {
+			output_repaint(output, frame_done_nsec);
 		}
+		return;
+	}
+	output->repaint_delayed = true;
+	wl_event_source_timer_update(output->repaint_timer, delay);
+	output->delayed_frame_done_nsec = send_frame_done(output);
+}
 
-		wlr_damage_ring_rotate(&output->scene_output->damage_ring);
-		wlr_output_state_finish(&pending);
+static void
+output_present_notify(struct wl_listener *listener, void *data)
+{
+	struct output *output = wl_container_of(listener, output, present);
+	const struct wlr_output_event_present *event = data;
+	if (!event->presented || !event->when) {
 		return;
 	}
 
-	output->wlr_output->pending.tearing_page_flip =
-		get_tearing_preference(output);
-	lab_wlr_scene_output_commit(output->scene_output);
+	int64_t refresh_nsec = event->refresh;
+	if (!refresh_nsec && output->wlr_output->refresh > 0) {
+		/* wlr_output->refresh is in mHz */
+		refresh_nsec = NSEC_PER_SEC * 1000 / output->wlr_output->refresh;
+	}
+	output->last_present_nsec = time_timespec_to_nsec(event->when);
+	output->refresh_nsec = refresh_nsec;
+	frame_stats_presented(&output->frame_stats,
+		output->last_present_nsec, refresh_nsec);
+}
 
-	struct timespec now = { 0 };
-	clock_gettime(CLOCK_MONOTONIC, &now);
-	wlr_scene_output_send_frame_done(output->scene_output, &now);
+static void
+output_commit_notify(struct wl_listener *listener, void *data)
+{
+	struct output *output = wl_container_of(listener, output, commit);
+	struct wlr_output_event_commit *event = data;
+
+	if ((event->state->committed & WLR_OUTPUT_STATE_SCALE)
+			&& output->scene_output) {
+		scaled_scene_buffer_on_output_scale_change(output->scene_output);
+	}
+
+	if (event->state->committed & (WLR_OUTPUT_STATE_ENABLED
+			| WLR_OUTPUT_STATE_MODE | WLR_OUTPUT_STATE_SCALE
+			| WLR_OUTPUT_STATE_TRANSFORM
+			| WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED)) {
+		output_state_cache_save(output->server, output->wlr_output);
+	}
 }
 
 static void
@@ -116,13 +571,18 @@ output_destroy_notify(struct wl_listener *listener, void *data)
 	struct seat *seat = &output->server->seat;
 	regions_evacuate_output(output);
 	regions_destroy(seat, &output->regions);
+	regions_grid_finish(&output->region_grid);
 	if (seat->overlay.active.output == output) {
 		overlay_hide(seat);
 	}
 	wl_list_remove(&output->link);
+	output_index_invalidate(output->server);
 	wl_list_remove(&output->frame.link);
+	wl_list_remove(&output->present.link);
+	wl_list_remove(&output->commit.link);
 	wl_list_remove(&output->destroy.link);
 	wl_list_remove(&output->request_state.link);
+	wl_event_source_remove(output->repaint_timer);
 	seat_output_layout_changed(seat);
 
 	for (size_t i = 0; i < ARRAY_SIZE(output->layer_tree); i++) {
@@ -130,11 +590,12 @@ output_destroy_notify(struct wl_listener *listener, void *data)
 	}
 	wlr_scene_node_destroy(&output->layer_popup_tree->node);
 	wlr_scene_node_destroy(&output->osd_tree->node);
+	osd_on_output_destroy(output);
+	placement_on_output_destroy(output);
+	magnifier_on_output_destroy(output);
+	adaptive_sync_on_output_destroy(output);
 	wlr_scene_node_destroy(&output->session_lock_tree->node);
-	if (output->workspace_osd) {
-		wlr_scene_node_destroy(&output->workspace_osd->node);
-		output->workspace_osd = NULL;
-	}
+	workspaces_osd_on_output_destroy(output);
 
 	struct view *view;
 	struct server *server = output->server;
@@ -232,6 +693,50 @@ add_output_to_layout(struct server *server, struct output *output)
 	}
 }
 
+static void
+configure_new_output(struct wlr_output *wlr_output)
+{
+	wlr_log(WLR_DEBUG, "enable output");
+	wlr_output_enable(wlr_output, true);
+
+	/*
+	 * Try to re-use the existing mode if configured to do so.
+	 * Failing that, try to set the preferred mode.
+	 */
+	struct wlr_output_mode *preferred_mode = NULL;
+	if (!rc.reuse_output_mode || !can_reuse_mode(wlr_output)) {
+		wlr_log(WLR_DEBUG, "set preferred mode");
+		/* The mode is a tuple of (width, height, refresh rate). */
+		preferred_mode = wlr_output_preferred_mode(wlr_output);
+		wlr_output_set_mode(wlr_output, preferred_mode);
+	}
+
+	/*
+	 * Sometimes the preferred mode is not available due to hardware
+	 * constraints (e.g. GPU or cable bandwidth limitations). In these
+	 * cases it's better to fallback to lower modes than to end up with
+	 * a black screen. See sway@4cdc4ac6
+	 */
+	if (!wlr_output_test(wlr_output)) {
+		wlr_log(WLR_DEBUG,
+			"preferred mode rejected, falling back to another mode");
+		struct wlr_output_mode *mode;
+		wl_list_for_each(mode, &wlr_output->modes, link) {
+			if (mode == preferred_mode) {
+				continue;
+			}
+			wlr_output_set_mode(wlr_output, mode);
+			if (wlr_output_test(wlr_output)) {
+				break;
+			}
+		}
+	}
+
+	if (rc.adaptive_sync == LAB_ADAPTIVE_SYNC_ENABLED) {
+		output_enable_adaptive_sync(wlr_output, true);
+	}
+}
+
 static void
 new_output_notify(struct wl_listener *listener, void *data)
 {
@@ -285,60 +790,46 @@ new_output_notify(struct wl_listener *listener, void *data)
 		return;
 	}
 
-	wlr_log(WLR_DEBUG, "enable output");
-	wlr_output_enable(wlr_output, true);
-
 	/*
-	 * Try to re-use the existing mode if configured to do so.
-	 * Failing that, try to set the preferred mode.
+	 * Displays which blink on and off (KVM switches, DP MST hubs) get
+	 * their last known-good state back in a single test and commit
+	 * instead of probing modes again.
 	 */
-	struct wlr_output_mode *preferred_mode = NULL;
-	if (!rc.reuse_output_mode || !can_reuse_mode(wlr_output)) {
-		wlr_log(WLR_DEBUG, "set preferred mode");
-		/* The mode is a tuple of (width, height, refresh rate). */
-		preferred_mode = wlr_output_preferred_mode(wlr_output);
-		wlr_output_set_mode(wlr_output, preferred_mode);
-	}
-
-	/*
-	 * Sometimes the preferred mode is not available due to hardware
-	 * constraints (e.g. GPU or cable bandwidth limitations). In these
-	 * cases it's better to fallback to lower modes than to end up with
-	 * a black screen. See sway@4cdc4ac6
-	 */
-	if (!wlr_output_test(wlr_output)) {
-		wlr_log(WLR_DEBUG,
-			"preferred mode rejected, falling back to another mode");
-		struct wlr_output_mode *mode;
-		wl_list_for_each(mode, &wlr_output->modes, link) {
-			if (mode == preferred_mode) {
-				continue;
-			}
-			wlr_output_set_mode(wlr_output, mode);
-			if (wlr_output_test(wlr_output)) {
-				break;
-			}
-		}
+	if (!output_state_cache_apply(server, wlr_output)) {
+		configure_new_output(wlr_output);
+		wlr_output_commit(wlr_output);
+		output_state_cache_save(server, wlr_output);
 	}
 
-	if (rc.adaptive_sync == LAB_ADAPTIVE_SYNC_ENABLED) {
-		output_enable_adaptive_sync(wlr_output, true);
-	}
-
-	wlr_output_commit(wlr_output);
-
 	output = znew(*output);
 	output->wlr_output = wlr_output;
 	wlr_output->data = output;
 	output->server = server;
+
+	/* Unlike scene_output->index, not limited to 64 outputs */
+	struct bitset used = { 0 };
+	struct output *other;
+	wl_list_for_each(other, &server->outputs, link) {
+		bitset_set(&used, other->index);
+	}
+	output->index = bitset_first_unset(&used);
+	bitset_finish(&used);
+
 	wlr_output_effective_resolution(wlr_output,
 		&output->usable_area.width, &output->usable_area.height);
 	wl_list_insert(&server->outputs, &output->link);
+	output_index_invalidate(server);
 
 	output->destroy.notify = output_destroy_notify;
 	wl_signal_add(&wlr_output->events.destroy, &output->destroy);
 	output->frame.notify = output_frame_notify;
 	wl_signal_add(&wlr_output->events.frame, &output->frame);
+	output->present.notify = output_present_notify;
+	wl_signal_add(&wlr_output->events.present, &output->present);
+	output->commit.notify = output_commit_notify;
+	wl_signal_add(&wlr_output->events.commit, &output->commit);
+	output->repaint_timer = wl_event_loop_add_timer(server->wl_event_loop,
+		handle_repaint_timer, output);
 
 	output->request_state.notify = output_request_state_notify;
 	wl_signal_add(&wlr_output->events.request_state, &output->request_state);
@@ -410,6 +901,7 @@ output_init(struct server *server)
 	server->gamma_control_manager_v1 =
 		wlr_gamma_control_manager_v1_create(server->wl_display);
 
+	wl_list_init(&server->output_state_cache);
 	server->new_output.notify = new_output_notify;
 	wl_signal_add(&server->backend->events.new_output, &server->new_output);
 
@@ -438,63 +930,210 @@ output_init(struct server *server)
 	output_manager_init(server);
 }
 
+/* Cache one buffer per distinct output scale in each scaled_scene_buffer */
+static void
+update_scaled_buffer_cache_size(struct server *server)
+{
+	int nr_scales = 0;
+	struct output *output, *other;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (!output->wlr_output->enabled) {
+			continue;
+		}
+		bool seen = false;
+		wl_list_for_each(other, &server->outputs, link) {
+			if (other == output) {
+				break;
+			}
+			if (other->wlr_output->enabled && other->wlr_output->scale
+					== output->wlr_output->scale) {
+				seen = true;
+				break;
+			}
+		}
+		if (!seen) {
+			nr_scales++;
+		}
+	}
+	scaled_scene_buffer_set_cache_size(nr_scales);
+}
+
 static void
 output_update_for_layout_change(struct server *server)
 {
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		wlr_output_layout_get_box(server->output_layout,
+			output->wlr_output, &output->layout_box);
+	}
+
 	output_update_all_usable_areas(server, /*layout_changed*/ true);
 	session_lock_update_for_layout_change();
+	edges_invalidate(server, NULL);
+	update_scaled_buffer_cache_size(server);
 
 	/*
 	 * "Move" each wlr_output_cursor (in per-output coordinates) to
 	 * align with the seat cursor. Re-set the cursor image so that
 	 * the cursor isn't invisible on new outputs.
 	 */
+	cursor_load_scales(&server->seat);
 	wlr_cursor_move(server->seat.cursor, NULL, 0, 0);
 	cursor_update_image(&server->seat);
 }
 
+/* Fill @state to restore the current configuration of @o */
+static void
+output_state_from_current(struct wlr_output_state *state, struct wlr_output *o)
+{
+	wlr_output_state_init(state);
+	wlr_output_state_set_enabled(state, o->enabled);
+	if (!o->enabled) {
+		return;
+	}
+	if (o->current_mode) {
+		wlr_output_state_set_mode(state, o->current_mode);
+	} else {
+		wlr_output_state_set_custom_mode(state, o->width, o->height,
+			o->refresh);
+	}
+	wlr_output_state_set_scale(state, o->scale);
+	wlr_output_state_set_transform(state, o->transform);
+	wlr_output_state_set_adaptive_sync_enabled(state,
+		o->adaptive_sync_status == WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED);
+}
+
+struct head_state {
+	struct wlr_output *output;
+	struct wlr_output_state state;
+	/* The current configuration, to roll back to */
+	struct wlr_output_state saved;
+	bool committed;
+};
+
+/* Adaptive sync is best effort, it is dropped if the head fails without */
 static bool
-output_config_apply(struct server *server,
-		struct wlr_output_configuration_v1 *config)
+head_state_test(struct head_state *head)
 {
-	bool success = true;
-	server->pending_output_layout_change++;
+	struct wlr_output_state *state = &head->state;
+	if (wlr_output_test_state(head->output, state)) {
+		return true;
+	}
+	if (!(state->committed & WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED)
+			|| !state->adaptive_sync_enabled) {
+		return false;
+	}
+	wlr_log(WLR_DEBUG, "failed to enable adaptive sync for output %s",
+		head->output->name);
+	wlr_output_state_set_adaptive_sync_enabled(state, false);
+	return wlr_output_test_state(head->output, state);
+}
 
+/*
+ * wlroots 0.17 cannot commit several outputs at once. All heads are
+ * therefore tested before any of them is committed, so that a head which
+ * cannot be applied leaves every output unchanged. Heads being disabled
+ * go first to free up their CRTCs for the others, as when docking a
+ * laptop. Should a commit still fail, the heads committed so far are
+ * restored to their previous state.
+ */
+static bool
+output_config_commit(struct server *server,
+		struct wlr_output_configuration_v1 *config, bool *was_enabled)
+{
+	size_t nr_heads = wl_list_length(&config->heads);
+	struct head_state *heads = znew_n(*heads, nr_heads);
+	bool success = false;
+
+	size_t i = 0;
 	struct wlr_output_configuration_head_v1 *head;
 	wl_list_for_each(head, &config->heads, link) {
 		struct wlr_output *o = head->state.output;
 		struct output *output = output_from_wlr_output(server, o);
-		bool output_enabled = head->state.enabled && !output->leased;
-		bool need_to_add = output_enabled && !o->enabled;
-		bool need_to_remove = !output_enabled && o->enabled;
+		was_enabled[i] = o->enabled;
 
-		wlr_output_enable(o, output_enabled);
-		if (output_enabled) {
-			/* Output specific actions only */
-			if (head->state.mode) {
-				wlr_output_set_mode(o, head->state.mode);
-			} else {
-				int32_t width = head->state.custom_mode.width;
-				int32_t height = head->state.custom_mode.height;
-				int32_t refresh = head->state.custom_mode.refresh;
-				wlr_output_set_custom_mode(o, width,
-					height, refresh);
+		heads[i].output = o;
+		wlr_output_state_init(&heads[i].state);
+		if (head->state.enabled && !output->leased) {
+			wlr_output_head_v1_state_apply(&head->state,
+				&heads[i].state);
+		} else {
+			wlr_output_state_set_enabled(&heads[i].state, false);
+		}
+		output_state_from_current(&heads[i].saved, o);
+		i++;
+	}
+
+	for (i = 0; i < nr_heads; i++) {
+		if (!head_state_test(&heads[i])) {
+			wlr_log(WLR_INFO, "Output config test failed: %s",
+				heads[i].output->name);
+			goto out;
+		}
+	}
+
+	/* Disabled heads in the first pass, the others in the second */
+	for (int pass = 0; pass < 2; pass++) {
+		for (i = 0; i < nr_heads; i++) {
+			if (heads[i].state.enabled != (pass == 1)) {
+				continue;
 			}
-			wlr_output_set_scale(o, head->state.scale);
-			wlr_output_set_transform(o, head->state.transform);
-			output_enable_adaptive_sync(o, head->state.adaptive_sync_enabled);
+			if (!wlr_output_commit_state(heads[i].output,
+					&heads[i].state)) {
+				wlr_log(WLR_INFO, "Output config commit failed: %s",
+					heads[i].output->name);
+				goto rollback;
+			}
+			heads[i].committed = true;
 		}
-		if (!wlr_output_commit(o)) {
-			/*
-			 * FIXME: This is only part of the story, we should revert
-			 *        all previously commited outputs as well here.
-			 *
-			 *        See https://github.com/labwc/labwc/pull/1528
-			 */
-			wlr_log(WLR_INFO, "Output config commit failed: %s", o->name);
-			success = false;
-			break;
+	}
+	success = true;
+	goto out;
+
+rollback:
+	for (int pass = 0; pass < 2; pass++) {
+		for (i = 0; i < nr_heads; i++) {
+			if (!heads[i].committed
+					|| heads[i].saved.enabled != (pass == 1)) {
+				continue;
+			}
+			if (!wlr_output_commit_state(heads[i].output,
+					&heads[i].saved)) {
+				wlr_log(WLR_ERROR, "Failed to restore output %s",
+					heads[i].output->name);
+			}
 		}
+	}
+out:
+	for (i = 0; i < nr_heads; i++) {
+		wlr_output_state_finish(&heads[i].state);
+		wlr_output_state_finish(&heads[i].saved);
+	}
+	free(heads);
+	return success;
+}
+
+static bool
+output_config_apply(struct server *server,
+		struct wlr_output_configuration_v1 *config)
+{
+	server->pending_output_layout_change++;
+
+	bool *was_enabled = znew_n(bool, wl_list_length(&config->heads));
+	bool success = output_config_commit(server, config, was_enabled);
+	if (!success) {
+		goto out;
+	}
+
+	size_t i = 0;
+	struct wlr_output_configuration_head_v1 *head;
+	wl_list_for_each(head, &config->heads, link) {
+		struct wlr_output *o = head->state.output;
+		struct output *output = output_from_wlr_output(server, o);
+		bool output_enabled = head->state.enabled && !output->leased;
+		bool need_to_add = output_enabled && !was_enabled[i];
+		bool need_to_remove = !output_enabled && was_enabled[i];
+		i++;
 
 		/* Only do Layout specific actions if the commit went trough */
 		if (need_to_add) {
@@ -531,6 +1170,9 @@ output_config_apply(struct server *server,
 		}
 	}
 
+out:
+	free(was_enabled);
+	/* A single layout change for all heads */
 	server->pending_output_layout_change--;
 	do_output_layout_change(server);
 	return success;
@@ -638,11 +1280,7 @@ handle_output_manager_apply(struct wl_listener *listener, void *data)
 		wlr_output_configuration_v1_send_failed(config);
 	}
 	wlr_output_configuration_v1_destroy(config);
-	struct output *output;
-	wl_list_for_each(output, &server->outputs, link) {
-		wlr_xcursor_manager_load(server->seat.xcursor_manager,
-			output->wlr_output->scale);
-	}
+	cursor_load_scales(&server->seat);
 
 	/* Re-set cursor image in case scale changed */
 	cursor_update_focus(server);
@@ -688,20 +1326,38 @@ wlr_output_configuration_v1 *create_output_config(struct server *server)
 	return config;
 }
 
+static void
+handle_output_layout_change_idle(void *data)
+{
+	struct server *server = data;
+	server->output_layout_change_idle = NULL;
+
+	struct wlr_output_configuration_v1 *config =
+		create_output_config(server);
+	if (config) {
+		wlr_output_manager_v1_set_configuration(
+			server->output_manager, config);
+	} else {
+		wlr_log(WLR_ERROR,
+			"wlr_output_manager_v1_set_configuration()");
+	}
+	output_update_for_layout_change(server);
+}
+
+/*
+ * Hotplugging a dock or applying an output configuration results in a
+ * series of layout changes (one per output and mode set). Rather than
+ * re-arranging layers, views and the session lock for each of them, the
+ * final layout is applied once when the event loop goes idle.
+ */
 static void
 do_output_layout_change(struct server *server)
 {
-	if (!server->pending_output_layout_change) {
-		struct wlr_output_configuration_v1 *config =
-			create_output_config(server);
-		if (config) {
-			wlr_output_manager_v1_set_configuration(
-				server->output_manager, config);
-		} else {
-			wlr_log(WLR_ERROR,
-				"wlr_output_manager_v1_set_configuration()");
-		}
-		output_update_for_layout_change(server);
+	if (!server->pending_output_layout_change
+			&& !server->output_layout_change_idle) {
+		server->output_layout_change_idle = wl_event_loop_add_idle(
+			server->wl_event_loop,
+			handle_output_layout_change_idle, server);
 	}
 }
 
@@ -711,6 +1367,8 @@ handle_output_layout_change(struct wl_listener *listener, void *data)
 	struct server *server =
 		wl_container_of(listener, server, output_layout_change);
 
+	output_index_invalidate(server);
+
 	/* Prevents unnecessary layout recalculations */
 	server->pending_output_layout_change++;
 	output_virtual_update_fallback(server);
@@ -755,43 +1413,221 @@ output_manager_init(struct server *server)
 		&server->gamma_control_set_gamma);
 }
 
-struct output *
-output_from_wlr_output(struct server *server, struct wlr_output *wlr_output)
+/*
+ * Video walls have dozens of outputs, while views, menus and the cursor
+ * look up outputs by position all the time. The boxes of the outputs
+ * are therefore cut into a grid along all their edges, so that finding
+ * the output at a point takes two binary searches. Names are kept sorted
+ * for the same reason. Both are rebuilt on first use after a change.
+ */
+struct output_index {
+	int *x_edges; /* sorted, without duplicates */
+	int nr_x_edges;
+	int *y_edges;
+	int nr_y_edges;
+	/* (nr_x_edges - 1) * (nr_y_edges - 1) cells, row by row */
+	struct output **cells;
+	/* Outputs in the layout in layout order, for output_nearest_to() */
+	struct output **outputs;
+	struct wlr_box *boxes;
+	int nr_outputs;
+	struct output **by_name; /* sorted by name */
+	int nr_names;
+};
+
+static void
+output_index_invalidate(struct server *server)
+{
+	struct output_index *index = server->output_index;
+	if (!index) {
+		return;
+	}
+	free(index->x_edges);
+	free(index->y_edges);
+	free(index->cells);
+	free(index->outputs);
+	free(index->boxes);
+	free(index->by_name);
+	zfree(server->output_index);
+}
+
+static int
+compare_ints(const void *a, const void *b)
+{
+	int x = *(const int *)a;
+	int y = *(const int *)b;
+	return (x > y) - (x < y);
+}
+
+static int
+compare_output_names(const void *a, const void *b)
+{
+	const struct output *x = *(struct output *const *)a;
+	const struct output *y = *(struct output *const *)b;
+	return strcasecmp(x->wlr_output->name, y->wlr_output->name);
+}
+
+static int
+compare_name_to_output(const void *key, const void *elm)
+{
+	const struct output *output = *(struct output *const *)elm;
+	return strcasecmp(key, output->wlr_output->name);
+}
+
+/* Sorts @edges and drops duplicates, returns the new count */
+static int
+unique_edges(int *edges, int nr)
+{
+	qsort(edges, nr, sizeof(*edges), compare_ints);
+	int len = 0;
+	for (int i = 0; i < nr; i++) {
+		if (!len || edges[len - 1] != edges[i]) {
+			edges[len++] = edges[i];
+		}
+	}
+	return len;
+}
+
+/* Returns the cell containing @value, or -1 if outside all edges */
+static int
+edge_cell(const int *edges, int nr, double value)
+{
+	if (nr < 2 || value < edges[0] || value >= edges[nr - 1]) {
+		return -1;
+	}
+	int low = 0;
+	int high = nr - 1;
+	while (high - low > 1) {
+		int mid = (low + high) / 2;
+		if (value < edges[mid]) {
+			high = mid;
+		} else {
+			low = mid;
+		}
+	}
+	return low;
+}
+
+static struct output_index *
+output_index_get(struct server *server)
 {
+	if (server->output_index) {
+		return server->output_index;
+	}
+	struct output_index *index = znew(*index);
+	server->output_index = index;
+
+	int nr_layout_outputs = wl_list_length(&server->output_layout->outputs);
+	index->outputs = znew_n(struct output *, nr_layout_outputs);
+	index->boxes = znew_n(struct wlr_box, nr_layout_outputs);
+	index->x_edges = znew_n(int, 2 * nr_layout_outputs);
+	index->y_edges = znew_n(int, 2 * nr_layout_outputs);
+
+	struct wlr_output_layout_output *l_output;
+	wl_list_for_each(l_output, &server->output_layout->outputs, link) {
+		struct output *output = l_output->output->data;
+		struct wlr_box box;
+		wlr_output_layout_get_box(server->output_layout,
+			l_output->output, &box);
+		if (!output || wlr_box_empty(&box)) {
+			continue;
+		}
+		int i = index->nr_outputs++;
+		index->outputs[i] = output;
+		index->boxes[i] = box;
+		index->x_edges[2 * i] = box.x;
+		index->x_edges[2 * i + 1] = box.x + box.width;
+		index->y_edges[2 * i] = box.y;
+		index->y_edges[2 * i + 1] = box.y + box.height;
+	}
+	index->nr_x_edges = unique_edges(index->x_edges, 2 * index->nr_outputs);
+	index->nr_y_edges = unique_edges(index->y_edges, 2 * index->nr_outputs);
+
+	int columns = MAX(index->nr_x_edges - 1, 0);
+	int rows = MAX(index->nr_y_edges - 1, 0);
+	index->cells = znew_n(struct output *, MAX(columns * rows, 1));
+	for (int i = 0; i < index->nr_outputs; i++) {
+		struct wlr_box *box = &index->boxes[i];
+		int x0 = edge_cell(index->x_edges, index->nr_x_edges, box->x);
+		int y0 = edge_cell(index->y_edges, index->nr_y_edges, box->y);
+		for (int y = y0; y < rows && index->y_edges[y] < box->y
+				+ box->height; y++) {
+			for (int x = x0; x < columns && index->x_edges[x]
+					< box->x + box->width; x++) {
+				/* Like wlroots, the first output wins on overlap */
+				struct output **cell = &index->cells[y * columns + x];
+				if (!*cell) {
+					*cell = index->outputs[i];
+				}
+			}
+		}
+	}
+
+	index->by_name = znew_n(struct output *,
+		MAX(wl_list_length(&server->outputs), 1));
 	struct output *output;
 	wl_list_for_each(output, &server->outputs, link) {
-		if (output->wlr_output == wlr_output) {
-			return output;
+		if (output->wlr_output->name) {
+			index->by_name[index->nr_names++] = output;
 		}
 	}
-	return NULL;
+	qsort(index->by_name, index->nr_names, sizeof(*index->by_name),
+		compare_output_names);
+	return index;
+}
+
+struct output *
+output_from_wlr_output(struct server *server, struct wlr_output *wlr_output)
+{
+	/* Set by new_output_notify() for every output we manage */
+	return wlr_output ? wlr_output->data : NULL;
 }
 
 struct output *
 output_from_name(struct server *server, const char *name)
 {
-	struct output *output;
-	wl_list_for_each(output, &server->outputs, link) {
-		if (!output_is_usable(output) || !output->wlr_output->name) {
-			continue;
-		}
-		if (!strcasecmp(name, output->wlr_output->name)) {
-			return output;
-		}
+	struct output_index *index = output_index_get(server);
+	struct output **found = bsearch(name, index->by_name, index->nr_names,
+		sizeof(*index->by_name), compare_name_to_output);
+	if (!found || !output_is_usable(*found)) {
+		return NULL;
 	}
-	return NULL;
+	return *found;
+}
+
+struct output *
+output_at(struct server *server, double lx, double ly)
+{
+	struct output_index *index = output_index_get(server);
+	int x = edge_cell(index->x_edges, index->nr_x_edges, lx);
+	int y = edge_cell(index->y_edges, index->nr_y_edges, ly);
+	if (x < 0 || y < 0) {
+		return NULL;
+	}
+	return index->cells[y * (index->nr_x_edges - 1) + x];
 }
 
 struct output *
 output_nearest_to(struct server *server, int lx, int ly)
 {
-	double closest_x, closest_y;
-	wlr_output_layout_closest_point(server->output_layout, NULL, lx, ly,
-		&closest_x, &closest_y);
+	struct output *output = output_at(server, lx, ly);
+	if (output) {
+		return output;
+	}
 
-	return output_from_wlr_output(server,
-		wlr_output_layout_output_at(server->output_layout,
-			closest_x, closest_y));
+	/* Outside of all outputs, as wlr_output_layout_closest_point() */
+	struct output_index *index = server->output_index;
+	double min_distance = DBL_MAX;
+	for (int i = 0; i < index->nr_outputs; i++) {
+		double x, y;
+		wlr_box_closest_point(&index->boxes[i], lx, ly, &x, &y);
+		double distance = (x - lx) * (x - lx) + (y - ly) * (y - ly);
+		if (distance < min_distance) {
+			min_distance = distance;
+			output = index->outputs[i];
+		}
+	}
+	return output;
 }
 
 struct output *
@@ -828,15 +1664,39 @@ update_usable_area(struct output *output)
 	return !wlr_box_equal(&old, &output->usable_area);
 }
 
+static void
+handle_usable_area_idle(void *data)
+{
+	struct server *server = data;
+	server->usable_area_idle = NULL;
+#if HAVE_XWAYLAND
+	xwayland_update_workarea(server);
+#endif
+	desktop_arrange_all_views(server);
+}
+
+/*
+ * Usable areas tend to change several times in a row, for example when
+ * outputs are hotplugged or a panel restarts. Updating the XWayland
+ * workarea and re-arranging all views is therefore done only once, when
+ * the event loop goes idle.
+ */
+static void
+schedule_usable_area_update(struct server *server)
+{
+	if (!server->usable_area_idle) {
+		server->usable_area_idle = wl_event_loop_add_idle(
+			server->wl_event_loop, handle_usable_area_idle, server);
+	}
+}
+
 void
 output_update_usable_area(struct output *output)
 {
 	if (update_usable_area(output)) {
+		output->server->usable_area_generation++;
 		regions_update_geometry(output);
-#if HAVE_XWAYLAND
-		xwayland_update_workarea(output->server);
-#endif
-		desktop_arrange_all_views(output->server);
+		schedule_usable_area_update(output->server);
 	}
 }
 
@@ -855,10 +1715,26 @@ output_update_all_usable_areas(struct server *server, bool layout_changed)
 		}
 	}
 	if (usable_area_changed || layout_changed) {
-#if HAVE_XWAYLAND
-		xwayland_update_workarea(server);
-#endif
-		desktop_arrange_all_views(server);
+		server->usable_area_generation++;
+		schedule_usable_area_update(server);
+	}
+}
+
+void
+output_finish(struct server *server)
+{
+	output_state_cache_finish(server);
+	if (server->output_layout_change_idle) {
+		wl_event_source_remove(server->output_layout_change_idle);
+		server->output_layout_change_idle = NULL;
+	}
+	if (server->usable_area_idle) {
+		wl_event_source_remove(server->usable_area_idle);
+		server->usable_area_idle = NULL;
+	}
+	if (server->output_repaint_idle) {
+		wl_event_source_remove(server->output_repaint_idle);
+		server->output_repaint_idle = NULL;
 	}
 }
 
@@ -920,6 +1796,9 @@ handle_output_power_manager_set_mode(struct wl_listener *listener, void *data)
 		cursor_update_image(&server->seat);
 		break;
 	}
+
+	/* Views only shown on a powered off output are no longer visible */
+	edges_invalidate(server, NULL);
 }
 
 void
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include <assert.h>
 #include <wlr/render/pixman.h>
+#include "common/timers.h"
 #include "labwc.h"
 #include "overlay.h"
 #include "view.h"
@@ -79,7 +80,10 @@ show_overlay(struct seat *seat, struct overlay_rect *rect, struct wlr_box *box)
 		multi_rect_set_size(rect->pixman_rect, box->width, box->height);
 	}
 
-	wlr_scene_node_reparent(node, view->scene_tree->node.parent);
+	/* The nodes are allocated once and only moved around afterwards */
+	if (node->parent != view->scene_tree->node.parent) {
+		wlr_scene_node_reparent(node, view->scene_tree->node.parent);
+	}
 	wlr_scene_node_place_below(node, &view->scene_tree->node);
 	wlr_scene_node_set_position(node, box->x, box->y);
 	wlr_scene_node_set_enabled(node, true);
@@ -100,7 +104,7 @@ inactivate_overlay(struct overlay *overlay)
 	overlay->active.edge = VIEW_EDGE_INVALID;
 	overlay->active.output = NULL;
 	if (overlay->timer) {
-		wl_event_source_timer_update(overlay->timer, 0);
+		timers_update(overlay->timer, 0);
 	}
 }
 
@@ -116,74 +120,18 @@ show_region_overlay(struct seat *seat, struct region *region)
 	show_overlay(seat, &seat->overlay.region_rect, &region->geo);
 }
 
-/* TODO: share logic with view_get_edge_snap_box() */
-static struct wlr_box get_edge_snap_box(enum view_edge edge, struct output *output)
-{
-	struct wlr_box box = output_usable_area_in_layout_coords(output);
-	switch (edge) {
-	case VIEW_EDGE_RIGHT:
-		box.x += box.width / 2;
-		/* fallthrough */
-	case VIEW_EDGE_LEFT:
-		box.width /= 2;
-		break;
-	case VIEW_EDGE_DOWN:
-		box.y += box.height / 2;
-		/* fallthrough */
-	case VIEW_EDGE_UP:
-		box.height /= 2;
-		break;
-	case VIEW_EDGE_CENTER:
-		/* <topMaximize> */
-		break;
-	default:
-		/* not reached */
-		assert(false);
-	}
-	return box;
-}
-
 static int
 handle_edge_overlay_timeout(void *data)
 {
 	struct seat *seat = data;
 	assert(seat->overlay.active.edge != VIEW_EDGE_INVALID
 		&& seat->overlay.active.output);
-	struct wlr_box box = get_edge_snap_box(seat->overlay.active.edge,
-		seat->overlay.active.output);
+	struct wlr_box box = edge_get_snap_box(seat->overlay.active.output,
+		seat->overlay.active.edge);
 	show_overlay(seat, &seat->overlay.edge_rect, &box);
 	return 0;
 }
 
-static enum wlr_direction
-get_wlr_direction(enum view_edge edge)
-{
-	switch (edge) {
-	case VIEW_EDGE_LEFT:
-		return WLR_DIRECTION_LEFT;
-	case VIEW_EDGE_RIGHT:
-		return WLR_DIRECTION_RIGHT;
-	case VIEW_EDGE_UP:
-	case VIEW_EDGE_CENTER:
-		return WLR_DIRECTION_UP;
-	case VIEW_EDGE_DOWN:
-		return WLR_DIRECTION_DOWN;
-	default:
-		/* not reached */
-		assert(false);
-		return 0;
-	}
-}
-
-static bool
-edge_has_adjacent_output_from_cursor(struct seat *seat, struct output *output,
-		enum view_edge edge)
-{
-	return wlr_output_layout_adjacent_output(
-		seat->server->output_layout, get_wlr_direction(edge),
-		output->wlr_output, seat->cursor->x, seat->cursor->y);
-}
-
 static void
 show_edge_overlay(struct seat *seat, enum view_edge edge,
 		struct output *output)
@@ -200,7 +148,7 @@ show_edge_overlay(struct seat *seat, enum view_edge edge,
 	seat->overlay.active.output = output;
 
 	int delay;
-	if (edge_has_adjacent_output_from_cursor(seat, output, edge)) {
+	if (edge_has_adjacent_output(output, edge)) {
 		delay = rc.snap_preview_delay_inner;
 	} else {
 		delay = rc.snap_preview_delay_outer;
@@ -208,16 +156,15 @@ show_edge_overlay(struct seat *seat, enum view_edge edge,
 
 	if (delay > 0) {
 		if (!seat->overlay.timer) {
-			seat->overlay.timer = wl_event_loop_add_timer(
+			seat->overlay.timer = timers_add(
 				seat->server->wl_event_loop,
 				handle_edge_overlay_timeout, seat);
 		}
 		/* Show overlay <snapping><preview><delay>ms later */
-		wl_event_source_timer_update(seat->overlay.timer, delay);
+		timers_update(seat->overlay.timer, delay);
 	} else {
 		/* Show overlay now */
-		struct wlr_box box = get_edge_snap_box(seat->overlay.active.edge,
-			seat->overlay.active.output);
+		struct wlr_box box = edge_get_snap_box(output, edge);
 		show_overlay(seat, &seat->overlay.edge_rect, &box);
 	}
 }
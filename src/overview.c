@@ -0,0 +1,252 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_cursor.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/types/wlr_scene.h>
+#include "common/macros.h"
+#include "common/mem.h"
+#include "labwc.h"
+#include "overview.h"
+#include "theme.h"
+#include "thumbnail.h"
+#include "view.h"
+
+/* Gap between the thumbnails and around the grid in layout pixels */
+#define OVERVIEW_GAP (24)
+
+/*
+ * Thumbnails are rendered a few at a time, so that the work done per
+ * frame stays bounded no matter how many windows there are. Windows
+ * which keep changing are refreshed at a lower rate.
+ */
+#define OVERVIEW_RENDERS_PER_BATCH (4)
+#define OVERVIEW_REFRESH_MS (100)
+
+struct overview_item {
+	struct view *view;
+	struct wlr_scene_buffer *thumbnail;
+	struct wlr_box slot; /* in layout coordinates */
+	float scale; /* of the output the slot is on */
+};
+
+static int
+compare_view_centers(const void *a, const void *b)
+{
+	const struct view *va = *(struct view * const *)a;
+	const struct view *vb = *(struct view * const *)b;
+	int ya = va->current.y + va->current.height / 2;
+	int yb = vb->current.y + vb->current.height / 2;
+	if (ya != yb) {
+		return ya < yb ? -1 : 1;
+	}
+	int xa = va->current.x + va->current.width / 2;
+	int xb = vb->current.x + vb->current.width / 2;
+	return (xa > xb) - (xa < xb);
+}
+
+/*
+ * Lay out the views of an output in a grid of nearly square shape.
+ * Views are ordered by their centers first, so that the grid roughly
+ * keeps their arrangement on screen.
+ */
+static void
+layout_output(struct server *server, struct output *output,
+		struct view **views, int nr_views)
+{
+	qsort(views, nr_views, sizeof(*views), compare_view_centers);
+
+	struct wlr_box area = output_usable_area_in_layout_coords(output);
+	int cols = ceil(sqrt(nr_views));
+	int rows = (nr_views + cols - 1) / cols;
+	int slot_width = (area.width - (cols + 1) * OVERVIEW_GAP) / cols;
+	int slot_height = (area.height - (rows + 1) * OVERVIEW_GAP) / rows;
+	if (slot_width <= 0 || slot_height <= 0) {
+		return;
+	}
+
+	for (int i = 0; i < nr_views; i++) {
+		struct overview_item *item = wl_array_add(
+			&server->overview.items, sizeof(*item));
+		*item = (struct overview_item){
+			.view = views[i],
+			.thumbnail = wlr_scene_buffer_create(
+				server->overview.tree, NULL),
+			.slot = {
+				.x = area.x + OVERVIEW_GAP
+					+ (i % cols) * (slot_width + OVERVIEW_GAP),
+				.y = area.y + OVERVIEW_GAP
+					+ (i / cols) * (slot_height + OVERVIEW_GAP),
+				.width = slot_width,
+				.height = slot_height,
+			},
+			.scale = output->wlr_output->scale,
+		};
+	}
+}
+
+/* Returns false if some thumbnails are left outdated */
+static bool
+update_thumbnails(struct server *server, int *budget)
+{
+	bool current = true;
+	struct overview_item *item;
+	wl_array_for_each(item, &server->overview.items) {
+		int max_width = item->slot.width * item->scale;
+		int max_height = item->slot.height * item->scale;
+		struct wlr_buffer *buffer = thumbnail_get(item->view,
+			max_width, max_height, budget);
+		current &= thumbnail_is_current(item->view, max_width,
+			max_height);
+		if (!buffer || buffer == item->thumbnail->buffer) {
+			continue;
+		}
+		wlr_scene_buffer_set_buffer(item->thumbnail, buffer);
+
+		/* Center the snapshot, which keeps the aspect ratio */
+		int w = buffer->width / item->scale;
+		int h = buffer->height / item->scale;
+		wlr_scene_buffer_set_dest_size(item->thumbnail, w, h);
+		wlr_scene_node_set_position(&item->thumbnail->node,
+			item->slot.x + (item->slot.width - w) / 2,
+			item->slot.y + (item->slot.height - h) / 2);
+	}
+	return current;
+}
+
+static int
+handle_timer(void *data)
+{
+	struct server *server = data;
+	int budget = OVERVIEW_RENDERS_PER_BATCH;
+	if (!update_thumbnails(server, &budget)) {
+		/* Render the rest right away, but refresh live ones slowly */
+		wl_event_source_timer_update(server->overview.timer,
+			budget > 0 ? OVERVIEW_REFRESH_MS : 1);
+	}
+	return 0;
+}
+
+static void
+overview_begin(struct server *server)
+{
+	server->overview.tree = wlr_scene_tree_create(&server->scene->tree);
+	wlr_scene_node_place_above(&server->overview.tree->node,
+		&server->menu_tree->node);
+
+	struct wl_array views;
+	wl_array_init(&views);
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (!output_is_usable(output)) {
+			continue;
+		}
+		struct wlr_box box;
+		wlr_output_layout_get_box(server->output_layout,
+			output->wlr_output, &box);
+		struct wlr_scene_rect *background = wlr_scene_rect_create(
+			server->overview.tree, box.width, box.height,
+			server->theme->osd_bg_color);
+		wlr_scene_node_set_position(&background->node, box.x, box.y);
+
+		views.size = 0;
+		struct view *view;
+		wl_list_for_each(view, &server->views, link) {
+			if (view->mapped && !view->minimized
+					&& view->output == output
+					&& view->workspace
+						== server->workspace_current) {
+				struct view **entry =
+					wl_array_add(&views, sizeof(*entry));
+				*entry = view;
+			}
+		}
+		if (views.size) {
+			layout_output(server, output, views.data,
+				views.size / sizeof(struct view *));
+		}
+	}
+	wl_array_release(&views);
+
+	server->overview.timer = wl_event_loop_add_timer(
+		server->wl_event_loop, handle_timer, server);
+	wl_event_source_timer_update(server->overview.timer, 1);
+	cursor_update_focus(server);
+}
+
+void
+overview_finish(struct server *server)
+{
+	if (!server->overview.tree) {
+		return;
+	}
+	wl_event_source_remove(server->overview.timer);
+	server->overview.timer = NULL;
+	wl_array_release(&server->overview.items);
+	wl_array_init(&server->overview.items);
+	wlr_scene_node_destroy(&server->overview.tree->node);
+	server->overview.tree = NULL;
+	server->overview.pressed = false;
+	cursor_update_focus(server);
+}
+
+void
+overview_toggle(struct server *server)
+{
+	if (server->overview.tree) {
+		overview_finish(server);
+	} else {
+		overview_begin(server);
+	}
+}
+
+static struct view *
+view_at(struct server *server, double lx, double ly)
+{
+	struct overview_item *item;
+	wl_array_for_each(item, &server->overview.items) {
+		if (wlr_box_contains_point(&item->slot, lx, ly)) {
+			return item->view;
+		}
+	}
+	return NULL;
+}
+
+bool
+overview_handle_button(struct server *server, bool pressed)
+{
+	if (!server->overview.tree) {
+		return false;
+	}
+	if (pressed) {
+		server->overview.pressed = true;
+		return true;
+	}
+	if (!server->overview.pressed) {
+		/* Button was pressed before the overview was shown */
+		return false;
+	}
+	/* Select on release, so that the client never sees the release */
+	struct wlr_cursor *cursor = server->seat.cursor;
+	struct view *view = view_at(server, cursor->x, cursor->y);
+	overview_finish(server);
+	if (view) {
+		desktop_focus_view(view, /*raise*/ true);
+	}
+	return true;
+}
+
+void
+overview_on_view_unmap(struct view *view)
+{
+	struct server *server = view->server;
+	struct overview_item *item;
+	wl_array_for_each(item, &server->overview.items) {
+		if (item->view == view) {
+			overview_finish(server);
+			return;
+		}
+	}
+}
@@ -1,30 +1,100 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include <assert.h>
-#include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "common/macros.h"
 #include "common/mem.h"
 #include "labwc.h"
 #include "placement.h"
+#include "profile.h"
 #include "ssd.h"
 #include "view.h"
 
 #define overlap_bitmap_index(bmp, i, j) \
-	(bmp)->grid[i * ((bmp)->nr_cols - 1) + j]
+	(bmp)->grid[(i) * ((bmp)->cols.nr - 1) + (j)]
+
+/* Sorted edges of a 1-D grid and the number of view edges on each of them */
+struct grid_axis {
+	int nr;
+	int alloc;
+	int *edges;
+	int *refs;
+};
 
 struct overlap_bitmap {
-	int nr_rows;
-	int nr_cols;
-	int *rows;
-	int *cols;
+	struct grid_axis rows;
+	struct grid_axis cols;
 	int *grid;
+
+	/*
+	 * Prefix sums of the overlap counters weighted by interval area,
+	 * see build_prefix_sums(). Rebuilt before searching whenever the
+	 * grid has changed.
+	 */
+	bool prefix_sums_dirty;
+	int64_t *area_sum;	/* (rows.nr) x (cols.nr) */
+	int64_t *col_sum;	/* (rows.nr - 1) x (cols.nr - 1) */
+	int64_t *row_sum;	/* (rows.nr - 1) x (cols.nr - 1) */
 };
 
-static int
-compare_ints(const void *a, const void *b)
+struct placement_entry {
+	/* Only used as a key, never dereferenced */
+	struct view *view;
+	/* Area accounted for in the overlap bitmap */
+	struct wlr_box box;
+	bool seen;
+};
+
+/*
+ * The overlap bitmap of an output is kept around between placements and
+ * brought up-to-date by only accounting for views which have been mapped,
+ * unmapped or moved since the last placement.
+ */
+struct placement_cache {
+	struct wlr_box usable;
+	struct overlap_bitmap bmp;
+	struct wl_array entries; /* struct placement_entry */
+};
+
+static void
+axis_finish(struct grid_axis *axis)
 {
-	return *(const int *)a - *(const int *)b;
+	zfree(axis->edges);
+	zfree(axis->refs);
+	axis->nr = 0;
+	axis->alloc = 0;
+}
+
+static void
+axis_insert(struct grid_axis *axis, int idx, int val)
+{
+	if (axis->nr == axis->alloc) {
+		axis->alloc = MAX(16, 2 * axis->alloc);
+		axis->edges = xrealloc(axis->edges,
+			axis->alloc * sizeof(*axis->edges));
+		axis->refs = xrealloc(axis->refs,
+			axis->alloc * sizeof(*axis->refs));
+	}
+	memmove(&axis->edges[idx + 1], &axis->edges[idx],
+		(axis->nr - idx) * sizeof(*axis->edges));
+	memmove(&axis->refs[idx + 1], &axis->refs[idx],
+		(axis->nr - idx) * sizeof(*axis->refs));
+	axis->edges[idx] = val;
+	axis->refs[idx] = 1;
+	axis->nr++;
+}
+
+static void
+axis_remove(struct grid_axis *axis, int idx)
+{
+	axis->nr--;
+	memmove(&axis->edges[idx], &axis->edges[idx + 1],
+		(axis->nr - idx) * sizeof(*axis->edges));
+	memmove(&axis->refs[idx], &axis->refs[idx + 1],
+		(axis->nr - idx) * sizeof(*axis->refs));
 }
 
 static void
@@ -32,278 +102,471 @@ destroy_bitmap(struct overlap_bitmap *bmp)
 {
 	assert(bmp);
 
-	zfree(bmp->rows);
-	zfree(bmp->cols);
+	axis_finish(&bmp->rows);
+	axis_finish(&bmp->cols);
 	zfree(bmp->grid);
+	zfree(bmp->area_sum);
+	zfree(bmp->col_sum);
+	zfree(bmp->row_sum);
+}
+
+/*
+ * Start with a grid consisting of a single interval which spans the
+ * usable area of the output and is not covered by any view.
+ */
+static void
+init_bitmap(struct overlap_bitmap *bmp, struct wlr_box *usable)
+{
+	destroy_bitmap(bmp);
+
+	axis_insert(&bmp->rows, 0, usable->y);
+	axis_insert(&bmp->rows, 1, usable->y + usable->height);
+	axis_insert(&bmp->cols, 0, usable->x);
+	axis_insert(&bmp->cols, 1, usable->x + usable->width);
 
-	bmp->nr_rows = 0;
-	bmp->nr_cols = 0;
+	bmp->grid = xzalloc(sizeof(*bmp->grid));
+	bmp->prefix_sums_dirty = true;
 }
 
-/* Count the number of views on view->output, excluding *view itself */
-static int
-count_views(struct view *view)
+/*
+ * A new row edge has been inserted at index idx, splitting the row
+ * interval idx - 1 in two. Both halves are covered by the same views.
+ */
+static void
+bitmap_split_row(struct overlap_bitmap *bmp, int idx)
 {
-	assert(view);
+	int nri = bmp->rows.nr - 1;
+	int nci = bmp->cols.nr - 1;
 
-	struct server *server = view->server;
+	bmp->grid = xrealloc(bmp->grid, nri * nci * sizeof(*bmp->grid));
+	memmove(&bmp->grid[idx * nci], &bmp->grid[(idx - 1) * nci],
+		(nri - idx) * nci * sizeof(*bmp->grid));
+}
 
-	struct output *output = view->output;
-	if (!output_is_usable(output)) {
-		return 0;
+/* Same as bitmap_split_row() for a new column edge */
+static void
+bitmap_split_col(struct overlap_bitmap *bmp, int idx)
+{
+	int nri = bmp->rows.nr - 1;
+	int nci = bmp->cols.nr - 1;
+
+	int *grid = xzalloc(nri * nci * sizeof(*grid));
+	for (int i = 0; i < nri; i++) {
+		int *src = &bmp->grid[i * (nci - 1)];
+		int *dst = &grid[i * nci];
+		for (int j = 0; j < nci; j++) {
+			dst[j] = src[j < idx ? j : j - 1];
+		}
 	}
+	free(bmp->grid);
+	bmp->grid = grid;
+}
 
-	int nviews = 0;
+/*
+ * The last view edge on row edge idx is going away, merge the row
+ * intervals on either side of it. Both are covered by the same views
+ * because no view edge separates them anymore.
+ */
+static void
+bitmap_merge_row(struct overlap_bitmap *bmp, int idx)
+{
+	int nri = bmp->rows.nr - 1;
+	int nci = bmp->cols.nr - 1;
 
-	struct view *v;
-	for_each_view(v, &server->views, LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
-		/* Ignore the target view or anything on a different output */
-		if (v == view || v->output != output) {
-			continue;
-		}
+	memmove(&bmp->grid[(idx - 1) * nci], &bmp->grid[idx * nci],
+		(nri - idx) * nci * sizeof(*bmp->grid));
+}
 
-		nviews++;
+/* Same as bitmap_merge_row() for a column edge */
+static void
+bitmap_merge_col(struct overlap_bitmap *bmp, int idx)
+{
+	int nri = bmp->rows.nr - 1;
+	int nci = bmp->cols.nr - 1;
+
+	/* Compact in place, destination never overtakes the source */
+	for (int i = 0; i < nri; i++) {
+		int *src = &bmp->grid[i * nci];
+		int *dst = &bmp->grid[i * (nci - 1)];
+		for (int j = 0; j < nci - 1; j++) {
+			dst[j] = src[j < idx - 1 ? j : j + 1];
+		}
 	}
-
-	return nviews;
 }
 
-/* Sort and de-duplicate a list of points that define a 1-D grid */
+/*
+ * Perform a rightmost binary search along a list of edges in a 1-D grid for
+ * the maximum index j such that edges[j] <= val. The list of edges must be
+ * sorted in increasing order.
+ *
+ * For a returned index j:
+ *
+ * - The index j == -1 implies that val < edges[0].
+ * - An index 0 <= j < (nedges - 1) implies that edges[j] <= val < edges[j + 1].
+ * - The index j == (nedges - 1) implies that edges[nedges - 1] <= val.
+ */
 static int
-order_grid(int *edges, int nedges)
+find_interval(int *edges, int nedges, double val)
 {
-	/* Sort grid edges */
-	qsort(edges, nedges, sizeof(int), compare_ints);
-
-	/* Skip over non-unique edges, counting the unique ones */
-	/* This is taken almost verbatim from Openbox. */
-	int i = 0;
-	int j = 0;
-
-	while (j < nedges) {
-		int last = edges[j++];
-		edges[i++] = last;
-		while (j < nedges && edges[j] == last) {
-			++j;
+	int l = 0;
+	int r = nedges;
+
+	while (l < r) {
+		int m = (l + r) / 2;
+		if (edges[m] > val) {
+			r = m;
+		} else {
+			l = m + 1;
 		}
 	}
 
-	return i;
+	return r - 1;
 }
 
 /*
- * Construct an irregular grid that divides the usable area of view->output
- * by extending the edges of every view on the output (except for *view itself)
- * to infinity. The resulting grid will consist of rectangular intervals that
- * are either completely uncovered by any view, or entirely covered.
- * Furthermore, when any view intersects any interval on the grid, that view
- * overlaps the whole interval: no view ever partially intersects any interval.
+ * Add a view edge to the grid. Only edges within the usable area split
+ * the grid; the edges of the usable area itself are always present.
  */
 static void
-build_grid(struct overlap_bitmap *bmp, struct view *view)
+bitmap_ref_edge(struct overlap_bitmap *bmp, bool row, int val)
 {
-	assert(bmp);
-	assert(view);
-
-	struct server *server = view->server;
-
-	/* Always start with a fresh bitmap */
-	destroy_bitmap(bmp);
-
-	struct output *output = view->output;
-	if (!output_is_usable(output)) {
+	struct grid_axis *axis = row ? &bmp->rows : &bmp->cols;
+	if (val <= axis->edges[0] || val >= axis->edges[axis->nr - 1]) {
 		return;
 	}
 
-	int nviews = count_views(view);
-	if (nviews < 1) {
+	int j = find_interval(axis->edges, axis->nr, val);
+	if (axis->edges[j] == val) {
+		axis->refs[j]++;
 		return;
 	}
 
-	/* Number of rows/columns is bounded by two per view plus screen edges */
-	int max_rc = 2 * nviews + 2;
+	axis_insert(axis, j + 1, val);
+	if (row) {
+		bitmap_split_row(bmp, j + 1);
+	} else {
+		bitmap_split_col(bmp, j + 1);
+	}
+}
 
-	bmp->rows = xzalloc(max_rc * sizeof(int));
-	bmp->cols = xzalloc(max_rc * sizeof(int));
-	if (!bmp->rows || !bmp->cols) {
-		destroy_bitmap(bmp);
+static void
+bitmap_unref_edge(struct overlap_bitmap *bmp, bool row, int val)
+{
+	struct grid_axis *axis = row ? &bmp->rows : &bmp->cols;
+	if (val <= axis->edges[0] || val >= axis->edges[axis->nr - 1]) {
 		return;
 	}
 
-	/* First edges of grid are start of usable area of output */
-	struct wlr_box usable = output_usable_area_in_layout_coords(output);
-	int usable_right = usable.x + usable.width;
-	int usable_bottom = usable.y + usable.height;
-
-	bmp->cols[0] = usable.x;
-	bmp->rows[0] = usable.y;
-
-	bmp->cols[1] = usable_right;
-	bmp->rows[1] = usable_bottom;
+	int j = find_interval(axis->edges, axis->nr, val);
+	assert(axis->edges[j] == val);
+	if (--axis->refs[j] > 0) {
+		return;
+	}
 
-	int nr_rows = 2;
-	int nr_cols = 2;
+	if (row) {
+		bitmap_merge_row(bmp, j);
+	} else {
+		bitmap_merge_col(bmp, j);
+	}
+	axis_remove(axis, j);
+}
 
-	struct view *v;
-	for_each_view(v, &server->views, LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
-		if (v == view || v->output != output) {
-			continue;
-		}
+/*
+ * Add delta to the overlap counters of all intervals covered by box.
+ * The edges of box must already be part of the grid.
+ */
+static void
+bitmap_update_overlap(struct overlap_bitmap *bmp, struct wlr_box *box,
+		int delta)
+{
+	int lx = box->x;
+	int ly = box->y;
+	int hx = box->x + box->width;
+	int hy = box->y + box->height;
 
-		struct border margin = ssd_get_margin(v->ssd);
-		int x = v->pending.x - margin.left;
-		int y = v->pending.y - margin.top;
+	/*
+	 * Find the first and last row and column intervals spanned by
+	 * this view. We want the left and top edges to fall in a
+	 * half-open interval [low, high) but the right and bottom
+	 * edges to fall in a half-open interval (low, high] to ensure
+	 * that the results do not include intervals adjacent to the
+	 * view. View edges are guaranteed by construction to fall
+	 * exactly on the grid points, so we perturb the left and top
+	 * edges by +0.5 units, and the right and bottom edges by -0.5
+	 * units, to ensure that we are always searching in the
+	 * interior of an interval.
+	 */
 
-		/* Add a column if the left view edge is in the usable region */
-		if (x > usable.x && x < usable_right) {
-			assert(nr_cols < max_rc);
-			bmp->cols[nr_cols++] = x;
-		}
+	/* First row and column overlapping the view */
+	int fc = find_interval(bmp->cols.edges, bmp->cols.nr, lx + 0.5);
+	int fr = find_interval(bmp->rows.edges, bmp->rows.nr, ly + 0.5);
 
-		/* Add a row if the top view edge is in the usable region */
-		if (y > usable.y && y < usable_bottom) {
-			assert(nr_rows < max_rc);
-			bmp->rows[nr_rows++] = y;
-		}
+	/* Clip first row/column to start of usable grid */
+	fc = MAX(fc, 0);
+	fr = MAX(fr, 0);
 
-		x = v->pending.x + margin.right + v->pending.width;
-		y = v->pending.y + margin.bottom
-			+ view_effective_height(v, /* use_pending */ true);
+	/* Last row and column overlapping the view */
+	int lc = find_interval(bmp->cols.edges, bmp->cols.nr, hx - 0.5);
+	int lr = find_interval(bmp->rows.edges, bmp->rows.nr, hy - 0.5);
 
-		/* Add a column if the right view edge is in the usable region */
-		if (x > usable.x && x < usable_right) {
-			assert(nr_cols < max_rc);
-			bmp->cols[nr_cols++] = x;
-		}
+	/*
+	 * Increment the last indices to convert them to strict upper
+	 * bounds, then clip them to the limits of the usable grid.
+	 */
+	lc = MIN(bmp->cols.nr - 1, lc + 1);
+	lr = MIN(bmp->rows.nr - 1, lr + 1);
 
-		/* Add a row if the bottom view edge is in the usable region */
-		if (y > usable.y && y < usable_bottom) {
-			assert(nr_rows < max_rc);
-			bmp->rows[nr_rows++] = y;
+	/*
+	 * Every interval in the region [fr, lr) x [fc, lc) is
+	 * completely covered by the view. Update the overlap
+	 * counters of these intervals to account for the view.
+	 */
+	for (int i = fr; i < lr; ++i) {
+		for (int j = fc; j < lc; ++j) {
+			overlap_bitmap_index(bmp, i, j) += delta;
 		}
 	}
+}
 
-	bmp->nr_rows = order_grid(bmp->rows, nr_rows);
-	bmp->nr_cols = order_grid(bmp->cols, nr_cols);
-
-	int grid_size = (bmp->nr_rows - 1) * (bmp->nr_cols - 1);
+static void
+bitmap_add_box(struct overlap_bitmap *bmp, struct wlr_box *box)
+{
+	bitmap_ref_edge(bmp, /* row */ false, box->x);
+	bitmap_ref_edge(bmp, /* row */ false, box->x + box->width);
+	bitmap_ref_edge(bmp, /* row */ true, box->y);
+	bitmap_ref_edge(bmp, /* row */ true, box->y + box->height);
+	bitmap_update_overlap(bmp, box, 1);
+	bmp->prefix_sums_dirty = true;
+}
 
-	bmp->grid = xzalloc(grid_size * sizeof(int));
-	if (!bmp->grid) {
-		destroy_bitmap(bmp);
-		return;
-	}
+static void
+bitmap_remove_box(struct overlap_bitmap *bmp, struct wlr_box *box)
+{
+	bitmap_update_overlap(bmp, box, -1);
+	bitmap_unref_edge(bmp, /* row */ false, box->x);
+	bitmap_unref_edge(bmp, /* row */ false, box->x + box->width);
+	bitmap_unref_edge(bmp, /* row */ true, box->y);
+	bitmap_unref_edge(bmp, /* row */ true, box->y + box->height);
+	bmp->prefix_sums_dirty = true;
 }
 
 /*
- * Perform a rightmost binary search along a list of edges in a 1-D grid for
- * the maximum index j such that edges[j] <= val. The list of edges must be
- * sorted in increasing order.
+ * Build a summed-area table of the overlap bitmap so that the overlap
+ * of any rectangle can be computed in constant time (plus a binary
+ * search for its corners). With c(i, j), h(i) and w(j) being the overlap
+ * count, height and width of interval (i, j):
  *
- * For a returned index j:
+ * - area_sum(i, j) is the sum of c * h * w of all intervals above row i
+ *   and left of column j
+ * - col_sum(i, j) is the sum of c * h of the intervals above row i in
+ *   column j
+ * - row_sum(i, j) is the sum of c * w of the intervals left of column j
+ *   in row i
  *
- * - The index j == -1 implies that val < edges[0].
- * - An index 0 <= j < (nedges - 1) implies that edges[j] <= val < edges[j + 1].
- * - The index j == (nedges - 1) implies that edges[nedges - 1] <= val.
+ * The latter two account for regions which only partially cover an
+ * interval, see prefix_overlap().
  */
-static int
-find_interval(int *edges, int nedges, double val)
+static void
+build_prefix_sums(struct overlap_bitmap *bmp)
 {
-	int l = 0;
-	int r = nedges;
+	if (!bmp->prefix_sums_dirty) {
+		return;
+	}
+	bmp->prefix_sums_dirty = false;
+
+	int nr = bmp->rows.nr;
+	int nc = bmp->cols.nr;
+	int nri = nr - 1;
+	int nci = nc - 1;
+
+	bmp->area_sum = xrealloc(bmp->area_sum,
+		nr * nc * sizeof(*bmp->area_sum));
+	bmp->col_sum = xrealloc(bmp->col_sum,
+		nri * nci * sizeof(*bmp->col_sum));
+	bmp->row_sum = xrealloc(bmp->row_sum,
+		nri * nci * sizeof(*bmp->row_sum));
+
+	int64_t *area = bmp->area_sum;
+	memset(area, 0, nc * sizeof(*area));
+
+	for (int i = 0; i < nri; i++) {
+		int64_t h = bmp->rows.edges[i + 1] - bmp->rows.edges[i];
+		int64_t *col = &bmp->col_sum[i * nci];
+		int64_t *row = &bmp->row_sum[i * nci];
+		area[(i + 1) * nc] = 0;
+		for (int j = 0; j < nci; j++) {
+			int64_t w = bmp->cols.edges[j + 1] - bmp->cols.edges[j];
+			int64_t c = overlap_bitmap_index(bmp, i, j);
+
+			if (i == 0) {
+				col[j] = 0;
+			} else {
+				int64_t h_above = bmp->rows.edges[i]
+					- bmp->rows.edges[i - 1];
+				col[j] = col[j - nci] + h_above
+					* overlap_bitmap_index(bmp, i - 1, j);
+			}
+			if (j == 0) {
+				row[j] = 0;
+			} else {
+				int64_t w_left = bmp->cols.edges[j]
+					- bmp->cols.edges[j - 1];
+				row[j] = row[j - 1] + w_left
+					* overlap_bitmap_index(bmp, i, j - 1);
+			}
 
-	while (l < r) {
-		int m = (l + r) / 2;
-		if (edges[m] > val) {
-			r = m;
-		} else {
-			l = m + 1;
+			area[(i + 1) * nc + j + 1] = area[i * nc + j + 1]
+				+ area[(i + 1) * nc + j] - area[i * nc + j]
+				+ c * h * w;
 		}
 	}
-
-	return r - 1;
 }
 
 /*
- * Construct an overlap bitmap for the irregular grid, computed by
- * build_grid(), that spans view->output. The overlap bitmap maps
- * each interval to the number of views on the output (excluding *view)
- * that overlap that interval.
+ * Overlap of the region spanning from the top-left corner of the grid to
+ * (x, y), which must lie within the grid. Intervals are partially
+ * covered when (x, y) is not on a grid point.
  */
-static void
-build_overlap(struct overlap_bitmap *bmp, struct view *view)
+static int64_t
+prefix_overlap(struct overlap_bitmap *bmp, int x, int y)
 {
-	assert(bmp);
-	assert(view);
+	int nci = bmp->cols.nr - 1;
+	int nri = bmp->rows.nr - 1;
+
+	int j = MIN(find_interval(bmp->cols.edges, bmp->cols.nr, x), nci - 1);
+	int i = MIN(find_interval(bmp->rows.edges, bmp->rows.nr, y), nri - 1);
+	assert(i >= 0 && j >= 0);
+
+	int64_t dx = x - bmp->cols.edges[j];
+	int64_t dy = y - bmp->rows.edges[i];
+
+	return bmp->area_sum[i * (nci + 1) + j]
+		+ dx * bmp->col_sum[i * nci + j]
+		+ dy * bmp->row_sum[i * nci + j]
+		+ dx * dy * overlap_bitmap_index(bmp, i, j);
+}
+
+/* Area covered by a view including its server-side decoration */
+static struct wlr_box
+get_view_box(struct view *view)
+{
+	struct border margin = ssd_get_margin(view->ssd);
+	struct wlr_box box = {
+		.x = view->pending.x - margin.left,
+		.y = view->pending.y - margin.top,
+		.width = view->pending.width + margin.left + margin.right,
+		.height = view_effective_height(view, /* use_pending */ true)
+			+ margin.top + margin.bottom,
+	};
+	return box;
+}
+
+static int
+compare_entries(const void *a, const void *b)
+{
+	uintptr_t view_a = (uintptr_t)((const struct placement_entry *)a)->view;
+	uintptr_t view_b = (uintptr_t)((const struct placement_entry *)b)->view;
+	return (view_a > view_b) - (view_a < view_b);
+}
 
+/* Looks up @view among the first @nr_sorted entries, sorted by view */
+static struct placement_entry *
+find_entry(struct placement_cache *cache, size_t nr_sorted, struct view *view)
+{
+	struct placement_entry key = { .view = view };
+	return bsearch(&key, cache->entries.data, nr_sorted,
+		sizeof(struct placement_entry), compare_entries);
+}
+
+/*
+ * Bring the overlap bitmap of view->output up-to-date. The resulting
+ * grid divides the usable area of the output by extending the edges of
+ * every view on the output (except for *view itself) to infinity. Each
+ * interval of the grid is either completely uncovered by any view, or
+ * entirely covered, and is mapped to the number of views overlapping it.
+ */
+static struct overlap_bitmap *
+update_bitmap(struct view *view)
+{
 	struct server *server = view->server;
+	struct output *output = view->output;
 
-	if (bmp->nr_rows < 1 || bmp->nr_cols < 1) {
-		return;
+	if (!output->placement_cache) {
+		output->placement_cache = znew(*output->placement_cache);
+		wl_array_init(&output->placement_cache->entries);
 	}
+	struct placement_cache *cache = output->placement_cache;
 
-	struct output *output = view->output;
-	if (!output_is_usable(output)) {
-		return;
+	struct wlr_box usable = output_usable_area_in_layout_coords(output);
+	if (!cache->bmp.grid || !wlr_box_equal(&usable, &cache->usable)) {
+		init_bitmap(&cache->bmp, &usable);
+		cache->usable = usable;
+		cache->entries.size = 0;
+	}
+
+	struct placement_entry *entry;
+	wl_array_for_each(entry, &cache->entries) {
+		entry->seen = false;
 	}
 
+	/* Entries of new views are appended behind the sorted ones */
+	size_t nr_sorted = cache->entries.size / sizeof(*entry);
+	qsort(cache->entries.data, nr_sorted, sizeof(*entry), compare_entries);
+
 	struct view *v;
 	for_each_view(v, &server->views, LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
+		/* Ignore the target view or anything on a different output */
 		if (v == view || v->output != output) {
 			continue;
 		}
 
-		/* Find boundaries of the window */
-		struct border margin = ssd_get_margin(v->ssd);
-		int lx = v->pending.x - margin.left;
-		int ly = v->pending.y - margin.top;
-		int hx = v->pending.x + margin.right + v->pending.width;
-		int hy = v->pending.y + margin.bottom
-			+ view_effective_height(v, /* use_pending */ true);
-
-		/*
-		 * Find the first and last row and column intervals spanned by
-		 * this view. We want the left and top edges to fall in a
-		 * half-open interval [low, high) but the right and bottom
-		 * edges to fall in a half-open interval (low, high] to ensure
-		 * that the results do not include intervals adjacent to the
-		 * view. View edges are guaranteed by construction to fall
-		 * exactly on the grid points, so we perturb the left and top
-		 * edges by +0.5 units, and the right and bottom edges by -0.5
-		 * units, to ensure that we are always searching in the
-		 * interior of an interval.
-		 */
-
-		/* First row and column overlapping the view */
-		int fc = find_interval(bmp->cols, bmp->nr_cols, lx + 0.5);
-		int fr = find_interval(bmp->rows, bmp->nr_rows, ly + 0.5);
-
-		/* Clip first row/column to start of usable grid */
-		fc = MAX(fc, 0);
-		fr = MAX(fr, 0);
-
-		/* Last row and column overlapping the view */
-		int lc = find_interval(bmp->cols, bmp->nr_cols, hx - 0.5);
-		int lr = find_interval(bmp->rows, bmp->nr_rows, hy - 0.5);
-
-		/*
-		 * Increment the last indices to convert them to strict upper
-		 * bounds, then clip them to the limits of the usable grid.
-		 */
-		lc = MIN(bmp->nr_cols - 1, lc + 1);
-		lr = MIN(bmp->nr_rows - 1, lr + 1);
-
-		/*
-		 * Every interval in the region [fr, lr) x [fc, lc) is
-		 * completely covered by the view. Increment the overlap
-		 * counters these intervals to account for the view.
-		 */
-		for (int i = fr; i < lr; ++i) {
-			for (int j = fc; j < lc; ++j) {
-				overlap_bitmap_index(bmp, i, j) += 1;
+		struct wlr_box box = get_view_box(v);
+		entry = find_entry(cache, nr_sorted, v);
+		if (!entry) {
+			entry = wl_array_add(&cache->entries, sizeof(*entry));
+			if (!entry) {
+				wlr_log(WLR_ERROR, "wl_array_add(): out of memory");
+				continue;
 			}
+			entry->view = v;
+			bitmap_add_box(&cache->bmp, &box);
+		} else if (!wlr_box_equal(&box, &entry->box)) {
+			bitmap_remove_box(&cache->bmp, &entry->box);
+			bitmap_add_box(&cache->bmp, &box);
 		}
+		entry->box = box;
+		entry->seen = true;
+	}
+
+	/*
+	 * Forget about views which have been unmapped, moved to another
+	 * workspace or output or are the one being placed right now.
+	 */
+	struct placement_entry *entries = cache->entries.data;
+	size_t nr_entries = cache->entries.size / sizeof(*entries);
+	for (size_t i = 0; i < nr_entries;) {
+		if (entries[i].seen) {
+			i++;
+			continue;
+		}
+		bitmap_remove_box(&cache->bmp, &entries[i].box);
+		entries[i] = entries[--nr_entries];
+	}
+	cache->entries.size = nr_entries * sizeof(*entries);
+
+	return &cache->bmp;
+}
+
+void
+placement_on_output_destroy(struct output *output)
+{
+	struct placement_cache *cache = output->placement_cache;
+	if (!cache) {
+		return;
 	}
+	destroy_bitmap(&cache->bmp);
+	wl_array_release(&cache->entries);
+	zfree(output->placement_cache);
 }
 
 /*
@@ -316,82 +579,40 @@ build_overlap(struct overlap_bitmap *bmp, struct view *view)
  *
  * If the region would extend beyond the edges of the grid (i.e., beyond the
  * usable region of an output) in the prescribed directions, an overlap of
- * INT_MAX is returned. Otherwise, the overlap is the sum of the areas of each
+ * INT64_MAX is returned. Otherwise, the overlap is the sum of the areas of each
  * interval covered by the region multiplied by its overlap count. For example,
  * an interval currently covered by three windows will be triply counted in the
  * overlap sum.
  */
-static int
+static int64_t
 compute_overlap(struct overlap_bitmap *bmp, int i, int j,
 		int width, int height, bool right, bool down, bool *single)
 {
-	/*
-	 * The number of row or column intervals is one less than corresponding
-	 * number of row or column grid points.
-	 */
-	int nri = bmp->nr_rows - 1;
-	int nci = bmp->nr_cols - 1;
-
-	int i_incr = down ? 1 : -1;
-	int j_incr = right ? 1 : -1;
-
-	int overlap = 0;
-	int count = 0;
-
-	/* Walk up or down along rows according to preference */
-	for (int ii = i; ii >= 0 && ii < nri && height > 0; ii += i_incr) {
-		/* Height of this row */
-		int rh = bmp->rows[ii + 1] - bmp->rows[ii];
-
-		/* Height of overlap between this row and test region */
-		int mh = MAX(0, MIN(height, rh));
-
-		/* Remaining height to consider for next row */
-		height -= rh;
-
-		/* Walk left or right along columns according to preference */
-		int ww = width;
-		for (int jj = j; jj >= 0 && jj < nci && ww > 0; jj += j_incr) {
-			/* Width of this column */
-			int cw = bmp->cols[jj + 1] - bmp->cols[jj];
-
-			/* Width of overlap between this column and test region */
-			int mw = MAX(0, MIN(ww, cw));
+	int *rows = bmp->rows.edges;
+	int *cols = bmp->cols.edges;
 
-			/* Add overlap contribution for this interval */
-			overlap += overlap_bitmap_index(bmp, ii, jj) * mh * mw;
-
-			/* Count the number of overlapping intervals */
-			count++;
-
-			/* Remaining width to consider for next column */
-			ww -= cw;
-		}
-
-		/*
-		 * If there is width left to consider after walking columns,
-		 * the region extends out of bounds and placement is invalid.
-		 */
-		if (ww > 0) {
-			overlap = INT_MAX;
-			break;
-		}
+	/* Indicate whether overlap is confined to a single region */
+	if (single) {
+		*single = width <= cols[j + 1] - cols[j]
+			&& height <= rows[i + 1] - rows[i];
 	}
 
+	/* Align the region with the interval according to preference */
+	int x0 = right ? cols[j] : cols[j + 1] - width;
+	int y0 = down ? rows[i] : rows[i + 1] - height;
+	int x1 = x0 + width;
+	int y1 = y0 + height;
+
 	/*
-	 * If there is height left ot consider after walking rows, the region
-	 * extends out of bounds and placement is invalid.
+	 * If the region extends out of bounds, placement is invalid.
 	 */
-	if (height > 0) {
-		overlap = INT_MAX;
-	}
-
-	/* Indicate whether overlap is confined to a single region */
-	if (single) {
-		*single = (count == 1);
+	if (x0 < cols[0] || x1 > cols[bmp->cols.nr - 1]
+			|| y0 < rows[0] || y1 > rows[bmp->rows.nr - 1]) {
+		return INT64_MAX;
 	}
 
-	return overlap;
+	return prefix_overlap(bmp, x1, y1) - prefix_overlap(bmp, x0, y1)
+		- prefix_overlap(bmp, x1, y0) + prefix_overlap(bmp, x0, y0);
 }
 
 /*
@@ -412,15 +633,16 @@ placement_find_best(struct view *view, struct wlr_box *geometry)
 		return false;
 	}
 
+	int64_t profile_start = profile_begin();
+
 	/* Default placement is upper-left corner, respecting gaps */
 	struct wlr_box usable = output_usable_area_in_layout_coords(output);
 	geometry->x = usable.x + margin.left + rc.gap;
 	geometry->y = usable.y + margin.top + rc.gap;
 
-	/* Build the placement grid and overlap bitmap */
-	struct overlap_bitmap bmp = { 0 };
-	build_grid(&bmp, view);
-	build_overlap(&bmp, view);
+	/* Bring the placement grid and overlap bitmap up-to-date */
+	struct overlap_bitmap *bmp = update_bitmap(view);
+	build_prefix_sums(bmp);
 
 	/* Dimensions include gap along all edges to ensure proper separation */
 	int height = geometry->height + margin.top + margin.bottom + 2 * rc.gap;
@@ -433,10 +655,10 @@ placement_find_best(struct view *view, struct wlr_box *geometry)
 	int offset_x = margin.left + rc.gap;
 	int offset_y = margin.top + rc.gap;
 
-	int min_overlap = INT_MAX;
+	int64_t min_overlap = INT64_MAX;
 
-	int nri = bmp.nr_rows - 1;
-	int nci = bmp.nr_cols - 1;
+	int nri = bmp->rows.nr - 1;
+	int nci = bmp->cols.nr - 1;
 
 	/*
 	 * Convolve the view region with the overlap grid to determine the
@@ -477,7 +699,7 @@ placement_find_best(struct view *view, struct wlr_box *geometry)
 				bool single = false;
 
 				/* Compute overlap in specified direction */
-				int overlap = compute_overlap(&bmp, i, j,
+				int64_t overlap = compute_overlap(bmp, i, j,
 					width, height, rt, dn, &single);
 
 				/* Move on if overlap isn't reduced */
@@ -490,20 +712,20 @@ placement_find_best(struct view *view, struct wlr_box *geometry)
 
 				if (rt) {
 					/* Extend window right from left edge */
-					geometry->x = bmp.cols[j] + offset_x;
+					geometry->x = bmp->cols.edges[j] + offset_x;
 				} else {
 					/* Extend window left from right edge */
 					geometry->x =
-						bmp.cols[j + 1] - width + offset_x;
+						bmp->cols.edges[j + 1] - width + offset_x;
 				}
 
 				if (dn) {
 					/* Extend window down from top edge */
-					geometry->y = bmp.rows[i] + offset_y;
+					geometry->y = bmp->rows.edges[i] + offset_y;
 				} else {
 					/* Extend window up from bottom edge */
 					geometry->y =
-						bmp.rows[i + 1] - height + offset_y;
+						bmp->rows.edges[i + 1] - height + offset_y;
 				}
 
 				/* If there is no overlap, the search is done. */
@@ -523,6 +745,6 @@ placement_find_best(struct view *view, struct wlr_box *geometry)
 	}
 
 final_placement:
-	destroy_bitmap(&bmp);
+	profile_end(PROFILE_PLACEMENT_FIND_BEST, profile_start);
 	return true;
 }
@@ -0,0 +1,235 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/util/log.h>
+#include "common/macros.h"
+#include "common/mem.h"
+#include "common/time-helpers.h"
+#include "profile.h"
+#include "trace.h"
+
+/* Startup has a few dozen phases and marks, one per output at most */
+#define STARTUP_MAX_RECORDS (64)
+
+struct profile_stats {
+	uint64_t nr_calls;
+	int64_t total_nsec;
+	int64_t max_nsec;
+};
+
+static bool enabled;
+static struct profile_stats stats[PROFILE_NR_ZONES];
+
+struct startup_record {
+	const char *name;
+	char *detail;
+	int depth;
+	int64_t begin_nsec;
+	int64_t end_nsec; /* 0 while running, begin_nsec for marks */
+};
+
+static struct {
+	bool enabled;
+	int64_t start_nsec;
+	struct startup_record records[STARTUP_MAX_RECORDS];
+	int nr_records;
+	int depth;
+} startup;
+
+static const char * const zone_names[] = {
+	[PROFILE_PLACEMENT_FIND_BEST] = "placement_find_best",
+	[PROFILE_OSD_UPDATE] = "osd_update",
+	[PROFILE_GET_CURSOR_CONTEXT] = "get_cursor_context",
+	[PROFILE_DESKTOP_ARRANGE_ALL_VIEWS] = "desktop_arrange_all_views",
+	[PROFILE_EDGES_FIND_NEIGHBORS] = "edges_find_neighbors",
+	[PROFILE_SSD_CREATE] = "ssd_create",
+	[PROFILE_SSD_UPDATE_TITLE] = "ssd_update_title",
+	[PROFILE_VIEW_RELOAD_SSD] = "view_reload_ssd",
+	[PROFILE_MENU_OPEN] = "menu_open",
+};
+
+void
+profile_init(void)
+{
+	enabled = !!getenv("LABWC_PROFILE");
+	startup.enabled = !!getenv("LABWC_PROFILE_STARTUP");
+	startup.start_nsec = time_now_nsec();
+}
+
+bool
+profile_enabled(void)
+{
+	return enabled;
+}
+
+int64_t
+profile_begin(void)
+{
+	return enabled ? time_now_nsec() : 0;
+}
+
+void
+profile_end(enum profile_zone zone, int64_t begin)
+{
+	assert(zone < PROFILE_NR_ZONES);
+	if (!enabled || !begin) {
+		return;
+	}
+	int64_t duration = time_now_nsec() - begin;
+	stats[zone].nr_calls++;
+	stats[zone].total_nsec += duration;
+	stats[zone].max_nsec = MAX(stats[zone].max_nsec, duration);
+}
+
+void
+profile_print(void)
+{
+	if (!enabled) {
+		return;
+	}
+	printf("%-28s %10s %12s %10s %10s\n", "zone", "calls",
+		"total (ms)", "avg (us)", "max (us)");
+	for (size_t i = 0; i < PROFILE_NR_ZONES; i++) {
+		struct profile_stats *s = &stats[i];
+		double avg = s->nr_calls
+			? (double)s->total_nsec / s->nr_calls / 1000.0 : 0.0;
+		printf("%-28s %10llu %12.3f %10.2f %10.2f\n", zone_names[i],
+			(unsigned long long)s->nr_calls,
+			(double)s->total_nsec / NSEC_PER_MSEC, avg,
+			(double)s->max_nsec / 1000.0);
+	}
+}
+
+static double
+startup_msec(int64_t nsec)
+{
+	return (double)(nsec - startup.start_nsec) / NSEC_PER_MSEC;
+}
+
+/* Returns the first record of @name, NULL if there is none */
+static struct startup_record *
+startup_find(const char *name)
+{
+	for (int i = 0; i < startup.nr_records; i++) {
+		if (!strcmp(startup.records[i].name, name)) {
+			return &startup.records[i];
+		}
+	}
+	return NULL;
+}
+
+void
+profile_write_json(void)
+{
+	const char *path = getenv("LABWC_PROFILE_JSON");
+	if (!enabled || !path || !*path) {
+		return;
+	}
+	FILE *stream = fopen(path, "w");
+	if (!stream) {
+		wlr_log_errno(WLR_ERROR, "cannot write profile to %s", path);
+		return;
+	}
+	fprintf(stream, "{\n  \"version\": \"%s\",\n  \"zones\": {",
+		LABWC_VERSION);
+	for (size_t i = 0; i < PROFILE_NR_ZONES; i++) {
+		struct profile_stats *s = &stats[i];
+		fprintf(stream, "%s\n    \"%s\": { \"calls\": %llu, "
+			"\"total_ns\": %lld, \"max_ns\": %lld }",
+			i ? "," : "", zone_names[i],
+			(unsigned long long)s->nr_calls,
+			(long long)s->total_nsec, (long long)s->max_nsec);
+	}
+	fprintf(stream, "\n  }");
+	struct startup_record *first_frame = startup_find("first_frame");
+	if (first_frame) {
+		fprintf(stream, ",\n  \"startup\": { \"first_frame_ms\": %.3f }",
+			startup_msec(first_frame->begin_nsec));
+	}
+	fprintf(stream, "\n}\n");
+	fclose(stream);
+}
+
+static struct startup_record *
+startup_record_add(const char *name, const char *detail)
+{
+	if (!startup.enabled || startup.nr_records >= STARTUP_MAX_RECORDS) {
+		return NULL;
+	}
+	struct startup_record *record = &startup.records[startup.nr_records++];
+	record->name = name;
+	record->detail = detail ? xstrdup(detail) : NULL;
+	record->depth = startup.depth;
+	record->begin_nsec = time_now_nsec();
+	return record;
+}
+
+void
+profile_startup_begin(const char *name)
+{
+	trace_begin(name, NULL);
+	if (startup_record_add(name, NULL)) {
+		startup.depth++;
+	}
+}
+
+void
+profile_startup_end(const char *name)
+{
+	trace_end(name);
+	/* The innermost running phase of that name */
+	for (int i = startup.nr_records - 1; i >= 0; i--) {
+		struct startup_record *record = &startup.records[i];
+		if (!record->end_nsec && !strcmp(record->name, name)) {
+			record->end_nsec = time_now_nsec();
+			startup.depth = record->depth;
+			wlr_log(WLR_INFO, "startup: %s took %.2f ms", name,
+				(double)(record->end_nsec - record->begin_nsec)
+					/ NSEC_PER_MSEC);
+			return;
+		}
+	}
+}
+
+void
+profile_startup_mark(const char *name, const char *detail)
+{
+	trace_instant(name, detail);
+	struct startup_record *record = startup_record_add(name, detail);
+	if (record) {
+		record->end_nsec = record->begin_nsec;
+		wlr_log(WLR_INFO, "startup: %s%s%s at %.2f ms", name,
+			detail ? " " : "", detail ? detail : "",
+			startup_msec(record->begin_nsec));
+	}
+}
+
+void
+profile_startup_print(void)
+{
+	if (!startup.enabled) {
+		return;
+	}
+	printf("%-40s %12s %12s\n", "startup phase", "at (ms)", "took (ms)");
+	for (int i = 0; i < startup.nr_records; i++) {
+		struct startup_record *record = &startup.records[i];
+		char name[64];
+		snprintf(name, sizeof(name), "%*s%s%s%s", 2 * record->depth, "",
+			record->name, record->detail ? " " : "",
+			record->detail ? record->detail : "");
+		if (record->end_nsec == record->begin_nsec) {
+			printf("%-40s %12.2f %12s\n", name,
+				startup_msec(record->begin_nsec), "-");
+		} else if (record->end_nsec) {
+			printf("%-40s %12.2f %12.2f\n", name,
+				startup_msec(record->begin_nsec),
+				(double)(record->end_nsec - record->begin_nsec)
+					/ NSEC_PER_MSEC);
+		} else {
+			printf("%-40s %12.2f %12s\n", name,
+				startup_msec(record->begin_nsec), "running");
+		}
+	}
+}
@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _GNU_SOURCE /* SCHED_RESET_ON_FORK */
+#include <sched.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <wlr/util/log.h>
+#include "config/rcxml.h"
+#include "realtime.h"
+
+/*
+ * Low on purpose: above all regular processes, but below audio servers
+ * (usually 88) and within the default limit of rtkit (20).
+ */
+#define REALTIME_PRIORITY (10)
+
+/* Stack touched in advance, more than the deepest handler needs */
+#define PREFAULT_STACK_SIZE (256 * 1024)
+
+static bool active;
+
+static void __attribute__((noinline))
+prefault_stack(void)
+{
+	volatile char stack[PREFAULT_STACK_SIZE];
+	for (size_t i = 0; i < sizeof(stack); i += 4096) {
+		stack[i] = 0;
+	}
+}
+
+static void
+set_scheduler(void)
+{
+	/* Children created by fork() or posix_spawn() get SCHED_OTHER */
+	struct sched_param param = { .sched_priority = REALTIME_PRIORITY };
+	if (sched_setscheduler(0, SCHED_RR | SCHED_RESET_ON_FORK, &param)) {
+		wlr_log_errno(WLR_ERROR, "cannot switch to SCHED_RR");
+		return;
+	}
+	active = true;
+	wlr_log(WLR_INFO, "running with SCHED_RR priority %d",
+		REALTIME_PRIORITY);
+}
+
+static void
+lock_memory(void)
+{
+	/*
+	 * Only what is mapped now, which after startup is the hot working
+	 * set. Locking future mappings as well would make allocations fail
+	 * once RLIMIT_MEMLOCK is reached.
+	 */
+	prefault_stack();
+	if (mlockall(MCL_CURRENT)) {
+		wlr_log_errno(WLR_ERROR, "cannot lock memory");
+		return;
+	}
+	wlr_log(WLR_INFO, "memory locked");
+}
+
+void
+realtime_init(void)
+{
+	if (!rc.realtime) {
+		return;
+	}
+	set_scheduler();
+	lock_memory();
+}
+
+bool
+realtime_is_active(void)
+{
+	return active;
+}
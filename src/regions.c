@@ -9,6 +9,7 @@
 #include <wlr/util/box.h>
 #include <wlr/util/log.h>
 #include "common/list.h"
+#include "common/macros.h"
 #include "common/mem.h"
 #include "input/keyboard.h"
 #include "labwc.h"
@@ -42,6 +43,84 @@ regions_from_name(const char *region_name, struct output *output)
 	return NULL;
 }
 
+void
+regions_grid_finish(struct region_grid *grid)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(grid->cells); i++) {
+		wl_array_release(&grid->cells[i]);
+		wl_array_init(&grid->cells[i]);
+	}
+	grid->box = (struct wlr_box){0};
+	grid->valid = false;
+}
+
+static void
+grid_fill_cell(struct wl_array *cell, struct wlr_box *cell_box,
+		struct wl_list *regions)
+{
+	struct wlr_box intersection;
+	struct region *region;
+	wl_list_for_each(region, regions, link) {
+		if (!wlr_box_intersection(&intersection, cell_box,
+				&region->geo)) {
+			continue;
+		}
+		struct region **slot = wl_array_add(cell, sizeof(*slot));
+		if (!slot) {
+			wlr_log(WLR_ERROR, "wl_array_add(): out of memory");
+			return;
+		}
+		*slot = region;
+	}
+}
+
+static void
+grid_update(struct region_grid *grid, struct wlr_box *box,
+		struct wl_list *regions)
+{
+	regions_grid_finish(grid);
+	grid->valid = true;
+	if (wlr_box_empty(box)) {
+		return;
+	}
+	grid->box = *box;
+
+	for (int row = 0; row < REGIONS_GRID_SIZE; row++) {
+		int top = box->height * row / REGIONS_GRID_SIZE;
+		int bottom = box->height * (row + 1) / REGIONS_GRID_SIZE;
+		for (int col = 0; col < REGIONS_GRID_SIZE; col++) {
+			int left = box->width * col / REGIONS_GRID_SIZE;
+			int right = box->width * (col + 1) / REGIONS_GRID_SIZE;
+			/*
+			 * Grow each cell by one pixel on all sides so that
+			 * rounding in grid_cell_at() can never miss a region
+			 */
+			struct wlr_box cell_box = {
+				.x = box->x + left - 1,
+				.y = box->y + top - 1,
+				.width = right - left + 2,
+				.height = bottom - top + 2,
+			};
+			grid_fill_cell(&grid->cells[row * REGIONS_GRID_SIZE + col],
+				&cell_box, regions);
+		}
+	}
+}
+
+/* Returns NULL if the point is outside of the indexed area */
+static struct wl_array *
+grid_cell_at(struct region_grid *grid, double lx, double ly)
+{
+	if (!wlr_box_contains_point(&grid->box, lx, ly)) {
+		return NULL;
+	}
+	int col = (lx - grid->box.x) * REGIONS_GRID_SIZE / grid->box.width;
+	int row = (ly - grid->box.y) * REGIONS_GRID_SIZE / grid->box.height;
+	col = MIN(MAX(col, 0), REGIONS_GRID_SIZE - 1);
+	row = MIN(MAX(row, 0), REGIONS_GRID_SIZE - 1);
+	return &grid->cells[row * REGIONS_GRID_SIZE + col];
+}
+
 struct region *
 regions_from_cursor(struct server *server)
 {
@@ -49,9 +128,7 @@ regions_from_cursor(struct server *server)
 	double lx = server->seat.cursor->x;
 	double ly = server->seat.cursor->y;
 
-	struct wlr_output *wlr_output = wlr_output_layout_output_at(
-		server->output_layout, lx, ly);
-	struct output *output = output_from_wlr_output(server, wlr_output);
+	struct output *output = output_at(server, lx, ly);
 	if (!output) {
 		return NULL;
 	}
@@ -60,6 +137,25 @@ regions_from_cursor(struct server *server)
 	double dist_min = DBL_MAX;
 	struct region *closest_region = NULL;
 	struct region *region;
+
+	struct wl_array *cell = grid_cell_at(&output->region_grid, lx, ly);
+	if (cell) {
+		struct region **candidate;
+		wl_array_for_each(candidate, cell) {
+			region = *candidate;
+			if (!wlr_box_contains_point(&region->geo, lx, ly)) {
+				continue;
+			}
+			dist = pow(region->center.x - lx, 2) + pow(region->center.y - ly, 2);
+			if (dist < dist_min) {
+				closest_region = region;
+				dist_min = dist;
+			}
+		}
+		return closest_region;
+	}
+
+	/* Outside of the usable area, regions may still extend there */
 	wl_list_for_each(region, &output->regions, link) {
 		if (wlr_box_contains_point(&region->geo, lx, ly)) {
 			/* No need for sqrt((x1 - x2)^2 + (y1 - y2)^2) as we just compare */
@@ -83,6 +179,7 @@ regions_reconfigure_output(struct output *output)
 		regions_evacuate_output(output);
 		regions_destroy(&output->server->seat, &output->regions);
 	}
+	regions_grid_finish(&output->region_grid);
 
 	/* Initialize regions from config */
 	struct region *region;
@@ -121,6 +218,12 @@ regions_update_geometry(struct output *output)
 	struct region *region;
 	struct wlr_box usable = output_usable_area_in_layout_coords(output);
 
+	/* Geometry is already up to date for this usable area */
+	struct region_grid *grid = &output->region_grid;
+	if (grid->valid && wlr_box_equal(&grid->box, &usable)) {
+		return;
+	}
+
 	/* Update regions */
 	struct wlr_box *perc, *geo;
 	wl_list_for_each(region, &output->regions, link) {
@@ -142,6 +245,8 @@ regions_update_geometry(struct output *output)
 		region->center.x = geo->x + geo->width / 2;
 		region->center.y = geo->y + geo->height / 2;
 	}
+
+	grid_update(grid, &usable, &output->regions);
 }
 
 void
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include <assert.h>
 #include <stdbool.h>
+#include <string.h>
 #include <strings.h>
 #include <wlr/backend/libinput.h>
 #include <wlr/types/wlr_input_device.h>
@@ -107,6 +108,11 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 	 *       test the enum being a member of a bitset via
 	 *       mask & value == value. All libinput enums are
 	 *       way below UINT32_MAX.
+	 *
+	 * Settings are only set if they differ from the current device
+	 * configuration. Reconfigure calls this for every device and some
+	 * setters (e.g. for the click method or left-handed mode) reset
+	 * device state, causing touchpads to stutter.
 	 */
 
 	if (!wlr_input_device) {
@@ -136,9 +142,16 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 		wlr_log(WLR_INFO, "tap unavailable");
 	} else {
 		wlr_log(WLR_INFO, "tap configured");
-		libinput_device_config_tap_set_enabled(libinput_dev, dc->tap);
-		libinput_device_config_tap_set_button_map(libinput_dev,
-			dc->tap_button_map);
+		if (libinput_device_config_tap_get_enabled(libinput_dev)
+				!= dc->tap) {
+			libinput_device_config_tap_set_enabled(libinput_dev,
+				dc->tap);
+		}
+		if (libinput_device_config_tap_get_button_map(libinput_dev)
+				!= dc->tap_button_map) {
+			libinput_device_config_tap_set_button_map(libinput_dev,
+				dc->tap_button_map);
+		}
 	}
 
 	if (libinput_device_config_tap_get_finger_count(libinput_dev) <= 0
@@ -146,8 +159,11 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 		wlr_log(WLR_INFO, "tap-and-drag not configured");
 	} else {
 		wlr_log(WLR_INFO, "tap-and-drag configured");
-		libinput_device_config_tap_set_drag_enabled(
-			libinput_dev, dc->tap_and_drag);
+		if ((int)libinput_device_config_tap_get_drag_enabled(libinput_dev)
+				!= dc->tap_and_drag) {
+			libinput_device_config_tap_set_drag_enabled(
+				libinput_dev, dc->tap_and_drag);
+		}
 	}
 
 	if (libinput_device_config_tap_get_finger_count(libinput_dev) <= 0
@@ -155,8 +171,11 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 		wlr_log(WLR_INFO, "drag lock not configured");
 	} else {
 		wlr_log(WLR_INFO, "drag lock configured");
-		libinput_device_config_tap_set_drag_lock_enabled(
-			libinput_dev, dc->drag_lock);
+		if ((int)libinput_device_config_tap_get_drag_lock_enabled(
+				libinput_dev) != dc->drag_lock) {
+			libinput_device_config_tap_set_drag_lock_enabled(
+				libinput_dev, dc->drag_lock);
+		}
 	}
 
 	if (libinput_device_config_scroll_has_natural_scroll(libinput_dev) <= 0
@@ -164,8 +183,11 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 		wlr_log(WLR_INFO, "natural scroll not configured");
 	} else {
 		wlr_log(WLR_INFO, "natural scroll configured");
-		libinput_device_config_scroll_set_natural_scroll_enabled(
-			libinput_dev, dc->natural_scroll);
+		if (libinput_device_config_scroll_get_natural_scroll_enabled(
+				libinput_dev) != dc->natural_scroll) {
+			libinput_device_config_scroll_set_natural_scroll_enabled(
+				libinput_dev, dc->natural_scroll);
+		}
 	}
 
 	if (libinput_device_config_left_handed_is_available(libinput_dev) <= 0
@@ -173,19 +195,26 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 		wlr_log(WLR_INFO, "left-handed mode not configured");
 	} else {
 		wlr_log(WLR_INFO, "left-handed mode configured");
-		libinput_device_config_left_handed_set(libinput_dev,
-			dc->left_handed);
+		if (libinput_device_config_left_handed_get(libinput_dev)
+				!= dc->left_handed) {
+			libinput_device_config_left_handed_set(libinput_dev,
+				dc->left_handed);
+		}
 	}
 
 	if (libinput_device_config_accel_is_available(libinput_dev) == 0) {
 		wlr_log(WLR_INFO, "pointer acceleration unavailable");
 	} else {
 		wlr_log(WLR_INFO, "pointer acceleration configured");
-		if (dc->pointer_speed > -1) {
+		if (dc->pointer_speed > -1
+				&& (float)libinput_device_config_accel_get_speed(
+					libinput_dev) != dc->pointer_speed) {
 			libinput_device_config_accel_set_speed(libinput_dev,
 				dc->pointer_speed);
 		}
-		if (dc->accel_profile > 0) {
+		if (dc->accel_profile > 0
+				&& (int)libinput_device_config_accel_get_profile(
+					libinput_dev) != dc->accel_profile) {
 			libinput_device_config_accel_set_profile(libinput_dev,
 				dc->accel_profile);
 		}
@@ -196,8 +225,11 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 		wlr_log(WLR_INFO, "middle emulation not configured");
 	} else {
 		wlr_log(WLR_INFO, "middle emulation configured");
-		libinput_device_config_middle_emulation_set_enabled(
-			libinput_dev, dc->middle_emu);
+		if ((int)libinput_device_config_middle_emulation_get_enabled(
+				libinput_dev) != dc->middle_emu) {
+			libinput_device_config_middle_emulation_set_enabled(
+				libinput_dev, dc->middle_emu);
+		}
 	}
 
 	if (libinput_device_config_dwt_is_available(libinput_dev) == 0
@@ -205,7 +237,11 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 		wlr_log(WLR_INFO, "dwt not configured");
 	} else {
 		wlr_log(WLR_INFO, "dwt configured");
-		libinput_device_config_dwt_set_enabled(libinput_dev, dc->dwt);
+		if ((int)libinput_device_config_dwt_get_enabled(libinput_dev)
+				!= dc->dwt) {
+			libinput_device_config_dwt_set_enabled(libinput_dev,
+				dc->dwt);
+		}
 	}
 
 	if ((dc->click_method != LIBINPUT_CONFIG_CLICK_METHOD_NONE
@@ -225,7 +261,11 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 		 * issues.
 		 */
 
-		libinput_device_config_click_set_method(libinput_dev, dc->click_method);
+		if ((int)libinput_device_config_click_get_method(libinput_dev)
+				!= dc->click_method) {
+			libinput_device_config_click_set_method(libinput_dev,
+				dc->click_method);
+		}
 	}
 
 	if ((dc->send_events_mode != LIBINPUT_CONFIG_SEND_EVENTS_ENABLED
@@ -235,7 +275,11 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 		wlr_log(WLR_INFO, "send events mode not configured");
 	} else {
 		wlr_log(WLR_INFO, "send events mode configured");
-		libinput_device_config_send_events_set_mode(libinput_dev, dc->send_events_mode);
+		if ((int)libinput_device_config_send_events_get_mode(libinput_dev)
+				!= dc->send_events_mode) {
+			libinput_device_config_send_events_set_mode(libinput_dev,
+				dc->send_events_mode);
+		}
 	}
 
 	/* Non-zero if the device can be calibrated, zero otherwise. */
@@ -244,7 +288,12 @@ configure_libinput(struct wlr_input_device *wlr_input_device)
 		wlr_log(WLR_INFO, "calibration matrix not configured");
 	} else {
 		wlr_log(WLR_INFO, "calibration matrix configured");
-		libinput_device_config_calibration_set_matrix(libinput_dev, dc->calibration_matrix);
+		float matrix[6];
+		libinput_device_config_calibration_get_matrix(libinput_dev, matrix);
+		if (memcmp(matrix, dc->calibration_matrix, sizeof(matrix))) {
+			libinput_device_config_calibration_set_matrix(libinput_dev,
+				dc->calibration_matrix);
+		}
 	}
 }
 
@@ -522,6 +571,7 @@ seat_init(struct server *server)
 	wl_list_init(&seat->touch_points);
 	wl_list_init(&seat->constraint_commit.link);
 	wl_list_init(&seat->inputs);
+	input_latency_init(&seat->input_latency);
 	seat->new_input.notify = new_input_notify;
 	wl_signal_add(&server->backend->events.new_input, &seat->new_input);
 
@@ -568,6 +618,7 @@ seat_finish(struct server *server)
 
 	input_handlers_finish(seat);
 	input_method_relay_finish(seat->input_method_relay);
+	input_latency_finish(&seat->input_latency);
 }
 
 static void
@@ -602,6 +653,7 @@ seat_reconfigure(struct server *server)
 			map_touch_to_output(seat, input->wlr_input_device);
 			break;
 		case WLR_INPUT_DEVICE_TABLET_TOOL:
+			tablet_reconfigure(input->wlr_input_device);
 			map_input_to_output(seat, input->wlr_input_device, rc.tablet.output_name);
 			break;
 		default:
@@ -754,4 +806,5 @@ seat_output_layout_changed(struct seat *seat)
 			break;
 		}
 	}
+	input_method_relay_output_layout_changed(seat->input_method_relay);
 }
@@ -7,10 +7,12 @@
 #include <wlr/backend/headless.h>
 #include <wlr/backend/multi.h>
 #include <wlr/types/wlr_data_control_v1.h>
+#include <wlr/types/wlr_drm.h>
 #include <wlr/types/wlr_export_dmabuf_v1.h>
 #include <wlr/types/wlr_fractional_scale_v1.h>
 #include <wlr/types/wlr_gamma_control_v1.h>
 #include <wlr/types/wlr_input_inhibitor.h>
+#include <wlr/types/wlr_linux_dmabuf_v1.h>
 #include <wlr/types/wlr_presentation_time.h>
 #include <wlr/types/wlr_primary_selection_v1.h>
 #include <wlr/types/wlr_screencopy_v1.h>
@@ -21,56 +23,128 @@
 #include "xwayland-shell-v1-protocol.h"
 #endif
 #include "drm-lease-v1-protocol.h"
+#include "buffer.h"
+#include "common/font-worker.h"
+#include "common/hash.h"
+#include "common/macros.h"
+#include "common/mem.h"
+#include "config/keybind.h"
+#include "common/spawn.h"
+#include "common/time-helpers.h"
+#include "common/timers.h"
 #include "config/rcxml.h"
 #include "config/session.h"
 #include "decorations.h"
+#include "edges.h"
+#include "event-loop.h"
+#include "geometry-cache.h"
 #include "idle.h"
 #include "labwc.h"
+#include "latency-trace.h"
 #include "layers.h"
+#include "memory-pressure.h"
+#include "metrics.h"
 #include "menu/menu.h"
+#include "osd.h"
 #include "output-virtual.h"
+#include "overview.h"
+#include "profile.h"
 #include "regions.h"
 #include "resize_indicator.h"
+#include "session-state.h"
 #include "theme.h"
+#include "thumbnail.h"
 #include "view.h"
+#include "window-rules.h"
+#include "window-state.h"
 #include "workspaces.h"
 #include "xwayland.h"
 
-#define LAB_WLR_COMPOSITOR_VERSION 5
+#define LAB_WLR_COMPOSITOR_VERSION 6
 #define LAB_WLR_FRACTIONAL_SCALE_V1_VERSION 1
+#define LAB_WLR_LINUX_DMABUF_VERSION 4
+#define LAB_WLR_CONTENT_TYPE_V1_VERSION 1
+
+/* Delay to reap children again while Xwayland's zombie is pending */
+#define REAP_RETRY_MS (50)
 
 static struct wlr_compositor *compositor;
 static struct wl_event_source *sighup_source;
 static struct wl_event_source *sigint_source;
 static struct wl_event_source *sigterm_source;
 static struct wl_event_source *sigchld_source;
+static struct lab_timer *reap_retry;
 
 static struct server *g_server;
 
 static void
 reload_config_and_theme(void)
 {
+	/*
+	 * Subsystems are only reconfigured if the settings they depend on
+	 * changed. Keybinds, mousebinds and window rules are looked up from
+	 * rc directly and need nothing but the invalidations below.
+	 */
+	int64_t start = time_now_nsec();
+	uint64_t old_hashes[RCXML_NR_SECTIONS];
+	for (int i = 0; i < RCXML_NR_SECTIONS; i++) {
+		old_hashes[i] = rcxml_section_hash(i, HASH_INIT);
+	}
+
+	/* The environment is part of the input section hash */
+	session_environment_init();
 	rcxml_finish();
 	rcxml_read(rc.config_file);
-	theme_finish(g_server->theme);
-	theme_init(g_server->theme, rc.theme_name);
+	bool theme_changed = theme_reload(g_server->theme, rc.theme_name);
 
-	struct view *view;
-	wl_list_for_each(view, &g_server->views, link) {
-		view_reload_ssd(view);
+	bool changed[RCXML_NR_SECTIONS];
+	for (int i = 0; i < RCXML_NR_SECTIONS; i++) {
+		changed[i] = theme_changed
+			|| rcxml_section_hash(i, HASH_INIT) != old_hashes[i];
+	}
+	window_rules_invalidate(g_server, NULL);
+	edges_invalidate(g_server, NULL);
+	osd_invalidate_views(g_server);
+	osd_invalidate_scene(g_server);
+	workspaces_osd_invalidate(g_server);
+
+	if (theme_changed) {
+		struct view *view;
+		wl_list_for_each(view, &g_server->views, link) {
+			view_reload_ssd(view);
+		}
 	}
 
-	menu_reconfigure(g_server);
-	seat_reconfigure(g_server);
-	regions_reconfigure(g_server);
-	resize_indicator_reconfigure(g_server);
+	menu_reconfigure(g_server, changed[RCXML_SECTION_MENU]);
+	if (changed[RCXML_SECTION_INPUT]) {
+		seat_reconfigure(g_server);
+	} else {
+		/* The keybinds have been re-created */
+		keybind_update_keycodes(g_server);
+	}
+	if (changed[RCXML_SECTION_REGIONS]) {
+		regions_reconfigure(g_server);
+	}
+	if (changed[RCXML_SECTION_RESIZE_INDICATOR]) {
+		resize_indicator_reconfigure(g_server);
+	}
 	kde_server_decoration_update_default();
+
+	/* The helper is only forked at startup, see main() */
+	if (!rc.spawn_helper) {
+		spawn_helper_stop();
+	}
+	metrics_init(g_server);
+	window_state_init(g_server);
+	session_state_init(g_server);
+
+	metrics_count(METRICS_RECONFIGURES);
+	metrics_observe(METRICS_RECONFIGURE_DURATION, time_now_nsec() - start);
 }
 
 static int
 handle_sighup(int signal, void *data)
 {
-	session_environment_init();
 	reload_config_and_theme();
 	output_virtual_update_fallback(g_server);
 	return 0;
@@ -81,69 +155,109 @@ handle_sigterm(int signal, void *data)
 {
 	struct wl_display *display = data;
 
-	wl_display_terminate(display);
+	event_loop_terminate(display);
 	return 0;
 }
 
-static int
-handle_sigchld(int signal, void *data)
+static void
+log_child_exit(const siginfo_t *info)
 {
-	siginfo_t info;
-	info.si_pid = 0;
-	struct server *server = data;
-
-	/* First call waitid() with NOWAIT which doesn't consume the zombie */
-	if (waitid(P_ALL, /*id*/ 0, &info, WEXITED | WNOHANG | WNOWAIT) == -1) {
-		return 0;
-	}
-
-	if (info.si_pid == 0) {
-		/* No children in waitable state */
-		return 0;
-	}
-
-#if HAVE_XWAYLAND
-	/* Ensure that we do not break xwayland lazy initialization */
-	if (server->xwayland && server->xwayland->server
-			&& info.si_pid == server->xwayland->server->pid) {
-		return 0;
-	}
-#endif
-
-	/* And then do the actual (consuming) lookup again */
-	int ret = waitid(P_PID, info.si_pid, &info, WEXITED);
-	if (ret == -1) {
-		wlr_log(WLR_ERROR, "blocking waitid() for %ld failed: %d",
-			(long)info.si_pid, ret);
-		return 0;
-	}
-
-	switch (info.si_code) {
+	switch (info->si_code) {
 	case CLD_EXITED:
-		wlr_log(info.si_status == 0 ? WLR_DEBUG : WLR_ERROR,
+		wlr_log(info->si_status == 0 ? WLR_DEBUG : WLR_ERROR,
 			"spawned child %ld exited with %d",
-			(long)info.si_pid, info.si_status);
+			(long)info->si_pid, info->si_status);
 		break;
 	case CLD_KILLED:
 	case CLD_DUMPED:
 		; /* works around "a label can only be part of a statement" */
-		const char *signame = strsignal(info.si_status);
+		const char *signame = strsignal(info->si_status);
 		wlr_log(WLR_ERROR,
 			"spawned child %ld terminated with signal %d (%s)",
-				(long)info.si_pid, info.si_status,
+				(long)info->si_pid, info->si_status,
 				signame ? signame : "unknown");
 		break;
 	default:
 		wlr_log(WLR_ERROR,
 			"spawned child %ld terminated unexpectedly: %d"
-			" please report", (long)info.si_pid, info.si_code);
+			" please report", (long)info->si_pid, info->si_code);
 	}
+}
 
-	if (info.si_pid == server->primary_client_pid) {
-		wlr_log(WLR_INFO, "primary client %ld exited", (long)info.si_pid);
-		wl_display_terminate(server->wl_display);
+/*
+ * Reaps all exited children but Xwayland, which wlroots waits for itself
+ * once it is ready. Returns false if a zombie Xwayland is in the way:
+ * waitid(P_ALL) always reports the oldest child first and would not show
+ * any children exited after it.
+ */
+static bool
+reap_children(struct server *server)
+{
+	for (;;) {
+		siginfo_t info;
+		info.si_pid = 0;
+
+		/* First call waitid() with NOWAIT which doesn't consume the zombie */
+		if (waitid(P_ALL, /*id*/ 0, &info,
+				WEXITED | WNOHANG | WNOWAIT) == -1) {
+			return true;
+		}
+		if (info.si_pid == 0) {
+			/* No children in waitable state */
+			return true;
+		}
+
+#if HAVE_XWAYLAND
+		/* Ensure that we do not break xwayland lazy initialization */
+		if (server->xwayland && server->xwayland->server
+				&& info.si_pid == server->xwayland->server->pid) {
+			return false;
+		}
+#endif
+
+		/* And then do the actual (consuming) lookup again */
+		pid_t pid = info.si_pid;
+		if (waitid(P_PID, pid, &info, WEXITED) == -1) {
+			wlr_log_errno(WLR_ERROR, "blocking waitid() for %ld failed",
+				(long)pid);
+			continue;
+		}
+		log_child_exit(&info);
+
+		if (info.si_pid == server->primary_client_pid) {
+			wlr_log(WLR_INFO, "primary client %ld exited",
+				(long)info.si_pid);
+			event_loop_terminate(server->wl_display);
+		}
 	}
+}
 
+static int handle_sigchld(int signal, void *data);
+
+static int
+handle_reap_retry(void *data)
+{
+	handle_sigchld(SIGCHLD, data);
+	return 0;
+}
+
+/*
+ * SIGCHLD signals merge while pending, so each one reaps every child
+ * which has exited rather than just one.
+ */
+static int
+handle_sigchld(int signal, void *data)
+{
+	struct server *server = data;
+	if (reap_children(server)) {
+		return 0;
+	}
+	/* Try again once wlroots has taken care of Xwayland */
+	if (!reap_retry) {
+		reap_retry = timers_add(server->wl_event_loop,
+			handle_reap_retry, server);
+	}
+	timers_update(reap_retry, REAP_RETRY_MS);
 	return 0;
 }
 
@@ -316,6 +430,21 @@ server_init(struct server *server)
 	sigchld_source = wl_event_loop_add_signal(
 		event_loop, SIGCHLD, handle_sigchld, server);
 	server->wl_event_loop = event_loop;
+	scratch_init(event_loop);
+	font_worker_init(event_loop);
+
+	/* Load the fonts while the backend and the theme are set up */
+	struct font fonts[] = {
+		rc.font_activewindow, rc.font_inactivewindow,
+		rc.font_menuitem, rc.font_osd,
+	};
+	font_worker_warm_up(fonts, ARRAY_SIZE(fonts));
+
+	memory_pressure_init(server);
+	latency_trace_init(event_loop);
+	geometry_cache_init(server);
+	metrics_init(server);
+	window_state_init(server);
 
 	/*
 	 * Prevent wayland clients that request the X11 clipboard but closing
@@ -333,6 +462,7 @@ server_init(struct server *server)
 	 * backend based on the current environment, such as opening an x11
 	 * window if an x11 server is running.
 	 */
+	profile_startup_begin("backend");
 	server->backend = wlr_backend_autocreate(
 		server->wl_display, &server->session);
 	if (!server->backend) {
@@ -366,34 +496,58 @@ server_init(struct server *server)
 	 */
 	wlr_output_destroy(wlr_headless_add_output(server->headless.backend, 0, 0));
 
+	/* Service input ahead of client requests */
+	event_loop_init(server);
+	profile_startup_end("backend");
+
 	/*
 	 * Autocreates a renderer, either Pixman, GLES2 or Vulkan for us. The
 	 * user can also specify a renderer using the WLR_RENDERER env var.
 	 * The renderer is responsible for defining the various pixel formats it
 	 * supports for shared memory, this configures that for clients.
 	 */
+	profile_startup_begin("renderer");
 	server->renderer = wlr_renderer_autocreate(server->backend);
 	if (!server->renderer) {
 		wlr_log(WLR_ERROR, "unable to create renderer");
 		exit(EXIT_FAILURE);
 	}
 
-	wlr_renderer_init_wl_display(server->renderer, server->wl_display);
+	/*
+	 * What wlr_renderer_init_wl_display() does, but keeping the
+	 * linux-dmabuf global for per-surface feedback, see below
+	 */
+	wlr_renderer_init_wl_shm(server->renderer, server->wl_display);
+	if (wlr_renderer_get_dmabuf_texture_formats(server->renderer)) {
+		wlr_drm_create(server->wl_display, server->renderer);
+		server->linux_dmabuf = wlr_linux_dmabuf_v1_create_with_renderer(
+			server->wl_display, LAB_WLR_LINUX_DMABUF_VERSION,
+			server->renderer);
+	}
+	profile_startup_end("renderer");
 
 	/*
 	 * Autocreates an allocator for us. The allocator is the bridge between
 	 * the renderer and the backend. It handles the buffer creation,
 	 * allowing wlroots to render onto the screen
 	 */
+	profile_startup_begin("allocator");
 	server->allocator = wlr_allocator_autocreate(
 		server->backend, server->renderer);
 	if (!server->allocator) {
 		wlr_log(WLR_ERROR, "unable to create allocator");
 		exit(EXIT_FAILURE);
 	}
+	profile_startup_end("allocator");
+	buffer_set_allocator(server->allocator);
 
 	wl_list_init(&server->views);
+	wl_list_init(&server->views_always_on_top);
+	wl_list_init(&server->views_always_on_bottom);
 	wl_list_init(&server->unmanaged_surfaces);
+	wl_list_init(&server->unmanaged_focus_stack);
+	thumbnail_init(server);
+	wl_array_init(&server->overview.items);
 
 	server->ssd_hover_state = ssd_hover_state_new();
 
@@ -403,6 +557,18 @@ server_init(struct server *server)
 		exit(EXIT_FAILURE);
 	}
 
+	/*
+	 * Surfaces which the scene could put on the primary plane, like
+	 * fullscreen views, get dmabuf feedback with a scanout tranche
+	 * for that output. Clients can then allocate buffers which are
+	 * scanned out directly instead of being composited, until the
+	 * surface is covered, leaves fullscreen or moves to another output.
+	 */
+	if (server->linux_dmabuf) {
+		wlr_scene_set_linux_dmabuf_v1(server->scene,
+			server->linux_dmabuf);
+	}
+
 	/*
 	 * The order in which the scene-trees below are created determines the
 	 * z-order for nodes which cover the whole work-area.  For per-output
@@ -417,6 +583,7 @@ server_init(struct server *server)
 	 * | server            | labwc-menus      | No         |
 	 * | xwayland-OR       | unmanaged        | No         | dmenu
 	 * | xdg-popups        | xdg-popups       | No         |
+	 * | server            | osd-preview      | No         | alt-tab preview
 	 * | toplevels windows | always-on-top    | No         |
 	 * | toplevels windows | normal           | No         | firefox
 	 * | toplevels windows | always-on-bottom | No         | pcmanfm-qt --desktop
@@ -427,6 +594,7 @@ server_init(struct server *server)
 	server->view_tree_always_on_bottom = wlr_scene_tree_create(&server->scene->tree);
 	server->view_tree = wlr_scene_tree_create(&server->scene->tree);
 	server->view_tree_always_on_top = wlr_scene_tree_create(&server->scene->tree);
+	server->osd_preview_tree = wlr_scene_tree_create(&server->scene->tree);
 	server->xdg_popup_tree = wlr_scene_tree_create(&server->scene->tree);
 #if HAVE_XWAYLAND
 	server->unmanaged_tree = wlr_scene_tree_create(&server->scene->tree);
@@ -444,6 +612,7 @@ server_init(struct server *server)
 	 * room for you to dig your fingers in and play with their behavior if
 	 * you want.
 	 */
+	profile_startup_begin("protocols");
 	compositor = wlr_compositor_create(server->wl_display,
 		LAB_WLR_COMPOSITOR_VERSION, server->renderer);
 	if (!compositor) {
@@ -549,10 +718,16 @@ server_init(struct server *server)
 	server->tearing_new_object.notify = new_tearing_hint;
 	wl_signal_add(&server->tearing_control->events.new_object, &server->tearing_new_object);
 
+	server->content_type_manager = wlr_content_type_manager_v1_create(
+		server->wl_display, LAB_WLR_CONTENT_TYPE_V1_VERSION);
+
 	layers_init(server);
+	profile_startup_end("protocols");
 
 #if HAVE_XWAYLAND
+	profile_startup_begin("xwayland_server_init");
 	xwayland_server_init(server, compositor);
+	profile_startup_end("xwayland_server_init");
 #endif
 	/* used when handling SIGHUP */
 	g_server = server;
@@ -585,6 +760,9 @@ server_start(struct server *server)
 	} else {
 		wlr_log(WLR_DEBUG, "WAYLAND_DISPLAY=%s", socket);
 	}
+
+	/* Needs the outputs and the name of the socket */
+	session_state_init(server);
 }
 
 void
@@ -596,12 +774,29 @@ server_finish(struct server *server)
 	if (sighup_source) {
 		wl_event_source_remove(sighup_source);
 	}
+	if (reap_retry) {
+		timers_remove(reap_retry);
+		reap_retry = NULL;
+	}
+	font_worker_finish();
+	memory_pressure_finish();
+	latency_trace_finish();
+	metrics_finish();
+	window_state_finish();
+	/* Before the clients go, so that their windows stay recorded */
+	session_state_finish();
+	overview_finish(server);
 	wl_display_destroy_clients(server->wl_display);
+	geometry_cache_finish();
 
 	seat_finish(server);
+	output_finish(server);
+	edges_finish(server);
+	thumbnail_finish(server);
 	wlr_output_layout_destroy(server->output_layout);
 
 	wl_display_destroy(server->wl_display);
+	event_loop_finish();
 
 	/* TODO: clean up various scene_tree nodes */
 	workspaces_destroy(server);
@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #define _POSIX_C_SOURCE 200809L
+#include "config.h"
 #include <assert.h>
+#include "common/macros.h"
 #include "common/mem.h"
 #include "labwc.h"
 
@@ -16,6 +18,8 @@ struct session_lock_output {
 	struct session_lock *lock;
 	struct output *output;
 	struct wlr_session_lock_surface_v1 *surface;
+	/* A frame with the blank background has been committed */
+	bool blanked;
 
 	struct wl_list link; /* session_lock.outputs */
 
@@ -25,6 +29,70 @@ struct session_lock_output {
 	struct wl_listener surface_map;
 };
 
+/*
+ * Everything except the session-lock trees is hidden while locked.
+ * Disabled scene trees are neither rendered nor sent frame events, so
+ * hidden clients stop drawing right away, and nothing can leak through
+ * should the lock surface not (yet) cover an output.
+ */
+static void
+set_output_content_enabled(struct output *output, bool enabled)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(output->layer_tree); i++) {
+		wlr_scene_node_set_enabled(&output->layer_tree[i]->node, enabled);
+	}
+	wlr_scene_node_set_enabled(&output->layer_popup_tree->node, enabled);
+}
+
+static void
+set_content_enabled(struct server *server, bool enabled)
+{
+	struct wlr_scene_tree *trees[] = {
+		server->view_tree_always_on_bottom,
+		server->view_tree,
+		server->view_tree_always_on_top,
+		server->osd_preview_tree,
+		server->xdg_popup_tree,
+#if HAVE_XWAYLAND
+		server->unmanaged_tree,
+#endif
+		server->menu_tree,
+	};
+	for (size_t i = 0; i < ARRAY_SIZE(trees); i++) {
+		wlr_scene_node_set_enabled(&trees[i]->node, enabled);
+	}
+
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		set_output_content_enabled(output, enabled);
+	}
+	if (enabled) {
+		desktop_update_top_layer_visiblity(server);
+	}
+}
+
+/*
+ * The ext-session-lock protocol requires the locked event to be sent only
+ * once all outputs are blanked, so wait for a frame on each of them.
+ * Outputs which are not usable do not show anything anyway.
+ */
+static void
+send_locked_if_blanked(struct session_lock *lock)
+{
+	if (lock->locked_sent || !lock->lock) {
+		return;
+	}
+	struct session_lock_output *lock_output;
+	wl_list_for_each(lock_output, &lock->session_lock_outputs, link) {
+		if (!lock_output->blanked
+				&& output_is_usable(lock_output->output)) {
+			return;
+		}
+	}
+	wlr_session_lock_v1_send_locked(lock->lock);
+	lock->locked_sent = true;
+}
+
 static void
 focus_surface(struct session_lock *lock, struct wlr_surface *focused)
 {
@@ -126,7 +194,9 @@ session_lock_output_destroy(struct session_lock_output *output)
 	wl_list_remove(&output->commit.link);
 	wl_list_remove(&output->destroy.link);
 	wl_list_remove(&output->link);
+	struct session_lock *lock = output->lock;
 	free(output);
+	send_locked_if_blanked(lock);
 }
 
 static void
@@ -146,6 +216,11 @@ handle_commit(struct wl_listener *listener, void *data)
 	if (event->state->committed & require_reconfigure) {
 		lock_output_reconfigure(output);
 	}
+	if (!output->blanked
+			&& (event->state->committed & WLR_OUTPUT_STATE_BUFFER)) {
+		output->blanked = true;
+		send_locked_if_blanked(output->lock);
+	}
 }
 
 static void
@@ -202,6 +277,11 @@ session_lock_output_create(struct session_lock *lock, struct output *output)
 	lock_output_reconfigure(lock_output);
 
 	wl_list_insert(&lock->session_lock_outputs, &lock_output->link);
+
+	/* Outputs added while locked must not show any content either */
+	set_output_content_enabled(output, false);
+	/* Render the blank frame with the next vblank */
+	wlr_output_schedule_frame(output->wlr_output);
 	return;
 
 exit_session:
@@ -213,6 +293,9 @@ exit_session:
 static void
 session_lock_destroy(struct session_lock *lock)
 {
+	/* Nothing must be sent to the lock while its outputs are destroyed */
+	lock->lock = NULL;
+
 	struct session_lock_output *lock_output, *next;
 	wl_list_for_each_safe(lock_output, next, &lock->session_lock_outputs, link) {
 		wlr_scene_node_destroy(&lock_output->tree->node);
@@ -233,6 +316,7 @@ handle_unlock(struct wl_listener *listener, void *data)
 {
 	struct session_lock *lock = wl_container_of(listener, lock, unlock);
 	session_lock_destroy(lock);
+	set_content_enabled(g_server, true);
 	desktop_focus_topmost_view(g_server);
 }
 
@@ -248,6 +332,7 @@ handle_session_lock_destroy(struct wl_listener *listener, void *data)
 	}
 
 	lock->abandoned = true;
+	lock->lock = NULL;
 	wl_list_remove(&lock->destroy.link);
 	wl_list_remove(&lock->unlock.link);
 	wl_list_remove(&lock->new_surface.link);
@@ -277,7 +362,9 @@ handle_new_session_lock(struct wl_listener *listener, void *data)
 		return;
 	}
 
+	session_lock->lock = lock;
 	wl_list_init(&session_lock->session_lock_outputs);
+	set_content_enabled(g_server, false);
 	struct output *output;
 	wl_list_for_each(output, &g_server->outputs, link) {
 		session_lock_output_create(session_lock, output);
@@ -292,8 +379,8 @@ handle_new_session_lock(struct wl_listener *listener, void *data)
 	session_lock->destroy.notify = handle_session_lock_destroy;
 	wl_signal_add(&lock->events.destroy, &session_lock->destroy);
 
-	wlr_session_lock_v1_send_locked(lock);
 	g_server->session_lock = session_lock;
+	send_locked_if_blanked(session_lock);
 }
 
 static void
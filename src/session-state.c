@@ -0,0 +1,605 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/box.h>
+#include <wlr/util/log.h>
+#include "common/buf.h"
+#include "common/mem.h"
+#include "common/timers.h"
+#include "config/rcxml.h"
+#include "labwc.h"
+#include "regions.h"
+#include "session-state.h"
+#include "tiling.h"
+#include "view.h"
+#include "workspaces.h"
+
+#define STATE_MAGIC (0x6c616277) /* "labw" */
+#define STATE_VERSION (1)
+#define MAX_VIEWS (256)
+#define MAX_WORKSPACES (32)
+/* Windows of the previous instance not back by then are forgotten */
+#define RESTORE_TIMEOUT_MS (30000)
+
+/*
+ * The file is a fixed array of records. Each record starts with a
+ * sequence number which is odd while the record is being written, so a
+ * record torn by a crash is skipped when loading. Unused records have a
+ * sequence number of 0.
+ */
+struct view_state {
+	int32_t x, y, width, height; /* natural geometry, relative to output */
+	uint8_t maximized; /* enum view_axis */
+	uint8_t tiled; /* enum view_edge */
+	uint8_t fullscreen;
+	uint8_t unused;
+	char output[32];
+	char workspace[64];
+	char region[64];
+	char app_id[256];
+};
+
+struct session_record {
+	uint32_t seq;
+	struct view_state state;
+};
+
+struct workspace_state {
+	uint32_t tiling_layout; /* enum tiling_layout */
+	char name[64];
+};
+
+struct workspace_record {
+	uint32_t seq;
+	struct workspace_state state;
+};
+
+struct state_file {
+	uint32_t magic;
+	uint32_t version;
+	struct workspace_record workspaces[MAX_WORKSPACES];
+	struct session_record views[MAX_VIEWS];
+};
+
+/* A window of the previous instance waiting to come back */
+struct saved_view {
+	struct view_state state;
+	struct view *view; /* the view it was given to, NULL if none yet */
+	struct wl_list link; /* session_state.saved */
+};
+
+static struct {
+	struct server *server;
+	char *path;
+	struct state_file *file; /* NULL if disabled */
+	/* Views changed since the last write */
+	struct wl_list changed; /* view.session_state.link */
+	bool layout_changed;
+	struct wl_event_source *write_idle;
+	struct wl_list saved; /* struct saved_view.link, in record order */
+	struct lab_timer *expire_timer;
+} session_state;
+
+/* Returns false if @src is NULL or does not fit */
+static bool
+copy_string(char *dst, size_t size, const char *src)
+{
+	if (!src || strlen(src) >= size) {
+		return false;
+	}
+	strcpy(dst, src);
+	return true;
+}
+
+/*
+ * Replaces the content of a record, unless unchanged. The mapping is
+ * shared, so every store reaches the file right away; compiler barriers
+ * are enough to keep the sequence number and the content in order for
+ * a crash of labwc itself.
+ */
+static void
+write_record(uint32_t *seq, void *dst, const void *src, size_t size)
+{
+	if (*seq && !memcmp(dst, src, size)) {
+		return;
+	}
+	uint32_t next = *seq + 2;
+	if (!next) {
+		next = 2;
+	}
+	*seq = next - 1;
+	atomic_signal_fence(memory_order_seq_cst);
+	memcpy(dst, src, size);
+	atomic_signal_fence(memory_order_seq_cst);
+	*seq = next;
+}
+
+/* Returns false for views not worth restoring */
+static bool
+get_state(struct view *view, struct view_state *state)
+{
+	memset(state, 0, sizeof(*state));
+	if (!view->mapped || view_get_root(view) != view
+			|| !output_is_usable(view->output)) {
+		return false;
+	}
+	const char *app_id = view_get_app_id(view);
+	if (!copy_string(state->app_id, sizeof(state->app_id), app_id)
+			|| !*state->app_id) {
+		return false;
+	}
+
+	struct wlr_box geometry;
+	if (view->tiling.seq) {
+		geometry = view->tiling.floating;
+	} else if (view_is_floating(view)) {
+		geometry = view->pending;
+	} else {
+		geometry = view->natural_geometry;
+	}
+	state->x = geometry.x - view->output->layout_box.x;
+	state->y = geometry.y - view->output->layout_box.y;
+	state->width = geometry.width;
+	state->height = geometry.height;
+	state->maximized = view->maximized;
+	state->tiled = view->tiled;
+	state->fullscreen = view->fullscreen;
+
+	/* Names which do not fit are left empty and not restored */
+	copy_string(state->output, sizeof(state->output),
+		view->output->wlr_output->name);
+	copy_string(state->workspace, sizeof(state->workspace),
+		view->workspace->name);
+	copy_string(state->region, sizeof(state->region), view->tiled_region
+		? view->tiled_region->name : view->tiled_region_evacuate);
+	return true;
+}
+
+static void
+release_record(struct view *view)
+{
+	if (view->session_state.record) {
+		view->session_state.record->seq = 0;
+		view->session_state.record = NULL;
+	}
+}
+
+static void
+write_view(struct view *view)
+{
+	struct view_state state;
+	if (!get_state(view, &state)) {
+		release_record(view);
+		return;
+	}
+	struct session_record *record = view->session_state.record;
+	if (!record) {
+		for (int i = 0; i < MAX_VIEWS; i++) {
+			if (!session_state.file->views[i].seq) {
+				record = &session_state.file->views[i];
+				break;
+			}
+		}
+		if (!record) {
+			/* Full, this view is not restored */
+			return;
+		}
+		view->session_state.record = record;
+	}
+	write_record(&record->seq, &record->state, &state, sizeof(state));
+}
+
+static void
+write_layouts(void)
+{
+	struct workspace_record *records = session_state.file->workspaces;
+	int i = 0;
+	struct workspace *workspace;
+	wl_list_for_each(workspace, &session_state.server->workspaces, link) {
+		if (i == MAX_WORKSPACES) {
+			break;
+		}
+		struct workspace_state state;
+		memset(&state, 0, sizeof(state));
+		if (!copy_string(state.name, sizeof(state.name),
+				workspace->name)) {
+			continue;
+		}
+		state.tiling_layout = workspace->tiling_layout;
+		write_record(&records[i].seq, &records[i].state, &state,
+			sizeof(state));
+		i++;
+	}
+	for (; i < MAX_WORKSPACES; i++) {
+		records[i].seq = 0;
+	}
+}
+
+static void
+handle_write(void *data)
+{
+	session_state.write_idle = NULL;
+
+	struct view *view, *tmp;
+	wl_list_for_each_safe(view, tmp, &session_state.changed,
+			session_state.link) {
+		wl_list_remove(&view->session_state.link);
+		view->session_state.queued = false;
+		write_view(view);
+	}
+	if (session_state.layout_changed) {
+		session_state.layout_changed = false;
+		write_layouts();
+	}
+}
+
+static void
+schedule_write(void)
+{
+	if (!session_state.write_idle) {
+		session_state.write_idle = wl_event_loop_add_idle(
+			session_state.server->wl_event_loop, handle_write,
+			NULL);
+	}
+}
+
+void
+session_state_changed(struct view *view)
+{
+	if (!session_state.file || view->session_state.queued) {
+		return;
+	}
+	view->session_state.queued = true;
+	wl_list_insert(session_state.changed.prev, &view->session_state.link);
+	schedule_write();
+}
+
+void
+session_state_layout_changed(void)
+{
+	if (!session_state.file) {
+		return;
+	}
+	session_state.layout_changed = true;
+	schedule_write();
+}
+
+static void
+saved_destroy(struct saved_view *saved)
+{
+	wl_list_remove(&saved->link);
+	free(saved);
+}
+
+void
+session_state_view_destroy(struct view *view)
+{
+	if (view->session_state.queued) {
+		wl_list_remove(&view->session_state.link);
+		view->session_state.queued = false;
+	}
+	release_record(view);
+
+	if (!session_state.saved.next) {
+		return;
+	}
+	struct saved_view *saved;
+	wl_list_for_each(saved, &session_state.saved, link) {
+		if (saved->view == view) {
+			saved_destroy(saved);
+			break;
+		}
+	}
+}
+
+static int
+handle_expire_timer(void *data)
+{
+	struct saved_view *saved, *tmp;
+	wl_list_for_each_safe(saved, tmp, &session_state.saved, link) {
+		if (!saved->view) {
+			saved_destroy(saved);
+		}
+	}
+	return 0;
+}
+
+static void
+terminate_strings(struct view_state *state)
+{
+	state->output[sizeof(state->output) - 1] = '\0';
+	state->workspace[sizeof(state->workspace) - 1] = '\0';
+	state->region[sizeof(state->region) - 1] = '\0';
+	state->app_id[sizeof(state->app_id) - 1] = '\0';
+}
+
+static struct workspace *
+find_workspace(struct server *server, const char *name)
+{
+	struct workspace *workspace;
+	wl_list_for_each(workspace, &server->workspaces, link) {
+		if (!strcmp(workspace->name, name)) {
+			return workspace;
+		}
+	}
+	return NULL;
+}
+
+/* Reads what the previous instance left behind */
+static void
+load(int fd)
+{
+	struct stat st;
+	if (fstat(fd, &st) || st.st_size != sizeof(struct state_file)) {
+		return;
+	}
+	struct state_file *file = mmap(NULL, sizeof(*file), PROT_READ,
+		MAP_SHARED, fd, 0);
+	if (file == MAP_FAILED) {
+		return;
+	}
+	if (file->magic != STATE_MAGIC || file->version != STATE_VERSION) {
+		goto out;
+	}
+
+	int nr_views = 0;
+	for (int i = 0; i < MAX_VIEWS; i++) {
+		uint32_t seq = file->views[i].seq;
+		if (!seq || (seq & 1)) {
+			continue;
+		}
+		struct saved_view *saved = znew(*saved);
+		saved->state = file->views[i].state;
+		terminate_strings(&saved->state);
+		wl_list_insert(session_state.saved.prev, &saved->link);
+		nr_views++;
+	}
+
+	for (int i = 0; i < MAX_WORKSPACES; i++) {
+		uint32_t seq = file->workspaces[i].seq;
+		if (!seq || (seq & 1)) {
+			continue;
+		}
+		struct workspace_state state = file->workspaces[i].state;
+		state.name[sizeof(state.name) - 1] = '\0';
+		struct workspace *workspace =
+			find_workspace(session_state.server, state.name);
+		if (workspace && state.tiling_layout < TILING_LAYOUT_INVALID) {
+			tiling_set_layout(workspace, state.tiling_layout);
+		}
+	}
+	wlr_log(WLR_INFO, "restoring %d windows from %s", nr_views,
+		session_state.path);
+out:
+	munmap(file, sizeof(*file));
+}
+
+static void
+close_file(void)
+{
+	if (session_state.write_idle) {
+		wl_event_source_remove(session_state.write_idle);
+		session_state.write_idle = NULL;
+	}
+	struct view *view;
+	wl_list_for_each(view, &session_state.server->views, link) {
+		if (view->session_state.queued) {
+			wl_list_remove(&view->session_state.link);
+			view->session_state.queued = false;
+		}
+		view->session_state.record = NULL;
+	}
+	if (session_state.file) {
+		munmap(session_state.file, sizeof(*session_state.file));
+		session_state.file = NULL;
+	}
+	zfree(session_state.path);
+}
+
+static bool
+open_file(const char *path)
+{
+	int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		wlr_log_errno(WLR_ERROR, "cannot open %s", path);
+		return false;
+	}
+	session_state.path = xstrdup(path);
+	load(fd);
+
+	/* Start over with all records unused */
+	struct state_file *file = MAP_FAILED;
+	if (!ftruncate(fd, 0) && !ftruncate(fd, sizeof(*file))) {
+		file = mmap(NULL, sizeof(*file), PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+	}
+	/* The mapping stays valid without the descriptor */
+	close(fd);
+	if (file == MAP_FAILED) {
+		wlr_log_errno(WLR_ERROR, "cannot map %s", path);
+		zfree(session_state.path);
+		return false;
+	}
+	file->magic = STATE_MAGIC;
+	file->version = STATE_VERSION;
+	session_state.file = file;
+	return true;
+}
+
+void
+session_state_init(struct server *server)
+{
+	if (!session_state.changed.next) {
+		wl_list_init(&session_state.changed);
+		wl_list_init(&session_state.saved);
+	}
+	session_state.server = server;
+
+	if (!rc.placement_restore_session) {
+		if (session_state.file) {
+			/* Nothing to restore the next time */
+			unlink(session_state.path);
+			close_file();
+		}
+		return;
+	}
+	if (session_state.file) {
+		return;
+	}
+
+	/* One file per Wayland socket, so nested instances keep theirs */
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+	const char *display = getenv("WAYLAND_DISPLAY");
+	if (!dir || !display) {
+		wlr_log(WLR_ERROR, "cannot keep session state without "
+			"XDG_RUNTIME_DIR and WAYLAND_DISPLAY");
+		return;
+	}
+	struct buf path = BUF_INIT;
+	buf_add_fmt(&path, "%s/labwc-%s.state", dir, display);
+	bool ok = open_file(path.data);
+	buf_reset(&path);
+	if (!ok) {
+		return;
+	}
+
+	if (!wl_list_empty(&session_state.saved)) {
+		if (!session_state.expire_timer) {
+			session_state.expire_timer = timers_add(
+				server->wl_event_loop, handle_expire_timer,
+				NULL);
+		}
+		timers_update(session_state.expire_timer, RESTORE_TIMEOUT_MS);
+	}
+
+	/* Record what is already there, after enabling on reconfigure */
+	session_state_layout_changed();
+	struct view *view;
+	wl_list_for_each(view, &server->views, link) {
+		session_state_changed(view);
+	}
+}
+
+void
+session_state_finish(void)
+{
+	if (!session_state.changed.next) {
+		return;
+	}
+	if (session_state.write_idle) {
+		wl_event_source_remove(session_state.write_idle);
+		handle_write(NULL);
+	}
+	/* The records are kept for the next instance */
+	close_file();
+
+	if (session_state.expire_timer) {
+		timers_remove(session_state.expire_timer);
+		session_state.expire_timer = NULL;
+	}
+	struct saved_view *saved, *tmp;
+	wl_list_for_each_safe(saved, tmp, &session_state.saved, link) {
+		saved_destroy(saved);
+	}
+}
+
+/* Returns the saved window given to @view, if any, or hands one out */
+static struct saved_view *
+claim(struct view *view)
+{
+	if (!session_state.saved.next || view->been_mapped
+			|| view_get_root(view) != view) {
+		return NULL;
+	}
+	struct saved_view *saved;
+	wl_list_for_each(saved, &session_state.saved, link) {
+		if (saved->view == view) {
+			return saved;
+		}
+	}
+	const char *app_id = view_get_app_id(view);
+	if (!app_id || !*app_id) {
+		return NULL;
+	}
+	/* Several windows of one app come back in their previous order */
+	wl_list_for_each(saved, &session_state.saved, link) {
+		if (!saved->view && !strcmp(saved->state.app_id, app_id)) {
+			saved->view = view;
+			return saved;
+		}
+	}
+	return NULL;
+}
+
+bool
+session_state_place(struct view *view)
+{
+	struct saved_view *saved = claim(view);
+	if (!saved) {
+		return false;
+	}
+	struct view_state *state = &saved->state;
+	struct output *output = output_from_name(view->server, state->output);
+	if (!output_is_usable(output) || state->width <= 0
+			|| state->height <= 0) {
+		return false;
+	}
+	struct wlr_box geometry = {
+		.x = state->x + output->layout_box.x,
+		.y = state->y + output->layout_box.y,
+		.width = state->width,
+		.height = state->height,
+	};
+	view_set_output(view, output);
+	view_move_resize(view, geometry);
+	return true;
+}
+
+void
+session_state_restore(struct view *view)
+{
+	struct saved_view *saved = claim(view);
+	if (!saved) {
+		return;
+	}
+	struct view_state *state = &saved->state;
+	struct server *server = view->server;
+
+	/* The client gets a single configure for all of it */
+	xdg_configure_batch_begin(server);
+	struct workspace *workspace = find_workspace(server, state->workspace);
+	if (workspace && workspace != view->workspace) {
+		view_move_to_workspace(view, workspace);
+	}
+	if (state->fullscreen) {
+		view_set_fullscreen(view, true);
+	} else if (state->maximized != VIEW_AXIS_NONE
+			&& state->maximized <= VIEW_AXIS_BOTH) {
+		view_maximize(view, state->maximized,
+			/* store_natural_geometry */ true);
+	} else if (*state->region) {
+		struct region *region =
+			regions_from_name(state->region, view->output);
+		if (region) {
+			view_snap_to_region(view, region,
+				/* store_natural_geometry */ true);
+		}
+	} else if (state->tiled != VIEW_EDGE_INVALID
+			&& state->tiled <= VIEW_EDGE_CENTER) {
+		view_snap_to_edge(view, state->tiled,
+			/* across_outputs */ false,
+			/* store_natural_geometry */ true);
+	}
+	xdg_configure_batch_end(server);
+
+	saved_destroy(saved);
+}
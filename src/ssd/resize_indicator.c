@@ -1,14 +1,180 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include <assert.h>
+#include <string.h>
+#include <wlr/types/wlr_buffer.h>
 #include <wlr/types/wlr_scene.h>
 #include <wlr/util/box.h>
 #include <wlr/util/log.h>
+#include "buffer.h"
+#include "common/font.h"
 #include "common/macros.h"
-#include "common/scaled_font_buffer.h"
+#include "common/mem.h"
+#include "common/scaled_scene_buffer.h"
 #include "labwc.h"
 #include "resize_indicator.h"
 #include "view.h"
 
+/*
+ * The indicator only ever shows digits and a few separators. These are
+ * rendered once per output scale into a glyph atlas shared by all views
+ * and the text is composed of one scene buffer per character. Updating
+ * the text then only swaps the buffers of the characters which changed
+ * and never runs a Pango layout.
+ */
+static const char glyph_chars[] = "0123456789-x, ";
+#define NR_GLYPHS (ARRAY_SIZE(glyph_chars) - 1)
+
+struct glyph_atlas_page {
+	double scale;
+	struct lab_data_buffer *buffers[NR_GLYPHS];
+	struct wl_list link; /* glyph_atlas.pages */
+};
+
+static struct {
+	bool measured;
+	int advance[NR_GLYPHS]; /* unscaled */
+	struct wl_list pages;
+} glyph_atlas;
+
+/* Pending deferred update of the grabbed view's indicator */
+static struct wl_event_source *update_idle;
+
+static int
+glyph_index(char c)
+{
+	const char *p = c ? strchr(glyph_chars, c) : NULL;
+	return p ? p - glyph_chars : -1;
+}
+
+static void
+glyph_atlas_measure(void)
+{
+	for (size_t i = 0; i < NR_GLYPHS; i++) {
+		char glyph[2] = { glyph_chars[i], '\0' };
+		/* font_extents() adds 4 pixels to the calculated width */
+		glyph_atlas.advance[i] = font_width(&rc.font_osd, glyph) - 4;
+	}
+	glyph_atlas.measured = true;
+}
+
+static struct glyph_atlas_page *
+glyph_atlas_page_get(double scale)
+{
+	if (!glyph_atlas.pages.next) {
+		wl_list_init(&glyph_atlas.pages);
+	}
+
+	struct glyph_atlas_page *page;
+	wl_list_for_each(page, &glyph_atlas.pages, link) {
+		if (page->scale == scale) {
+			return page;
+		}
+	}
+	page = znew(*page);
+	page->scale = scale;
+	wl_list_insert(&glyph_atlas.pages, &page->link);
+	return page;
+}
+
+static struct lab_data_buffer *
+glyph_atlas_get(int index, double scale)
+{
+	struct glyph_atlas_page *page = glyph_atlas_page_get(scale);
+	if (!page->buffers[index]) {
+		char glyph[2] = { glyph_chars[index], '\0' };
+		font_buffer_create(&page->buffers[index],
+			glyph_atlas.advance[index], glyph, &rc.font_osd,
+			rc.theme->osd_label_text_color,
+			rc.theme->osd_bg_color, NULL, scale);
+		buffer_set_category(page->buffers[index],
+			LAB_BUFFER_RESIZE_INDICATOR);
+	}
+	return page->buffers[index];
+}
+
+static void
+glyph_atlas_clear(void)
+{
+	if (!glyph_atlas.pages.next) {
+		wl_list_init(&glyph_atlas.pages);
+	}
+
+	/* Glyph nodes still showing a buffer keep it alive until updated */
+	struct glyph_atlas_page *page, *tmp;
+	wl_list_for_each_safe(page, tmp, &glyph_atlas.pages, link) {
+		for (size_t i = 0; i < NR_GLYPHS; i++) {
+			if (page->buffers[i]) {
+				wlr_buffer_drop(&page->buffers[i]->base);
+			}
+		}
+		wl_list_remove(&page->link);
+		free(page);
+	}
+	glyph_atlas.measured = false;
+}
+
+static struct lab_data_buffer *
+glyph_create_buffer(struct scaled_scene_buffer *scaled_buffer, double scale)
+{
+	/* Points to the character of resize_indicator.text shown */
+	const char *c = scaled_buffer->data;
+	int index = glyph_index(*c);
+	if (index < 0) {
+		return NULL;
+	}
+	return glyph_atlas_get(index, scale);
+}
+
+static const struct scaled_scene_buffer_impl glyph_impl = {
+	.create_buffer = glyph_create_buffer,
+};
+
+/* Returns the unscaled width of the text */
+static int
+glyphs_set_text(struct resize_indicator *indicator, const char *text)
+{
+	if (!glyph_atlas.measured) {
+		glyph_atlas_measure();
+	}
+
+	int x = 0;
+	size_t len = strlen(text);
+	assert(len < ARRAY_SIZE(indicator->glyphs));
+	for (size_t i = 0; i < len; i++) {
+		struct scaled_scene_buffer *glyph = indicator->glyphs[i];
+		if (!glyph) {
+			glyph = scaled_scene_buffer_create(indicator->text_tree,
+				&glyph_impl, /* drop_buffer */ false);
+			if (!glyph) {
+				break;
+			}
+			glyph->data = &indicator->text[i];
+			indicator->glyphs[i] = glyph;
+		}
+		if (indicator->text[i] != text[i]) {
+			indicator->text[i] = text[i];
+			scaled_scene_buffer_invalidate_cache(glyph);
+		}
+		wlr_scene_node_set_position(&glyph->scene_buffer->node, x, 0);
+		wlr_scene_node_set_enabled(&glyph->scene_buffer->node, true);
+
+		int index = glyph_index(text[i]);
+		if (index >= 0) {
+			x += glyph_atlas.advance[index];
+		}
+	}
+
+	/* Hide the glyphs of a previously longer text */
+	for (size_t i = len; i < ARRAY_SIZE(indicator->glyphs); i++) {
+		indicator->text[i] = '\0';
+		if (indicator->glyphs[i]) {
+			wlr_scene_node_set_enabled(
+				&indicator->glyphs[i]->scene_buffer->node, false);
+		}
+	}
+	return x;
+}
+
 static void
 resize_indicator_reconfigure_view(struct resize_indicator *indicator)
 {
@@ -23,13 +189,21 @@ resize_indicator_reconfigure_view(struct resize_indicator *indicator)
 	wlr_scene_node_set_position(&indicator->background->node,
 		theme->osd_border_width, theme->osd_border_width);
 
-	wlr_scene_node_set_position(&indicator->text->scene_buffer->node,
+	wlr_scene_node_set_position(&indicator->text_tree->node,
 		theme->osd_border_width + theme->osd_window_switcher_padding,
 		theme->osd_border_width + theme->osd_window_switcher_padding);
 
 	/* Colors */
 	wlr_scene_rect_set_color(indicator->border, theme->osd_border_color);
 	wlr_scene_rect_set_color(indicator->background, theme->osd_bg_color);
+
+	/* Release the glyphs of the old atlas, the font may have changed */
+	for (size_t i = 0; i < ARRAY_SIZE(indicator->glyphs); i++) {
+		indicator->text[i] = '\0';
+		if (indicator->glyphs[i]) {
+			scaled_scene_buffer_invalidate_cache(indicator->glyphs[i]);
+		}
+	}
 }
 
 static void
@@ -44,7 +218,7 @@ resize_indicator_init(struct view *view)
 		indicator->tree, 0, 0, rc.theme->osd_border_color);
 	indicator->background = wlr_scene_rect_create(
 		indicator->tree, 0, 0, rc.theme->osd_bg_color);
-	indicator->text = scaled_font_buffer_create(indicator->tree);
+	indicator->text_tree = wlr_scene_tree_create(indicator->tree);
 
 	wlr_scene_node_set_enabled(&indicator->tree->node, false);
 	resize_indicator_reconfigure_view(indicator);
@@ -70,6 +244,8 @@ wants_indicator(struct view *view)
 void
 resize_indicator_reconfigure(struct server *server)
 {
+	glyph_atlas_clear();
+
 	struct view *view;
 	wl_list_for_each(view, &server->views, link) {
 		struct resize_indicator *indicator = &view->resize_indicator;
@@ -133,12 +309,9 @@ resize_indicator_show(struct view *view)
 	resize_indicator_update(view);
 }
 
-void
-resize_indicator_update(struct view *view)
+static void
+update_indicator(struct view *view)
 {
-	assert(view);
-	assert(view == view->server->grabbed_view);
-
 	if (!wants_indicator(view)) {
 		return;
 	}
@@ -186,21 +359,42 @@ resize_indicator_update(struct view *view)
 	}
 
 	/* Let the indicator change width as required by the content */
-	int width = font_width(&rc.font_osd, text);
-
-	/* font_extents() adds 4 pixels to the calculated width */
-	width -= 4;
-
-	resize_indicator_set_size(indicator, width);
+	resize_indicator_set_size(indicator, glyphs_set_text(indicator, text));
 
 	/* Center the indicator in the window */
 	wlr_scene_node_set_position(&indicator->tree->node,
 		(eff_width - indicator->width) / 2,
 		(eff_height - indicator->height) / 2);
+}
+
+static void
+handle_update_idle(void *data)
+{
+	struct server *server = data;
+	update_idle = NULL;
+
+	/* The grab may have ended in the meantime */
+	if (server->grabbed_view) {
+		update_indicator(server->grabbed_view);
+	}
+}
 
-	scaled_font_buffer_update(indicator->text, text, width, &rc.font_osd,
-		rc.theme->osd_label_text_color, rc.theme->osd_bg_color,
-		NULL /* const char *arrow */);
+void
+resize_indicator_update(struct view *view)
+{
+	assert(view);
+	assert(view == view->server->grabbed_view);
+
+	/*
+	 * A single pointer motion can move and resize the view several
+	 * times (e.g. resistance, size hints, the client commit), so
+	 * only update the indicator once per event loop iteration.
+	 */
+	if (!update_idle) {
+		update_idle = wl_event_loop_add_idle(
+			view->server->wl_event_loop, handle_update_idle,
+			view->server);
+	}
 }
 
 void
@@ -7,11 +7,17 @@
  */
 
 #include <assert.h>
+#include <stdint.h>
+#include "common/macros.h"
 #include "common/mem.h"
 #include "common/scene-helpers.h"
+#include "common/time-helpers.h"
+#include "common/timers.h"
 #include "labwc.h"
+#include "profile.h"
 #include "ssd-internal.h"
 #include "theme.h"
+#include "trace.h"
 #include "view.h"
 
 struct border
@@ -82,6 +88,37 @@ ssd_is_button(enum ssd_part_type type)
 		|| type == LAB_SSD_BUTTON_WINDOW_MENU;
 }
 
+static const struct ssd_sub_tree *
+get_sub_tree(const struct ssd *ssd, struct wlr_scene_node *node)
+{
+	const struct ssd_sub_tree *subtrees[] = {
+		&ssd->titlebar.active,
+		&ssd->titlebar.inactive,
+		&ssd->border.active,
+		&ssd->border.inactive,
+		&ssd->extents,
+	};
+
+	/*
+	 * Parts are at most three levels below their sub-tree (the
+	 * icons of corner buttons), so walk up the ancestors once
+	 * rather than testing each sub-tree at each level.
+	 */
+	struct wlr_scene_tree *parent = node->parent;
+	for (int depth = 0; parent && depth < 3; depth++) {
+		if (parent == ssd->tree) {
+			return NULL;
+		}
+		for (size_t i = 0; i < ARRAY_SIZE(subtrees); i++) {
+			if (subtrees[i]->tree == parent) {
+				return subtrees[i];
+			}
+		}
+		parent = parent->node.parent;
+	}
+	return NULL;
+}
+
 enum ssd_part_type
 ssd_get_part_type(const struct ssd *ssd, struct wlr_scene_node *node)
 {
@@ -94,47 +131,15 @@ ssd_get_part_type(const struct ssd *ssd, struct wlr_scene_node *node)
 		return LAB_SSD_NONE;
 	}
 
-	const struct wl_list *part_list = NULL;
-	struct wlr_scene_tree *grandparent =
-		node->parent ? node->parent->node.parent : NULL;
-	struct wlr_scene_tree *greatgrandparent =
-		grandparent ? grandparent->node.parent : NULL;
-
-	/* active titlebar */
-	if (node->parent == ssd->titlebar.active.tree) {
-		part_list = &ssd->titlebar.active.parts;
-	} else if (grandparent == ssd->titlebar.active.tree) {
-		part_list = &ssd->titlebar.active.parts;
-	} else if (greatgrandparent == ssd->titlebar.active.tree) {
-		part_list = &ssd->titlebar.active.parts;
-
-	/* extents */
-	} else if (node->parent == ssd->extents.tree) {
-		part_list = &ssd->extents.parts;
-
-	/* active border */
-	} else if (node->parent == ssd->border.active.tree) {
-		part_list = &ssd->border.active.parts;
-
-	/* inactive titlebar */
-	} else if (node->parent == ssd->titlebar.inactive.tree) {
-		part_list = &ssd->titlebar.inactive.parts;
-	} else if (grandparent == ssd->titlebar.inactive.tree) {
-		part_list = &ssd->titlebar.inactive.parts;
-	} else if (greatgrandparent == ssd->titlebar.inactive.tree) {
-		part_list = &ssd->titlebar.inactive.parts;
-
-	/* inactive border */
-	} else if (node->parent == ssd->border.inactive.tree) {
-		part_list = &ssd->border.inactive.parts;
-	}
-
-	if (part_list) {
-		struct ssd_part *part;
-		wl_list_for_each(part, part_list, link) {
-			if (node == part->node) {
-				return part->type;
-			}
+	const struct ssd_sub_tree *subtree = get_sub_tree(ssd, node);
+	if (!subtree) {
+		return LAB_SSD_NONE;
+	}
+
+	struct ssd_part *part;
+	wl_list_for_each(part, &subtree->parts, link) {
+		if (node == part->node) {
+			return part->type;
 		}
 	}
 	return LAB_SSD_NONE;
@@ -175,11 +180,94 @@ ssd_resize_edges(enum ssd_part_type type)
 	}
 }
 
+/*
+ * Views hidden for this long, on another workspace, minimized or
+ * otherwise unmapped, have their title buffers released. Only the scene
+ * nodes and their geometry are kept, the titles are rendered again once
+ * the view is shown.
+ */
+#define SSD_RELEASE_DELAY_MS 10000
+
+static struct {
+	struct lab_timer *timer;
+	bool armed;
+} release;
+
+bool
+ssd_view_is_shown(struct ssd *ssd)
+{
+	struct view *view = ssd->view;
+	return view->mapped && view->workspace == view->server->workspace_current;
+}
+
+static int
+handle_release_timeout(void *data)
+{
+	struct server *server = data;
+	int64_t now = time_now_nsec();
+	int64_t next = INT64_MAX;
+	release.armed = false;
+
+	struct view *view;
+	wl_list_for_each(view, &server->views, link) {
+		struct ssd *ssd = view->ssd;
+		if (!ssd || !ssd->hidden.since_nsec) {
+			continue;
+		}
+		int64_t left = ssd->hidden.since_nsec
+			+ SSD_RELEASE_DELAY_MS * NSEC_PER_MSEC - now;
+		if (left > 0) {
+			next = MIN(next, left);
+			continue;
+		}
+		ssd_titlebar_release(ssd);
+		ssd->hidden.since_nsec = 0;
+		ssd->hidden.released = true;
+	}
+	if (next != INT64_MAX) {
+		timers_update(release.timer,
+			(next + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC);
+		release.armed = true;
+	}
+	return 0;
+}
+
+void
+ssd_update_visibility(struct ssd *ssd)
+{
+	if (!ssd) {
+		return;
+	}
+	if (ssd_view_is_shown(ssd)) {
+		ssd->hidden.since_nsec = 0;
+		ssd->hidden.released = false;
+		if (ssd->state.title.active.stale
+				|| ssd->state.title.inactive.stale) {
+			ssd_update_title(ssd);
+		}
+		return;
+	}
+	if (ssd->hidden.since_nsec || ssd->hidden.released) {
+		return;
+	}
+	ssd->hidden.since_nsec = time_now_nsec();
+	if (!release.timer) {
+		release.timer = timers_add(ssd->view->server->wl_event_loop,
+			handle_release_timeout, ssd->view->server);
+	}
+	if (!release.armed) {
+		timers_update(release.timer, SSD_RELEASE_DELAY_MS);
+		release.armed = true;
+	}
+}
+
 struct ssd *
 ssd_create(struct view *view, bool active)
 {
 	assert(view);
+	int64_t profile_start = profile_begin();
 	struct ssd *ssd = znew(*ssd);
+	trace_begin("ssd_create", view_get_app_id(view));
 
 	ssd->view = view;
 	ssd->tree = wlr_scene_tree_create(view->scene_tree);
@@ -196,6 +284,9 @@ ssd_create(struct view *view, bool active)
 	ssd_set_active(ssd, active);
 	ssd_enable_keybind_inhibit_indicator(ssd, view->inhibits_keybinds);
 	ssd->state.geometry = view->current;
+	ssd_update_visibility(ssd);
+	trace_end("ssd_create");
+	profile_end(PROFILE_SSD_CREATE, profile_start);
 
 	return ssd;
 }
@@ -236,8 +327,10 @@ ssd_update_geometry(struct ssd *ssd)
 		}
 		bool maximized = (ssd->view->maximized == VIEW_AXIS_BOTH);
 		if (ssd->state.was_maximized != maximized) {
+			trace_begin("ssd_update", view_get_app_id(ssd->view));
 			ssd_border_update(ssd);
 			ssd_titlebar_update(ssd);
+			trace_end("ssd_update");
 			/*
 			 * Not strictly necessary as ssd_titlebar_update()
 			 * already sets state.was_maximized but to future
@@ -247,10 +340,12 @@ ssd_update_geometry(struct ssd *ssd)
 		}
 		return;
 	}
+	trace_begin("ssd_update", view_get_app_id(ssd->view));
 	ssd_extents_update(ssd);
 	ssd_border_update(ssd);
 	ssd_titlebar_update(ssd);
 	ssd->state.geometry = current;
+	trace_end("ssd_update");
 }
 
 void
@@ -339,6 +434,12 @@ ssd_set_active(struct ssd *ssd, bool active)
 	wlr_scene_node_set_enabled(&ssd->titlebar.active.tree->node, active);
 	wlr_scene_node_set_enabled(&ssd->border.inactive.tree->node, !active);
 	wlr_scene_node_set_enabled(&ssd->titlebar.inactive.tree->node, !active);
+
+	struct ssd_state_title_width *dstate = active
+		? &ssd->state.title.active : &ssd->state.title.inactive;
+	if (dstate->stale) {
+		ssd_update_title(ssd);
+	}
 }
 
 void
@@ -362,7 +463,7 @@ ssd_enable_keybind_inhibit_indicator(struct ssd *ssd, bool enable)
 		? rc.theme->window_toggled_keybinds_color
 		: rc.theme->window_active_border_color;
 
-	struct ssd_part *part = ssd_get_part(&ssd->border.active.parts, LAB_SSD_PART_TOP);
+	struct ssd_part *part = ssd_get_part(&ssd->border.active, LAB_SSD_PART_TOP);
 	struct wlr_scene_rect *rect = wlr_scene_rect_from_node(part->node);
 	wlr_scene_rect_set_color(rect, color);
 }
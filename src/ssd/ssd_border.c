@@ -40,14 +40,14 @@ ssd_border_create(struct ssd *ssd)
 			wlr_scene_node_set_enabled(&parent->node, false);
 		}
 		wl_list_init(&subtree->parts);
-		add_scene_rect(&subtree->parts, LAB_SSD_PART_LEFT, parent,
+		add_scene_rect(subtree, LAB_SSD_PART_LEFT, parent,
 			theme->border_width, height, 0, 0, color);
-		add_scene_rect(&subtree->parts, LAB_SSD_PART_RIGHT, parent,
+		add_scene_rect(subtree, LAB_SSD_PART_RIGHT, parent,
 			theme->border_width, height,
 			theme->border_width + width, 0, color);
-		add_scene_rect(&subtree->parts, LAB_SSD_PART_BOTTOM, parent,
+		add_scene_rect(subtree, LAB_SSD_PART_BOTTOM, parent,
 			full_width, theme->border_width, 0, height, color);
-		add_scene_rect(&subtree->parts, LAB_SSD_PART_TOP, parent,
+		add_scene_rect(subtree, LAB_SSD_PART_TOP, parent,
 			width - 2 * SSD_BUTTON_WIDTH, theme->border_width,
 			theme->border_width + SSD_BUTTON_WIDTH,
 			-(ssd->titlebar.height + theme->border_width), color);
@@ -139,7 +139,7 @@ ssd_border_destroy(struct ssd *ssd)
 
 	struct ssd_sub_tree *subtree;
 	FOR_EACH_STATE(ssd, subtree) {
-		ssd_destroy_parts(&subtree->parts);
+		ssd_destroy_parts(subtree);
 		wlr_scene_node_destroy(&subtree->tree->node);
 		subtree->tree = NULL;
 	} FOR_EACH_END
@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: GPL-2.0-only
 
 #include <pixman.h>
+#include <string.h>
+#include <wlr/util/box.h>
 #include "common/mem.h"
 #include "common/scene-helpers.h"
 #include "labwc.h"
@@ -8,12 +10,100 @@
 #include "theme.h"
 #include "view.h"
 
+/*
+ * Union of the usable areas of the outputs the last updated view was on.
+ * Moving a view mostly keeps it on the same outputs, so the region is
+ * only built again if their usable areas differ.
+ */
+static struct {
+	struct wl_array areas; /* struct wlr_box */
+	pixman_region32_t region;
+	bool valid;
+} usable_cache;
+
+static pixman_region32_t *
+usable_region(struct view *view)
+{
+	struct wl_array areas;
+	wl_array_init(&areas);
+	struct output *output;
+	wl_list_for_each(output, &view->server->outputs, link) {
+		if (view_on_output(view, output)) {
+			struct wlr_box *area = scratch_array_add(&areas,
+				sizeof(*area));
+			*area = output_usable_area_in_layout_coords(output);
+		}
+	}
+
+	if (usable_cache.valid && areas.size == usable_cache.areas.size
+			&& (!areas.size || !memcmp(areas.data,
+				usable_cache.areas.data, areas.size))) {
+		return &usable_cache.region;
+	}
+	if (!usable_cache.valid) {
+		wl_array_init(&usable_cache.areas);
+		pixman_region32_init(&usable_cache.region);
+		usable_cache.valid = true;
+	}
+	wl_array_copy(&usable_cache.areas, &areas);
+	pixman_region32_clear(&usable_cache.region);
+	struct wlr_box *area;
+	wl_array_for_each(area, &usable_cache.areas) {
+		pixman_region32_union_rect(&usable_cache.region,
+			&usable_cache.region, area->x, area->y,
+			area->width, area->height);
+	}
+	return &usable_cache.region;
+}
+
+/*
+ * Returns false if no part of @box is in @usable. @intersection is
+ * scratch space.
+ */
+static bool
+constrain_to_region(pixman_region32_t *usable,
+		pixman_region32_t *intersection, struct wlr_box *box,
+		struct wlr_box *result)
+{
+	int nrects;
+	pixman_region32_clear(intersection);
+	pixman_region32_intersect_rect(intersection, usable,
+		box->x, box->y, box->width, box->height);
+	const pixman_box32_t *inter_rects =
+		pixman_region32_rectangles(intersection, &nrects);
+	if (nrects == 0) {
+		return false;
+	}
+
+	/*
+	 * For each edge, the invisible grab area is resized
+	 * to not cover layer-shell clients such as panels.
+	 * However, only one resize operation is used per edge,
+	 * so if a window is in the unlikely position that it
+	 * is near a panel but also overspills onto another screen,
+	 * the invisible grab-area on the other screen would be
+	 * smaller than would normally be the case.
+	 *
+	 * Thus only use the first intersecting rect, this is
+	 * a compromise as it doesn't require us to create
+	 * multiple scene rects for a given extent edge
+	 * and still works in 95% of the cases.
+	 */
+	*result = (struct wlr_box) {
+		.x = inter_rects[0].x1,
+		.y = inter_rects[0].y1,
+		.width = inter_rects[0].x2 - inter_rects[0].x1,
+		.height = inter_rects[0].y2 - inter_rects[0].y1
+	};
+	return true;
+}
+
 static struct ssd_part *
-add_extent(struct wl_list *part_list, enum ssd_part_type type,
+add_extent(struct ssd_sub_tree *subtree, enum ssd_part_type type,
 		struct wlr_scene_tree *parent)
 {
 	float invisible[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
-	struct ssd_part *part = add_scene_part(part_list, type);
+	struct ssd_part *part = add_scene_part(subtree, type);
 	/*
 	 * Extents need additional geometry to enable dynamic
 	 * resize based on position and output->usable_area.
@@ -30,7 +120,7 @@ ssd_extents_create(struct ssd *ssd)
 {
 	struct view *view = ssd->view;
 	struct theme *theme = view->server->theme;
-	struct wl_list *part_list = &ssd->extents.parts;
+	struct ssd_sub_tree *subtree = &ssd->extents;
 	int extended_area = SSD_EXTENDED_AREA;
 	int corner_size = extended_area + theme->border_width + SSD_BUTTON_WIDTH / 2;
 
@@ -48,37 +138,37 @@ ssd_extents_create(struct ssd *ssd)
 	struct ssd_part *p;
 
 	/* Top */
-	p = add_extent(part_list, LAB_SSD_PART_CORNER_TOP_LEFT, parent);
+	p = add_extent(subtree, LAB_SSD_PART_CORNER_TOP_LEFT, parent);
 	p->geometry->width = corner_size;
 	p->geometry->height = corner_size;
 
-	p = add_extent(part_list, LAB_SSD_PART_TOP, parent);
+	p = add_extent(subtree, LAB_SSD_PART_TOP, parent);
 	p->geometry->x = corner_size;
 	p->geometry->height = extended_area;
 
-	p = add_extent(part_list, LAB_SSD_PART_CORNER_TOP_RIGHT, parent);
+	p = add_extent(subtree, LAB_SSD_PART_CORNER_TOP_RIGHT, parent);
 	p->geometry->width = corner_size;
 	p->geometry->height = corner_size;
 
 	/* Sides */
-	p = add_extent(part_list, LAB_SSD_PART_LEFT, parent);
+	p = add_extent(subtree, LAB_SSD_PART_LEFT, parent);
 	p->geometry->y = corner_size;
 	p->geometry->width = extended_area;
 
-	p = add_extent(part_list, LAB_SSD_PART_RIGHT, parent);
+	p = add_extent(subtree, LAB_SSD_PART_RIGHT, parent);
 	p->geometry->y = corner_size;
 	p->geometry->width = extended_area;
 
 	/* Bottom */
-	p = add_extent(part_list, LAB_SSD_PART_CORNER_BOTTOM_LEFT, parent);
+	p = add_extent(subtree, LAB_SSD_PART_CORNER_BOTTOM_LEFT, parent);
 	p->geometry->width = corner_size;
 	p->geometry->height = corner_size;
 
-	p = add_extent(part_list, LAB_SSD_PART_BOTTOM, parent);
+	p = add_extent(subtree, LAB_SSD_PART_BOTTOM, parent);
 	p->geometry->x = corner_size;
 	p->geometry->height = extended_area;
 
-	p = add_extent(part_list, LAB_SSD_PART_CORNER_BOTTOM_RIGHT, parent);
+	p = add_extent(subtree, LAB_SSD_PART_CORNER_BOTTOM_RIGHT, parent);
 	p->geometry->width = corner_size;
 	p->geometry->height = corner_size;
 
@@ -124,23 +214,22 @@ ssd_extents_update(struct ssd *ssd)
 		-(ssd->titlebar.height + theme->border_width + extended_area));
 
 	/*
-	 * Convert all output usable areas that the
-	 * view is currently on into a pixman region
+	 * On a single output, the usable area is a plain box and the parts
+	 * can be constrained to it without pixman, which is what happens
+	 * on every step of moving a view around. Otherwise all output
+	 * usable areas that the view is currently on are combined into a
+	 * pixman region.
 	 */
-	int nrects;
-	pixman_region32_t usable;
+	bool single_output = bitset_count(&view->outputs) == 1
+		&& view_on_output(view, view->output);
+	struct wlr_box single_usable = { 0 };
+	pixman_region32_t *usable = NULL;
 	pixman_region32_t intersection;
-	pixman_region32_init(&usable);
 	pixman_region32_init(&intersection);
-	struct output *output;
-	wl_list_for_each(output, &view->server->outputs, link) {
-		if (!view_on_output(view, output)) {
-			continue;
-		}
-		struct wlr_box usable_area =
-			output_usable_area_in_layout_coords(output);
-		pixman_region32_union_rect(&usable, &usable, usable_area.x,
-			usable_area.y, usable_area.width, usable_area.height);
+	if (single_output) {
+		single_usable = output_usable_area_in_layout_coords(view->output);
+	} else {
+		usable = usable_region(view);
 	}
 
 	/* Remember base layout coordinates */
@@ -187,39 +276,17 @@ ssd_extents_update(struct ssd *ssd)
 		part_box.height = target->height;
 
 		/* Constrain part to output->usable_area */
-		pixman_region32_clear(&intersection);
-		pixman_region32_intersect_rect(&intersection, &usable,
-			part_box.x, part_box.y, part_box.width, part_box.height);
-		const pixman_box32_t *inter_rects =
-			pixman_region32_rectangles(&intersection, &nrects);
-
-		if (nrects == 0) {
+		bool visible = single_output
+			? wlr_box_intersection(&result_box, &single_usable,
+				&part_box)
+			: constrain_to_region(usable, &intersection, &part_box,
+				&result_box);
+		if (!visible) {
 			/* Not visible */
 			wlr_scene_node_set_enabled(part->node, false);
 			continue;
 		}
 
-		/*
-		 * For each edge, the invisible grab area is resized
-		 * to not cover layer-shell clients such as panels.
-		 * However, only one resize operation is used per edge,
-		 * so if a window is in the unlikely position that it
-		 * is near a panel but also overspills onto another screen,
-		 * the invisible grab-area on the other screen would be
-		 * smaller than would normally be the case.
-		 *
-		 * Thus only use the first intersecting rect, this is
-		 * a compromise as it doesn't require us to create
-		 * multiple scene rects for a given extent edge
-		 * and still works in 95% of the cases.
-		 */
-		result_box = (struct wlr_box) {
-			.x = inter_rects[0].x1,
-			.y = inter_rects[0].y1,
-			.width = inter_rects[0].x2 - inter_rects[0].x1,
-			.height = inter_rects[0].y2 - inter_rects[0].y1
-		};
-
 		if (!part->node->enabled) {
 			wlr_scene_node_set_enabled(part->node, true);
 		}
@@ -245,7 +312,6 @@ ssd_extents_update(struct ssd *ssd)
 		}
 	}
 	pixman_region32_fini(&intersection);
-	pixman_region32_fini(&usable);
 }
 
 void
@@ -255,7 +321,7 @@ ssd_extents_destroy(struct ssd *ssd)
 		return;
 	}
 
-	ssd_destroy_parts(&ssd->extents.parts);
+	ssd_destroy_parts(&ssd->extents);
 	wlr_scene_node_destroy(&ssd->extents.tree->node);
 	ssd->extents.tree = NULL;
 }
@@ -1,11 +1,18 @@
 // SPDX-License-Identifier: GPL-2.0-only
 
 #include <assert.h>
+#include <string.h>
 #include "common/list.h"
 #include "common/mem.h"
+#include "common/scaled_scene_buffer.h"
 #include "labwc.h"
 #include "node.h"
 #include "ssd-internal.h"
+#include "theme.h"
+
+/* Decorations are created and destroyed with every (re)mapped view */
+static struct pool part_pool = POOL_INIT(struct ssd_part);
+static struct pool button_pool = POOL_INIT(struct ssd_button);
 
 /* Internal helpers */
 static void
@@ -13,7 +20,7 @@ ssd_button_destroy_notify(struct wl_listener *listener, void *data)
 {
 	struct ssd_button *button = wl_container_of(listener, button, destroy);
 	wl_list_remove(&button->destroy.link);
-	free(button);
+	pool_free(&button_pool, button);
 }
 
 /*
@@ -25,7 +32,7 @@ static struct ssd_button *
 ssd_button_descriptor_create(struct wlr_scene_node *node)
 {
 	/* Create new ssd_button */
-	struct ssd_button *button = znew(*button);
+	struct ssd_button *button = pool_alloc(&button_pool);
 
 	/* Let it destroy automatically when the scene node destroys */
 	button->destroy.notify = ssd_button_destroy_notify;
@@ -38,16 +45,22 @@ ssd_button_descriptor_create(struct wlr_scene_node *node)
 
 /* Internal API */
 struct ssd_part *
-add_scene_part(struct wl_list *part_list, enum ssd_part_type type)
+add_scene_part(struct ssd_sub_tree *subtree, enum ssd_part_type type)
 {
-	struct ssd_part *part = znew(*part);
+	assert(type < LAB_SSD_END_MARKER);
+	struct ssd_part *part = pool_alloc(&part_pool);
 	part->type = type;
-	wl_list_append(part_list, &part->link);
+	wl_list_append(&subtree->parts, &part->link);
+
+	/* Buttons consist of several parts, the first one is their root */
+	if (!subtree->part_by_type[type]) {
+		subtree->part_by_type[type] = part;
+	}
 	return part;
 }
 
 struct ssd_part *
-add_scene_rect(struct wl_list *list, enum ssd_part_type type,
+add_scene_rect(struct ssd_sub_tree *subtree, enum ssd_part_type type,
 	struct wlr_scene_tree *parent, int width, int height,
 	int x, int y, float color[4])
 {
@@ -60,7 +73,7 @@ add_scene_rect(struct wl_list *list, enum ssd_part_type type,
 	width = width >= 0 ? width : 0;
 	height = height >= 0 ? height : 0;
 
-	struct ssd_part *part = add_scene_part(list, type);
+	struct ssd_part *part = add_scene_part(subtree, type);
 	part->node = &wlr_scene_rect_create(
 		parent, width, height, color)->node;
 	wlr_scene_node_set_position(part->node, x, y);
@@ -68,20 +81,20 @@ add_scene_rect(struct wl_list *list, enum ssd_part_type type,
 }
 
 struct ssd_part *
-add_scene_buffer(struct wl_list *list, enum ssd_part_type type,
+add_scene_buffer(struct ssd_sub_tree *subtree, enum ssd_part_type type,
 	struct wlr_scene_tree *parent, struct wlr_buffer *buffer,
 	int x, int y)
 {
-	struct ssd_part *part = add_scene_part(list, type);
+	struct ssd_part *part = add_scene_part(subtree, type);
 	part->node = &wlr_scene_buffer_create(parent, buffer)->node;
 	wlr_scene_node_set_position(part->node, x, y);
 	return part;
 }
 
 struct ssd_part *
-add_scene_button_corner(struct wl_list *part_list, enum ssd_part_type type,
+add_scene_button_corner(struct ssd_sub_tree *subtree, enum ssd_part_type type,
 		enum ssd_part_type corner_type, struct wlr_scene_tree *parent,
-		struct wlr_buffer *corner_buffer, struct wlr_buffer *icon_buffer,
+		bool active, struct wlr_buffer *icon_buffer,
 		struct wlr_buffer *hover_buffer, int x, struct view *view)
 {
 	int offset_x;
@@ -97,20 +110,23 @@ add_scene_button_corner(struct wl_list *part_list, enum ssd_part_type type,
 		abort();
 	}
 
-	struct ssd_part *button_root = add_scene_part(part_list, corner_type);
+	struct ssd_part *button_root = add_scene_part(subtree, corner_type);
 	parent = wlr_scene_tree_create(parent);
 	button_root->node = &parent->node;
 	wlr_scene_node_set_position(button_root->node, x, 0);
 
 	/*
 	 * Background, x and y adjusted for border_width which is
-	 * already included in rendered theme.c / corner_buffer
+	 * already included in the corner rendered by theme.c
 	 */
-	add_scene_buffer(part_list, corner_type, parent, corner_buffer,
-		-offset_x, -rc.theme->border_width);
+	struct scaled_scene_buffer *corner = theme_corner_create(parent,
+		rc.theme, corner_type == LAB_SSD_PART_CORNER_TOP_RIGHT, active);
+	struct ssd_part *part = add_scene_part(subtree, corner_type);
+	part->node = &corner->scene_buffer->node;
+	wlr_scene_node_set_position(part->node, -offset_x, -rc.theme->border_width);
 
 	/* Finally just put a usual theme button on top, using an invisible hitbox */
-	add_scene_button(part_list, type, parent, invisible, icon_buffer, hover_buffer, 0, view);
+	add_scene_button(subtree, type, parent, invisible, icon_buffer, hover_buffer, 0, view);
 	return button_root;
 }
 
@@ -141,25 +157,25 @@ get_scale_box(struct wlr_buffer *buffer, double container_width,
 }
 
 struct ssd_part *
-add_scene_button(struct wl_list *part_list, enum ssd_part_type type,
+add_scene_button(struct ssd_sub_tree *subtree, enum ssd_part_type type,
 		struct wlr_scene_tree *parent, float *bg_color,
 		struct wlr_buffer *icon_buffer, struct wlr_buffer *hover_buffer,
 		int x, struct view *view)
 {
-	struct ssd_part *button_root = add_scene_part(part_list, type);
+	struct ssd_part *button_root = add_scene_part(subtree, type);
 	parent = wlr_scene_tree_create(parent);
 	button_root->node = &parent->node;
 	wlr_scene_node_set_position(button_root->node, x, 0);
 
 	/* Background */
-	struct ssd_part *bg_rect = add_scene_rect(part_list, type, parent,
+	struct ssd_part *bg_rect = add_scene_rect(subtree, type, parent,
 		SSD_BUTTON_WIDTH, rc.theme->title_height, 0, 0, bg_color);
 
 	/* Icon */
 	struct wlr_scene_tree *icon_tree = wlr_scene_tree_create(parent);
 	struct wlr_box icon_geo = get_scale_box(icon_buffer,
 		SSD_BUTTON_WIDTH, rc.theme->title_height);
-	struct ssd_part *icon_part = add_scene_buffer(part_list, type,
+	struct ssd_part *icon_part = add_scene_buffer(subtree, type,
 		icon_tree, icon_buffer, icon_geo.x, icon_geo.y);
 
 	/* Make sure big icons are scaled down if necessary */
@@ -172,7 +188,7 @@ add_scene_button(struct wl_list *part_list, enum ssd_part_type type,
 	wlr_scene_node_set_enabled(&hover_tree->node, false);
 	struct wlr_box hover_geo = get_scale_box(hover_buffer,
 		SSD_BUTTON_WIDTH, rc.theme->title_height);
-	struct ssd_part *hover_part = add_scene_buffer(part_list, type,
+	struct ssd_part *hover_part = add_scene_buffer(subtree, type,
 		hover_tree, hover_buffer, hover_geo.x, hover_geo.y);
 
 	/* Make sure big icons are scaled down if necessary */
@@ -194,7 +210,7 @@ add_scene_button(struct wl_list *part_list, enum ssd_part_type type,
 }
 
 void
-add_toggled_icon(struct ssd_button *button, struct wl_list *part_list,
+add_toggled_icon(struct ssd_button *button, struct ssd_sub_tree *subtree,
 		enum ssd_part_type type, struct wlr_buffer *icon_buffer,
 		struct wlr_buffer *hover_buffer)
 {
@@ -202,7 +218,7 @@ add_toggled_icon(struct ssd_button *button, struct wl_list *part_list,
 	struct wlr_box icon_geo = get_scale_box(icon_buffer,
 		SSD_BUTTON_WIDTH, rc.theme->title_height);
 
-	struct ssd_part *alticon_part = add_scene_buffer(part_list, type,
+	struct ssd_part *alticon_part = add_scene_buffer(subtree, type,
 		button->icon_tree, icon_buffer, icon_geo.x, icon_geo.y);
 
 	wlr_scene_buffer_set_dest_size(
@@ -213,7 +229,7 @@ add_toggled_icon(struct ssd_button *button, struct wl_list *part_list,
 
 	struct wlr_box hover_geo = get_scale_box(hover_buffer,
 		SSD_BUTTON_WIDTH, rc.theme->title_height);
-	struct ssd_part *althover_part = add_scene_buffer(part_list, type,
+	struct ssd_part *althover_part = add_scene_buffer(subtree, type,
 		button->hover_tree, hover_buffer, hover_geo.x, hover_geo.y);
 
 	wlr_scene_buffer_set_dest_size(
@@ -227,34 +243,39 @@ add_toggled_icon(struct ssd_button *button, struct wl_list *part_list,
 }
 
 struct ssd_part *
-ssd_get_part(struct wl_list *part_list, enum ssd_part_type type)
+ssd_get_part(struct ssd_sub_tree *subtree, enum ssd_part_type type)
 {
-	struct ssd_part *part;
-	wl_list_for_each(part, part_list, link) {
-		if (part->type == type) {
-			return part;
-		}
+	assert(type < LAB_SSD_END_MARKER);
+	return subtree->part_by_type[type];
+}
+
+void
+ssd_destroy_part(struct ssd_sub_tree *subtree, struct ssd_part *part)
+{
+	if (part->node) {
+		wlr_scene_node_destroy(part->node);
+		part->node = NULL;
+	}
+	/* part->buffer will free itself along the scene_buffer node */
+	part->buffer = NULL;
+	if (part->geometry) {
+		free(part->geometry);
+		part->geometry = NULL;
 	}
-	return NULL;
+	if (subtree->part_by_type[part->type] == part) {
+		subtree->part_by_type[part->type] = NULL;
+	}
+	wl_list_remove(&part->link);
+	pool_free(&part_pool, part);
 }
 
 void
-ssd_destroy_parts(struct wl_list *list)
+ssd_destroy_parts(struct ssd_sub_tree *subtree)
 {
 	struct ssd_part *part, *tmp;
-	wl_list_for_each_reverse_safe(part, tmp, list, link) {
-		if (part->node) {
-			wlr_scene_node_destroy(part->node);
-			part->node = NULL;
-		}
-		/* part->buffer will free itself along the scene_buffer node */
-		part->buffer = NULL;
-		if (part->geometry) {
-			free(part->geometry);
-			part->geometry = NULL;
-		}
-		wl_list_remove(&part->link);
-		free(part);
+	wl_list_for_each_reverse_safe(part, tmp, &subtree->parts, link) {
+		ssd_destroy_part(subtree, part);
 	}
-	assert(wl_list_empty(list));
+	assert(wl_list_empty(&subtree->parts));
+	memset(subtree->part_by_type, 0, sizeof(subtree->part_by_type));
 }
@@ -4,12 +4,14 @@
 #include <assert.h>
 #include <string.h>
 #include "buffer.h"
+#include "common/intern.h"
 #include "common/mem.h"
 #include "common/scaled_font_buffer.h"
 #include "common/scene-helpers.h"
 #include "common/string-helpers.h"
 #include "labwc.h"
 #include "node.h"
+#include "profile.h"
 #include "ssd-internal.h"
 #include "theme.h"
 #include "view.h"
@@ -30,8 +32,6 @@ ssd_titlebar_create(struct ssd *ssd)
 
 	float *color;
 	struct wlr_scene_tree *parent;
-	struct wlr_buffer *corner_top_left;
-	struct wlr_buffer *corner_top_right;
 
 	struct wlr_buffer *menu_button_unpressed;
 	struct wlr_buffer *iconify_button_unpressed;
@@ -54,8 +54,6 @@ ssd_titlebar_create(struct ssd *ssd)
 		wlr_scene_node_set_position(&parent->node, 0, -theme->title_height);
 		if (subtree == &ssd->titlebar.active) {
 			color = theme->window_active_title_bg_color;
-			corner_top_left = &theme->corner_top_left_active_normal->base;
-			corner_top_right = &theme->corner_top_right_active_normal->base;
 			menu_button_unpressed = &theme->button_menu_active_unpressed->base;
 			iconify_button_unpressed = &theme->button_iconify_active_unpressed->base;
 			close_button_unpressed = &theme->button_close_active_unpressed->base;
@@ -69,8 +67,6 @@ ssd_titlebar_create(struct ssd *ssd)
 			restore_button_hover = &theme->button_restore_active_hover->base;
 		} else {
 			color = theme->window_inactive_title_bg_color;
-			corner_top_left = &theme->corner_top_left_inactive_normal->base;
-			corner_top_right = &theme->corner_top_right_inactive_normal->base;
 			menu_button_unpressed = &theme->button_menu_inactive_unpressed->base;
 			iconify_button_unpressed = &theme->button_iconify_inactive_unpressed->base;
 			maximize_button_unpressed =
@@ -89,33 +85,37 @@ ssd_titlebar_create(struct ssd *ssd)
 		wl_list_init(&subtree->parts);
 
 		/* Title */
-		add_scene_rect(&subtree->parts, LAB_SSD_PART_TITLEBAR, parent,
+		add_scene_rect(subtree, LAB_SSD_PART_TITLEBAR, parent,
 			width - SSD_BUTTON_WIDTH * SSD_BUTTON_COUNT, theme->title_height,
 			SSD_BUTTON_WIDTH, 0, color);
 		/* Buttons */
-		add_scene_button_corner(&subtree->parts,
+		add_scene_button_corner(subtree,
 			LAB_SSD_BUTTON_WINDOW_MENU, LAB_SSD_PART_CORNER_TOP_LEFT, parent,
-			corner_top_left, menu_button_unpressed, menu_button_hover, 0, view);
-		add_scene_button(&subtree->parts, LAB_SSD_BUTTON_ICONIFY, parent,
+			subtree == &ssd->titlebar.active,
+			menu_button_unpressed, menu_button_hover, 0, view);
+		add_scene_button(subtree, LAB_SSD_BUTTON_ICONIFY, parent,
 			color, iconify_button_unpressed, iconify_button_hover,
 			width - SSD_BUTTON_WIDTH * 3, view);
 
 		/* Maximize button has an alternate state when maximized */
 		struct ssd_part *btn_max_root = add_scene_button(
-			&subtree->parts, LAB_SSD_BUTTON_MAXIMIZE, parent,
+			subtree, LAB_SSD_BUTTON_MAXIMIZE, parent,
 			color, maximize_button_unpressed, maximize_button_hover,
 			width - SSD_BUTTON_WIDTH * 2, view);
 		struct ssd_button *btn_max = node_ssd_button_from_node(btn_max_root->node);
-		add_toggled_icon(btn_max, &subtree->parts, LAB_SSD_BUTTON_MAXIMIZE,
+		add_toggled_icon(btn_max, subtree, LAB_SSD_BUTTON_MAXIMIZE,
 			restore_button_unpressed, restore_button_hover);
 
-		add_scene_button_corner(&subtree->parts,
+		add_scene_button_corner(subtree,
 			LAB_SSD_BUTTON_CLOSE, LAB_SSD_PART_CORNER_TOP_RIGHT, parent,
-			corner_top_right, close_button_unpressed, close_button_hover,
+			subtree == &ssd->titlebar.active,
+			close_button_unpressed, close_button_hover,
 			width - SSD_BUTTON_WIDTH * 1, view);
 	} FOR_EACH_END
 
-	ssd_update_title(ssd);
+	/* Only the state shown is rendered, by ssd_set_active() */
+	ssd->state.title.active.stale = true;
+	ssd->state.title.inactive.stale = true;
 
 	if (view->maximized == VIEW_AXIS_BOTH) {
 		set_squared_corners(ssd, true);
@@ -124,12 +124,6 @@ ssd_titlebar_create(struct ssd *ssd)
 	}
 }
 
-static bool
-is_direct_child(struct wlr_scene_node *node, struct ssd_sub_tree *subtree)
-{
-	return node->parent == subtree->tree;
-}
-
 static void
 set_squared_corners(struct ssd *ssd, bool enable)
 {
@@ -139,7 +133,7 @@ set_squared_corners(struct ssd *ssd, bool enable)
 
 	FOR_EACH_STATE(ssd, subtree) {
 		for (size_t i = 0; i < ARRAY_SIZE(ssd_type); i++) {
-			part = ssd_get_part(&subtree->parts, ssd_type[i]);
+			part = ssd_get_part(subtree, ssd_type[i]);
 			struct ssd_button *button = node_ssd_button_from_node(part->node);
 
 			/* Toggle background between invisible and titlebar background color */
@@ -165,7 +159,7 @@ set_maximize_alt_icon(struct ssd *ssd, bool enable)
 	struct ssd_sub_tree *subtree;
 
 	FOR_EACH_STATE(ssd, subtree) {
-		part = ssd_get_part(&subtree->parts, LAB_SSD_BUTTON_MAXIMIZE);
+		part = ssd_get_part(subtree, LAB_SSD_BUTTON_MAXIMIZE);
 		button = node_ssd_button_from_node(part->node);
 
 		if (button->toggled) {
@@ -201,36 +195,21 @@ ssd_titlebar_update(struct ssd *ssd)
 	struct ssd_part *part;
 	struct ssd_sub_tree *subtree;
 	FOR_EACH_STATE(ssd, subtree) {
-		wl_list_for_each(part, &subtree->parts, link) {
-			switch (part->type) {
-			case LAB_SSD_PART_TITLEBAR:
-				wlr_scene_rect_set_size(
-					wlr_scene_rect_from_node(part->node),
-					width - SSD_BUTTON_WIDTH * SSD_BUTTON_COUNT,
-					theme->title_height);
-				continue;
-			case LAB_SSD_BUTTON_ICONIFY:
-				if (is_direct_child(part->node, subtree)) {
-					wlr_scene_node_set_position(part->node,
-						width - SSD_BUTTON_WIDTH * 3, 0);
-				}
-				continue;
-			case LAB_SSD_BUTTON_MAXIMIZE:
-				if (is_direct_child(part->node, subtree)) {
-					wlr_scene_node_set_position(part->node,
-						width - SSD_BUTTON_WIDTH * 2, 0);
-				}
-				continue;
-			case LAB_SSD_PART_CORNER_TOP_RIGHT:
-				if (is_direct_child(part->node, subtree)) {
-					wlr_scene_node_set_position(part->node,
-						width - SSD_BUTTON_WIDTH * 1, 0);
-				}
-				continue;
-			default:
-				continue;
-			}
-		}
+		part = ssd_get_part(subtree, LAB_SSD_PART_TITLEBAR);
+		wlr_scene_rect_set_size(wlr_scene_rect_from_node(part->node),
+			width - SSD_BUTTON_WIDTH * SSD_BUTTON_COUNT,
+			theme->title_height);
+
+		/* The first part of each button type is its root node */
+		part = ssd_get_part(subtree, LAB_SSD_BUTTON_ICONIFY);
+		wlr_scene_node_set_position(part->node,
+			width - SSD_BUTTON_WIDTH * 3, 0);
+		part = ssd_get_part(subtree, LAB_SSD_BUTTON_MAXIMIZE);
+		wlr_scene_node_set_position(part->node,
+			width - SSD_BUTTON_WIDTH * 2, 0);
+		part = ssd_get_part(subtree, LAB_SSD_PART_CORNER_TOP_RIGHT);
+		wlr_scene_node_set_position(part->node,
+			width - SSD_BUTTON_WIDTH * 1, 0);
 	} FOR_EACH_END
 	ssd_update_title(ssd);
 }
@@ -241,18 +220,20 @@ ssd_titlebar_destroy(struct ssd *ssd)
 	if (!ssd->titlebar.tree) {
 		return;
 	}
+	if (ssd->prewarm_idle) {
+		wl_event_source_remove(ssd->prewarm_idle);
+		ssd->prewarm_idle = NULL;
+	}
 
 	struct ssd_sub_tree *subtree;
 	FOR_EACH_STATE(ssd, subtree) {
-		ssd_destroy_parts(&subtree->parts);
+		ssd_destroy_parts(subtree);
 		wlr_scene_node_destroy(&subtree->tree->node);
 		subtree->tree = NULL;
 	} FOR_EACH_END
 
-	if (ssd->state.title.text) {
-		free(ssd->state.title.text);
-		ssd->state.title.text = NULL;
-	}
+	intern_unref(ssd->state.title.text);
+	ssd->state.title.text = NULL;
 
 	wlr_scene_node_destroy(&ssd->titlebar.tree->node);
 	ssd->titlebar.tree = NULL;
@@ -283,7 +264,7 @@ ssd_update_title_positions(struct ssd *ssd)
 	struct ssd_part *part;
 	struct ssd_sub_tree *subtree;
 	FOR_EACH_STATE(ssd, subtree) {
-		part = ssd_get_part(&subtree->parts, LAB_SSD_PART_TITLE);
+		part = ssd_get_part(subtree, LAB_SSD_PART_TITLE);
 		if (!part || !part->node) {
 			/* view->surface never been mapped */
 			/* Or we somehow failed to allocate a scaled titlebar buffer */
@@ -322,22 +303,27 @@ ssd_update_title_positions(struct ssd *ssd)
 	} FOR_EACH_END
 }
 
-void
-ssd_update_title(struct ssd *ssd)
+/* @prewarm also renders the titlebar states not shown */
+static void
+update_title(struct ssd *ssd, bool prewarm)
 {
-	if (!ssd) {
+	struct view *view = ssd->view;
+	const char *title = view_get_title(view);
+	if (string_null_or_empty(title)) {
 		return;
 	}
 
-	struct view *view = ssd->view;
-	char *title = (char *)view_get_string_prop(view, "title");
-	if (string_null_or_empty(title)) {
+	struct ssd_state_title *state = &ssd->state.title;
+	if (!ssd_view_is_shown(ssd)) {
+		/* Rendered by ssd_update_visibility() once shown */
+		state->active.stale = true;
+		state->inactive.stale = true;
 		return;
 	}
 
 	struct theme *theme = view->server->theme;
-	struct ssd_state_title *state = &ssd->state.title;
-	bool title_unchanged = state->text && !strcmp(title, state->text);
+	/* Both are interned, see view_get_title() */
+	bool title_unchanged = title == state->text;
 
 	const float *text_color;
 	const float *bg_color;
@@ -366,16 +352,26 @@ ssd_update_title(struct ssd *ssd)
 			continue;
 		}
 
-		if (title_unchanged
+		if (title_unchanged && !dstate->stale
 				&& !dstate->truncated && dstate->width < title_bg_width) {
 			/* title the same + we don't need to resize title */
 			continue;
 		}
 
-		part = ssd_get_part(&subtree->parts, LAB_SSD_PART_TITLE);
+		/*
+		 * Only the state currently shown is rendered, the other
+		 * one is brought up to date by ssd_set_active() once shown.
+		 */
+		if (!subtree->tree->node.enabled && !prewarm) {
+			dstate->stale = true;
+			continue;
+		}
+		dstate->stale = false;
+
+		part = ssd_get_part(subtree, LAB_SSD_PART_TITLE);
 		if (!part) {
 			/* Initialize part and wlr_scene_buffer without attaching a buffer */
-			part = add_scene_part(&subtree->parts, LAB_SSD_PART_TITLE);
+			part = add_scene_part(subtree, LAB_SSD_PART_TITLE);
 			part->buffer = scaled_font_buffer_create(subtree->tree);
 			if (part->buffer) {
 				part->node = &part->buffer->scene_buffer->node;
@@ -397,14 +393,62 @@ ssd_update_title(struct ssd *ssd)
 	} FOR_EACH_END
 
 	if (!title_unchanged) {
-		if (state->text) {
-			free(state->text);
-		}
-		state->text = xstrdup(title);
+		intern_unref(state->text);
+		state->text = intern_ref(title);
 	}
 	ssd_update_title_positions(ssd);
 }
 
+void
+ssd_titlebar_release(struct ssd *ssd)
+{
+	struct ssd_sub_tree *subtree;
+	FOR_EACH_STATE(ssd, subtree) {
+		struct ssd_part *part = ssd_get_part(subtree, LAB_SSD_PART_TITLE);
+		if (part) {
+			ssd_destroy_part(subtree, part);
+		}
+	} FOR_EACH_END
+
+	struct ssd_state_title *state = &ssd->state.title;
+	intern_unref(state->text);
+	state->text = NULL;
+	state->active = (struct ssd_state_title_width){ .stale = true };
+	state->inactive = (struct ssd_state_title_width){ .stale = true };
+}
+
+void
+ssd_update_title(struct ssd *ssd)
+{
+	if (!ssd) {
+		return;
+	}
+	int64_t profile_start = profile_begin();
+	update_title(ssd, /* prewarm */ false);
+	profile_end(PROFILE_SSD_UPDATE_TITLE, profile_start);
+}
+
+static void
+handle_prewarm_idle(void *data)
+{
+	struct ssd *ssd = data;
+	ssd->prewarm_idle = NULL;
+	if (ssd->state.title.active.stale) {
+		update_title(ssd, /* prewarm */ true);
+	}
+}
+
+void
+ssd_prewarm_title(struct ssd *ssd)
+{
+	if (!ssd || ssd->prewarm_idle || !ssd->state.title.active.stale
+			|| !ssd_view_is_shown(ssd)) {
+		return;
+	}
+	ssd->prewarm_idle = wl_event_loop_add_idle(
+		ssd->view->server->wl_event_loop, handle_prewarm_idle, ssd);
+}
+
 static void
 ssd_button_set_hover(struct ssd_button *button, bool enabled)
 {
@@ -2,6 +2,16 @@
 
 #include "labwc.h"
 #include "view.h"
+#include "window-rules.h"
+
+/*
+ * With <allowTearing>auto</allowTearing> tearing is enabled for a
+ * fullscreen view once at least this many of the last
+ * FRAME_STATS_NR_RECENT frames of its output missed their vblank.
+ * It then stays enabled for as long as the view is fullscreen on that
+ * output, since tearing itself makes the missed vblanks go away.
+ */
+#define TEARING_AUTO_MISSED_VBLANKS (8)
 
 struct tearing_controller {
 		struct wlr_tearing_control_v1 *tearing_control;
@@ -48,3 +58,86 @@ new_tearing_hint(struct wl_listener *listener, void *data)
 	controller->destroy.notify = tearing_controller_destroy;
 	wl_signal_add(&tearing_control->events.destroy, &controller->destroy);
 }
+
+static struct view *
+get_tearing_candidate(struct output *output)
+{
+	struct view *view = output_get_fullscreen_view(output);
+	if (view) {
+		return view;
+	}
+	view = output->server->active_view;
+	return view && view->output == output ? view : NULL;
+}
+
+static bool
+misses_vblanks(struct output *output, struct view *view)
+{
+	struct frame_stats *stats = &output->frame_stats;
+
+	if (output->tearing.view != view) {
+		/* Only judge frames shown since the view became fullscreen */
+		output->tearing.view = view;
+		output->tearing.start_frame = stats->nr_frames;
+		output->tearing.enabled = false;
+	}
+	if (output->tearing.enabled) {
+		return true;
+	}
+	if (stats->nr_frames - output->tearing.start_frame < FRAME_STATS_NR_RECENT
+			|| stats->nr_recent_missed < TEARING_AUTO_MISSED_VBLANKS) {
+		return false;
+	}
+
+	wlr_log(WLR_INFO, "allow tearing on %s: %d of the last %d frames "
+		"missed their vblank", output->wlr_output->name,
+		stats->nr_recent_missed, FRAME_STATS_NR_RECENT);
+	output->tearing.enabled = true;
+	return true;
+}
+
+bool
+tearing_allowed(struct output *output)
+{
+	/* Never allow tearing when disabled */
+	if (rc.allow_tearing == LAB_TEARING_DISABLED) {
+		return false;
+	}
+
+	struct view *view = get_tearing_candidate(output);
+	if (!view) {
+		output->tearing.view = NULL;
+		return false;
+	}
+
+	switch (window_rules_get_property(view, LAB_RULE_PROP_ALLOW_TEARING)) {
+	case LAB_PROP_TRUE:
+		return true;
+	case LAB_PROP_FALSE:
+		return false;
+	default:
+		break;
+	}
+
+	/* If the view requests tearing, or it is toggled on with action, allow it */
+	if (view->tearing_hint) {
+		return true;
+	}
+
+	if (rc.allow_tearing != LAB_TEARING_AUTO || !view->fullscreen) {
+		output->tearing.view = NULL;
+		return false;
+	}
+
+	/* Games want low latency, videos a steady picture */
+	switch (view_get_content_type(view)) {
+	case WP_CONTENT_TYPE_V1_TYPE_GAME:
+		return true;
+	case WP_CONTENT_TYPE_V1_TYPE_VIDEO:
+		output->tearing.view = NULL;
+		return false;
+	default:
+		break;
+	}
+	return misses_vblanks(output, view);
+}
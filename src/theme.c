@@ -12,6 +12,7 @@
 #include <drm_fourcc.h>
 #include <glib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -21,13 +22,17 @@
 #include "common/macros.h"
 #include "common/dir.h"
 #include "common/font.h"
+#include "common/grab-file.h"
 #include "common/graphic-helpers.h"
 #include "common/match.h"
 #include "common/mem.h"
 #include "common/parse-bool.h"
+#include "common/scaled_scene_buffer.h"
 #include "common/string-helpers.h"
 #include "config/rcxml.h"
+#include "button/button-cache.h"
 #include "button/button-png.h"
+#include "button/common.h"
 
 #if HAVE_RSVG
 #include "button/button-svg.h"
@@ -63,13 +68,14 @@ struct rounded_corner_ctx {
 	enum corner corner;
 };
 
-static struct lab_data_buffer *rounded_rect(struct rounded_corner_ctx *ctx);
+static struct lab_data_buffer *rounded_rect(struct rounded_corner_ctx *ctx,
+	double scale);
 
 static void
 zdrop(struct lab_data_buffer **buffer)
 {
 	if (*buffer) {
-		wlr_buffer_drop(&(*buffer)->base);
+		buffer_intern_drop(*buffer);
 		*buffer = NULL;
 	}
 }
@@ -141,9 +147,12 @@ create_hover_fallback(struct theme *theme, const char *icon_name,
 	enum corner corner = corner_from_icon_name(icon_name);
 
 	if (corner == LAB_CORNER_UNKNOWN) {
-		set_cairo_color(cairo, overlay_color);
-		cairo_rectangle(cairo, 0, 0, width, height);
-		cairo_fill(cairo);
+		cairo_surface_flush(surf);
+		pixels_blend_color(
+			(uint32_t *)cairo_image_surface_get_data(surf),
+			width, height, cairo_image_surface_get_stride(surf),
+			overlay_color);
+		cairo_surface_mark_dirty(surf);
 	} else {
 		struct rounded_corner_ctx rounded_ctx = {
 			.box = &(struct wlr_box) { .width = width, .height = height },
@@ -153,7 +162,8 @@ create_hover_fallback(struct theme *theme, const char *icon_name,
 			.border_color = overlay_color,
 			.corner = corner
 		};
-		struct lab_data_buffer *overlay_buffer = rounded_rect(&rounded_ctx);
+		struct lab_data_buffer *overlay_buffer =
+			rounded_rect(&rounded_ctx, 1.0);
 		cairo_set_source_surface(cairo,
 			cairo_get_target(overlay_buffer->cairo), 0, 0);
 		cairo_paint(cairo);
@@ -166,6 +176,42 @@ create_hover_fallback(struct theme *theme, const char *icon_name,
 	}
 }
 
+/* Keep in sync with load_buttons() */
+static const char *const button_names[] = {
+	"menu", "iconify", "max", "max_toggled", "close",
+	"menu_hover", "iconify_hover", "max_hover",
+	"max_toggled_hover", "max_hover_toggled", "close_hover",
+};
+
+/*
+ * Decode all png and svg button images load_buttons() might use with a
+ * pool of worker threads, so that it then finds them in the button cache.
+ */
+static void
+preload_buttons(struct theme *theme)
+{
+	static const char *const suffixes[] = {
+		"-active.png", "-inactive.png", "-active.svg", "-inactive.svg",
+	};
+	int svg_size = theme->title_height - 2 * theme->padding_height;
+
+	char name[64];
+	char filename[4096];
+	for (size_t i = 0; i < ARRAY_SIZE(button_names); i++) {
+		for (size_t j = 0; j < ARRAY_SIZE(suffixes); j++) {
+			snprintf(name, sizeof(name), "%s%s", button_names[i],
+				suffixes[j]);
+			filename[0] = '\0';
+			button_filename(name, filename, sizeof(filename));
+			if (filename[0]) {
+				button_cache_preload(filename,
+					strstr(suffixes[j], ".svg") ? svg_size : 0);
+			}
+		}
+	}
+	button_cache_preload_finish();
+}
+
 /*
  * We use the following button filename schema: "BUTTON [TOGGLED] [STATE]"
  * with the words separated by underscore, and the following meaning:
@@ -272,6 +318,8 @@ load_buttons(struct theme *theme)
 		.inactive.rgba = theme->window_inactive_button_close_unpressed_image_color,
 	}, };
 
+	preload_buttons(theme);
+
 	char filename[4096] = {0};
 	for (size_t i = 0; i < ARRAY_SIZE(buttons); ++i) {
 		struct button *b = &buttons[i];
@@ -374,6 +422,16 @@ load_buttons(struct theme *theme)
 			}
 		}
 	}
+
+	/* Let identical buttons share one buffer */
+	for (size_t i = 0; i < ARRAY_SIZE(buttons); i++) {
+		buffer_set_category(*buttons[i].active.buffer, LAB_BUFFER_BUTTON);
+		buffer_set_category(*buttons[i].inactive.buffer,
+			LAB_BUFFER_BUTTON);
+		*buttons[i].active.buffer = buffer_intern(*buttons[i].active.buffer);
+		*buttons[i].inactive.buffer =
+			buffer_intern(*buttons[i].inactive.buffer);
+	}
 }
 
 static int
@@ -803,8 +861,87 @@ process_line(struct theme *theme, char *line)
 	entry(theme, key, value);
 }
 
+/* FNV-1a */
+#define THEME_HASH_INIT (14695981039346656037ull)
+
+static uint64_t
+hash_bytes(uint64_t hash, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+	for (size_t i = 0; i < len; i++) {
+		hash ^= p[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+static uint64_t
+hash_string(uint64_t hash, const char *str)
+{
+	if (!str) {
+		str = "";
+	}
+	/* Include the terminator so that "ab" + "c" differs from "a" + "bc" */
+	return hash_bytes(hash, str, strlen(str) + 1);
+}
+
+static uint64_t
+hash_font(uint64_t hash, struct font *font)
+{
+	hash = hash_string(hash, font->name);
+	hash = hash_bytes(hash, &font->size, sizeof(font->size));
+	hash = hash_bytes(hash, &font->slant, sizeof(font->slant));
+	return hash_bytes(hash, &font->weight, sizeof(font->weight));
+}
+
+static uint64_t
+hash_file(uint64_t hash, const char *filename)
+{
+	FILE *stream = fopen(filename, "r");
+	if (!stream) {
+		return hash;
+	}
+	hash = hash_string(hash, filename);
+	char data[4096];
+	size_t len;
+	while ((len = fread(data, 1, sizeof(data), stream)) > 0) {
+		hash = hash_bytes(hash, data, len);
+	}
+	fclose(stream);
+	return hash;
+}
+
+/*
+ * Hash the content of all button images which load_buttons() might pick
+ * up, so that changed images are noticed without decoding them.
+ */
+static uint64_t
+hash_button_files(uint64_t hash)
+{
+	static const char *const suffixes[] = {
+		"-active.png", "-inactive.png",
+		"-active.svg", "-inactive.svg",
+		".xbm",
+	};
+
+	char name[64];
+	char filename[4096];
+	for (size_t i = 0; i < ARRAY_SIZE(button_names); i++) {
+		for (size_t j = 0; j < ARRAY_SIZE(suffixes); j++) {
+			snprintf(name, sizeof(name), "%s%s", button_names[i],
+				suffixes[j]);
+			filename[0] = '\0';
+			button_filename(name, filename, sizeof(filename));
+			if (filename[0]) {
+				hash = hash_file(hash, filename);
+			}
+		}
+	}
+	return hash;
+}
+
 static void
-theme_read(struct theme *theme, struct wl_list *paths)
+theme_read(struct theme *theme, struct wl_list *paths, uint64_t *hash)
 {
 	bool should_merge_config = rc.merge_config;
 	struct wl_list *(*iter)(struct wl_list *list);
@@ -812,24 +949,20 @@ theme_read(struct theme *theme, struct wl_list *paths)
 
 	for (struct wl_list *elm = iter(paths); elm != paths; elm = iter(elm)) {
 		struct path *path = wl_container_of(elm, path, link);
-		FILE *stream = fopen(path->string, "r");
-		if (!stream) {
+		struct file_view view;
+		if (!file_view_open(&view, path->string)) {
 			continue;
 		}
 
 		wlr_log(WLR_INFO, "read theme %s", path->string);
+		*hash = hash_string(*hash, path->string);
 
-		char *line = NULL;
-		size_t len = 0;
-		while (getline(&line, &len, stream) != -1) {
-			char *p = strrchr(line, '\n');
-			if (p) {
-				*p = '\0';
-			}
+		char *line;
+		while ((line = file_view_next_line(&view))) {
+			*hash = hash_string(*hash, line);
 			process_line(theme, line);
 		}
-		zfree(line);
-		fclose(stream);
+		file_view_close(&view);
 		if (!should_merge_config) {
 			break;
 		}
@@ -837,7 +970,7 @@ theme_read(struct theme *theme, struct wl_list *paths)
 }
 
 static struct lab_data_buffer *
-rounded_rect(struct rounded_corner_ctx *ctx)
+rounded_rect(struct rounded_corner_ctx *ctx, double scale)
 {
 	/* 1 degree in radians (=2π/360) */
 	double deg = 0.017453292519943295;
@@ -851,8 +984,7 @@ rounded_rect(struct rounded_corner_ctx *ctx)
 	double r = ctx->radius;
 
 	struct lab_data_buffer *buffer;
-	/* TODO: scale */
-	buffer = buffer_create_cairo(w, h, 1, /*free_on_destroy*/ true);
+	buffer = buffer_create_cairo(w, h, scale, /*free_on_destroy*/ true);
 
 	cairo_t *cairo = buffer->cairo;
 	cairo_surface_t *surf = cairo_get_target(cairo);
@@ -1001,38 +1133,103 @@ out:
 	return buffer;
 }
 
-static void
-create_corners(struct theme *theme)
+/*
+ * The rounded corners of the titlebar are rendered on demand for each
+ * output scale and shared by all windows. The theme keeps every buffer
+ * it rendered, so each combination of corner, window state and scale is
+ * drawn once until theme_finish(). Radius, border width and colors
+ * are the same for all entries because they come from the theme.
+ */
+struct corner_buffer {
+	enum corner corner;
+	bool active;
+	double scale;
+	struct lab_data_buffer *buffer;
+	struct wl_list link; /* theme.corner_buffers */
+};
+
+struct corner_ctx {
+	struct theme *theme;
+	enum corner corner;
+	bool active;
+};
+
+static struct lab_data_buffer *
+corner_buffer_get(struct theme *theme, enum corner corner, bool active,
+		double scale)
 {
+	struct corner_buffer *entry;
+	wl_list_for_each(entry, &theme->corner_buffers, link) {
+		if (entry->corner == corner && entry->active == active
+				&& entry->scale == scale) {
+			return entry->buffer;
+		}
+	}
+
 	struct wlr_box box = {
-		.x = 0,
-		.y = 0,
 		.width = SSD_BUTTON_WIDTH + theme->border_width,
 		.height = theme->title_height + theme->border_width,
 	};
-
 	struct rounded_corner_ctx ctx = {
 		.box = &box,
 		.radius = rc.corner_radius,
 		.line_width = theme->border_width,
-		.fill_color = theme->window_active_title_bg_color,
-		.border_color = theme->window_active_border_color,
-		.corner = LAB_CORNER_TOP_LEFT,
+		.fill_color = active ? theme->window_active_title_bg_color
+			: theme->window_inactive_title_bg_color,
+		.border_color = active ? theme->window_active_border_color
+			: theme->window_inactive_border_color,
+		.corner = corner,
 	};
-	theme->corner_top_left_active_normal = rounded_rect(&ctx);
+	struct lab_data_buffer *buffer = rounded_rect(&ctx, scale);
+	if (!buffer) {
+		return NULL;
+	}
+	buffer_set_category(buffer, LAB_BUFFER_CORNER);
 
-	ctx.fill_color = theme->window_inactive_title_bg_color,
-	ctx.border_color = theme->window_inactive_border_color,
-	theme->corner_top_left_inactive_normal = rounded_rect(&ctx);
+	entry = znew(*entry);
+	entry->corner = corner;
+	entry->active = active;
+	entry->scale = scale;
+	entry->buffer = buffer;
+	wl_list_insert(&theme->corner_buffers, &entry->link);
+	return buffer;
+}
 
-	ctx.corner = LAB_CORNER_TOP_RIGHT;
-	ctx.fill_color = theme->window_active_title_bg_color,
-	ctx.border_color = theme->window_active_border_color,
-	theme->corner_top_right_active_normal = rounded_rect(&ctx);
+static struct lab_data_buffer *
+corner_create_buffer(struct scaled_scene_buffer *scaled_buffer, double scale)
+{
+	struct corner_ctx *ctx = scaled_buffer->data;
+	return corner_buffer_get(ctx->theme, ctx->corner, ctx->active, scale);
+}
 
-	ctx.fill_color = theme->window_inactive_title_bg_color,
-	ctx.border_color = theme->window_inactive_border_color,
-	theme->corner_top_right_inactive_normal = rounded_rect(&ctx);
+static void
+corner_destroy(struct scaled_scene_buffer *scaled_buffer)
+{
+	zfree(scaled_buffer->data);
+}
+
+static const struct scaled_scene_buffer_impl corner_impl = {
+	.create_buffer = corner_create_buffer,
+	.destroy = corner_destroy,
+};
+
+struct scaled_scene_buffer *
+theme_corner_create(struct wlr_scene_tree *parent, struct theme *theme,
+		bool right, bool active)
+{
+	/* The buffers are owned by the theme and must not be dropped */
+	struct scaled_scene_buffer *scaled_buffer = scaled_scene_buffer_create(
+		parent, &corner_impl, /* drop_buffer */ false);
+	if (!scaled_buffer) {
+		return NULL;
+	}
+	struct corner_ctx *ctx = znew(*ctx);
+	ctx->theme = theme;
+	ctx->corner = right ? LAB_CORNER_TOP_RIGHT : LAB_CORNER_TOP_LEFT;
+	ctx->active = active;
+	scaled_buffer->data = ctx;
+	scaled_scene_buffer_invalidate_cache(scaled_buffer);
+	return scaled_buffer;
 }
 
 static void
@@ -1131,36 +1328,76 @@ post_processing(struct theme *theme)
 	}
 }
 
-void
-theme_init(struct theme *theme, const char *theme_name)
+/*
+ * Read the theme values and return a hash of everything the textures and
+ * server side decorations are derived from.
+ */
+static uint64_t
+theme_read_values(struct theme *theme, const char *theme_name)
 {
+	uint64_t hash = hash_string(THEME_HASH_INIT, theme_name);
+
 	/*
 	 * Set some default values. This is particularly important on
 	 * reconfigure as not all themes set all options
 	 */
 	theme_builtin(theme);
 
+	/* Pick up buttons added or removed since the last (re-)load */
+	button_filename_revalidate();
+
 	/* Read <data-dir>/share/themes/$theme_name/openbox-3/themerc */
 	struct wl_list paths;
 	paths_theme_create(&paths, theme_name, "themerc");
-	theme_read(theme, &paths);
+	theme_read(theme, &paths, &hash);
 	paths_destroy(&paths);
 
 	/* Read <config-dir>/labwc/themerc-override */
 	paths_config_create(&paths, "themerc-override");
-	theme_read(theme, &paths);
+	theme_read(theme, &paths, &hash);
 	paths_destroy(&paths);
 
+	/* rc.xml values used by post_processing() and the decorations */
+	hash = hash_bytes(hash, &rc.corner_radius, sizeof(rc.corner_radius));
+	hash = hash_font(hash, &rc.font_activewindow);
+	hash = hash_font(hash, &rc.font_inactivewindow);
+
 	post_processing(theme);
-	create_corners(theme);
+
+	return hash_button_files(hash);
+}
+
+void
+theme_init(struct theme *theme, const char *theme_name)
+{
+	wl_list_init(&theme->corner_buffers);
+	theme->input_hash = theme_read_values(theme, theme_name);
 	load_buttons(theme);
 }
 
+bool
+theme_reload(struct theme *theme, const char *theme_name)
+{
+	uint64_t hash = theme_read_values(theme, theme_name);
+	if (hash == theme->input_hash) {
+		wlr_log(WLR_DEBUG, "theme unchanged, keeping textures");
+		return false;
+	}
+
+	theme->input_hash = hash;
+	theme_finish(theme);
+	load_buttons(theme);
+	return true;
+}
+
 void
 theme_finish(struct theme *theme)
 {
-	zdrop(&theme->corner_top_left_active_normal);
-	zdrop(&theme->corner_top_left_inactive_normal);
-	zdrop(&theme->corner_top_right_active_normal);
-	zdrop(&theme->corner_top_right_inactive_normal);
+	/* Windows still showing a corner keep it alive until they let go */
+	struct corner_buffer *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &theme->corner_buffers, link) {
+		zdrop(&entry->buffer);
+		wl_list_remove(&entry->link);
+		free(entry);
+	}
 }
@@ -0,0 +1,299 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#include <assert.h>
+#include <drm_fourcc.h>
+#include <stdint.h>
+#include <wlr/render/allocator.h>
+#include <wlr/render/drm_format_set.h>
+#include <wlr/render/pass.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/util/log.h>
+#include "common/macros.h"
+#include "common/mem.h"
+#include "labwc.h"
+#include "thumbnail.h"
+#include "view.h"
+
+/*
+ * Upper bound of the pixels kept for all snapshots together, leaving
+ * room for a full size switcher preview next to the small ones
+ */
+#define THUMBNAIL_BUDGET_BYTES (64 * 1024 * 1024)
+
+/* Snapshots are only sampled by the renderer, any modifier will do */
+static struct wlr_drm_format_set formats;
+
+/*
+ * The switcher rows, the overview and the switcher preview ask for
+ * different sizes, so a few are kept per view instead of replacing each
+ * other on every request.
+ */
+#define THUMBNAIL_SIZES_PER_VIEW 2
+
+struct snapshot {
+	struct wlr_buffer *buffer;
+	int max_width;
+	int max_height;
+	size_t bytes;
+	bool damaged;
+	uint64_t last_used;
+};
+
+struct thumbnail {
+	struct view *view;
+	struct snapshot snapshots[THUMBNAIL_SIZES_PER_VIEW];
+	struct wl_list link; /* server.thumbnails.lru, most recent first */
+	struct wl_listener surface_commit;
+};
+
+/* Orders the snapshots of a view by use */
+static uint64_t use_counter;
+
+static void
+drop_buffer(struct server *server, struct snapshot *snapshot)
+{
+	if (!snapshot->buffer) {
+		return;
+	}
+	/* The OSD may still show the buffer, it keeps its own lock */
+	wlr_buffer_drop(snapshot->buffer);
+	snapshot->buffer = NULL;
+	server->thumbnails.bytes -= snapshot->bytes;
+	snapshot->bytes = 0;
+}
+
+static void
+drop_buffers(struct thumbnail *thumbnail)
+{
+	for (int i = 0; i < THUMBNAIL_SIZES_PER_VIEW; i++) {
+		drop_buffer(thumbnail->view->server, &thumbnail->snapshots[i]);
+	}
+}
+
+static void
+evict(struct server *server, struct thumbnail *keep)
+{
+	struct thumbnail *thumbnail, *tmp;
+	wl_list_for_each_reverse_safe(thumbnail, tmp, &server->thumbnails.lru,
+			link) {
+		if (server->thumbnails.bytes <= THUMBNAIL_BUDGET_BYTES) {
+			return;
+		}
+		if (thumbnail != keep) {
+			drop_buffers(thumbnail);
+		}
+	}
+}
+
+static void
+handle_surface_commit(struct wl_listener *listener, void *data)
+{
+	struct thumbnail *thumbnail =
+		wl_container_of(listener, thumbnail, surface_commit);
+	for (int i = 0; i < THUMBNAIL_SIZES_PER_VIEW; i++) {
+		thumbnail->snapshots[i].damaged = true;
+	}
+}
+
+struct render_context {
+	struct wlr_render_pass *pass;
+	double scale;
+};
+
+static void
+render_surface(struct wlr_surface *surface, int sx, int sy, void *data)
+{
+	struct render_context *ctx = data;
+	struct wlr_texture *texture = wlr_surface_get_texture(surface);
+	if (!texture) {
+		return;
+	}
+	wlr_render_pass_add_texture(ctx->pass, &(struct wlr_render_texture_options){
+		.texture = texture,
+		.dst_box = {
+			.x = sx * ctx->scale,
+			.y = sy * ctx->scale,
+			.width = surface->current.width * ctx->scale,
+			.height = surface->current.height * ctx->scale,
+		},
+		.filter_mode = WLR_SCALE_FILTER_BILINEAR,
+	});
+}
+
+static struct wlr_buffer *
+render(struct server *server, struct wlr_surface *surface, int max_width,
+		int max_height)
+{
+	int surface_width = surface->current.width;
+	int surface_height = surface->current.height;
+	if (surface_width <= 0 || surface_height <= 0) {
+		return NULL;
+	}
+	double scale = MIN((double)max_width / surface_width,
+		(double)max_height / surface_height);
+	int width = MAX(1, surface_width * scale);
+	int height = MAX(1, surface_height * scale);
+
+	const struct wlr_drm_format *format =
+		wlr_drm_format_set_get(&formats, DRM_FORMAT_ARGB8888);
+	if (!format) {
+		return NULL;
+	}
+	struct wlr_buffer *buffer = wlr_allocator_create_buffer(
+		server->allocator, width, height, format);
+	if (!buffer) {
+		return NULL;
+	}
+
+	struct wlr_render_pass *pass =
+		wlr_renderer_begin_buffer_pass(server->renderer, buffer, NULL);
+	if (!pass) {
+		wlr_buffer_drop(buffer);
+		return NULL;
+	}
+	wlr_render_pass_add_rect(pass, &(struct wlr_render_rect_options){
+		.box = { .width = width, .height = height },
+		.blend_mode = WLR_RENDER_BLEND_MODE_NONE,
+	});
+	struct render_context ctx = { .pass = pass, .scale = scale };
+	wlr_surface_for_each_surface(surface, render_surface, &ctx);
+	if (!wlr_render_pass_submit(pass)) {
+		wlr_buffer_drop(buffer);
+		return NULL;
+	}
+	return buffer;
+}
+
+static struct thumbnail *
+thumbnail_create(struct view *view)
+{
+	struct thumbnail *thumbnail = znew(*thumbnail);
+	thumbnail->view = view;
+	wl_list_insert(&view->server->thumbnails.lru, &thumbnail->link);
+	thumbnail->surface_commit.notify = handle_surface_commit;
+	wl_signal_add(&view->surface->events.commit, &thumbnail->surface_commit);
+	view->thumbnail = thumbnail;
+	return thumbnail;
+}
+
+/* Returns the snapshot rendered for the given size, NULL if none */
+static struct snapshot *
+find_snapshot(struct thumbnail *thumbnail, int max_width, int max_height)
+{
+	for (int i = 0; i < THUMBNAIL_SIZES_PER_VIEW; i++) {
+		struct snapshot *snapshot = &thumbnail->snapshots[i];
+		if (snapshot->buffer && snapshot->max_width == max_width
+				&& snapshot->max_height == max_height) {
+			return snapshot;
+		}
+	}
+	return NULL;
+}
+
+/* Returns the snapshot to render the given size into */
+static struct snapshot *
+reuse_snapshot(struct thumbnail *thumbnail, int max_width, int max_height)
+{
+	struct snapshot *snapshot =
+		find_snapshot(thumbnail, max_width, max_height);
+	if (snapshot) {
+		return snapshot;
+	}
+	/* The least recently used one */
+	snapshot = &thumbnail->snapshots[0];
+	for (int i = 1; i < THUMBNAIL_SIZES_PER_VIEW; i++) {
+		if (thumbnail->snapshots[i].last_used < snapshot->last_used) {
+			snapshot = &thumbnail->snapshots[i];
+		}
+	}
+	return snapshot;
+}
+
+bool
+thumbnail_is_current(struct view *view, int max_width, int max_height)
+{
+	struct thumbnail *thumbnail = view->thumbnail;
+	if (!thumbnail) {
+		return false;
+	}
+	struct snapshot *snapshot =
+		find_snapshot(thumbnail, max_width, max_height);
+	return snapshot && !snapshot->damaged;
+}
+
+struct wlr_buffer *
+thumbnail_get(struct view *view, int max_width, int max_height, int *budget)
+{
+	assert(budget);
+	if (!view->mapped || !view->surface) {
+		return NULL;
+	}
+	struct thumbnail *thumbnail = view->thumbnail;
+	if (!thumbnail) {
+		thumbnail = thumbnail_create(view);
+	}
+	struct server *server = view->server;
+	wl_list_remove(&thumbnail->link);
+	wl_list_insert(&server->thumbnails.lru, &thumbnail->link);
+
+	struct snapshot *snapshot =
+		reuse_snapshot(thumbnail, max_width, max_height);
+	snapshot->last_used = ++use_counter;
+	bool same_size = snapshot->max_width == max_width
+		&& snapshot->max_height == max_height;
+	if ((same_size && snapshot->buffer && !snapshot->damaged)
+			|| *budget <= 0) {
+		/* A snapshot of another size is of no use to the caller */
+		return same_size ? snapshot->buffer : NULL;
+	}
+	(*budget)--;
+
+	struct wlr_buffer *buffer = render(server, view->surface, max_width,
+		max_height);
+	if (!buffer) {
+		return same_size ? snapshot->buffer : NULL;
+	}
+	drop_buffer(server, snapshot);
+	snapshot->buffer = buffer;
+	snapshot->max_width = max_width;
+	snapshot->max_height = max_height;
+	snapshot->damaged = false;
+	snapshot->bytes = (size_t)buffer->width * buffer->height * 4;
+	server->thumbnails.bytes += snapshot->bytes;
+	evict(server, thumbnail);
+	return buffer;
+}
+
+void
+thumbnail_init(struct server *server)
+{
+	wl_list_init(&server->thumbnails.lru);
+	server->thumbnails.bytes = 0;
+	wlr_drm_format_set_add(&formats, DRM_FORMAT_ARGB8888,
+		DRM_FORMAT_MOD_INVALID);
+}
+
+void
+thumbnail_finish(struct server *server)
+{
+	struct thumbnail *thumbnail, *tmp;
+	wl_list_for_each_safe(thumbnail, tmp, &server->thumbnails.lru, link) {
+		thumbnail_on_view_unmap(thumbnail->view);
+	}
+	wlr_drm_format_set_finish(&formats);
+}
+
+void
+thumbnail_on_view_unmap(struct view *view)
+{
+	struct thumbnail *thumbnail = view->thumbnail;
+	if (!thumbnail) {
+		return;
+	}
+	drop_buffers(thumbnail);
+	wl_list_remove(&thumbnail->link);
+	wl_list_remove(&thumbnail->surface_commit.link);
+	view->thumbnail = NULL;
+	free(thumbnail);
+}
@@ -0,0 +1,234 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <wlr/util/box.h>
+#include "common/mem.h"
+#include "config/rcxml.h"
+#include "labwc.h"
+#include "session-state.h"
+#include "tiling.h"
+#include "view.h"
+#include "window-rules.h"
+#include "workspaces.h"
+
+/* Order in which views joined a layout, the newest one is the master */
+static uint64_t next_seq = 1;
+
+enum tiling_layout
+tiling_layout_parse(const char *name)
+{
+	if (!name) {
+		return TILING_LAYOUT_INVALID;
+	}
+	if (!strcasecmp(name, "none")) {
+		return TILING_LAYOUT_NONE;
+	} else if (!strcasecmp(name, "masterStack")) {
+		return TILING_LAYOUT_MASTER_STACK;
+	} else if (!strcasecmp(name, "grid")) {
+		return TILING_LAYOUT_GRID;
+	}
+	return TILING_LAYOUT_INVALID;
+}
+
+static bool
+is_tileable(struct view *view)
+{
+	return view->mapped && !view->minimized && !view->fullscreen
+		&& view->maximized == VIEW_AXIS_NONE
+		&& view->tiled == VIEW_EDGE_INVALID
+		&& !view->tiled_region && !view->tiled_region_evacuate
+		&& view_get_root(view) == view
+		&& output_is_usable(view->output)
+		&& window_rules_get_property(view,
+			LAB_RULE_PROP_FIXED_POSITION) != LAB_PROP_TRUE;
+}
+
+static int
+compare_seq(const void *a, const void *b)
+{
+	const struct view *view_a = *(struct view *const *)a;
+	const struct view *view_b = *(struct view *const *)b;
+	/* Descending */
+	return (view_a->tiling.seq < view_b->tiling.seq)
+		- (view_a->tiling.seq > view_b->tiling.seq);
+}
+
+/*
+ * Splits @area into @n boxes, side by side or on top of each other.
+ * The edges of the first and last box stay exactly on those of @area,
+ * which is what view_get_tile_geometry() checks to apply the outer gap.
+ */
+static void
+split(struct wlr_box area, bool vertical, struct wlr_box *boxes, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		boxes[i] = area;
+		if (vertical) {
+			int y0 = area.y + (int)(area.height * i / n);
+			int y1 = area.y + (int)(area.height * (i + 1) / n);
+			boxes[i].y = y0;
+			boxes[i].height = y1 - y0;
+		} else {
+			int x0 = area.x + (int)(area.width * i / n);
+			int x1 = area.x + (int)(area.width * (i + 1) / n);
+			boxes[i].x = x0;
+			boxes[i].width = x1 - x0;
+		}
+	}
+}
+
+static void
+layout_master_stack(struct wlr_box area, struct wlr_box *boxes, size_t n)
+{
+	if (n == 1) {
+		boxes[0] = area;
+		return;
+	}
+	int master_width = area.width * rc.tiling_master_ratio / 100;
+	boxes[0] = area;
+	boxes[0].width = master_width;
+
+	struct wlr_box stack = area;
+	stack.x += master_width;
+	stack.width -= master_width;
+	split(stack, /* vertical */ true, boxes + 1, n - 1);
+}
+
+static void
+layout_grid(struct wlr_box area, struct wlr_box *boxes, size_t n)
+{
+	size_t cols = 1;
+	while (cols * cols < n) {
+		cols++;
+	}
+	size_t nr_rows = (n + cols - 1) / cols;
+	struct wlr_box *rows = znew_n(struct wlr_box, nr_rows);
+	split(area, /* vertical */ true, rows, nr_rows);
+
+	/* The last row may be shorter, its windows get wider instead */
+	for (size_t r = 0; r < nr_rows; r++) {
+		size_t nr_cols = r == nr_rows - 1 ? n - cols * r : cols;
+		split(rows[r], /* vertical */ false, boxes + cols * r, nr_cols);
+	}
+	free(rows);
+}
+
+static void
+arrange(struct workspace *workspace, struct output *output)
+{
+	struct server *server = workspace->server;
+
+	struct wl_array tiles;
+	wl_array_init(&tiles);
+	struct view *view;
+	wl_list_for_each(view, &server->views, link) {
+		if (view->workspace != workspace || view->output != output
+				|| !is_tileable(view)) {
+			continue;
+		}
+		if (!view->tiling.seq) {
+			view->tiling.seq = next_seq++;
+			view->tiling.floating = view->pending;
+		}
+		struct view **tile = wl_array_add(&tiles, sizeof(*tile));
+		*tile = view;
+	}
+
+	size_t n = tiles.size / sizeof(struct view *);
+	if (!n) {
+		wl_array_release(&tiles);
+		return;
+	}
+	struct view **views = tiles.data;
+	qsort(views, n, sizeof(*views), compare_seq);
+
+	struct wlr_box area = output_usable_area_in_layout_coords(output);
+	struct wlr_box *boxes = znew_n(struct wlr_box, n);
+	switch (workspace->tiling_layout) {
+	case TILING_LAYOUT_MASTER_STACK:
+		layout_master_stack(area, boxes, n);
+		break;
+	case TILING_LAYOUT_GRID:
+		layout_grid(area, boxes, n);
+		break;
+	default:
+		assert(false);
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		struct wlr_box geo =
+			view_get_tile_geometry(views[i], output, boxes[i]);
+		if (!wlr_box_empty(&geo) && !wlr_box_equal(&geo,
+				&views[i]->pending)) {
+			view_move_resize(views[i], geo);
+		}
+	}
+	free(boxes);
+	wl_array_release(&tiles);
+}
+
+/* Puts the views of @workspace back where they were before tiling */
+static void
+release(struct workspace *workspace)
+{
+	struct view *view;
+	wl_list_for_each(view, &workspace->server->views, link) {
+		if (view->workspace != workspace || !view->tiling.seq) {
+			continue;
+		}
+		view->tiling.seq = 0;
+		if (wlr_box_empty(&view->tiling.floating)) {
+			continue;
+		}
+		if (view_is_floating(view)) {
+			view_move_resize(view, view->tiling.floating);
+		} else {
+			/* Restored once unmaximized or untiled */
+			view->natural_geometry = view->tiling.floating;
+		}
+	}
+}
+
+void
+tiling_update(struct workspace *workspace)
+{
+	assert(workspace);
+	struct server *server = workspace->server;
+
+	xdg_configure_batch_begin(server);
+	if (workspace->tiling_layout == TILING_LAYOUT_NONE) {
+		release(workspace);
+	} else {
+		struct output *output;
+		wl_list_for_each(output, &server->outputs, link) {
+			if (output_is_usable(output)) {
+				arrange(workspace, output);
+			}
+		}
+	}
+	xdg_configure_batch_end(server);
+}
+
+void
+tiling_update_all(struct server *server)
+{
+	struct workspace *workspace;
+	wl_list_for_each(workspace, &server->workspaces, link) {
+		tiling_update(workspace);
+	}
+}
+
+void
+tiling_set_layout(struct workspace *workspace, enum tiling_layout layout)
+{
+	assert(workspace);
+	assert(layout != TILING_LAYOUT_INVALID);
+	if (workspace->tiling_layout == layout) {
+		return;
+	}
+	workspace->tiling_layout = layout;
+	tiling_update(workspace);
+	session_state_layout_changed();
+}
@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "common/time-helpers.h"
+#include "trace.h"
+
+#define STREAM_BUFFER_SIZE (64 * 1024)
+
+static struct {
+	FILE *stream;
+	int pid;
+	bool first_event;
+} trace;
+
+void
+trace_init(void)
+{
+	const char *path = getenv("LABWC_TRACE_FILE");
+	if (!path || !*path) {
+		return;
+	}
+	trace.stream = fopen(path, "w");
+	if (!trace.stream) {
+		wlr_log(WLR_ERROR, "cannot open trace file %s: %s", path,
+			strerror(errno));
+		return;
+	}
+	/* Events are small and frequent, write them out in large chunks */
+	setvbuf(trace.stream, NULL, _IOFBF, STREAM_BUFFER_SIZE);
+	trace.pid = getpid();
+	trace.first_event = true;
+	fputs("[", trace.stream);
+	wlr_log(WLR_INFO, "writing trace events to %s", path);
+}
+
+void
+trace_finish(void)
+{
+	if (!trace.stream) {
+		return;
+	}
+	fputs("\n]\n", trace.stream);
+	fclose(trace.stream);
+	trace.stream = NULL;
+}
+
+static void
+write_escaped(const char *str)
+{
+	for (const char *p = str; *p; p++) {
+		unsigned char c = *p;
+		if (c == '"' || c == '\\') {
+			fprintf(trace.stream, "\\%c", c);
+		} else if (c < 0x20) {
+			fprintf(trace.stream, "\\u%04x", c);
+		} else {
+			fputc(c, trace.stream);
+		}
+	}
+}
+
+/* @id is only written for async events, which are the only ones using it */
+static void
+write_event(const char *name, char phase, const uint64_t *id,
+		const char *detail)
+{
+	if (!trace.stream) {
+		return;
+	}
+	double ts = (double)time_now_nsec() / 1000.0;
+	fprintf(trace.stream, "%s\n{\"name\":\"%s\",\"cat\":\"labwc\","
+		"\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d",
+		trace.first_event ? "" : ",", name, phase, ts,
+		trace.pid, trace.pid);
+	trace.first_event = false;
+	if (id) {
+		fprintf(trace.stream, ",\"id\":\"0x%llx\"",
+			(unsigned long long)*id);
+	}
+	if (phase == 'i') {
+		/* Instant events span the whole process track */
+		fputs(",\"s\":\"p\"", trace.stream);
+	}
+	if (detail) {
+		fputs(",\"args\":{\"detail\":\"", trace.stream);
+		write_escaped(detail);
+		fputs("\"}", trace.stream);
+	}
+	fputc('}', trace.stream);
+}
+
+void
+trace_begin(const char *name, const char *detail)
+{
+	write_event(name, 'B', NULL, detail);
+}
+
+void
+trace_end(const char *name)
+{
+	write_event(name, 'E', NULL, NULL);
+}
+
+void
+trace_instant(const char *name, const char *detail)
+{
+	write_event(name, 'i', NULL, detail);
+}
+
+void
+trace_async_begin(const char *name, uint64_t id, const char *detail)
+{
+	write_event(name, 'b', &id, detail);
+}
+
+void
+trace_async_end(const char *name, uint64_t id, const char *detail)
+{
+	write_event(name, 'e', &id, detail);
+}
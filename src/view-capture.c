@@ -0,0 +1,195 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <wlr/backend/headless.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/util/log.h>
+#include "common/mem.h"
+#include "labwc.h"
+#include "view.h"
+#include "view-capture.h"
+
+struct view_capture {
+	struct view *view;
+	struct wlr_scene *scene;
+	struct wlr_output *wlr_output;
+	struct wlr_scene_output *scene_output;
+
+	struct wl_listener frame;
+	struct wl_listener output_destroy;
+	struct wl_listener surface_commit;
+};
+
+static void
+capture_destroy(struct view_capture *capture)
+{
+	wl_list_remove(&capture->frame.link);
+	wl_list_remove(&capture->output_destroy.link);
+	wl_list_remove(&capture->surface_commit.link);
+	capture->view->capture = NULL;
+
+	/* Destroys the scene output as well */
+	if (capture->wlr_output) {
+		wlr_output_destroy(capture->wlr_output);
+	}
+	wlr_scene_node_destroy(&capture->scene->tree.node);
+	free(capture);
+}
+
+static void
+handle_frame(struct wl_listener *listener, void *data)
+{
+	struct view_capture *capture = wl_container_of(listener, capture, frame);
+
+	/* Only commits if the mirrored surfaces have been damaged */
+	wlr_scene_output_commit(capture->scene_output, NULL);
+}
+
+static void
+handle_output_destroy(struct wl_listener *listener, void *data)
+{
+	struct view_capture *capture =
+		wl_container_of(listener, capture, output_destroy);
+	capture->wlr_output = NULL;
+	capture_destroy(capture);
+}
+
+/* Returns false if the size of the view is not known yet */
+static bool
+set_output_state(struct view_capture *capture)
+{
+	struct wlr_surface *surface = capture->view->surface;
+	struct wlr_output *wlr_output = capture->wlr_output;
+	int width = surface->current.width;
+	int height = surface->current.height;
+	if (width <= 0 || height <= 0) {
+		return false;
+	}
+
+	/*
+	 * The scale follows the output of the view, so that both scene
+	 * surfaces send the same preferred scale to the client.
+	 */
+	float scale = 1;
+	struct output *output = capture->view->output;
+	if (output_is_usable(output)) {
+		scale = output->wlr_output->scale;
+	}
+	if (wlr_output->enabled && wlr_output->width == (int)(width * scale)
+			&& wlr_output->height == (int)(height * scale)
+			&& wlr_output->scale == scale) {
+		return true;
+	}
+
+	struct wlr_output_state state;
+	wlr_output_state_init(&state);
+	wlr_output_state_set_enabled(&state, true);
+	wlr_output_state_set_custom_mode(&state, width * scale,
+		height * scale, 0);
+	wlr_output_state_set_scale(&state, scale);
+	bool success = wlr_output_commit_state(wlr_output, &state);
+	wlr_output_state_finish(&state);
+	if (!success) {
+		wlr_log(WLR_ERROR, "failed to configure capture output %s",
+			wlr_output->name);
+	}
+	return success;
+}
+
+static void
+handle_surface_commit(struct wl_listener *listener, void *data)
+{
+	struct view_capture *capture =
+		wl_container_of(listener, capture, surface_commit);
+	set_output_state(capture);
+}
+
+static struct wlr_output *
+create_output(struct server *server)
+{
+	static unsigned int nr_captures;
+
+	/*
+	 * Keep our new-output handler from adding the output to the
+	 * layout, like output_virtual_add() does.
+	 */
+	wl_list_remove(&server->new_output.link);
+	struct wlr_output *wlr_output = wlr_headless_add_output(
+		server->headless.backend, 1, 1);
+	wl_signal_add(&server->backend->events.new_output, &server->new_output);
+	if (!wlr_output) {
+		return NULL;
+	}
+
+	char name[32];
+	snprintf(name, sizeof(name), "CAPTURE-%u", ++nr_captures);
+	wlr_output_set_name(wlr_output, name);
+	if (!wlr_output_init_render(wlr_output, server->allocator,
+			server->renderer)) {
+		wlr_output_destroy(wlr_output);
+		return NULL;
+	}
+	return wlr_output;
+}
+
+static void
+capture_create(struct view *view)
+{
+	if (!view->mapped || !view->surface) {
+		return;
+	}
+	struct wlr_output *wlr_output = create_output(view->server);
+	if (!wlr_output) {
+		wlr_log(WLR_ERROR, "unable to create capture output");
+		return;
+	}
+
+	struct view_capture *capture = znew(*capture);
+	capture->view = view;
+	capture->wlr_output = wlr_output;
+	capture->scene = wlr_scene_create();
+	wlr_scene_subsurface_tree_create(&capture->scene->tree, view->surface);
+	capture->scene_output = wlr_scene_output_create(capture->scene,
+		wlr_output);
+	view->capture = capture;
+
+	capture->frame.notify = handle_frame;
+	wl_signal_add(&wlr_output->events.frame, &capture->frame);
+	capture->output_destroy.notify = handle_output_destroy;
+	wl_signal_add(&wlr_output->events.destroy, &capture->output_destroy);
+	capture->surface_commit.notify = handle_surface_commit;
+	wl_signal_add(&view->surface->events.commit, &capture->surface_commit);
+
+	if (!set_output_state(capture)) {
+		capture_destroy(capture);
+		return;
+	}
+
+	char description[128];
+	snprintf(description, sizeof(description), "Window capture: %s",
+		view_get_app_id(view));
+	wlr_output_set_description(wlr_output, description);
+	wlr_output_create_global(wlr_output);
+	wlr_log(WLR_INFO, "capturing view '%s' on output %s",
+		view_get_app_id(view), wlr_output->name);
+}
+
+void
+view_capture_toggle(struct view *view)
+{
+	if (view->capture) {
+		capture_destroy(view->capture);
+	} else {
+		capture_create(view);
+	}
+}
+
+void
+view_capture_on_view_unmap(struct view *view)
+{
+	if (view->capture) {
+		capture_destroy(view->capture);
+	}
+}
@@ -2,35 +2,52 @@
 /* view-impl-common.c: common code for shell view->impl functions */
 #include <stdio.h>
 #include <strings.h>
-#include "common/list.h"
+#include "edges.h"
 #include "labwc.h"
+#include "osd.h"
+#include "overview.h"
+#include "session-state.h"
+#include "ssd.h"
+#include "thumbnail.h"
+#include "tiling.h"
 #include "view.h"
+#include "view-capture.h"
 #include "view-impl-common.h"
 #include "window-rules.h"
+#include "window-state.h"
 
 void
 view_impl_move_to_front(struct view *view)
 {
-	wl_list_remove(&view->link);
-	wl_list_insert(&view->server->views, &view->link);
+	view_stack_insert(view, /* front */ true);
 	wlr_scene_node_raise_to_top(&view->scene_tree->node);
 }
 
 void
 view_impl_move_to_back(struct view *view)
 {
-	wl_list_remove(&view->link);
-	wl_list_append(&view->server->views, &view->link);
+	view_stack_insert(view, /* front */ false);
 	wlr_scene_node_lower_to_bottom(&view->scene_tree->node);
 }
 
 void
 view_impl_map(struct view *view)
 {
+	edges_invalidate(view->server, view);
+	view_invalidate_criteria(view->server, view);
+	osd_invalidate_views(view->server);
 	desktop_focus_view(view, /*raise*/ true);
+	ssd_update_visibility(view->ssd);
+	/*
+	 * Unchanged properties are not pushed again, so refresh them all
+	 * once to bring the foreign toplevel handle up to date
+	 */
+	view->string_cache.valid = false;
 	view_update_title(view);
 	view_update_app_id(view);
 	if (!view->been_mapped) {
+		/* Before the window rules, so that those still win */
+		session_state_restore(view);
 		window_rules_apply(view, LAB_WINDOW_RULE_EVENT_ON_FIRST_MAP);
 	}
 
@@ -39,28 +56,43 @@ view_impl_map(struct view *view)
 	 * map handlers, but the app_id/title might not have been set at that
 	 * point, so it's safer to process the property here
 	 */
-	enum property ret = window_rules_get_property(view, "skipTaskbar");
+	enum property ret = window_rules_get_property(view,
+		LAB_RULE_PROP_SKIP_TASKBAR);
 	if (ret == LAB_PROP_TRUE) {
 		if (view->toplevel.handle) {
 			wlr_foreign_toplevel_handle_v1_destroy(view->toplevel.handle);
 		}
 	}
+	tiling_update(view->workspace);
+	window_state_changed(view);
+	session_state_changed(view);
 
 	wlr_log(WLR_DEBUG, "[map] identifier=%s, title=%s\n",
-		view_get_string_prop(view, "app_id"),
-		view_get_string_prop(view, "title"));
+		view_get_app_id(view),
+		view_get_title(view));
 }
 
 void
 view_impl_unmap(struct view *view)
 {
 	struct server *server = view->server;
+	edges_invalidate(server, view);
+	/* Child views may get a new parent */
+	view_invalidate_criteria(server, NULL);
+	osd_invalidate_views(server);
+	ssd_update_visibility(view->ssd);
+	view_capture_on_view_unmap(view);
+	overview_on_view_unmap(view);
+	thumbnail_on_view_unmap(view);
 	if (view == server->active_view) {
 		desktop_focus_topmost_view(server);
 	}
 	if (view == server->last_raised_view) {
 		server->last_raised_view = NULL;
 	}
+	tiling_update(view->workspace);
+	window_state_changed(view);
+	session_state_changed(view);
 }
 
 static bool
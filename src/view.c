@@ -1,24 +1,39 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <strings.h>
 #include <wlr/types/wlr_output_layout.h>
+#include "common/array.h"
+#include "common/intern.h"
+#include "common/list.h"
 #include "common/macros.h"
 #include "common/match.h"
 #include "common/mem.h"
 #include "common/scene-helpers.h"
+#include "common/time-helpers.h"
+#include "common/timers.h"
+#include "edges.h"
+#include "geometry-cache.h"
 #include "input/keyboard.h"
 #include "labwc.h"
 #include "menu/menu.h"
 #include "osd.h"
+#include "overview.h"
 #include "placement.h"
+#include "profile.h"
 #include "regions.h"
 #include "resize_indicator.h"
+#include "session-state.h"
 #include "snap-constraints.h"
 #include "snap.h"
 #include "ssd.h"
+#include "thumbnail.h"
+#include "tiling.h"
 #include "view.h"
+#include "view-capture.h"
 #include "window-rules.h"
+#include "window-state.h"
 #include "workspaces.h"
 #include "xwayland.h"
 
@@ -68,13 +83,13 @@ view_matches_query(struct view *view, struct view_query *query)
 	bool match = true;
 	bool empty = true;
 
-	const char *identifier = view_get_string_prop(view, "app_id");
+	const char *identifier = view_get_app_id(view);
 	if (match && query->identifier) {
 		empty = false;
 		match &= match_glob(query->identifier, identifier);
 	}
 
-	const char *title = view_get_string_prop(view, "title");
+	const char *title = view_get_title(view);
 	if (match && query->title) {
 		empty = false;
 		match &= match_glob(query->title, title);
@@ -83,12 +98,55 @@ view_matches_query(struct view *view, struct view_query *query)
 	return !empty && match;
 }
 
-static bool
-matches_criteria(struct view *view, enum lab_view_criteria criteria)
+static uint32_t
+criteria_state(struct view *view)
+{
+	if (view->criteria_cache.valid) {
+		return view->criteria_cache.state;
+	}
+
+	uint32_t state = 0;
+	if (view->fullscreen) {
+		state |= LAB_VIEW_CRITERIA_FULLSCREEN;
+	}
+	if (view_is_always_on_top(view)) {
+		state |= LAB_VIEW_CRITERIA_ALWAYS_ON_TOP;
+	} else {
+		state |= LAB_VIEW_CRITERIA_NO_ALWAYS_ON_TOP;
+	}
+	if (view == view_get_root(view)) {
+		state |= LAB_VIEW_CRITERIA_ROOT_TOPLEVEL;
+	}
+	if (window_rules_get_property(view,
+			LAB_RULE_PROP_SKIP_WINDOW_SWITCHER) != LAB_PROP_TRUE) {
+		state |= LAB_VIEW_CRITERIA_NO_SKIP_WINDOW_SWITCHER;
+	}
+
+	view->criteria_cache.state = state;
+	view->criteria_cache.valid = true;
+	return state;
+}
+
+void
+view_invalidate_criteria(struct server *server, struct view *view)
+{
+	if (view) {
+		view->criteria_cache.valid = false;
+		return;
+	}
+	wl_list_for_each(view, &server->views, link) {
+		view->criteria_cache.valid = false;
+	}
+}
+
+bool
+view_matches_criteria(struct view *view, enum lab_view_criteria criteria)
 {
 	if (!view_is_focusable(view)) {
 		return false;
 	}
+
+	uint32_t state = criteria_state(view);
 	if (criteria & LAB_VIEW_CRITERIA_CURRENT_WORKSPACE) {
 		/*
 		 * Always-on-top views are always on the current desktop and are
@@ -96,36 +154,173 @@ matches_criteria(struct view *view, enum lab_view_criteria criteria)
 		 */
 		struct server *server = view->server;
 		if (view->scene_tree->node.parent != server->workspace_current->tree
-				&& !view_is_always_on_top(view)) {
+				&& !(state & LAB_VIEW_CRITERIA_ALWAYS_ON_TOP)) {
 			return false;
 		}
 	}
-	if (criteria & LAB_VIEW_CRITERIA_FULLSCREEN) {
-		if (!view->fullscreen) {
-			return false;
-		}
+	uint32_t mask = criteria & ~LAB_VIEW_CRITERIA_CURRENT_WORKSPACE;
+	return (state & mask) == mask;
+}
+
+/*
+ * The secondary list of views sharing the scene tree parent of a view.
+ * A view previewed by the window switcher still belongs to the layer it
+ * is restored to afterwards.
+ */
+static struct wl_list *
+layer_views(struct view *view)
+{
+	struct server *server = view->server;
+	struct wlr_scene_tree *parent = view->scene_tree->node.parent;
+	if (server->osd_state.preview_node == &view->scene_tree->node) {
+		parent = server->osd_state.preview_parent;
 	}
-	if (criteria & LAB_VIEW_CRITERIA_ALWAYS_ON_TOP) {
-		if (!view_is_always_on_top(view)) {
-			return false;
-		}
+	if (parent == server->view_tree_always_on_top) {
+		return &server->views_always_on_top;
+	} else if (parent == server->view_tree_always_on_bottom) {
+		return &server->views_always_on_bottom;
 	}
-	if (criteria & LAB_VIEW_CRITERIA_ROOT_TOPLEVEL) {
-		if (view != view_get_root(view)) {
-			return false;
+	return &view->workspace->views;
+}
+
+/* Insert into the layer list, keeping it sorted by stack_seq */
+static void
+layer_link_insert(struct view *view)
+{
+	struct wl_list *head = layer_views(view);
+	struct wl_list *elm;
+	for (elm = head->next; elm != head; elm = elm->next) {
+		struct view *other = wl_container_of(elm, other, layer_link);
+		if (other->stack_seq < view->stack_seq) {
+			break;
 		}
 	}
-	if (criteria & LAB_VIEW_CRITERIA_NO_ALWAYS_ON_TOP) {
-		if (view_is_always_on_top(view)) {
-			return false;
+	/* Insert before elm */
+	wl_list_insert(elm->prev, &view->layer_link);
+}
+
+/* @value is an interned string, the reference is passed on to @cache */
+static void
+view_set_string_cache(const char **cache, const char *prop, const char *value)
+{
+	window_rules_count_instance(prop, *cache, value);
+	intern_unref(*cache);
+	*cache = value;
+}
+
+/* Returns true if the cached value has changed */
+static bool
+view_cache_string_prop(struct view *view, const char **cache, const char *prop)
+{
+	const char *value = NULL;
+	if (view->impl->get_string_prop) {
+		value = intern_str(view->impl->get_string_prop(view, prop));
+	}
+	/* Interned strings compare by pointer */
+	bool changed = value != *cache;
+	view_set_string_cache(cache, prop, value);
+	return changed;
+}
+
+static void
+view_update_string_cache(struct view *view)
+{
+	if (view->string_cache.valid) {
+		return;
+	}
+	view_cache_string_prop(view, &view->string_cache.title, "title");
+	view_cache_string_prop(view, &view->string_cache.app_id, "app_id");
+	view->string_cache.valid = true;
+}
+
+/* To be called whenever the scene tree parent of a view changes */
+static void
+view_update_layer_link(struct view *view)
+{
+	wl_list_remove(&view->layer_link);
+	layer_link_insert(view);
+	view_invalidate_criteria(view->server, view);
+	osd_invalidate_views(view->server);
+}
+
+void
+view_stack_insert(struct view *view, bool front)
+{
+	assert(view);
+	struct server *server = view->server;
+
+	/* view->link is NULL when called for a new view */
+	if (view->link.next) {
+		wl_list_remove(&view->link);
+		wl_list_remove(&view->layer_link);
+	} else {
+		/* Count the app_id and title of the view from the start */
+		view_update_string_cache(view);
+	}
+
+	if (front) {
+		view->stack_seq = ++server->views_front_seq;
+		wl_list_insert(&server->views, &view->link);
+		wl_list_insert(layer_views(view), &view->layer_link);
+	} else {
+		view->stack_seq = --server->views_back_seq;
+		wl_list_append(&server->views, &view->link);
+		wl_list_append(layer_views(view), &view->layer_link);
+	}
+	osd_invalidate_views(server);
+}
+
+/*
+ * First view in a layer list behind @view in stacking order, or the
+ * first one of the list if @view is NULL.
+ */
+static struct view *
+layer_next(struct wl_list *head, struct view *view)
+{
+	struct wl_list *elm = head->next;
+	if (view && layer_views(view) == head) {
+		elm = view->layer_link.next;
+	} else if (view) {
+		/* The other list, usually only contains a few views */
+		for (; elm != head; elm = elm->next) {
+			struct view *other = wl_container_of(elm, other, layer_link);
+			if (other->stack_seq < view->stack_seq) {
+				break;
+			}
 		}
 	}
-	if (criteria & LAB_VIEW_CRITERIA_NO_SKIP_WINDOW_SWITCHER) {
-		if (window_rules_get_property(view, "skipWindowSwitcher") == LAB_PROP_TRUE) {
-			return false;
+	return elm == head ? NULL : wl_container_of(elm, view, layer_link);
+}
+
+/*
+ * Views on the current workspace are those in its own layer list and the
+ * always-on-top views, so only these two lists need to be merged instead
+ * of walking the views of all workspaces.
+ */
+static struct view *
+view_next_on_current_workspace(struct server *server, struct view *view,
+		enum lab_view_criteria criteria)
+{
+	struct wl_list *workspace_views = &server->workspace_current->views;
+	struct wl_list *top_views = &server->views_always_on_top;
+	bool with_top = !(criteria & LAB_VIEW_CRITERIA_NO_ALWAYS_ON_TOP);
+
+	struct view *a = layer_next(workspace_views, view);
+	struct view *b = with_top ? layer_next(top_views, view) : NULL;
+	while (a || b) {
+		struct view *next;
+		if (a && (!b || a->stack_seq > b->stack_seq)) {
+			next = a;
+			a = layer_next(workspace_views, a);
+		} else {
+			next = b;
+			b = layer_next(top_views, b);
+		}
+		if (view_matches_criteria(next, criteria)) {
+			return next;
 		}
 	}
-	return true;
+	return NULL;
 }
 
 struct view *
@@ -133,11 +328,21 @@ view_next(struct wl_list *head, struct view *view, enum lab_view_criteria criter
 {
 	assert(head);
 
+	if ((criteria & LAB_VIEW_CRITERIA_CURRENT_WORKSPACE)
+			&& !wl_list_empty(head)) {
+		struct view *first = wl_container_of(head->next, first, link);
+		struct server *server = first->server;
+		if (head == &server->views) {
+			return view_next_on_current_workspace(server, view,
+				criteria);
+		}
+	}
+
 	struct wl_list *elm = view ? &view->link : head;
 
 	for (elm = elm->next; elm != head; elm = elm->next) {
 		view = wl_container_of(elm, view, link);
-		if (matches_criteria(view, criteria)) {
+		if (view_matches_criteria(view, criteria)) {
 			return view;
 		}
 	}
@@ -158,7 +363,7 @@ view_next_no_head_stop(struct wl_list *head, struct view *from,
 			continue;
 		}
 		struct view *view = wl_container_of(elm, view, link);
-		if (matches_criteria(view, criteria)) {
+		if (view_matches_criteria(view, criteria)) {
 			return view;
 		}
 	}
@@ -179,7 +384,7 @@ view_prev_no_head_stop(struct wl_list *head, struct view *from,
 			continue;
 		}
 		struct view *view = wl_container_of(elm, view, link);
-		if (matches_criteria(view, criteria)) {
+		if (view_matches_criteria(view, criteria)) {
 			return view;
 		}
 	}
@@ -192,11 +397,7 @@ view_array_append(struct server *server, struct wl_array *views,
 {
 	struct view *view;
 	for_each_view(view, &server->views, criteria) {
-		struct view **entry = wl_array_add(views, sizeof(*entry));
-		if (!entry) {
-			wlr_log(WLR_ERROR, "wl_array_add(): out of memory");
-			continue;
-		}
+		struct view **entry = scratch_array_add(views, sizeof(*entry));
 		*entry = view;
 	}
 }
@@ -316,6 +517,10 @@ view_discover_output(struct view *view, struct wlr_box *geometry)
 static void
 set_adaptive_sync_fullscreen(struct view *view)
 {
+	if (rc.adaptive_sync == LAB_ADAPTIVE_SYNC_AUTO) {
+		adaptive_sync_update(view->output);
+		return;
+	}
 	if (rc.adaptive_sync != LAB_ADAPTIVE_SYNC_FULLSCREEN) {
 		return;
 	}
@@ -332,19 +537,14 @@ view_set_activated(struct view *view, bool activated)
 	if (view->impl->set_activated) {
 		view->impl->set_activated(view, activated);
 	}
-	if (view->toplevel.handle) {
-		wlr_foreign_toplevel_handle_v1_set_activated(
-			view->toplevel.handle, activated);
-	}
+	foreign_toplevel_set_activated(view, activated);
+	window_state_changed(view);
 
 	if (rc.kb_layout_per_window) {
 		if (!activated) {
-			/* Store configured keyboard layout per view */
-			view->keyboard_layout =
-				view->server->seat.keyboard_group->keyboard.modifiers.group;
+			keyboard_save_layout(&view->server->seat, view);
 		} else {
-			/* Switch to previously stored keyboard layout */
-			keyboard_update_layout(&view->server->seat, view->keyboard_layout);
+			keyboard_restore_layout(&view->server->seat, view);
 		}
 	}
 	set_adaptive_sync_fullscreen(view);
@@ -359,7 +559,19 @@ view_set_output(struct view *view, struct output *output)
 		wlr_log(WLR_ERROR, "invalid output set for view");
 		return;
 	}
-	view->output = output;
+	if (view->output != output && !view->mapped
+			&& view->impl->notify_scale) {
+		/* So that the first buffer is rendered at the right scale */
+		view->impl->notify_scale(view, output->wlr_output->scale);
+	}
+	if (view->output != output) {
+		struct output *old_output = view->output;
+		view->output = output;
+		window_state_changed(view);
+		session_state_changed(view);
+		adaptive_sync_update(old_output);
+		adaptive_sync_update(output);
+	}
 }
 
 void
@@ -371,23 +583,46 @@ view_close(struct view *view)
 	}
 }
 
+/*
+ * Foreign-toplevel clients are only notified when the set of outputs
+ * changes, unless @force is set (e.g. after a layout change, where the
+ * same scene-output index may refer to a different output).
+ */
 static void
-view_update_outputs(struct view *view)
+view_update_outputs(struct view *view, bool force)
 {
-	struct output *output;
-	struct wlr_output_layout *layout = view->server->output_layout;
+	/* Reused to not allocate on every move */
+	static struct bitset outputs;
+	bitset_clear(&outputs);
 
-	view->outputs = 0;
+	struct output *output;
+	struct wlr_box intersection;
 	wl_list_for_each(output, &view->server->outputs, link) {
-		if (output_is_usable(output) && wlr_output_layout_intersects(
-				layout, output->wlr_output, &view->current)) {
-			view->outputs |= (1ull << output->scene_output->index);
+		if (output_is_usable(output) && wlr_box_intersection(
+				&intersection, &output->layout_box,
+				&view->current)) {
+			bitset_set(&outputs, output->index);
 		}
 	}
 
-	if (view->toplevel.handle) {
-		foreign_toplevel_update_outputs(view);
+	if (bitset_equal(&outputs, &view->outputs) && !force) {
+		return;
+	}
+	bitset_copy(&view->outputs, &outputs);
+	/* Only relay the outputs entered and left unless forced */
+	foreign_toplevel_queue_update(view, force
+		? FOREIGN_TOPLEVEL_ALL_OUTPUTS : FOREIGN_TOPLEVEL_OUTPUTS);
+}
+
+enum wp_content_type_v1_type
+view_get_content_type(struct view *view)
+{
+	struct server *server = view->server;
+	if (!view->surface || !server->content_type_manager) {
+		return WP_CONTENT_TYPE_V1_TYPE_NONE;
 	}
+	return wlr_surface_get_content_type_v1(server->content_type_manager,
+		view->surface);
 }
 
 bool
@@ -395,8 +630,7 @@ view_on_output(struct view *view, struct output *output)
 {
 	assert(view);
 	assert(output);
-	return output->scene_output
-			&& (view->outputs & (1ull << output->scene_output->index));
+	return bitset_test(&view->outputs, output->index);
 }
 
 void
@@ -424,12 +658,15 @@ view_moved(struct view *view)
 	if (view_is_floating(view)) {
 		view_discover_output(view, NULL);
 	}
-	view_update_outputs(view);
+	view_update_outputs(view, /* force */ false);
 	ssd_update_geometry(view->ssd);
+	edges_invalidate(view->server, view);
 	cursor_update_focus(view->server);
 	if (rc.resize_indicator && view->server->grabbed_view == view) {
 		resize_indicator_update(view);
 	}
+	window_state_changed(view);
+	session_state_changed(view);
 }
 
 void
@@ -590,14 +827,12 @@ _minimize(struct view *view, bool minimized)
 	if (view->minimized == minimized) {
 		return;
 	}
-	if (view->toplevel.handle) {
-		wlr_foreign_toplevel_handle_v1_set_minimized(
-			view->toplevel.handle, minimized);
-	}
 	if (view->impl->minimize) {
 		view->impl->minimize(view, minimized);
 	}
 	view->minimized = minimized;
+	foreign_toplevel_queue_update(view, FOREIGN_TOPLEVEL_STATE);
+	window_state_changed(view);
 	if (minimized) {
 		view->impl->unmap(view, /* client_request */ false);
 	} else {
@@ -605,19 +840,23 @@ _minimize(struct view *view, bool minimized)
 	}
 }
 
+/* Sub-views which are shown, or would be if not minimized */
+static bool
+is_active_subview(struct view *view)
+{
+	return view->surface && (view->mapped || view->minimized);
+}
+
 static void
 minimize_sub_views(struct view *view, bool minimized)
 {
-	struct view **child;
-	struct wl_array children;
-
-	wl_array_init(&children);
-	view_append_children(view, &children);
-	wl_array_for_each(child, &children) {
-		_minimize(*child, minimized);
-		minimize_sub_views(*child, minimized);
+	struct view *child;
+	wl_list_for_each(child, &view->children, child_link) {
+		if (is_active_subview(child)) {
+			_minimize(child, minimized);
+		}
+		minimize_sub_views(child, minimized);
 	}
-	wl_array_release(&children);
 }
 
 /*
@@ -692,7 +931,8 @@ adjust_floating_geometry(struct view *view, struct wlr_box *geometry,
 	}
 
 	/* Avoid moving panels out of their own reserved area ("strut") */
-	if (window_rules_get_property(view, "fixedPosition") == LAB_PROP_TRUE
+	if (window_rules_get_property(view,
+			LAB_RULE_PROP_FIXED_POSITION) == LAB_PROP_TRUE
 			|| view_has_strut_partial(view)) {
 		return false;
 	}
@@ -811,6 +1051,14 @@ view_center(struct view *view, const struct wlr_box *ref)
 void
 view_place_initial(struct view *view, bool allow_cursor)
 {
+	/* Windows of the previous instance go back where they were */
+	if (!view->been_mapped && session_state_place(view)) {
+		return;
+	}
+	/* Recurring apps go where they were last closed */
+	if (!view->been_mapped && geometry_cache_place(view)) {
+		return;
+	}
 	if (allow_cursor && rc.placement_policy == LAB_PLACE_CURSOR) {
 		view_move_to_cursor(view);
 		return;
@@ -883,34 +1131,10 @@ view_apply_natural_geometry(struct view *view)
 	view_move_resize(view, geometry);
 }
 
-static void
-view_apply_region_geometry(struct view *view)
+struct wlr_box
+view_get_tile_geometry(struct view *view, struct output *output,
+		struct wlr_box geo)
 {
-	assert(view);
-	assert(view->tiled_region || view->tiled_region_evacuate);
-	struct output *output = view->output;
-	assert(output_is_usable(output));
-
-	if (view->tiled_region_evacuate) {
-		/* View was evacuated from a destroying output */
-		/* Get new output local region, may be NULL */
-		view->tiled_region = regions_from_name(
-			view->tiled_region_evacuate, output);
-
-		/* Get rid of the evacuate instruction */
-		zfree(view->tiled_region_evacuate);
-
-		if (!view->tiled_region) {
-			/* Existing region name doesn't exist in rc.xml anymore */
-			view_set_untiled(view);
-			view_apply_natural_geometry(view);
-			return;
-		}
-	}
-
-	/* Create a copy of the original region geometry */
-	struct wlr_box geo = view->tiled_region->geo;
-
 	/* Adjust for rc.gap */
 	if (rc.gap) {
 		double half_gap = rc.gap / 2.0;
@@ -948,8 +1172,36 @@ view_apply_region_geometry(struct view *view)
 	geo.y += margin.top;
 	geo.width -= margin.left + margin.right;
 	geo.height -= margin.top + margin.bottom;
+	return geo;
+}
 
-	view_move_resize(view, geo);
+static void
+view_apply_region_geometry(struct view *view)
+{
+	assert(view);
+	assert(view->tiled_region || view->tiled_region_evacuate);
+	struct output *output = view->output;
+	assert(output_is_usable(output));
+
+	if (view->tiled_region_evacuate) {
+		/* View was evacuated from a destroying output */
+		/* Get new output local region, may be NULL */
+		view->tiled_region = regions_from_name(
+			view->tiled_region_evacuate, output);
+
+		/* Get rid of the evacuate instruction */
+		zfree(view->tiled_region_evacuate);
+
+		if (!view->tiled_region) {
+			/* Existing region name doesn't exist in rc.xml anymore */
+			view_set_untiled(view);
+			view_apply_natural_geometry(view);
+			return;
+		}
+	}
+
+	view_move_resize(view, view_get_tile_geometry(view, output,
+		view->tiled_region->geo));
 }
 
 static void
@@ -1065,11 +1317,10 @@ set_maximized(struct view *view, enum view_axis maximized)
 	if (view->impl->maximize) {
 		view->impl->maximize(view, (maximized == VIEW_AXIS_BOTH));
 	}
-	if (view->toplevel.handle) {
-		wlr_foreign_toplevel_handle_v1_set_maximized(
-			view->toplevel.handle, (maximized == VIEW_AXIS_BOTH));
-	}
 	view->maximized = maximized;
+	foreign_toplevel_queue_update(view, FOREIGN_TOPLEVEL_STATE);
+	window_state_changed(view);
+	session_state_changed(view);
 
 	/*
 	 * Ensure that follow-up actions like SnapToEdge / SnapToRegion
@@ -1119,6 +1370,8 @@ view_notify_tiled(struct view *view)
 	if (view->impl->notify_tiled) {
 		view->impl->notify_tiled(view);
 	}
+	window_state_changed(view);
+	session_state_changed(view);
 }
 
 /* Reset tiled state of view without changing geometry */
@@ -1166,6 +1419,7 @@ view_maximize(struct view *view, enum view_axis axis,
 	} else {
 		view_apply_special_geometry(view);
 	}
+	tiling_update(view->workspace);
 }
 
 void
@@ -1214,6 +1468,7 @@ view_toggle_decorations(struct view *view)
 		if (!view_is_floating(view)) {
 			view_apply_special_geometry(view);
 		}
+		edges_invalidate(view->server, view);
 		return;
 	}
 	view_set_decorations(view, !view->ssd_enabled);
@@ -1239,6 +1494,9 @@ view_toggle_always_on_top(struct view *view)
 		wlr_scene_node_reparent(&view->scene_tree->node,
 			view->server->view_tree_always_on_top);
 	}
+	view_update_layer_link(view);
+	edges_invalidate(view->server, view);
+	window_state_changed(view);
 }
 
 bool
@@ -1261,6 +1519,8 @@ view_toggle_always_on_bottom(struct view *view)
 		wlr_scene_node_reparent(&view->scene_tree->node,
 			view->server->view_tree_always_on_bottom);
 	}
+	view_update_layer_link(view);
+	edges_invalidate(view->server, view);
 }
 
 void
@@ -1276,9 +1536,19 @@ view_move_to_workspace(struct view *view, struct workspace *workspace)
 	assert(view);
 	assert(workspace);
 	if (view->workspace != workspace) {
+		struct workspace *old_workspace = view->workspace;
 		view->workspace = workspace;
 		wlr_scene_node_reparent(&view->scene_tree->node,
 			workspace->tree);
+		view_update_layer_link(view);
+		edges_invalidate(view->server, view);
+		ssd_update_visibility(view->ssd);
+		window_state_changed(view);
+		session_state_changed(view);
+		if (old_workspace) {
+			tiling_update(old_workspace);
+		}
+		tiling_update(workspace);
 	}
 }
 
@@ -1318,6 +1588,7 @@ view_set_decorations(struct view *view, bool decorations)
 		if (!view_is_floating(view)) {
 			view_apply_special_geometry(view);
 		}
+		edges_invalidate(view->server, view);
 	}
 }
 
@@ -1346,11 +1617,11 @@ set_fullscreen(struct view *view, bool fullscreen)
 	if (view->impl->set_fullscreen) {
 		view->impl->set_fullscreen(view, fullscreen);
 	}
-	if (view->toplevel.handle) {
-		wlr_foreign_toplevel_handle_v1_set_fullscreen(
-			view->toplevel.handle, fullscreen);
-	}
 	view->fullscreen = fullscreen;
+	foreign_toplevel_queue_update(view, FOREIGN_TOPLEVEL_STATE);
+	window_state_changed(view);
+	session_state_changed(view);
+	view_invalidate_criteria(view->server, view);
 
 	/* Re-show decorations when no longer fullscreen */
 	if (!fullscreen && view->ssd_enabled) {
@@ -1392,6 +1663,7 @@ view_set_fullscreen(struct view *view, bool fullscreen)
 		view_apply_special_geometry(view);
 	}
 	set_adaptive_sync_fullscreen(view);
+	tiling_update(view->workspace);
 }
 
 static bool
@@ -1531,7 +1803,7 @@ view_adjust_for_layout_change(struct view *view)
 		}
 	}
 
-	view_update_outputs(view);
+	view_update_outputs(view, /* force */ true);
 }
 
 void
@@ -1895,6 +2167,7 @@ view_snap_to_edge(struct view *view, enum view_edge edge,
 	view->tiled = edge;
 	view_notify_tiled(view);
 	view_apply_tiled_geometry(view);
+	tiling_update(view->workspace);
 }
 
 void
@@ -1929,6 +2202,7 @@ view_snap_to_region(struct view *view, struct region *region,
 	view->tiled_region = region;
 	view_notify_tiled(view);
 	view_apply_region_geometry(view);
+	tiling_update(view->workspace);
 }
 
 void
@@ -1954,20 +2228,20 @@ view_move_to_output(struct view *view, struct output *output)
 		struct region *region = regions_from_name(view->tiled_region->name, output);
 		view_snap_to_region(view, region, /*store_natural_geometry*/ false);
 	}
+	tiling_update(view->workspace);
 }
 
+/* Walks the sub-views of @view depth-first, each above its parent */
 static void
 for_each_subview(struct view *view, void (*action)(struct view *))
 {
-	struct wl_array subviews;
-	struct view **subview;
-
-	wl_array_init(&subviews);
-	view_append_children(view, &subviews);
-	wl_array_for_each(subview, &subviews) {
-		action(*subview);
+	struct view *child;
+	wl_list_for_each(child, &view->children, child_link) {
+		if (is_active_subview(child)) {
+			action(child);
+		}
+		for_each_subview(child, action);
 	}
-	wl_array_release(&subviews);
 }
 
 static void
@@ -1990,6 +2264,32 @@ move_to_back(struct view *view)
 	}
 }
 
+static void
+move_to_front_with_subviews(struct view *view)
+{
+	struct view *root = view_get_root(view);
+	assert(root);
+
+	/* Keep the branch of @view above its siblings from now on */
+	for (struct view *v = view; v->parent; v = v->parent) {
+		wl_list_remove(&v->child_link);
+		wl_list_insert(v->parent->children.prev, &v->child_link);
+	}
+
+#if HAVE_XWAYLAND
+	xwayland_restack_begin();
+#endif
+	move_to_front(root);
+	for_each_subview(root, move_to_front);
+	/* make sure view is in front of other sub-views */
+	if (view != root) {
+		move_to_front(view);
+	}
+#if HAVE_XWAYLAND
+	xwayland_restack_end(view->server);
+#endif
+}
+
 /*
  * In the view_move_to_{front,back} functions, a modal dialog is always
  * shown above its parent window, and the two always move together, so
@@ -2011,17 +2311,24 @@ view_move_to_front(struct view *view)
 		return;
 	}
 
-	struct view *root = view_get_root(view);
-	assert(root);
+	move_to_front_with_subviews(view);
+	edges_invalidate(view->server, NULL);
+	cursor_update_focus(view->server);
+}
 
-	move_to_front(root);
-	for_each_subview(root, move_to_front);
-	/* make sure view is in front of other sub-views */
-	if (view != root) {
-		move_to_front(view);
+void
+view_array_move_to_front(struct wl_array *views)
+{
+	struct server *server = NULL;
+	struct view **view;
+	wl_array_for_each_reverse(view, views) {
+		move_to_front_with_subviews(*view);
+		server = (*view)->server;
+	}
+	if (server) {
+		edges_invalidate(server, NULL);
+		cursor_update_focus(server);
 	}
-
-	cursor_update_focus(view->server);
 }
 
 void
@@ -2034,6 +2341,7 @@ view_move_to_back(struct view *view)
 	for_each_subview(root, move_to_back);
 	move_to_back(root);
 
+	edges_invalidate(view->server, NULL);
 	cursor_update_focus(view->server);
 }
 
@@ -2041,19 +2349,36 @@ struct view *
 view_get_root(struct view *view)
 {
 	assert(view);
-	if (view->impl->get_root) {
-		return view->impl->get_root(view);
+	while (view->parent) {
+		view = view->parent;
 	}
 	return view;
 }
 
 void
-view_append_children(struct view *view, struct wl_array *children)
+view_set_parent(struct view *view, struct view *parent)
 {
 	assert(view);
-	if (view->impl->append_children) {
-		view->impl->append_children(view, children);
+	if (view->parent == parent) {
+		return;
 	}
+	for (struct view *v = parent; v; v = v->parent) {
+		if (v == view) {
+			wlr_log(WLR_ERROR, "ignoring cyclic parent of view");
+			return;
+		}
+	}
+
+	if (view->parent) {
+		wl_list_remove(&view->child_link);
+		wl_list_init(&view->child_link);
+	}
+	view->parent = parent;
+	if (parent) {
+		wl_list_insert(parent->children.prev, &view->child_link);
+	}
+	/* The root toplevel criteria changed */
+	view_invalidate_criteria(view->server, NULL);
 }
 
 bool
@@ -2065,38 +2390,121 @@ view_has_strut_partial(struct view *view)
 }
 
 const char *
-view_get_string_prop(struct view *view, const char *prop)
+view_get_title(struct view *view)
 {
 	assert(view);
-	assert(prop);
-	if (view->impl->get_string_prop) {
-		return view->impl->get_string_prop(view, prop);
+	view_update_string_cache(view);
+	return view->string_cache.title;
+}
+
+const char *
+view_get_app_id(struct view *view)
+{
+	assert(view);
+	view_update_string_cache(view);
+	return view->string_cache.app_id;
+}
+
+static void
+apply_title(struct view *view)
+{
+	view->title_update.last_nsec = time_now_nsec();
+	window_rules_invalidate(view->server, view);
+	osd_invalidate_views(view->server);
+	window_state_changed(view);
+	const char *title = view_get_title(view);
+	if (!view->toplevel.handle || !title) {
+		return;
+	}
+	ssd_update_title(view->ssd);
+	foreign_toplevel_queue_update(view, FOREIGN_TOPLEVEL_TITLE);
+}
+
+static int
+handle_title_update_timeout(void *data)
+{
+	struct view *view = data;
+	timers_remove(view->title_update.timer);
+	view->title_update.timer = NULL;
+	apply_title(view);
+	return 0;
+}
+
+static int64_t
+title_update_interval_nsec(struct view *view)
+{
+	if (rc.title_update_interval > 0) {
+		return (int64_t)rc.title_update_interval * NSEC_PER_MSEC;
+	}
+	int refresh = 0; /* mHz */
+	if (output_is_usable(view->output)) {
+		refresh = view->output->wlr_output->refresh;
 	}
-	return "";
+	if (refresh <= 0) {
+		refresh = 60000;
+	}
+	return (int64_t)1000 * NSEC_PER_SEC / refresh;
 }
 
 void
 view_update_title(struct view *view)
 {
 	assert(view);
-	const char *title = view_get_string_prop(view, "title");
-	if (!view->toplevel.handle || !title) {
+	if (view->string_cache.valid && !view_cache_string_prop(view,
+			&view->string_cache.title, "title")) {
 		return;
 	}
-	ssd_update_title(view->ssd);
-	wlr_foreign_toplevel_handle_v1_set_title(view->toplevel.handle, title);
+	if (view->title_update.timer) {
+		/* The pending update picks up the new title */
+		return;
+	}
+
+	/*
+	 * The first change after a quiet period is applied at once, later
+	 * ones are coalesced until the interval since the last update
+	 * has passed.
+	 */
+	int64_t elapsed = time_now_nsec() - view->title_update.last_nsec;
+	int64_t interval = title_update_interval_nsec(view);
+	if (elapsed >= interval) {
+		apply_title(view);
+		return;
+	}
+	int delay_ms = (interval - elapsed + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC;
+	view->title_update.timer = timers_add(view->server->wl_event_loop,
+		handle_title_update_timeout, view);
+	timers_update(view->title_update.timer, MAX(delay_ms, 1));
+}
+
+void
+view_count_commit(struct view *view)
+{
+	enum view_commit_state state = VIEW_COMMIT_SHOWN;
+	if (view->workspace != view->server->workspace_current) {
+		state = VIEW_COMMIT_HIDDEN;
+	} else if (view->occluded) {
+		state = VIEW_COMMIT_OCCLUDED;
+	}
+	view->nr_commits[state]++;
 }
 
 void
 view_update_app_id(struct view *view)
 {
 	assert(view);
-	const char *app_id = view_get_string_prop(view, "app_id");
+	if (view->string_cache.valid && !view_cache_string_prop(view,
+			&view->string_cache.app_id, "app_id")) {
+		return;
+	}
+	window_rules_invalidate(view->server, view);
+	osd_invalidate_views(view->server);
+	window_state_changed(view);
+	session_state_changed(view);
+	const char *app_id = view_get_app_id(view);
 	if (!view->toplevel.handle || !app_id) {
 		return;
 	}
-	wlr_foreign_toplevel_handle_v1_set_app_id(
-		view->toplevel.handle, app_id);
+	foreign_toplevel_queue_update(view, FOREIGN_TOPLEVEL_APP_ID);
 }
 
 void
@@ -2104,8 +2512,10 @@ view_reload_ssd(struct view *view)
 {
 	assert(view);
 	if (view->ssd_enabled && !view->fullscreen) {
+		int64_t profile_start = profile_begin();
 		undecorate(view);
 		decorate(view);
+		profile_end(PROFILE_VIEW_RELOAD_SSD, profile_start);
 	}
 }
 
@@ -2197,6 +2607,8 @@ view_set_shade(struct view *view, bool shaded)
 	view->shaded = shaded;
 	ssd_enable_shade(view->ssd, view->shaded);
 	wlr_scene_node_set_enabled(view->scene_node, !view->shaded);
+	edges_invalidate(view->server, view);
+	window_state_changed(view);
 }
 
 void
@@ -2206,6 +2618,10 @@ view_destroy(struct view *view)
 	struct server *server = view->server;
 
 	snap_constraints_invalidate(view);
+	edges_invalidate(server, NULL);
+	geometry_cache_save(view);
+	window_state_view_destroy(view);
+	session_state_view_destroy(view);
 
 	if (view->mappable.connected) {
 		mappable_disconnect(&view->mappable);
@@ -2245,6 +2661,13 @@ view_destroy(struct view *view)
 	if (view->tiled_region_evacuate) {
 		zfree(view->tiled_region_evacuate);
 	}
+	bitset_finish(&view->outputs);
+	view_set_string_cache(&view->string_cache.title, "title", NULL);
+	view_set_string_cache(&view->string_cache.app_id, "app_id", NULL);
+	if (view->title_update.timer) {
+		timers_remove(view->title_update.timer);
+		view->title_update.timer = NULL;
+	}
 
 	if (view->inhibits_keybinds) {
 		view->inhibits_keybinds = false;
@@ -2252,8 +2675,20 @@ view_destroy(struct view *view)
 	}
 
 	osd_on_view_destroy(view);
+	adaptive_sync_on_view_destroy(view);
+	view_capture_on_view_unmap(view);
+	overview_on_view_unmap(view);
+	thumbnail_on_view_unmap(view);
 	undecorate(view);
 
+	/* Children of the view are passed on to its parent */
+	struct view *child, *tmp;
+	wl_list_for_each_safe(child, tmp, &view->children, child_link) {
+		view_set_parent(child, view->parent);
+	}
+	view_set_parent(view, NULL);
+	view_invalidate_criteria(server, NULL);
+
 	/*
 	 * The layer-shell top-layer is disabled when an application is running
 	 * in fullscreen mode, so if that's the case, we may have to re-enable
@@ -2262,7 +2697,8 @@ view_destroy(struct view *view)
 	if (view->fullscreen && view->output) {
 		view->fullscreen = false;
 		desktop_update_top_layer_visiblity(server);
-		if (rc.adaptive_sync == LAB_ADAPTIVE_SYNC_FULLSCREEN) {
+		if (rc.adaptive_sync == LAB_ADAPTIVE_SYNC_FULLSCREEN
+				|| rc.adaptive_sync == LAB_ADAPTIVE_SYNC_AUTO) {
 			set_adaptive_sync_fullscreen(view);
 		}
 	}
@@ -2283,8 +2719,9 @@ view_destroy(struct view *view)
 		view->scene_tree = NULL;
 	}
 
-	/* Remove view from server->views */
+	/* Remove view from server->views and its layer list */
 	wl_list_remove(&view->link);
+	wl_list_remove(&view->layer_link);
 	free(view);
 
 	cursor_update_focus(server);
@@ -2,52 +2,141 @@
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <cairo.h>
 #include <glib.h>
-#include <strings.h>
+#include <string.h>
 #include <wlr/util/log.h>
 #include "action.h"
+#include "common/intern.h"
 #include "common/match.h"
+#include "common/mem.h"
 #include "config/rcxml.h"
 #include "labwc.h"
 #include "view.h"
 #include "window-rules.h"
 
-static bool
-other_instances_exist(struct view *self, const char *id, const char *title)
-{
-	struct wl_list *views = &self->server->views;
-	const char *prop = NULL;
-	struct view *view;
+#define INSTANCE_BUCKETS (256)
 
-	wl_list_for_each(view, views, link) {
-		if (view == self) {
-			continue;
-		}
-		if (id) {
-			prop = view_get_string_prop(view, "app_id");
-			if (prop && !strcmp(prop, id)) {
-				return true;
-			}
+/* Number of views using an interned app_id or title */
+struct instance {
+	struct wl_list link; /* instance_table.buckets[] */
+	const char *str; /* interned, reference held */
+	unsigned int nr_views;
+};
+
+struct instance_table {
+	struct wl_list buckets[INSTANCE_BUCKETS];
+	bool initialized;
+};
+
+static struct instance_table app_id_instances;
+static struct instance_table title_instances;
+
+static struct wl_list *
+instance_bucket(struct instance_table *table, const char *str)
+{
+	if (!table->initialized) {
+		for (size_t i = 0; i < INSTANCE_BUCKETS; i++) {
+			wl_list_init(&table->buckets[i]);
 		}
-		if (title) {
-			prop = view_get_string_prop(view, "title");
-			if (prop && !strcmp(prop, title)) {
-				return true;
-			}
+		table->initialized = true;
+	}
+	/* Interned strings are unique, so the address is a good key */
+	uintptr_t key = (uintptr_t)str;
+	return &table->buckets[(key >> 4 ^ key >> 12) % INSTANCE_BUCKETS];
+}
+
+static struct instance *
+instance_find(struct instance_table *table, const char *str)
+{
+	struct instance *instance;
+	wl_list_for_each(instance, instance_bucket(table, str), link) {
+		if (instance->str == str) {
+			return instance;
 		}
 	}
-	return false;
+	return NULL;
+}
+
+static unsigned int
+instance_count(struct instance_table *table, const char *str)
+{
+	struct instance *instance = instance_find(table, str);
+	return instance ? instance->nr_views : 0;
+}
+
+static void
+instance_add(struct instance_table *table, const char *str)
+{
+	struct instance *instance = instance_find(table, str);
+	if (!instance) {
+		instance = znew(*instance);
+		instance->str = intern_ref(str);
+		wl_list_insert(instance_bucket(table, str), &instance->link);
+	}
+	instance->nr_views++;
+}
+
+static void
+instance_remove(struct instance_table *table, const char *str)
+{
+	struct instance *instance = instance_find(table, str);
+	assert(instance && instance->nr_views > 0);
+	if (--instance->nr_views) {
+		return;
+	}
+	wl_list_remove(&instance->link);
+	intern_unref(instance->str);
+	free(instance);
+}
+
+void
+window_rules_count_instance(const char *prop, const char *old,
+		const char *new)
+{
+	if (old == new) {
+		return;
+	}
+	struct instance_table *table = !strcmp(prop, "title")
+		? &title_instances : &app_id_instances;
+	if (old) {
+		instance_remove(table, old);
+	}
+	if (new) {
+		instance_add(table, new);
+	}
+}
+
+/* @id and @title are the interned app_id and title of the view to match */
+static bool
+other_instances_exist(const char *id, const char *title)
+{
+	return (id && instance_count(&app_id_instances, id) > 1)
+		|| (title && instance_count(&title_instances, title) > 1);
+}
+
+/* @str is interned, see view_get_app_id() and view_get_title() */
+static bool
+match_cached(const char *pattern, const char *str, const char **cached_str,
+		bool *cached_result)
+{
+	if (*cached_str != str) {
+		intern_unref(*cached_str);
+		*cached_str = intern_ref(str);
+		*cached_result = match_glob(pattern, str);
+	}
+	return *cached_result;
 }
 
 /* Try to match against identifier AND title (if set) */
 static bool
-view_matches_criteria(struct window_rule *rule, struct view *view)
+rule_matches_view(struct window_rule *rule, struct view *view)
 {
-	const char *id = view_get_string_prop(view, "app_id");
-	const char *title = view_get_string_prop(view, "title");
+	const char *id = view_get_app_id(view);
+	const char *title = view_get_title(view);
 
-	if (rule->match_once && other_instances_exist(view, id, title)) {
+	if (rule->match_once && other_instances_exist(id, title)) {
 		return false;
 	}
 
@@ -55,18 +144,24 @@ view_matches_criteria(struct window_rule *rule, struct view *view)
 		if (!id || !title) {
 			return false;
 		}
-		return match_glob(rule->identifier, id)
-			&& match_glob(rule->title, title);
+		return match_cached(rule->identifier, id,
+				&rule->match_cache.id, &rule->match_cache.id_matches)
+			&& match_cached(rule->title, title,
+				&rule->match_cache.title,
+				&rule->match_cache.title_matches);
 	} else if (rule->identifier) {
 		if (!id) {
 			return false;
 		}
-		return match_glob(rule->identifier, id);
+		return match_cached(rule->identifier, id,
+			&rule->match_cache.id, &rule->match_cache.id_matches);
 	} else if (rule->title) {
 		if (!title) {
 			return false;
 		}
-		return match_glob(rule->title, title);
+		return match_cached(rule->title, title,
+			&rule->match_cache.title,
+			&rule->match_cache.title_matches);
 	} else {
 		wlr_log(WLR_ERROR, "rule has no identifier or title\n");
 		return false;
@@ -81,16 +176,49 @@ window_rules_apply(struct view *view, enum window_rule_event event)
 		if (rule->event != event) {
 			continue;
 		}
-		if (view_matches_criteria(rule, view)) {
+		if (rule_matches_view(rule, view)) {
 			actions_run(view, view->server, &rule->actions, 0);
 		}
 	}
 }
 
-enum property
-window_rules_get_property(struct view *view, const char *property)
+static enum property
+rule_get_property(struct window_rule *rule, enum window_rule_property property)
+{
+	switch (property) {
+	case LAB_RULE_PROP_SERVER_DECORATION:
+		return rule->server_decoration;
+	case LAB_RULE_PROP_SKIP_TASKBAR:
+		return rule->skip_taskbar;
+	case LAB_RULE_PROP_SKIP_WINDOW_SWITCHER:
+		return rule->skip_window_switcher;
+	case LAB_RULE_PROP_IGNORE_FOCUS_REQUEST:
+		return rule->ignore_focus_request;
+	case LAB_RULE_PROP_FIXED_POSITION:
+		return rule->fixed_position;
+	case LAB_RULE_PROP_ADAPTIVE_SYNC:
+		return rule->adaptive_sync;
+	case LAB_RULE_PROP_ALLOW_TEARING:
+		return rule->allow_tearing;
+	case LAB_RULE_PROP_COUNT:
+		break;
+	}
+	return LAB_PROP_UNSPECIFIED;
+}
+
+/*
+ * Resolve all properties with a single pass over the rules. Returns false
+ * if the result depends on other views (matchOnce) and must not be cached.
+ */
+static bool
+resolve_properties(struct view *view, enum property *props)
 {
-	assert(property);
+	bool cacheable = true;
+	size_t nr_unresolved = LAB_RULE_PROP_COUNT;
+
+	for (size_t i = 0; i < LAB_RULE_PROP_COUNT; i++) {
+		props[i] = LAB_PROP_UNSPECIFIED;
+	}
 
 	/*
 	 * We iterate in reverse here because later items in list have higher
@@ -104,34 +232,59 @@ window_rules_get_property(struct view *view, const char *property)
 	 */
 	struct window_rule *rule;
 	wl_list_for_each_reverse(rule, &rc.window_rules, link) {
+		if (!nr_unresolved) {
+			break;
+		}
+		if (rule->match_once) {
+			cacheable = false;
+		}
+		if (!rule_matches_view(rule, view)) {
+			continue;
+		}
 		/*
-		 * Only return if property != LAB_PROP_UNSPECIFIED otherwise a
-		 * <windowRule> which does not set a particular property
-		 * attribute would still return here if that property was asked
-		 * for.
+		 * Only use the value if property != LAB_PROP_UNSPECIFIED
+		 * otherwise a <windowRule> which does not set a particular
+		 * property attribute would still override lower priority
+		 * rules which do.
 		 */
-		if (view_matches_criteria(rule, view)) {
-			if (rule->server_decoration
-					&& !strcasecmp(property, "serverDecoration")) {
-				return rule->server_decoration;
-			}
-			if (rule->skip_taskbar
-					&& !strcasecmp(property, "skipTaskbar")) {
-				return rule->skip_taskbar;
-			}
-			if (rule->skip_window_switcher
-					&& !strcasecmp(property, "skipWindowSwitcher")) {
-				return rule->skip_window_switcher;
-			}
-			if (rule->ignore_focus_request
-					&& !strcasecmp(property, "ignoreFocusRequest")) {
-				return rule->ignore_focus_request;
-			}
-			if (rule->fixed_position
-					&& !strcasecmp(property, "fixedPosition")) {
-				return rule->fixed_position;
+		for (size_t i = 0; i < LAB_RULE_PROP_COUNT; i++) {
+			enum property value = rule_get_property(rule, i);
+			if (props[i] == LAB_PROP_UNSPECIFIED && value) {
+				props[i] = value;
+				nr_unresolved--;
 			}
 		}
 	}
-	return LAB_PROP_UNSPECIFIED;
+	return cacheable;
+}
+
+enum property
+window_rules_get_property(struct view *view, enum window_rule_property property)
+{
+	assert(property < LAB_RULE_PROP_COUNT);
+
+	if (view->window_rule_cache.valid) {
+		return view->window_rule_cache.props[property];
+	}
+
+	enum property props[LAB_RULE_PROP_COUNT];
+	if (resolve_properties(view, props)) {
+		memcpy(view->window_rule_cache.props, props, sizeof(props));
+		view->window_rule_cache.valid = true;
+	}
+	return props[property];
+}
+
+void
+window_rules_invalidate(struct server *server, struct view *view)
+{
+	/* The skipWindowSwitcher result is part of the criteria state */
+	view_invalidate_criteria(server, view);
+	if (view) {
+		view->window_rule_cache.valid = false;
+		return;
+	}
+	wl_list_for_each(view, &server->views, link) {
+		view->window_rule_cache.valid = false;
+	}
 }
@@ -0,0 +1,434 @@
+// SPDX-License-Identifier: GPL-2.0-only
+#define _GNU_SOURCE /* accept4() */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/util/log.h>
+#include "common/buf.h"
+#include "common/mem.h"
+#include "common/unix-socket.h"
+#include "config/rcxml.h"
+#include "labwc.h"
+#include "view.h"
+#include "window-state.h"
+#include "workspaces.h"
+
+/* Connections exceeding this are closed right away */
+#define MAX_CLIENTS (16)
+/* Subscribers not reading what is sent to them are dropped */
+#define MAX_BUFFERED (1024 * 1024)
+#define MAX_REQUEST (64)
+
+struct window_state_client {
+	int fd;
+	struct wl_event_source *source;
+	char request[MAX_REQUEST];
+	int request_len;
+	bool answered;
+	bool subscribed;
+	struct buf out;
+	int written;
+	struct wl_list link; /* window_state.clients */
+};
+
+static struct {
+	struct server *server;
+	char *path;
+	int fd;
+	struct wl_event_source *source;
+	struct wl_list clients;
+	int nr_clients;
+	int nr_subscribers;
+
+	/* Views changed since the last message to subscribers */
+	struct wl_list changed; /* view.window_state.link */
+	struct wl_event_source *flush_idle;
+	uint64_t next_id;
+} window_state = {
+	.fd = -1,
+	.next_id = 1,
+};
+
+static void
+add_string(struct buf *b, const char *s)
+{
+	if (!s) {
+		buf_add(b, "null");
+		return;
+	}
+	buf_add_char(b, '"');
+	const char *run = s;
+	for (const char *p = s; *p; p++) {
+		unsigned char c = *p;
+		if (c != '"' && c != '\\' && c >= 0x20) {
+			continue;
+		}
+		buf_add_len(b, run, p - run);
+		if (c == '"' || c == '\\') {
+			buf_add_fmt(b, "\\%c", c);
+		} else {
+			buf_add_fmt(b, "\\u%04x", c);
+		}
+		run = p + 1;
+	}
+	buf_add(b, run);
+	buf_add_char(b, '"');
+}
+
+uint64_t
+window_state_view_id(struct view *view)
+{
+	if (!view->window_state.id) {
+		view->window_state.id = window_state.next_id++;
+	}
+	return view->window_state.id;
+}
+
+static const char *
+bool_str(bool value)
+{
+	return value ? "true" : "false";
+}
+
+static void
+add_view(struct buf *b, struct view *view)
+{
+	static const char *const axes[] = {
+		[VIEW_AXIS_NONE] = "none",
+		[VIEW_AXIS_HORIZONTAL] = "horizontal",
+		[VIEW_AXIS_VERTICAL] = "vertical",
+		[VIEW_AXIS_BOTH] = "both",
+	};
+
+	buf_add_fmt(b, "{\"id\":%llu,\"app_id\":",
+		(unsigned long long)window_state_view_id(view));
+	add_string(b, view_get_app_id(view));
+	buf_add(b, ",\"title\":");
+	add_string(b, view_get_title(view));
+	buf_add_fmt(b, ",\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d",
+		view->current.x, view->current.y,
+		view->current.width, view->current.height);
+	buf_add(b, ",\"workspace\":");
+	add_string(b, view->workspace ? view->workspace->name : NULL);
+	buf_add(b, ",\"output\":");
+	add_string(b, output_is_usable(view->output)
+		? view->output->wlr_output->name : NULL);
+	buf_add_fmt(b, ",\"mapped\":%s,\"activated\":%s,\"minimized\":%s,"
+		"\"maximized\":\"%s\",\"fullscreen\":%s,\"tiled\":%s,"
+		"\"shaded\":%s,\"always_on_top\":%s}",
+		bool_str(view->mapped),
+		bool_str(view == view->server->active_view),
+		bool_str(view->minimized),
+		axes[view->maximized],
+		bool_str(view->fullscreen),
+		bool_str(view->tiled || view->tiled_region),
+		bool_str(view->shaded),
+		bool_str(view_is_always_on_top(view)));
+}
+
+/* All views in a single pass over server.views, topmost first */
+static void
+add_snapshot(struct buf *b)
+{
+	buf_add(b, "{\"event\":\"snapshot\",\"views\":[");
+	bool first = true;
+	struct view *view;
+	wl_list_for_each(view, &window_state.server->views, link) {
+		if (!first) {
+			buf_add_char(b, ',');
+		}
+		add_view(b, view);
+		first = false;
+	}
+	buf_add(b, "]}\n");
+}
+
+static void
+client_destroy(struct window_state_client *client)
+{
+	if (client->source) {
+		wl_event_source_remove(client->source);
+	}
+	close(client->fd);
+	buf_reset(&client->out);
+	wl_list_remove(&client->link);
+	window_state.nr_clients--;
+	if (client->subscribed) {
+		window_state.nr_subscribers--;
+	}
+	free(client);
+}
+
+/* Returns false once the client is done with, either way */
+static bool
+client_flush(struct window_state_client *client)
+{
+	while (client->written < client->out.len) {
+		ssize_t ret = write(client->fd,
+			client->out.data + client->written,
+			client->out.len - client->written);
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+		if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			break;
+		}
+		if (ret <= 0) {
+			return false;
+		}
+		client->written += ret;
+	}
+	if (client->written == client->out.len) {
+		buf_clear(&client->out);
+		client->written = 0;
+		if (client->answered && !client->subscribed) {
+			return false;
+		}
+	}
+	/* Watch for writability only while something is left to send */
+	wl_event_source_fd_update(client->source, WL_EVENT_READABLE
+		| (client->out.len ? WL_EVENT_WRITABLE : 0));
+	return true;
+}
+
+static void
+handle_request(struct window_state_client *client, char *request)
+{
+	size_t len = strlen(request);
+	if (len && request[len - 1] == '\r') {
+		request[len - 1] = '\0';
+	}
+
+	client->answered = true;
+	if (!strcmp(request, "subscribe")) {
+		client->subscribed = true;
+		window_state.nr_subscribers++;
+	} else if (strcmp(request, "snapshot")) {
+		buf_add(&client->out, "{\"error\":\"unknown request\"}\n");
+		return;
+	}
+	add_snapshot(&client->out);
+}
+
+/* Returns false if the client is to be closed */
+static bool
+client_read(struct window_state_client *client)
+{
+	char data[MAX_REQUEST];
+	ssize_t ret = read(client->fd, data, sizeof(data));
+	if (ret < 0) {
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+	}
+	if (ret == 0) {
+		return false;
+	}
+	if (client->answered) {
+		/* Anything after the request is ignored */
+		return true;
+	}
+
+	char *newline = memchr(data, '\n', ret);
+	size_t len = newline ? (size_t)(newline - data) : (size_t)ret;
+	if (client->request_len + len >= MAX_REQUEST) {
+		return false;
+	}
+	memcpy(client->request + client->request_len, data, len);
+	client->request_len += len;
+	if (newline) {
+		client->request[client->request_len] = '\0';
+		handle_request(client, client->request);
+	}
+	return true;
+}
+
+static int
+handle_client(int fd, uint32_t mask, void *data)
+{
+	struct window_state_client *client = data;
+	if (mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR)) {
+		client_destroy(client);
+		return 0;
+	}
+	if ((mask & WL_EVENT_READABLE) && !client_read(client)) {
+		client_destroy(client);
+		return 0;
+	}
+	if (client->answered && !client_flush(client)) {
+		client_destroy(client);
+	}
+	return 0;
+}
+
+static int
+handle_connection(int fd, uint32_t mask, void *data)
+{
+	int client_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (client_fd < 0) {
+		return 0;
+	}
+	if (window_state.nr_clients >= MAX_CLIENTS) {
+		close(client_fd);
+		return 0;
+	}
+
+	struct window_state_client *client = znew(*client);
+	client->fd = client_fd;
+	client->out = BUF_INIT;
+	wl_list_insert(&window_state.clients, &client->link);
+	window_state.nr_clients++;
+
+	client->source = wl_event_loop_add_fd(
+		window_state.server->wl_event_loop, client_fd,
+		WL_EVENT_READABLE, handle_client, client);
+	if (!client->source) {
+		client_destroy(client);
+	}
+	return 0;
+}
+
+static void
+broadcast(struct buf *msg)
+{
+	struct window_state_client *client, *tmp;
+	wl_list_for_each_safe(client, tmp, &window_state.clients, link) {
+		if (!client->subscribed) {
+			continue;
+		}
+		if (client->out.len + msg->len > MAX_BUFFERED) {
+			wlr_log(WLR_INFO, "dropping window state subscriber "
+				"not keeping up");
+			client_destroy(client);
+			continue;
+		}
+		buf_add_len(&client->out, msg->data, msg->len);
+		if (!client_flush(client)) {
+			client_destroy(client);
+		}
+	}
+}
+
+static void
+handle_flush(void *data)
+{
+	window_state.flush_idle = NULL;
+
+	struct buf msg = BUF_INIT;
+	struct view *view, *tmp;
+	wl_list_for_each_safe(view, tmp, &window_state.changed,
+			window_state.link) {
+		buf_add(&msg, "{\"event\":\"changed\",\"view\":");
+		add_view(&msg, view);
+		buf_add(&msg, "}\n");
+		wl_list_remove(&view->window_state.link);
+		view->window_state.queued = false;
+	}
+	broadcast(&msg);
+	buf_reset(&msg);
+}
+
+void
+window_state_changed(struct view *view)
+{
+	if (!window_state.nr_subscribers || view->window_state.queued) {
+		return;
+	}
+	view->window_state.queued = true;
+	wl_list_insert(window_state.changed.prev, &view->window_state.link);
+	if (!window_state.flush_idle) {
+		window_state.flush_idle = wl_event_loop_add_idle(
+			view->server->wl_event_loop, handle_flush, NULL);
+	}
+}
+
+void
+window_state_view_destroy(struct view *view)
+{
+	if (view->window_state.queued) {
+		wl_list_remove(&view->window_state.link);
+		view->window_state.queued = false;
+	}
+	if (!window_state.nr_subscribers || !view->window_state.id) {
+		return;
+	}
+	struct buf msg = BUF_INIT;
+	buf_add_fmt(&msg, "{\"event\":\"closed\",\"id\":%llu}\n",
+		(unsigned long long)view->window_state.id);
+	broadcast(&msg);
+	buf_reset(&msg);
+}
+
+static void
+close_socket(void)
+{
+	struct window_state_client *client, *tmp;
+	wl_list_for_each_safe(client, tmp, &window_state.clients, link) {
+		client_destroy(client);
+	}
+	if (window_state.source) {
+		wl_event_source_remove(window_state.source);
+		window_state.source = NULL;
+	}
+	if (window_state.fd >= 0) {
+		close(window_state.fd);
+		unlink(window_state.path);
+		window_state.fd = -1;
+	}
+	zfree(window_state.path);
+}
+
+static bool
+open_socket(const char *path)
+{
+	int fd = unix_socket_listen(path, MAX_CLIENTS);
+	if (fd < 0) {
+		return false;
+	}
+	window_state.fd = fd;
+	window_state.path = xstrdup(path);
+	window_state.source = wl_event_loop_add_fd(
+		window_state.server->wl_event_loop, fd, WL_EVENT_READABLE,
+		handle_connection, NULL);
+	wlr_log(WLR_INFO, "serving window state on %s", path);
+	return true;
+}
+
+void
+window_state_init(struct server *server)
+{
+	if (!window_state.clients.next) {
+		wl_list_init(&window_state.clients);
+		wl_list_init(&window_state.changed);
+	}
+	window_state.server = server;
+
+	const char *socket = rc.window_state_socket;
+	struct buf path = BUF_INIT;
+	unix_socket_path(&path, socket);
+
+	if (window_state.path && !strcmp(window_state.path, path.data)) {
+		goto out;
+	}
+	close_socket();
+	if (socket) {
+		open_socket(path.data);
+	}
+out:
+	buf_reset(&path);
+}
+
+void
+window_state_finish(void)
+{
+	if (!window_state.clients.next) {
+		return;
+	}
+	close_socket();
+	if (window_state.flush_idle) {
+		wl_event_source_remove(window_state.flush_idle);
+		window_state.flush_idle = NULL;
+	}
+}
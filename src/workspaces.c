@@ -1,20 +1,23 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
-#include <cairo.h>
-#include <pango/pangocairo.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 #include "config.h"
-#include "buffer.h"
 #include "common/font.h"
 #include "common/graphic-helpers.h"
 #include "common/list.h"
+#include "common/macros.h"
+#include "edges.h"
 #include "common/mem.h"
+#include "common/scaled_font_buffer.h"
+#include "common/time-helpers.h"
 #include "input/keyboard.h"
 #include "labwc.h"
+#include "osd.h"
+#include "ssd.h"
 #include "view.h"
 #include "workspaces.h"
 #include "xwayland.h"
@@ -52,123 +55,241 @@ parse_workspace_index(const char *name)
 	return index;
 }
 
+/*
+ * The workspace switcher OSD is kept as a retained scene per output: the
+ * background, border and outlines of all workspace boxes are solid rects,
+ * each workspace name is pre-rendered into a scaled_font_buffer
+ * and the active box is a separate rectangle. Switching workspaces only
+ * moves the highlight and shows a different label.
+ */
+struct osd_layout {
+	int margin;
+	int padding;
+	int rect_width;
+	int rect_height;
+	bool hide_boxes;
+	int marker_width;
+	int width;
+	int height;
+};
+
 static void
-_osd_update(struct server *server)
+get_osd_layout(struct server *server, struct osd_layout *layout)
 {
 	struct theme *theme = server->theme;
 
 	/* Settings */
-	uint16_t margin = 10;
-	uint16_t padding = 2;
-	uint16_t rect_height = theme->osd_workspace_switcher_boxes_height;
-	uint16_t rect_width = theme->osd_workspace_switcher_boxes_width;
-	bool hide_boxes = theme->osd_workspace_switcher_boxes_width == 0 ||
+	layout->margin = 10;
+	layout->padding = 2;
+	layout->rect_height = theme->osd_workspace_switcher_boxes_height;
+	layout->rect_width = theme->osd_workspace_switcher_boxes_width;
+	layout->hide_boxes = theme->osd_workspace_switcher_boxes_width == 0 ||
 		theme->osd_workspace_switcher_boxes_height == 0;
 
 	/* Dimensions */
 	size_t workspace_count = wl_list_length(&server->workspaces);
-	uint16_t marker_width = workspace_count * (rect_width + padding) - padding;
-	uint16_t width = margin * 2 + (marker_width < 200 ? 200 : marker_width);
-	uint16_t height = margin * (hide_boxes ? 2 : 3) + rect_height + font_height(&rc.font_osd);
+	layout->marker_width = workspace_count
+		* (layout->rect_width + layout->padding) - layout->padding;
+	layout->width = layout->margin * 2
+		+ MAX(layout->marker_width, 200);
+	layout->height = layout->margin * (layout->hide_boxes ? 2 : 3)
+		+ layout->rect_height + font_height(&rc.font_osd);
+}
+
+static void
+osd_scene_destroy(struct output *output)
+{
+	struct workspace_osd *osd = &output->workspace_osd;
+	if (osd->tree) {
+		wlr_scene_node_destroy(&osd->tree->node);
+	}
+	wl_array_release(&osd->labels);
+	*osd = (struct workspace_osd){ 0 };
+	wl_array_init(&osd->labels);
+}
+
+static bool
+osd_scene_create(struct output *output)
+{
+	struct server *server = output->server;
+	struct theme *theme = server->theme;
+	struct workspace_osd *osd = &output->workspace_osd;
+	struct osd_layout layout;
+	get_osd_layout(server, &layout);
+
+	osd->tree = wlr_scene_tree_create(&server->scene->tree);
+	osd->width = layout.width;
+	osd->height = layout.height;
+
+	/* Background and border */
+	wlr_scene_rect_create(osd->tree, layout.width, layout.height,
+		theme->osd_bg_color);
+	outline_rect_create(osd->tree, layout.width, layout.height,
+		theme->osd_border_width, theme->osd_border_color);
+
+	/* Boxes, the active one is filled by a separate highlight */
+	if (!layout.hide_boxes) {
+		int x = (layout.width - layout.marker_width) / 2;
+		for (int i = 0; i < wl_list_length(&server->workspaces); i++) {
+			/* 2px lines centered on the edges of the box */
+			struct wlr_scene_tree *box = outline_rect_create(osd->tree,
+				layout.rect_width - layout.padding + 2,
+				layout.rect_height + 2, 2,
+				theme->osd_label_text_color);
+			wlr_scene_node_set_position(&box->node,
+				x - 1, layout.margin - 1);
+			x += layout.rect_width + layout.padding;
+		}
+		osd->highlight = wlr_scene_rect_create(osd->tree,
+			layout.rect_width - layout.padding, layout.rect_height,
+			theme->osd_label_text_color);
+	}
+
+	int y;
+	if (!layout.hide_boxes) {
+		y = layout.margin * 2 + layout.rect_height;
+	} else {
+		y = (layout.height - font_height(&rc.font_osd)) / 2;
+	}
 
-	cairo_t *cairo;
-	cairo_surface_t *surface;
 	struct workspace *workspace;
+	wl_list_for_each(workspace, &server->workspaces, link) {
+		struct scaled_font_buffer *label =
+			scaled_font_buffer_create(osd->tree);
+		if (!label) {
+			osd_scene_destroy(output);
+			return false;
+		}
+		scaled_font_buffer_update(label, workspace->name,
+			layout.width - 2 * layout.margin, &rc.font_osd,
+			theme->osd_label_text_color, theme->osd_bg_color,
+			NULL);
+
+		/* Center workspace indicator on the x axis */
+		wlr_scene_node_set_position(&label->scene_buffer->node,
+			(layout.width - label->width) / 2, y);
+		wlr_scene_node_set_enabled(&label->scene_buffer->node, false);
+
+		struct scaled_font_buffer **entry =
+			wl_array_add(&osd->labels, sizeof(*entry));
+		*entry = label;
+	}
+	return true;
+}
+
+static void
+_osd_update(struct server *server)
+{
+	struct osd_layout layout;
+	get_osd_layout(server, &layout);
 
 	struct output *output;
 	wl_list_for_each(output, &server->outputs, link) {
 		if (!output_is_usable(output)) {
 			continue;
 		}
-		struct lab_data_buffer *buffer = buffer_create_cairo(width, height,
-			output->wlr_output->scale, true);
-		if (!buffer) {
-			wlr_log(WLR_ERROR, "Failed to allocate buffer for workspace OSD");
+		struct workspace_osd *osd = &output->workspace_osd;
+		if (!osd->tree && !osd_scene_create(output)) {
 			continue;
 		}
 
-		cairo = buffer->cairo;
-
-		/* Background */
-		set_cairo_color(cairo, theme->osd_bg_color);
-		cairo_rectangle(cairo, 0, 0, width, height);
-		cairo_fill(cairo);
-
-		/* Border */
-		set_cairo_color(cairo, theme->osd_border_color);
-		struct wlr_fbox fbox = {
-			.width = width,
-			.height = height,
-		};
-		draw_cairo_border(cairo, fbox, theme->osd_border_width);
-
-		/* Boxes */
-		uint16_t x;
-		if (!hide_boxes) {
-			x = (width - marker_width) / 2;
-			wl_list_for_each(workspace, &server->workspaces, link) {
-				bool active =  workspace == server->workspace_current;
-				set_cairo_color(cairo, server->theme->osd_label_text_color);
-				cairo_rectangle(cairo, x, margin,
-					rect_width - padding, rect_height);
-				cairo_stroke(cairo);
-				if (active) {
-					cairo_rectangle(cairo, x, margin,
-						rect_width - padding, rect_height);
-					cairo_fill(cairo);
-				}
-				x += rect_width + padding;
+		/* Show the label and highlight of the current workspace */
+		int index = 0;
+		struct workspace *workspace;
+		struct scaled_font_buffer **label = osd->labels.data;
+		wl_list_for_each(workspace, &server->workspaces, link) {
+			bool active = workspace == server->workspace_current;
+			wlr_scene_node_set_enabled(&label[index]->scene_buffer->node,
+				active);
+			if (active && osd->highlight) {
+				int x = (layout.width - layout.marker_width) / 2
+					+ index * (layout.rect_width + layout.padding);
+				wlr_scene_node_set_position(&osd->highlight->node,
+					x, layout.margin);
 			}
+			index++;
 		}
 
-		/* Text */
-		set_cairo_color(cairo, server->theme->osd_label_text_color);
-		PangoLayout *layout = pango_cairo_create_layout(cairo);
-		pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_END);
-
-		/* Center workspace indicator on the x axis */
-		int req_width = font_width(&rc.font_osd, server->workspace_current->name);
-		req_width = MIN(req_width, width - 2 * margin);
-		x = (width - req_width) / 2;
-		if (!hide_boxes) {
-			cairo_move_to(cairo, x, margin * 2 + rect_height);
-		} else {
-			cairo_move_to(cairo, x, (height - font_height(&rc.font_osd)) / 2.0);
-		}
-		PangoFontDescription *desc = font_to_pango_desc(&rc.font_osd);
-		//pango_font_description_set_weight(desc, PANGO_WEIGHT_BOLD);
-		pango_layout_set_font_description(layout, desc);
-		pango_layout_set_width(layout, req_width * PANGO_SCALE);
-		pango_font_description_free(desc);
-		pango_layout_set_text(layout, server->workspace_current->name, -1);
-		pango_cairo_show_layout(cairo, layout);
-
-		g_object_unref(layout);
-		surface = cairo_get_target(cairo);
-		cairo_surface_flush(surface);
-
-		if (!output->workspace_osd) {
-			output->workspace_osd = wlr_scene_buffer_create(
-				&server->scene->tree, NULL);
-		}
 		/* Position the whole thing */
 		struct wlr_box output_box;
 		wlr_output_layout_get_box(output->server->output_layout,
 			output->wlr_output, &output_box);
 		int lx = output->usable_area.x
-			+ (output->usable_area.width - width) / 2
+			+ (output->usable_area.width - osd->width) / 2
 			+ output_box.x;
 		int ly = output->usable_area.y
-			+ (output->usable_area.height - height) / 2
+			+ (output->usable_area.height - osd->height) / 2
 			+ output_box.y;
-		wlr_scene_node_set_position(&output->workspace_osd->node, lx, ly);
-		wlr_scene_buffer_set_buffer(output->workspace_osd, &buffer->base);
-		wlr_scene_buffer_set_dest_size(output->workspace_osd,
-			buffer->unscaled_width, buffer->unscaled_height);
+		wlr_scene_node_set_position(&osd->tree->node, lx, ly);
+	}
+}
 
-		/* And finally drop the buffer so it will get destroyed on OSD hide */
-		wlr_buffer_drop(&buffer->base);
+/*
+ * With <desktops><transitionTime> set, the old workspace slides out while
+ * the new one slides in. Only the positions of the two workspace trees
+ * are animated, so clients do not have to render anything. The animation
+ * is stepped from the output frame events; if these come in too late it
+ * jumps to the end rather than stuttering.
+ */
+#define WORKSPACE_TRANSITION_MAX_FRAME_MSEC (50)
+
+static int
+workspace_index(struct workspace *workspace)
+{
+	int index = 0;
+	struct workspace *iter;
+	wl_list_for_each(iter, &workspace->server->workspaces, link) {
+		if (iter == workspace) {
+			break;
+		}
+		index++;
 	}
+	return index;
+}
+
+static int
+_transition_handle_timeout(void *data)
+{
+	workspaces_transition_finish(data);
+	return 0;
+}
+
+static bool
+transition_start(struct workspace *from, struct workspace *to)
+{
+	struct server *server = from->server;
+	struct workspace_transition *transition = &server->workspace_transition;
+	if (!rc.workspace_config.transition_time) {
+		return false;
+	}
+
+	struct wlr_box layout_box;
+	wlr_output_layout_get_box(server->output_layout, NULL, &layout_box);
+	if (wlr_box_empty(&layout_box)) {
+		return false;
+	}
+
+	/* Workspaces further right in the list slide in from the right */
+	transition->distance = layout_box.width;
+	if (workspace_index(to) < workspace_index(from)) {
+		transition->distance = -layout_box.width;
+	}
+	transition->from = from;
+	transition->start_nsec = time_now_nsec();
+	transition->last_step_nsec = transition->start_nsec;
+	transition->duration_nsec =
+		rc.workspace_config.transition_time * NSEC_PER_MSEC;
+	wlr_scene_node_set_position(&to->tree->node, transition->distance, 0);
+
+	/* In case no frame events arrive at all */
+	if (!transition->timer) {
+		transition->timer = wl_event_loop_add_timer(
+			server->wl_event_loop, _transition_handle_timeout, server);
+	}
+	wl_event_source_timer_update(transition->timer,
+		rc.workspace_config.transition_time
+			+ WORKSPACE_TRANSITION_MAX_FRAME_MSEC);
+	return true;
 }
 
 /* Internal API */
@@ -179,6 +300,8 @@ add_workspace(struct server *server, const char *name)
 	workspace->server = server;
 	workspace->name = xstrdup(name);
 	workspace->tree = wlr_scene_tree_create(server->view_tree);
+	wl_list_init(&workspace->views);
+	workspace->tiling_layout = rc.tiling_layout;
 	wl_list_append(&server->workspaces, &workspace->link);
 	if (!server->workspace_current) {
 		server->workspace_current = workspace;
@@ -236,8 +359,9 @@ _osd_show(struct server *server)
 	_osd_update(server);
 	struct output *output;
 	wl_list_for_each(output, &server->outputs, link) {
-		if (output_is_usable(output) && output->workspace_osd) {
-			wlr_scene_node_set_enabled(&output->workspace_osd->node, true);
+		if (output_is_usable(output) && output->workspace_osd.tree) {
+			wlr_scene_node_set_enabled(
+				&output->workspace_osd.tree->node, true);
 		}
 	}
 	struct wlr_keyboard *keyboard = &server->seat.keyboard_group->keyboard;
@@ -280,29 +404,50 @@ workspaces_switch_to(struct workspace *target, bool update_focus)
 	if (target == server->workspace_current) {
 		return;
 	}
-
-	/* Disable the old workspace */
-	wlr_scene_node_set_enabled(
-		&server->workspace_current->tree->node, false);
+	workspaces_transition_finish(server);
+	struct workspace *from = server->workspace_current;
 
 	/* Move Omnipresent views to new workspace */
-	struct view *view;
-	enum lab_view_criteria criteria =
-		LAB_VIEW_CRITERIA_CURRENT_WORKSPACE;
-	for_each_view(view, &server->views, criteria) {
-		if (view->visible_on_all_workspaces) {
-			view_move_to_workspace(view, target);
+	struct view **view;
+	struct wl_array views;
+	wl_array_init(&views);
+	view_array_append(server, &views, LAB_VIEW_CRITERIA_CURRENT_WORKSPACE);
+	wl_array_for_each(view, &views) {
+		if ((*view)->visible_on_all_workspaces) {
+			view_move_to_workspace(*view, target);
 		}
 	}
 
-	/* Enable the new workspace */
+	/* Enable the new workspace and disable or slide out the old one */
 	wlr_scene_node_set_enabled(&target->tree->node, true);
+	if (!transition_start(from, target)) {
+		wlr_scene_node_set_enabled(&from->tree->node, false);
+	}
+	edges_invalidate(server, NULL);
 
 	/* Save the last visited workspace */
 	server->workspace_last = server->workspace_current;
 
 	/* Make sure new views will spawn on the new workspace */
 	server->workspace_current = target;
+	osd_invalidate_views(server);
+	/* The window switcher shows the name of the current workspace */
+	osd_invalidate_scene(server);
+	/* Fullscreen views of the old workspace are no longer shown */
+	adaptive_sync_update_all(server);
+	struct view *v;
+	wl_list_for_each(v, &server->views, link) {
+		ssd_update_visibility(v->ssd);
+	}
+
+#if HAVE_XWAYLAND
+	/*
+	 * Ensure xwayland internal stacking order corresponds to the current
+	 * workspace. This is done first so that raising the focused view
+	 * below does not need to restack it again.
+	 */
+	xwayland_adjust_stacking_order(server);
+#endif
 
 	/*
 	 * Make sure we are focusing what the user sees.
@@ -318,10 +463,6 @@ workspaces_switch_to(struct workspace *target, bool update_focus)
 	/* And finally show the OSD */
 	_osd_show(server);
 
-#if HAVE_XWAYLAND
-	/* Ensure xwayland internal stacking order corresponds to the current workspace  */
-	xwayland_adjust_stacking_order(server);
-#endif
 	/*
 	 * Make sure we are not carrying around a
 	 * cursor image from the previous desktop
@@ -332,6 +473,53 @@ workspaces_switch_to(struct workspace *target, bool update_focus)
 	desktop_update_top_layer_visiblity(server);
 }
 
+void
+workspaces_transition_update(struct server *server)
+{
+	struct workspace_transition *transition = &server->workspace_transition;
+	if (!transition->from) {
+		return;
+	}
+
+	int64_t now = time_now_nsec();
+	int64_t elapsed = now - transition->start_nsec;
+	int64_t max_frame_nsec =
+		WORKSPACE_TRANSITION_MAX_FRAME_MSEC * NSEC_PER_MSEC;
+	if (elapsed >= transition->duration_nsec
+			|| now - transition->last_step_nsec > max_frame_nsec) {
+		workspaces_transition_finish(server);
+		return;
+	}
+	transition->last_step_nsec = now;
+
+	/* Cubic ease-out */
+	double t = 1.0 - (double)elapsed / transition->duration_nsec;
+	int offset = transition->distance * t * t * t;
+	wlr_scene_node_set_position(&transition->from->tree->node,
+		offset - transition->distance, 0);
+	wlr_scene_node_set_position(&server->workspace_current->tree->node,
+		offset, 0);
+}
+
+void
+workspaces_transition_finish(struct server *server)
+{
+	struct workspace_transition *transition = &server->workspace_transition;
+	if (!transition->from) {
+		return;
+	}
+
+	wlr_scene_node_set_enabled(&transition->from->tree->node, false);
+	wlr_scene_node_set_position(&transition->from->tree->node, 0, 0);
+	wlr_scene_node_set_position(&server->workspace_current->tree->node,
+		0, 0);
+	transition->from = NULL;
+	wl_event_source_timer_update(transition->timer, 0);
+
+	edges_invalidate(server, NULL);
+	cursor_update_focus(server);
+}
+
 void
 workspaces_osd_hide(struct seat *seat)
 {
@@ -339,11 +527,10 @@ workspaces_osd_hide(struct seat *seat)
 	struct output *output;
 	struct server *server = seat->server;
 	wl_list_for_each(output, &server->outputs, link) {
-		if (!output->workspace_osd) {
-			continue;
+		if (output->workspace_osd.tree) {
+			wlr_scene_node_set_enabled(
+				&output->workspace_osd.tree->node, false);
 		}
-		wlr_scene_node_set_enabled(&output->workspace_osd->node, false);
-		wlr_scene_buffer_set_buffer(output->workspace_osd, NULL);
 	}
 	seat->workspace_osd_shown_by_modifier = false;
 
@@ -351,6 +538,33 @@ workspaces_osd_hide(struct seat *seat)
 	cursor_update_focus(server);
 }
 
+void
+workspaces_osd_invalidate(struct server *server)
+{
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		osd_scene_destroy(output);
+	}
+}
+
+void
+workspaces_osd_trim(struct server *server)
+{
+	struct output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		struct workspace_osd *osd = &output->workspace_osd;
+		if (osd->tree && !osd->tree->node.enabled) {
+			osd_scene_destroy(output);
+		}
+	}
+}
+
+void
+workspaces_osd_on_output_destroy(struct output *output)
+{
+	osd_scene_destroy(output);
+}
+
 struct workspace *
 workspaces_find(struct workspace *anchor, const char *name, bool wrap)
 {
@@ -391,6 +605,13 @@ workspaces_find(struct workspace *anchor, const char *name, bool wrap)
 void
 workspaces_destroy(struct server *server)
 {
+	struct workspace_transition *transition = &server->workspace_transition;
+	if (transition->timer) {
+		wl_event_source_remove(transition->timer);
+		transition->timer = NULL;
+	}
+	transition->from = NULL;
+
 	struct workspace *workspace, *tmp;
 	wl_list_for_each_safe(workspace, tmp, &server->workspaces, link) {
 		wlr_scene_node_destroy(&workspace->tree->node);
@@ -19,18 +19,52 @@ struct xdg_popup {
 	struct wl_listener commit;
 	struct wl_listener destroy;
 	struct wl_listener new_popup;
+	struct wl_listener reposition;
 };
 
+/*
+ * Returns the usable area (in layout coordinates) of the output at @lx,@ly.
+ *
+ * Menus open and close popups in quick succession, mostly on the output
+ * of the previous one, so the last result is kept with the view and only
+ * looked up again once the point is elsewhere or the outputs changed.
+ */
+static struct wlr_box
+get_constraint(struct view *view, int lx, int ly)
+{
+	struct server *server = view->server;
+	if (view->popup_constraint.generation == server->usable_area_generation
+			&& wlr_box_contains_point(
+				&view->popup_constraint.output_box, lx, ly)) {
+		return view->popup_constraint.usable;
+	}
+
+	struct output *output = output_nearest_to(server, lx, ly);
+	struct wlr_box output_box = {0};
+	if (output) {
+		wlr_output_layout_get_box(server->output_layout,
+			output->wlr_output, &output_box);
+	}
+	view->popup_constraint.generation = server->usable_area_generation;
+	view->popup_constraint.output_box = output_box;
+	view->popup_constraint.usable =
+		output_usable_area_in_layout_coords(output);
+	return view->popup_constraint.usable;
+}
+
 static void
 popup_unconstrain(struct xdg_popup *popup)
 {
 	struct view *view = popup->parent_view;
-	struct server *server = view->server;
-	struct wlr_box *popup_box = &popup->wlr_popup->current.geometry;
-	struct output *output = output_nearest_to(server,
-		view->current.x + popup_box->x,
-		view->current.y + popup_box->y);
-	struct wlr_box usable = output_usable_area_in_layout_coords(output);
+	/* Geometry about to be configured, also when repositioning */
+	struct wlr_box *popup_box = &popup->wlr_popup->scheduled.geometry;
+
+	/* Nested popups are positioned relative to their parent popup */
+	int toplevel_sx, toplevel_sy;
+	wlr_xdg_popup_get_toplevel_coords(popup->wlr_popup, popup_box->x,
+		popup_box->y, &toplevel_sx, &toplevel_sy);
+	struct wlr_box usable = get_constraint(view,
+		view->current.x + toplevel_sx, view->current.y + toplevel_sy);
 
 	struct wlr_box output_toplevel_box = {
 		.x = usable.x - view->current.x,
@@ -47,6 +81,7 @@ handle_xdg_popup_destroy(struct wl_listener *listener, void *data)
 	struct xdg_popup *popup = wl_container_of(listener, popup, destroy);
 	wl_list_remove(&popup->destroy.link);
 	wl_list_remove(&popup->new_popup.link);
+	wl_list_remove(&popup->reposition.link);
 
 	/* Usually already removed unless there was no commit at all */
 	if (popup->commit.notify) {
@@ -69,6 +104,13 @@ handle_xdg_popup_commit(struct wl_listener *listener, void *data)
 	}
 }
 
+static void
+handle_xdg_popup_reposition(struct wl_listener *listener, void *data)
+{
+	struct xdg_popup *popup = wl_container_of(listener, popup, reposition);
+	popup_unconstrain(popup);
+}
+
 static void
 popup_handle_new_xdg_popup(struct wl_listener *listener, void *data)
 {
@@ -97,6 +139,9 @@ xdg_popup_create(struct view *view, struct wlr_xdg_popup *wlr_popup)
 	popup->new_popup.notify = popup_handle_new_xdg_popup;
 	wl_signal_add(&wlr_popup->base->events.new_popup, &popup->new_popup);
 
+	popup->reposition.notify = handle_xdg_popup_reposition;
+	wl_signal_add(&wlr_popup->events.reposition, &popup->reposition);
+
 	popup->commit.notify = handle_xdg_popup_commit;
 	wl_signal_add(&wlr_popup->base->surface->events.commit, &popup->commit);
 
@@ -1,14 +1,22 @@
 // SPDX-License-Identifier: GPL-2.0-only
 
 #include <assert.h>
+#include <math.h>
+#include <stdio.h>
 #include <wlr/types/wlr_fractional_scale_v1.h>
 
 #include "common/macros.h"
 #include "common/mem.h"
+#include "common/time-helpers.h"
+#include "common/timers.h"
 #include "decorations.h"
+#include "edges.h"
 #include "labwc.h"
+#include "latency-trace.h"
+#include "metrics.h"
 #include "node.h"
 #include "snap-constraints.h"
+#include "trace.h"
 #include "view.h"
 #include "view-impl-common.h"
 #include "window-rules.h"
@@ -17,6 +25,103 @@
 #define LAB_XDG_SHELL_VERSION (2)
 #define CONFIGURE_TIMEOUT_MS 100
 
+/*
+ * Once a client has acked configures, its timeout is a multiple of its
+ * average round trip within these bounds. A responsive client which
+ * suddenly stops responding does then not hold up a batch of views for
+ * long, while a client which is known to be slow does not time out all
+ * the time. The upper bound is lower during an interactive resize of
+ * the view so that slow clients do not stall it.
+ */
+#define CONFIGURE_TIMEOUT_RTT_FACTOR 3
+#define CONFIGURE_TIMEOUT_MIN_MS 30
+#define CONFIGURE_TIMEOUT_MAX_MS 250
+#define CONFIGURE_TIMEOUT_RESIZE_MAX_MS CONFIGURE_TIMEOUT_MS
+
+/* Clients above this average round trip are logged as slow, once */
+#define CONFIGURE_SLOW_RTT_MS 50
+
+/*
+ * Views which have been configured together, for example when all views
+ * are re-arranged after an output layout change. Their new geometry is
+ * applied in one go once all of them have acknowledged their configure
+ * requests (or when the shared timeout expires), rather than each view
+ * waiting on its own timer and moving on its own.
+ */
+struct configure_batch {
+	int depth;      /* nesting of xdg_configure_batch_begin() */
+	int nr_waiting; /* views with an unacknowledged configure */
+	struct wl_list views; /* struct view.configure_batch.link */
+	struct lab_timer *timeout;
+};
+
+static int
+configure_timeout_ms(struct view *view)
+{
+	if (!view->configure_rtt.nr_samples) {
+		return CONFIGURE_TIMEOUT_MS;
+	}
+	int max_ms = CONFIGURE_TIMEOUT_MAX_MS;
+	if (view->server->input_mode == LAB_INPUT_STATE_RESIZE
+			&& view->server->grabbed_view == view) {
+		max_ms = CONFIGURE_TIMEOUT_RESIZE_MAX_MS;
+	}
+	int ms = CONFIGURE_TIMEOUT_RTT_FACTOR
+		* view->configure_rtt.avg_nsec / NSEC_PER_MSEC;
+	return MIN(MAX(ms, CONFIGURE_TIMEOUT_MIN_MS), max_ms);
+}
+
+/* Account a round trip, a timeout counting as a round trip of its length */
+static void
+configure_rtt_add(struct view *view, int64_t rtt)
+{
+	if (!view->configure_rtt.avg_nsec) {
+		view->configure_rtt.avg_nsec = rtt;
+	} else {
+		/* Exponential moving average with weight 1/8 */
+		view->configure_rtt.avg_nsec +=
+			(rtt - view->configure_rtt.avg_nsec) / 8;
+	}
+	view->configure_rtt.max_nsec = MAX(view->configure_rtt.max_nsec, rtt);
+	view->configure_rtt.nr_samples++;
+
+	int64_t slow_nsec = CONFIGURE_SLOW_RTT_MS * NSEC_PER_MSEC;
+	if (!view->configure_rtt.slow
+			&& view->configure_rtt.avg_nsec > slow_nsec) {
+		view->configure_rtt.slow = true;
+		wlr_log(WLR_INFO, "client (%s) is slow to respond to configure "
+			"requests, %.1f ms on average", view_get_app_id(view),
+			(double)view->configure_rtt.avg_nsec / NSEC_PER_MSEC);
+	} else if (view->configure_rtt.slow
+			&& view->configure_rtt.avg_nsec < slow_nsec / 2) {
+		view->configure_rtt.slow = false;
+	}
+}
+
+static void
+configure_acked(struct view *view)
+{
+	int64_t rtt = time_now_nsec() - view->configure_rtt.sent_nsec;
+	trace_async_end("configure", view->pending_configure_serial, "acked");
+	metrics_observe(METRICS_CONFIGURE_RTT, rtt);
+	configure_rtt_add(view, rtt);
+	view->pending_configure_serial = 0;
+}
+
+static void
+configure_timed_out(struct view *view)
+{
+	int64_t rtt = time_now_nsec() - view->configure_rtt.sent_nsec;
+	wlr_log(WLR_INFO, "client (%s) did not respond to configure request "
+		"in %d ms", view_get_app_id(view), (int)(rtt / NSEC_PER_MSEC));
+	metrics_count(METRICS_CONFIGURE_TIMEOUTS);
+	trace_async_end("configure", view->pending_configure_serial,
+		"timeout");
+	view->configure_rtt.nr_timeouts++;
+	configure_rtt_add(view, rtt);
+	view->pending_configure_serial = 0;
+}
+
 static struct xdg_toplevel_view *
 xdg_toplevel_view_from_view(struct view *view)
 {
@@ -57,7 +162,8 @@ static bool
 has_ssd(struct view *view)
 {
 	/* Window-rules take priority if they exist for this view */
-	switch (window_rules_get_property(view, "serverDecoration")) {
+	switch (window_rules_get_property(view,
+			LAB_RULE_PROP_SERVER_DECORATION)) {
 	case LAB_PROP_TRUE:
 		return true;
 	case LAB_PROP_FALSE:
@@ -84,12 +190,163 @@ has_ssd(struct view *view)
 	}
 }
 
+static void
+update_geometry(struct view *view, int width, int height)
+{
+	view_impl_apply_geometry(view, width, height);
+
+	/*
+	 * Some views (e.g., terminals that scale as multiples of rows
+	 * and columns, or windows that impose a fixed aspect ratio),
+	 * may respond to a resize but alter the width or height. When
+	 * this happens, view->pending will be out of sync with the
+	 * actual geometry (size *and* position, depending on the edge
+	 * from which the resize was attempted). When no other
+	 * configure is pending, re-sync the pending geometry with the
+	 * actual view.
+	 */
+	if (!view->pending_configure_serial) {
+		snap_constraints_update(view);
+		view->pending = view->current;
+
+		/*
+		 * wlroots retains the size set by any call to
+		 * wlr_xdg_toplevel_set_size and will send the retained
+		 * values with every subsequent configure request. If a
+		 * client has resized itself in the meantime, a
+		 * configure request that sends the now-outdated size
+		 * may prompt the client to resize itself unexpectedly.
+		 *
+		 * Calling wlr_xdg_toplevel_set_size to update the
+		 * value held by wlroots is undesirable here, because
+		 * that will trigger another configure event and we
+		 * don't want to get stuck in a request-response loop.
+		 * Instead, just manipulate the dimensions that *would*
+		 * be adjusted by the call, so the right values will
+		 * apply next time.
+		 *
+		 * This is not ideal, but it is the cleanest option.
+		 */
+		struct wlr_xdg_toplevel *toplevel =
+			xdg_toplevel_from_view(view);
+		toplevel->scheduled.width = view->current.width;
+		toplevel->scheduled.height = view->current.height;
+	}
+}
+
+static void
+configure_batch_apply(struct configure_batch *batch)
+{
+	struct view *view, *tmp;
+	wl_list_for_each_safe(view, tmp, &batch->views, configure_batch.link) {
+		wl_list_remove(&view->configure_batch.link);
+		view->configure_batch.batch = NULL;
+		if (!view->configure_batch.acked) {
+			configure_timed_out(view);
+		}
+		update_geometry(view, view->configure_batch.width,
+			view->configure_batch.height);
+	}
+
+	if (batch->timeout) {
+		timers_remove(batch->timeout);
+	}
+	free(batch);
+}
+
+static int
+handle_configure_batch_timeout(void *data)
+{
+	configure_batch_apply(data);
+	return 0; /* ignored per wl_event_loop docs */
+}
+
+static void
+configure_batch_add(struct configure_batch *batch, struct view *view,
+		bool acked)
+{
+	view->configure_batch.batch = batch;
+	view->configure_batch.acked = acked;
+	view->configure_batch.width = view->current.width;
+	view->configure_batch.height = view->current.height;
+	wl_list_append(&batch->views, &view->configure_batch.link);
+	if (!acked) {
+		batch->nr_waiting++;
+	}
+}
+
+static void
+configure_batch_ack(struct view *view)
+{
+	struct configure_batch *batch = view->configure_batch.batch;
+	assert(!view->configure_batch.acked);
+	view->configure_batch.acked = true;
+	if (!--batch->nr_waiting && !batch->depth) {
+		configure_batch_apply(batch);
+	}
+}
+
+static void
+configure_batch_remove(struct view *view)
+{
+	struct configure_batch *batch = view->configure_batch.batch;
+	wl_list_remove(&view->configure_batch.link);
+	view->configure_batch.batch = NULL;
+	if (!view->configure_batch.acked && !--batch->nr_waiting
+			&& !batch->depth) {
+		configure_batch_apply(batch);
+	}
+}
+
+void
+xdg_configure_batch_begin(struct server *server)
+{
+	if (!server->configure_batch) {
+		struct configure_batch *batch = znew(*batch);
+		wl_list_init(&batch->views);
+		server->configure_batch = batch;
+	}
+	server->configure_batch->depth++;
+}
+
+void
+xdg_configure_batch_end(struct server *server)
+{
+	struct configure_batch *batch = server->configure_batch;
+	assert(batch && batch->depth > 0);
+	if (--batch->depth) {
+		return;
+	}
+	server->configure_batch = NULL;
+
+	if (!batch->nr_waiting) {
+		configure_batch_apply(batch);
+		return;
+	}
+
+	/* Wait as long as the slowest of the views would on its own */
+	int timeout_ms = 0;
+	struct view *view;
+	wl_list_for_each(view, &batch->views, configure_batch.link) {
+		if (!view->configure_batch.acked) {
+			timeout_ms = MAX(timeout_ms,
+				view->configure_rtt.timeout_ms);
+		}
+	}
+	batch->timeout = timers_add(server->wl_event_loop,
+		handle_configure_batch_timeout, batch);
+	timers_update(batch->timeout, timeout_ms);
+}
+
 static void
 handle_commit(struct wl_listener *listener, void *data)
 {
 	struct view *view = wl_container_of(listener, view, commit);
 	struct wlr_xdg_surface *xdg_surface = xdg_surface_from_view(view);
 	assert(view->surface);
+	adaptive_sync_view_commit(view);
+	edges_view_commit(view);
+	view_count_commit(view);
 
 	struct wlr_box size;
 	wlr_xdg_surface_get_geometry(xdg_surface, &size);
@@ -110,67 +367,49 @@ handle_commit(struct wl_listener *listener, void *data)
 				&& extent.height == view->pending.height) {
 			wlr_log(WLR_DEBUG, "window geometry for client (%s) "
 				"appears to be incorrect - ignoring",
-				view_get_string_prop(view, "app_id"));
+				view_get_app_id(view));
 			size = extent; /* Use surface extent instead */
 		}
 	}
 
+	uint32_t serial = view->pending_configure_serial;
+	bool acked = serial > 0
+		&& serial == xdg_surface->current.configure_serial;
+
+	if (view->configure_batch.batch) {
+		/* Geometry is applied together with the rest of the batch */
+		view->configure_batch.width = size.width;
+		view->configure_batch.height = size.height;
+		if (acked) {
+			configure_acked(view);
+			configure_batch_ack(view);
+			interactive_configure_done(view);
+		}
+		return;
+	}
+
 	struct wlr_box *current = &view->current;
 	bool update_required = current->width != size.width
 		|| current->height != size.height;
 
-	uint32_t serial = view->pending_configure_serial;
-	if (serial > 0 && serial == xdg_surface->current.configure_serial) {
+	if (acked) {
 		assert(view->pending_configure_timeout);
-		wl_event_source_remove(view->pending_configure_timeout);
-		view->pending_configure_serial = 0;
+		configure_acked(view);
+		timers_remove(view->pending_configure_timeout);
 		view->pending_configure_timeout = NULL;
 		update_required = true;
 	}
 
 	if (update_required) {
-		view_impl_apply_geometry(view, size.width, size.height);
-
-		/*
-		 * Some views (e.g., terminals that scale as multiples of rows
-		 * and columns, or windows that impose a fixed aspect ratio),
-		 * may respond to a resize but alter the width or height. When
-		 * this happens, view->pending will be out of sync with the
-		 * actual geometry (size *and* position, depending on the edge
-		 * from which the resize was attempted). When no other
-		 * configure is pending, re-sync the pending geometry with the
-		 * actual view.
-		 */
-		if (!view->pending_configure_serial) {
-			snap_constraints_update(view);
-			view->pending = view->current;
-
-			/*
-			 * wlroots retains the size set by any call to
-			 * wlr_xdg_toplevel_set_size and will send the retained
-			 * values with every subsequent configure request. If a
-			 * client has resized itself in the meantime, a
-			 * configure request that sends the now-outdated size
-			 * may prompt the client to resize itself unexpectedly.
-			 *
-			 * Calling wlr_xdg_toplevel_set_size to update the
-			 * value held by wlroots is undesirable here, because
-			 * that will trigger another configure event and we
-			 * don't want to get stuck in a request-response loop.
-			 * Instead, just manipulate the dimensions that *would*
-			 * be adjusted by the call, so the right values will
-			 * apply next time.
-			 *
-			 * This is not ideal, but it is the cleanest option.
-			 */
-			struct wlr_xdg_toplevel *toplevel =
-				xdg_toplevel_from_view(view);
-			toplevel->scheduled.width = view->current.width;
-			toplevel->scheduled.height = view->current.height;
-		}
+		update_geometry(view, size.width, size.height);
+	}
+	if (acked) {
+		interactive_configure_done(view);
 	}
 }
 
+LATENCY_TRACE_LISTENER(handle_commit)
+
 static int
 handle_configure_timeout(void *data)
 {
@@ -178,12 +417,8 @@ handle_configure_timeout(void *data)
 	assert(view->pending_configure_serial > 0);
 	assert(view->pending_configure_timeout);
 
-	const char *app_id = view_get_string_prop(view, "app_id");
-	wlr_log(WLR_INFO, "client (%s) did not respond to configure request "
-		"in %d ms", app_id, CONFIGURE_TIMEOUT_MS);
-
-	wl_event_source_remove(view->pending_configure_timeout);
-	view->pending_configure_serial = 0;
+	configure_timed_out(view);
+	timers_remove(view->pending_configure_timeout);
 	view->pending_configure_timeout = NULL;
 
 	view_impl_apply_geometry(view,
@@ -193,20 +428,45 @@ handle_configure_timeout(void *data)
 	snap_constraints_update(view);
 	view->pending = view->current;
 
+	interactive_configure_done(view);
+
 	return 0; /* ignored per wl_event_loop docs */
 }
 
 static void
 set_pending_configure_serial(struct view *view, uint32_t serial)
 {
+	if (view->pending_configure_serial) {
+		trace_async_end("configure", view->pending_configure_serial,
+			"superseded");
+	}
+	trace_async_begin("configure", serial, view_get_app_id(view));
 	view->pending_configure_serial = serial;
+	view->configure_rtt.sent_nsec = time_now_nsec();
+	view->configure_rtt.timeout_ms = configure_timeout_ms(view);
+
+	struct configure_batch *batch = view->configure_batch.batch;
+	if (batch) {
+		/* Already part of a batch, wait for the new serial instead */
+		if (view->configure_batch.acked) {
+			view->configure_batch.acked = false;
+			batch->nr_waiting++;
+		}
+		return;
+	}
+	batch = view->server->configure_batch;
+	if (batch && !view->pending_configure_timeout) {
+		configure_batch_add(batch, view, /* acked */ false);
+		return;
+	}
+
 	if (!view->pending_configure_timeout) {
 		view->pending_configure_timeout =
-			wl_event_loop_add_timer(view->server->wl_event_loop,
+			timers_add(view->server->wl_event_loop,
 				handle_configure_timeout, view);
 	}
-	wl_event_source_timer_update(view->pending_configure_timeout,
-		CONFIGURE_TIMEOUT_MS);
+	timers_update(view->pending_configure_timeout,
+		view->configure_rtt.timeout_ms);
 }
 
 static void
@@ -222,12 +482,16 @@ handle_destroy(struct wl_listener *listener, void *data)
 
 	/* Remove xdg-shell view specific listeners */
 	wl_list_remove(&xdg_toplevel_view->set_app_id.link);
+	wl_list_remove(&xdg_toplevel_view->set_parent.link);
 	wl_list_remove(&xdg_toplevel_view->new_popup.link);
 
 	if (view->pending_configure_timeout) {
-		wl_event_source_remove(view->pending_configure_timeout);
+		timers_remove(view->pending_configure_timeout);
 		view->pending_configure_timeout = NULL;
 	}
+	if (view->configure_batch.batch) {
+		configure_batch_remove(view);
+	}
 
 	view_destroy(view);
 }
@@ -325,6 +589,16 @@ handle_set_app_id(struct wl_listener *listener, void *data)
 	view_update_app_id(view);
 }
 
+static void
+handle_set_parent(struct wl_listener *listener, void *data)
+{
+	struct xdg_toplevel_view *xdg_toplevel_view =
+		wl_container_of(listener, xdg_toplevel_view, set_parent);
+	struct view *view = &xdg_toplevel_view->base;
+	struct wlr_xdg_toplevel *parent = xdg_toplevel_from_view(view)->parent;
+	view_set_parent(view, parent ? parent->base->data : NULL);
+}
+
 static void
 xdg_toplevel_view_configure(struct view *view, struct wlr_box geo)
 {
@@ -346,10 +620,17 @@ xdg_toplevel_view_configure(struct view *view, struct wlr_box geo)
 	view->pending = geo;
 	if (serial > 0) {
 		set_pending_configure_serial(view, serial);
-	} else if (view->pending_configure_serial == 0) {
-		view->current.x = geo.x;
-		view->current.y = geo.y;
-		view_moved(view);
+	} else if (view->pending_configure_serial == 0
+			&& !view->configure_batch.batch) {
+		if (view->server->configure_batch) {
+			/* Move together with the rest of the batch */
+			configure_batch_add(view->server->configure_batch,
+				view, /* acked */ true);
+		} else {
+			view->current.x = geo.x;
+			view->current.y = geo.y;
+			view_moved(view);
+		}
 	}
 }
 
@@ -371,48 +652,12 @@ xdg_toplevel_view_minimize(struct view *view, bool minimized)
 	/* noop */
 }
 
-static struct wlr_xdg_toplevel *
-top_parent_of(struct view *view)
-{
-	struct wlr_xdg_toplevel *toplevel = xdg_toplevel_from_view(view);
-	while (toplevel->parent) {
-		toplevel = toplevel->parent;
-	}
-	return toplevel;
-}
-
-/* Return the most senior parent (=root) view */
-static struct view *
-xdg_toplevel_view_get_root(struct view *view)
-{
-	struct wlr_xdg_toplevel *root = top_parent_of(view);
-	struct wlr_xdg_surface *surface = (struct wlr_xdg_surface *)root->base;
-	return (struct view *)surface->data;
-}
-
 static void
-xdg_toplevel_view_append_children(struct view *self, struct wl_array *children)
+xdg_toplevel_view_notify_scale(struct view *view, double scale)
 {
-	struct wlr_xdg_toplevel *toplevel = xdg_toplevel_from_view(self);
-	struct view *view;
-
-	wl_list_for_each_reverse(view, &self->server->views, link)
-	{
-		if (view == self) {
-			continue;
-		}
-		if (view->type != LAB_XDG_SHELL_VIEW) {
-			continue;
-		}
-		if (!view->mapped && !view->minimized) {
-			continue;
-		}
-		if (top_parent_of(view) != toplevel) {
-			continue;
-		}
-		struct view **child = wl_array_add(children, sizeof(*child));
-		*child = view;
-	}
+	struct wlr_surface *surface = xdg_surface_from_view(view)->surface;
+	wlr_fractional_scale_v1_notify_scale(surface, scale);
+	wlr_surface_set_preferred_buffer_scale(surface, ceil(scale));
 }
 
 static void
@@ -619,7 +864,7 @@ xdg_toplevel_view_map(struct view *view)
 		view_moved(view);
 	}
 
-	view->commit.notify = handle_commit;
+	view->commit.notify = handle_commit_traced;
 	wl_signal_add(&xdg_surface->surface->events.commit, &view->commit);
 
 	view_impl_map(view);
@@ -650,8 +895,7 @@ static const struct view_impl xdg_toplevel_view_impl = {
 	.minimize = xdg_toplevel_view_minimize,
 	.move_to_front = view_impl_move_to_front,
 	.move_to_back = view_impl_move_to_back,
-	.get_root = xdg_toplevel_view_get_root,
-	.append_children = xdg_toplevel_view_append_children,
+	.notify_scale = xdg_toplevel_view_notify_scale,
 };
 
 static void
@@ -682,7 +926,8 @@ xdg_activation_handle_request(struct wl_listener *listener, void *data)
 	 * for the seat / serial being correct and then allow the request.
 	 */
 
-	if (window_rules_get_property(view, "ignoreFocusRequest") == LAB_PROP_TRUE) {
+	if (window_rules_get_property(view,
+			LAB_RULE_PROP_IGNORE_FOCUS_REQUEST) == LAB_PROP_TRUE) {
 		wlr_log(WLR_INFO, "Ignoring focus request due to window rule configuration");
 		return;
 	}
@@ -729,14 +974,12 @@ xdg_surface_new(struct wl_listener *listener, void *data)
 	 * the chance to configure itself (and possibly pick its dimensions).
 	 */
 	view_set_output(view, output_nearest_to_cursor(server));
-	if (view->output) {
-		wlr_fractional_scale_v1_notify_scale(xdg_surface->surface,
-			view->output->wlr_output->scale);
-	}
 
 	view->workspace = server->workspace_current;
 	view->scene_tree = wlr_scene_tree_create(view->workspace->tree);
 	wlr_scene_node_set_enabled(&view->scene_tree->node, false);
+	wl_list_init(&view->children);
+	wl_list_init(&view->child_link);
 
 	struct wlr_scene_tree *tree = wlr_scene_xdg_surface_create(
 		view->scene_tree, xdg_surface);
@@ -792,9 +1035,36 @@ xdg_surface_new(struct wl_listener *listener, void *data)
 
 	/* Events specific to XDG toplevel views */
 	CONNECT_SIGNAL(toplevel, xdg_toplevel_view, set_app_id);
+	CONNECT_SIGNAL(toplevel, xdg_toplevel_view, set_parent);
 	CONNECT_SIGNAL(xdg_surface, xdg_toplevel_view, new_popup);
 
-	wl_list_insert(&server->views, &view->link);
+	view_stack_insert(view, /* front */ true);
+}
+
+LATENCY_TRACE_LISTENER(xdg_surface_new)
+
+void
+xdg_print_configure_stats(struct server *server)
+{
+	printf("Configure round trips\n");
+	printf("   %-24s %8s %8s %8s %8s %8s\n", "app_id", "avg (ms)",
+		"max (ms)", "samples", "timeouts", "timeout");
+	struct view *view;
+	wl_list_for_each(view, &server->views, link) {
+		if (view->type != LAB_XDG_SHELL_VIEW) {
+			continue;
+		}
+		const char *app_id = view_get_app_id(view);
+		printf("   %-24.24s %8.3f %8.3f %8u %8u %8d%s\n",
+			app_id && *app_id ? app_id : "-",
+			(double)view->configure_rtt.avg_nsec / NSEC_PER_MSEC,
+			(double)view->configure_rtt.max_nsec / NSEC_PER_MSEC,
+			view->configure_rtt.nr_samples,
+			view->configure_rtt.nr_timeouts,
+			configure_timeout_ms(view),
+			view->configure_rtt.slow ? "  slow" : "");
+	}
+	printf("\n");
 }
 
 void
@@ -806,7 +1076,7 @@ xdg_shell_init(struct server *server)
 		wlr_log(WLR_ERROR, "unable to create the XDG shell interface");
 		exit(EXIT_FAILURE);
 	}
-	server->new_xdg_surface.notify = xdg_surface_new;
+	server->new_xdg_surface.notify = xdg_surface_new_traced;
 	wl_signal_add(&server->xdg_shell->events.new_surface, &server->new_xdg_surface);
 
 	server->xdg_activation = wlr_xdg_activation_v1_create(server->wl_display);
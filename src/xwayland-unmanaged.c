@@ -1,5 +1,6 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #include <assert.h>
+#include <wlr/util/box.h>
 #include <wlr/xwayland.h>
 #include "common/list.h"
 #include "common/macros.h"
@@ -7,6 +8,33 @@
 #include "labwc.h"
 #include "xwayland.h"
 
+/*
+ * Pointer focus can only change if the cursor is above the surface or
+ * the surface had pointer focus before. Skip the scene lookup of
+ * cursor_update_focus() for tooltips and menus showing up elsewhere.
+ */
+static void
+update_cursor_focus(struct xwayland_unmanaged *unmanaged,
+		struct wlr_box *old_box)
+{
+	struct server *server = unmanaged->server;
+	struct wlr_xwayland_surface *xsurface = unmanaged->xwayland_surface;
+	struct wlr_cursor *cursor = server->seat.cursor;
+	struct wlr_box box = {
+		.x = xsurface->x,
+		.y = xsurface->y,
+		.width = xsurface->width,
+		.height = xsurface->height,
+	};
+
+	if (server->seat.seat->pointer_state.focused_surface == xsurface->surface
+			|| wlr_box_contains_point(&box, cursor->x, cursor->y)
+			|| (old_box && wlr_box_contains_point(old_box,
+				cursor->x, cursor->y))) {
+		cursor_update_focus(server);
+	}
+}
+
 static void
 handle_request_configure(struct wl_listener *listener, void *data)
 {
@@ -14,10 +42,16 @@ handle_request_configure(struct wl_listener *listener, void *data)
 		wl_container_of(listener, unmanaged, request_configure);
 	struct wlr_xwayland_surface *xsurface = unmanaged->xwayland_surface;
 	struct wlr_xwayland_surface_configure_event *ev = data;
+	struct wlr_box old_box = {
+		.x = xsurface->x,
+		.y = xsurface->y,
+		.width = xsurface->width,
+		.height = xsurface->height,
+	};
 	wlr_xwayland_surface_configure(xsurface, ev->x, ev->y, ev->width, ev->height);
 	if (unmanaged->node) {
 		wlr_scene_node_set_position(unmanaged->node, ev->x, ev->y);
-		cursor_update_focus(unmanaged->server);
+		update_cursor_focus(unmanaged, &old_box);
 	}
 }
 
@@ -28,8 +62,14 @@ handle_set_geometry(struct wl_listener *listener, void *data)
 		wl_container_of(listener, unmanaged, set_geometry);
 	struct wlr_xwayland_surface *xsurface = unmanaged->xwayland_surface;
 	if (unmanaged->node) {
+		struct wlr_box old_box = {
+			.x = unmanaged->node->x,
+			.y = unmanaged->node->y,
+			.width = xsurface->width,
+			.height = xsurface->height,
+		};
 		wlr_scene_node_set_position(unmanaged->node, xsurface->x, xsurface->y);
-		cursor_update_focus(unmanaged->server);
+		update_cursor_focus(unmanaged, &old_box);
 	}
 }
 
@@ -48,6 +88,8 @@ handle_map(struct wl_listener *listener, void *data)
 	CONNECT_SIGNAL(xsurface, unmanaged, set_geometry);
 
 	if (wlr_xwayland_or_surface_wants_focus(xsurface)) {
+		wl_list_append(&unmanaged->server->unmanaged_focus_stack,
+			&unmanaged->focus_link);
 		seat_focus_surface(&unmanaged->server->seat, xsurface->surface);
 	}
 
@@ -56,21 +98,21 @@ handle_map(struct wl_listener *listener, void *data)
 			unmanaged->server->unmanaged_tree,
 			xsurface->surface)->buffer->node;
 	wlr_scene_node_set_position(unmanaged->node, xsurface->x, xsurface->y);
-	cursor_update_focus(unmanaged->server);
+	update_cursor_focus(unmanaged, NULL);
 }
 
 static void
 focus_next_surface(struct server *server, struct wlr_xwayland_surface *xsurface)
 {
-	/* Try to focus on last created unmanaged xwayland surface */
-	struct xwayland_unmanaged *u;
-	struct wl_list *list = &server->unmanaged_surfaces;
-	wl_list_for_each_reverse(u, list, link) {
-		struct wlr_xwayland_surface *prev = u->xwayland_surface;
-		if (wlr_xwayland_or_surface_wants_focus(prev)) {
-			seat_focus_surface(&server->seat, prev->surface);
-			return;
-		}
+	/*
+	 * Try to focus on last created unmanaged xwayland surface. Only
+	 * surfaces wanting focus are on the stack, so this is O(1).
+	 */
+	if (!wl_list_empty(&server->unmanaged_focus_stack)) {
+		struct xwayland_unmanaged *u = wl_container_of(
+			server->unmanaged_focus_stack.prev, u, focus_link);
+		seat_focus_surface(&server->seat, u->xwayland_surface->surface);
+		return;
 	}
 
 	/*
@@ -91,6 +133,8 @@ handle_unmap(struct wl_listener *listener, void *data)
 	assert(unmanaged->node);
 
 	wl_list_remove(&unmanaged->link);
+	wl_list_remove(&unmanaged->focus_link);
+	wl_list_init(&unmanaged->focus_link);
 	wl_list_remove(&unmanaged->set_geometry.link);
 	wlr_scene_node_set_enabled(unmanaged->node, false);
 
@@ -99,7 +143,7 @@ handle_unmap(struct wl_listener *listener, void *data)
 	 * won't try to reposition the node while unmapped.
 	 */
 	unmanaged->node = NULL;
-	cursor_update_focus(unmanaged->server);
+	update_cursor_focus(unmanaged, NULL);
 
 	if (seat->seat->keyboard_state.focused_surface == xsurface->surface) {
 		focus_next_surface(unmanaged->server, xsurface);
@@ -214,6 +258,7 @@ xwayland_unmanaged_create(struct server *server,
 	struct xwayland_unmanaged *unmanaged = znew(*unmanaged);
 	unmanaged->server = server;
 	unmanaged->xwayland_surface = xsurface;
+	wl_list_init(&unmanaged->focus_link);
 	/*
 	 * xsurface->data is presumed to be a (struct view *) if set,
 	 * so it must be left NULL for an unmanaged surface (it should
@@ -1,13 +1,23 @@
 // SPDX-License-Identifier: GPL-2.0-only
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <errno.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 #include <wlr/xwayland.h>
 #include "common/array.h"
 #include "common/macros.h"
 #include "common/mem.h"
+#include "common/time-helpers.h"
+#include "common/timers.h"
+#include "edges.h"
 #include "labwc.h"
+#include "latency-trace.h"
 #include "node.h"
+#include "profile.h"
 #include "ssd.h"
 #include "view.h"
 #include "view-impl-common.h"
@@ -15,9 +25,29 @@
 #include "workspaces.h"
 #include "xwayland.h"
 
+/* Max time to wait for the commit after a resize before sending more */
+#define CONFIGURE_TIMEOUT_MS 100
+
 xcb_atom_t atoms[ATOM_LEN] = {0};
 
+/* Set while xwayland_adjust_stacking_order() restacks all views */
+static bool restack_deferred;
+
+/* Nesting of xwayland_restack_begin() */
+static int restack_batch_depth;
+static bool restack_unmanaged_pending;
+
+/* Start of Xwayland, also see <core><xwaylandStart> */
+static struct {
+	struct wl_event_source *delay_timer;
+	/* When the start was triggered by labwc, 0 in lazy mode */
+	int64_t start_nsec;
+	int64_t server_ready_nsec;
+} xwayland_start;
+
 static void xwayland_view_unmap(struct view *view, bool client_request);
+static struct xwayland_view *xwayland_view_from_view(struct view *view);
+static void xwayland_view_configure(struct view *view, struct wlr_box geo);
 
 bool
 xwayland_surface_contains_window_type(
@@ -32,6 +62,23 @@ xwayland_surface_contains_window_type(
 	return false;
 }
 
+static void
+xwayland_view_update_props(struct xwayland_view *xwayland_view)
+{
+	struct wlr_xwayland_surface *xsurface = xwayland_view->xwayland_surface;
+
+	xwayland_view->window_types = 0;
+	for (size_t i = 0; i < xsurface->window_type_len; i++) {
+		for (size_t j = 0; j < ATOM_LEN; j++) {
+			if (xsurface->window_type[i] == atoms[j]) {
+				xwayland_view->window_types |= 1u << j;
+				break;
+			}
+		}
+	}
+	xwayland_view->input_model = wlr_xwayland_icccm_input_model(xsurface);
+}
+
 static struct view_size_hints
 xwayland_view_get_size_hints(struct view *view)
 {
@@ -52,10 +99,9 @@ xwayland_view_get_size_hints(struct view *view)
 static enum view_wants_focus
 xwayland_view_wants_focus(struct view *view)
 {
-	struct wlr_xwayland_surface *xsurface =
-		xwayland_surface_from_view(view);
+	struct xwayland_view *xwayland_view = xwayland_view_from_view(view);
 
-	switch (wlr_xwayland_icccm_input_model(xsurface)) {
+	switch (xwayland_view->input_model) {
 	/*
 	 * Abbreviated from ICCCM section 4.1.7 (Input Focus):
 	 *
@@ -96,9 +142,9 @@ xwayland_view_wants_focus(struct view *view)
 		 * Alt-Tab switcher and be automatically focused when
 		 * they become topmost.
 		 */
-		return (xwayland_surface_contains_window_type(xsurface,
+		return (xwayland_view_has_window_type(xwayland_view,
 				NET_WM_WINDOW_TYPE_NORMAL)
-			|| xwayland_surface_contains_window_type(xsurface,
+			|| xwayland_view_has_window_type(xwayland_view,
 				NET_WM_WINDOW_TYPE_DIALOG)) ?
 			VIEW_WANTS_FOCUS_ALWAYS : VIEW_WANTS_FOCUS_OFFER;
 
@@ -124,16 +170,6 @@ xwayland_view_has_strut_partial(struct view *view)
 	return (bool)xsurface->strut_partial;
 }
 
-static struct wlr_xwayland_surface *
-top_parent_of(struct view *view)
-{
-	struct wlr_xwayland_surface *s = xwayland_surface_from_view(view);
-	while (s->parent) {
-		s = s->parent;
-	}
-	return s;
-}
-
 static struct xwayland_view *
 xwayland_view_from_view(struct view *view)
 {
@@ -182,7 +218,8 @@ want_deco(struct wlr_xwayland_surface *xwayland_surface)
 	struct view *view = (struct view *)xwayland_surface->data;
 
 	/* Window-rules take priority if they exist for this view */
-	switch (window_rules_get_property(view, "serverDecoration")) {
+	switch (window_rules_get_property(view,
+			LAB_RULE_PROP_SERVER_DECORATION)) {
 	case LAB_PROP_TRUE:
 		return true;
 	case LAB_PROP_FALSE:
@@ -195,11 +232,41 @@ want_deco(struct wlr_xwayland_surface *xwayland_surface)
 		WLR_XWAYLAND_SURFACE_DECORATIONS_ALL;
 }
 
+/* Stop waiting for the commit and send any geometry queued meanwhile */
+static void
+configure_done(struct xwayland_view *xwayland_view)
+{
+	struct view *view = &xwayland_view->base;
+	if (wlr_box_empty(&xwayland_view->configure_inflight)) {
+		return;
+	}
+	xwayland_view->configure_inflight = (struct wlr_box){0};
+	timers_update(xwayland_view->configure_timeout, 0);
+	if (xwayland_view->configure_queued) {
+		xwayland_view->configure_queued = false;
+		xwayland_view_configure(view, view->pending);
+	}
+}
+
+static int
+handle_configure_timeout(void *data)
+{
+	struct xwayland_view *xwayland_view = data;
+	wlr_log(WLR_DEBUG, "client (%s) did not commit configure in %d ms",
+		view_get_app_id(&xwayland_view->base),
+		CONFIGURE_TIMEOUT_MS);
+	configure_done(xwayland_view);
+	return 0;
+}
+
 static void
 handle_commit(struct wl_listener *listener, void *data)
 {
 	struct view *view = wl_container_of(listener, view, commit);
 	assert(data && data == view->surface);
+	adaptive_sync_view_commit(view);
+	edges_view_commit(view);
+	view_count_commit(view);
 
 	/* Must receive commit signal before accessing surface->current* */
 	struct wlr_surface_state *state = &view->surface->current;
@@ -213,9 +280,16 @@ handle_commit(struct wl_listener *listener, void *data)
 	 */
 	if (current->width != state->width || current->height != state->height) {
 		view_impl_apply_geometry(view, state->width, state->height);
+		/*
+		 * The client may have adjusted the size to its hints,
+		 * so any resize counts as the reply to the configure.
+		 */
+		configure_done(xwayland_view_from_view(view));
 	}
 }
 
+LATENCY_TRACE_LISTENER(handle_commit)
+
 static void
 handle_request_move(struct wl_listener *listener, void *data)
 {
@@ -331,14 +405,57 @@ handle_destroy(struct wl_listener *listener, void *data)
 	wl_list_remove(&xwayland_view->set_override_redirect.link);
 	wl_list_remove(&xwayland_view->set_strut_partial.link);
 	wl_list_remove(&xwayland_view->set_window_type.link);
+	wl_list_remove(&xwayland_view->set_hints.link);
+	wl_list_remove(&xwayland_view->set_parent.link);
+
+	if (xwayland_view->configure_timeout) {
+		timers_remove(xwayland_view->configure_timeout);
+		xwayland_view->configure_timeout = NULL;
+	}
 
 	view_destroy(view);
 }
 
+/*
+ * Clients spamming configure requests during a live resize would get
+ * each of their requests echoed back immediately, feeding a loop of
+ * view_adjust_size() and configures. Keep at most one resize in flight
+ * and merge further resizes into view->pending until it is committed.
+ * Position-only changes, relative to either the resize in flight or the
+ * current size, are never held back.
+ */
 static void
 xwayland_view_configure(struct view *view, struct wlr_box geo)
 {
+	struct xwayland_view *xwayland_view = xwayland_view_from_view(view);
+	struct wlr_box *inflight = &xwayland_view->configure_inflight;
 	view->pending = geo;
+
+	if (!wlr_box_empty(inflight)) {
+		bool inflight_size = geo.width == inflight->width
+			&& geo.height == inflight->height;
+		bool current_size = geo.width == view->current.width
+			&& geo.height == view->current.height;
+		if (!inflight_size && !current_size) {
+			xwayland_view->configure_queued = true;
+			return;
+		}
+		xwayland_view->configure_queued = false;
+		if (inflight_size) {
+			/* Moved along, applied with the commit of the resize */
+			if (!wlr_box_equal(&geo, inflight)) {
+				wlr_xwayland_surface_configure(
+					xwayland_surface_from_view(view),
+					geo.x, geo.y, geo.width, geo.height);
+				*inflight = geo;
+			}
+			return;
+		}
+		/* Back to the current size, the move is applied below */
+		*inflight = (struct wlr_box){0};
+		timers_update(xwayland_view->configure_timeout, 0);
+	}
+
 	wlr_xwayland_surface_configure(xwayland_surface_from_view(view),
 		geo.x, geo.y, geo.width, geo.height);
 
@@ -359,7 +476,20 @@ xwayland_view_configure(struct view *view, struct wlr_box geo)
 		view->current.x = geo.x;
 		view->current.y = geo.y;
 		view_moved(view);
+		return;
 	}
+
+	/* Unmapped surfaces do not commit, so there is nothing to wait for */
+	if (!view->mapped) {
+		return;
+	}
+	xwayland_view->configure_inflight = geo;
+	if (!xwayland_view->configure_timeout) {
+		xwayland_view->configure_timeout = timers_add(
+			view->server->wl_event_loop,
+			handle_configure_timeout, xwayland_view);
+	}
+	timers_update(xwayland_view->configure_timeout, CONFIGURE_TIMEOUT_MS);
 }
 
 static void
@@ -387,6 +517,8 @@ handle_request_configure(struct wl_listener *listener, void *data)
 	}
 }
 
+LATENCY_TRACE_LISTENER(handle_request_configure)
+
 static void
 handle_request_activate(struct wl_listener *listener, void *data)
 {
@@ -394,7 +526,8 @@ handle_request_activate(struct wl_listener *listener, void *data)
 		wl_container_of(listener, xwayland_view, request_activate);
 	struct view *view = &xwayland_view->base;
 
-	if (window_rules_get_property(view, "ignoreFocusRequest") == LAB_PROP_TRUE) {
+	if (window_rules_get_property(view,
+			LAB_RULE_PROP_IGNORE_FOCUS_REQUEST) == LAB_PROP_TRUE) {
 		wlr_log(WLR_INFO, "Ignoring focus request due to window rule configuration");
 		return;
 	}
@@ -499,7 +632,27 @@ handle_set_decorations(struct wl_listener *listener, void *data)
 static void
 handle_set_window_type(struct wl_listener *listener, void *data)
 {
-	/* Intentionally left blank */
+	struct xwayland_view *xwayland_view =
+		wl_container_of(listener, xwayland_view, set_window_type);
+	xwayland_view_update_props(xwayland_view);
+}
+
+static void
+handle_set_hints(struct wl_listener *listener, void *data)
+{
+	struct xwayland_view *xwayland_view =
+		wl_container_of(listener, xwayland_view, set_hints);
+	xwayland_view_update_props(xwayland_view);
+}
+
+static void
+handle_set_parent(struct wl_listener *listener, void *data)
+{
+	struct xwayland_view *xwayland_view =
+		wl_container_of(listener, xwayland_view, set_parent);
+	struct wlr_xwayland_surface *xsurface = xwayland_view->xwayland_surface;
+	view_set_parent(&xwayland_view->base,
+		xsurface->parent ? xsurface->parent->data : NULL);
 }
 
 static void
@@ -606,6 +759,8 @@ xwayland_view_map(struct view *view)
 		return;
 	}
 	view->mapped = true;
+	/* WM_PROTOCOLS are only read on map and have no event of their own */
+	xwayland_view_update_props(xwayland_view_from_view(view));
 	ensure_initial_geometry_and_output(view);
 	wlr_scene_node_set_enabled(&view->scene_tree->node, true);
 
@@ -677,7 +832,7 @@ xwayland_view_map(struct view *view)
 
 	/* Add commit here, as xwayland map/unmap can change the wlr_surface */
 	wl_signal_add(&xwayland_surface->surface->events.commit, &view->commit);
-	view->commit.notify = handle_commit;
+	view->commit.notify = handle_commit_traced;
 
 	view_impl_map(view);
 	view->been_mapped = true;
@@ -696,6 +851,7 @@ xwayland_view_unmap(struct view *view, bool client_request)
 	}
 	view->mapped = false;
 	wl_list_remove(&view->commit.link);
+	configure_done(xwayland_view_from_view(view));
 	wlr_scene_node_set_enabled(&view->scene_tree->node, false);
 	view_impl_unmap(view);
 
@@ -730,10 +886,24 @@ xwayland_view_minimize(struct view *view, bool minimized)
 		minimized);
 }
 
+/* Unmanaged surfaces (menus, tooltips) stay on top */
+static void
+restack_unmanaged(struct server *server)
+{
+	struct xwayland_unmanaged *u;
+	wl_list_for_each(u, &server->unmanaged_surfaces, link) {
+		wlr_xwayland_surface_restack(u->xwayland_surface,
+			NULL, XCB_STACK_MODE_ABOVE);
+	}
+}
+
 static void
 xwayland_view_move_to_front(struct view *view)
 {
 	view_impl_move_to_front(view);
+	if (restack_deferred) {
+		return;
+	}
 	/*
 	 * Update XWayland stacking order.
 	 *
@@ -744,68 +914,37 @@ xwayland_view_move_to_front(struct view *view)
 	 */
 	wlr_xwayland_surface_restack(xwayland_surface_from_view(view),
 		NULL, XCB_STACK_MODE_ABOVE);
-	/* Restack unmanaged surfaces on top */
-	struct wl_list *list = &view->server->unmanaged_surfaces;
-	struct xwayland_unmanaged *u;
-	wl_list_for_each(u, list, link) {
-		wlr_xwayland_surface_restack(u->xwayland_surface,
-			NULL, XCB_STACK_MODE_ABOVE);
+	if (restack_batch_depth) {
+		restack_unmanaged_pending = true;
+	} else {
+		restack_unmanaged(view->server);
 	}
 }
 
-static void
-xwayland_view_move_to_back(struct view *view)
+void
+xwayland_restack_begin(void)
 {
-	view_impl_move_to_back(view);
-	/* Update XWayland stacking order */
-	wlr_xwayland_surface_restack(xwayland_surface_from_view(view),
-		NULL, XCB_STACK_MODE_BELOW);
+	restack_batch_depth++;
 }
 
-static struct view *
-xwayland_view_get_root(struct view *view)
+void
+xwayland_restack_end(struct server *server)
 {
-	struct wlr_xwayland_surface *root = top_parent_of(view);
-
-	/*
-	 * The case of root->data == NULL is unlikely, but has been reported
-	 * when starting XWayland games (for example 'Fall Guys'). It is
-	 * believed to be caused by setting override-redirect on the root
-	 * wlr_xwayland_surface making it not be associated with a view anymore.
-	 */
-	return (root && root->data) ? (struct view *)root->data : view;
+	assert(restack_batch_depth > 0);
+	if (--restack_batch_depth || !restack_unmanaged_pending) {
+		return;
+	}
+	restack_unmanaged_pending = false;
+	restack_unmanaged(server);
 }
 
 static void
-xwayland_view_append_children(struct view *self, struct wl_array *children)
+xwayland_view_move_to_back(struct view *view)
 {
-	struct wlr_xwayland_surface *surface = xwayland_surface_from_view(self);
-	struct view *view;
-
-	wl_list_for_each_reverse(view, &self->server->views, link)
-	{
-		if (view == self) {
-			continue;
-		}
-		if (view->type != LAB_XWAYLAND_VIEW) {
-			continue;
-		}
-		/*
-		 * This happens when a view has never been mapped or when a
-		 * client has requested a `handle_unmap`.
-		 */
-		if (!view->surface) {
-			continue;
-		}
-		if (!view->mapped && !view->minimized) {
-			continue;
-		}
-		if (top_parent_of(view) != surface) {
-			continue;
-		}
-		struct view **child = wl_array_add(children, sizeof(*child));
-		*child = view;
-	}
+	view_impl_move_to_back(view);
+	/* Update XWayland stacking order */
+	wlr_xwayland_surface_restack(xwayland_surface_from_view(view),
+		NULL, XCB_STACK_MODE_BELOW);
 }
 
 static void
@@ -840,8 +979,6 @@ static const struct view_impl xwayland_view_impl = {
 	.minimize = xwayland_view_minimize,
 	.move_to_front = xwayland_view_move_to_front,
 	.move_to_back = xwayland_view_move_to_back,
-	.get_root = xwayland_view_get_root,
-	.append_children = xwayland_view_append_children,
 	.get_size_hints = xwayland_view_get_size_hints,
 	.wants_focus = xwayland_view_wants_focus,
 	.has_strut_partial = xwayland_view_has_strut_partial,
@@ -884,14 +1021,35 @@ xwayland_view_create(struct server *server,
 	CONNECT_SIGNAL(xsurface, xwayland_view, associate);
 	CONNECT_SIGNAL(xsurface, xwayland_view, dissociate);
 	CONNECT_SIGNAL(xsurface, xwayland_view, request_activate);
-	CONNECT_SIGNAL(xsurface, xwayland_view, request_configure);
+	xwayland_view->request_configure.notify = handle_request_configure_traced;
+	wl_signal_add(&xsurface->events.request_configure,
+		&xwayland_view->request_configure);
 	CONNECT_SIGNAL(xsurface, xwayland_view, set_class);
 	CONNECT_SIGNAL(xsurface, xwayland_view, set_decorations);
 	CONNECT_SIGNAL(xsurface, xwayland_view, set_override_redirect);
 	CONNECT_SIGNAL(xsurface, xwayland_view, set_strut_partial);
 	CONNECT_SIGNAL(xsurface, xwayland_view, set_window_type);
+	CONNECT_SIGNAL(xsurface, xwayland_view, set_hints);
+	CONNECT_SIGNAL(xsurface, xwayland_view, set_parent);
+	xwayland_view_update_props(xwayland_view);
 
-	wl_list_insert(&view->server->views, &view->link);
+	/*
+	 * The view may be created again for an existing xsurface (after
+	 * override-redirect was unset), so pick up existing relations
+	 */
+	wl_list_init(&view->children);
+	wl_list_init(&view->child_link);
+	if (xsurface->parent) {
+		view_set_parent(view, xsurface->parent->data);
+	}
+	struct wlr_xwayland_surface *child;
+	wl_list_for_each(child, &xsurface->children, parent_link) {
+		if (child->data) {
+			view_set_parent(child->data, view);
+		}
+	}
+
+	view_stack_insert(view, /* front */ true);
 
 	if (xsurface->surface) {
 		handle_associate(&xwayland_view->associate, NULL);
@@ -955,6 +1113,13 @@ sync_atoms(xcb_connection_t *xcb_conn)
 static void
 handle_server_ready(struct wl_listener *listener, void *data)
 {
+	xwayland_start.server_ready_nsec = time_now_nsec();
+	if (xwayland_start.start_nsec) {
+		wlr_log(WLR_INFO, "xwayland server ready after %.1f ms",
+			(double)(xwayland_start.server_ready_nsec
+				- xwayland_start.start_nsec) / NSEC_PER_MSEC);
+	}
+
 	xcb_connection_t *xcb_conn = xcb_connect(NULL, NULL);
 	if (xcb_connection_has_error(xcb_conn)) {
 		wlr_log(WLR_ERROR, "Failed to create xcb connection");
@@ -979,17 +1144,80 @@ handle_xwm_ready(struct wl_listener *listener, void *data)
 		wl_container_of(listener, server, xwayland_xwm_ready);
 	wlr_xwayland_set_seat(server->xwayland, server->seat.seat);
 	xwayland_update_workarea(server);
+
+	profile_startup_mark("xwayland_ready", NULL);
+	int64_t now = time_now_nsec();
+	if (xwayland_start.start_nsec) {
+		wlr_log(WLR_INFO, "xwayland ready after %.1f ms",
+			(double)(now - xwayland_start.start_nsec) / NSEC_PER_MSEC);
+	}
+	if (xwayland_start.server_ready_nsec) {
+		wlr_log(WLR_INFO, "xwayland window manager ready after %.1f ms",
+			(double)(now - xwayland_start.server_ready_nsec)
+				/ NSEC_PER_MSEC);
+	}
+}
+
+/*
+ * A lazy Xwayland is started by wlroots once a client connects to one
+ * of its X11 sockets and there is no API to start it otherwise. So just
+ * connect to the socket like a client would and hang up again, Xwayland
+ * drops the dead connection after accepting it.
+ */
+static int
+handle_start_delay(void *data)
+{
+	struct server *server = data;
+	wl_event_source_remove(xwayland_start.delay_timer);
+	xwayland_start.delay_timer = NULL;
+
+	if (!server->xwayland || server->xwayland->server->pid) {
+		/* Already started by an X11 client */
+		return 0;
+	}
+
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "/tmp/.X11-unix/X%d",
+		server->xwayland->server->display);
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		wlr_log_errno(WLR_ERROR, "cannot start xwayland");
+		return 0;
+	}
+	xwayland_start.start_nsec = time_now_nsec();
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+			&& errno != EINPROGRESS) {
+		wlr_log_errno(WLR_ERROR, "cannot start xwayland");
+		xwayland_start.start_nsec = 0;
+	}
+	close(fd);
+	return 0;
 }
 
 void
 xwayland_server_init(struct server *server, struct wlr_compositor *compositor)
 {
+	bool lazy = rc.xwayland_start != LAB_XWAYLAND_START_STARTUP;
 	server->xwayland =
-		wlr_xwayland_create(server->wl_display, compositor, true);
+		wlr_xwayland_create(server->wl_display, compositor, lazy);
 	if (!server->xwayland) {
 		wlr_log(WLR_ERROR, "cannot create xwayland server");
 		exit(EXIT_FAILURE);
 	}
+	switch (rc.xwayland_start) {
+	case LAB_XWAYLAND_START_LAZY:
+		break;
+	case LAB_XWAYLAND_START_STARTUP:
+		/* wlroots starts it once the event loop runs */
+		xwayland_start.start_nsec = time_now_nsec();
+		break;
+	case LAB_XWAYLAND_START_DELAYED:
+		xwayland_start.delay_timer = wl_event_loop_add_timer(
+			server->wl_event_loop, handle_start_delay, server);
+		wl_event_source_timer_update(xwayland_start.delay_timer,
+			MAX(rc.xwayland_start_delay, 1));
+		break;
+	}
 	server->xwayland_new_surface.notify = handle_new_surface;
 	wl_signal_add(&server->xwayland->events.new_surface,
 		&server->xwayland_new_surface);
@@ -1021,6 +1249,35 @@ xwayland_server_init(struct server *server, struct wlr_compositor *compositor)
 	}
 }
 
+/*
+ * Bring the X11 stacking order in line with server->views in one go.
+ *
+ * Raising each view separately restacks the unmanaged surfaces on top
+ * again and again. Instead, each view is stacked directly above the one
+ * below it, starting from the bottom, and the unmanaged surfaces are
+ * raised once at the end.
+ */
+static void
+restack_all(struct server *server)
+{
+	struct wlr_xwayland_surface *sibling = NULL;
+	struct view *view;
+	wl_list_for_each_reverse(view, &server->views, link) {
+		if (view->type != LAB_XWAYLAND_VIEW) {
+			continue;
+		}
+		struct wlr_xwayland_surface *xsurface =
+			xwayland_view_from_view(view)->xwayland_surface;
+		if (!xsurface) {
+			continue;
+		}
+		wlr_xwayland_surface_restack(xsurface, sibling,
+			sibling ? XCB_STACK_MODE_ABOVE : XCB_STACK_MODE_BELOW);
+		sibling = xsurface;
+	}
+	restack_unmanaged(server);
+}
+
 /*
  * Until we expose the workspaces to xwayland we need a way to
  * ensure that xwayland views on the current workspace are always
@@ -1042,7 +1299,6 @@ xwayland_server_init(struct server *server, struct wlr_compositor *compositor)
 void
 xwayland_adjust_stacking_order(struct server *server)
 {
-	struct view **view;
 	struct wl_array views;
 
 	wl_array_init(&views);
@@ -1051,20 +1307,24 @@ xwayland_adjust_stacking_order(struct server *server)
 		| LAB_VIEW_CRITERIA_NO_ALWAYS_ON_TOP);
 
 	/*
-	 * view_array_append() provides top-most windows
-	 * first so we simply reverse the iteration here
+	 * view_array_append() provides top-most windows first, which is
+	 * what view_array_move_to_front() expects
 	 */
-	wl_array_for_each_reverse(view, &views) {
-		view_move_to_front(*view);
-	}
+	restack_deferred = true;
+	view_array_move_to_front(&views);
+	restack_deferred = false;
 
-	wl_array_release(&views);
+	restack_all(server);
 }
 
 void
 xwayland_server_finish(struct server *server)
 {
 	struct wlr_xwayland *xwayland = server->xwayland;
+	if (xwayland_start.delay_timer) {
+		wl_event_source_remove(xwayland_start.delay_timer);
+		xwayland_start.delay_timer = NULL;
+	}
 	/*
 	 * Reset server->xwayland to NULL first to prevent callbacks (like
 	 * server_global_filter) from accessing it as it is destroyed